@@ -0,0 +1,485 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "bgzf_pool.h"
+
+#include <klib/log.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/* the compressed block ( incl. header and footer ) has to fit into 64k,
+   even if the payload of BGZF_POOL_PAYLOAD bytes is not compressible */
+#define BGZF_MAX_BLOCK 0x10000
+#define BGZF_HDR_SIZE 18
+#define BGZF_FTR_SIZE 8
+
+static const uint8_t bgzf_hdr[ BGZF_HDR_SIZE ] =
+{
+    31, 139,    /* ID1, ID2 */
+    8,          /* CM = deflate */
+    4,          /* FLG = FEXTRA */
+    0, 0, 0, 0, /* MTIME */
+    0,          /* XFL */
+    255,        /* OS = unknown */
+    6, 0,       /* XLEN = 6 */
+    'B', 'C',   /* SI1, SI2 */
+    2, 0,       /* SLEN = 2 */
+    0, 0        /* BSIZE = total block size - 1, filled in per block */
+};
+
+static const uint8_t bgzf_eof[ 28 ] =
+{
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0,
+    27, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+enum slot_state
+{
+    ss_free = 0,    /* can be filled by the producer */
+    ss_filled,      /* waiting for a worker */
+    ss_busy,        /* a worker compresses it */
+    ss_done         /* compressed, waiting to be written out */
+};
+
+typedef struct bgzf_slot
+{
+    uint64_t block_nr;
+    size_t in_used;
+    size_t out_size;
+    rc_t rc;
+    enum slot_state state;
+    uint8_t in[ BGZF_POOL_PAYLOAD ];
+    uint8_t out[ BGZF_MAX_BLOCK ];
+} bgzf_slot;
+
+
+typedef struct bgzf_pool
+{
+    KFile * f;
+    uint64_t pos;
+
+    /* the slots are used round robin: block #n lives in slot[ n % slot_count ] */
+    bgzf_slot * slots;
+    uint32_t slot_count;
+
+    bgzf_slot * cur;        /* the slot filled by the producer */
+    uint64_t block_nr;      /* the number of the block in cur */
+    uint64_t next_write;    /* the number of the next block to be written out */
+    uint64_t next_work;     /* the number of the next block to be compressed by a worker */
+
+    uint64_t * block_pos;   /* file-position of every written block, for resolving vpos */
+    uint64_t block_pos_cap;
+    bool track_blocks;      /* only if an index is written, block_pos is NULL otherwise */
+
+    z_stream zs;            /* used if we have no worker-threads */
+
+    KLock * lock;
+    KCondition * work_cond;
+    KCondition * done_cond;
+    KThread ** threads;
+    uint32_t thread_count;
+    int level;
+    bool quit;
+} bgzf_pool;
+
+
+static void put_u32_le( uint8_t * dst, uint32_t value )
+{
+    dst[ 0 ] = value & 0xFF;
+    dst[ 1 ] = ( value >> 8 ) & 0xFF;
+    dst[ 2 ] = ( value >> 16 ) & 0xFF;
+    dst[ 3 ] = ( value >> 24 ) & 0xFF;
+}
+
+
+static rc_t deflate_slot( z_stream * zs, bgzf_slot * s )
+{
+    rc_t rc = 0;
+    int zr = deflateReset( zs );
+    if ( zr == Z_OK )
+    {
+        zs->next_in   = s->in;
+        zs->avail_in  = ( uInt )s->in_used;
+        zs->next_out  = s->out + BGZF_HDR_SIZE;
+        zs->avail_out = BGZF_MAX_BLOCK - BGZF_HDR_SIZE - BGZF_FTR_SIZE;
+        zr = deflate( zs, Z_FINISH );
+    }
+    if ( zr != Z_STREAM_END )
+    {
+        rc = RC( rcExe, rcFile, rcWriting, rcBuffer, rcInsufficient );
+        (void)PLOGERR( klogErr, ( klogErr, rc, "deflate() failed with $(zr)", "zr=%d", zr ) );
+    }
+    else
+    {
+        size_t block_size = BGZF_HDR_SIZE + zs->total_out + BGZF_FTR_SIZE;
+        uint8_t * footer = s->out + BGZF_HDR_SIZE + zs->total_out;
+        uint32_t crc = crc32( 0L, Z_NULL, 0 );
+
+        crc = crc32( crc, s->in, ( uInt )s->in_used );
+        memmove( s->out, bgzf_hdr, BGZF_HDR_SIZE );
+        s->out[ 16 ] = ( block_size - 1 ) & 0xFF;
+        s->out[ 17 ] = ( ( block_size - 1 ) >> 8 ) & 0xFF;
+        put_u32_le( footer, crc );
+        put_u32_le( footer + 4, ( uint32_t )s->in_used );
+        s->out_size = block_size;
+    }
+    return rc;
+}
+
+
+static rc_t init_deflate( z_stream * zs, int level )
+{
+    rc_t rc = 0;
+    int zr;
+
+    memset( zs, 0, sizeof *zs );
+    /* negative window-bits: raw deflate, we write the gzip-header/footer ourselfs */
+    zr = deflateInit2( zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY );
+    if ( zr != Z_OK )
+    {
+        rc = RC( rcExe, rcFile, rcConstructing, rcParam, rcInvalid );
+        (void)PLOGERR( klogErr, ( klogErr, rc, "deflateInit2() failed with $(zr)", "zr=%d", zr ) );
+    }
+    return rc;
+}
+
+
+static rc_t CC bgzf_worker( const KThread * thread, void * data )
+{
+    bgzf_pool * self = data;
+    z_stream zs;
+    rc_t rc = init_deflate( &zs, self->level );
+    if ( rc == 0 )
+    {
+        KLockAcquire( self->lock );
+        while ( true )
+        {
+            bgzf_slot * s = &self->slots[ self->next_work % self->slot_count ];
+            if ( s->state == ss_filled && s->block_nr == self->next_work )
+            {
+                s->state = ss_busy;
+                self->next_work++;
+                KLockUnlock( self->lock );
+
+                s->rc = deflate_slot( &zs, s );
+
+                KLockAcquire( self->lock );
+                s->state = ss_done;
+                KConditionBroadcast( self->done_cond );
+            }
+            else if ( self->quit )
+                break;
+            else
+                KConditionWait( self->work_cond, self->lock );
+        }
+        KLockUnlock( self->lock );
+        deflateEnd( &zs );
+    }
+    return rc;
+}
+
+
+rc_t make_bgzf_pool( struct bgzf_pool ** pool, KFile * f, uint64_t pos, uint32_t threads, int level,
+                     bool track_blocks )
+{
+    rc_t rc = 0;
+    bgzf_pool * p = calloc( 1, sizeof *p );
+    *pool = NULL;
+    if ( p == NULL )
+        rc = RC( rcExe, rcFile, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        p->f = f;
+        p->pos = pos;
+        p->level = level;
+        p->track_blocks = track_blocks;
+        /* two slots per thread: one beeing compressed, one waiting */
+        p->slot_count = ( threads == 0 ) ? 1 : threads * 2;
+        p->slots = calloc( p->slot_count, sizeof p->slots[ 0 ] );
+        if ( p->slots == NULL )
+            rc = RC( rcExe, rcFile, rcConstructing, rcMemory, rcExhausted );
+        else
+            p->cur = &p->slots[ 0 ];
+
+        if ( rc == 0 && threads == 0 )
+            rc = init_deflate( &p->zs, level );
+
+        if ( rc == 0 && threads > 0 )
+        {
+            rc = KLockMake( &p->lock );
+            if ( rc == 0 )
+                rc = KConditionMake( &p->work_cond );
+            if ( rc == 0 )
+                rc = KConditionMake( &p->done_cond );
+            if ( rc == 0 )
+            {
+                p->threads = calloc( threads, sizeof p->threads[ 0 ] );
+                if ( p->threads == NULL )
+                    rc = RC( rcExe, rcFile, rcConstructing, rcMemory, rcExhausted );
+            }
+            while ( rc == 0 && p->thread_count < threads )
+            {
+                rc = KThreadMake( &p->threads[ p->thread_count ], bgzf_worker, p );
+                if ( rc == 0 )
+                    p->thread_count++;
+            }
+            if ( rc != 0 )
+                LOGERR( klogErr, rc, "cannot start bgzf-compression threads" );
+        }
+
+        if ( rc == 0 )
+            *pool = p;
+        else
+            release_bgzf_pool( p );
+    }
+    return rc;
+}
+
+
+void release_bgzf_pool( struct bgzf_pool * self )
+{
+    if ( self != NULL )
+    {
+        if ( self->thread_count > 0 )
+        {
+            uint32_t i;
+
+            KLockAcquire( self->lock );
+            self->quit = true;
+            KConditionBroadcast( self->work_cond );
+            KLockUnlock( self->lock );
+
+            for ( i = 0; i < self->thread_count; ++i )
+            {
+                rc_t status;
+                KThreadWait( self->threads[ i ], &status );
+                KThreadRelease( self->threads[ i ] );
+            }
+        }
+        else if ( self->slots != NULL )
+            deflateEnd( &self->zs );
+
+        free( self->threads );
+        KConditionRelease( self->done_cond );
+        KConditionRelease( self->work_cond );
+        KLockRelease( self->lock );
+        free( self->block_pos );
+        free( self->slots );
+        free( self );
+    }
+}
+
+
+static rc_t write_out( bgzf_pool * self, const void * src, size_t size )
+{
+    size_t num_writ;
+    rc_t rc = KFileWriteAll( self->f, self->pos, src, size, &num_writ );
+    if ( rc == 0 && num_writ != size )
+        rc = RC( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+    if ( rc != 0 )
+        LOGERR( klogErr, rc, "cannot write bgzf-block" );
+    else
+        self->pos += num_writ;
+    return rc;
+}
+
+
+/* waits until the slot is compressed, then writes it out */
+static rc_t write_slot( bgzf_pool * self, bgzf_slot * s )
+{
+    rc_t rc;
+
+    if ( self->thread_count > 0 )
+    {
+        KLockAcquire( self->lock );
+        while ( s->state != ss_done )
+            KConditionWait( self->done_cond, self->lock );
+        KLockUnlock( self->lock );
+    }
+
+    rc = s->rc;
+    if ( rc == 0 && self->track_blocks && s->block_nr >= self->block_pos_cap )
+    {
+        uint64_t cap = ( self->block_pos_cap == 0 ) ? 4096 : self->block_pos_cap * 2;
+        uint64_t * tmp = realloc( self->block_pos, cap * sizeof tmp[ 0 ] );
+        if ( tmp == NULL )
+            rc = RC( rcExe, rcFile, rcWriting, rcMemory, rcExhausted );
+        else
+        {
+            self->block_pos = tmp;
+            self->block_pos_cap = cap;
+        }
+    }
+    if ( rc == 0 )
+    {
+        if ( self->track_blocks )
+            self->block_pos[ s->block_nr ] = self->pos;
+        rc = write_out( self, s->out, s->out_size );
+    }
+
+    /* the workers look at the slot-states, they change only under the lock */
+    if ( self->thread_count > 0 )
+    {
+        KLockAcquire( self->lock );
+        s->state = ss_free;
+        KConditionBroadcast( self->done_cond );
+        KLockUnlock( self->lock );
+    }
+    else
+        s->state = ss_free;
+    self->next_write = s->block_nr + 1;
+    return rc;
+}
+
+
+/* hands the current slot over to the workers ( or compresses it here ),
+   and makes the slot for the next block available */
+static rc_t submit_block( bgzf_pool * self )
+{
+    rc_t rc = 0;
+    bgzf_slot * s = self->cur;
+
+    s->block_nr = self->block_nr++;
+    if ( self->thread_count == 0 )
+    {
+        s->rc = deflate_slot( &self->zs, s );
+        s->state = ss_done;
+        rc = write_slot( self, s );
+    }
+    else
+    {
+        KLockAcquire( self->lock );
+        s->state = ss_filled;
+        KConditionSignal( self->work_cond );
+        KLockUnlock( self->lock );
+    }
+
+    /* the slot of the next block still holds the oldest block in flight: write that one out first,
+       ( decided by the block-numbers, the state of the slot may be changed by a worker right now ) */
+    s = &self->slots[ self->block_nr % self->slot_count ];
+    if ( rc == 0 && self->block_nr - self->next_write >= self->slot_count )
+        rc = write_slot( self, s );
+    s->in_used = 0;
+    self->cur = s;
+    return rc;
+}
+
+
+rc_t bgzf_pool_write( struct bgzf_pool * self, const void * src, size_t size )
+{
+    rc_t rc = 0;
+    const uint8_t * p = src;
+    while ( rc == 0 && size > 0 )
+    {
+        bgzf_slot * s = self->cur;
+        size_t to_copy = BGZF_POOL_PAYLOAD - s->in_used;
+        if ( to_copy > size )
+            to_copy = size;
+        memmove( s->in + s->in_used, p, to_copy );
+        s->in_used += to_copy;
+        p += to_copy;
+        size -= to_copy;
+        if ( s->in_used == BGZF_POOL_PAYLOAD )
+            rc = submit_block( self );
+    }
+    return rc;
+}
+
+
+rc_t bgzf_pool_flush( struct bgzf_pool * self )
+{
+    return ( self->cur->in_used > 0 ) ? submit_block( self ) : 0;
+}
+
+
+size_t bgzf_pool_room( const struct bgzf_pool * self )
+{
+    return BGZF_POOL_PAYLOAD - self->cur->in_used;
+}
+
+
+uint64_t bgzf_pool_vpos( const struct bgzf_pool * self )
+{
+    return ( self->block_nr << 16 ) | self->cur->in_used;
+}
+
+
+uint64_t bgzf_pool_resolve( const struct bgzf_pool * self, uint64_t vpos )
+{
+    uint64_t block_nr = vpos >> 16;
+    if ( self->track_blocks && block_nr < self->next_write )
+        return ( self->block_pos[ block_nr ] << 16 ) | ( vpos & 0xFFFF );
+    /* an offset behind the last block that has been written */
+    return self->pos << 16;
+}
+
+
+rc_t bgzf_pool_sync( struct bgzf_pool * self )
+{
+    rc_t rc = bgzf_pool_flush( self );
+    while ( rc == 0 && self->next_write < self->block_nr )
+        rc = write_slot( self, &self->slots[ self->next_write % self->slot_count ] );
+    return rc;
+}
+
+
+rc_t bgzf_pool_finish( struct bgzf_pool * self )
+{
+    rc_t rc = bgzf_pool_sync( self );
+    if ( rc == 0 )
+    {
+        /* the EOF-marker does not move self->pos: vpos behind the data resolve to it */
+        uint64_t pos = self->pos;
+        rc = write_out( self, bgzf_eof, sizeof bgzf_eof );
+        if ( rc == 0 )
+            self->pos = pos;
+    }
+    return rc;
+}
+
+
+uint64_t bgzf_pool_pos( const struct bgzf_pool * self )
+{
+    return self->pos;
+}
+
+
+rc_t bgzf_write_eof( KFile * f, uint64_t pos )
+{
+    size_t num_writ;
+    rc_t rc = KFileWriteAll( f, pos, bgzf_eof, sizeof bgzf_eof, &num_writ );
+    if ( rc == 0 && num_writ != sizeof bgzf_eof )
+        rc = RC( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+    if ( rc != 0 )
+        LOGERR( klogErr, rc, "cannot write bgzf-EOF-marker" );
+    return rc;
+}
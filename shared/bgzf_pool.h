@@ -0,0 +1,100 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+#ifndef _h_bgzf_pool_
+#define _h_bgzf_pool_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+#include <klib/rc.h>
+#include <kfs/file.h>
+
+/* ---------------------------------------------------------------------------------------------
+    the bgzf-pool cuts the data written to it into BGZF-blocks ( independent gzip-members
+    of at most 64k, as used by BAM ) and lets a pool of threads compress them. The blocks
+    are written out in the order they have been filled.
+
+    Virtual file-offsets ( compressed-offset << 16 | offset-in-block ) as needed for a BAM-index
+    are only known after a block has been compressed. bgzf_pool_vpos() therefore returns
+    ( block-number << 16 | offset-in-block ), bgzf_pool_resolve() translates such a value into
+    the real virtual file-offset once the block has been written.
+
+    sam-dump ( bam_out.c ) and fasterq-dump ( join_results.c, concatenator.c ) share this code:
+    the join-threads of fasterq-dump compress their own files without workers ( threads = 0 ),
+    their files are concatenated and terminated by bgzf_write_eof().
+--------------------------------------------------------------------------------------------- */
+
+/* the uncompressed payload of one block */
+#define BGZF_POOL_PAYLOAD 0xFF00
+
+#define BGZF_DFLT_LEVEL 6
+
+struct bgzf_pool;
+
+/* threads = 0 ... compress on the calling thread, the pool does not own the file
+   track_blocks ... remember the position of every block, needed for bgzf_pool_resolve() */
+rc_t make_bgzf_pool( struct bgzf_pool ** pool, KFile * f, uint64_t pos, uint32_t threads, int level,
+                     bool track_blocks );
+
+/* waits for the worker-threads, does NOT write pending data, call bgzf_pool_finish() before */
+void release_bgzf_pool( struct bgzf_pool * self );
+
+rc_t bgzf_pool_write( struct bgzf_pool * self, const void * src, size_t size );
+
+/* closes the current block ( if not empty ), the next write starts a new block */
+rc_t bgzf_pool_flush( struct bgzf_pool * self );
+
+/* how many bytes fit into the current block */
+size_t bgzf_pool_room( const struct bgzf_pool * self );
+
+/* unresolved virtual offset of the next byte written */
+uint64_t bgzf_pool_vpos( const struct bgzf_pool * self );
+
+/* translate an unresolved virtual offset into a real one ( block has to be written out,
+   the pool has to be made with track_blocks ) */
+uint64_t bgzf_pool_resolve( const struct bgzf_pool * self, uint64_t vpos );
+
+/* flushes and waits for all blocks to be written, without EOF-marker ( output to be concatenated ) */
+rc_t bgzf_pool_sync( struct bgzf_pool * self );
+
+/* flushes, waits for all blocks to be written and appends the EOF-marker-block */
+rc_t bgzf_pool_finish( struct bgzf_pool * self );
+
+/* position in the file behind the last written data-block ( the EOF-marker not counted ) */
+uint64_t bgzf_pool_pos( const struct bgzf_pool * self );
+
+/* writes the 28 byte EOF-marker-block at pos */
+rc_t bgzf_write_eof( KFile * f, uint64_t pos );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
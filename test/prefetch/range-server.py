@@ -0,0 +1,151 @@
+#!/usr/bin/env python
+
+# a local HTTP server for the prefetch tests: serves the files of a directory,
+# honours 'Range: bytes=first-last', logs the served ranges and can cut
+# the response of a range short to make the client retry
+
+import sys, os, re, getopt, threading
+from http.server import BaseHTTPRequestHandler, HTTPServer
+from socketserver import ThreadingMixIn
+
+class Server( ThreadingMixIn, HTTPServer ) :
+    daemon_threads = True
+
+class Handler( BaseHTTPRequestHandler ) :
+    protocol_version = 'HTTP/1.1'
+
+    def log_message( self, format, *args ) :
+        pass
+
+    def file_path( self ) :
+        name = os.path.basename( self.path.split( '?' )[ 0 ] )
+        path = os.path.join( self.server.root, name )
+        if name == '' or not os.path.isfile( path ) :
+            self.send_response( 404 )
+            self.send_header( 'Content-Length', '0' )
+            self.end_headers()
+            return None
+        return path
+
+    def do_HEAD( self ) :
+        path = self.file_path()
+        if path != None :
+            self.send_response( 200 )
+            self.send_header( 'Content-Length', str( os.path.getsize( path ) ) )
+            self.send_header( 'Accept-Ranges', 'bytes' )
+            self.end_headers()
+
+    def do_GET( self ) :
+        path = self.file_path()
+        if path == None :
+            return
+        size = os.path.getsize( path )
+        first, last = 0, size - 1
+        ranged = False
+        m = re.match( r'bytes=(\d*)-(\d*)$', self.headers.get( 'Range', '' ) )
+        if m != None :
+            ranged = True
+            if m.group( 1 ) != '' :
+                first = int( m.group( 1 ) )
+                if m.group( 2 ) != '' :
+                    last = min( int( m.group( 2 ) ), size - 1 )
+            elif m.group( 2 ) != '' :
+                first = max( size - int( m.group( 2 ) ), 0 )
+            if first > last :
+                self.send_response( 416 )
+                self.send_header( 'Content-Range', 'bytes */%d' % size )
+                self.send_header( 'Content-Length', '0' )
+                self.end_headers()
+                return
+
+        with open( path, 'rb' ) as f :
+            f.seek( first )
+            data = f.read( last - first + 1 )
+
+        cut = self.server.should_fail( first, last )
+        self.server.log_range( first, last, cut )
+
+        if ranged :
+            self.send_response( 206 )
+            self.send_header( 'Content-Range', 'bytes %d-%d/%d' % ( first, last, size ) )
+        else :
+            self.send_response( 200 )
+        self.send_header( 'Content-Length', str( len( data ) ) )
+        self.send_header( 'Accept-Ranges', 'bytes' )
+        self.end_headers()
+
+        if cut :
+            # promise the whole range, deliver half of it and drop the connection
+            self.wfile.write( data[ : len( data ) // 2 ] )
+            self.wfile.flush()
+            self.close_connection = True
+        else :
+            self.wfile.write( data )
+
+class RangeServer( Server ) :
+    def __init__( self, root, log, fail_at, fail_count ) :
+        Server.__init__( self, ( '127.0.0.1', 0 ), Handler )
+        self.root = root
+        self.log = log
+        self.fail_at = fail_at
+        self.fail_count = fail_count
+        self.lock = threading.Lock()
+
+    def should_fail( self, first, last ) :
+        with self.lock :
+            if self.fail_at != None and self.fail_count > 0 and first <= self.fail_at <= last :
+                self.fail_count -= 1
+                return True
+            return False
+
+    def log_range( self, first, last, cut ) :
+        if self.log != None :
+            with self.lock :
+                with open( self.log, 'a' ) as f :
+                    f.write( '%d-%d%s\n' % ( first, last, ' cut' if cut else '' ) )
+
+def usage() :
+    print( sys.argv[ 0 ], '-d <dir> -p <port-file> [-l <log-file>] [-f <offset> [-n <count>]]' )
+
+if __name__ == '__main__':
+    if sys.version_info[ 0 ] < 3 :
+        print( "does not work with python version < 3!" )
+        sys.exit( 3 )
+
+    root, port_file, log, fail_at, fail_count = '.', None, None, None, 1
+    try :
+        opts, args = getopt.getopt( sys.argv[ 1: ], "hd:p:l:f:n:" )
+    except getopt.GetoptError :
+        usage()
+        sys.exit( 2 )
+    for opt, arg in opts :
+        if opt == '-h' :
+            usage()
+            sys.exit()
+        elif opt == '-d' :
+            root = arg
+        elif opt == '-p' :
+            port_file = arg
+        elif opt == '-l' :
+            log = arg
+        elif opt == '-f' :
+            fail_at = int( arg )
+        elif opt == '-n' :
+            fail_count = int( arg )
+
+    srv = RangeServer( root, log, fail_at, fail_count )
+
+    # the port is chosen by the system, the test waits for this file
+    port = str( srv.server_address[ 1 ] )
+    if port_file != None :
+        with open( port_file + '.part', 'w' ) as f :
+            f.write( port )
+        os.rename( port_file + '.part', port_file )
+    else :
+        print( port )
+        sys.stdout.flush()
+
+    try :
+        srv.serve_forever()
+    except KeyboardInterrupt :
+        pass
@@ -0,0 +1,130 @@
+#!/usr/local/bin/perl -w
+use strict;
+
+# prefetch --connections: parallel ranged download from a local HTTP-server
+# ( range-server.py ), no network access is needed
+
+my $verbose; # = 1;
+
+my $CHUNK = 4096;
+my $COUNT = 10;
+my $SIZE = $CHUNK * $COUNT + 123; # the last chunk is short
+my $PYTHON = $ENV{PYTHON} || 'python3';
+my $SRV = 'srv';
+my $NAME = 'run.sra';
+my $OUT = "out/$NAME";
+
+$ENV{NCBI_VDB_PREFETCH_CHUNK_SZ} = $CHUNK;
+
+mkdir $SRV;
+mkdir 'out';
+
+# the served file: every chunk has different content
+srand(53325);
+my $org = '';
+$org .= pack('N', int(rand(0xFFFFFFFF))) while length($org) < $SIZE;
+$org = substr($org, 0, $SIZE);
+write_file("$SRV/$NAME", $org);
+
+my $pid;
+
+sub write_file {
+  my ($name, $data) = @_;
+  open F, ">$name" or die "cannot write $name";
+  binmode F; print F $data; close F;
+}
+
+sub read_file {
+  my ($name) = @_;
+  open F, $name or die "cannot read $name";
+  binmode F; local $/; my $data = <F>; close F;
+  return $data;
+}
+
+# starts range-server.py with extra options, returns the URL of the served file
+sub start_server {
+  unlink 'port', 'ranges';
+  $pid = fork();
+  die 'cannot fork' unless defined $pid;
+  if ($pid == 0) {
+    exec $PYTHON, '../range-server.py', '-d', $SRV, '-p', 'port',
+         '-l', 'ranges', @_;
+    die 'cannot start range-server.py';
+  }
+  for (my $i = 0; $i < 100 && ! -e 'port'; ++$i) {
+    select(undef, undef, undef, 0.1);
+  }
+  die 'range-server.py did not start' unless -e 'port';
+  my $port = read_file('port');
+  return "http://127.0.0.1:$port/$NAME";
+}
+
+sub stop_server {
+  if ($pid) { kill 'TERM', $pid; waitpid $pid, 0; $pid = undef; }
+}
+
+END { my $rc = $?; stop_server(); $? = $rc; }
+
+# the ranges served so far: [ first, last, cut ]
+sub ranges {
+  my @r;
+  open R, 'ranges' or return @r;
+  while (<R>) { push @r, [ $1, $2, defined $3 ] if /^(\d+)-(\d+)( cut)?$/; }
+  close R;
+  return @r;
+}
+
+sub download {
+  my ($url) = @_;
+  my $out = `prefetch $url -O / -o $OUT --connections 4`;
+  print $out if $verbose; die 'prefetch failed' if $?;
+  die "$OUT differs from the served file" unless read_file($OUT) eq $org;
+  die 'chunk-map was not removed' if -e "$OUT.prc";
+  unlink $OUT or die;
+}
+
+print "=====\nparallel download from scratch\n" if $verbose;
+download(start_server());
+my %starts = map { $_->[0] => 1 } ranges();
+die 'the file was not fetched in chunks' if keys %starts < 3;
+stop_server();
+
+print "=====\na range cut short is retried\n" if $verbose;
+my $FAIL = $CHUNK * 3 + 10;
+download(start_server('-f', $FAIL));
+my ($cut, $retried);
+for my $r (ranges()) {
+  if ($r->[2]) { $cut = $r; }
+  elsif ($cut && $cut->[0] <= $r->[0] && $r->[0] <= $cut->[1]) { $retried = 1; }
+}
+die 'no range was cut' unless $cut;
+die 'the cut range was not fetched again' unless $retried;
+stop_server();
+
+print "=====\nchunk-map: fetch only missing chunks\n" if $verbose;
+my ($tmp, $map) = ('', pack('a8 Q Q', 'NCBIprCh', $SIZE, $CHUNK));
+my $count = int(($SIZE + $CHUNK - 1) / $CHUNK);
+my $bits = "\0" x int(($count + 7) / 8);
+for (my $i = 0; $i < $count; ++$i) {
+  my $chunk = substr($org, $i * $CHUNK, $CHUNK);
+  if ($i % 2) { # odd chunks are done
+    vec($bits, $i, 1) = 1;
+    $tmp .= $chunk;
+  } else {
+    $tmp .= "\0" x length($chunk);
+  }
+}
+write_file("$OUT.tmp", $tmp);
+write_file("$OUT.prc", $map . $bits);
+download(start_server());
+for my $r (ranges()) {
+  my $chunk = int($r->[0] / $CHUNK);
+  die "chunk $chunk was done but fetched again" if $chunk % 2;
+}
+stop_server();
+
+print "=====\nchunk-map of another file is ignored\n" if $verbose;
+write_file("$OUT.tmp", $tmp);
+write_file("$OUT.prc", pack('a8 Q Q', 'NCBIprCh', $SIZE + 1, $CHUNK) . $bits);
+download(start_server());
+stop_server();
@@ -0,0 +1,93 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+/* ---------------------------------------------------------------------------------------------
+    reads the output of sra-pileup --function binary with libpileup-bin and prints the
+    columns that --function count prints too:
+
+        ref  pos  depth  matches  A-A  C-C  G-G  T-T  forward%
+
+    exit-code: 0 ... ok, 1 ... usage/io-error, 2 ... format-error, 3 ... out of memory
+--------------------------------------------------------------------------------------------- */
+
+#include "pileup_bin_reader.h"
+
+#include <stdio.h>
+
+static int print_segment( const pileup_bin_segment * seg )
+{
+    uint32_t i;
+    for ( i = 0; i < seg->count; ++i )
+    {
+        uint32_t forward = seg->column[ pbin_forward ][ i ];
+        uint32_t sum = forward + seg->column[ pbin_reverse ][ i ];
+        uint32_t matches = seg->column[ pbin_matches ][ i ];
+
+        printf( "%s\t%u\t%u\t", seg->ref_name, seg->start + i + 1, seg->column[ pbin_depth ][ i ] );
+        if ( matches > 0 )
+            printf( "%u", matches );
+        printf( "\t%u-A\t%u-C\t%u-G\t%u-T\t%u%%\n",
+                seg->column[ pbin_A ][ i ], seg->column[ pbin_C ][ i ],
+                seg->column[ pbin_G ][ i ], seg->column[ pbin_T ][ i ],
+                ( sum > 0 ) ? ( ( forward * 100 ) / sum ) : 0 );
+    }
+    return ferror( stdout ) ? pbs_io_error : pbs_ok;
+}
+
+
+int main( int argc, char * argv[] )
+{
+    struct pileup_bin_reader * r;
+    int res;
+
+    if ( argc > 2 )
+    {
+        fprintf( stderr, "usage: %s [pileup.bin]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    res = pileup_bin_open( &r, ( argc > 1 ) ? argv[ 1 ] : NULL );
+    if ( res == pbs_ok )
+    {
+        pileup_bin_segment seg;
+        while ( ( res = pileup_bin_next( r, &seg ) ) == pbs_ok )
+        {
+            res = print_segment( &seg );
+            if ( res != pbs_ok )
+                break;
+        }
+        pileup_bin_close( r );
+    }
+
+    switch( res )
+    {
+        case pbs_ok           : /* fall through intended ! */
+        case pbs_end          : return 0;
+        case pbs_format_error : fprintf( stderr, "format-error\n" ); return 2;
+        case pbs_no_memory    : fprintf( stderr, "out of memory\n" ); return 3;
+        default               : fprintf( stderr, "io-error\n" ); return 1;
+    }
+}
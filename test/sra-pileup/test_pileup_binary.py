@@ -0,0 +1,214 @@
+#!/usr/bin/env python
+
+# round-trip of the binary pileup-format ( tools/sra-pileup/pileup_bin.h ):
+#   sra-pileup --function binary -> test-pileup-bin ( libpileup-bin ) -> text
+# compared to the same columns of sra-pileup --function count,
+# with --threads the output has to be the same bytes as without ( the slices must not
+# announce a reference again ), and the reader has to reject truncated and corrupt streams
+# without crashing
+
+import sys, os, getopt, struct, subprocess, tempfile
+
+MAGIC = b'SRAPILEB'
+VERSION = 2
+COLUMNS = 10
+
+def run_tool( args ) :
+    p = subprocess.Popen( args, stdout = subprocess.PIPE, stderr = subprocess.PIPE )
+    out, err = p.communicate()
+    return ( p.returncode, out.decode( 'ascii' ) )
+
+def varint( v ) :
+    res = bytearray()
+    while v >= 0x80 :
+        res.append( ( v & 0x7F ) | 0x80 )
+        v >>= 7
+    res.append( v )
+    return bytes( res )
+
+def header( columns = COLUMNS ) :
+    return MAGIC + struct.pack( '=IIII', 0x01020304, VERSION, columns, 0 )
+
+def reference( name ) :
+    return b'R' + varint( len( name ) ) + name.encode( 'ascii' )
+
+def column( values ) :
+    enc = bytearray()
+    i = 0
+    while i < len( values ) :
+        if values[ i ] == 0 :
+            run = 1
+            while i + run < len( values ) and values[ i + run ] == 0 :
+                run += 1
+            enc += varint( ( ( run - 1 ) << 1 ) | 1 )
+            i += run
+        else :
+            enc += varint( values[ i ] << 1 )
+            i += 1
+    return varint( len( enc ) ) + bytes( enc )
+
+def segment( start, columns ) :
+    res = b'S' + varint( start ) + varint( len( columns[ 0 ] ) )
+    for c in columns :
+        res += column( c )
+    return res
+
+def write_file( path, data ) :
+    with open( path, 'wb' ) as f :
+        f.write( data )
+
+def expect_rc( tool, path, rc, what ) :
+    ( res, out ) = run_tool( [ tool, path ] )
+    if res != rc :
+        print( "%s: expected rc=%d, got rc=%d" % ( what, rc, res ) )
+        sys.exit( 1 )
+    return out
+
+# the columns of --function count: ref pos base depth matches A C G T I: D: forward% S E
+def count_to_common( text ) :
+    res = []
+    for line in text.splitlines() :
+        f = line.split( '\t' )
+        if len( f ) > 11 and f[ 3 ] != '0' :
+            res.append( '\t'.join( f[ 0:2 ] + f[ 3:9 ] + [ f[ 11 ] ] ) )
+    return '\n'.join( res )
+
+def test_synthetic( tool, tmp ) :
+    print( "synthetic stream" )
+    depth = [ 3, 3, 4, 0x80000001 ]
+    zeros = [ 0, 0, 0, 0 ]
+    cols = [ depth, [ 3, 2, 4, 0 ], [ 0, 1, 0, 0 ], zeros, zeros, zeros, zeros, zeros, [ 1, 1, 4, 0 ], [ 2, 2, 0, 1 ] ]
+    data = header() + reference( 'chr1' ) + segment( 99, cols )
+    write_file( tmp, data )
+    out = expect_rc( tool, tmp, 0, "synthetic" )
+    expected = "chr1\t100\t3\t3\t0-A\t0-C\t0-G\t0-T\t33%\n" \
+               "chr1\t101\t3\t2\t1-A\t0-C\t0-G\t0-T\t33%\n" \
+               "chr1\t102\t4\t4\t0-A\t0-C\t0-G\t0-T\t100%\n" \
+               "chr1\t103\t2147483649\t\t0-A\t0-C\t0-G\t0-T\t0%\n"
+    if out != expected :
+        print( "synthetic: unexpected output:\n" + out )
+        sys.exit( 1 )
+
+    # a newer writer with an extra column: skipped by the byte-count
+    write_file( tmp, header( COLUMNS + 1 ) + reference( 'chr1' ) + segment( 99, cols + [ [ 7, 0, 0, 7 ] ] ) )
+    if expect_rc( tool, tmp, 0, "extra column" ) != expected :
+        print( "extra column: unexpected output" )
+        sys.exit( 1 )
+
+def test_corrupt( tool, tmp, good ) :
+    print( "truncated and corrupt streams" )
+    for cut in [ 1, 7, len( good ) // 2 ] :
+        if cut < len( good ) - len( header() ) :
+            write_file( tmp, good[ : len( good ) - cut ] )
+            expect_rc( tool, tmp, 2, "truncated by %d bytes" % cut )
+
+    # huge name-length, must be rejected before allocating
+    write_file( tmp, header() + b'R' + varint( 0xFFFFFFFF ) + b'chr1' )
+    expect_rc( tool, tmp, 2, "name-length" )
+
+    # varint longer than 32 bits
+    write_file( tmp, header() + b'R' + b'\xff\xff\xff\xff\xff\x01' )
+    expect_rc( tool, tmp, 2, "long varint" )
+
+    # huge segment
+    write_file( tmp, header() + reference( 'chr1' ) + b'S' + varint( 0 ) + varint( 0xFFFFFFFF ) )
+    expect_rc( tool, tmp, 2, "segment-count" )
+
+    # column producing more values than the segment has
+    bad = b'S' + varint( 0 ) + varint( 1 ) + column( [ 1, 1 ] ) * COLUMNS
+    write_file( tmp, header() + reference( 'chr1' ) + bad )
+    expect_rc( tool, tmp, 2, "column-overflow" )
+
+    # segment before any reference, unknown record, wrong version
+    write_file( tmp, header() + segment( 0, [ [ 1 ] ] * COLUMNS ) )
+    expect_rc( tool, tmp, 2, "no reference" )
+    write_file( tmp, header() + b'X' )
+    expect_rc( tool, tmp, 2, "unknown record" )
+    write_file( tmp, MAGIC + struct.pack( '=IIII', 0x01020304, 1, COLUMNS, 0 ) )
+    expect_rc( tool, tmp, 2, "version" )
+
+def test_round_trip( pileup, tool, acc, region, tmp ) :
+    print( "round-trip of %s -r %s" % ( acc, region ) )
+    ( res, out ) = run_tool( [ pileup, acc, '-r', region, '--function', 'binary', '-o', tmp ] )
+    if res != 0 :
+        print( "sra-pileup --function binary failed" )
+        sys.exit( 1 )
+    binary = expect_rc( tool, tmp, 0, "round-trip" ).rstrip( '\n' )
+
+    ( res, out ) = run_tool( [ pileup, acc, '-r', region, '--function', 'count' ] )
+    if res != 0 :
+        print( "sra-pileup --function count failed" )
+        sys.exit( 1 )
+    count = count_to_common( out )
+
+    if binary != count or len( count ) == 0 :
+        print( "binary and count differ:" )
+        print( binary )
+        print( "vs:" )
+        print( count )
+        sys.exit( 1 )
+
+    with open( tmp, 'rb' ) as f :
+        return f.read()
+
+# the region has to span several slices ( 64k each at least )
+def test_threads( pileup, tool, acc, region, tmp ) :
+    print( "--threads 4 vs. serial of %s -r %s" % ( acc, region ) )
+    res = []
+    for threads in [ '1', '4' ] :
+        ( rc, out ) = run_tool( [ pileup, acc, '-r', region, '--function', 'binary', '--threads', threads, '-o', tmp ] )
+        if rc != 0 :
+            print( "sra-pileup --function binary --threads %s failed" % threads )
+            sys.exit( 1 )
+        with open( tmp, 'rb' ) as f :
+            data = f.read()
+        res.append( ( data, expect_rc( tool, tmp, 0, "threads %s" % threads ) ) )
+    if res[ 0 ][ 1 ] != res[ 1 ][ 1 ] or len( res[ 0 ][ 1 ] ) == 0 :
+        print( "decoded output with and without threads differs" )
+        sys.exit( 1 )
+    if res[ 0 ][ 0 ] != res[ 1 ][ 0 ] :
+        print( "binary output with and without threads differs" )
+        sys.exit( 1 )
+
+if __name__ == '__main__':
+    if sys.version_info[ 0 ] < 3 :
+        print( "does not work with python version < 3!" )
+        sys.exit( 3 )
+
+    pileup = None
+    tool = 'test-pileup-bin'
+    acc = 'SRR5486177'
+    region = 'chr1:3002000-3004000'
+    wide_region = 'chr1:3000000-3400000'
+
+    usage = ' -p <sra-pileup> -t <test-pileup-bin> -a <accession> -r <region>'
+    try :
+        opts, args = getopt.getopt( sys.argv[ 1: ], "hp:t:a:r:" )
+    except getopt.GetoptError :
+        print ( sys.argv[ 0 ], usage )
+        sys.exit( 2 )
+    for opt, arg in opts :
+        if opt == '-h' :
+            print ( sys.argv[ 0 ], usage )
+            sys.exit()
+        elif opt == '-p' :
+            pileup = arg
+        elif opt == '-t' :
+            tool = arg
+        elif opt == '-a' :
+            acc = arg
+        elif opt == '-r' :
+            region = arg
+
+    fd, tmp = tempfile.mkstemp( suffix = '.pileup' )
+    os.close( fd )
+    try :
+        test_synthetic( tool, tmp )
+        good = header() + reference( 'chr1' ) + segment( 0, [ list( range( 1, 40 ) ) ] * COLUMNS )
+        if pileup != None :
+            good = test_round_trip( pileup, tool, acc, region, tmp )
+            test_threads( pileup, tool, acc, wide_region, tmp )
+        test_corrupt( tool, tmp, good )
+    finally :
+        os.remove( tmp )
+    print( "ok" )
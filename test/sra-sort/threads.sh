@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# sra-sort copies columns on a pool of threads:
+# the result has to be the same as the one of a single thread
+
+ACC="$1"
+BINDIR="$2"
+THREADS="$3"
+
+if [ "$ACC" == "" ] ; then ACC=SRR341578 ; fi
+if [ "$BINDIR" == "" ] ; then BINDIR=`dirname \`which sra-sort\`` ; fi
+if [ "$THREADS" == "" ] ; then THREADS=4 ; fi
+
+echo ""
+echo "===== TESTING SRA-SORT: --threads $THREADS vs --threads 1 ====="
+echo "accession  : $ACC"
+echo "binaries in: $BINDIR"
+echo ""
+
+SCRATCH=`pwd`/tmp-threads
+rm -fr $SCRATCH
+mkdir -p $SCRATCH
+if [ "$?" != "0" ] ; then echo "cannot create $SCRATCH"; exit 1; fi
+
+OPT="--tempdir $SCRATCH --mmapdir $SCRATCH"
+
+sort_acc()
+{
+    CMD="$BINDIR/sra-sort -f $OPT --threads $1 $ACC $SCRATCH/$1"
+    echo "$CMD"
+    $CMD
+    rc=$?; if [[ $rc != 0 ]]; then echo "$CMD failed"; rm -fr $SCRATCH; exit $rc; fi
+}
+
+sort_acc 1
+sort_acc $THREADS
+
+TABLES=`ls $SCRATCH/1/tbl`
+if [ "$TABLES" == "" ] ; then
+    echo "no tables in $SCRATCH/1"; rm -fr $SCRATCH; exit 2
+fi
+if [ "$TABLES" != "`ls $SCRATCH/$THREADS/tbl`" ] ; then
+    echo "the tables differ"; rm -fr $SCRATCH; exit 3
+fi
+
+for T in $TABLES ; do
+    for N in 1 $THREADS ; do
+        CMD="$BINDIR/vdb-dump $SCRATCH/$N -T $T -f tab"
+        $CMD > $SCRATCH/$T.$N.txt
+        rc=$?; if [[ $rc != 0 ]]; then echo "$CMD failed"; rm -fr $SCRATCH; exit $rc; fi
+    done
+
+    CMD="diff $SCRATCH/$T.1.txt $SCRATCH/$T.$THREADS.txt"
+    echo "$CMD"
+    $CMD > /dev/null
+    rc=$?; if [[ $rc != 0 ]]; then echo "$CMD failed"; rm -fr $SCRATCH; exit $rc; fi
+done
+
+echo ">>>SUCCESS!"
+rm -fr $SCRATCH
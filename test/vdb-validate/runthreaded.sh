@@ -0,0 +1,64 @@
+#!/bin/bash
+# ===========================================================================
+#
+#                            PUBLIC DOMAIN NOTICE
+#               National Center for Biotechnology Information
+#
+#  This software/database is a "United States Government Work" under the
+#  terms of the United States Copyright Act.  It was written as part of
+#  the author's official duties as a United States Government employee and
+#  thus cannot be copyrighted.  This software/database is freely available
+#  to the public for use. The National Library of Medicine and the U.S.
+#  Government have not placed any restriction on its use or reproduction.
+#
+#  Although all reasonable efforts have been taken to ensure the accuracy
+#  and reliability of the software and data, the NLM and the U.S.
+#  Government do not and cannot warrant the performance or results that
+#  may be obtained by using this software or data. The NLM and the U.S.
+#  Government disclaim all warranties, express or implied, including
+#  warranties of performance, merchantability or fitness for any particular
+#  purpose.
+#
+#  Please cite the author in any work or product based on this material.
+#
+# ===========================================================================
+
+# runs TEST_CMD with a single thread and with THREADS threads,
+# letting the threaded checks split even the small test tables:
+# the exit codes and the outputs have to be the same
+
+TEST_CMD=$1
+CASEID=$2
+THREADS=${3:-4}
+
+run()
+{
+    CMD="$TEST_CMD $1 > \"actual/$CASEID.$2.tmp\" 2>&1"
+    eval $CMD
+    rc="$?"
+
+    # remove first two columns from output: datetime and progname,
+    # file names and line numbers, and the read-ahead report
+    cat "actual/$CASEID.$2.tmp" \
+        | awk '{if(substr($2,1,12) == "vdb-validate"){$2=$1="";} print $0}' \
+        | grep -v 'Reading ahead' \
+        | sed -e 's/^[ \t]*//g' -e 's/: .*:[0-9]*:[^ ]*:/:/g' > "actual/$CASEID.$2"
+    rm "actual/$CASEID.$2.tmp"
+}
+
+run "--threads 1" 1
+RC1=$rc
+run "--threads $THREADS --min-rows-per-thread 1" $THREADS
+RCN=$rc
+
+if [ "$RC1" != "$RCN" ] ; then
+    echo "command \"$TEST_CMD\" returned $RC1 with 1 thread, $RCN with $THREADS"
+    cat actual/$CASEID.$THREADS
+    exit 2
+fi
+
+diff actual/$CASEID.1 actual/$CASEID.$THREADS
+if [ "$?" != "0" ] ; then
+    echo "command \"$TEST_CMD\": output differs with $THREADS threads"
+    exit 3
+fi
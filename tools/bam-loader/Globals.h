@@ -24,6 +24,8 @@
  *
  */
 
+#include <atomic32.h>
+
 enum LoaderModes {
     mode_Archive,
     mode_Remap
@@ -55,7 +57,9 @@ typedef struct globals
     uint64_t maxAlignCount;
     size_t cache_size;
 
-    unsigned errCount;
+    unsigned inflateThreads; /* number of threads inflating BGZF blocks */
+    unsigned regionThreads; /* number of threads reading ranges of an indexed BAM file */
+    atomic32_t errCount; /* counted by the range readers concurrently */
     unsigned maxErrCount;
     unsigned maxWarnCount_NoMatch;
     unsigned maxWarnCount_DupConflict;
@@ -88,6 +92,7 @@ typedef struct globals
     bool allowMultiMapping; /* allow multiple reference names to map to the same real reference */
     bool assembleWithSecondary;
     bool deferSecondary;
+    bool hashNameIndex; /* use NameIndex instead of a KBTree per read group for spot names */
 } Globals;
 
 extern Globals G;
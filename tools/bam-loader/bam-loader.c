@@ -149,6 +149,9 @@ static char const option_accept_hard_clip[] = "accept-hard-clip";
 static char const option_allow_multi_map[] = "allow-multi-map";
 static char const option_allow_secondary[] = "make-spots-with-secondary";
 static char const option_defer_secondary[] = "defer-secondary";
+static char const option_inflate_threads[] = "inflate-threads";
+static char const option_hash_name_index[] = "hash-name-index";
+static char const option_region_threads[] = "region-threads";
 
 #define OPTION_INPUT option_input
 #define OPTION_OUTPUT option_output
@@ -174,6 +177,9 @@ static char const option_defer_secondary[] = "defer-secondary";
 #define OPTION_ALLOW_MULTI_MAP option_allow_multi_map
 #define OPTION_ALLOW_SECONDARY option_allow_secondary
 #define OPTION_DEFER_SECONDARY option_defer_secondary
+#define OPTION_INFLATE_THREADS option_inflate_threads
+#define OPTION_HASH_NAME_INDEX option_hash_name_index
+#define OPTION_REGION_THREADS option_region_threads
 
 #define ALIAS_INPUT  "i"
 #define ALIAS_OUTPUT "o"
@@ -423,6 +429,31 @@ char const * use_defer_secondary[] =
     NULL
 };
 
+static
+char const * use_inflate_threads[] =
+{
+    "number of threads decompressing the BAM file, default 1",
+    "(0 or 1 decompresses on the reader thread)",
+    NULL
+};
+
+static
+char const * use_hash_name_index[] =
+{
+    "look up spot names in a sharded hash index instead of a b-tree per read group",
+    "(faster for files with many spots; the footprint is logged at the end)",
+    NULL
+};
+
+static
+char const * use_region_threads[] =
+{
+    "number of threads reading a coordinate-sorted BAM file in ranges",
+    "found in its .bai index; default 0 reads it from start to end",
+    "(not used with --defer-secondary)",
+    NULL
+};
+
 OptDef Options[] = 
 {
     /* order here is same as in param array below!!! */
@@ -458,7 +489,10 @@ OptDef Options[] =
     { OPTION_ACCEPT_HARD_CLIP, NULL, NULL, use_accept_hard_clip, 1, false, false },
     { OPTION_ALLOW_MULTI_MAP, NULL, NULL, use_allow_multi_map, 1, false, false },
     { OPTION_ALLOW_SECONDARY, NULL, NULL, use_allow_secondary, 1, false, false },
-    { OPTION_DEFER_SECONDARY, NULL, NULL, use_defer_secondary, 1, false, false }
+    { OPTION_DEFER_SECONDARY, NULL, NULL, use_defer_secondary, 1, false, false },
+    { OPTION_INFLATE_THREADS, NULL, NULL, use_inflate_threads, 1, true, false },
+    { OPTION_HASH_NAME_INDEX, NULL, NULL, use_hash_name_index, 1, false, false },
+    { OPTION_REGION_THREADS, NULL, NULL, use_region_threads, 1, true, false }
 };
 
 const char* OptHelpParam[] =
@@ -496,7 +530,10 @@ const char* OptHelpParam[] =
     NULL,				/* allow hard clipping */
     NULL,				/* allow multimapping */
     NULL,				/* allow secondary */
-    NULL				/* defer secondary */
+    NULL,				/* defer secondary */
+    "count",			/* inflate threads */
+    NULL,				/* hash name index */
+    "count"				/* region threads */
 };
 
 rc_t UsageSummary (char const * progname)
@@ -922,6 +959,28 @@ static rc_t main_1(int argc, char *argv[], bool const continuing, unsigned const
             G.maxErrCount = strtoul(value, &dummy, 0);
         }
         
+        rc = ArgsOptionCount (args, OPTION_INFLATE_THREADS, &pcount);
+        if (rc)
+            break;
+        if (pcount == 1)
+        {
+            rc = ArgsOptionValue (args, OPTION_INFLATE_THREADS, 0, (const void **)&value);
+            if (rc)
+                break;
+            G.inflateThreads = strtoul(value, &dummy, 0);
+        }
+        
+        rc = ArgsOptionCount (args, OPTION_REGION_THREADS, &pcount);
+        if (rc)
+            break;
+        if (pcount == 1)
+        {
+            rc = ArgsOptionValue (args, OPTION_REGION_THREADS, 0, (const void **)&value);
+            if (rc)
+                break;
+            G.regionThreads = strtoul(value, &dummy, 0);
+        }
+        
         rc = ArgsOptionCount (args, OPTION_MIN_MATCH, &pcount);
         if (rc)
             break;
@@ -983,6 +1042,11 @@ static rc_t main_1(int argc, char *argv[], bool const continuing, unsigned const
             break;
         G.deferSecondary |= (pcount > 0);
         
+        rc = ArgsOptionCount (args, OPTION_HASH_NAME_INDEX, &pcount);
+        if (rc)
+            break;
+        G.hashNameIndex |= (pcount > 0);
+        
         rc = ArgsOptionCount (args, OPTION_NOMATCH_LOG, &pcount);
         if (rc)
             break;
@@ -1101,10 +1165,10 @@ static rc_t main_1(int argc, char *argv[], bool const continuing, unsigned const
 
     if (rc) {
         (void)PLOGERR(klogErr, (klogErr, rc, "load failed",
-                "severity=total,status=failure,accession=%s,errors=%u", G.outname, G.errCount));
+                "severity=total,status=failure,accession=%s,errors=%u", G.outname, (unsigned)atomic32_read(&G.errCount)));
     } else {
         (void)PLOGMSG(klogInfo, (klogInfo, "loaded",
-                "severity=total,status=success,accession=%s,errors=%u", G.outname, G.errCount));
+                "severity=total,status=success,accession=%s,errors=%u", G.outname, (unsigned)atomic32_read(&G.errCount)));
     }
     ArgsWhack(args);
     return rc;
@@ -1248,6 +1312,7 @@ rc_t CC KMain(int argc, char *argv[])
     G.cache_size = ((size_t)16) << 30;
     G.maxErrCount = 1000;
     G.minMatchCount = 10;
+    G.inflateThreads = 1;
     
     set_pid();
 
@@ -65,9 +65,12 @@ struct SAMFile {
     rc_t last;
 };
 
+typedef struct BGZFilePar BGZFilePar;
+
 struct BGZFile {
     BufferedFile file;
     z_stream zs;
+    BGZFilePar *par;    /* not NULL if the blocks are inflated by a pool of threads */
 };
 
 struct BAM_File {
@@ -86,9 +89,11 @@ struct BAM_File {
     void *headerData1;          /* gets used for refSeq and readGroup */
     void *headerData2;          /* gets used for refSeq */
     BAM_Alignment *nocopy;      /* used to hold current record for BAM_FileRead2 */
+    BAM_File const *master;     /* if not NULL, this reads a range of master; detached records are given to master */
 
     uint64_t fpos_cur;
     uint64_t deferPos;
+    uint64_t endPos;            /* if not 0, virtual offset at which reading stops */
     
     unsigned refSeqs;
     unsigned readGroups;
@@ -36,6 +36,9 @@
 #include <klib/text.h>
 #include <klib/refcount.h>
 #include <klib/data-buffer.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
 #include <sysalloc.h>
 
 #include <atomic32.h>
@@ -332,6 +335,18 @@ static void BGZFileWhack(BGZFile *self)
     inflateEnd(&self->zs);
 }
 
+/* pos must be the start of a BGZF block */
+static rc_t BGZFileSetPos(BGZFile *const self, uint64_t const pos)
+{
+    rc_t const rc = BufferedFileSetPos(&self->file, pos);
+    if (rc == 0) {
+        self->zs.avail_in = (uInt)(self->file.bmax - self->file.bpos);
+        self->zs.next_in = (Bytef *)self->file.buf + self->file.bpos;
+        inflateReset(&self->zs);
+    }
+    return rc;
+}
+
 static rc_t BGZFileInit(BGZFile *const self, RawFile_vt *const vt)
 {
     int i;
@@ -340,7 +355,7 @@ static rc_t BGZFileInit(BGZFile *const self, RawFile_vt *const vt)
         (uint64_t (*)(void const *))BufferedFileGetPos,
         (float (*)(void const *))BufferedFileProPos,
         (uint64_t (*)(void const *))BufferedFileGetSize,
-        (rc_t (*)(void *, uint64_t))BufferedFileSetPos,
+        (rc_t (*)(void *, uint64_t))BGZFileSetPos,
         (void (*)(void *))BGZFileWhack
     };
     
@@ -359,6 +374,360 @@ static rc_t BGZFileInit(BGZFile *const self, RawFile_vt *const vt)
     return 0;
 }
 
+/* MARK: BGZFile parallel inflation *** Start *** */
+
+/* Every BGZF block is a complete gzip member of at most 64k, holding at most
+ * 64k of uncompressed data. The blocks are read in file order under the lock,
+ * inflated out of order by a pool of threads into a ring of slots, and handed
+ * to BAM_FileReadn in file order again.
+ */
+
+#define BGZF_SLOTS_PER_THREAD 4
+
+typedef struct BGZFBlock {
+    uint64_t fpos_end;      /* position in file of the next block */
+    unsigned csize;         /* compressed size */
+    unsigned usize;         /* uncompressed size */
+    rc_t rc;
+    bool ready;
+    uint8_t cdata[ZLIB_BLOCK_SIZE];
+    zlib_block_t udata;
+} BGZFBlock;
+
+struct BGZFilePar {
+    BufferedFile *file;
+    KLock *lock;
+    KCondition *slotFree;   /* the reader has taken a block */
+    KCondition *blockReady; /* an inflater has finished a block */
+    KThread **thread;
+    BGZFBlock *block;
+    uint64_t fpos_cur;      /* position in file of the block after the one last taken */
+    uint64_t nextRead;      /* sequence number of the next block to read from the file */
+    uint64_t nextOut;       /* sequence number of the next block to give to the reader */
+    rc_t rc;
+    unsigned numThreads;
+    unsigned numSlots;
+    bool eof;               /* no more blocks will be read from the file */
+    bool quit;
+};
+
+static rc_t BufferedFileReadExactly(BufferedFile *const self, unsigned const len, uint8_t dst[], unsigned *const nread)
+{
+    unsigned cur = 0;
+
+    while (cur < len) {
+        size_t n;
+
+        if (self->bpos == self->bmax) {
+            rc_t const rc = BufferedFileRead(self);
+            if (rc)
+                return rc;
+            if (self->bmax == 0)
+                break;
+        }
+        n = self->bmax - self->bpos;
+        if (n > len - cur)
+            n = len - cur;
+        memmove(&dst[cur], &((uint8_t const *)self->buf)[self->bpos], n);
+        self->bpos += n;
+        cur += n;
+    }
+    *nread = cur;
+    return 0;
+}
+
+/* reads one complete BGZF block; *csize == 0 at end of file */
+static rc_t BGZFileReadBlock(BufferedFile *const file, uint8_t block[ZLIB_BLOCK_SIZE], unsigned *const csize)
+{
+    unsigned nread = 0;
+    unsigned xlen;
+    unsigned bsize = 0;
+    unsigned i;
+    rc_t rc;
+
+    *csize = 0;
+    rc = BufferedFileReadExactly(file, 12, block, &nread);
+    if (rc || nread == 0)
+        return rc;
+    if (nread < 12)
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcTooShort);
+    if (block[0] != 31 || block[1] != 139 || block[2] != 8 || (block[3] & 4) == 0)
+        return RC(rcAlign, rcFile, rcReading, rcFormat, rcInvalid); /* not BGZF */
+
+    xlen = LE2HUI16(&block[10]);
+    if (12 + xlen + 8 > ZLIB_BLOCK_SIZE)
+        return RC(rcAlign, rcFile, rcReading, rcFormat, rcInvalid);
+    rc = BufferedFileReadExactly(file, xlen, &block[12], &nread);
+    if (rc)
+        return rc;
+    if (nread < xlen)
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcTooShort);
+
+    for (i = 0; i + 4 <= xlen; ) {
+        uint8_t const si1 = block[12 + i + 0];
+        uint8_t const si2 = block[12 + i + 1];
+        unsigned const slen = LE2HUI16(&block[12 + i + 2]);
+
+        if (si1 == 'B' && si2 == 'C' && slen == 2 && i + 6 <= xlen) {
+            bsize = 1 + LE2HUI16(&block[12 + i + 4]);
+            break;
+        }
+        i += slen + 4;
+    }
+    if (bsize < 12 + xlen + 8) {
+        DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("BGZF Header extra field BC not found\n"));
+        return RC(rcAlign, rcFile, rcReading, rcFormat, rcInvalid); /* not BGZF */
+    }
+    rc = BufferedFileReadExactly(file, bsize - 12 - xlen, &block[12 + xlen], &nread);
+    if (rc)
+        return rc;
+    if (nread < bsize - 12 - xlen)
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcTooShort);
+
+    *csize = bsize;
+    return 0;
+}
+
+/* zs must be initialized for raw deflate data, the gzip header is skipped here */
+static rc_t BGZFBlockInflate(BGZFBlock *const self, z_stream *const zs)
+{
+    unsigned const hlen = 12 + LE2HUI16(&self->cdata[10]);
+    uint8_t const *const trailer = &self->cdata[self->csize - 8];
+    uint32_t const crc = LE2HUI32(&trailer[0]);
+    uint32_t const isize = LE2HUI32(&trailer[4]);
+    int zr;
+
+    zs->next_in = (Bytef *)&self->cdata[hlen];
+    zs->avail_in = (uInt)(self->csize - hlen - 8);
+    zs->next_out = (Bytef *)self->udata;
+    zs->avail_out = sizeof(self->udata);
+
+    zr = inflate(zs, Z_FINISH);
+    self->usize = (unsigned)(sizeof(self->udata) - zs->avail_out);
+    inflateReset(zs);
+
+    if (zr != Z_STREAM_END) {
+        DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("Unexpected Zlib result %i: %s\n", zr, zs->msg ? zs->msg : "unknown"));
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcCorrupt);
+    }
+    if (self->usize != isize || crc32(crc32(0L, Z_NULL, 0), self->udata, self->usize) != crc) {
+        DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("BGZF block CRC or size mismatch\n"));
+        return RC(rcAlign, rcFile, rcReading, rcFile, rcCorrupt);
+    }
+    return 0;
+}
+
+static rc_t CC BGZFileParThreadMain(KThread const *const th, void *const vp)
+{
+    BGZFilePar *const self = vp;
+    z_stream zs;
+    bool zsOK;
+    rc_t rc = 0;
+
+    memset(&zs, 0, sizeof(zs));
+    zsOK = inflateInit2(&zs, -MAX_WBITS) == Z_OK; /* raw deflate, the header is skipped */
+
+    KLockAcquire(self->lock);
+    if (!zsOK) {
+        rc = RC(rcAlign, rcFile, rcConstructing, rcMemory, rcExhausted);
+        self->rc = rc;
+        self->eof = true;
+    }
+    while (!self->eof && !self->quit) {
+        BGZFBlock *block;
+
+        if (self->nextRead >= self->nextOut + self->numSlots) {
+            /* all slots are in use, wait for the reader */
+            KConditionWait(self->slotFree, self->lock);
+            continue;
+        }
+        block = &self->block[self->nextRead % self->numSlots];
+        block->ready = false;
+        block->rc = BGZFileReadBlock(self->file, block->cdata, &block->csize);
+        block->fpos_end = BufferedFileGetPos(self->file);
+        if (block->rc == 0 && block->csize == 0) {
+            self->eof = true;
+            break;
+        }
+        ++self->nextRead;
+        if (block->rc) {
+            /* the reader gets the error when it gets to this block */
+            self->eof = true;
+            block->ready = true;
+            break;
+        }
+        KLockUnlock(self->lock);
+
+        rc = BGZFBlockInflate(block, &zs);
+
+        KLockAcquire(self->lock);
+        block->rc = rc;
+        rc = 0;
+        block->ready = true;
+        KConditionBroadcast(self->blockReady);
+    }
+    /* wake up everyone waiting: the reader and the other inflaters */
+    KConditionBroadcast(self->blockReady);
+    KConditionBroadcast(self->slotFree);
+    KLockUnlock(self->lock);
+
+    if (zsOK)
+        inflateEnd(&zs);
+    return rc;
+}
+
+static rc_t BGZFileParRead(BGZFile *const self, zlib_block_t dst, unsigned *const pNumRead)
+{
+    BGZFilePar *const par = self->par;
+    BGZFBlock *block = NULL;
+    rc_t rc = 0;
+
+    *pNumRead = 0;
+    KLockAcquire(par->lock);
+    for ( ; ; ) {
+        if (par->nextOut < par->nextRead) {
+            block = &par->block[par->nextOut % par->numSlots];
+            if (block->ready)
+                break;
+        }
+        else if (par->eof) {
+            block = NULL;
+            break;
+        }
+        KConditionWait(par->blockReady, par->lock);
+    }
+    KLockUnlock(par->lock);
+
+    if (block == NULL)
+        return par->rc ? par->rc : RC(rcAlign, rcFile, rcReading, rcData, rcInsufficient);
+
+    /* the slot is not reused before nextOut is advanced */
+    rc = block->rc;
+    if (rc == 0) {
+        memmove(dst, block->udata, block->usize);
+        *pNumRead = block->usize;
+    }
+
+    KLockAcquire(par->lock);
+    par->fpos_cur = block->fpos_end;
+    ++par->nextOut;
+    KConditionSignal(par->slotFree);
+    KLockUnlock(par->lock);
+
+    return rc;
+}
+
+static uint64_t BGZFileParGetPos(BGZFile const *const self)
+{
+    return self->par->fpos_cur;
+}
+
+static float BGZFileParProPos(BGZFile const *const self)
+{
+    return self->file.fmax == 0 ? -1.0 : (self->par->fpos_cur / (double)self->file.fmax);
+}
+
+static uint64_t BGZFileParGetSize(BGZFile const *const self)
+{
+    return BufferedFileGetSize(&self->file);
+}
+
+static rc_t BGZFileParSetPos(BGZFile *const self, uint64_t const pos)
+{
+    return RC(rcAlign, rcFile, rcPositioning, rcFunction, rcUnsupported);
+}
+
+static void BGZFileParWhack(BGZFile *const self)
+{
+    BGZFilePar *const par = self->par;
+
+    if (par) {
+        unsigned i;
+
+        KLockAcquire(par->lock);
+        par->quit = true;
+        KConditionBroadcast(par->slotFree);
+        KConditionBroadcast(par->blockReady);
+        KLockUnlock(par->lock);
+
+        for (i = 0; i < par->numThreads; ++i) {
+            rc_t status = 0;
+            KThreadWait(par->thread[i], &status);
+            KThreadRelease(par->thread[i]);
+        }
+        KConditionRelease(par->blockReady);
+        KConditionRelease(par->slotFree);
+        KLockRelease(par->lock);
+        free(par->thread);
+        free(par->block);
+        free(par);
+        self->par = NULL;
+    }
+    BGZFileWhack(self);
+}
+
+/* the serial reader always stops at the end of a block,
+ * so the pool starts reading at the current position of the buffered file */
+static rc_t BGZFileParInit(BGZFile *const self, RawFile_vt *const vt, unsigned const numThreads)
+{
+    static RawFile_vt const my_vt = {
+        (rc_t (*)(void *, zlib_block_t, unsigned *))BGZFileParRead,
+        (uint64_t (*)(void const *))BGZFileParGetPos,
+        (float (*)(void const *))BGZFileParProPos,
+        (uint64_t (*)(void const *))BGZFileParGetSize,
+        (rc_t (*)(void *, uint64_t))BGZFileParSetPos,
+        (void (*)(void *))BGZFileParWhack
+    };
+    BGZFilePar *const par = calloc(1, sizeof(*par));
+    rc_t rc;
+
+    if (par == NULL)
+        return RC(rcAlign, rcFile, rcConstructing, rcMemory, rcExhausted);
+
+    par->file = &self->file;
+    par->fpos_cur = BufferedFileGetPos(&self->file);
+    par->numSlots = numThreads * BGZF_SLOTS_PER_THREAD;
+    par->block = calloc(par->numSlots, sizeof(par->block[0]));
+    par->thread = calloc(numThreads, sizeof(par->thread[0]));
+    if (par->block == NULL || par->thread == NULL) {
+        free(par->block);
+        free(par->thread);
+        free(par);
+        return RC(rcAlign, rcFile, rcConstructing, rcMemory, rcExhausted);
+    }
+    rc = KLockMake(&par->lock);
+    if (rc == 0)
+        rc = KConditionMake(&par->slotFree);
+    if (rc == 0)
+        rc = KConditionMake(&par->blockReady);
+
+    /* nothing reads the file until the vt is switched, the threads can start reading right away */
+    while (rc == 0 && par->numThreads < numThreads) {
+        rc = KThreadMake(&par->thread[par->numThreads], BGZFileParThreadMain, par);
+        if (rc == 0)
+            ++par->numThreads;
+    }
+    if (rc) {
+        DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("Failed to start BGZF inflater threads: %R\n", rc));
+        if (par->numThreads == 0) {
+            /* stay with the serial reader */
+            KConditionRelease(par->blockReady);
+            KConditionRelease(par->slotFree);
+            KLockRelease(par->lock);
+            free(par->thread);
+            free(par->block);
+            free(par);
+            return rc;
+        }
+        /* keep going with the threads that did start */
+        rc = 0;
+    }
+    self->par = par;
+    *vt = my_vt;
+    DBGMSG(DBG_ALIGN, DBG_FLAG(DBG_ALIGN_BGZF), ("Inflating BGZF blocks with %u threads\n", par->numThreads));
+    return 0;
+}
+
 static const char cigarChars[] = {
     ct_Match,
     ct_Insert,
@@ -1519,6 +1888,260 @@ rc_t BAM_FileGetPosition(const BAM_File *self, BAM_FilePosition *pos) {
     return 0;
 }
 
+rc_t BAM_FileStartInflaters(const BAM_File *cself, unsigned numThreads)
+{
+    BAM_File *const self = (BAM_File *)cself;
+
+    if (self == NULL)
+        return RC(rcAlign, rcFile, rcConstructing, rcSelf, rcNull);
+    if (self->isSAM || numThreads < 2 || self->file.bam.par != NULL)
+        return 0;
+    return BGZFileParInit(&self->file.bam, &self->vt, numThreads);
+}
+
+/* MARK: BAM File partitioning by index *** Start *** */
+
+/* the position of the next record, where a position at the end of a block
+ * is the same as the position at the start of the next block
+ */
+static BAM_FilePosition BAM_FileCurPos(BAM_File const *const self)
+{
+    if (self->bufSize != 0 && self->bufCurrent >= self->bufSize)
+        return self->vt.FileGetPos(&self->file) << 16;
+    return (self->fpos_cur << 16) | self->bufCurrent;
+}
+
+static rc_t BAM_FileSetPosition(BAM_File *const self, BAM_FilePosition const pos)
+{
+    uint64_t const fpos = pos >> 16;
+    unsigned const bpos = (unsigned)(pos & 0xFFFF);
+    rc_t rc = self->vt.FileSetPos(&self->file, fpos);
+
+    if (rc) return rc;
+
+    self->fpos_cur = fpos;
+    self->bufCurrent = 0;
+    self->bufSize = 0;
+    self->eof = false;
+
+    rc = BAM_FileFillBuffer(self);
+    if (rc) {
+        if ((int)GetRCObject(rc) == rcData && GetRCState(rc) == rcInsufficient) {
+            /* positioned at the end of the file */
+            self->bufSize = 0;
+            self->eof = true;
+            return 0;
+        }
+        return rc;
+    }
+    if (bpos > self->bufSize)
+        return RC(rcAlign, rcFile, rcPositioning, rcOffset, rcInvalid);
+    if (bpos == self->bufSize) {
+        self->fpos_cur = self->vt.FileGetPos(&self->file);
+        self->bufSize = 0;
+    }
+    else
+        self->bufCurrent = bpos;
+    return 0;
+}
+
+static int64_t comp_FilePosition(const void *A, const void *B, void *ignored)
+{
+    BAM_FilePosition const a = *(BAM_FilePosition const *)A;
+    BAM_FilePosition const b = *(BAM_FilePosition const *)B;
+
+    return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static rc_t AppendFilePosition(KDataBuffer *const buf, BAM_FilePosition const pos)
+{
+    uint64_t const n = buf->elem_count;
+    rc_t const rc = KDataBufferResize(buf, n + 1);
+
+    if (rc == 0)
+        ((BAM_FilePosition *)buf->base)[n] = pos;
+    return rc;
+}
+
+/* every position in the index is the start of a record:
+ * the first chunk of each reference and every entry of its linear index
+ */
+static rc_t CollectIndexPositions(KDataBuffer *const rslt, uint8_t const data[], size_t const size)
+{
+#define NEED(N) do { if (size - cp < (N)) return RC(rcAlign, rcIndex, rcReading, rcData, rcInsufficient); } while (0)
+    size_t cp = 0;
+    int32_t nrefs;
+    int32_t r;
+    rc_t rc = 0;
+
+    NEED(8);
+    if (memcmp(data, "BAI\1", 4) != 0)
+        return RC(rcAlign, rcIndex, rcReading, rcFormat, rcInvalid);
+    nrefs = LE2HI32(data + 4);
+    cp = 8;
+    for (r = 0; r < nrefs && rc == 0; ++r) {
+        BAM_FilePosition first = 0;
+        BAM_FilePosition last = 0;
+        int32_t nbins;
+        int32_t nintv;
+        int32_t i;
+
+        NEED(4);
+        nbins = LE2HI32(data + cp); cp += 4;
+        for (i = 0; i < nbins; ++i) {
+            uint32_t bin;
+            int32_t nchunks;
+            int32_t j;
+
+            NEED(8);
+            bin = LE2HUI32(data + cp);
+            nchunks = LE2HI32(data + cp + 4);
+            cp += 8;
+            if (nchunks < 0)
+                return RC(rcAlign, rcIndex, rcReading, rcData, rcInvalid);
+            NEED(16 * (size_t)nchunks);
+            if (bin != 37450) { /* the pseudo-bin holds statistics */
+                for (j = 0; j < nchunks; ++j) {
+                    BAM_FilePosition const beg = LE2HUI64(data + cp + 16 * j);
+                    if (first == 0 || beg < first)
+                        first = beg;
+                }
+            }
+            cp += 16 * (size_t)nchunks;
+        }
+        if (first != 0)
+            rc = AppendFilePosition(rslt, first);
+
+        NEED(4);
+        nintv = LE2HI32(data + cp); cp += 4;
+        if (nintv < 0)
+            return RC(rcAlign, rcIndex, rcReading, rcData, rcInvalid);
+        NEED(8 * (size_t)nintv);
+        for (i = 0; i < nintv && rc == 0; ++i) {
+            BAM_FilePosition const ioffset = LE2HUI64(data + cp + 8 * i);
+            if (ioffset != 0 && ioffset != last)
+                rc = AppendFilePosition(rslt, last = ioffset);
+        }
+        cp += 8 * (size_t)nintv;
+    }
+    return rc;
+#undef NEED
+}
+
+static rc_t LoadIndexFile(KDataBuffer *const rslt, char const path[])
+{
+    KDirectory *dir;
+    KFile const *kf = NULL;
+    uint64_t fsize = 0;
+    rc_t rc = KDirectoryNativeDir(&dir);
+
+    if (rc) return rc;
+    rc = KDirectoryOpenFileRead(dir, &kf, "%s", path);
+    KDirectoryRelease(dir);
+    if (rc) return rc;
+
+    rc = KFileSize(kf, &fsize);
+    if (rc == 0)
+        rc = KDataBufferMakeBytes(rslt, fsize);
+    if (rc == 0) {
+        size_t nread = 0;
+
+        rc = KFileReadAll(kf, 0, rslt->base, fsize, &nread);
+        if (rc == 0 && nread != fsize)
+            rc = RC(rcAlign, rcIndex, rcReading, rcFile, rcTooShort);
+        if (rc)
+            KDataBufferWhack(rslt);
+    }
+    KFileRelease(kf);
+    return rc;
+}
+
+rc_t BAM_FileMakePartitions(const BAM_File *self, char const indexPath[], unsigned maxParts,
+                            BAM_FilePosition **rslt, unsigned *count)
+{
+    KDataBuffer index;
+    KDataBuffer positions;
+    rc_t rc;
+
+    if (self == NULL || rslt == NULL || count == NULL)
+        return RC(rcAlign, rcFile, rcReading, rcParam, rcNull);
+    *rslt = NULL;
+    *count = 0;
+    if (self->isSAM || self->file.bam.par != NULL || maxParts < 1)
+        return RC(rcAlign, rcFile, rcReading, rcFunction, rcUnsupported);
+
+    rc = LoadIndexFile(&index, indexPath);
+    if (rc) return rc;
+
+    rc = KDataBufferMake(&positions, 8 * sizeof(BAM_FilePosition), 0);
+    if (rc == 0) {
+        rc = CollectIndexPositions(&positions, index.base, (size_t)index.elem_count);
+        if (rc == 0) {
+            BAM_FilePosition *const pos = positions.base;
+            unsigned const npos = (unsigned)positions.elem_count;
+            BAM_FilePosition *const starts = malloc(maxParts * sizeof(starts[0]));
+
+            if (starts != NULL) {
+                uint64_t const first = BAM_FileCurPos(self);
+                uint64_t const fsize = self->vt.FileGetSize(&self->file);
+                uint64_t const target = fsize > (first >> 16) ? (fsize - (first >> 16)) / maxParts : 0;
+                unsigned n = 1;
+                unsigned i;
+
+                /* the partitions are cut at records that are roughly the same number of compressed bytes apart */
+                ksort(pos, npos, sizeof(pos[0]), comp_FilePosition, NULL);
+                starts[0] = first;
+                for (i = 0; i < npos && n < maxParts; ++i) {
+                    if (pos[i] > starts[n - 1] && (pos[i] >> 16) - (starts[n - 1] >> 16) >= target)
+                        starts[n++] = pos[i];
+                }
+                *rslt = starts;
+                *count = n;
+            }
+            else
+                rc = RC(rcAlign, rcFile, rcReading, rcMemory, rcExhausted);
+        }
+        KDataBufferWhack(&positions);
+    }
+    KDataBufferWhack(&index);
+    return rc;
+}
+
+rc_t BAM_FileMakeRange(const BAM_File *master, BAM_FilePosition beg, BAM_FilePosition end, const BAM_File **rslt)
+{
+    BAM_File *self = NULL;
+    void *nocopy;
+    rc_t rc;
+
+    if (master == NULL || rslt == NULL)
+        return RC(rcAlign, rcFile, rcConstructing, rcParam, rcNull);
+    *rslt = NULL;
+    if (master->isSAM)
+        return RC(rcAlign, rcFile, rcConstructing, rcFunction, rcUnsupported);
+
+    nocopy = malloc(64u * 1024u);
+    if (nocopy == NULL)
+        return RC(rcAlign, rcFile, rcConstructing, rcMemory, rcExhausted);
+
+    rc = BAM_FileMakeWithKFileAndHeader(&self, master->file.bam.file.kf, master->header);
+    if (rc) {
+        free(nocopy);
+        return rc;
+    }
+    self->nocopy = nocopy;
+    self->master = master;
+    rc = BAM_FileSetPosition(self, beg);
+    if (rc) {
+        BAM_FileRelease(self);
+        return rc;
+    }
+    self->endPos = end;
+    *rslt = self;
+    return 0;
+}
+
+/* MARK: BAM File partitioning by index *** End *** */
+
 static void BAM_FileAdvance(BAM_File *const self, unsigned distance)
 {
     self->bufCurrent += distance;
@@ -2056,6 +2679,11 @@ static rc_t read2(BAM_File *const self, BAM_Alignment **const rhs)
     
     if (self->bufCurrent >= self->bufSize && self->eof)
         return SILENT_RC(rcAlign, rcFile, rcReading, rcRow, rcNotFound);
+
+    if (self->endPos != 0 && BAM_FileCurPos(self) >= self->endPos) {
+        self->eof = true;
+        return SILENT_RC(rcAlign, rcFile, rcReading, rcRow, rcNotFound);
+    }
     
     if (self->isSAM) {
         rc = BAM_FileReadSAM(self, rhs);
@@ -2290,8 +2918,12 @@ BAM_Alignment *BAM_AlignmentDetach(const BAM_Alignment *self)
         if (self == file->nocopy || BAM_FileIsInBuffer(file, self->data)) {
             BAM_Alignment *copy = BAM_AlignmentCopy(self);
             BAM_AlignmentRelease(self);
+            if (copy && file->master)
+                copy->parent = (BAM_File *)file->master;
             return copy;
         }
+        if (file->master)
+            ((BAM_Alignment *)self)->parent = (BAM_File *)file->master;
     }
     return (BAM_Alignment *)self;
 }
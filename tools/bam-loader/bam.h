@@ -520,6 +520,41 @@ rc_t BAM_FileMake(const BAM_File **result,
                   char const headerText[],
                   char const path[], ... );
 
+/* StartInflaters
+ *  inflate the remaining BGZF blocks with a pool of threads
+ *  the blocks are inflated out of order and handed to the reader in order
+ *  call before reading the first record; has no effect on SAM files
+ *  seeking is not possible afterwards
+ *
+ *  "numThreads" [ IN ] - number of inflater threads, < 2 means no pool
+ */
+rc_t BAM_FileStartInflaters ( const BAM_File *self, unsigned numThreads );
+
+/* MakePartitions
+ *  cut a coordinate-sorted BAM file into at most maxParts ranges of about
+ *  the same compressed size, using the positions found in its BAI index
+ *  range i starts at (*result)[i] and ends where range i + 1 starts;
+ *  the last range ends at the end of the file
+ *  call before reading the first record and before StartInflaters
+ *
+ *  "indexPath" [ IN ] - path of the BAI file
+ *
+ *  "result" [ OUT ] - the start positions, free with free()
+ *
+ *  "count" [ OUT ] - number of ranges, >= 1
+ */
+rc_t BAM_FileMakePartitions ( const BAM_File *self, char const indexPath[], unsigned maxParts,
+                              BAM_FilePosition **result, unsigned *count );
+
+/* MakeRange
+ *  open another reader of the same file, positioned at beg, that reports
+ *  end of file upon reaching end (0 means the real end of the file)
+ *  detached records read from it belong to master, so the range may be
+ *  released before its records are
+ */
+rc_t BAM_FileMakeRange ( const BAM_File *master, BAM_FilePosition beg, BAM_FilePosition end,
+                         const BAM_File **result );
+
 /* AddRef
  * Release
  */
@@ -65,6 +65,8 @@
 
 #include <kproc/queue.h>
 #include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
 #include <kproc/timeout.h>
 #include <os-native.h>
 
@@ -90,6 +92,7 @@
 #include "alignment-writer.h"
 #include "mem-bank.h"
 #include "low-match-count.h"
+#include "name-index.h"
 
 #define NUM_ID_SPACES (256u)
 
@@ -147,6 +150,7 @@ typedef struct FragmentInfo {
 
 typedef struct KeyToID {
     KBTree *key2id[NUM_ID_SPACES];
+    NameIndex *nameIndex; /* if not NULL, used instead of key2id */
     char *key2id_names;
 
     uint32_t idCount[NUM_ID_SPACES];
@@ -373,6 +377,19 @@ static rc_t OpenKBTree(KBTree **const rslt, unsigned n, unsigned max)
     return rc;
 }
 
+static rc_t KeyToIDEntry(KeyToID *const ctx, unsigned const f, uint64_t *const id, bool *const wasInserted, char const name[], size_t const namelen)
+{
+    if (ctx->nameIndex) {
+        uint32_t id32 = 0;
+        rc_t const rc = NameIndexEntry(ctx->nameIndex, f, name, namelen, &id32, wasInserted);
+
+        *id = id32;
+        return rc;
+    }
+    *id = ctx->idCount[f];
+    return KBTreeEntry(ctx->key2id[f], id, wasInserted, name, namelen);
+}
+
 static rc_t GetKeyIDOld(KeyToID *const ctx, uint64_t *const rslt, bool *const wasInserted, char const key[], char const name[], unsigned const namelen)
 {
     unsigned const keylen = strlen(key);
@@ -380,14 +397,15 @@ static rc_t GetKeyIDOld(KeyToID *const ctx, uint64_t *const rslt, bool *const wa
     uint64_t tmpKey;
 
     if (ctx->key2id_count == 0) {
-        rc = OpenKBTree(&ctx->key2id[0], 1, 1);
-        if (rc) return rc;
+        if (ctx->nameIndex == NULL) {
+            rc = OpenKBTree(&ctx->key2id[0], 1, 1);
+            if (rc) return rc;
+        }
         ctx->key2id_count = 1;
     }
     if (memcmp(key, name, keylen) == 0) {
         /* qname starts with read group; no append */
-        tmpKey = ctx->idCount[0];
-        rc = KBTreeEntry(ctx->key2id[0], &tmpKey, wasInserted, name, namelen);
+        rc = KeyToIDEntry(ctx, 0, &tmpKey, wasInserted, name, namelen);
     }
     else {
         char sbuf[4096];
@@ -404,8 +422,7 @@ static rc_t GetKeyIDOld(KeyToID *const ctx, uint64_t *const rslt, bool *const wa
         }
         rc = string_printf(buf, bsize, &actsize, "%s\t%.*s", key, (int)namelen, name);
 
-        tmpKey = ctx->idCount[0];
-        rc = KBTreeEntry(ctx->key2id[0], &tmpKey, wasInserted, buf, actsize);
+        rc = KeyToIDEntry(ctx, 0, &tmpKey, wasInserted, buf, actsize);
         if (hbuf)
             free(hbuf);
     }
@@ -571,8 +588,8 @@ rc_t GetKeyID(KeyToID *const ctx,
         }
         if (ctx->key2id_count < ctx->key2id_max) {
             unsigned const name_max = ctx->key2id_name_max + keylen + 1;
-            KBTree *tree;
-            rc_t rc = OpenKBTree(&tree, ctx->key2id_count + 1, 1); /* ctx->key2id_max); */
+            KBTree *tree = NULL;
+            rc_t rc = ctx->nameIndex ? 0 : OpenKBTree(&tree, ctx->key2id_count + 1, 1); /* ctx->key2id_max); */
 
             if (rc) return rc;
 
@@ -614,8 +631,7 @@ rc_t GetKeyID(KeyToID *const ctx,
                 ctx->key2id_hash[h] = (((ctx->key2id_hash[h] & ~(0xFFu)) | f) << 8) | 3;
             }
         GET_ID:
-            tmpKey = ctx->idCount[f];
-            rc = KBTreeEntry(ctx->key2id[f], &tmpKey, wasInserted, name, namelen);
+            rc = KeyToIDEntry(ctx, f, &tmpKey, wasInserted, name, namelen);
             if (rc == 0) {
                 *rslt = (((uint64_t)f) << 32) | tmpKey;
                 if (*wasInserted)
@@ -677,6 +693,8 @@ static rc_t SetupContext(context_t *ctx, unsigned numfiles)
             rc = OpenMMapFile(ctx, dir);
         if (rc == 0)
             rc = MemBankMake(&ctx->frags, dir, G.pid, fragSize);
+        if (rc == 0 && G.hashNameIndex && ctx->keyToID.nameIndex == NULL)
+            rc = NameIndexMake(&ctx->keyToID.nameIndex, dir, G.pid, NUM_ID_SPACES);
         KDirectoryRelease(dir);
     }
     else if (G.mode == mode_Remap) {
@@ -800,6 +818,77 @@ static KFile *MakeDeferralFile() {
     return NULL;
 }
 
+/* MARK: reading an indexed BAM file in ranges */
+
+typedef struct BAMRange {
+    BAM_File const *file;
+    BAM_Alignment **rec;    /* parsed records of the range, in file order */
+    size_t numRecs;         /* appended by the reader */
+    size_t maxRecs;
+    size_t merged;          /* taken by the merge */
+    BAM_FilePosition beg;
+    BAM_FilePosition end;
+    rc_t rc;                /* set by the reader when it is done with the range */
+    bool done;
+} BAMRange;
+
+static BAMRange *bamRange;
+static unsigned bamRanges;
+static BAM_File const *rangeMaster;
+static float rangeProgress = -1.0;
+static volatile bool rangeAbort;
+
+/* the readers append to the buffer of their range without waiting for the merge,
+ * as long as the records buffered over all ranges stay below rangeBudget;
+ * the range being merged is exempt from the budget, so it can always be completed
+ */
+static KLock *rangeLock;
+static KCondition *rangeFilled;     /* the merge waits on it for records of the current range */
+static KCondition *rangeDrained;    /* the readers wait on it for the budget */
+static size_t rangeBuffered;
+static size_t rangeBudget;
+static unsigned rangeMerging;
+
+static void MakeRanges(BAM_File const *const bam, char const bamFile[])
+{
+    size_t const namelen = strlen(bamFile);
+    BAM_FilePosition *starts = NULL;
+    unsigned count = 0;
+    char indexPath[4096];
+    rc_t rc = string_printf(indexPath, sizeof(indexPath), NULL, "%s.bai", bamFile);
+
+    if (rc == 0)
+        rc = BAM_FileMakePartitions(bam, indexPath, 4 * G.regionThreads, &starts, &count);
+    if (rc != 0 && namelen > 4 && strcmp(bamFile + namelen - 4, ".bam") == 0) {
+        rc = string_printf(indexPath, sizeof(indexPath), NULL, "%.*s.bai", (int)(namelen - 4), bamFile);
+        if (rc == 0)
+            rc = BAM_FileMakePartitions(bam, indexPath, 4 * G.regionThreads, &starts, &count);
+    }
+    if (rc) {
+        (void)PLOGERR(klogInfo, (klogInfo, rc, "no usable index for '$(file)'; reading it from start to end", "file=%s", bamFile));
+        return;
+    }
+    if (count > 1) {
+        rangeBudget = G.cache_size / 4096;
+        if (rangeBudget < 65536)
+            rangeBudget = 65536;
+        bamRange = calloc(count, sizeof(bamRange[0]));
+        if (bamRange != NULL) {
+            unsigned i;
+
+            for (i = 0; i < count; ++i) {
+                bamRange[i].beg = starts[i];
+                bamRange[i].end = i + 1 < count ? starts[i + 1] : 0;
+            }
+            bamRanges = count;
+            rangeProgress = 0.0;
+            (void)PLOGMSG(klogInfo, (klogInfo, "reading '$(file)' in $(ranges) ranges with $(threads) threads",
+                                     "file=%s,ranges=%u,threads=%u", bamFile, count, G.regionThreads));
+        }
+    }
+    free(starts);
+}
+
 static rc_t OpenBAM(const BAM_File **bam, VDatabase *db, const char bamFile[])
 {
     rc_t rc = 0;
@@ -812,6 +901,16 @@ static rc_t OpenBAM(const BAM_File **bam, VDatabase *db, const char bamFile[])
         rc = BAM_FileMake(bam, defer, G.headerText, "%s", bamFile);
     }
     KFileRelease(defer); /* it was retained by BAM file */
+    rangeProgress = -1.0;
+    if (rc == 0 && G.regionThreads > 1 && !G.deferSecondary && strcmp(bamFile, "/dev/stdin") != 0)
+        MakeRanges(*bam, bamFile);
+    if (rc == 0 && G.inflateThreads > 1 && bamRanges == 0) {
+        rc = BAM_FileStartInflaters(*bam, G.inflateThreads);
+        if (rc) {
+            BAM_FileRelease(*bam);
+            *bam = NULL;
+        }
+    }
     
     if (rc) {
         (void)PLOGERR(klogErr, (klogErr, rc, "Failed to open '$(file)'", "file=%s", bamFile));
@@ -1017,7 +1116,7 @@ INSDC_SRA_platform_id GetINSDCPlatform(BAM_File const *bam, char const name[]) {
 static
 rc_t CheckLimitAndLogError(void)
 {
-    unsigned const count = ++G.errCount;
+    unsigned const count = (unsigned)atomic32_read_and_add(&G.errCount, 1) + 1;
 
     if (G.maxErrCount > 0 && count > G.maxErrCount) {
         (void)PLOGERR(klogErr, (klogErr, SILENT_RC(rcAlign, rcFile, rcReading, rcError, rcExcessive), "Number of errors $(cnt) exceeds limit of $(max): Exiting", "cnt=%u,max=%u", count, G.maxErrCount));
@@ -1417,6 +1516,30 @@ static rc_t BAM_FileReadDetached(BAM_File const *self, BAM_Alignment **rec)
     return rc;
 }
 
+/* assigns the spot id and hands the record to the main thread */
+static rc_t pushRecord(BAM_Alignment *const rec)
+{
+    static char const dummy[] = "";
+    char const *spotGroup;
+    char const *name;
+    size_t namelen;
+    rc_t rc;
+
+    BAM_AlignmentGetReadName2(rec, &name, &namelen);
+    BAM_AlignmentGetReadGroupName(rec, &spotGroup);
+    rc = GetKeyID(&GlobalContext.keyToID, &rec->keyId, &rec->wasInserted, spotGroup ? spotGroup : dummy, name, namelen);
+    if (rc) return rc;
+
+    for ( ; ; ) {
+        timeout_t tm;
+        TimeoutInit(&tm, 1000);
+        rc = KQueuePush(bamq, rec, &tm);
+        if (rc == 0 || (int)GetRCObject(rc) != rcTimeout)
+            break;
+    }
+    return rc;
+}
+
 static rc_t run_bamread_thread(const KThread *self, void *const file)
 {
     rc_t rc = 0;
@@ -1439,27 +1562,191 @@ static rc_t run_bamread_thread(const KThread *self, void *const file)
         }
         if (rc) break;
 
-        {
-            static char const dummy[] = "";
-            char const *spotGroup;
-            char const *name;
-            size_t namelen;
-
-            BAM_AlignmentGetReadName2(rec, &name, &namelen);
-            BAM_AlignmentGetReadGroupName(rec, &spotGroup);
-            rc = GetKeyID(&GlobalContext.keyToID, &rec->keyId, &rec->wasInserted, spotGroup ? spotGroup : dummy, name, namelen);
-            if (rc) break;
-        }
+        rc = pushRecord(rec);
+    }
+    KQueueSeal(bamq);
+    if (rc) {
+        (void)LOGERR(klogErr, rc, "bamread_thread done");
+    }
+    else {
+        (void)PLOGMSG(klogInfo, (klogInfo, "bamread_thread done; read $(NR) records", "NR=%lu", NR));
+    }
+    return rc;
+}
 
-        for ( ; ; ) {
-            timeout_t tm;
-            TimeoutInit(&tm, 1000);
-            rc = KQueuePush(bamq, rec, &tm);
-            if (rc == 0 || (int)GetRCObject(rc) != rcTimeout)
+/* reads ranges first, first + threads, first + 2 * threads, ... */
+static rc_t run_bamrange_thread(const KThread *self, void *const data)
+{
+    unsigned const threads = G.regionThreads < bamRanges ? G.regionThreads : bamRanges;
+    unsigned i;
+
+    for (i = (unsigned)(size_t)data; i < bamRanges; i += threads) {
+        BAMRange *const range = &bamRange[i];
+        rc_t rc = BAM_FileMakeRange(rangeMaster, range->beg, range->end, &range->file);
+
+        while (rc == 0) {
+            BAM_Alignment *rec = NULL;
+
+            rc = BAM_FileReadDetached(range->file, &rec);
+            if ((int)GetRCObject(rc) == rcRow && (int)GetRCState(rc) == rcEmpty) {
+                rc = CheckLimitAndLogError();
+                continue;
+            }
+            if ((int)GetRCObject(rc) == rcRow && (int)GetRCState(rc) == rcNotFound) {
+                /* end of range */
+                rc = 0;
                 break;
+            }
+            if (rc) break;
+
+            KLockAcquire(rangeLock);
+            while (!rangeAbort && i != rangeMerging && rangeBuffered >= rangeBudget)
+                KConditionWait(rangeDrained, rangeLock);
+            if (rangeAbort)
+                rc = RC(rcExe, rcQueue, rcInserting, rcTransfer, rcCanceled);
+            else if (range->numRecs == range->maxRecs) {
+                size_t const newMax = range->maxRecs ? range->maxRecs * 2 : 4096;
+                void *const tmp = realloc(range->rec, newMax * sizeof(range->rec[0]));
+
+                if (tmp == NULL)
+                    rc = RC(rcExe, rcQueue, rcInserting, rcMemory, rcExhausted);
+                else {
+                    range->rec = tmp;
+                    range->maxRecs = newMax;
+                }
+            }
+            if (rc == 0) {
+                range->rec[range->numRecs++] = rec;
+                ++rangeBuffered;
+                if (i == rangeMerging)
+                    KConditionSignal(rangeFilled);
+            }
+            KLockUnlock(rangeLock);
+            if (rc)
+                BAM_AlignmentRelease(rec);
+        }
+        /* the records belong to rangeMaster, the range can go */
+        BAM_FileRelease(range->file);
+        range->file = NULL;
+        KLockAcquire(rangeLock);
+        range->rc = rc;
+        range->done = true;
+        KConditionSignal(rangeFilled);
+        KLockUnlock(rangeLock);
+        if (rc) return rc;
+    }
+    return 0;
+}
+
+/* the ranges are read concurrently and merged here in file order,
+ * so spot ids are assigned just as if the file was read from start to end
+ */
+static rc_t run_bamrange_merge(const KThread *self, void *const file)
+{
+    unsigned const threads = G.regionThreads < bamRanges ? G.regionThreads : bamRanges;
+    KThread **thread = calloc(threads, sizeof(thread[0]));
+    unsigned started = 0;
+    size_t NR = 0;
+    unsigned i;
+    rc_t rc = thread ? 0 : RC(rcExe, rcThread, rcAllocating, rcMemory, rcExhausted);
+
+    rangeMaster = file;
+    rangeAbort = false;
+    rangeBuffered = 0;
+    rangeMerging = 0;
+    if (rc == 0)
+        rc = KLockMake(&rangeLock);
+    if (rc == 0)
+        rc = KConditionMake(&rangeFilled);
+    if (rc == 0)
+        rc = KConditionMake(&rangeDrained);
+    for ( ; started < threads && rc == 0; ++started)
+        rc = KThreadMake(&thread[started], run_bamrange_thread, (void *)(size_t)started);
+    if (rc)
+        rangeAbort = true; /* some of the ranges would never be read */
+
+    for (i = 0; i < bamRanges && rc == 0; ++i) {
+        BAMRange *const range = &bamRange[i];
+
+        rangeProgress = (float)i / bamRanges;
+        KLockAcquire(rangeLock);
+        rangeMerging = i;
+        KConditionBroadcast(rangeDrained); /* the reader of this range may wait for the budget */
+        while (rc == 0) {
+            BAM_Alignment *batch[256];
+            unsigned n = 0;
+
+            if (range->merged == range->numRecs) {
+                timeout_t tm;
+
+                if (range->done) {
+                    rc = range->rc;
+                    break;
+                }
+                TimeoutInit(&tm, 1000);
+                if (KConditionTimedWait(rangeFilled, rangeLock, &tm) != 0)
+                    rc = Quitting();
+                continue;
+            }
+            while (n < 256 && range->merged < range->numRecs)
+                batch[n++] = range->rec[range->merged++];
+            rangeBuffered -= n;
+            KConditionBroadcast(rangeDrained);
+            KLockUnlock(rangeLock);
+            {
+                unsigned j;
+
+                for (j = 0; j < n; ++j) {
+                    ++NR;
+                    if (rc == 0)
+                        rc = pushRecord(batch[j]);
+                    else
+                        BAM_AlignmentRelease(batch[j]);
+                }
+            }
+            KLockAcquire(rangeLock);
+        }
+        if (rc == 0) {
+            free(range->rec);
+            range->rec = NULL;
+            range->numRecs = range->maxRecs = range->merged = 0;
         }
+        KLockUnlock(rangeLock);
     }
+    if (rc && rangeLock) {
+        KLockAcquire(rangeLock);
+        rangeAbort = true;
+        KConditionBroadcast(rangeDrained);
+        KLockUnlock(rangeLock);
+    }
+    else if (rc)
+        rangeAbort = true;
     KQueueSeal(bamq);
+
+    for (i = 0; i < started; ++i) {
+        rc_t rc2 = 0;
+        KThreadWait(thread[i], &rc2);
+        KThreadRelease(thread[i]);
+    }
+    free(thread);
+    for (i = 0; i < bamRanges; ++i) {
+        BAMRange *const range = &bamRange[i];
+
+        while (range->merged < range->numRecs)
+            BAM_AlignmentRelease(range->rec[range->merged++]);
+        free(range->rec);
+        BAM_FileRelease(range->file);
+    }
+    KConditionRelease(rangeDrained);
+    KConditionRelease(rangeFilled);
+    KLockRelease(rangeLock);
+    rangeDrained = rangeFilled = NULL;
+    rangeLock = NULL;
+    free(bamRange);
+    bamRange = NULL;
+    bamRanges = 0;
+    rangeProgress = 1.0;
+
     if (rc) {
         (void)LOGERR(klogErr, rc, "bamread_thread done");
     }
@@ -1475,7 +1762,7 @@ static BAM_Alignment const *getNextRecord(BAM_File const *const bam, rc_t *const
     if (bamq == NULL) {
         *rc = KQueueMake(&bamq, 4096);
         if (*rc) return NULL;
-        *rc = KThreadMake(&bamread_thread, run_bamread_thread, (void *)bam);
+        *rc = KThreadMake(&bamread_thread, bamRanges > 0 ? run_bamrange_merge : run_bamread_thread, (void *)bam);
         if (*rc) {
             KQueueRelease(bamq);
             bamq = NULL;
@@ -1704,7 +1991,7 @@ static rc_t ProcessBAM(char const bamFile[], context_t *ctx, VDatabase *db,
         }
 
         {
-            float const new_value = BAM_FileGetProportionalPosition(bam) * 100.0;
+            float const new_value = (rangeProgress < 0 ? BAM_FileGetProportionalPosition(bam) : rangeProgress) * 100.0;
             float const delta = new_value - progress;
             if (delta > 1.0) {
                 KLoadProgressbar_Process(ctx->progress[0], delta, false);
@@ -2954,10 +3241,18 @@ static rc_t ArchiveBAM(VDBManager *mgr, VDatabase *db,
     if (!continuing) {
 /*** No longer need memory for key2id ***/
         for (i = 0; i != ctx->keyToID.key2id_count; ++i) {
+            if (ctx->keyToID.key2id[i] == NULL)
+                continue;
             KBTreeDropBacking(ctx->keyToID.key2id[i]);
             KBTreeRelease(ctx->keyToID.key2id[i]);
             ctx->keyToID.key2id[i] = NULL;
         }
+        if (ctx->keyToID.nameIndex) {
+            (void)PLOGMSG(klogInfo, (klogInfo, "name index: $(count) names, $(bytes) bytes", "count=%lu,bytes=%lu",
+                                     NameIndexCount(ctx->keyToID.nameIndex), NameIndexMemoryUsed(ctx->keyToID.nameIndex)));
+            NameIndexRelease(ctx->keyToID.nameIndex);
+            ctx->keyToID.nameIndex = NULL;
+        }
         free(ctx->keyToID.key2id_names);
         ctx->keyToID.key2id_names = NULL;
 /*******************/
@@ -2,7 +2,7 @@
 #include <vector>
 #include <algorithm>
 
-unsigned MateDistanceStats::NthMostFrequent(unsigned N, distance_t result[N]) const
+unsigned MateDistanceStats::NthMostFrequent(unsigned N, distance_t result[]) const
 {
     typedef std::vector<map_t::const_iterator> vector_t;
     unsigned const n = map.size() < N ? map.size() : N;
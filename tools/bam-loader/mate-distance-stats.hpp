@@ -16,5 +16,5 @@ private:
 public:
     MateDistanceStats() {}
     void Count(distance_t const &d) { ++map[d]; }
-    unsigned NthMostFrequent(unsigned N, distance_t result[N]) const;
+    unsigned NthMostFrequent(unsigned N, distance_t result[]) const;
 };
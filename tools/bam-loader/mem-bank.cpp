@@ -163,140 +163,452 @@ rc_t MemBank_Free(MemBank *const self, uint32_t const id)
 
 #else
 
-#include <map>
-#include <set>
+#include <kfs/file.h>
+#include <kfs/directory.h>
+#include <klib/log.h>
+
 #include <vector>
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "mate-distance-stats.hpp"
 
-class pmem
+/* Log-structured fragment store
+ *
+ * Fragments are appended to one of two logs made of large segments: the near
+ * log holds fragments whose mate is expected nearby (same reference), the
+ * far log holds all others. A freed fragment leaves a hole; a segment that is
+ * mostly holes is compacted by copying its live fragments to the end of the
+ * log. If the logs outgrow the memory limit, whole segments are written to a
+ * temporary file, far log first and oldest first, so spilling is sequential.
+ * When the last fragment of a spilled segment is freed, its range of the file
+ * is released: later spills reuse it, and the file is cut back when the range
+ * is at its end. The file holds no more than the spilled segments that still
+ * have live fragments, plus holes too small for a segment.
+ *
+ * How long fragments wait for their mates is counted when they are freed;
+ * compaction moves near fragments that have waited much longer than most
+ * mates take into the far log, so they are the first to be spilled.
+ *
+ * ids are (index + 1) << 1 | far, so they are never 0; the low bit tells in
+ * which log the fragment started, an id stays valid when it is moved
+ */
+class matebuf
 {
-    struct allocation {
-        void *memory;
+    enum { SEGMENT_SIZE = 4u * 1024u * 1024u };
+    enum { NEAR = 0, FAR = 1 };
+
+    struct header {
+        uint32_t index;
+        uint32_t size;
+    };
+    struct entry {
+        uint64_t birth;     /* value of clock when allocated */
+        uint32_t segment;   /* segment index + 1, 0 if not in use */
+        uint32_t offset;    /* of the data in the segment */
+        uint32_t size;
+        uint32_t where;     /* NEAR or FAR */
+    };
+    struct segment {
+        char *memory;       /* NULL once spilled or freed */
+        uint64_t fileOffset;
         size_t size;
-        
-        allocation(int = 0) : memory(0), size(0) {}
+        size_t used;
+        size_t live;
+        bool spilled;
     };
-    typedef std::map<uint32_t, struct allocation> my_map_t;
-    typedef std::set<uint32_t> my_set_t;
-    my_map_t in_use;
-    my_set_t no_use;
-    my_map_t::size_type max_in_use;
-    my_set_t::size_type max_no_use;
-    my_map_t::size_type total_allocs;
-    my_map_t::size_type total_frees;
-    
-    void *get(uint32_t const id) const
-    {
-        my_map_t::const_iterator const i = in_use.find(id);
-        
-        if (i == in_use.end())
-            throw std::runtime_error("attempt to access invalid id");
-        
-        return i->second.memory;
+    struct range {
+        uint64_t offset;
+        uint64_t size;
+    };
+    struct log {
+        std::vector<segment> segments;
+        MateDistanceStats waited;
+        uint64_t freed;
+
+        log() : freed(0) {}
+    };
+    log logs[2];
+    std::vector<entry> entries;
+    std::vector<uint32_t> unused;
+    KDirectory *dir;
+    KFile *file;
+    uint64_t fileSize;
+    uint64_t maxFileSize;
+    uint64_t spilled;       /* bytes written to the file in total */
+    std::vector<range> holes; /* released ranges of the file, by offset */
+    uint64_t clock;
+    size_t limit;           /* 0 means no limit */
+    size_t inMemory;
+    size_t maxInMemory;
+    uint64_t compactions;
+    uint64_t demoted;
+    int pid;
+
+    static unsigned bucket(uint64_t d) {
+        unsigned i = 0;
+        for (++d; d > 1; d >>= 1)
+            ++i;
+        return i;
+    }
+    static uint32_t makeId(unsigned const which, uint32_t const index) {
+        return ((index + 1) << 1) | which;
+    }
+    static uint32_t indexOf(uint32_t const id) {
+        return (id >> 1) - 1;
+    }
+
+    entry &get(uint32_t const id) {
+        uint32_t const index = indexOf(id);
+
+        if (id < 2 || index >= entries.size() || entries[index].segment == 0)
+            throw std::runtime_error("attempt to access invalid or freed id");
+        return entries[index];
+    }
+    entry const &get(uint32_t const id) const {
+        return const_cast<matebuf *>(this)->get(id);
+    }
+
+    /* how long near fragments may wait before they are treated as far */
+    uint64_t horizon() const {
+        MateDistanceStats::distance_t top[8];
+        log const &L = logs[NEAR];
+
+        if (L.freed < 1024)
+            return ~(uint64_t)0;
+        unsigned const n = L.waited.NthMostFrequent(8, top);
+        if (n == 0 || top[n - 1] > 60)
+            return ~(uint64_t)0;
+        return ((uint64_t)4) << top[n - 1];
+    }
+
+    void newSegment(log &L, size_t const need) {
+        segment seg;
+
+        seg.size = need > SEGMENT_SIZE ? need : SEGMENT_SIZE;
+        seg.memory = reinterpret_cast<char *>(malloc(seg.size));
+        if (seg.memory == NULL)
+            throw std::bad_alloc();
+        seg.fileOffset = 0;
+        seg.used = 0;
+        seg.live = 0;
+        seg.spilled = false;
+        L.segments.push_back(seg);
+        inMemory += seg.size;
+        if (maxInMemory < inMemory)
+            maxInMemory = inMemory;
+    }
+    void dropMemory(segment &seg) {
+        free(seg.memory);
+        seg.memory = NULL;
+        inMemory -= seg.size;
+    }
+
+    /* reserves room for a fragment at the end of the log */
+    void append(unsigned const which, uint32_t const index, size_t const size, uint64_t const birth, bool const mayEvict) {
+        log &L = logs[which];
+        size_t const need = sizeof(header) + size;
+
+        if (L.segments.empty() || L.segments.back().memory == NULL || L.segments.back().used + need > L.segments.back().size) {
+            if (mayEvict && limit != 0)
+                makeRoom(need > SEGMENT_SIZE ? need : SEGMENT_SIZE);
+            newSegment(L, need);
+        }
+        segment &seg = L.segments.back();
+        header const hdr = { index, (uint32_t)size };
+        entry &e = entries[index];
+
+        memmove(seg.memory + seg.used, &hdr, sizeof(hdr));
+        e.where = which;
+        e.birth = birth;
+        e.segment = (uint32_t)L.segments.size();
+        e.offset = (uint32_t)(seg.used + sizeof(hdr));
+        e.size = (uint32_t)size;
+        seg.used += need;
+        seg.live += need;
+    }
+    uint32_t newIndex() {
+        if (!unused.empty()) {
+            uint32_t const index = unused.back();
+            unused.pop_back();
+            return index;
+        }
+        if (entries.size() >= 0x7FFFFFFEu)
+            throw std::runtime_error("fragment id space overflow");
+        entries.push_back(entry());
+        return (uint32_t)(entries.size() - 1);
+    }
+
+    bool isTail(log const &L, size_t const s) const {
+        return s + 1 == L.segments.size();
+    }
+
+    /* copies the live fragments of a segment to the end of the log,
+     * or to the far log if they have waited too long */
+    void compact(unsigned const which, size_t const s, uint64_t const maxWait) {
+        log &L = logs[which];
+        size_t offset = 0;
+
+        ++compactions;
+        while (offset < L.segments[s].used) {
+            header hdr;
+
+            memmove(&hdr, L.segments[s].memory + offset, sizeof(hdr));
+            offset += sizeof(hdr);
+            {
+                entry const e = entries[hdr.index];
+
+                if (e.segment == s + 1 && e.offset == offset && e.where == which) {
+                    unsigned const to = (which == NEAR && clock - e.birth > maxWait) ? FAR : which;
+
+                    if (to != which)
+                        ++demoted;
+                    append(to, hdr.index, hdr.size, e.birth, false);
+                    {
+                        entry const &n = entries[hdr.index];
+                        /* append may have grown the segment list; the segment memory stays put */
+                        memmove(logs[to].segments[n.segment - 1].memory + n.offset, L.segments[s].memory + offset, hdr.size);
+                    }
+                }
+            }
+            offset += hdr.size;
+        }
+        L.segments[s].live = 0;
+        dropMemory(L.segments[s]);
     }
-public:
-    pmem(int = 0)
-    : max_in_use(0)
-    , max_no_use(0)
-    , total_allocs(0)
-    , total_frees(0)
-    {}
-    ~pmem() {
-        my_map_t::iterator i;
-        
-        for (i = in_use.begin(); i != in_use.end(); ++i) {
-            free(i->second.memory);
-            ++total_frees;
+    bool compactOne() {
+        uint64_t const maxWait = horizon();
+
+        for (unsigned which = 0; which < 2; ++which) {
+            log &L = logs[which];
+
+            for (size_t s = 0; s < L.segments.size(); ++s) {
+                segment const &seg = L.segments[s];
+
+                if (seg.memory != NULL && !isTail(L, s) && seg.live * 2 < seg.used) {
+                    compact(which, s, maxWait);
+                    return true;
+                }
+            }
         }
-#if 0
-        std::cerr << "max. used: " << max_in_use << std::endl;
-        std::cerr << "max. free: " << max_no_use << std::endl;
-        std::cerr << "num alloc: " << total_allocs << std::endl;
-        std::cerr << "num frees: " << total_frees << std::endl;
-#endif
+        return false;
     }
-    
-    void Write(uint32_t id, size_t const offset, size_t const size, void const *const data) const
-    {
-        if (offset + size <= this->Size(id)) {
-            char *dst = reinterpret_cast<char *>(get(id)) + offset;
-            char const *src = reinterpret_cast<char const *>(data);
-            
-            std::copy(src, src + size, dst);
-            return;
+
+    rc_t openFile() {
+        rc_t rc = KDirectoryCreateFile(dir, &file, true, 0600, kcmInit, "frag_data.%u", pid);
+        KDirectoryRemove(dir, 0, "frag_data.%u", pid);
+        return rc;
+    }
+    /* the first released range of the file the size fits into, else the end of the file */
+    uint64_t takeRange(uint64_t const size) {
+        for (std::vector<range>::iterator i = holes.begin(); i != holes.end(); ++i) {
+            if (i->size >= size) {
+                uint64_t const offset = i->offset;
+
+                i->offset += size;
+                i->size -= size;
+                if (i->size == 0)
+                    holes.erase(i);
+                return offset;
+            }
+        }
+        fileSize += size;
+        if (maxFileSize < fileSize)
+            maxFileSize = fileSize;
+        return fileSize - size;
+    }
+    void releaseRange(uint64_t const offset, uint64_t const size) {
+        std::vector<range>::iterator i = holes.begin();
+        range const r = { offset, size };
+
+        while (i != holes.end() && i->offset < offset)
+            ++i;
+        i = holes.insert(i, r);
+        if (i + 1 != holes.end() && i->offset + i->size == (i + 1)->offset) {
+            i->size += (i + 1)->size;
+            holes.erase(i + 1);
+        }
+        if (i != holes.begin() && (i - 1)->offset + (i - 1)->size == i->offset) {
+            (i - 1)->size += i->size;
+            i = holes.erase(i) - 1;
+        }
+        if (i->offset + i->size == fileSize) {
+            fileSize = i->offset;
+            holes.erase(i);
+            (void)KFileSetSize(file, fileSize);
         }
-        throw std::runtime_error("attempt to write more than was allocated");
     }
-    uint32_t Alloc(size_t const size, bool const clear = true)
-    {
-        my_map_t::key_type new_key;
-        
-        if (no_use.begin() == no_use.end()) {
-            my_map_t::size_type const new_id = in_use.size() + 1;
-
-            if (max_in_use < new_id)
-                max_in_use = new_id;
-            
-            new_key = (my_map_t::key_type)new_id;
-            if (new_key < new_id)
-                throw std::runtime_error("pmem overflow");
+    rc_t spill(segment &seg) {
+        if (file == NULL) {
+            rc_t const rc = openFile();
+            if (rc) return rc;
         }
-        else {
-            my_set_t::const_iterator const j = no_use.begin();
-            
-            new_key = *j;
-            no_use.erase(j);
+        uint64_t const offset = takeRange(seg.used);
+        size_t written = 0;
+        while (written < seg.used) {
+            size_t num_writ = 0;
+            rc_t const rc = KFileWrite(file, offset + written, seg.memory + written, seg.used - written, &num_writ);
+            if (rc) return rc;
+            if (num_writ == 0)
+                return RC(rcApp, rcFile, rcWriting, rcTransfer, rcIncomplete);
+            written += num_writ;
         }
-        my_map_t::iterator const i = in_use.insert(my_map_t::value_type(new_key, 0)).first;
-        
-        void *const alloc = calloc(1, size);
-        if (alloc) {
-            i->second.memory = alloc;
-            i->second.size = size;
-            
-            ++total_allocs;
-            return i->first;
+        seg.fileOffset = offset;
+        seg.spilled = true;
+        spilled += seg.used;
+        dropMemory(seg);
+        return 0;
+    }
+    bool spillOne() {
+        for (unsigned which = FAR + 1; which-- > 0; ) {
+            log &L = logs[which];
+
+            for (size_t s = 0; s < L.segments.size(); ++s) {
+                segment &seg = L.segments[s];
+
+                if (seg.memory != NULL && !isTail(L, s)) {
+                    rc_t const rc = spill(seg);
+                    if (rc) {
+                        (void)LOGERR(klogErr, rc, "failed to spill fragments to temporary file");
+                        throw std::runtime_error("spill failed");
+                    }
+                    return true;
+                }
+            }
         }
-        throw std::bad_alloc();
+        return false;
     }
-    void Free(uint32_t const id)
-    {
-        my_map_t::iterator const i = in_use.find(id);
-        
-        if (i == in_use.end())
-            throw std::runtime_error("attempt to free invalid id");
-        
-        void *const alloc = i->second.memory;
+    void makeRoom(size_t const need) {
+        while (inMemory + need > limit) {
+            if (!compactOne() && !spillOne())
+                break;
+        }
+    }
+
+    rc_t transfer(uint32_t const id, uint64_t const pos, void *const buffer, size_t const bsize, size_t *const num, bool const write) {
+        entry const &e = get(id);
+        segment const &seg = logs[e.where].segments[e.segment - 1];
+
+        *num = 0;
+        if (pos >= e.size)
+            return 0;
 
-        no_use.insert(id);
-        if (max_no_use < no_use.size())
-            max_no_use = no_use.size();
+        size_t const actsize = (bsize + pos > e.size) ? (size_t)(e.size - pos) : bsize;
 
-        in_use.erase(i);
-        free(alloc);
-        ++total_frees;
+        if (seg.memory != NULL) {
+            char *const data = seg.memory + e.offset + pos;
+            if (write)
+                memmove(data, buffer, actsize);
+            else
+                memmove(buffer, data, actsize);
+            *num = actsize;
+            return 0;
+        }
+        if (!seg.spilled)
+            throw std::runtime_error("attempt to access a fragment in a released segment");
+        uint64_t const fpos = seg.fileOffset + e.offset + pos;
+        if (write) {
+            size_t written = 0;
+            while (written < actsize) {
+                size_t num_writ = 0;
+                rc_t const rc = KFileWrite(file, fpos + written, reinterpret_cast<char const *>(buffer) + written, actsize - written, &num_writ);
+                if (rc) return rc;
+                if (num_writ == 0)
+                    return RC(rcApp, rcFile, rcWriting, rcTransfer, rcIncomplete);
+                written += num_writ;
+            }
+            *num = written;
+            return 0;
+        }
+        return KFileReadAll(file, fpos, buffer, actsize, num);
     }
-    size_t Size(uint32_t const id) const
+
+public:
+    matebuf(KDirectory *const Dir, int const Pid, size_t const Limit)
+    : dir(Dir)
+    , file(NULL)
+    , fileSize(0)
+    , maxFileSize(0)
+    , spilled(0)
+    , clock(0)
+    , limit(Limit)
+    , inMemory(0)
+    , maxInMemory(0)
+    , compactions(0)
+    , demoted(0)
+    , pid(Pid)
     {
-        my_map_t::const_iterator const i = in_use.find(id);
-        
-        if (i == in_use.end())
-            throw std::runtime_error("attempt to access invalid or freed id");
-        
-        return i->second.size;
+        KDirectoryAddRef(dir);
     }
-    void const *Read(uint32_t const id) const
-    {
-        return get(id);
+    ~matebuf() {
+        uint64_t const allocs = entries.size();
+
+        for (unsigned which = 0; which < 2; ++which) {
+            log &L = logs[which];
+
+            for (std::vector<segment>::iterator i = L.segments.begin(); i != L.segments.end(); ++i)
+                free(i->memory);
+        }
+        (void)PLOGMSG(klogInfo, (klogInfo, "fragment store: $(allocs) ids, max. $(mem) bytes in memory, $(spill) bytes spilled, max. $(file) bytes in the spill file, $(comp) compactions, $(demo) demoted",
+                                 "allocs=%lu,mem=%lu,spill=%lu,file=%lu,comp=%lu,demo=%lu",
+                                 allocs, (uint64_t)maxInMemory, spilled, maxFileSize, compactions, demoted));
+        KFileRelease(file);
+        KDirectoryRelease(dir);
+    }
+
+    uint32_t Alloc(size_t const size, bool const clear, bool const far) {
+        unsigned const which = far ? FAR : NEAR;
+
+        if (size > 0xFFFFFFFFu - sizeof(header))
+            throw std::runtime_error("fragment too large");
+        {
+            uint32_t const index = newIndex();
+
+            append(which, index, size, ++clock, true);
+            if (clear) {
+                entry const &e = entries[index];
+                memset(logs[which].segments[e.segment - 1].memory + e.offset, 0, size);
+            }
+            return makeId(which, index);
+        }
+    }
+    void Free(uint32_t const id) {
+        entry &e = get(id);
+        log &L = logs[e.where];
+        size_t const s = e.segment - 1;
+        segment &seg = L.segments[s];
+
+        L.waited.Count(bucket(clock - e.birth));
+        ++L.freed;
+        seg.live -= sizeof(header) + e.size;
+        e.segment = 0;
+        unused.push_back(indexOf(id));
+        if (seg.live == 0 && seg.memory != NULL && !isTail(L, s))
+            dropMemory(seg);
+        else if (seg.live == 0 && seg.spilled) {
+            releaseRange(seg.fileOffset, seg.used);
+            seg.spilled = false;
+        }
+    }
+    size_t Size(uint32_t const id) const {
+        return get(id).size;
+    }
+    rc_t Write(uint32_t const id, uint64_t const pos, void const *const buffer, size_t const bsize, size_t *const num_writ) {
+        return transfer(id, pos, const_cast<void *>(buffer), bsize, num_writ, true);
+    }
+    rc_t Read(uint32_t const id, uint64_t const pos, void *const buffer, size_t const bsize, size_t *const num_read) const {
+        return const_cast<matebuf *>(this)->transfer(id, pos, buffer, bsize, num_read, false);
     }
 };
 
-rc_t MemBank_Make(MemBank **bank, struct KDirectory * = 0, int = 0, size_t const * = 0)
+rc_t MemBank_Make(MemBank **bank, struct KDirectory *dir, int pid, size_t const climits[2])
 {
     try {
-        pmem *const rslt = new pmem;
+        size_t const limit = climits ? climits[0] + climits[1] : 0;
+        matebuf *const rslt = new matebuf(dir, pid, limit);
         
         *bank = reinterpret_cast<MemBank *>(rslt);
         return 0;
@@ -316,15 +628,15 @@ rc_t MemBank_Make(MemBank **bank, struct KDirectory * = 0, int = 0, size_t const
 
 void MemBank_Release(MemBank *const self)
 {
-    delete reinterpret_cast<pmem *>(self);
+    delete reinterpret_cast<matebuf *>(self);
 }
 
 rc_t MemBank_Alloc(MemBank *const Self, uint32_t *const id, size_t const bytes, bool const clear, bool const longlived)
 {
     try {
-        pmem *const self = reinterpret_cast<pmem *>(Self);
+        matebuf *const self = reinterpret_cast<matebuf *>(Self);
         
-        *id = self->Alloc(bytes, clear);
+        *id = self->Alloc(bytes, clear, longlived);
         return 0;
     }
     catch (std::bad_alloc const &e) {
@@ -343,21 +655,9 @@ rc_t MemBank_Alloc(MemBank *const Self, uint32_t *const id, size_t const bytes,
 rc_t MemBank_Write(MemBank *const Self, uint32_t const id, uint64_t const pos, void const *const buffer, size_t const bsize, size_t *const num_writ)
 {
     try {
-        pmem *const self = reinterpret_cast<pmem *>(Self);
-        
-        *num_writ = 0;
-
-        size_t const size = self->Size((uint32_t)id);
-        
-        if (pos >= size)
-            return 0;
-        
-        size_t const actsize = (bsize + pos > size) ? (size - pos) : size;
-        
-        *num_writ = actsize;
-        self->Write(id, pos, actsize, buffer);
+        matebuf *const self = reinterpret_cast<matebuf *>(Self);
         
-        return 0;
+        return self->Write(id, pos, buffer, bsize, num_writ);
     }
     catch (std::exception const &e) {
         std::cerr << e.what() << std::endl;
@@ -372,7 +672,7 @@ rc_t MemBank_Write(MemBank *const Self, uint32_t const id, uint64_t const pos, v
 rc_t MemBank_Size(MemBank const *const Self, uint32_t const id, size_t *const size)
 {
     try {
-        pmem const *const self = reinterpret_cast<pmem const *>(Self);
+        matebuf const *const self = reinterpret_cast<matebuf const *>(Self);
         
         *size = self->Size(id);
         return 0;
@@ -390,24 +690,9 @@ rc_t MemBank_Size(MemBank const *const Self, uint32_t const id, size_t *const si
 rc_t MemBank_Read(MemBank const *const Self, uint32_t const id, uint64_t const pos, void *const buffer, size_t const bsize, size_t *const num_read)
 {
     try {
-        pmem const *const self = reinterpret_cast<pmem const *>(Self);
-        
-        *num_read = 0;
-        
-        size_t const size = self->Size(id);
-        char const *data = reinterpret_cast<char const *>(self->Read(id)) + pos;
+        matebuf const *const self = reinterpret_cast<matebuf const *>(Self);
         
-        if (pos >= size)
-            return 0;
-        
-        size_t const actsize = (bsize + pos > size) ? (size - pos) : size;
-        
-        *num_read = actsize;
-        
-        char *dst = reinterpret_cast<char *>(buffer);
-        std::copy(data, data + actsize, dst);
-        
-        return 0;
+        return self->Read(id, pos, buffer, bsize, num_read);
     }
     catch (std::exception const &e) {
         std::cerr << e.what() << std::endl;
@@ -422,7 +707,7 @@ rc_t MemBank_Read(MemBank const *const Self, uint32_t const id, uint64_t const p
 rc_t MemBank_Free(MemBank *const Self, uint32_t const id)
 {
     try {
-        pmem *const self = reinterpret_cast<pmem *>(Self);
+        matebuf *const self = reinterpret_cast<matebuf *>(Self);
         
         self->Free(id);
         return 0;
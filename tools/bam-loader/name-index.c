@@ -0,0 +1,390 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include <klib/rc.h>
+#include <kfs/directory.h>
+#include <kfs/file.h>
+#include <kfs/mmap.h>
+#include <kproc/lock.h>
+#include <sysalloc.h>
+#include <atomic32.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "name-index.h"
+
+#define NUM_SHARDS (256u)
+#define INITIAL_BUCKETS (1024u)
+#define ENTRIES_PER_CHUNK (1u << 14)
+#define FIRST_NAME_CHUNK_SIZE (1u << 16)
+#define MAX_NAME_CHUNK_SIZE (64u << 20)
+
+typedef struct {
+    uint64_t fingerprint;
+    uint64_t nameAt;        /* chunk << 32 | offset in chunk */
+    uint32_t next;          /* index + 1 of the next entry in the bucket, 0 ends the list */
+    uint32_t id;
+    uint32_t space;
+    uint32_t namelen;
+} Entry;
+
+typedef struct {
+    KMMap *mmap;
+    uint8_t *base;
+    size_t size;
+    size_t used;
+} Chunk;
+
+typedef struct {
+    KLock *lock;
+    uint32_t *bucket;       /* index + 1 of the first entry in the bucket */
+    uint32_t numBuckets;
+    uint32_t numEntries;
+    Chunk *entries;         /* fixed size, ENTRIES_PER_CHUNK each */
+    Chunk *names;           /* growing in size */
+    unsigned numEntryChunks;
+    unsigned numNameChunks;
+} Shard;
+
+struct NameIndex {
+    KLock *fileLock;
+    atomic32_t *nextId;     /* per id space */
+    KFile *file;
+    uint64_t mapped;
+    uint64_t fsize;
+    unsigned numSpaces;
+    Shard shard[NUM_SHARDS];
+};
+
+/* FNV-1a with a final mix, the low bits select the shard, the next bits the bucket */
+static uint64_t NameHash(unsigned const space, char const name[], size_t const namelen)
+{
+    uint64_t h = 0xcbf29ce484222325ull ^ space;
+    size_t i;
+
+    for (i = 0; i < namelen; ++i)
+        h = (h ^ (uint8_t)name[i]) * 0x100000001b3ull;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static unsigned BucketOf(Shard const *const shard, uint64_t const fingerprint)
+{
+    return (unsigned)((fingerprint / NUM_SHARDS) & (shard->numBuckets - 1));
+}
+
+static Entry *GetEntry(Shard const *const shard, uint32_t const i)
+{
+    return &((Entry *)shard->entries[i / ENTRIES_PER_CHUNK].base)[i % ENTRIES_PER_CHUNK];
+}
+
+static char const *GetName(Shard const *const shard, uint64_t const nameAt)
+{
+    return (char const *)&shard->names[nameAt >> 32].base[(uint32_t)nameAt];
+}
+
+static rc_t MapChunk(NameIndex *const self, Chunk *const chunk, size_t const size)
+{
+    rc_t rc = 0;
+
+    KLockAcquire(self->fileLock);
+    {
+        uint64_t const offset = self->fsize;
+
+        rc = KFileSetSize(self->file, offset + size);
+        if (rc == 0) {
+            KMMap *mm = NULL;
+
+            rc = KMMapMakeRgnUpdate(&mm, self->file, offset, size);
+            if (rc == 0) {
+                void *base = NULL;
+
+                rc = KMMapAddrUpdate(mm, &base);
+                if (rc == 0) {
+                    self->fsize = offset + size;
+                    self->mapped += size;
+                    chunk->mmap = mm;
+                    chunk->base = base;
+                    chunk->size = size;
+                    chunk->used = 0;
+                }
+                else
+                    KMMapRelease(mm);
+            }
+        }
+    }
+    KLockUnlock(self->fileLock);
+    return rc;
+}
+
+static rc_t AppendChunk(NameIndex *const self, Chunk **const chunks, unsigned *const count, size_t const size)
+{
+    void *const tmp = realloc(*chunks, (*count + 1) * sizeof((*chunks)[0]));
+    rc_t rc;
+
+    if (tmp == NULL)
+        return RC(rcExe, rcMemMap, rcAllocating, rcMemory, rcExhausted);
+    *chunks = tmp;
+    rc = MapChunk(self, &(*chunks)[*count], size);
+    if (rc == 0)
+        ++*count;
+    return rc;
+}
+
+static rc_t GrowBuckets(Shard *const shard)
+{
+    uint32_t const newCount = shard->numBuckets * 2;
+    uint32_t *const bucket = calloc(newCount, sizeof(bucket[0]));
+    uint32_t i;
+
+    if (bucket == NULL)
+        return RC(rcExe, rcIndex, rcResizing, rcMemory, rcExhausted);
+
+    free(shard->bucket);
+    shard->bucket = bucket;
+    shard->numBuckets = newCount;
+    for (i = 0; i < shard->numEntries; ++i) {
+        Entry *const entry = GetEntry(shard, i);
+        unsigned const b = BucketOf(shard, entry->fingerprint);
+
+        entry->next = bucket[b];
+        bucket[b] = i + 1;
+    }
+    return 0;
+}
+
+static rc_t StoreName(NameIndex *const self, Shard *const shard, char const name[], size_t const namelen, uint64_t *const nameAt)
+{
+    Chunk *chunk = shard->numNameChunks > 0 ? &shard->names[shard->numNameChunks - 1] : NULL;
+
+    if (namelen > MAX_NAME_CHUNK_SIZE)
+        return RC(rcExe, rcString, rcWriting, rcSize, rcExcessive);
+
+    if (chunk == NULL || chunk->used + namelen > chunk->size) {
+        size_t size = chunk ? chunk->size * 2 : FIRST_NAME_CHUNK_SIZE;
+        rc_t rc;
+
+        if (size > MAX_NAME_CHUNK_SIZE)
+            size = MAX_NAME_CHUNK_SIZE;
+        rc = AppendChunk(self, &shard->names, &shard->numNameChunks, size);
+        if (rc)
+            return rc;
+        chunk = &shard->names[shard->numNameChunks - 1];
+    }
+    memmove(&chunk->base[chunk->used], name, namelen);
+    *nameAt = (((uint64_t)(shard->numNameChunks - 1)) << 32) | chunk->used;
+    chunk->used += namelen;
+    return 0;
+}
+
+/* the lock of the shard is held */
+static rc_t Insert(NameIndex *const self, Shard *const shard, uint64_t const fingerprint,
+                   unsigned const space, char const name[], size_t const namelen, uint32_t *const id)
+{
+    uint32_t const i = shard->numEntries;
+    Entry *entry;
+    rc_t rc = 0;
+
+    if (i == UINT32_MAX)
+        return RC(rcExe, rcIndex, rcInserting, rcId, rcExhausted);
+
+    if (i >= shard->numBuckets) {
+        rc = GrowBuckets(shard);
+        if (rc)
+            return rc;
+    }
+    if (i / ENTRIES_PER_CHUNK >= shard->numEntryChunks) {
+        rc = AppendChunk(self, &shard->entries, &shard->numEntryChunks, ENTRIES_PER_CHUNK * sizeof(Entry));
+        if (rc)
+            return rc;
+    }
+    entry = GetEntry(shard, i);
+    rc = StoreName(self, shard, name, namelen, &entry->nameAt);
+    if (rc)
+        return rc;
+
+    entry->id = (uint32_t)atomic32_read_and_add(&self->nextId[space], 1);
+    if (entry->id == UINT32_MAX)
+        return RC(rcExe, rcIndex, rcInserting, rcId, rcExhausted);
+
+    entry->fingerprint = fingerprint;
+    entry->space = space;
+    entry->namelen = (uint32_t)namelen;
+    {
+        unsigned const b = BucketOf(shard, fingerprint);
+
+        entry->next = shard->bucket[b];
+        shard->bucket[b] = i + 1;
+    }
+    shard->entries[i / ENTRIES_PER_CHUNK].used += sizeof(Entry);
+    shard->numEntries = i + 1;
+    *id = entry->id;
+    return 0;
+}
+
+rc_t NameIndexEntry(NameIndex *const self, unsigned const space, char const name[], size_t const namelen,
+                    uint32_t *const id, bool *const wasInserted)
+{
+    uint64_t const fingerprint = NameHash(space, name, namelen);
+    Shard *const shard = &self->shard[fingerprint % NUM_SHARDS];
+    bool found = false;
+    rc_t rc = 0;
+
+    if (space >= self->numSpaces)
+        return RC(rcExe, rcIndex, rcInserting, rcParam, rcExcessive);
+
+    *wasInserted = false;
+    KLockAcquire(shard->lock);
+    {
+        uint32_t i = shard->bucket[BucketOf(shard, fingerprint)];
+
+        /* walk the collision list, the names are compared only if the fingerprints match */
+        while (i != 0) {
+            Entry const *const entry = GetEntry(shard, i - 1);
+
+            if (   entry->fingerprint == fingerprint
+                && entry->space == space
+                && entry->namelen == namelen
+                && memcmp(GetName(shard, entry->nameAt), name, namelen) == 0)
+            {
+                *id = entry->id;
+                found = true;
+                break;
+            }
+            i = entry->next;
+        }
+        if (!found) {
+            rc = Insert(self, shard, fingerprint, space, name, namelen, id);
+            if (rc == 0)
+                *wasInserted = true;
+        }
+    }
+    KLockUnlock(shard->lock);
+    return rc;
+}
+
+uint64_t NameIndexCount(NameIndex const *const self)
+{
+    uint64_t count = 0;
+    unsigned i;
+
+    for (i = 0; i < NUM_SHARDS; ++i)
+        count += self->shard[i].numEntries;
+    return count;
+}
+
+uint64_t NameIndexMemoryUsed(NameIndex const *const self)
+{
+    uint64_t used = sizeof(*self) + self->numSpaces * sizeof(self->nextId[0]);
+    unsigned i;
+
+    for (i = 0; i < NUM_SHARDS; ++i) {
+        Shard const *const shard = &self->shard[i];
+        unsigned j;
+
+        used += shard->numBuckets * sizeof(shard->bucket[0]);
+        used += (shard->numEntryChunks + shard->numNameChunks) * sizeof(Chunk);
+        for (j = 0; j < shard->numEntryChunks; ++j)
+            used += shard->entries[j].used;
+        for (j = 0; j < shard->numNameChunks; ++j)
+            used += shard->names[j].used;
+    }
+    return used;
+}
+
+void NameIndexRelease(NameIndex *const self)
+{
+    if (self) {
+        unsigned i;
+
+        for (i = 0; i < NUM_SHARDS; ++i) {
+            Shard *const shard = &self->shard[i];
+            unsigned j;
+
+            for (j = 0; j < shard->numEntryChunks; ++j)
+                KMMapRelease(shard->entries[j].mmap);
+            for (j = 0; j < shard->numNameChunks; ++j)
+                KMMapRelease(shard->names[j].mmap);
+            free(shard->entries);
+            free(shard->names);
+            free(shard->bucket);
+            KLockRelease(shard->lock);
+        }
+        KLockRelease(self->fileLock);
+        free(self->nextId);
+        KFileRelease(self->file);
+        free(self);
+    }
+}
+
+rc_t NameIndexMake(NameIndex **const rslt, KDirectory *const tmpdir, unsigned const pid, unsigned const numSpaces)
+{
+    NameIndex *const self = calloc(1, sizeof(*self));
+    rc_t rc;
+    unsigned i;
+
+    if (self == NULL)
+        return RC(rcExe, rcIndex, rcConstructing, rcMemory, rcExhausted);
+    self->numSpaces = numSpaces;
+    self->nextId = calloc(numSpaces, sizeof(self->nextId[0]));
+    if (self->nextId == NULL) {
+        NameIndexRelease(self);
+        return RC(rcExe, rcIndex, rcConstructing, rcMemory, rcExhausted);
+    }
+
+    rc = KLockMake(&self->fileLock);
+    for (i = 0; rc == 0 && i < NUM_SHARDS; ++i) {
+        Shard *const shard = &self->shard[i];
+
+        rc = KLockMake(&shard->lock);
+        if (rc == 0) {
+            shard->bucket = calloc(INITIAL_BUCKETS, sizeof(shard->bucket[0]));
+            if (shard->bucket == NULL)
+                rc = RC(rcExe, rcIndex, rcConstructing, rcMemory, rcExhausted);
+            else
+                shard->numBuckets = INITIAL_BUCKETS;
+        }
+    }
+    if (rc == 0) {
+        rc = KDirectoryCreateFile(tmpdir, &self->file, true, 0600, kcmInit, "name-index.%u", pid);
+        if (rc == 0)
+            KDirectoryRemove(tmpdir, false, "name-index.%u", pid);
+    }
+    if (rc) {
+        NameIndexRelease(self);
+        return rc;
+    }
+    *rslt = self;
+    return 0;
+}
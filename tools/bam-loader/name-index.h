@@ -0,0 +1,50 @@
+/* ===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/* NameIndex: spot-name -> id map, an alternative to one KBTree per id space
+ *
+ * The names are spread over shards by hash, each shard has its own lock,
+ * a bucket array and collision lists of entries holding a 64-bit fingerprint
+ * of the name. Entries and names live in memory-mapped chunks of a temporary
+ * file in the given directory. The full name is only compared if the fingerprints match.
+ *
+ * Lookup and insert may be called from several threads at once;
+ * ids are handed out per id space, in order of insertion, starting at 0.
+ */
+
+typedef struct NameIndex NameIndex;
+struct KDirectory;
+
+rc_t NameIndexMake(NameIndex **rslt, struct KDirectory *tmpdir, unsigned pid, unsigned numSpaces);
+
+void NameIndexRelease(NameIndex *self);
+
+rc_t NameIndexEntry(NameIndex *self, unsigned space, char const name[], size_t namelen, uint32_t *id, bool *wasInserted);
+
+uint64_t NameIndexCount(NameIndex const *self);
+
+/* bytes of memory used: bucket arrays and the used part of the mapped chunks */
+uint64_t NameIndexMemoryUsed(NameIndex const *self);
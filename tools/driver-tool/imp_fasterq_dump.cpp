@@ -61,6 +61,8 @@ struct FasterqParams final : CmnOptAndAccessions
     ncbi::U32 MinReadLen;
     bool strict;
     bool append;
+    bool gzip;
+    bool skip_space_check;
 
     explicit FasterqParams(WhatImposter const &what)
     : CmnOptAndAccessions(what)
@@ -82,6 +84,8 @@ struct FasterqParams final : CmnOptAndAccessions
     , MinReadLen( 0 )
     , strict( false )
     , append( false )
+    , gzip( false )
+    , skip_space_check( false )
     {
     }
 
@@ -127,6 +131,9 @@ struct FasterqParams final : CmnOptAndAccessions
 
         cmdline . addOption ( bases, nullptr, "B", "bases", "<bases>", "filter output by matching against given bases" );
         cmdline . addOption ( append, "A", "append", "append to output-file, instead of overwriting it" );
+        cmdline . addOption ( gzip, "g", "gzip", "compress output using gzip (in parallel, BGZF-compatible)" );
+        cmdline . addOption ( skip_space_check, "", "skip-space-check",
+            "do not refuse to start if the estimated disk-space is not available" );
 
         CmnOptAndAccessions::add(cmdline);
     }
@@ -157,6 +164,8 @@ struct FasterqParams final : CmnOptAndAccessions
         if ( strict ) ss << "strict" << std::endl;
         if ( !bases.isEmpty() )  ss << "bases : " << bases << std::endl;
         if ( append ) ss << "append" << std::endl;
+        if ( gzip ) ss << "gzip" << std::endl;
+        if ( skip_space_check ) ss << "skip-space-check" << std::endl;
         return CmnOptAndAccessions::show(ss);
     }
 
@@ -197,6 +206,8 @@ struct FasterqParams final : CmnOptAndAccessions
         if ( strict ) builder . add_option( "--strict" );
         if ( !bases.isEmpty() ) builder . add_option( "-B", bases );
         if ( append ) builder . add_option( "-A" );
+        if ( gzip ) builder . add_option( "-g" );
+        if ( skip_space_check ) builder . add_option( "--skip-space-check" );
     }
 
     bool check() const override
@@ -43,6 +43,8 @@ struct PrefetchParams final : CmnOptAndAccessions
     ncbi::String resume;
     ncbi::String validate;
     ncbi::String check_refseqs;
+    ncbi::String connections;
+    ncbi::String jobs;
     bool progress;
     bool eliminate_quals;
     bool check_all;
@@ -88,6 +90,11 @@ struct PrefetchParams final : CmnOptAndAccessions
 
         cmdline . addOption ( check_all, "c", "check-all", "Double-check all refseqs" );
 
+        cmdline . addOption ( connections, nullptr, "", "connections", "<count>",
+            "Number of concurrent HTTP range-requests per file. Default: 1" );
+        cmdline . addOption ( jobs, nullptr, "", "jobs", "<count>",
+            "Number of items to download concurrently. Default: 1" );
+
         cmdline . addOption ( check_refseqs, nullptr,
             "S", "check-rs", "<yes|no|smart>",
             "Check for refseqs in downloaded files: "
@@ -130,6 +137,8 @@ struct PrefetchParams final : CmnOptAndAccessions
         if ( !validate.isEmpty() ) ss << "validate: " << validate << std::endl;
         if ( eliminate_quals ) ss << "eliminate-quals" << std::endl;
         if ( check_all ) ss << "check-all" << std::endl;
+        if ( !connections.isEmpty() ) ss << "connections: " << connections << std::endl;
+        if ( !jobs.isEmpty() ) ss << "jobs: " << jobs << std::endl;
         if ( !check_refseqs.isEmpty() ) ss << "check_refseqs: " << check_refseqs << std::endl;
         //if ( !ascp_path.isEmpty() ) ss << "ascp-path: " << ascp_path << std::endl;
         //if ( !ascp_options.isEmpty() ) ss << "ascp-options: " << ascp_options << std::endl;
@@ -157,6 +166,8 @@ struct PrefetchParams final : CmnOptAndAccessions
         if ( !validate.isEmpty() ) builder . add_option( "-C", validate);
         if ( eliminate_quals ) builder . add_option( "--eliminate-quals" );
         if ( check_all ) builder . add_option( "-c" );
+        if ( !connections.isEmpty() ) builder . add_option( "--connections", connections );
+        if ( !jobs.isEmpty() ) builder . add_option( "--jobs", jobs );
         if ( !check_refseqs.isEmpty() )
             builder . add_option( "-S", check_refseqs );
         //if ( !ascp_path.isEmpty() ) builder . add_option( "-a", ascp_path );
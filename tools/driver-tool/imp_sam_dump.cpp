@@ -43,6 +43,7 @@ struct SamDumpParams final : CmnOptAndAccessions
     ncbi::String qual_quant;
     ncbi::String output_file;
     ncbi::String rna_splice_log;
+    ncbi::String bam_index;
     ncbi::U32 out_buf_size_count;
     ncbi::U32 out_buf_size;
     ncbi::U32 cursor_cache_count;
@@ -51,6 +52,12 @@ struct SamDumpParams final : CmnOptAndAccessions
     ncbi::U32 min_mapq;
     ncbi::U32 rna_splice_level_count;
     ncbi::U32 rna_splice_level;
+    ncbi::U32 bam_threads_count;
+    ncbi::U32 bam_threads;
+    ncbi::U32 ref_threads_count;
+    ncbi::U32 ref_threads;
+    ncbi::U32 mate_min_dist_count;
+    ncbi::U32 mate_min_dist;
     bool unaligned;
     bool primary;
     bool cigar_long;
@@ -78,6 +85,7 @@ struct SamDumpParams final : CmnOptAndAccessions
     bool no_mate_cache;
     bool rna_splicing;
     bool md_flag;
+    bool bam;
     
     explicit SamDumpParams(WhatImposter const &what)
     : CmnOptAndAccessions(what)
@@ -89,6 +97,12 @@ struct SamDumpParams final : CmnOptAndAccessions
     , min_mapq(0)
     , rna_splice_level_count(0)
     , rna_splice_level(0)
+    , bam_threads_count(0)
+    , bam_threads(0)
+    , ref_threads_count(0)
+    , ref_threads(0)
+    , mate_min_dist_count(0)
+    , mate_min_dist(0)
     , unaligned(false)
     , primary(false)
     , cigar_long(false)
@@ -116,6 +130,7 @@ struct SamDumpParams final : CmnOptAndAccessions
     , no_mate_cache(false)
     , rna_splicing(false)
     , md_flag(false)
+    , bam(false)
     {
     }
 
@@ -182,6 +197,9 @@ struct SamDumpParams final : CmnOptAndAccessions
 
         cmdline . addOption ( no_mate_cache, "", "no-mate-cache",
             "do not use mate-cache, slower but less memory usage" );
+        cmdline . addOption ( mate_min_dist, &mate_min_dist_count, "", "mate-cache-min-dist", "<bases>",
+            "mates closer than this on the reference are always cached, farther ones only if "
+            "they are within the observed distances (dflt:10000)" );
 
         cmdline . addOption ( rna_splicing, "", "rna-splicing",
             "modify cigar-string (replace .D. with .N.) and add output flags (XS:A:+/-) when "
@@ -194,6 +212,16 @@ struct SamDumpParams final : CmnOptAndAccessions
 
         cmdline . addOption ( md_flag, "", "with-md-flag", "print MD-flag" );
 
+        cmdline . addOption ( bam, "", "bam", "Produce BAM (BGZF-compressed) output" );
+        cmdline . addOption ( bam_index, nullptr, "", "bam-index", "<bai|csi>",
+            "write a bai- or csi-index of the BAM-output next to the output-file "
+            "(needs --output-file and coordinate-sorted output)" );
+        cmdline . addOption ( bam_threads, &bam_threads_count, "", "bam-threads", "<count>",
+            "number of threads compressing the BAM-output (dflt:4)" );
+        cmdline . addOption ( ref_threads, &ref_threads_count, "", "ref-threads", "<count>",
+            "threads dumping references concurrently (dflt:1, output-order is unchanged, "
+            "needs more memory)" );
+
         CmnOptAndAccessions::add(cmdline);
     }
 
@@ -234,10 +262,15 @@ struct SamDumpParams final : CmnOptAndAccessions
         if ( cursor_cache_count > 0 ) ss << "cursor-cache: " << cursor_cache_size << std::endl;
         if ( min_mapq_count > 0 ) ss << "min-mapq: " << min_mapq << std::endl;
         if ( no_mate_cache ) ss << "no-mate-cache" << std::endl;
+        if ( mate_min_dist_count > 0 ) ss << "mate-cache-min-dist: " << mate_min_dist << std::endl;
         if ( rna_splicing ) ss << "rna-splicing" << std::endl;
         if ( rna_splice_level_count > 0 ) ss << "rna-splice-level: " << rna_splice_level << std::endl;
         if ( !rna_splice_log.isEmpty() ) ss << "rna-splice-log: " << rna_splice_log << std::endl;
         if ( md_flag ) ss << "md-flag" << std::endl;
+        if ( bam ) ss << "bam" << std::endl;
+        if ( !bam_index.isEmpty() ) ss << "bam-index: " << bam_index << std::endl;
+        if ( bam_threads_count > 0 ) ss << "bam-threads: " << bam_threads << std::endl;
+        if ( ref_threads_count > 0 ) ss << "ref-threads: " << ref_threads << std::endl;
         return CmnOptAndAccessions::show(ss);
     }
 
@@ -274,10 +307,11 @@ struct SamDumpParams final : CmnOptAndAccessions
         if ( !qual_quant.isEmpty() ) builder . add_option( "-Q", qual_quant );
         if ( !output_file.isEmpty() ) {
             if (accessions.size() > 1 && !(fasta || fastq)) {
+                auto const extension = bam ? ".bam" : ".sam";
                 if (acc_index == 0)
-                    print_unsafe_output_file_message("sam-dump", ".sam", accessions);
+                    print_unsafe_output_file_message("sam-dump", extension, accessions);
 
-                builder . add_option( "--output-file", accessions[acc_index] + ".sam" );
+                builder . add_option( "--output-file", accessions[acc_index] + extension );
             }
             else
                 builder . add_option( "--output-file", output_file );
@@ -289,10 +323,15 @@ struct SamDumpParams final : CmnOptAndAccessions
         if ( cursor_cache_count > 0 ) builder . add_option( "--cursor-cache", cursor_cache_size );
         if ( min_mapq_count > 0 ) builder . add_option( "--min-mapq", min_mapq );
         if ( no_mate_cache ) builder . add_option( "--no-mate-cache" );
+        if ( mate_min_dist_count > 0 ) builder . add_option( "--mate-cache-min-dist", mate_min_dist );
         if ( rna_splicing ) builder . add_option( "--rna-splicing" );
         if ( rna_splice_level_count > 0 ) builder . add_option( "--rna-splice-level", rna_splice_level );
         if ( !rna_splice_log.isEmpty() ) builder . add_option( "--rna-splice-log", rna_splice_log );
         if ( md_flag ) builder . add_option( "--with-md-flag" );
+        if ( bam ) builder . add_option( "--bam" );
+        if ( !bam_index.isEmpty() ) builder . add_option( "--bam-index", bam_index );
+        if ( bam_threads_count > 0 ) builder . add_option( "--bam-threads", bam_threads );
+        if ( ref_threads_count > 0 ) builder . add_option( "--ref-threads", ref_threads );
     }
 
     bool check() const override
@@ -317,6 +356,11 @@ struct SamDumpParams final : CmnOptAndAccessions
             std::cerr << "fasta and fastq cannot both be used at the same time" << std::endl;
             problems++;
         }
+        if ( bam && ( fasta || fastq || gzip || bzip ) )
+        {
+            std::cerr << "bam cannot be combined with fasta, fastq, gzip or bzip2" << std::endl;
+            problems++;
+        }
 
         return CmnOptAndAccessions::check() && ( problems == 0 );
     }
@@ -47,6 +47,8 @@ struct SraPileupParams final : CmnOptAndAccessions
     ncbi::U32 min_mismatch_value;
     ncbi::U32 merge_dist_count;
     ncbi::U32 merge_dist_value;
+    ncbi::U32 threads_count;
+    ncbi::U32 threads_value;
     ncbi::String function;
 
     explicit SraPileupParams(WhatImposter const &what)
@@ -62,6 +64,7 @@ struct SraPileupParams final : CmnOptAndAccessions
     , duplicates_count( 0 ), duplicates_value( 0 )
     , min_mismatch_count( 0 ), min_mismatch_value( 0 )
     , merge_dist_count( 0 ), merge_dist_value( 0 )
+    , threads_count( 0 ), threads_value( 0 )
     {
     }
 
@@ -96,6 +99,10 @@ struct SraPileupParams final : CmnOptAndAccessions
             "If adjacent slices are closer than this, they are merged and skiplist is created. "
             "a value of zero disables the feature, default is 10000" );
 
+        cmdline . addOption ( threads_value, &threads_count, "", "threads", "<count>",
+            "number of worker-threads: the references are cut into slices, which are piled up concurrently, "
+            "default is 1" );
+
         cmdline . addOption ( noqual, "n", "noqual", "omit qualities (faster)" );
 
         cmdline . addOption ( function, nullptr, "", "function", "<selector>",
@@ -103,7 +110,8 @@ struct SraPileupParams final : CmnOptAndAccessions
             "stat = strand/tlen statistic, mismatch = only lines with mismatches, index = list deletions counts "
             "varcount = variation counters ( columns: ref-name, ref-pos, ref-base, coverage, mismatch A "
             "mismatch C, mismatch G, mismatch T, deletes, inserts, ins after A, ins after C ins after G "
-            "ins after T ) deletes = list deletions greater than 20, indels = list only inserts/deletions" );
+            "ins after T ) deletes = list deletions greater than 20, indels = list only inserts/deletions "
+            "binary = per-position counters in binary format" );
 
         CmnOptAndAccessions::add(cmdline);
     }
@@ -123,6 +131,7 @@ struct SraPileupParams final : CmnOptAndAccessions
         if ( seqname ) ss << "orig. seqname" << std::endl;
         if ( min_mismatch_count > 0 ) ss << "min. mismatch: " << min_mismatch_value << std::endl;
         if ( merge_dist_count > 0 ) ss << "merge-dist: " << merge_dist_value << std::endl;
+        if ( threads_count > 0 ) ss << "threads: " << threads_value << std::endl;
         if ( noqual ) ss << "no qualities" << std::endl;
         if ( !function.isEmpty() ) ss << "function: " << function << std::endl;
         return CmnOptAndAccessions::show(ss);
@@ -153,6 +162,7 @@ struct SraPileupParams final : CmnOptAndAccessions
         if ( seqname ) builder . add_option( "-e" );
         if ( min_mismatch_count > 0 ) builder . add_option( "--minmismatch", min_mismatch_value );
         if ( merge_dist_count > 0 ) builder . add_option( "--merge-dist", merge_dist_value );
+        if ( threads_count > 0 ) builder . add_option( "--threads", threads_value );
         if ( noqual ) builder . add_option( "-n" );
         if ( !function.isEmpty() ) builder . add_option( "--function", function );
     }
@@ -162,9 +172,9 @@ struct SraPileupParams final : CmnOptAndAccessions
         int problems = 0;
         if ( !function.isEmpty() )
         {
-            if ( !is_one_of( function, 9,
+            if ( !is_one_of( function, 10,
                              "ref", "ref-ex", "count", "stat", "mismatch", "index",
-                             "varcount", "deletes", "indels" ) )
+                             "varcount", "deletes", "indels", "binary" ) )
             {
                 std::cerr << "invalid function: " << function << std::endl;
                 problems++;
@@ -945,6 +945,7 @@ RUNNING_AS_FASTERQ_DUMP:
         '-S' => '--split-files',
         '-3' => '--split-3',
         '-f' => '--force',
+        '-g' => '--gzip',
         '-N' => '--rowid-as-name',
         '-P' => '--print-read-nr',
         '-M' => '--min-read-len',
@@ -1015,6 +1016,10 @@ RUNNING_AS_SAM_DUMP:
         '--min-mapq' => TRUE,
         '--rna-splice-level' => TRUE,
         '--rna-splice-log' => TRUE,
+        '--bam-index' => TRUE,
+        '--bam-threads' => TRUE,
+        '--ref-threads' => TRUE,
+        '--mate-cache-min-dist' => TRUE,
         '--ngc' => TRUE,
         '--log-level' => TRUE,
         '--debug' => TRUE,
@@ -1023,8 +1028,8 @@ RUNNING_AS_SAM_DUMP:
     my @args = (); # everything that isn't part of a parameter
 
     if (parseArgv('new', @params, @args, %long_arg, %param_has_arg, @ARGV)) {
-        my $extension = hasParameter('--fastq', \@params) ? '.fastq' : hasParameter('--fasta', \@params) ? '.fasta' : '.sam';
-        processAccessions('sam-dump', $toolpath, $extension eq '.sam' ? '--output-file' : undef, $extension, @params, @args);
+        my $extension = hasParameter('--fastq', \@params) ? '.fastq' : hasParameter('--fasta', \@params) ? '.fasta' : hasParameter('--bam', \@params) ? '.bam' : '.sam';
+        processAccessions('sam-dump', $toolpath, ($extension eq '.sam' || $extension eq '.bam') ? '--output-file' : undef, $extension, @params, @args);
     }
     else {
         toolHelp('sam-dump', $toolpath);
@@ -1070,6 +1075,8 @@ RUNNING_AS_PREFETCH:
         '--order' => TRUE,
         '--ascp-path' => TRUE,
         '--ascp-options' => TRUE,
+        '--connections' => TRUE,
+        '--jobs' => TRUE,
         '--output-file' => TRUE,
         '--output-directory' => TRUE,
         '--ngc' => TRUE,
@@ -1162,6 +1169,7 @@ RUNNING_AS_SRA_PILEUP:
         '--duplicates' => TRUE,
         '--minmismatch' => TRUE,
         '--merge-dist' => TRUE,
+        '--threads' => TRUE,
         '--function' => TRUE,        
         '--ngc' => TRUE,
         '--log-level' => TRUE,
@@ -107,6 +107,7 @@ ArgsInfo infoFor(int toolID)
                     { "-c", "--curcache" },
                     { "-e", "--threads" },
                     { "-f", "--force" },
+                    { "-g", "--gzip" },
                     { "-h", "--help" },
                     { "-m", "--mem" },
                     { "-o", "--outfile" },
@@ -151,17 +152,21 @@ ArgsInfo infoFor(int toolID)
                 },
                 {
                     { "--aligned-region", "TRUE" },
+                    { "--bam-index", "TRUE" },
+                    { "--bam-threads", "TRUE" },
                     { "--cursor-cache", "TRUE" },
                     { "--debug", "TRUE" },
                     { "--header-comment", "TRUE" },
                     { "--header-file", "TRUE" },
                     { "--log-level", "TRUE" },
+                    { "--mate-cache-min-dist", "TRUE" },
                     { "--matepair-distance", "TRUE" },
                     { "--min-mapq", "TRUE" },
                     { "--output-buffer-size", "TRUE" },
                     { "--output-file", "TRUE" },
                     { "--prefix", "TRUE" },
                     { "--qual-quant", "TRUE" },
+                    { "--ref-threads", "TRUE" },
                     { "--rna-splice-level", "TRUE" },
                     { "--rna-splice-log", "TRUE" },
                 }
@@ -193,8 +198,10 @@ ArgsInfo infoFor(int toolID)
                 {
                     { "--ascp-options", "TRUE" },
                     { "--ascp-path", "TRUE" },
+                    { "--connections", "TRUE" },
                     { "--debug", "TRUE" },
                     { "--force", "TRUE" },
+                    { "--jobs", "TRUE" },
                     { "--location", "TRUE" },
                     { "--log-level", "TRUE" },
                     { "--max-size", "TRUE" },
@@ -237,6 +244,7 @@ ArgsInfo infoFor(int toolID)
                     { "--minmismatch", "TRUE" },
                     { "--outfile", "TRUE" },
                     { "--table", "TRUE" },
+                    { "--threads", "TRUE" },
                 }
             };
         default:
@@ -497,6 +497,106 @@ rc_t cmn_iter_range( struct cmn_iter * self, uint32_t col_id )
     return rc;
 }
 
+rc_t cmn_iter_set_range( struct cmn_iter * self, int64_t first_row, uint64_t row_count )
+{
+    rc_t rc;
+    if ( NULL == self || NULL == self -> ranges )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+        ErrMsg( "cmn_iter.c cmn_iter_set_range() -> %R", rc );
+    }
+    else
+    {
+        if ( NULL != self -> row_iter )
+        {
+            num_gen_iterator_destroy( self -> row_iter );
+            self -> row_iter = NULL;
+        }
+        rc = num_gen_clear( self -> ranges );
+        if ( 0 != rc )
+        {
+            ErrMsg( "cmn_iter.c cmn_iter_set_range().num_gen_clear() -> %R\n", rc );
+        }
+        else if ( row_count > 0 )
+        {
+            rc = num_gen_add( self -> ranges, first_row, row_count );
+            if ( 0 != rc )
+            {
+                ErrMsg( "cmn_iter.c cmn_iter_set_range().num_gen_add( %ld.%lu ) -> %R\n",
+                        first_row, row_count, rc );
+            }
+        }
+        if ( 0 == rc )
+        {
+            /* first_row/row_count of the iterator are the id-range of the column ( cmn_iter_range ) */
+            rc = make_row_iter( self -> ranges, self -> first_row, self -> row_count, &self -> row_iter );
+        }
+    }
+    return rc;
+}
+
+rc_t cmn_make_blob_chunks( const cmn_params * cp, const char * tblname, const char * col_name,
+                           uint64_t rows_per_chunk, int64_t * first_row,
+                           int64_t ** chunk_ends, uint64_t * num_chunks )
+{
+    cmn_params whole = * cp;
+    struct cmn_iter * iter = NULL;
+    rc_t rc;
+
+    whole . first_row = 0;
+    whole . row_count = 0;  /* ... the whole column */
+    rc = make_cmn_iter( &whole, tblname, &iter ); /* above */
+    if ( 0 == rc )
+    {
+        uint32_t col_id;
+        rc = cmn_iter_add_column( iter, col_name, &col_id ); /* above */
+        if ( 0 == rc )
+        {
+            rc = cmn_iter_range( iter, col_id ); /* above */
+        }
+        if ( 0 == rc )
+        {
+            int64_t last_row = iter -> first_row + iter -> row_count - 1;
+            uint64_t max_chunks = ( iter -> row_count + rows_per_chunk - 1 ) / rows_per_chunk;
+            int64_t * ends = malloc( ( max_chunks + 1 ) * sizeof ends[ 0 ] );
+            if ( NULL == ends )
+            {
+                rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+                ErrMsg( "cmn_iter.c cmn_make_blob_chunks().malloc( %lu chunks ) -> %R", max_chunks, rc );
+            }
+            else
+            {
+                uint64_t count = 0;
+                int64_t row = iter -> first_row;
+                while ( row <= last_row )
+                {
+                    int64_t end = row + rows_per_chunk - 1;
+                    if ( end >= last_row )
+                    {
+                        end = last_row;
+                    }
+                    else
+                    {
+                        int64_t blob_first, blob_last;
+                        if ( 0 == VCursorPageIdRange( iter -> cursor, col_id, end, &blob_first, &blob_last ) &&
+                             blob_last > end )
+                        {
+                            /* extend the chunk to the end of the blob, no blob is decoded by 2 threads */
+                            end = ( blob_last < last_row ) ? blob_last : last_row;
+                        }
+                    }
+                    ends[ count++ ] = end;
+                    row = end + 1;
+                }
+                *first_row = iter -> first_row;
+                *chunk_ends = ends;
+                *num_chunks = count;
+            }
+        }
+        destroy_cmn_iter( iter ); /* above */
+    }
+    return rc;
+}
 
 rc_t cmn_read_uint64( struct cmn_iter * self, uint32_t col_id, uint64_t *value )
 {
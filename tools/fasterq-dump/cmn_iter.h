@@ -52,6 +52,10 @@ rc_t make_cmn_iter( const cmn_params * cp, const char * tblname, struct cmn_iter
 rc_t cmn_iter_add_column( struct cmn_iter * self, const char * name, uint32_t * id );
 rc_t cmn_iter_range( struct cmn_iter * selfr, uint32_t col_id );
 
+/* re-targets an iterator ( after cmn_iter_range ) to a new slice of rows,
+   the cursor stays open and keeps its cached blobs */
+rc_t cmn_iter_set_range( struct cmn_iter * self, int64_t first_row, uint64_t row_count );
+
 bool cmn_iter_next( struct cmn_iter * self, rc_t * rc );
 int64_t cmn_iter_row_id( const struct cmn_iter * self );
 
@@ -84,6 +88,13 @@ rc_t cmn_check_db_column( KDirectory * dir, const VDBManager * vdb_mgr,
                           const char * accession_short, const char * accession_path,
                           const char * tbl_name, const char * col_name,  bool * present );
 
+/* splits the rows of a table into chunks of about rows_per_chunk rows, each chunk is extended
+   to the end of the blob of the given column its nominal end falls into - a chunk never splits a blob.
+   *chunk_ends is allocated here ( free() it ), it holds the last row-id of each chunk */
+rc_t cmn_make_blob_chunks( const cmn_params * cp, const char * tblname, const char * col_name,
+                           uint64_t rows_per_chunk, int64_t * first_row,
+                           int64_t ** chunk_ends, uint64_t * num_chunks );
+
 VNamelist * cmn_get_table_names( KDirectory * dir, const VDBManager * vdb_mgr,
                                  const char * accession_short,
                                  const char * accession_path );
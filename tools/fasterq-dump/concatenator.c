@@ -27,6 +27,7 @@
 #include "concatenator.h"
 #include "helper.h"
 #include "copy_machine.h"
+#include "../../shared/bgzf_pool.h"
 
 #include <klib/out.h>
 #include <klib/printf.h>
@@ -353,6 +354,73 @@ rc_t execute_concat_un_compressed( KDirectory * dir,
 }
 
 
+/* ----------------------------------------------------------------------------------
+    the join-threads have already compressed their output into gzip-blocks ( bgzf_pool.c ),
+    a byte-wise concatenation of these files is a valid gzip-file, we only have to add
+    the end-of-file block
+   ---------------------------------------------------------------------------------- */
+
+static rc_t append_bgzf_eof( KDirectory * dir, const char * filename )
+{
+    uint64_t size;
+    rc_t rc = KDirectoryFileSize ( dir, &size, "%s", filename );
+    if ( 0 != rc )
+    {
+        ErrMsg( "concatenator.c append_bgzf_eof() KDirectoryFileSize( '%s' ) -> %R", filename, rc );
+    }
+    else
+    {
+        struct KFile * dst;
+        rc = KDirectoryOpenFileWrite ( dir, &dst, true, "%s", filename );
+        if ( 0 != rc )
+        {
+            ErrMsg( "concatenator.c append_bgzf_eof() KDirectoryOpenFileWrite( '%s' ) -> %R", filename, rc );
+        }
+        else
+        {
+            rc = bgzf_write_eof( dst, size ); /* bgzf_pool.c */
+            {
+                rc_t rc2 = KFileRelease( dst );
+                if ( 0 != rc2 )
+                {
+                    ErrMsg( "concatenator.c append_bgzf_eof().KFileRelease() -> %R", rc2 );
+                    rc = ( 0 == rc ) ? rc2 : rc;
+                }
+            }
+        }
+    }
+    return rc;
+}
+
+static rc_t execute_concat_gzip_blocks( KDirectory * dir,
+                    const char * output_filename,
+                    const struct VNamelist * files,
+                    size_t buf_size,
+                    struct bg_progress * progress,
+                    bool force,
+                    bool append,
+                    uint32_t count,
+                    uint32_t q_wait_time )
+{
+    char gz_filename[ 4096 ];
+    size_t num_writ;
+    rc_t rc = string_printf( gz_filename, sizeof gz_filename, &num_writ, ct_gzip_fmt, output_filename );
+    if ( 0 != rc )
+    {
+        ErrMsg( "concatenator.c execute_concat_gzip_blocks().string_printf() -> %R", rc );
+    }
+    else
+    {
+        rc = execute_concat_un_compressed( dir, gz_filename, files, buf_size,
+                        progress, force, append, count, q_wait_time ); /* above */
+        if ( 0 == rc )
+        {
+            rc = append_bgzf_eof( dir, gz_filename ); /* above */
+        }
+    }
+    return rc;
+}
+
 /* ---------------------------------------------------------------------------------- */
 
 rc_t execute_concat( KDirectory * dir,
@@ -373,7 +441,12 @@ rc_t execute_concat( KDirectory * dir,
     else if ( count > 0 )
     {
         uint32_t q_wait_time = 500;
-        if ( ct_none != compress )
+        if ( ct_gzip == compress )
+        {
+            rc = execute_concat_gzip_blocks( dir, output_filename, files, buf_size,
+                        progress, force, append, count, q_wait_time ); /* above */
+        }
+        else if ( ct_none != compress )
         {
             rc = execute_concat_compressed( dir, output_filename, files, buf_size,
                         progress, force, append, compress, count, q_wait_time ); /* above */
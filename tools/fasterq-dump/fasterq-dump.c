@@ -32,8 +32,10 @@
 #include "concatenator.h"
 #include "cleanup_task.h"
 #include "lookup_reader.h"
+#include "lookup_store.h"
 #include "raw_read_iter.h"
 #include "temp_dir.h"
+#include "planner.h"
 
 #include <kapp/main.h>
 #include <kapp/args.h>
@@ -77,7 +79,7 @@ static const char * curcache_usage[] = { "size of cursor-cache dflt=10MB", NULL
 #define OPTION_CURCACHE "curcache"
 #define ALIAS_CURCACHE  "c"
 
-static const char * mem_usage[] = { "memory limit for sorting dflt=100MB", NULL };
+static const char * mem_usage[] = { "memory limit for sorting dflt=chosen from available RAM", NULL };
 #define OPTION_MEM      "mem"
 #define ALIAS_MEM       "m"
 
@@ -85,7 +87,7 @@ static const char * temp_usage[] = { "where to put temp. files dflt=curr dir", N
 #define OPTION_TEMP     "temp"
 #define ALIAS_TEMP      "t"
 
-static const char * threads_usage[] = { "how many thread dflt=6", NULL };
+static const char * threads_usage[] = { "how many thread dflt=number of cores", NULL };
 #define OPTION_THREADS  "threads"
 #define ALIAS_THREADS   "e"
 
@@ -112,11 +114,11 @@ static const char * stdout_usage[] = { "print output to stdout", NULL };
 #define OPTION_STDOUT    "stdout"
 #define ALIAS_STDOUT     "Z"
 
-/*
-static const char * gzip_usage[] = { "compress output using gzip", NULL };
+static const char * gzip_usage[] = { "compress output using gzip ( in parallel, BGZF-compatible )", NULL };
 #define OPTION_GZIP      "gzip"
 #define ALIAS_GZIP       "g"
 
+/*
 static const char * bzip2_usage[] = { "compress output using bzip2", NULL };
 #define OPTION_BZIP2     "bzip2"
 #define ALIAS_BZIP2      "z"
@@ -165,6 +167,9 @@ static const char * append_usage[] = { "append to output-file", NULL };
 static const char * ngc_usage[] = { "PATH to ngc file", NULL };
 #define OPTION_NGC   "ngc"
 
+static const char * skip_space_usage[] = { "do not refuse to start if the estimated disk-space is not available", NULL };
+#define OPTION_SKIP_SPACE   "skip-space-check"
+
 /* ---------------------------------------------------------------------------------- */
 
 OptDef ToolOptions[] =
@@ -184,7 +189,7 @@ OptDef ToolOptions[] =
     { OPTION_SPLIT_3,   ALIAS_SPLIT_3,   NULL, split_3_usage,    1, false,  false },
     { OPTION_WHOLE_SPOT,    NULL,        NULL, whole_spot_usage, 1, false,  false },    
     { OPTION_STDOUT,    ALIAS_STDOUT,    NULL, stdout_usage,     1, false,  false },
-/*    { OPTION_GZIP,      ALIAS_GZIP,      NULL, gzip_usage,       1, false,  false }, */
+    { OPTION_GZIP,      ALIAS_GZIP,      NULL, gzip_usage,       1, false,  false },
 /*    { OPTION_BZIP2,     ALIAS_BZIP2,     NULL, bzip2_usage,      1, false,  false }, */
 /*    { OPTION_MAXFD,     ALIAS_MAXFD,     NULL, maxfd_usage,      1, true,   false }, */
     { OPTION_FORCE,     ALIAS_FORCE,     NULL, force_usage,      1, false,  false },
@@ -198,6 +203,7 @@ OptDef ToolOptions[] =
     { OPTION_BASE_FLT,  ALIAS_BASE_FLT,  NULL, base_flt_usage,   10, true,  false },
     { OPTION_APPEND,    ALIAS_APPEND,    NULL, append_usage,     1, false,  false },
     { OPTION_NGC,       NULL,            NULL, ngc_usage,        1, true,   false },
+    { OPTION_SKIP_SPACE,NULL,            NULL, skip_space_usage, 1, false,  false },
 };
 
 /* ----------------------------------------------------------------------------------- */
@@ -282,6 +288,8 @@ typedef struct tool_ctx_t
     char dflt_output[ DFLT_PATH_LEN ];
     
     struct KFastDumpCleanupTask * cleanup_task; /* cleanup_task.h */
+
+    struct lookup_store * lookup_store; /* lookup_store.h ( in-memory mode only ) */
     
     size_t cursor_cache, buf_size, mem_limit;
 
@@ -293,6 +301,8 @@ typedef struct tool_ctx_t
     compress_t compress; /* helper.h */ 
 
     bool force, show_progress, show_details, append, use_stdout;
+
+    bool choose_mem_limit, choose_num_threads, skip_space_check; /* for the planner ( planner.h ) */
     
     join_options join_options; /* helper.h */
 } tool_ctx_t;
@@ -367,7 +377,11 @@ static rc_t show_details( tool_ctx_t * tool_ctx )
     }
     if ( 0 == rc )
     {
-        rc = KOutMsg( "stdout-mode  : '%s'\n", tool_ctx -> append ? "YES" : "NO" );
+        rc = KOutMsg( "stdout-mode  : '%s'\n", tool_ctx -> use_stdout ? "YES" : "NO" );
+    }
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "compression  : '%s'\n", ct_gzip == tool_ctx -> compress ? "gzip-blocks" : "NO" );
     }
     return rc;
 }
@@ -382,11 +396,8 @@ static void get_user_input( tool_ctx_t * tool_ctx, const Args * args )
 {
     bool split_spot, split_file, split_3, whole_spot;
 
-#if 0
-    tool_ctx -> compress = get_compress_t( get_bool_option( args, OPTION_GZIP ),
-                                            get_bool_option( args, OPTION_BZIP2 ) );
-#endif
-    tool_ctx -> compress = ct_none;
+    /* bzip2 is not supported, gzip is produced in blocks by the join-threads */
+    tool_ctx -> compress = get_compress_t( get_bool_option( args, OPTION_GZIP ), false ); /* helper.c */
 
     tool_ctx -> cursor_cache = get_size_t_option( args, OPTION_CURCACHE, DFLT_CUR_CACHE );
     tool_ctx -> show_progress = get_bool_option( args, OPTION_PROGRESS );
@@ -398,6 +409,10 @@ static void get_user_input( tool_ctx_t * tool_ctx, const Args * args )
     tool_ctx -> buf_size = get_size_t_option( args, OPTION_BUFSIZE, DFLT_BUF_SIZE );
     tool_ctx -> mem_limit = get_size_t_option( args, OPTION_MEM, DFLT_MEM_LIMIT );
     tool_ctx -> num_threads = get_uint32_t_option( args, OPTION_THREADS, DFLT_NUM_THREADS );
+    /* if not given by the user, the planner chooses them from the available resources */
+    tool_ctx -> choose_mem_limit = !get_bool_option( args, OPTION_MEM );
+    tool_ctx -> choose_num_threads = !get_bool_option( args, OPTION_THREADS );
+    tool_ctx -> skip_space_check = get_bool_option( args, OPTION_SKIP_SPACE );
 
     tool_ctx -> join_options . rowid_as_name = get_bool_option( args, OPTION_RIDN );
     tool_ctx -> join_options . skip_tech = !( get_bool_option( args, OPTION_INCL_TECH ) );
@@ -478,6 +493,9 @@ static void encforce_constrains( tool_ctx_t * tool_ctx )
         tool_ctx -> force = false;
         tool_ctx -> append = false;
     }
+
+    /* the join-threads have to know if they compress their output ( bgzf_pool.c ) */
+    tool_ctx -> join_options . compress = tool_ctx -> compress;
 }
 
 static rc_t handle_accession( tool_ctx_t * tool_ctx )
@@ -779,7 +797,7 @@ static rc_t produce_lookup_files( tool_ctx_t * tool_ctx )
                                 gap ); /* merge_sorter.c */
     }
 
-    /* the background-vector-merger catches the KVectors produced by
+    /* the background-vector-merger catches the lookup-stores produced by
        the lookup-produceer */
     if ( 0 == rc )
     {
@@ -800,10 +818,10 @@ static rc_t produce_lookup_files( tool_ctx_t * tool_ctx )
     reading SEQ_SPOT_ID, SEQ_READ_ID and RAW_READ
     SEQ_SPOT_ID and SEQ_READ_ID is merged into a 64-bit-key
     RAW_READ is read as 4na-unpacked ( Schema does not provide 4na-packed for this column )
-    these key-pairs are temporarely stored in a KVector until a limit is reached
-    after that limit is reached they are pushed to the background-vector-merger
-    This KVector looks like this:
-    content: [KEY][RAW_READ]
+    these key-pairs are temporarely stored in a lookup-store until a limit is reached
+    after that limit is reached the store is sorted and pushed to the background-vector-merger
+    This lookup-store looks like this ( lookup_store.h ):
+    content: array of [KEY][PTR] + arena of [RAW_READ]
     KEY... 64-bit value as SEQ_SPOT_ID shifted left by 1 bit, zero-bit contains SEQ_READ_ID
     RAW_READ... 16-bit binary-chunk-lenght, followed by n bytes of packed 4na
 -------------------------------------------------------------------------------------------- */
@@ -844,6 +862,126 @@ static rc_t produce_lookup_files( tool_ctx_t * tool_ctx )
 }
 
 
+/* --------------------------------------------------------------------------------------------
+    in-memory mode: if the whole lookup fits into the memory the producers would use for sorting
+    anyway ( mem-limit per thread ), it is kept as one sorted in-memory store, shared by the
+    join-threads, and no temp-files are written / merged / read back for the lookup
+-------------------------------------------------------------------------------------------- */
+
+static rc_t produce_lookup_in_mem( tool_ctx_t * tool_ctx )
+{
+    rc_t rc = execute_lookup_production_in_mem( tool_ctx -> dir,
+                                                tool_ctx -> vdb_mgr,
+                                                tool_ctx -> accession_short,
+                                                tool_ctx -> accession_path,
+                                                tool_ctx -> cursor_cache,
+                                                tool_ctx -> buf_size,
+                                                tool_ctx -> num_threads,
+                                                tool_ctx -> show_progress,
+                                                &( tool_ctx -> lookup_store ) ); /* sorter.c */
+    if ( 0 != rc )
+    {
+        ErrMsg( "fasterq-dump.c produce_lookup_in_mem() -> %R", rc );
+    }
+    else
+    {
+        /* there are no lookup-files, the join uses the store */
+        tool_ctx -> lookup_filename[ 0 ] = 0;
+        tool_ctx -> index_filename[ 0 ] = 0;
+    }
+    return rc;
+}
+
+/* --------------------------------------------------------------------------------------------
+    the planner looks at the accession and the machine before any work is done ( planner.h ):
+    it chooses threads and mem-limit ( if not given by the user ), decides if the lookup
+    can stay in memory and refuses to start if the scratch- or output-volume is too small
+-------------------------------------------------------------------------------------------- */
+
+static rc_t check_planned_space( tool_ctx_t * tool_ctx, const resource_plan * plan )
+{
+    rc_t rc = 0;
+    if ( !plan -> enough_space )
+    {
+        if ( tool_ctx -> skip_space_check )
+        {
+            ErrMsg( "fasterq-dump.c check_planned_space() : disk-space may not be sufficient, continuing anyway" );
+        }
+        else
+        {
+            rc = RC( rcExe, rcFile, rcPacking, rcSize, rcInsufficient );
+            if ( plan -> scratch_total > 0 && plan -> scratch_needed > plan -> scratch_free )
+            {
+                ErrMsg( "not enough space on scratch-path '%s' : %,lu bytes needed, %,lu bytes free ( use --%s to choose another one )",
+                        get_temp_dir( tool_ctx -> temp_dir ), plan -> scratch_needed, plan -> scratch_free, OPTION_TEMP );
+            }
+            else
+            {
+                ErrMsg( "not enough space for output-file '%s' : %,lu bytes needed, %,lu bytes free",
+                        tool_ctx -> output_filename, plan -> output_needed, plan -> output_free );
+            }
+            ErrMsg( "the space needed is an estimate, use --%s to try anyway", OPTION_SKIP_SPACE );
+        }
+    }
+    return rc;
+}
+
+static rc_t plan_resources( tool_ctx_t * tool_ctx, const char * seq_tbl_name, bool needs_lookup,
+                            bool * in_mem_lookup )
+{
+    resource_plan plan;
+    resource_request request;
+    rc_t rc;
+
+    request . dir = tool_ctx -> dir;
+    request . vdb_mgr = tool_ctx -> vdb_mgr;
+    request . accession_short = tool_ctx -> accession_short;
+    request . accession_path = tool_ctx -> accession_path;
+    request . seq_tbl_name = seq_tbl_name;
+    request . scratch_path = get_temp_dir( tool_ctx -> temp_dir );
+    request . output_path = tool_ctx -> use_stdout ? NULL : tool_ctx -> output_filename;
+    request . cursor_cache = tool_ctx -> cursor_cache;
+    request . buf_size = tool_ctx -> buf_size;
+    request . mem_limit = tool_ctx -> mem_limit;
+    request . num_threads = tool_ctx -> num_threads;
+    request . choose_mem_limit = tool_ctx -> choose_mem_limit;
+    request . choose_num_threads = tool_ctx -> choose_num_threads;
+    request . total_ram = tool_ctx -> total_ram;
+    request . fmt = tool_ctx -> fmt;
+    request . compress = tool_ctx -> compress;
+    request . needs_lookup = needs_lookup;
+
+    rc = make_resource_plan( &request, &plan ); /* planner.c */
+    if ( 0 != rc )
+    {
+        ErrMsg( "fasterq-dump.c plan_resources() -> %R", rc );
+    }
+    else
+    {
+        tool_ctx -> num_threads = plan . num_threads;
+        tool_ctx -> mem_limit = plan . mem_limit;
+        if ( NULL != in_mem_lookup )
+        {
+            *in_mem_lookup = plan . in_mem_lookup;
+        }
+
+        if ( tool_ctx -> show_details )
+        {
+            rc = show_details( tool_ctx ); /* above */
+            if ( 0 == rc )
+            {
+                rc = print_resource_plan( &plan ); /* planner.c */
+            }
+        }
+
+        if ( 0 == rc )
+        {
+            rc = check_planned_space( tool_ctx, &plan ); /* above */
+        }
+    }
+    return rc;
+}
+
 /* -------------------------------------------------------------------------------------------- */
 
 
@@ -875,17 +1013,22 @@ static rc_t produce_final_db_output( tool_ctx_t * tool_ctx )
                            &stats,
                            &tool_ctx -> lookup_filename[ 0 ],
                            &tool_ctx -> index_filename[ 0 ],
+                           tool_ctx -> lookup_store,
                            tool_ctx -> temp_dir,
                            registry,
                            tool_ctx -> cursor_cache,
                            tool_ctx -> buf_size,
                            tool_ctx -> num_threads,
                            tool_ctx -> show_progress,
+                           tool_ctx -> use_stdout,
                            tool_ctx -> fmt,
                            & tool_ctx -> join_options ); /* join.c */
     }
 
-    /* from now on we do not need the lookup-file and it's index any more... */
+    /* from now on we do not need the lookup-file and it's index ( or the lookup-store ) any more... */
+    release_lookup_store( tool_ctx -> lookup_store ); /* lookup_store.c ( ignores NULL ) */
+    tool_ctx -> lookup_store = NULL;
+
     if ( 0 != tool_ctx -> lookup_filename[ 0 ] )
     {
         KDirectoryRemove( tool_ctx -> dir, true, "%s", &tool_ctx -> lookup_filename[ 0 ] );
@@ -899,13 +1042,8 @@ static rc_t produce_final_db_output( tool_ctx_t * tool_ctx )
     /* STEP 4 : concatenate output-chunks */
     if ( 0 == rc )
     {
-        if ( tool_ctx -> use_stdout )
-        {
-            rc = temp_registry_to_stdout( registry,
-                                          tool_ctx -> dir,
-                                          tool_ctx -> buf_size ); /* temp_registry.c */
-        }
-        else
+        /* in stdout-mode the join-threads have streamed the output already ( stream_ring.c ) */
+        if ( !tool_ctx -> use_stdout )
         {
             rc = temp_registry_merge( registry,
                               tool_ctx -> dir,
@@ -995,27 +1133,35 @@ static rc_t check_output_exits( tool_ctx_t * tool_ctx )
 
 static rc_t fastdump_csra( tool_ctx_t * tool_ctx )
 {
-    rc_t rc = 0;
-    
-    if ( tool_ctx -> show_details )
-    {
-        rc = show_details( tool_ctx ); /* above */
-    }
+    bool in_mem_lookup = false;
+    rc_t rc = check_output_exits( tool_ctx ); /* above */
 
     if ( 0 == rc )
     {
-        rc = check_output_exits( tool_ctx ); /* above */
+        rc = plan_resources( tool_ctx, dflt_seq_tabl_name, true, &in_mem_lookup ); /* above */
     }
 
+    tool_ctx -> lookup_store = NULL;
     if ( 0 == rc )
     {
-        rc = produce_lookup_files( tool_ctx ); /* above */
+        if ( in_mem_lookup )
+        {
+            rc = produce_lookup_in_mem( tool_ctx ); /* above */
+        }
+        else
+        {
+            rc = produce_lookup_files( tool_ctx ); /* above */
+        }
     }
 
     if ( 0 == rc )
     {
         rc = produce_final_db_output( tool_ctx ); /* above */
     }
+    else
+    {
+        release_lookup_store( tool_ctx -> lookup_store ); /* lookup_store.c ( ignores NULL ) */
+    }
     return rc;
 }
 
@@ -1024,20 +1170,17 @@ static rc_t fastdump_csra( tool_ctx_t * tool_ctx )
 
 static rc_t fastdump_table( tool_ctx_t * tool_ctx, const char * tbl_name )
 {
-    rc_t rc = 0;
+    rc_t rc;
     struct temp_registry * registry = NULL;
     join_stats stats;
     
     clear_join_stats( &stats ); /* helper.c */
     
-    if ( tool_ctx -> show_details )
-    {
-        rc = show_details( tool_ctx ); /* above */
-    }
+    rc = check_output_exits( tool_ctx ); /* above */
 
     if ( 0 == rc )
     {
-        rc = check_output_exits( tool_ctx ); /* above */
+        rc = plan_resources( tool_ctx, tbl_name, false, NULL ); /* above */
     }
 
     if ( 0 == rc )
@@ -1059,19 +1202,15 @@ static rc_t fastdump_table( tool_ctx_t * tool_ctx, const char * tbl_name )
                            tool_ctx -> buf_size,
                            tool_ctx -> num_threads,
                            tool_ctx -> show_progress,
+                           tool_ctx -> use_stdout,
                            tool_ctx -> fmt,
                            & tool_ctx -> join_options ); /* tbl_join.c */
     }
 
     if ( 0 == rc )
     {
-        if ( tool_ctx -> use_stdout )
-        {
-            rc = temp_registry_to_stdout( registry,
-                                          tool_ctx -> dir,
-                                          tool_ctx -> buf_size ); /* temp_registry.c */
-        }
-        else
+        /* in stdout-mode the join-threads have streamed the output already ( stream_ring.c ) */
+        if ( !tool_ctx -> use_stdout )
         {
             rc = temp_registry_merge( registry,
                               tool_ctx -> dir,
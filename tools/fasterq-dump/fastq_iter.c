@@ -311,6 +311,11 @@ uint64_t get_row_count_of_fastq_csra_iter( struct fastq_csra_iter * self )
     return cmn_iter_row_count( self -> cmn );
 }
 
+rc_t set_range_of_fastq_csra_iter( struct fastq_csra_iter * self, int64_t first_row, uint64_t row_count )
+{
+    return cmn_iter_set_range( self -> cmn, first_row, row_count ); /* cmn_iter.h */
+}
+
 /* ------------------------------------------------------------------------------------------------------------- */
 
 typedef struct fastq_sra_iter
@@ -498,3 +503,8 @@ uint64_t get_row_count_of_fastq_sra_iter( struct fastq_sra_iter * self )
 {
     return cmn_iter_row_count( self -> cmn );
 }
+
+rc_t set_range_of_fastq_sra_iter( struct fastq_sra_iter * self, int64_t first_row, uint64_t row_count )
+{
+    return cmn_iter_set_range( self -> cmn, first_row, row_count ); /* cmn_iter.h */
+}
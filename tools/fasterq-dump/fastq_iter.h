@@ -74,6 +74,7 @@ rc_t make_fastq_csra_iter( const cmn_params * params,
                          
 bool get_from_fastq_csra_iter( struct fastq_csra_iter * self, fastq_rec * rec, rc_t * rc );
 uint64_t get_row_count_of_fastq_csra_iter( struct fastq_csra_iter * self );
+rc_t set_range_of_fastq_csra_iter( struct fastq_csra_iter * self, int64_t first_row, uint64_t row_count );
 
 struct fastq_sra_iter;
 
@@ -85,6 +86,7 @@ rc_t make_fastq_sra_iter( const cmn_params * params,
 
 bool get_from_fastq_sra_iter( struct fastq_sra_iter * self, fastq_rec * rec, rc_t * rc );
 uint64_t get_row_count_of_fastq_sra_iter( struct fastq_sra_iter * self );
+rc_t set_range_of_fastq_sra_iter( struct fastq_sra_iter * self, int64_t first_row, uint64_t row_count );
 
 #ifdef __cplusplus
 }
@@ -1439,7 +1439,7 @@ static rc_t locked_vector_unlock( const locked_vector * self, const char * funct
 void locked_vector_release( locked_vector * self,
                             void ( CC * whack ) ( void *item, void *data ), void *data )
 {
-    if ( NULL == self )
+    if ( NULL != self )
     {
         rc_t rc = KLockAcquire ( self -> lock );
         if ( 0 != rc )
@@ -84,6 +84,10 @@ typedef struct join_stats
     uint64_t reads_invalid;
 } join_stats;
 
+typedef enum format_t { ft_unknown, ft_special, ft_whole_spot,
+                        ft_fastq_split_spot, ft_fastq_split_file, ft_fastq_split_3 } format_t;
+typedef enum compress_t { ct_none, ct_gzip, ct_bzip2 } compress_t;
+
 typedef struct join_options
 {
     bool rowid_as_name;
@@ -93,6 +97,7 @@ typedef struct join_options
     bool terminate_on_invalid;
     uint32_t min_read_len;
     const char * filter_bases;
+    compress_t compress;    /* ct_gzip: the join-threads write blocks of gzip ( bgzf_pool.h ) */
 } join_options;
 
 typedef struct tmp_id
@@ -115,10 +120,6 @@ typedef struct part_head
     uint32_t total, len, part, padd;
 } part_head;
 
-typedef enum format_t { ft_unknown, ft_special, ft_whole_spot,
-                        ft_fastq_split_spot, ft_fastq_split_file, ft_fastq_split_3 } format_t;
-typedef enum compress_t { ct_none, ct_gzip, ct_bzip2 } compress_t;
-
 typedef struct cmn_params
 {
     const KDirectory * dir;
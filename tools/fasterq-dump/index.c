@@ -33,6 +33,7 @@ typedef struct index_writer
 {
     struct KFile * f;
     uint64_t frequency, pos, last_key;
+    uint64_t next_key;      /* dense only: the key the next offset-slot belongs to */
 } index_writer;
 
 
@@ -79,6 +80,32 @@ static rc_t write_key_and_offset( index_writer * writer, uint64_t key, uint64_t
 }
 
 
+static rc_t write_dense_key( index_writer * writer, uint64_t key, uint64_t offset )
+{
+    rc_t rc = 0;
+    if ( key < writer -> next_key )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcWriting, rcId, rcOutoforder );
+        ErrMsg( "index.c write_dense_key( %lu ) after %lu -> %R", key, writer -> next_key, rc );
+    }
+    else
+    {
+        /* fill the slots of the keys that are not in the lookup-file */
+        while ( 0 == rc && writer -> next_key < key )
+        {
+            rc = write_value( writer, INDEX_NO_OFFSET );
+            writer -> next_key++;
+        }
+        if ( 0 == rc )
+        {
+            rc = write_value( writer, offset );
+            writer -> next_key++;
+            writer -> last_key = key;
+        }
+    }
+    return rc;
+}
+
 rc_t write_key( struct index_writer * writer, uint64_t key, uint64_t offset )
 {
     rc_t rc = 0;
@@ -87,6 +114,10 @@ rc_t write_key( struct index_writer * writer, uint64_t key, uint64_t offset )
         rc = RC( rcVDB, rcNoTarg, rcReading, rcParam, rcInvalid );
         ErrMsg( "index.c write_key() -> %R", rc );
     }
+    else if ( INDEX_DENSE == writer -> frequency )
+    {
+        rc = write_dense_key( writer, key, offset );
+    }
     else
     {
         if ( key > ( writer -> last_key + writer -> frequency ) )
@@ -117,7 +148,7 @@ static rc_t make_index_writer_obj( struct index_writer ** writer,
         w -> f = f;
         w -> frequency = frequency;
         rc = write_value( w, frequency );
-        if ( 0 == rc )
+        if ( 0 == rc && INDEX_DENSE != frequency )
         {
             rc = write_key_and_offset( w, 1, 0 );
         }
@@ -312,6 +343,43 @@ static uint64_t key_to_pos_guess( const index_reader * self, uint64_t key )
     return ( ( sizeof self -> frequency ) + ( chunk_id * ( 2 * ( sizeof self -> frequency ) ) ) );
 }
 
+bool index_is_dense( const index_reader * self )
+{
+    return ( NULL != self && INDEX_DENSE == self -> frequency );
+}
+
+static rc_t get_dense_offset( const index_reader * self,
+                              uint64_t key_to_find,
+                              uint64_t * key_found,
+                              uint64_t * offset )
+{
+    rc_t rc;
+    uint64_t pos = ( sizeof self -> frequency ) + ( key_to_find * ( sizeof *offset ) );
+    if ( key_to_find > self -> max_key || pos >= self -> file_size )
+    {
+        rc = SILENT_RC( rcVDB, rcNoTarg, rcReading, rcId, rcNotFound );
+    }
+    else
+    {
+        uint64_t value;
+        rc = KFileReadExactly( self -> f, pos, ( void * )&value, sizeof value );
+        if ( 0 != rc )
+        {
+            ErrMsg( "index.c get_dense_offset().KFileReadExactly( at %lu ) failed %R", pos, rc );
+        }
+        else if ( INDEX_NO_OFFSET == value )
+        {
+            rc = SILENT_RC( rcVDB, rcNoTarg, rcReading, rcId, rcNotFound );
+        }
+        else
+        {
+            *key_found = key_to_find;
+            *offset = value;
+        }
+    }
+    return rc;
+}
+
 rc_t get_nearest_offset( const index_reader * self,
                          uint64_t key_to_find,
                          uint64_t * key_found,
@@ -323,6 +391,10 @@ rc_t get_nearest_offset( const index_reader * self,
         rc = RC( rcVDB, rcNoTarg, rcReading, rcParam, rcInvalid );
         ErrMsg( "index.c get_nearest_offset() -> %R", rc );
     }
+    else if ( INDEX_DENSE == self -> frequency )
+    {
+        rc = get_dense_offset( self, key_to_find, key_found, offset ); /* above */
+    }
     else if ( self -> file_size <= 24 )
     {
         rc = SILENT_RC( rcVDB, rcNoTarg, rcReading, rcId, rcNotFound );
@@ -427,6 +499,12 @@ rc_t get_max_key( const index_reader * self, uint64_t * max_key )
     {
         *max_key = self -> max_key;
     }
+    else if ( INDEX_DENSE == self -> frequency )
+    {
+        /* one slot per key, starting with key 0 */
+        uint64_t slots = ( self -> file_size - ( sizeof self -> frequency ) ) / ( sizeof self -> frequency );
+        *max_key = ( slots > 0 ) ? slots - 1 : 0;
+    }
     else
     {
         uint64_t data[ 6 ];
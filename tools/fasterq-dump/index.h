@@ -45,6 +45,17 @@ extern "C" {
 
 #define DFLT_INDEX_FREQUENCY 20000
 
+/* ---------------------------------------------------------------------------------------------
+    passing INDEX_DENSE as frequency to make_index_writer() produces a dense index:
+    the file starts with INDEX_DENSE instead of the frequency, followed by one 64-bit offset
+    for every key ( key = row-id * 2 + read-id - 1, see make_key() in helper.c ) from 0 to the
+    max. key, INDEX_NO_OFFSET marks keys that are not in the lookup-file.
+    get_nearest_offset() on a dense index is a single read of 8 bytes, it always returns the
+    exact key ( or not-found ), no forward scan in the lookup-file is needed
+--------------------------------------------------------------------------------------------- */
+#define INDEX_DENSE 0xFFFFFFFFFFFFFFFF
+#define INDEX_NO_OFFSET 0xFFFFFFFFFFFFFFFF
+
 struct index_writer;
 
 void release_index_writer( struct index_writer * writer );
@@ -62,6 +73,8 @@ rc_t get_nearest_offset( const struct index_reader * reader, uint64_t key_to_fin
 
 rc_t get_max_key( const struct index_reader * reader, uint64_t * max_key );
 
+bool index_is_dense( const struct index_reader * reader );
+
 #ifdef __cplusplus
 }
 #endif
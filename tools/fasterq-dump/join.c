@@ -32,6 +32,7 @@
 #include "fastq_iter.h"
 #include "cleanup_task.h"
 #include "join_results.h"
+#include "stream_ring.h"
 #include "progress_thread.h"
 
 #include <klib/out.h>
@@ -47,6 +48,8 @@ typedef struct join
     struct join_results * results;  /* join_results.h */
     SBuffer B1, B2;                 /* helper.h */
     uint64_t loop_nr;               /* in which loop of this partial join are we? */
+    struct fastq_csra_iter * fastq_iter;    /* fastq_iter.h ( kept open over all chunks of a thread ) */
+    struct special_iter * special_iter;     /* special_iter.h ( dito ) */
     uint32_t thread_id;             /* in which thread are we? */
     bool cmp_read_present;          /* do we have a cmp-read column? */
 } join;
@@ -60,6 +63,8 @@ static void release_join_ctx( join * j )
         release_lookup_reader( j -> lookup );     /* lookup_reader.c */
         release_SBuffer( &( j -> B1 ) );          /* helper.c */
         release_SBuffer( &( j -> B2 ) );          /* helper.c */
+        destroy_fastq_csra_iter( j -> fastq_iter );  /* fastq_iter.c ( ignores NULL ) */
+        destroy_special_iter( j -> special_iter );   /* special_iter.c ( ignores NULL ) */
     }
 }
 
@@ -67,6 +72,7 @@ static rc_t init_join( cmn_params * cp,
                        struct join_results * results,
                        const char * lookup_filename,
                        const char * index_filename,
+                       const struct lookup_store * lookup_store,
                        size_t buf_size,
                        bool cmp_read_present,
                        struct join * j )
@@ -80,22 +86,33 @@ static rc_t init_join( cmn_params * cp,
     j -> B1 . S . addr = NULL;
     j -> B2 . S . addr = NULL;
     j -> loop_nr = 0;
+    j -> fastq_iter = NULL;
+    j -> special_iter = NULL;
     j -> cmp_read_present = cmp_read_present;
     
-    if ( NULL != index_filename )
+    if ( NULL != lookup_store )
     {
-        if ( file_exists( cp -> dir, "%s", index_filename ) )
-        {
-            rc = make_index_reader( cp -> dir, &j -> index, buf_size, "%s", index_filename ); /* index.c */
-        }
+        /* in-memory mode: the lookup-store is shared, no files to open */
+        j -> index = NULL;
+        rc = make_lookup_reader_from_store( lookup_store, &( j -> lookup ) ); /* lookup_reader.c */
     }
     else
     {
-        j -> index = NULL;
-    }
+        if ( NULL != index_filename )
+        {
+            if ( file_exists( cp -> dir, "%s", index_filename ) )
+            {
+                rc = make_index_reader( cp -> dir, &j -> index, buf_size, "%s", index_filename ); /* index.c */
+            }
+        }
+        else
+        {
+            j -> index = NULL;
+        }
 
-    rc = make_lookup_reader( cp -> dir, j -> index, &( j -> lookup ), buf_size,
-                             "%s", lookup_filename ); /* lookup_reader.c */
+        rc = make_lookup_reader( cp -> dir, j -> index, &( j -> lookup ), buf_size,
+                                 "%s", lookup_filename ); /* lookup_reader.c */
+    }
     if ( 0 == rc )
     {
         rc = make_SBuffer( &( j -> B1 ), 4096 );  /* helper.c */
@@ -124,6 +141,38 @@ static rc_t init_join( cmn_params * cp,
     return rc;
 }
 
+/* the first call opens the iterator ( schema, db, table, cursor ), every later call ( next stream-chunk )
+   just moves the existing one to the new slice of rows - the cursor keeps its cache and the open blobs */
+static rc_t join_fastq_iter( join * j, cmn_params * cp, fastq_iter_opt opt, struct fastq_csra_iter ** iter )
+{
+    rc_t rc;
+    if ( NULL == j -> fastq_iter )
+    {
+        rc = make_fastq_csra_iter( cp, opt, &( j -> fastq_iter ) ); /* fastq_iter.c */
+    }
+    else
+    {
+        rc = set_range_of_fastq_csra_iter( j -> fastq_iter, cp -> first_row, cp -> row_count ); /* fastq_iter.c */
+    }
+    *iter = j -> fastq_iter;
+    return rc;
+}
+
+static rc_t join_special_iter( join * j, cmn_params * cp, struct special_iter ** iter )
+{
+    rc_t rc;
+    if ( NULL == j -> special_iter )
+    {
+        rc = make_special_iter( cp, &( j -> special_iter ) ); /* special_iter.c */
+    }
+    else
+    {
+        rc = set_range_of_special_iter( j -> special_iter, cp -> first_row, cp -> row_count ); /* special_iter.c */
+    }
+    *iter = j -> special_iter;
+    return rc;
+}
+
 /* ------------------------------------------------------------------------------------------ */
 
 static rc_t print_special_1_read( special_rec * rec, join * j )
@@ -912,7 +961,7 @@ static rc_t perform_special_join( cmn_params * cp,
                                   struct bg_progress * progress )
 {
     struct special_iter * iter;
-    rc_t rc = make_special_iter( cp, &iter ); /* special_iter.c */
+    rc_t rc = join_special_iter( j, cp, &iter ); /* above */
     if ( 0 == rc )
     {
         special_rec rec;
@@ -939,11 +988,10 @@ static rc_t perform_special_join( cmn_params * cp,
         {
             set_quitting();     /* helper.c */
         }
-        destroy_special_iter( iter ); /* special_iter.c */
     }
     else
     {
-        ErrMsg( "perform_special_join().make_special_iter() -> %R", rc );
+        ErrMsg( "perform_special_join().join_special_iter() -> %R", rc );
     }
     return rc;
 }
@@ -963,10 +1011,10 @@ static rc_t perform_whole_spot_join( cmn_params * cp,
     opt . with_read_type = true;
     opt . with_cmp_read = j -> cmp_read_present;
     
-    rc = make_fastq_csra_iter( cp, opt, &iter ); /* fastq-iter.c */
+    rc = join_fastq_iter( j, cp, opt, &iter ); /* above */
     if ( 0 != rc )
     {
-        ErrMsg( "perform_fastq_join().make_fastq_csra_iter() -> %R", rc );
+        ErrMsg( "perform_fastq_join().join_fastq_iter() -> %R", rc );
     }
     else
     {
@@ -1008,7 +1056,6 @@ static rc_t perform_whole_spot_join( cmn_params * cp,
                 bg_progress_inc( progress ); /* progress_thread.c (ignores NULL) */
             }
         }
-        destroy_fastq_csra_iter( iter ); /* fastq-iter.c */
     }
     return rc;
 }
@@ -1027,10 +1074,10 @@ static rc_t perform_fastq_split_spot_join( cmn_params * cp,
     opt . with_read_type = true;
     opt . with_cmp_read = j -> cmp_read_present;
 
-    rc = make_fastq_csra_iter( cp, opt, &iter ); /* fastq-iter.c */
+    rc = join_fastq_iter( j, cp, opt, &iter ); /* above */
     if ( 0 != rc )
     {
-        ErrMsg( "perform_fastq_split_spot_join().make_fastq_csra_iter() -> %R", rc );
+        ErrMsg( "perform_fastq_split_spot_join().join_fastq_iter() -> %R", rc );
     }
     else
     {
@@ -1065,7 +1112,6 @@ static rc_t perform_fastq_split_spot_join( cmn_params * cp,
                 bg_progress_inc( progress ); /* progress_thread.c (ignores NULL) */
             }
         }
-        destroy_fastq_csra_iter( iter ); /* fastq-iter.c */
     }
     return rc;
 }
@@ -1084,10 +1130,10 @@ static rc_t perform_fastq_split_file_join( cmn_params * cp,
     opt . with_read_type = true;
     opt . with_cmp_read = j -> cmp_read_present;
     
-    rc = make_fastq_csra_iter( cp, opt, &iter ); /* fastq-iter.c */
+    rc = join_fastq_iter( j, cp, opt, &iter ); /* above */
     if ( 0 != rc )
     {
-        ErrMsg( "perform_fastq_split_file_join().make_fastq_csra_iter() -> %R", rc );
+        ErrMsg( "perform_fastq_split_file_join().join_fastq_iter() -> %R", rc );
     }
     else
     {
@@ -1133,7 +1179,6 @@ static rc_t perform_fastq_split_file_join( cmn_params * cp,
                 bg_progress_inc( progress ); /* progress_thread.c (ignores NULL) */
             }
         }
-        destroy_fastq_csra_iter( iter );
     }
     return rc;
 }
@@ -1152,10 +1197,10 @@ static rc_t perform_fastq_split_3_join( cmn_params * cp,
     opt . with_read_type = true;
     opt . with_cmp_read = j -> cmp_read_present;
     
-    rc = make_fastq_csra_iter( cp, opt, &iter ); /* fastq-iter.c */
+    rc = join_fastq_iter( j, cp, opt, &iter ); /* above */
     if ( 0 != rc )
     {
-        ErrMsg( "perform_fastq_split_3_join().make_fastq_csra_iter() -> %R", rc );
+        ErrMsg( "perform_fastq_split_3_join().join_fastq_iter() -> %R", rc );
     }
     else
     {
@@ -1203,8 +1248,6 @@ static rc_t perform_fastq_split_3_join( cmn_params * cp,
                 bg_progress_inc( progress ); /* progress_thread.c (ignores NULL) */
             }
         }
-        destroy_fastq_csra_iter( iter );
-
         if ( 0 == rc && 0 != rc_iter )
         {
             rc = rc_iter;
@@ -1228,8 +1271,10 @@ typedef struct join_thread_data
     const char * accession_short;
     const char * lookup_filename;
     const char * index_filename;
+    const struct lookup_store * lookup_store;
     struct bg_progress * progress;
     struct temp_registry * registry;
+    struct stream_ring * stream;    /* stream_ring.h ( NULL if not streaming to stdout ) */
     KThread * thread;
     
     int64_t first_row;
@@ -1244,6 +1289,61 @@ typedef struct join_thread_data
     
 } join_thread_data;
 
+static rc_t perform_join( join_thread_data * jtd, cmn_params * cp, join * j )
+{
+    rc_t rc = 0;
+    switch ( jtd -> fmt )
+    {
+        case ft_special             : rc = perform_special_join( cp,
+                                                j,
+                                                jtd -> progress ); break;
+
+        case ft_whole_spot          : rc = perform_whole_spot_join( cp,
+                                                &jtd -> stats,
+                                                j,
+                                                jtd -> progress,
+                                                jtd -> join_options ); break;
+
+        case ft_fastq_split_spot    : rc = perform_fastq_split_spot_join( cp,
+                                                &jtd -> stats,
+                                                j,
+                                                jtd -> progress,
+                                                jtd -> join_options ); break;
+
+        case ft_fastq_split_file    : rc = perform_fastq_split_file_join( cp,
+                                                &jtd -> stats,
+                                                j,
+                                                jtd -> progress,
+                                                jtd -> join_options ); break;
+
+        case ft_fastq_split_3       : rc = perform_fastq_split_3_join( cp,
+                                                &jtd -> stats,
+                                                j,
+                                                jtd -> progress,
+                                                jtd -> join_options ); break;
+
+        default : break;
+    }
+    return rc;
+}
+
+/* stream-mode: the thread works on small chunks handed out by the stream-ring, instead of one slice */
+static rc_t perform_join_chunks( join_thread_data * jtd, cmn_params * cp, join * j )
+{
+    rc_t rc = 0;
+    uint64_t chunk_id;
+    while ( 0 == rc &&
+            stream_ring_next_chunk( jtd -> stream, &chunk_id, &cp -> first_row, &cp -> row_count, &rc ) ) /* stream_ring.c */
+    {
+        rc = perform_join( jtd, cp, j ); /* above */
+        if ( 0 == rc )
+        {
+            rc = join_results_to_stream( j -> results, jtd -> stream, chunk_id ); /* join_results.c */
+        }
+    }
+    return rc;
+}
+
 static rc_t CC cmn_thread_func( const KThread * self, void * data )
 {
     join_thread_data * jtd = data;
@@ -1252,13 +1352,14 @@ static rc_t CC cmn_thread_func( const KThread * self, void * data )
     rc_t rc = make_join_results( jtd -> dir,
                                 &results,
                                 jtd -> registry,
-                                jtd -> part_file,
+                                ( NULL != jtd -> stream ) ? NULL : jtd -> part_file,
                                 jtd -> accession_short,
                                 jtd -> buf_size,
                                 4096,
                                 jtd -> join_options -> print_read_nr,
                                 jtd -> join_options -> print_name,
-                                jtd -> join_options -> filter_bases );
+                                jtd -> join_options -> filter_bases,
+                                jtd -> join_options -> compress );
 
     if ( 0 == rc && NULL != results )
     {
@@ -1270,6 +1371,7 @@ static rc_t CC cmn_thread_func( const KThread * self, void * data )
                         results,
                         jtd -> lookup_filename,
                         jtd -> index_filename,
+                        jtd -> lookup_store,
                         jtd -> buf_size,
                         jtd -> cmp_read_present,
                         &j ); /* above */
@@ -1277,42 +1379,23 @@ static rc_t CC cmn_thread_func( const KThread * self, void * data )
         {
             j . thread_id = jtd -> thread_id;
 
-            switch ( jtd -> fmt )
+            if ( NULL != jtd -> stream )
+            {
+                rc = perform_join_chunks( jtd, &cp, &j ); /* above */
+            }
+            else
             {
-                case ft_special             : rc = perform_special_join( &cp,
-                                                        &j,
-                                                        jtd -> progress ); break;
-
-                case ft_whole_spot          : rc = perform_whole_spot_join( &cp,
-                                                        &jtd -> stats,
-                                                        &j,
-                                                        jtd -> progress,
-                                                        jtd -> join_options ); break;
-
-                case ft_fastq_split_spot    : rc = perform_fastq_split_spot_join( &cp,
-                                                        &jtd -> stats,
-                                                        &j,
-                                                        jtd -> progress,
-                                                        jtd -> join_options ); break;
-
-                case ft_fastq_split_file    : rc = perform_fastq_split_file_join( &cp,
-                                                        &jtd -> stats,
-                                                        &j,
-                                                        jtd -> progress,
-                                                        jtd -> join_options ); break;
-
-                case ft_fastq_split_3       : rc = perform_fastq_split_3_join( &cp,
-                                                        &jtd -> stats,
-                                                        &j,
-                                                        jtd -> progress,
-                                                        jtd -> join_options ); break;
-
-                default : break;
+                rc = perform_join( jtd, &cp, &j ); /* above */
             }
             release_join_ctx( &j );
         }
         destroy_join_results( results );
     }
+    if ( 0 != rc )
+    {
+        /* the writer and the other threads must not wait for a chunk this thread will never deliver */
+        stream_ring_abort( jtd -> stream ); /* stream_ring.c ( ignores NULL ) */
+    }
     return rc;
 }
 
@@ -1323,12 +1406,14 @@ rc_t execute_db_join( KDirectory * dir,
                     join_stats * stats,
                     const char * lookup_filename,
                     const char * index_filename,
+                    const struct lookup_store * lookup_store,
                     const struct temp_dir * temp_dir,
                     struct temp_registry * registry,
                     size_t cur_cache,
                     size_t buf_size,
                     uint32_t num_threads,
                     bool show_progress,
+                    bool to_stdout,
                     format_t fmt,
                     const join_options * join_options )
 {
@@ -1344,13 +1429,17 @@ rc_t execute_db_join( KDirectory * dir,
     if ( rc == 0 )
     {
         uint64_t row_count = 0;
-        bool name_column_present, cmp_read_column_present;
+        bool name_column_present, cmp_read_column_present, quality_column_present = false;
 
         rc = cmn_check_db_column( dir, vdb_mgr, accession_short, accession_path, "SEQUENCE", "NAME", &name_column_present ); /* cmn_iter.c */
         if ( 0 == rc )
         {
             rc = cmn_check_db_column( dir, vdb_mgr, accession_short, accession_path, "SEQUENCE", "CMP_READ", &cmp_read_column_present ); /* cmn_iter.c */
         }
+        if ( 0 == rc && to_stdout )
+        {
+            rc = cmn_check_db_column( dir, vdb_mgr, accession_short, accession_path, "SEQUENCE", "QUALITY", &quality_column_present ); /* cmn_iter.c */
+        }
 
         rc = extract_csra_row_count( dir, vdb_mgr, accession_short, accession_path, cur_cache, &row_count );
         if ( 0 == rc && row_count > 0 )
@@ -1360,6 +1449,7 @@ rc_t execute_db_join( KDirectory * dir,
             uint32_t thread_id;
             uint64_t rows_per_thread;
             struct bg_progress * progress = NULL;
+            struct stream_ring * stream = NULL;
             struct join_options corrected_join_options;
 
             VectorInit( &threads, 0, num_threads );
@@ -1371,6 +1461,7 @@ rc_t execute_db_join( KDirectory * dir,
             corrected_join_options . min_read_len = join_options -> min_read_len;
             corrected_join_options . filter_bases = join_options -> filter_bases;
             corrected_join_options . terminate_on_invalid = join_options -> terminate_on_invalid;
+            corrected_join_options . compress = join_options -> compress;
 
             if ( row_count < ( num_threads * 100 ) )
             {
@@ -1387,6 +1478,25 @@ rc_t execute_db_join( KDirectory * dir,
                 rc = bg_progress_make( &progress, row_count, 0, 0 ); /* progress_thread.c */
             }
 
+            if ( 0 == rc && to_stdout )
+            {
+                /* no temp-files: the threads hand their chunks to the ring, it writes them in order,
+                   the chunks end at blob-boundaries, so no blob has to be decoded by 2 threads,
+                   without qualities the blobs of ( CMP_)READ are used */
+                cmn_params cp = { dir, vdb_mgr, accession_short, accession_path, 0, 0, cur_cache };
+                const char * chunk_col = quality_column_present ? "QUALITY" : ( cmp_read_column_present ? "CMP_READ" : "READ" );
+                int64_t first_row;
+                int64_t * chunk_ends = NULL;
+                uint64_t num_chunks = 0;
+                rc = cmn_make_blob_chunks( &cp, "SEQUENCE", chunk_col, DFLT_STREAM_CHUNK_ROWS,
+                                           &first_row, &chunk_ends, &num_chunks ); /* cmn_iter.c */
+                if ( 0 == rc )
+                {
+                    /* the chunks are big: allow each thread one chunk in flight and a little slack */
+                    rc = make_stream_ring( &stream, first_row, chunk_ends, num_chunks, num_threads + 2 ); /* stream_ring.c */
+                }
+            }
+
             for ( thread_id = 0; 0 == rc && thread_id < num_threads; ++thread_id )
             {
                 join_thread_data * jtd = calloc( 1, sizeof * jtd );
@@ -1402,12 +1512,14 @@ rc_t execute_db_join( KDirectory * dir,
                     jtd -> accession_short  = accession_short;
                     jtd -> lookup_filename  = lookup_filename;
                     jtd -> index_filename   = index_filename;
+                    jtd -> lookup_store     = lookup_store;
                     jtd -> first_row        = row;
                     jtd -> row_count        = rows_per_thread;
                     jtd -> cur_cache        = cur_cache;
                     jtd -> buf_size         = buf_size;
                     jtd -> progress         = progress;
                     jtd -> registry         = registry;
+                    jtd -> stream           = stream;
                     jtd -> fmt              = fmt;
                     jtd -> join_options     = &corrected_join_options;
                     jtd -> thread_id        = thread_id;
@@ -1436,6 +1548,12 @@ rc_t execute_db_join( KDirectory * dir,
                 }
             }
 
+            if ( 0 != rc )
+            {
+                /* not all threads could be started, do not let the started ones wait for chunks */
+                stream_ring_abort( stream ); /* stream_ring.c ( ignores NULL ) */
+            }
+
             {
                 /* collect the threads, and add the join_stats */
                 uint32_t i, n = VectorLength( &threads );
@@ -1459,6 +1577,13 @@ rc_t execute_db_join( KDirectory * dir,
                 }
                 VectorWhack ( &threads, NULL, NULL );
             }
+
+            if ( NULL != stream )
+            {
+                /* all join-threads are done, wait for the writer to forward the last chunks */
+                rc_t rc2 = wait_for_and_release_stream_ring( stream ); /* stream_ring.c */
+                rc = ( 0 == rc ) ? rc2 : rc;
+            }
             bg_progress_release( progress ); /* progress_thread.c ( ignores NULL )*/
         }
     }
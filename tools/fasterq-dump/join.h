@@ -55,6 +55,10 @@ extern "C" {
 #include "temp_registry.h"
 #endif
 
+#ifndef _h_lookup_store_
+#include "lookup_store.h"
+#endif
+
 rc_t execute_db_join( KDirectory * dir,
                     const VDBManager * vdb_mgr,
                     const char * accession_path,
@@ -62,12 +66,14 @@ rc_t execute_db_join( KDirectory * dir,
                     join_stats * stats,
                     const char * lookup_filename,
                     const char * index_filename,
+                    const struct lookup_store * lookup_store, /* NULL: use the lookup-file */
                     const struct temp_dir * temp_dir,
                     struct temp_registry * registry,
                     size_t cur_cache,
                     size_t buf_size,
                     uint32_t num_threads,
                     bool show_progress,
+                    bool to_stdout, /* stream to stdout, no temp-files for the output */
                     format_t fmt,
                     const join_options * join_options );
 
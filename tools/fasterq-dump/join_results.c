@@ -24,14 +24,19 @@
 *
 */
 #include "join_results.h"
+#include "../../shared/bgzf_pool.h"
+#include "stream_ring.h"
 #include "helper.h"
 #include <klib/vector.h>
 #include <klib/printf.h>
 #include <kfs/buffile.h>
 
+#include <string.h>
+
 typedef struct join_printer
 {
     struct KFile * f;
+    struct bgzf_pool * gz;      /* NULL if not compressing, bgzf_pool.h */
     uint64_t file_pos;
 } join_printer;
 
@@ -65,7 +70,10 @@ typedef struct join_results
     print_v2 v2_print_name_not_null;    
     SBuffer print_buffer;   /* we have only one print_buffer... */
     Vector printers;
+    char * stream_data;     /* stream-mode ( no output_base ): the output of the current chunk */
+    size_t stream_size, stream_allocated;
     size_t buffer_size;
+    compress_t compress;
     bool print_frag_nr, print_name;
 } join_results;
 
@@ -74,6 +82,15 @@ static void CC destroy_join_printer( void * item, void * data )
     if ( NULL != item )
     {
         join_printer * p = item;
+        if ( NULL != p -> gz )
+        {
+            rc_t rc = bgzf_pool_sync( p -> gz ); /* bgzf_pool.c */
+            if ( 0 != rc )
+            {
+                ErrMsg( "destroy_join_printer().bgzf_pool_sync() -> %R", rc );
+            }
+            release_bgzf_pool( p -> gz ); /* bgzf_pool.c */
+        }
         if ( NULL != p -> f )
         {
             rc_t rc = KFileRelease( p -> f );
@@ -92,6 +109,10 @@ void destroy_join_results( join_results * self )
     {
         VectorWhack ( &self -> printers, destroy_join_printer, NULL );
         release_SBuffer( &self -> print_buffer );
+        if ( NULL != self -> stream_data )
+        {
+            free( ( void * ) self -> stream_data );
+        }
         if ( NULL != self -> buf2na )
         {
             release_Buf2NA( self -> buf2na );
@@ -427,7 +448,8 @@ rc_t make_join_results( struct KDirectory * dir,
                         size_t print_buffer_size,
                         bool print_frag_nr,
                         bool print_name,
-                        const char * filter_bases )
+                        const char * filter_bases,
+                        compress_t compress )
 {
     rc_t rc = 0;
     struct Buf2NA * buf2na = NULL;
@@ -458,6 +480,7 @@ rc_t make_join_results( struct KDirectory * dir,
             p -> print_frag_nr = print_frag_nr;
             p -> print_name = print_name;
             p -> buf2na = buf2na;
+            p -> compress = compress;
             
             /* available:
                 print_v1_no_name_no_frag_nr()       print_v2_no_name_no_frag_nr()
@@ -608,7 +631,19 @@ static rc_t make_join_printer( join_results * self, uint32_t read_id, join_print
                     else
                     {
                         p -> f = f;
-                        *printer = p;
+                        if ( ct_gzip == self -> compress )
+                        {
+                            /* each join-thread compresses its own output-file, no extra threads */
+                            rc = make_bgzf_pool( &( p -> gz ), f, 0, 0, BGZF_DFLT_LEVEL, false ); /* bgzf_pool.c */
+                        }
+                        if ( 0 == rc )
+                        {
+                            *printer = p;
+                        }
+                        else
+                        {
+                            destroy_join_printer( p, NULL );
+                        }
                     }
                 }
             }
@@ -617,6 +652,86 @@ static rc_t make_join_printer( join_results * self, uint32_t read_id, join_print
     return rc;
 }
 
+static rc_t append_to_stream( join_results * self, const char * src, size_t size )
+{
+    rc_t rc = 0;
+    if ( self -> stream_size + size > self -> stream_allocated )
+    {
+        size_t new_size = ( 0 == self -> stream_allocated ) ? ( 1024 * 1024 ) : self -> stream_allocated * 2;
+        char * tmp;
+        while ( self -> stream_size + size > new_size )
+        {
+            new_size *= 2;
+        }
+        tmp = realloc( self -> stream_data, new_size );
+        if ( NULL == tmp )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcWriting, rcMemory, rcExhausted );
+            ErrMsg( "join_results.c append_to_stream().realloc( %lu ) -> %R", new_size, rc );
+        }
+        else
+        {
+            self -> stream_data = tmp;
+            self -> stream_allocated = new_size;
+        }
+    }
+    if ( 0 == rc )
+    {
+        memmove( &( self -> stream_data[ self -> stream_size ] ), src, size );
+        self -> stream_size += size;
+    }
+    return rc;
+}
+
+static rc_t join_results_print_to_stream( join_results * self, const char * fmt, va_list args )
+{
+    bool done = false;
+    uint32_t cnt = 4;
+    rc_t rc = 0;
+
+    while ( 0 == rc && !done && cnt-- > 0 )
+    {
+        va_list args_copy;
+        va_copy( args_copy, args );
+        rc = print_to_SBufferV( & self -> print_buffer, fmt, args_copy );
+        va_end( args_copy );
+
+        done = ( 0 == rc );
+        if ( !done )
+        {
+            rc = try_to_enlarge_SBuffer( & self -> print_buffer, rc );
+        }
+    }
+    if ( 0 != rc )
+    {
+        ErrMsg( "join_results_print_to_stream().failed to enlarge buffer -> %R", rc );
+    }
+    else
+    {
+        rc = append_to_stream( self, self -> print_buffer . S . addr, self -> print_buffer . S . size ); /* above */
+    }
+    return rc;
+}
+
+rc_t join_results_to_stream( struct join_results * self, struct stream_ring * ring, uint64_t chunk_id )
+{
+    rc_t rc = 0;
+    if ( NULL == self || NULL == ring )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcWriting, rcParam, rcNull );
+        ErrMsg( "join_results_to_stream() -> %R", rc );
+    }
+    else
+    {
+        /* the ring owns the data now, the next chunk starts with a fresh allocation */
+        rc = stream_ring_put( ring, chunk_id, self -> stream_data, self -> stream_size ); /* stream_ring.c */
+        self -> stream_data = NULL;
+        self -> stream_size = 0;
+        self -> stream_allocated = 0;
+    }
+    return rc;
+}
+
 rc_t join_results_print( struct join_results * self, uint32_t read_id, const char * fmt, ... )
 {
     rc_t rc = 0;
@@ -630,6 +745,14 @@ rc_t join_results_print( struct join_results * self, uint32_t read_id, const cha
         rc = RC( rcVDB, rcNoTarg, rcWriting, rcParam, rcNull );
         ErrMsg( "join_results_print() -> %R", rc );
     }
+    else if ( NULL == self -> output_base )
+    {
+        /* stream-mode: all reads go into one buffer per chunk, in the order they are printed */
+        va_list args;
+        va_start ( args, fmt );
+        rc = join_results_print_to_stream( self, fmt, args ); /* above */
+        va_end ( args );
+    }
     else
     {
         join_printer * p = VectorGet ( &self -> printers, read_id );
@@ -670,6 +793,12 @@ rc_t join_results_print( struct join_results * self, uint32_t read_id, const cha
             {
                 ErrMsg( "join_results_print().failed to enlarge buffer -> %R", rc );
             }
+            else if ( NULL != p -> gz )
+            {
+                /* the bgzf-pool tracks the file-position itself */
+                rc = bgzf_pool_write( p -> gz, self -> print_buffer . S . addr,
+                                      self -> print_buffer . S . size ); /* bgzf_pool.c */
+            }
             else
             {
                 size_t num_writ, to_write;
@@ -46,6 +46,10 @@ extern "C" {
 #include "temp_registry.h"
 #endif
 
+#ifndef _h_stream_ring_
+#include "stream_ring.h"
+#endif
+
 struct join_results;
 
 void destroy_join_results( struct join_results * self );
@@ -59,7 +63,12 @@ rc_t make_join_results( struct KDirectory * dir,
                         size_t print_buffer_size,
                         bool print_frag_nr,
                         bool print_name,
-                        const char * filter_bases );
+                        const char * filter_bases,
+                        compress_t compress );
+
+/* if output_base is NULL, the results are collected in memory ( stream-mode ),
+   and handed over to the stream-ring after each chunk */
+rc_t join_results_to_stream( struct join_results * self, struct stream_ring * ring, uint64_t chunk_id );
 
 bool join_results_match( struct join_results * self, const String * bases );
 bool join_results_match2( struct join_results * self, const String * bases1, const String * bases2 );
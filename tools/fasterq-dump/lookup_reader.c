@@ -25,6 +25,7 @@
 */
 
 #include "lookup_reader.h"
+#include "lookup_store.h"
 #include "file_printer.h"
 #include "helper.h"
 
@@ -39,8 +40,10 @@ typedef struct lookup_reader
 {
     const struct KFile * f;
     const struct index_reader * index;
+    const struct lookup_store * store;  /* lookup_store.h ( in-memory mode, f and index are NULL ) */
     SBuffer buf;
     uint64_t pos, f_size, max_key;
+    uint64_t store_idx;                 /* the cursor into the store, in-memory mode only */
 } lookup_reader;
 
 
@@ -103,6 +106,32 @@ static rc_t make_lookup_reader_obj( struct lookup_reader ** reader,
     return rc;
 }
 
+rc_t make_lookup_reader_from_store( const struct lookup_store * store, struct lookup_reader ** reader )
+{
+    rc_t rc = 0;
+    if ( NULL == store || NULL == reader )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+        ErrMsg( "make_lookup_reader_from_store() -> %R", rc );
+    }
+    else
+    {
+        lookup_reader * r = calloc( 1, sizeof * r );
+        if ( NULL == r )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            ErrMsg( "make_lookup_reader_from_store().calloc( %d ) -> %R", ( sizeof * r ), rc );
+        }
+        else
+        {
+            /* the store is shared read-only between all readers, every reader has its own cursor */
+            r -> store = store;
+            *reader = r;
+        }
+    }
+    return rc;
+}
+
 rc_t make_lookup_reader( const KDirectory *dir, const struct index_reader * index,
                          struct lookup_reader ** reader, size_t buf_size, const char * fmt, ... )
 {
@@ -306,12 +335,26 @@ rc_t seek_lookup_reader( struct lookup_reader * self, uint64_t key_to_find, uint
         rc = RC( rcVDB, rcNoTarg, rcReading, rcParam, rcInvalid );
         ErrMsg( "lookup_reader.c seek_lookup_reader() -> %R", rc );
     }
+    else if ( NULL != self -> store )
+    {
+        uint64_t idx = self -> store_idx;
+        if ( lookup_store_find( self -> store, key_to_find, &idx ) ) /* lookup_store.c */
+        {
+            self -> store_idx = idx;
+            *key_found = key_to_find;
+        }
+        else
+        {
+            rc = SILENT_RC( rcVDB, rcNoTarg, rcReading, rcId, rcNotFound );
+        }
+    }
     else
     {
         if ( NULL != self -> index )
         {
             rc = indexed_seek( self, key_to_find, key_found, exactly );
-            if ( 0 != rc )
+            /* a dense index knows every key: if it does not have it, the lookup-file does not have it */
+            if ( 0 != rc && !index_is_dense( self -> index ) ) /* index.c */
             {
                 rc = full_table_seek( self, key_to_find, key_found );
             }
@@ -422,7 +465,35 @@ rc_t lookup_reader_get( struct lookup_reader * self, uint64_t * key, SBuffer * p
     return rc;
 }
 
-rc_t lookup_bases( struct lookup_reader * self, int64_t row_id, uint32_t read_id, SBuffer * B, bool reverse )
+static rc_t lookup_bases_from_store( struct lookup_reader * self, int64_t row_id, uint32_t read_id,
+                                     SBuffer * B, bool reverse )
+{
+    rc_t rc;
+    uint64_t key;
+    String packed;
+    uint64_t idx = self -> store_idx;
+
+    if ( lookup_store_find( self -> store, make_key( row_id, read_id ), &idx ) ) /* lookup_store.c */
+    {
+        rc = lookup_store_get( self -> store, idx, &key, &packed ); /* lookup_store.c */
+        if ( 0 == rc )
+        {
+            /* the packed bases are unpacked straight out of the arena, no copy */
+            rc = unpack_4na( &packed, B, reverse ); /* helper.c */
+            /* the next lookup in this slice is most likely the next entry */
+            self -> store_idx = idx + 1;
+        }
+    }
+    else
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcTransfer, rcInvalid );
+        ErrMsg( "lookup_bases( %lu.%u ) ---> not found in memory", row_id, read_id );
+    }
+    return rc;
+}
+
+static rc_t lookup_bases_from_file( struct lookup_reader * self, int64_t row_id, uint32_t read_id,
+                                    SBuffer * B, bool reverse )
 {
     int64_t found_row_id;
     uint32_t found_read_id;
@@ -490,6 +561,20 @@ rc_t lookup_bases( struct lookup_reader * self, int64_t row_id, uint32_t read_id
     return rc;
 }
 
+rc_t lookup_bases( struct lookup_reader * self, int64_t row_id, uint32_t read_id, SBuffer * B, bool reverse )
+{
+    rc_t rc;
+    if ( NULL != self -> store )
+    {
+        rc = lookup_bases_from_store( self, row_id, read_id, B, reverse ); /* above */
+    }
+    else
+    {
+        rc = lookup_bases_from_file( self, row_id, read_id, B, reverse ); /* above */
+    }
+    return rc;
+}
+
 
 rc_t lookup_check( struct lookup_reader * self )
 {
@@ -48,6 +48,10 @@ extern "C" {
 #include "index.h"
 #endif
 
+#ifndef _h_lookup_store_
+#include "lookup_store.h"
+#endif
+
 struct lookup_reader;
 
 void release_lookup_reader( struct lookup_reader * self );
@@ -55,6 +59,10 @@ void release_lookup_reader( struct lookup_reader * self );
 rc_t make_lookup_reader( const KDirectory *dir, const struct index_reader * index,
                          struct lookup_reader ** reader, size_t buf_size, const char * fmt, ... );
 
+/* a reader on top of a sorted in-memory lookup-store, only seek_lookup_reader() and lookup_bases()
+   are supported, the store is not owned by the reader and has to outlive it */
+rc_t make_lookup_reader_from_store( const struct lookup_store * store, struct lookup_reader ** reader );
+
 rc_t seek_lookup_reader( struct lookup_reader * self, uint64_t key, uint64_t * key_found, bool exactly );
 
 rc_t lookup_reader_get( struct lookup_reader * self, uint64_t * key, SBuffer * packed_bases );
@@ -0,0 +1,432 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "lookup_store.h"
+#include "helper.h"
+
+#include <klib/sort.h>
+
+#include <string.h>
+
+#define DFLT_STORE_BLOCK_SIZE ( 4 * 1024 * 1024 )
+#define DFLT_STORE_ENTRIES 4096
+#define MAX_PACKED_BASES_SIZE ( 2 + ( 0xFFFF + 1 ) / 2 )
+
+typedef struct lookup_store_entry
+{
+    uint64_t key;
+    const uint8_t * packed;     /* points into one of the blocks */
+} lookup_store_entry;
+
+typedef struct lookup_store
+{
+    lookup_store_entry * entries;
+    uint64_t num_entries, entries_allocated;
+
+    uint8_t ** blocks;          /* the arena, every block has block_size bytes */
+    uint32_t num_blocks, blocks_allocated;
+    size_t block_size;
+    size_t block_used;          /* how much of the last block is in use */
+    size_t limit;               /* 0 ... no limit, otherwise upper bound of lookup_store_size() */
+    bool sorted;
+} lookup_store;
+
+
+void release_lookup_store( lookup_store * self )
+{
+    if ( NULL != self )
+    {
+        if ( NULL != self -> blocks )
+        {
+            uint32_t i;
+            for ( i = 0; i < self -> num_blocks; ++i )
+            {
+                free( ( void * ) self -> blocks[ i ] );
+            }
+            free( ( void * ) self -> blocks );
+        }
+        if ( NULL != self -> entries )
+        {
+            free( ( void * ) self -> entries );
+        }
+        free( ( void * ) self );
+    }
+}
+
+rc_t make_lookup_store( lookup_store ** store, size_t block_size, uint64_t initial_entries, size_t limit )
+{
+    rc_t rc = 0;
+    lookup_store * s = calloc( 1, sizeof * s );
+    *store = NULL;
+    if ( NULL == s )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+        ErrMsg( "lookup_store.c make_lookup_store().calloc( %d ) -> %R", ( sizeof * s ), rc );
+    }
+    else
+    {
+        /* a block has to be able to hold the biggest possible packed read */
+        s -> block_size = ( block_size < MAX_PACKED_BASES_SIZE ) ? DFLT_STORE_BLOCK_SIZE : block_size;
+        s -> entries_allocated = ( 0 == initial_entries ) ? DFLT_STORE_ENTRIES : initial_entries;
+        s -> limit = limit;
+        s -> entries = malloc( s -> entries_allocated * sizeof s -> entries[ 0 ] );
+        if ( NULL == s -> entries )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            ErrMsg( "lookup_store.c make_lookup_store().malloc( %lu entries ) -> %R", s -> entries_allocated, rc );
+            release_lookup_store( s );
+        }
+        else
+        {
+            *store = s;
+        }
+    }
+    return rc;
+}
+
+#define STORE_FULL_RC SILENT_RC( rcVDB, rcNoTarg, rcWriting, rcBuffer, rcInsufficient )
+
+bool lookup_store_is_full( rc_t rc )
+{
+    return ( GetRCObject( rc ) == ( enum RCObject )rcBuffer && GetRCState( rc ) == rcInsufficient );
+}
+
+static size_t lookup_store_room( const lookup_store * self )
+{
+    size_t used = lookup_store_size( self );
+    return ( used < self -> limit ) ? self -> limit - used : 0;
+}
+
+static rc_t lookup_store_grow_entries( lookup_store * self )
+{
+    rc_t rc = 0;
+    uint64_t new_count = self -> entries_allocated * 2;
+    lookup_store_entry * tmp;
+    if ( self -> limit > 0 )
+    {
+        /* doubling would overshoot the limit: grow only into what is left of it */
+        uint64_t extra = lookup_store_room( self ) / sizeof self -> entries[ 0 ];
+        if ( extra < self -> entries_allocated )
+        {
+            if ( extra < 1024 )
+            {
+                return STORE_FULL_RC;
+            }
+            new_count = self -> entries_allocated + extra;
+        }
+    }
+    tmp = realloc( self -> entries, new_count * sizeof self -> entries[ 0 ] );
+    if ( NULL == tmp )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+        ErrMsg( "lookup_store.c lookup_store_grow_entries().realloc( %lu entries ) -> %R", new_count, rc );
+    }
+    else
+    {
+        self -> entries = tmp;
+        self -> entries_allocated = new_count;
+    }
+    return rc;
+}
+
+static rc_t lookup_store_new_block( lookup_store * self )
+{
+    rc_t rc = 0;
+    if ( self -> num_blocks >= self -> blocks_allocated )
+    {
+        uint32_t new_count = ( 0 == self -> blocks_allocated ) ? 16 : self -> blocks_allocated * 2;
+        uint8_t ** tmp = realloc( self -> blocks, new_count * sizeof self -> blocks[ 0 ] );
+        if ( NULL == tmp )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            ErrMsg( "lookup_store.c lookup_store_new_block().realloc( %u blocks ) -> %R", new_count, rc );
+        }
+        else
+        {
+            self -> blocks = tmp;
+            self -> blocks_allocated = new_count;
+        }
+    }
+    if ( 0 == rc )
+    {
+        uint8_t * block = NULL;
+        if ( self -> limit > 0 && self -> num_blocks > 0 && lookup_store_room( self ) < self -> block_size )
+        {
+            return STORE_FULL_RC;
+        }
+        block = malloc( self -> block_size );
+        if ( NULL == block )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            ErrMsg( "lookup_store.c lookup_store_new_block().malloc( %lu ) -> %R", self -> block_size, rc );
+        }
+        else
+        {
+            self -> blocks[ self -> num_blocks++ ] = block;
+            self -> block_used = 0;
+        }
+    }
+    return rc;
+}
+
+rc_t lookup_store_add( lookup_store * self, uint64_t key, const String * packed_bases )
+{
+    rc_t rc = 0;
+    if ( NULL == self || NULL == packed_bases || packed_bases -> size < 2 )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcWriting, rcParam, rcInvalid );
+        ErrMsg( "lookup_store.c lookup_store_add() -> %R", rc );
+    }
+    else
+    {
+        if ( self -> num_entries >= self -> entries_allocated )
+        {
+            rc = lookup_store_grow_entries( self );
+        }
+        if ( 0 == rc &&
+             ( 0 == self -> num_blocks || self -> block_used + packed_bases -> size > self -> block_size ) )
+        {
+            rc = lookup_store_new_block( self );
+        }
+        if ( 0 == rc )
+        {
+            uint8_t * dst = self -> blocks[ self -> num_blocks - 1 ] + self -> block_used;
+            lookup_store_entry * e = &( self -> entries[ self -> num_entries++ ] );
+            memmove( dst, packed_bases -> addr, packed_bases -> size );
+            self -> block_used += packed_bases -> size;
+            e -> key = key;
+            e -> packed = dst;
+            self -> sorted = false;
+        }
+    }
+    return rc;
+}
+
+static int64_t CC lookup_store_entry_cmp( const void * a, const void * b, void * data )
+{
+    const lookup_store_entry * ea = a;
+    const lookup_store_entry * eb = b;
+    if ( ea -> key < eb -> key )
+    {
+        return -1;
+    }
+    return ( ea -> key > eb -> key ) ? 1 : 0;
+}
+
+void lookup_store_sort( lookup_store * self )
+{
+    if ( NULL != self && !self -> sorted )
+    {
+        if ( self -> num_entries > 1 )
+        {
+            ksort( self -> entries, self -> num_entries, sizeof self -> entries[ 0 ],
+                   lookup_store_entry_cmp, NULL );
+        }
+        self -> sorted = true;
+    }
+}
+
+uint64_t lookup_store_count( const lookup_store * self )
+{
+    return ( NULL == self ) ? 0 : self -> num_entries;
+}
+
+size_t lookup_store_size( const lookup_store * self )
+{
+    size_t res = 0;
+    if ( NULL != self )
+    {
+        res = ( sizeof * self )
+            + ( self -> entries_allocated * sizeof self -> entries[ 0 ] )
+            + ( self -> blocks_allocated * sizeof self -> blocks[ 0 ] )
+            + ( self -> num_blocks * self -> block_size );
+    }
+    return res;
+}
+
+rc_t lookup_store_get( const lookup_store * self, uint64_t idx, uint64_t * key, String * packed_bases )
+{
+    rc_t rc = 0;
+    if ( NULL == self || NULL == key || NULL == packed_bases )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcReading, rcParam, rcInvalid );
+    }
+    else if ( idx >= self -> num_entries )
+    {
+        rc = SILENT_RC( rcVDB, rcNoTarg, rcReading, rcId, rcNotFound );
+    }
+    else
+    {
+        const lookup_store_entry * e = &( self -> entries[ idx ] );
+        uint16_t dna_len = e -> packed[ 0 ];
+        size_t size;
+        dna_len <<= 8;
+        dna_len |= e -> packed[ 1 ];
+        size = 2 + ( ( dna_len & 1 ) ? ( dna_len + 1 ) >> 1 : dna_len >> 1 );
+        StringInit( packed_bases, ( const char * )e -> packed, size, ( uint32_t )size );
+        *key = e -> key;
+    }
+    return rc;
+}
+
+rc_t lookup_store_merge( lookup_store ** sources, uint32_t count, lookup_store ** merged )
+{
+    rc_t rc = 0;
+    if ( NULL == sources || 0 == count || NULL == merged )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcWriting, rcParam, rcInvalid );
+        ErrMsg( "lookup_store.c lookup_store_merge() -> %R", rc );
+    }
+    else
+    {
+        uint64_t total_entries = 0;
+        uint32_t total_blocks = 0;
+        uint32_t i;
+        lookup_store * m;
+
+        for ( i = 0; i < count; ++i )
+        {
+            lookup_store_sort( sources[ i ] ); /* above, does nothing if already sorted */
+            total_entries += lookup_store_count( sources[ i ] );
+            total_blocks += ( NULL == sources[ i ] ) ? 0 : sources[ i ] -> num_blocks;
+        }
+
+        rc = make_lookup_store( &m, 0, ( 0 == total_entries ) ? 1 : total_entries, 0 ); /* above */
+        if ( 0 == rc && total_blocks > 0 )
+        {
+            m -> blocks = malloc( total_blocks * sizeof m -> blocks[ 0 ] );
+            if ( NULL == m -> blocks )
+            {
+                rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+                ErrMsg( "lookup_store.c lookup_store_merge().malloc( %u blocks ) -> %R", total_blocks, rc );
+                release_lookup_store( m );
+            }
+            else
+            {
+                m -> blocks_allocated = total_blocks;
+            }
+        }
+        if ( 0 == rc )
+        {
+            uint64_t * heads = calloc( count, sizeof heads[ 0 ] );
+            if ( NULL == heads )
+            {
+                rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+                ErrMsg( "lookup_store.c lookup_store_merge().calloc( %u heads ) -> %R", count, rc );
+                release_lookup_store( m );
+            }
+            else
+            {
+                /* k-way merge of the sorted entry-arrays, k is the number of producer-threads ( small ) */
+                while ( m -> num_entries < total_entries )
+                {
+                    uint32_t min_src = count;
+                    for ( i = 0; i < count; ++i )
+                    {
+                        const lookup_store * src = sources[ i ];
+                        if ( NULL != src && heads[ i ] < src -> num_entries &&
+                             ( min_src == count ||
+                               src -> entries[ heads[ i ] ] . key < sources[ min_src ] -> entries[ heads[ min_src ] ] . key ) )
+                        {
+                            min_src = i;
+                        }
+                    }
+                    m -> entries[ m -> num_entries++ ] = sources[ min_src ] -> entries[ heads[ min_src ]++ ];
+                }
+                free( ( void * ) heads );
+
+                /* the merged entries keep pointing into the arenas of the sources: move the blocks over */
+                for ( i = 0; i < count; ++i )
+                {
+                    lookup_store * src = sources[ i ];
+                    if ( NULL != src )
+                    {
+                        memmove( &( m -> blocks[ m -> num_blocks ] ), src -> blocks,
+                                 src -> num_blocks * sizeof src -> blocks[ 0 ] );
+                        m -> num_blocks += src -> num_blocks;
+                        src -> num_blocks = 0;
+                        release_lookup_store( src );
+                        sources[ i ] = NULL;
+                    }
+                }
+                /* the blocks may come with different sizes: nothing can be appended any more */
+                m -> block_used = m -> block_size;
+                m -> sorted = true;
+                *merged = m;
+            }
+        }
+    }
+    return rc;
+}
+
+bool lookup_store_find( const lookup_store * self, uint64_t key, uint64_t * idx )
+{
+    bool res = false;
+    if ( NULL != self && NULL != idx && self -> sorted && self -> num_entries > 0 )
+    {
+        uint64_t hint = *idx;
+        /* the join-threads walk the keys in ascending order: try the hint and its successor first */
+        if ( hint < self -> num_entries && self -> entries[ hint ] . key == key )
+        {
+            res = true;
+        }
+        else if ( hint + 1 < self -> num_entries && self -> entries[ hint + 1 ] . key == key )
+        {
+            *idx = hint + 1;
+            res = true;
+        }
+        else
+        {
+            uint64_t lo = 0;
+            uint64_t hi = self -> num_entries;
+            while ( lo < hi )
+            {
+                uint64_t mid = lo + ( ( hi - lo ) >> 1 );
+                if ( self -> entries[ mid ] . key < key )
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            if ( lo < self -> num_entries && self -> entries[ lo ] . key == key )
+            {
+                *idx = lo;
+                res = true;
+            }
+        }
+    }
+    return res;
+}
+
+uint64_t lookup_store_estimate( uint64_t num_entries, uint64_t avg_read_len )
+{
+    uint64_t per_entry = ( sizeof( lookup_store_entry ) ) + 2 + ( ( avg_read_len + 1 ) >> 1 );
+    /* the entries-array grows by doubling: account for the worst case of half of it unused */
+    return ( num_entries * per_entry ) + ( num_entries * sizeof( lookup_store_entry ) ) + DFLT_STORE_BLOCK_SIZE;
+}
@@ -0,0 +1,93 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_lookup_store_
+#define _h_lookup_store_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _h_klib_rc_
+#include <klib/rc.h>
+#endif
+
+#ifndef _h_klib_text_
+#include <klib/text.h>
+#endif
+
+/* ---------------------------------------------------------------------------------------------
+    the lookup-store is the in-memory container filled by the lookup-producer ( sorter.c )
+    and consumed by the background-vector-merger ( merge_sorter.c ):
+
+    - an array of ( key, pointer ) - pairs, sorted once before the hand-off
+    - a list of fixed-size blocks ( the arena ) holding the packed bases back to back,
+      every entry is in the format produced by pack_read_2_4na() in helper.c:
+      2 bytes dna-length followed by the packed 4na-bases
+
+    all memory is allocated in big pieces, there is no allocation per read,
+    and the number of bytes in use ( lookup_store_size ) is exact
+
+    in the in-memory mode the stores of all producers are merged into one sorted store,
+    which is then shared read-only by the join-threads ( lookup_reader.c )
+--------------------------------------------------------------------------------------------- */
+
+struct lookup_store;
+
+/* limit > 0 : the store never grows beyond limit bytes ( lookup_store_size ),
+   lookup_store_add() then returns an rc of rcBuffer/rcInsufficient and the caller has to spill */
+rc_t make_lookup_store( struct lookup_store ** store, size_t block_size, uint64_t initial_entries, size_t limit );
+void release_lookup_store( struct lookup_store * self );
+
+rc_t lookup_store_add( struct lookup_store * self, uint64_t key, const String * packed_bases );
+bool lookup_store_is_full( rc_t rc );
+
+/* sorts the entries by key, has to be called once before lookup_store_get() is used */
+void lookup_store_sort( struct lookup_store * self );
+
+uint64_t lookup_store_count( const struct lookup_store * self );
+size_t lookup_store_size( const struct lookup_store * self );
+
+/* the packed_bases point into the arena, they are valid as long as the store lives */
+rc_t lookup_store_get( const struct lookup_store * self, uint64_t idx,
+                       uint64_t * key, String * packed_bases );
+
+/* merges count stores into one sorted store, the arena-blocks are handed over ( not copied )
+   and the sources are released, their slots in the array are set to NULL */
+rc_t lookup_store_merge( struct lookup_store ** sources, uint32_t count, struct lookup_store ** merged );
+
+/* finds the key in a sorted store, idx is a hint on input ( the last position found )
+   and the position of the key on output */
+bool lookup_store_find( const struct lookup_store * self, uint64_t key, uint64_t * idx );
+
+/* estimates how many bytes a store needs for num_entries reads of avg_read_len bases */
+uint64_t lookup_store_estimate( uint64_t num_entries, uint64_t avg_read_len );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -24,6 +24,7 @@
 *
 */
 #include "merge_sorter.h"
+#include "lookup_store.h"
 #include "lookup_reader.h"
 #include "lookup_writer.h"
 #include "index.h"
@@ -101,8 +102,9 @@ static rc_t init_merge_sorter( merge_sorter * self,
     
     if ( NULL != index )
     {
+        /* dense: one offset per key, the join-threads seek in O(1) */
         rc = make_index_writer( dir, &( self -> idx ), buf_size,
-                        DFLT_INDEX_FREQUENCY, "%s", index ); /* index.h */
+                        INDEX_DENSE, "%s", index ); /* index.h */
     }
     else
     {
@@ -217,10 +219,11 @@ static rc_t run_merge_sorter( merge_sorter * self )
 
 /* =================================================================================
     The background-merger is composed from 1 background-thread, which is the consumer
-    of a job_q. The producer-pool in sorter.c puts KVector-instances into the queue.
+    of a job_q. The producer-pool in sorter.c puts lookup_store-instances into the queue.
+    The stores arrive already sorted ( lookup_store.c ).
     The background-merger pops the jobs out of the queue until it has assembled
     a batch of jobs. It then processes this batch by merge-sorting the content of
-    the KVector's into a temporary file. The entries are key-value pairs with a 64-bit
+    the lookup_store's into a temporary file. The entries are key-value pairs with a 64-bit
     key which is composed from the SEQID and one bit: first or second read in a spot.
     The value is the packed READ ( pack_4na() in helper.c ).
     The background-merger terminates when it's input-queue is sealed in perform_fastdump()
@@ -233,12 +236,12 @@ typedef struct background_vector_merger
 {
     KDirectory * dir;               /* needed to perform the merge-sort */
     const struct temp_dir * temp_dir; /* needed to create temp. files */
-    KQueue * job_q;                 /* the KVector objects arrive here from the lookup-producer */
+    KQueue * job_q;                 /* the lookup_store objects arrive here from the lookup-producer */
     KThread * thread;               /* the thread that performs the merge-sort */
     struct background_file_merger * file_merger;    /* below */
     struct KFastDumpCleanupTask * cleanup_task;     /* add the produced temp_files here too */
     uint32_t product_id;            /* increased by one for each batch-run, used in temp-file-name */
-    uint32_t batch_size;            /* how many KVectors have to arrive to run a batch */
+    uint32_t batch_size;            /* how many lookup_stores have to arrive to run a batch */
     uint32_t q_wait_time;           /* timeout in milliseconds to get something out of in_q */
     size_t buf_size;                /* needed to perform the merge-sort */
     struct bg_update * gap;         /* visualize the gap after the producer finished */
@@ -307,26 +310,26 @@ rc_t wait_for_and_release_background_vector_merger( background_vector_merger * s
 
 typedef struct bg_vec_merge_src
 {
-    KVector * store;
+    struct lookup_store * store;    /* lookup_store.h */
+    uint64_t idx;                   /* position of the current entry in the sorted store */
     uint64_t key;
-    const String * bases;
+    String bases;                   /* points into the arena of the store */
     rc_t rc;
 } bg_vec_merge_src;
 
 
-static rc_t init_bg_vec_merge_src( bg_vec_merge_src * src, KVector * store )
+static rc_t init_bg_vec_merge_src( bg_vec_merge_src * src, struct lookup_store * store )
 {
     src -> store = store;
-    src -> rc = KVectorGetFirstPtr ( src -> store, &( src -> key ), ( void ** )&( src -> bases ) );
+    src -> idx = 0;
+    src -> rc = lookup_store_get( src -> store, src -> idx, &( src -> key ), &( src -> bases ) ); /* lookup_store.c */
     return src -> rc;
 }
 
 static void release_bg_vec_merge_src( bg_vec_merge_src * src )
 {
-    if ( NULL != src -> store )
-    {
-        KVectorRelease( src -> store );
-    }
+    release_lookup_store( src -> store ); /* lookup_store.c ( ignores NULL ) */
+    src -> store = NULL;
 }
 
 static bg_vec_merge_src * get_min_bg_vec_merge_src( bg_vec_merge_src * batch, uint32_t count )
@@ -356,15 +359,12 @@ static rc_t write_bg_vec_merge_src( bg_vec_merge_src * src, struct lookup_writer
     rc_t rc = src -> rc;
     if ( 0 == rc )
     {
-        rc = write_packed_to_lookup_writer( writer, src -> key, src -> bases ); /* lookup_writer.c */
-        StringWhack ( src -> bases );
-        src -> bases = NULL;
+        rc = write_packed_to_lookup_writer( writer, src -> key, &( src -> bases ) ); /* lookup_writer.c */
     }
     if ( 0 == rc )
     {
-        uint64_t next_key;
-        src -> rc = KVectorGetNextPtr ( src -> store, &next_key, src -> key, ( void ** )&( src -> bases ) );
-        src -> key = next_key;
+        src -> idx += 1;
+        src -> rc = lookup_store_get( src -> store, src -> idx, &( src -> key ), &( src -> bases ) ); /* lookup_store.c */
     }
     return rc;
 }
@@ -391,7 +391,7 @@ static rc_t background_vector_merger_collect_batch( background_vector_merger * s
             rc = TimeoutInit ( &tm, self -> q_wait_time );
             if ( 0 == rc )
             {
-                KVector * store = NULL;
+                struct lookup_store * store = NULL;
                 rc = KQueuePop ( self -> job_q, ( void ** )&store, &tm );
                 if ( 0 == rc )
                 {
@@ -525,7 +525,7 @@ static rc_t CC background_vector_merger_thread_func( const KThread * thread, voi
         bg_vec_merge_src * batch = NULL;
         uint32_t count = 0;
         
-        /* Step 1 : get n = batch_size KVector's out of the in_q */
+        /* Step 1 : get n = batch_size lookup_store's out of the in_q */
         STATUS ( STAT_USR, "collecting batch" );
         rc = background_vector_merger_collect_batch( self, &batch, &count );
         STATUS ( STAT_USR, "done collectin batch: rc = %R, count = %u", rc, count );
@@ -634,7 +634,7 @@ rc_t seal_background_vector_merger( background_vector_merger * self )
     return rc;
 }
 
-rc_t push_to_background_vector_merger( background_vector_merger * self, KVector * store )
+rc_t push_to_background_vector_merger( background_vector_merger * self, struct lookup_store * store )
 {
     rc_t rc;
     bool running = true;
@@ -53,6 +53,7 @@ extern "C" {
 
 struct background_vector_merger;
 struct background_file_merger;
+struct lookup_store;
 
 /* ================================================================================= */
 
@@ -68,7 +69,8 @@ rc_t make_background_vector_merger( struct background_vector_merger ** merger,
 
 void tell_total_rowcount_to_vector_merger( struct background_vector_merger * self, uint64_t value );
 
-rc_t push_to_background_vector_merger( struct background_vector_merger * self, KVector * store );
+/* takes ownership of the ( sorted ) store, see lookup_store.h */
+rc_t push_to_background_vector_merger( struct background_vector_merger * self, struct lookup_store * store );
 
 rc_t seal_background_vector_merger( struct background_vector_merger * self );
 
@@ -0,0 +1,496 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "planner.h"
+#include "cmn_iter.h"
+#include "sorter.h"
+
+#include <klib/out.h>
+#include <klib/text.h>
+#include <kfs/file.h>
+#include <strtol.h> /* strtou64 */
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/* how many rows of the SEQUENCE-table we look at to find the average spot-length */
+#define PLAN_SAMPLE_ROWS 10000
+
+/* the same lower limits as enforced by fasterq-dump.c */
+#define PLAN_MIN_THREADS 2
+#define PLAN_MIN_MEM_LIMIT ( 1024L * 1024 * 5 )
+
+/* more threads do not help, the join is limited by the reading of the accession */
+#define PLAN_MAX_THREADS 32
+/* bigger sort-buffers do not help, less sub-files to merge do not make it much faster */
+#define PLAN_MAX_MEM_LIMIT ( 1024L * 1024 * 1024 )
+
+/* a FASTQ-defline: '@' + accession + '.' + spot-nr + ' ' + spot-name + ' length=' + read-len */
+#define PLAN_DEFLINE_OVERHEAD 32
+/* the output-size is divided by this with --gzip: deflate packs the deflines and bases of FASTQ
+   well and the qualities poorly, which ends up at about 1:3 for typical runs. Runs with binned or
+   stripped qualities compress better, so for them the estimate errs on the safe side */
+#define PLAN_GZIP_RATIO 3
+
+/* -------------------------------------------------------------------------------------------- */
+
+static uint32_t get_num_cores( void )
+{
+    uint32_t res = 0;
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    res = info . dwNumberOfProcessors;
+#else
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+    if ( n > 0 )
+    {
+        res = ( uint32_t )n;
+    }
+#endif
+    return res;
+}
+
+#if defined( __linux__ )
+/* the kernel knows better than sysconf() how much memory is available ( includes the page-cache ) */
+static uint64_t get_avail_ram_from_meminfo( KDirectory * dir )
+{
+    uint64_t res = 0;
+    const struct KFile * f;
+    rc_t rc = KDirectoryOpenFileRead( dir, &f, "/proc/meminfo" );
+    if ( 0 == rc )
+    {
+        char buffer[ 4096 ];
+        size_t num_read;
+        rc = KFileRead( f, 0, buffer, ( sizeof buffer ) - 1, &num_read );
+        if ( 0 == rc )
+        {
+            const char * key = "MemAvailable:";
+            char * found;
+            buffer[ num_read ] = 0;
+            found = strstr( buffer, key );
+            if ( NULL != found )
+            {
+                /* the value is given in kB */
+                res = strtou64( found + string_size( key ), NULL, 10 ) * 1024;
+            }
+        }
+        KFileRelease( f );
+    }
+    return res;
+}
+#endif
+
+static uint64_t get_avail_ram( KDirectory * dir )
+{
+    uint64_t res = 0;
+#if defined( _WIN32 )
+    MEMORYSTATUSEX status;
+    status . dwLength = sizeof status;
+    if ( GlobalMemoryStatusEx( &status ) )
+    {
+        res = status . ullAvailPhys;
+    }
+#else
+#if defined( __linux__ )
+    res = get_avail_ram_from_meminfo( dir );
+#endif
+#if defined( _SC_AVPHYS_PAGES )
+    if ( 0 == res )
+    {
+        long pages = sysconf( _SC_AVPHYS_PAGES );
+        long page_size = sysconf( _SC_PAGESIZE );
+        if ( pages > 0 && page_size > 0 )
+        {
+            res = ( uint64_t )pages * page_size;
+        }
+    }
+#endif
+#endif
+    return res;
+}
+
+/* free and total space of the volume the path is on, both stay 0 if it cannot be found out */
+static void get_disk_space( KDirectory * dir, const char * path, uint64_t * free_bytes, uint64_t * total_bytes )
+{
+    const KDirectory * sub;
+    rc_t rc = KDirectoryOpenDirRead( dir, &sub, false, "%s", path );
+    *free_bytes = 0;
+    *total_bytes = 0;
+    if ( 0 == rc )
+    {
+        rc = KDirectoryGetDiskFreeSpace( sub, free_bytes, total_bytes );
+        if ( 0 != rc )
+        {
+            *free_bytes = 0;
+            *total_bytes = 0;
+        }
+        KDirectoryRelease( sub );
+    }
+}
+
+/* the directory the output-file goes into */
+static void get_output_dir( const char * output_path, char * path, size_t path_size )
+{
+    size_t len = string_copy_measure( path, path_size, output_path );
+    /* cut the filename off, what is left is the directory of the output */
+    while ( len > 0 && '/' != path[ len - 1 ] && '\\' != path[ len - 1 ] )
+    {
+        len--;
+    }
+    if ( 0 == len )
+    {
+        path[ len++ ] = '.';
+    }
+    path[ len ] = 0;
+}
+
+#ifdef _WIN32
+/* the resolved paths look like '/C/dir' or '//server/share/dir', the volume is '/C' or '//server/share' */
+static size_t volume_prefix_len( const char * path )
+{
+    size_t i;
+    uint32_t slashes = ( '/' == path[ 0 ] && '/' == path[ 1 ] ) ? 4 : 2;
+    for ( i = 0; 0 != path[ i ]; ++i )
+    {
+        if ( '/' == path[ i ] && 0 == --slashes )
+        {
+            break;
+        }
+    }
+    return i;
+}
+#endif
+
+/* both paths are on the same volume, false if that cannot be found out:
+   compares the device-ids ( the drive or share on Windows ), not the space reported for them */
+static bool on_same_volume( KDirectory * dir, const char * path1, const char * path2 )
+{
+    bool res = false;
+    char full1[ 4096 ];
+    char full2[ 4096 ];
+    if ( 0 == KDirectoryResolvePath( dir, true, full1, sizeof full1, "%s", path1 ) &&
+         0 == KDirectoryResolvePath( dir, true, full2, sizeof full2, "%s", path2 ) )
+    {
+#ifdef _WIN32
+        size_t len = volume_prefix_len( full1 );
+        res = ( len == volume_prefix_len( full2 ) && 0 == _strnicmp( full1, full2, len ) );
+#else
+        struct stat st1, st2;
+        res = ( 0 == stat( full1, &st1 ) && 0 == stat( full2, &st2 ) && st1 . st_dev == st2 . st_dev );
+#endif
+    }
+    return res;
+}
+
+/* -------------------------------------------------------------------------------------------- */
+
+static rc_t sample_seq_tbl( const resource_request * request, resource_plan * plan )
+{
+    struct cmn_iter * iter;
+    cmn_params cp = { request -> dir, request -> vdb_mgr, request -> accession_short,
+                      request -> accession_path, 0, 0, request -> cursor_cache }; /* helper.h */
+    rc_t rc = make_cmn_iter( &cp, request -> seq_tbl_name, &iter ); /* cmn_iter.c */
+    if ( 0 != rc )
+    {
+        ErrMsg( "planner.c sample_seq_tbl().make_cmn_iter() -> %R", rc );
+    }
+    else
+    {
+        uint32_t read_len_id;
+        rc = cmn_iter_add_column( iter, "READ_LEN", &read_len_id ); /* cmn_iter.c */
+        if ( 0 == rc )
+        {
+            rc = cmn_iter_range( iter, read_len_id ); /* cmn_iter.c */
+        }
+        if ( 0 == rc )
+        {
+            rc_t rc1 = 0;
+            uint64_t sampled = 0;
+            uint64_t bases = 0;
+            uint64_t reads = 0;
+
+            plan -> seq_rows = cmn_iter_row_count( iter ); /* cmn_iter.c */
+            while ( sampled < PLAN_SAMPLE_ROWS && 0 == rc1 && cmn_iter_next( iter, &rc1 ) )
+            {
+                uint32_t * read_len;
+                uint32_t count;
+                rc1 = cmn_read_uint32_array( iter, read_len_id, &read_len, &count ); /* cmn_iter.c */
+                if ( 0 == rc1 )
+                {
+                    uint32_t idx;
+                    for ( idx = 0; idx < count; ++idx )
+                    {
+                        bases += read_len[ idx ];
+                    }
+                    reads += count;
+                    sampled++;
+                }
+            }
+            if ( sampled > 0 )
+            {
+                plan -> avg_spot_len = ( bases + sampled - 1 ) / sampled;
+                plan -> avg_reads_per_spot = ( reads + sampled - 1 ) / sampled;
+            }
+        }
+        destroy_cmn_iter( iter ); /* cmn_iter.c */
+    }
+    return rc;
+}
+
+static uint64_t estimate_output_size( const resource_request * request, const resource_plan * plan )
+{
+    uint64_t per_spot;
+    uint64_t defline = string_size( request -> accession_short ) + PLAN_DEFLINE_OVERHEAD;
+    switch( request -> fmt )
+    {
+        /* one line per spot: spot-id, read, spot-group */
+        case ft_special     : per_spot = plan -> avg_spot_len + defline; break;
+
+        /* one FASTQ-record per spot: 2 deflines, bases, qualities, 4 newlines */
+        case ft_whole_spot  : per_spot = ( 2 * plan -> avg_spot_len ) + ( 2 * defline ) + 4; break;
+
+        /* one FASTQ-record per read */
+        default             : per_spot = ( 2 * plan -> avg_spot_len ) +
+                                         ( plan -> avg_reads_per_spot * ( ( 2 * defline ) + 4 ) ); break;
+    }
+    if ( ct_gzip == request -> compress )
+    {
+        per_spot /= PLAN_GZIP_RATIO;
+    }
+    return plan -> seq_rows * per_spot;
+}
+
+static void choose_threads_and_memory( const resource_request * request, resource_plan * plan )
+{
+    /* we do not want to use more than half of the available RAM */
+    uint64_t usable = ( plan -> avail_ram > 0 ) ? plan -> avail_ram : plan -> total_ram;
+    uint64_t budget = usable / 2;
+    uint64_t per_thread_fixed = request -> cursor_cache + request -> buf_size;
+
+    plan -> num_threads = request -> num_threads;
+    plan -> mem_limit = request -> mem_limit;
+
+    if ( request -> choose_num_threads && plan -> num_cores > 0 )
+    {
+        uint32_t threads = plan -> num_cores;
+        if ( threads > PLAN_MAX_THREADS )
+        {
+            threads = PLAN_MAX_THREADS;
+        }
+        if ( budget > 0 )
+        {
+            /* every thread needs at least a cursor-cache, a buffer and a sort-buffer */
+            uint64_t per_thread_min = per_thread_fixed +
+                    ( request -> choose_mem_limit ? PLAN_MIN_MEM_LIMIT : request -> mem_limit );
+            uint64_t affordable = budget / per_thread_min;
+            if ( affordable < threads )
+            {
+                threads = ( uint32_t )affordable;
+            }
+        }
+        plan -> num_threads = ( threads < PLAN_MIN_THREADS ) ? PLAN_MIN_THREADS : threads;
+    }
+
+    if ( request -> choose_mem_limit && request -> needs_lookup && budget > 0 )
+    {
+        uint64_t per_thread = budget / plan -> num_threads;
+        uint64_t mem = ( per_thread > per_thread_fixed ) ? per_thread - per_thread_fixed : 0;
+        /* more than the whole lookup divided by the threads is never needed */
+        if ( plan -> lookup_mem_size > 0 )
+        {
+            uint64_t needed = ( plan -> lookup_mem_size / plan -> num_threads ) + PLAN_MIN_MEM_LIMIT;
+            if ( mem > needed )
+            {
+                mem = needed;
+            }
+        }
+        if ( mem > PLAN_MAX_MEM_LIMIT )
+        {
+            mem = PLAN_MAX_MEM_LIMIT;
+        }
+        plan -> mem_limit = ( mem < PLAN_MIN_MEM_LIMIT ) ? PLAN_MIN_MEM_LIMIT : ( size_t )mem;
+    }
+
+    if ( request -> needs_lookup && plan -> lookup_mem_size > 0 )
+    {
+        /* the producers would use mem-limit per thread for sorting anyway */
+        uint64_t lookup_budget = ( uint64_t )plan -> mem_limit * plan -> num_threads;
+        if ( budget > 0 && lookup_budget > budget )
+        {
+            lookup_budget = budget;
+        }
+        plan -> in_mem_lookup = ( plan -> lookup_mem_size <= lookup_budget );
+    }
+}
+
+static void estimate_space( const resource_request * request, resource_plan * plan )
+{
+    uint64_t lookup_peak = 0;
+    uint64_t lookup_final = 0;
+    uint64_t output_temp = 0;
+
+    if ( request -> needs_lookup && !plan -> in_mem_lookup )
+    {
+        /* the dense index has one 64-bit offset per key, 2 keys per spot ( index.h ) */
+        uint64_t index_size = 8 * ( ( 2 * plan -> seq_rows ) + 2 );
+        /* while merging, the sub-files and the merged lookup-file exist at the same time */
+        lookup_peak = ( 2 * plan -> lookup_file_size ) + index_size;
+        lookup_final = plan -> lookup_file_size + index_size;
+    }
+    if ( NULL != request -> output_path )
+    {
+        /* the join-threads write their output into temp-files on the scratch-volume,
+           the concatenator removes each of them after it has been appended to the output */
+        output_temp = plan -> output_size;
+        plan -> output_needed = plan -> output_size;
+    }
+    plan -> scratch_needed = lookup_final + output_temp;
+    if ( lookup_peak > plan -> scratch_needed )
+    {
+        plan -> scratch_needed = lookup_peak;
+    }
+
+    plan -> enough_space = true;
+    if ( plan -> scratch_total > 0 && plan -> scratch_needed > plan -> scratch_free )
+    {
+        plan -> enough_space = false;
+    }
+    /* on the same volume, the output grows while the temp-files shrink: covered by scratch_needed */
+    if ( !plan -> same_volume && plan -> output_total > 0 && plan -> output_needed > plan -> output_free )
+    {
+        plan -> enough_space = false;
+    }
+}
+
+rc_t make_resource_plan( const resource_request * request, resource_plan * plan )
+{
+    rc_t rc = 0;
+    if ( NULL == request || NULL == plan || NULL == request -> dir || NULL == request -> scratch_path )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+        ErrMsg( "planner.c make_resource_plan() -> %R", rc );
+    }
+    else
+    {
+        memset( plan, 0, sizeof *plan );
+
+        /* the machine */
+        plan -> total_ram = request -> total_ram;
+        plan -> avail_ram = get_avail_ram( request -> dir );
+        plan -> num_cores = get_num_cores();
+        get_disk_space( request -> dir, request -> scratch_path,
+                        &plan -> scratch_free, &plan -> scratch_total );
+        if ( NULL != request -> output_path )
+        {
+            char output_dir[ 4096 ];
+            get_output_dir( request -> output_path, output_dir, sizeof output_dir );
+            get_disk_space( request -> dir, output_dir, &plan -> output_free, &plan -> output_total );
+            plan -> same_volume = on_same_volume( request -> dir, request -> scratch_path, output_dir );
+        }
+
+        /* the accession */
+        rc = sample_seq_tbl( request, plan ); /* above */
+        if ( 0 == rc && request -> needs_lookup )
+        {
+            rc = estimate_lookup_size( request -> dir,
+                                       request -> vdb_mgr,
+                                       request -> accession_short,
+                                       request -> accession_path,
+                                       request -> cursor_cache,
+                                       &plan -> lookup_rows,
+                                       &plan -> avg_read_len,
+                                       &plan -> lookup_mem_size ); /* sorter.c */
+            /* on disk: 64-bit key, 16-bit length, packed 4na ( lookup_writer.c ) */
+            plan -> lookup_file_size = plan -> lookup_rows * ( 8 + 2 + ( ( plan -> avg_read_len + 1 ) / 2 ) );
+        }
+
+        if ( 0 == rc )
+        {
+            plan -> output_size = estimate_output_size( request, plan ); /* above */
+            choose_threads_and_memory( request, plan ); /* above */
+            estimate_space( request, plan ); /* above */
+        }
+    }
+    return rc;
+}
+
+rc_t print_resource_plan( const resource_plan * plan )
+{
+    rc_t rc = KOutMsg( "plan-cores   : %u\n", plan -> num_cores );
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "plan-ram     : %,lu bytes total, %,lu bytes available\n",
+                      plan -> total_ram, plan -> avail_ram );
+    }
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "seq-rows     : %,lu ( avg. %lu bases in %lu reads )\n",
+                      plan -> seq_rows, plan -> avg_spot_len, plan -> avg_reads_per_spot );
+    }
+    if ( 0 == rc && plan -> lookup_rows > 0 )
+    {
+        rc = KOutMsg( "lookup-rows  : %,lu ( avg. %lu bases )\n", plan -> lookup_rows, plan -> avg_read_len );
+        if ( 0 == rc )
+        {
+            rc = KOutMsg( "lookup-size  : %,lu bytes in memory, %,lu bytes as file ( estimated )\n",
+                          plan -> lookup_mem_size, plan -> lookup_file_size );
+        }
+        if ( 0 == rc )
+        {
+            rc = KOutMsg( "lookup-mode  : '%s'\n", plan -> in_mem_lookup ? "in memory" : "temp-files" );
+        }
+    }
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "output-size  : %,lu bytes ( estimated )\n", plan -> output_size );
+    }
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "scratch-space: %,lu bytes needed, %,lu bytes free\n",
+                      plan -> scratch_needed, plan -> scratch_free );
+    }
+    if ( 0 == rc && !plan -> same_volume && plan -> output_needed > 0 )
+    {
+        rc = KOutMsg( "output-space : %,lu bytes needed, %,lu bytes free\n",
+                      plan -> output_needed, plan -> output_free );
+    }
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "plan-threads : %u\n", plan -> num_threads );
+    }
+    if ( 0 == rc )
+    {
+        rc = KOutMsg( "plan-mem     : %,lu bytes\n", plan -> mem_limit );
+    }
+    return rc;
+}
@@ -0,0 +1,114 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_planner_
+#define _h_planner_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _h_klib_rc_
+#include <klib/rc.h>
+#endif
+
+#ifndef _h_kfs_directory_
+#include <kfs/directory.h>
+#endif
+
+#ifndef _h_vdb_manager_
+#include <vdb/manager.h>
+#endif
+
+#ifndef _h_helper_
+#include "helper.h"
+#endif
+
+/* ---------------------------------------------------------------------------------------------
+    the planner runs before any lookup- or output-production:
+
+    - it counts the rows and samples the read-lengths of the accession
+    - it probes the machine: physical and available RAM, number of cores,
+      free space on the scratch- and on the output-volume
+    - if the user did not ask for a specific number of threads or mem-limit,
+      it chooses them from the cores and the available RAM
+    - it decides if the lookup can be kept in memory or has to be spilled into temp-files
+    - it estimates how much space the temp-files and the output will need,
+      and refuses early if there is not enough, instead of failing late after hours of work
+
+    all sizes are estimates, based on a sample of rows at the beginning of the tables
+--------------------------------------------------------------------------------------------- */
+
+typedef struct resource_request
+{
+    KDirectory * dir;
+    const VDBManager * vdb_mgr;
+    const char * accession_short;
+    const char * accession_path;
+    const char * seq_tbl_name;      /* NULL for a flat table */
+    const char * scratch_path;      /* where the temp-files go */
+    const char * output_path;       /* where the output goes ( NULL in stdout-mode ) */
+    size_t cursor_cache, buf_size;
+    size_t mem_limit;               /* given by the user or the default */
+    uint32_t num_threads;           /* given by the user or the default */
+    bool choose_mem_limit;          /* the user did not give a mem-limit, let the planner choose */
+    bool choose_num_threads;        /* the user did not give a thread-count, let the planner choose */
+    uint64_t total_ram;
+    format_t fmt;                   /* helper.h */
+    compress_t compress;            /* helper.h */
+    bool needs_lookup;              /* cSRA: the PRIMARY_ALIGNMENT-table has to be looked up */
+} resource_request;
+
+typedef struct resource_plan
+{
+    /* what the planner found out */
+    uint64_t seq_rows, avg_spot_len, avg_reads_per_spot;
+    uint64_t lookup_rows, avg_read_len, lookup_mem_size, lookup_file_size;
+    uint64_t total_ram, avail_ram;
+    uint32_t num_cores;
+    uint64_t scratch_free, scratch_total;   /* 0 if unknown */
+    uint64_t output_free, output_total;     /* 0 if unknown */
+    bool same_volume;                       /* scratch and output have the same device-id */
+
+    /* what the planner estimated */
+    uint64_t output_size, scratch_needed, output_needed;
+
+    /* what the planner decided */
+    size_t mem_limit;
+    uint32_t num_threads;
+    bool in_mem_lookup;
+    bool enough_space;
+} resource_plan;
+
+rc_t make_resource_plan( const resource_request * request, resource_plan * plan );
+
+rc_t print_resource_plan( const resource_plan * plan );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,6 +25,7 @@
 */
 
 #include "sorter.h"
+#include "lookup_store.h"
 #include "lookup_writer.h"
 #include "lookup_reader.h"
 #include "raw_read_iter.h"
@@ -51,11 +52,11 @@
 typedef struct lookup_producer
 {
     struct raw_read_iter * iter; /* raw_read_iter.h */
-    KVector * store;
+    struct lookup_store * store; /* lookup_store.h */
     struct bg_progress * progress; /* progress_thread.h */
     struct background_vector_merger * merger; /* merge_sorter.h */
+    locked_vector * collected; /* helper.h ( in-memory mode, instead of the merger ) */
     SBuffer buf; /* helper.h */
-    uint64_t bytes_in_store;
     atomic64_t * processed_row_count;
     uint32_t chunk_id, sub_file_id;
     size_t buf_size, mem_limit;
@@ -72,17 +73,29 @@ static void release_producer( lookup_producer * self )
         {
             destroy_raw_read_iter( self -> iter ); /* raw_read_iter.c */
         }
-        if ( NULL != self -> store )
-        {
-            KVectorRelease( self -> store );
-        }
+        release_lookup_store( self -> store ); /* lookup_store.c ( ignores NULL ) */
         free( ( void * ) self );
     }
 }
 
+/* the arena-blocks of the store are a fraction of the mem-limit, to keep the limit tight */
+#define STORE_BLOCK_FRACTION 16
+
+static rc_t make_producer_store( lookup_producer * self )
+{
+    rc_t rc = make_lookup_store( &( self -> store ), self -> mem_limit / STORE_BLOCK_FRACTION, 0,
+                                 self -> mem_limit ); /* lookup_store.c */
+    if ( 0 != rc )
+    {
+        ErrMsg( "sorter.c make_producer_store().make_lookup_store() -> %R", rc );
+    }
+    return rc;
+}
+
 static rc_t init_multi_producer( lookup_producer * self,
                                  cmn_params * cmn, /* helper.h */
                                  struct background_vector_merger * merger, /* merge_sorter.h */
+                                 locked_vector * collected, /* helper.h */
                                  size_t buf_size,
                                  size_t mem_limit,
                                  struct bg_progress * progress, /* progress_thread.h */
@@ -91,12 +104,10 @@ static rc_t init_multi_producer( lookup_producer * self,
                                  uint64_t row_count,
                                  atomic64_t * processed_row_count )
 {
-    rc_t rc = KVectorMake( &self -> store );
-    if ( 0 != rc )
-    {
-        ErrMsg( "sorter.c init_multi_producer().KVectorMake() -> %R", rc );
-    }
-    else
+    rc_t rc;
+    self -> mem_limit = mem_limit;
+    rc = make_producer_store( self ); /* above */
+    if ( 0 == rc )
     {
         rc = make_SBuffer( &( self -> buf ), 4096 ); /* helper.c */
         if ( 0 == rc )
@@ -106,11 +117,10 @@ static rc_t init_multi_producer( lookup_producer * self,
             self -> iter            = NULL;
             self -> progress        = progress;
             self -> merger          = merger;
-            self -> bytes_in_store  = 0;
+            self -> collected       = collected;
             self -> chunk_id        = chunk_id;
             self -> sub_file_id     = 0;
             self -> buf_size        = buf_size;
-            self -> mem_limit       = mem_limit;
             self -> single          = false;
             self -> processed_row_count = processed_row_count;
 
@@ -131,20 +141,26 @@ static rc_t init_multi_producer( lookup_producer * self,
 static rc_t push_store_to_merger( lookup_producer * self, bool last )
 {
     rc_t rc = 0;
-    if ( self -> bytes_in_store > 0 )
+    if ( lookup_store_count( self -> store ) > 0 )
     {
-        rc = push_to_background_vector_merger( self -> merger, self -> store ); /* this might block! merge_sorter.c */
+        /* sort the store here, in the producer-thread, the merger just walks it */
+        lookup_store_sort( self -> store ); /* lookup_store.c */
+        if ( NULL != self -> collected )
+        {
+            /* in-memory mode: the store is kept, and merged after all producers are done */
+            rc = locked_vector_push( self -> collected, self -> store, false ); /* helper.c */
+        }
+        else
+        {
+            rc = push_to_background_vector_merger( self -> merger, self -> store ); /* this might block! merge_sorter.c */
+        }
         if ( 0 == rc )
         {
+            /* the merger ( or the collector ) owns the store now */
             self -> store = NULL;
-            self -> bytes_in_store = 0;
             if ( !last )
             {
-                rc = KVectorMake( &self -> store );
-                if ( 0 != rc )
-                {
-                    ErrMsg( "sorter.c push_store_to_merger().KVectorMake() -> %R", rc );
-                }
+                rc = make_producer_store( self ); /* above */
             }
         }
     }
@@ -163,29 +179,23 @@ static rc_t write_to_store( lookup_producer * self,
     }
     else
     {
-        const String * to_store;
-        rc = StringCopy( &to_store, &( self -> buf . S ) );
-        if ( 0 != rc )
+        /* the packed bases are copied into the arena of the store, no allocation per read */
+        rc = lookup_store_add( self -> store, key, &( self -> buf . S ) ); /* lookup_store.c */
+        if ( 0 != rc && lookup_store_is_full( rc ) )
         {
-            ErrMsg( "sorter.c write_to_store().StringCopy() -> %R", rc );
-        }
-        else
-        {
-            rc = KVectorSetPtr( self -> store, key, ( const void * )to_store );
-            if ( 0 != rc )
-            {
-                ErrMsg( "sorter.c write_to_store().KVectorSetPtr() -> %R", rc );
-            }
-            else
+            /* the store cannot grow without exceeding the mem-limit: spill it and retry with an empty one */
+            rc = push_store_to_merger( self, false ); /* this might block ! */
+            if ( 0 == rc )
             {
-                size_t item_size = ( sizeof key ) + ( sizeof *to_store ) + to_store -> size;
-                self -> bytes_in_store += item_size;
+                rc = lookup_store_add( self -> store, key, &( self -> buf . S ) ); /* lookup_store.c */
             }
         }
-        
-        if ( 0 == rc &&
-             self -> mem_limit > 0 &&
-             self -> bytes_in_store >= self -> mem_limit )
+        if ( 0 != rc )
+        {
+            ErrMsg( "sorter.c write_to_store().lookup_store_add() -> %R", rc );
+        }
+        else if ( self -> mem_limit > 0 &&
+                  lookup_store_size( self -> store ) >= self -> mem_limit )
         {
             rc = push_store_to_merger( self, false ); /* this might block ! */
         }
@@ -285,6 +295,7 @@ static uint64_t find_out_row_count( cmn_params * cmn )
 
 static rc_t run_producer_pool( cmn_params * cmn, /* helper.h */
                                struct background_vector_merger * merger, /* merge_sorter.h */
+                               locked_vector * collected, /* helper.h */
                                size_t buf_size,
                                size_t mem_limit,
                                uint32_t num_threads,
@@ -322,6 +333,7 @@ static rc_t run_producer_pool( cmn_params * cmn, /* helper.h */
                 rc = init_multi_producer( producer,
                                           cmn,
                                           merger,
+                                          collected,
                                           buf_size,
                                           mem_limit,
                                           progress,
@@ -410,6 +422,7 @@ rc_t execute_lookup_production( KDirectory * dir,
         cmn_params cmn = { dir, vdb_mgr, accession_short, accession_path, 0, 0, cursor_cache };
         rc = run_producer_pool( &cmn,
                                 merger,
+                                NULL,
                                 buf_size,
                                 mem_limit,
                                 num_threads,
@@ -426,3 +439,171 @@ rc_t execute_lookup_production( KDirectory * dir,
 
     return rc;
 }
+
+/* -------------------------------------------------------------------------------------------- */
+
+/* how many rows of PRIMARY_ALIGNMENT we look at to find the average read-length */
+#define ESTIMATE_SAMPLE_ROWS 10000
+
+rc_t estimate_lookup_size( KDirectory * dir,
+                           const VDBManager * vdb_mgr,
+                           const char * accession_short,
+                           const char * accession_path,
+                           size_t cursor_cache,
+                           uint64_t * row_count,
+                           uint64_t * avg_read_len,
+                           uint64_t * lookup_size )
+{
+    rc_t rc;
+    struct raw_read_iter * iter; /* raw_read_iter.c */
+    cmn_params cp = { dir, vdb_mgr, accession_short, accession_path, 0, 0, cursor_cache }; /* cmn_iter.h */
+
+    rc = make_raw_read_iter( &cp, &iter ); /* raw_read_iter.c */
+    if ( 0 != rc )
+    {
+        ErrMsg( "sorter.c estimate_lookup_size().make_raw_read_iter() -> %R", rc );
+    }
+    else
+    {
+        raw_read_rec rec;
+        rc_t rc1 = 0;
+        uint64_t sampled = 0;
+        uint64_t sampled_bases = 0;
+        uint64_t avg_len = 0;
+        uint64_t total = get_row_count_of_raw_read( iter ); /* raw_read_iter.c */
+
+        while ( sampled < ESTIMATE_SAMPLE_ROWS && 0 == rc1 && get_from_raw_read_iter( iter, &rec, &rc1 ) )
+        {
+            if ( 0 == rc1 )
+            {
+                sampled_bases += rec . read . len;
+                sampled++;
+            }
+        }
+        destroy_raw_read_iter( iter ); /* raw_read_iter.c */
+
+        if ( sampled > 0 )
+        {
+            avg_len = ( sampled_bases + sampled - 1 ) / sampled;
+        }
+        *row_count = total;
+        *lookup_size = ( avg_len > 0 ) ? lookup_store_estimate( total, avg_len ) : 0; /* lookup_store.c */
+        if ( NULL != avg_read_len )
+        {
+            *avg_read_len = avg_len;
+        }
+    }
+    return rc;
+}
+
+static void CC release_collected_store( void * item, void * data )
+{
+    release_lookup_store( item ); /* lookup_store.c ( ignores NULL ) */
+}
+
+static rc_t merge_collected_stores( locked_vector * collected, struct lookup_store ** store )
+{
+    rc_t rc = 0;
+    Vector stores;
+    bool sealed = false;
+
+    VectorInit( &stores, 0, 16 );
+    while ( 0 == rc && !sealed )
+    {
+        void * item;
+        rc = locked_vector_pop( collected, &item, &sealed ); /* helper.c */
+        if ( 0 == rc && NULL != item )
+        {
+            rc = VectorAppend( &stores, NULL, item );
+            if ( 0 != rc )
+            {
+                ErrMsg( "sorter.c merge_collected_stores().VectorAppend() -> %R", rc );
+                release_lookup_store( item ); /* lookup_store.c */
+            }
+        }
+        else if ( 0 == rc )
+        {
+            /* the vector is empty: all producers are joined, nothing will arrive any more */
+            sealed = true;
+        }
+    }
+
+    if ( 0 == rc )
+    {
+        uint32_t count = VectorLength( &stores );
+        if ( 0 == count )
+        {
+            rc = make_lookup_store( store, 0, 1, 0 ); /* lookup_store.c */
+        }
+        else
+        {
+            /* the Vector-base is an array of pointers, the merge sets its slots to NULL */
+            rc = lookup_store_merge( ( struct lookup_store ** )stores . v, count, store ); /* lookup_store.c */
+            if ( 0 != rc )
+            {
+                ErrMsg( "sorter.c merge_collected_stores().lookup_store_merge() -> %R", rc );
+            }
+        }
+    }
+    VectorWhack( &stores, release_collected_store, NULL );
+    return rc;
+}
+
+rc_t execute_lookup_production_in_mem( KDirectory * dir,
+                                       const VDBManager * vdb_mgr,
+                                       const char * accession_short,
+                                       const char * accession_path,
+                                       size_t cursor_cache,
+                                       size_t buf_size,
+                                       uint32_t num_threads,
+                                       bool show_progress,
+                                       struct lookup_store ** store )
+{
+    rc_t rc = 0;
+    locked_vector collected; /* helper.h */
+
+    if ( NULL == store )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcParam, rcInvalid );
+        ErrMsg( "sorter.c execute_lookup_production_in_mem() -> %R", rc );
+    }
+    else
+    {
+        *store = NULL;
+        rc = locked_vector_init( &collected, 16 ); /* helper.c */
+        if ( 0 == rc )
+        {
+            if ( show_progress )
+            {
+                KOutHandlerSetStdErr();
+                rc = KOutMsg( "lookup :" );
+                KOutHandlerSetStdOut();
+            }
+
+            if ( 0 == rc )
+            {
+                cmn_params cmn = { dir, vdb_mgr, accession_short, accession_path, 0, 0, cursor_cache };
+                /* mem_limit = 0 : the producers never hand over a store before they are done */
+                rc = run_producer_pool( &cmn,
+                                        NULL,
+                                        &collected,
+                                        buf_size,
+                                        0,
+                                        num_threads,
+                                        show_progress ); /* above */
+            }
+
+            if ( 0 == rc )
+            {
+                rc = merge_collected_stores( &collected, store ); /* above */
+            }
+            locked_vector_release( &collected, release_collected_store, NULL ); /* helper.c */
+        }
+    }
+
+    if ( 0 != rc )
+    {
+        ErrMsg( "sorter.c execute_lookup_production_in_mem() -> %R", rc );
+    }
+    return rc;
+}
@@ -43,6 +43,10 @@ extern "C" {
 #include "merge_sorter.h"
 #endif
 
+#ifndef _h_lookup_store_
+#include "lookup_store.h"
+#endif
+
 #ifndef _h_vdb_manager_
 #include <vdb/manager.h>
 #endif
@@ -58,6 +62,28 @@ rc_t execute_lookup_production( KDirectory * dir,
                                 uint32_t num_threads,
                                 bool show_progress );
 
+/* counts the rows of PRIMARY_ALIGNMENT and estimates the memory an in-memory lookup would need,
+   based on the average length of a sample of reads ( avg_read_len may be NULL ) */
+rc_t estimate_lookup_size( KDirectory * dir,
+                           const VDBManager * vdb_mgr,
+                           const char * accession_short,
+                           const char * accession_path,
+                           size_t cursor_cache,
+                           uint64_t * row_count,
+                           uint64_t * avg_read_len,
+                           uint64_t * lookup_size );
+
+/* produces the whole lookup as one sorted in-memory store, no temp-files are written */
+rc_t execute_lookup_production_in_mem( KDirectory * dir,
+                                       const VDBManager * vdb_mgr,
+                                       const char * accession_short,
+                                       const char * accession_path,
+                                       size_t cursor_cache,
+                                       size_t buf_size,
+                                       uint32_t num_threads,
+                                       bool show_progress,
+                                       struct lookup_store ** store );
+
 #ifdef __cplusplus
 }
 #endif
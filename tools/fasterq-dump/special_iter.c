@@ -117,3 +117,8 @@ uint64_t get_row_count_of_special_iter( struct special_iter * iter )
 {
     return cmn_iter_row_count( iter -> cmn );
 }
+
+rc_t set_range_of_special_iter( struct special_iter * iter, int64_t first_row, uint64_t row_count )
+{
+    return cmn_iter_set_range( iter -> cmn, first_row, row_count ); /* cmn_iter.h */
+}
@@ -61,6 +61,7 @@ rc_t make_special_iter( cmn_params * params, struct special_iter ** iter );
 bool get_from_special_iter( struct special_iter * iter, special_rec * rec, rc_t * rc );
 
 uint64_t get_row_count_of_special_iter( struct special_iter * iter );
+rc_t set_range_of_special_iter( struct special_iter * iter, int64_t first_row, uint64_t row_count );
 
 #ifdef __cplusplus
 }
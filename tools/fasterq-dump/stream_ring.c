@@ -0,0 +1,346 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "stream_ring.h"
+
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <kproc/thread.h>
+#include <kfs/file.h>
+
+typedef struct stream_slot
+{
+    char * data;
+    size_t size;
+    bool filled;
+} stream_slot;
+
+typedef struct stream_ring
+{
+    KLock * lock;
+    KCondition * chunk_done;    /* signaled by the join-threads after a put */
+    KCondition * chunk_written; /* signaled by the writer after a chunk is written */
+    KThread * thread;
+    struct KFile * out;
+    stream_slot * slots;
+    uint64_t pos;               /* in the stdout-stream */
+    int64_t first_row;
+    int64_t * chunk_ends;       /* last row of each chunk */
+    uint64_t num_chunks;
+    uint64_t next_chunk;        /* handed out to the join-threads next */
+    uint64_t next_to_write;     /* the writer is waiting for this one */
+    uint32_t capacity;
+    bool aborted;
+} stream_ring;
+
+
+static void release_stream_ring( stream_ring * self )
+{
+    if ( NULL != self )
+    {
+        if ( NULL != self -> slots )
+        {
+            uint32_t i;
+            for ( i = 0; i < self -> capacity; ++i )
+            {
+                if ( NULL != self -> slots[ i ] . data )
+                {
+                    free( ( void * ) self -> slots[ i ] . data );
+                }
+            }
+            free( ( void * ) self -> slots );
+        }
+        if ( NULL != self -> chunk_ends )
+        {
+            free( ( void * ) self -> chunk_ends );
+        }
+        if ( NULL != self -> out )
+        {
+            KFileRelease( self -> out );
+        }
+        KConditionRelease( self -> chunk_written );
+        KConditionRelease( self -> chunk_done );
+        KLockRelease( self -> lock );
+        free( ( void * ) self );
+    }
+}
+
+static rc_t write_chunk( stream_ring * self, const char * data, size_t size )
+{
+    rc_t rc = 0;
+    if ( size > 0 )
+    {
+        size_t num_writ;
+        rc = KFileWriteAll( self -> out, self -> pos, data, size, &num_writ );
+        if ( 0 != rc )
+        {
+            ErrMsg( "stream_ring.c write_chunk().KFileWriteAll( at %lu ) -> %R", self -> pos, rc );
+        }
+        else if ( num_writ != size )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcWriting, rcFormat, rcInvalid );
+            ErrMsg( "stream_ring.c write_chunk().KFileWriteAll( %lu vs %lu ) -> %R", num_writ, size, rc );
+        }
+        else
+        {
+            self -> pos += num_writ;
+        }
+    }
+    return rc;
+}
+
+static rc_t CC stream_ring_thread_func( const KThread * thread, void * data )
+{
+    rc_t rc = 0;
+    stream_ring * self = data;
+    bool done = false;
+
+    while ( 0 == rc && !done )
+    {
+        rc = KLockAcquire( self -> lock );
+        if ( 0 == rc )
+        {
+            stream_slot * slot = &( self -> slots[ self -> next_to_write % self -> capacity ] );
+            while ( !slot -> filled && !self -> aborted && self -> next_to_write < self -> num_chunks )
+            {
+                KConditionWait( self -> chunk_done, self -> lock );
+            }
+            if ( self -> aborted || self -> next_to_write >= self -> num_chunks )
+            {
+                done = true;
+                KLockUnlock( self -> lock );
+            }
+            else
+            {
+                /* take the chunk out of the ring, and write it without holding the lock */
+                char * chunk_data = slot -> data;
+                size_t chunk_size = slot -> size;
+                slot -> data = NULL;
+                slot -> size = 0;
+                slot -> filled = false;
+                KLockUnlock( self -> lock );
+
+                rc = write_chunk( self, chunk_data, chunk_size ); /* above */
+                if ( NULL != chunk_data )
+                {
+                    free( ( void * ) chunk_data );
+                }
+
+                if ( 0 == KLockAcquire( self -> lock ) )
+                {
+                    self -> next_to_write++;
+                    if ( 0 != rc )
+                    {
+                        self -> aborted = true;
+                    }
+                    KConditionBroadcast( self -> chunk_written );
+                    KLockUnlock( self -> lock );
+                }
+            }
+        }
+    }
+    if ( 0 != rc )
+    {
+        set_quitting(); /* helper.c */
+    }
+    return rc;
+}
+
+rc_t make_stream_ring( stream_ring ** ring,
+                       int64_t first_row,
+                       int64_t * chunk_ends,
+                       uint64_t num_chunks,
+                       uint32_t capacity )
+{
+    rc_t rc = 0;
+    stream_ring * r = calloc( 1, sizeof * r );
+    *ring = NULL;
+    if ( NULL == r )
+    {
+        rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+        ErrMsg( "stream_ring.c make_stream_ring().calloc( %d ) -> %R", ( sizeof * r ), rc );
+        free( ( void * ) chunk_ends );
+    }
+    else
+    {
+        r -> first_row = first_row;
+        r -> chunk_ends = chunk_ends;
+        r -> num_chunks = ( NULL == chunk_ends ) ? 0 : num_chunks;
+        r -> capacity = ( capacity < 2 ) ? 2 : capacity;
+        r -> slots = calloc( r -> capacity, sizeof r -> slots[ 0 ] );
+        if ( NULL == r -> slots )
+        {
+            rc = RC( rcVDB, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            ErrMsg( "stream_ring.c make_stream_ring().calloc( %u slots ) -> %R", r -> capacity, rc );
+        }
+        if ( 0 == rc )
+        {
+            rc = KLockMake( &( r -> lock ) );
+            if ( 0 != rc )
+            {
+                ErrMsg( "stream_ring.c make_stream_ring().KLockMake() -> %R", rc );
+            }
+        }
+        if ( 0 == rc )
+        {
+            rc = KConditionMake( &( r -> chunk_done ) );
+            if ( 0 == rc )
+            {
+                rc = KConditionMake( &( r -> chunk_written ) );
+            }
+            if ( 0 != rc )
+            {
+                ErrMsg( "stream_ring.c make_stream_ring().KConditionMake() -> %R", rc );
+            }
+        }
+        if ( 0 == rc )
+        {
+            rc = KFileMakeStdOut( &( r -> out ) );
+            if ( 0 != rc )
+            {
+                ErrMsg( "stream_ring.c make_stream_ring().KFileMakeStdOut() -> %R", rc );
+            }
+        }
+        if ( 0 == rc )
+        {
+            rc = helper_make_thread( &( r -> thread ), stream_ring_thread_func, r, THREAD_DFLT_STACK_SIZE ); /* helper.c */
+            if ( 0 != rc )
+            {
+                ErrMsg( "stream_ring.c make_stream_ring().helper_make_thread() -> %R", rc );
+            }
+        }
+        if ( 0 == rc )
+        {
+            *ring = r;
+        }
+        else
+        {
+            release_stream_ring( r ); /* above */
+        }
+    }
+    return rc;
+}
+
+bool stream_ring_next_chunk( stream_ring * self,
+                             uint64_t * chunk_id,
+                             int64_t * first_row,
+                             uint64_t * row_count,
+                             rc_t * rc )
+{
+    bool res = false;
+    *rc = KLockAcquire( self -> lock );
+    if ( 0 != *rc )
+    {
+        ErrMsg( "stream_ring.c stream_ring_next_chunk().KLockAcquire() -> %R", *rc );
+    }
+    else
+    {
+        if ( !self -> aborted && self -> next_chunk < self -> num_chunks )
+        {
+            uint64_t id = self -> next_chunk++;
+            int64_t start = ( 0 == id ) ? self -> first_row : self -> chunk_ends[ id - 1 ] + 1;
+
+            /* the chunk has to fit into the ring: wait for the writer to catch up */
+            while ( !self -> aborted && id >= ( self -> next_to_write + self -> capacity ) )
+            {
+                KConditionWait( self -> chunk_written, self -> lock );
+            }
+            if ( !self -> aborted )
+            {
+                *chunk_id = id;
+                *first_row = start;
+                *row_count = ( uint64_t )( self -> chunk_ends[ id ] - start + 1 );
+                res = true;
+            }
+        }
+        KLockUnlock( self -> lock );
+    }
+    return res;
+}
+
+rc_t stream_ring_put( stream_ring * self, uint64_t chunk_id, char * data, size_t size )
+{
+    rc_t rc = KLockAcquire( self -> lock );
+    if ( 0 != rc )
+    {
+        ErrMsg( "stream_ring.c stream_ring_put().KLockAcquire() -> %R", rc );
+        free( ( void * ) data );
+    }
+    else
+    {
+        stream_slot * slot = &( self -> slots[ chunk_id % self -> capacity ] );
+        if ( self -> aborted )
+        {
+            free( ( void * ) data );
+        }
+        else
+        {
+            /* stream_ring_next_chunk() made sure this slot is not occupied */
+            slot -> data = data;
+            slot -> size = size;
+            slot -> filled = true;
+            KConditionSignal( self -> chunk_done );
+        }
+        KLockUnlock( self -> lock );
+    }
+    return rc;
+}
+
+void stream_ring_abort( stream_ring * self )
+{
+    if ( NULL != self && 0 == KLockAcquire( self -> lock ) )
+    {
+        self -> aborted = true;
+        KConditionBroadcast( self -> chunk_done );
+        KConditionBroadcast( self -> chunk_written );
+        KLockUnlock( self -> lock );
+    }
+}
+
+rc_t wait_for_and_release_stream_ring( stream_ring * self )
+{
+    rc_t rc = 0;
+    if ( NULL != self )
+    {
+        rc_t rc_status;
+        rc = KThreadWait( self -> thread, &rc_status );
+        if ( 0 != rc )
+        {
+            ErrMsg( "stream_ring.c wait_for_and_release_stream_ring().KThreadWait() -> %R", rc );
+        }
+        else
+        {
+            rc = rc_status;
+            if ( 0 == rc && self -> aborted )
+            {
+                rc = RC( rcVDB, rcNoTarg, rcWriting, rcTransfer, rcCanceled );
+            }
+        }
+        KThreadRelease( self -> thread );
+        release_stream_ring( self ); /* above */
+    }
+    return rc;
+}
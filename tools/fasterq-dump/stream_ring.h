@@ -0,0 +1,88 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_stream_ring_
+#define _h_stream_ring_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef _h_klib_rc_
+#include <klib/rc.h>
+#endif
+
+#ifndef _h_helper_
+#include "helper.h"
+#endif
+
+/* ---------------------------------------------------------------------------------------------
+    the stream-ring is used in --stdout mode instead of temp-files and the concatenator:
+
+    - the rows are split into chunks, the join-threads ask the ring for the next chunk
+      ( stream_ring_next_chunk ), produce its output in memory and hand it back ( stream_ring_put )
+    - a writer-thread forwards the chunks to stdout in the order of the chunk-id,
+      as soon as the next chunk in order is complete
+    - a join-thread is not allowed to start a chunk that is more than 'capacity' chunks ahead
+      of the writer, this bounds the memory used for reordering
+--------------------------------------------------------------------------------------------- */
+
+/* nominal size of a chunk, cmn_make_blob_chunks() extends it to the next blob-boundary */
+#define DFLT_STREAM_CHUNK_ROWS 50000
+
+struct stream_ring;
+
+/* starts the writer-thread,
+   chunk 0 starts at first_row, chunk_ends[ i ] is the last row of chunk i ( see cmn_make_blob_chunks() ),
+   the ring takes ownership of chunk_ends */
+rc_t make_stream_ring( struct stream_ring ** ring,
+                       int64_t first_row,
+                       int64_t * chunk_ends,
+                       uint64_t num_chunks,
+                       uint32_t capacity );
+
+/* returns false if there are no more chunks ( or the ring was aborted ),
+   blocks until the chunk fits into the ring */
+bool stream_ring_next_chunk( struct stream_ring * self,
+                             uint64_t * chunk_id,
+                             int64_t * first_row,
+                             uint64_t * row_count,
+                             rc_t * rc );
+
+/* takes ownership of data ( allocated with malloc/realloc, may be NULL if size is 0 ) */
+rc_t stream_ring_put( struct stream_ring * self, uint64_t chunk_id, char * data, size_t size );
+
+/* a join-thread failed: wake up everybody, nothing more is written */
+void stream_ring_abort( struct stream_ring * self );
+
+/* waits for the writer-thread to write out all chunks */
+rc_t wait_for_and_release_stream_ring( struct stream_ring * self );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,6 +27,7 @@
 #include "fastq_iter.h"
 #include "cleanup_task.h"
 #include "join_results.h"
+#include "stream_ring.h"
 #include "progress_thread.h"
 
 #include <klib/out.h>
@@ -417,9 +418,32 @@ static rc_t print_fastq_n_reads_split_3( join_stats * stats,
 
 /* ------------------------------------------------------------------------------------------ */
 
+/* the iterator of a join-thread: opened once, moved to the next slice of rows for every stream-chunk,
+   the cursor keeps its cache and the open blobs */
+typedef struct tbl_iter
+{
+    const char * tbl_name;
+    struct fastq_sra_iter * iter;   /* fastq_iter.h */
+} tbl_iter;
+
+static rc_t get_tbl_iter( tbl_iter * ti, cmn_params * cp, fastq_iter_opt opt, struct fastq_sra_iter ** iter )
+{
+    rc_t rc;
+    if ( NULL == ti -> iter )
+    {
+        rc = make_fastq_sra_iter( cp, opt, ti -> tbl_name, &( ti -> iter ) ); /* fastq-iter.c */
+    }
+    else
+    {
+        rc = set_range_of_fastq_sra_iter( ti -> iter, cp -> first_row, cp -> row_count ); /* fastq-iter.c */
+    }
+    *iter = ti -> iter;
+    return rc;
+}
+
 static rc_t perform_whole_spot_join( cmn_params * cp,
                                 join_stats * stats,
-                                const char * tbl_name,
+                                tbl_iter * ti,
                                 struct join_results * results,
                                 struct bg_progress * progress,
                                 const join_options * jo )
@@ -431,7 +455,7 @@ static rc_t perform_whole_spot_join( cmn_params * cp,
     opt . with_name = !( jo -> rowid_as_name );
     opt . with_read_type = false;
 
-    rc = make_fastq_sra_iter( cp, opt, tbl_name, &iter ); /* fastq-iter.c */
+    rc = get_tbl_iter( ti, cp, opt, &iter ); /* above */
     if ( 0 != rc )
     {
         ErrMsg( "perform_fastq_join().make_fastq_iter() -> %R", rc );
@@ -471,14 +495,13 @@ static rc_t perform_whole_spot_join( cmn_params * cp,
         {
             set_quitting(); /* helper.c */
         }
-        destroy_fastq_sra_iter( iter );
     }
     return rc;
 }
 
 static rc_t perform_fastq_split_spot_join( cmn_params * cp,
                                       join_stats * stats,
-                                      const char * tbl_name,
+                                      tbl_iter * ti,
                                       struct join_results * results,
                                       struct bg_progress * progress,
                                       const join_options * jo )
@@ -490,7 +513,7 @@ static rc_t perform_fastq_split_spot_join( cmn_params * cp,
     opt . with_name = !( jo -> rowid_as_name );
     opt . with_read_type = jo -> skip_tech;
 
-    rc = make_fastq_sra_iter( cp, opt, tbl_name, &iter ); /* fastq-iter.c */
+    rc = get_tbl_iter( ti, cp, opt, &iter ); /* above */
     if ( 0 == rc )
     {
         rc_t rc_iter;
@@ -523,7 +546,6 @@ static rc_t perform_fastq_split_spot_join( cmn_params * cp,
         {
             set_quitting(); /* helper.c */
         }
-        destroy_fastq_sra_iter( iter );
     }
     else
     {
@@ -534,7 +556,7 @@ static rc_t perform_fastq_split_spot_join( cmn_params * cp,
 
 static rc_t perform_fastq_split_file_join( cmn_params * cp,
                                       join_stats * stats,
-                                      const char * tbl_name,
+                                      tbl_iter * ti,
                                       struct join_results * results,
                                       struct bg_progress * progress,
                                       const join_options * jo )
@@ -546,7 +568,7 @@ static rc_t perform_fastq_split_file_join( cmn_params * cp,
     opt . with_name = !( jo -> rowid_as_name );
     opt . with_read_type = jo -> skip_tech;
 
-    rc = make_fastq_sra_iter( cp, opt, tbl_name, &iter ); /* fastq-iter.c */
+    rc = get_tbl_iter( ti, cp, opt, &iter ); /* above */
     if ( 0 == rc )
     {
         rc_t rc_iter;
@@ -578,7 +600,6 @@ static rc_t perform_fastq_split_file_join( cmn_params * cp,
         {
             set_quitting();     /* helper.c */
         }
-        destroy_fastq_sra_iter( iter );
     }
     else
     {
@@ -589,7 +610,7 @@ static rc_t perform_fastq_split_file_join( cmn_params * cp,
 
 static rc_t perform_fastq_split_3_join( cmn_params * cp,
                                       join_stats * stats,
-                                      const char * tbl_name,
+                                      tbl_iter * ti,
                                       struct join_results * results,
                                       struct bg_progress * progress,
                                       const join_options * jo )
@@ -601,7 +622,7 @@ static rc_t perform_fastq_split_3_join( cmn_params * cp,
     opt . with_name = !( jo -> rowid_as_name );
     opt . with_read_type = true;
 
-    rc = make_fastq_sra_iter( cp, opt, tbl_name, &iter ); /* fastq-iter.c */
+    rc = get_tbl_iter( ti, cp, opt, &iter ); /* above */
     if ( 0 == rc )
     {
         rc_t rc_iter;
@@ -644,7 +665,6 @@ static rc_t perform_fastq_split_3_join( cmn_params * cp,
         {
             set_quitting();     /* helper.c */
         }
-        destroy_fastq_sra_iter( iter );
     }
     else
     {
@@ -669,6 +689,7 @@ typedef struct join_thread_data
     const char * tbl_name;
     struct bg_progress * progress;
     struct temp_registry * registry;
+    struct stream_ring * stream;    /* stream_ring.h ( NULL if not streaming to stdout ) */
     KThread * thread;
 
     int64_t first_row;
@@ -680,6 +701,61 @@ typedef struct join_thread_data
 
 } join_thread_data;
 
+static rc_t perform_join( join_thread_data * jtd, cmn_params * cp, struct join_results * results, tbl_iter * ti )
+{
+    rc_t rc = 0;
+    switch( jtd -> fmt )
+    {
+        case ft_whole_spot       : rc = perform_whole_spot_join( cp,
+                                        &jtd -> stats,
+                                        ti,
+                                        results,
+                                        jtd -> progress,
+                                        jtd -> join_options ); break; /* above */
+
+        case ft_fastq_split_spot : rc = perform_fastq_split_spot_join( cp,
+                                        &jtd -> stats,
+                                        ti,
+                                        results,
+                                        jtd -> progress,
+                                        jtd -> join_options ); break; /* above */
+
+        case ft_fastq_split_file : rc = perform_fastq_split_file_join( cp,
+                                        &jtd -> stats,
+                                        ti,
+                                        results,
+                                        jtd -> progress,
+                                        jtd -> join_options ); break; /* above */
+
+        case ft_fastq_split_3   : rc = perform_fastq_split_3_join( cp,
+                                        &jtd -> stats,
+                                        ti,
+                                        results,
+                                        jtd -> progress,
+                                        jtd -> join_options ); break; /* above */
+
+        default : break;
+    }
+    return rc;
+}
+
+/* stream-mode: the thread works on small chunks handed out by the stream-ring, instead of one slice */
+static rc_t perform_join_chunks( join_thread_data * jtd, cmn_params * cp, struct join_results * results, tbl_iter * ti )
+{
+    rc_t rc = 0;
+    uint64_t chunk_id;
+    while ( 0 == rc &&
+            stream_ring_next_chunk( jtd -> stream, &chunk_id, &cp -> first_row, &cp -> row_count, &rc ) ) /* stream_ring.c */
+    {
+        rc = perform_join( jtd, cp, results, ti ); /* above */
+        if ( 0 == rc )
+        {
+            rc = join_results_to_stream( results, jtd -> stream, chunk_id ); /* join_results.c */
+        }
+    }
+    return rc;
+}
+
 static rc_t CC cmn_thread_func( const KThread *self, void *data )
 {
     rc_t rc = 0;
@@ -689,53 +765,37 @@ static rc_t CC cmn_thread_func( const KThread *self, void *data )
     rc = make_join_results( jtd -> dir,
                             &results,
                             jtd -> registry,
-                            jtd -> part_file,
+                            ( NULL != jtd -> stream ) ? NULL : jtd -> part_file,
                             jtd -> accession_short,
                             jtd -> buf_size,
                             4096,
                             jtd -> join_options -> print_read_nr,
                             jtd -> join_options -> print_name,
-                            jtd -> join_options -> filter_bases ); /* join_results.c */
+                            jtd -> join_options -> filter_bases,
+                            jtd -> join_options -> compress ); /* join_results.c */
 
     if ( 0 == rc && NULL != results )
     {
         cmn_params cp = { jtd -> dir, jtd -> vdb_mgr, 
                           jtd -> accession_short, jtd -> accession_path,
                           jtd -> first_row, jtd -> row_count, jtd -> cur_cache };
-        switch( jtd -> fmt )
-        {
-            case ft_whole_spot       : rc = perform_whole_spot_join( &cp,
-                                            &jtd -> stats,
-                                            jtd -> tbl_name,
-                                            results,
-                                            jtd -> progress,
-                                            jtd -> join_options ); break; /* above */
-
-            case ft_fastq_split_spot : rc = perform_fastq_split_spot_join( &cp,
-                                            &jtd -> stats,
-                                            jtd -> tbl_name,
-                                            results,
-                                            jtd -> progress,
-                                            jtd -> join_options ); break; /* above */
-
-            case ft_fastq_split_file : rc = perform_fastq_split_file_join( &cp,
-                                            &jtd -> stats,
-                                            jtd -> tbl_name,
-                                            results,
-                                            jtd -> progress,
-                                            jtd -> join_options ); break; /* above */
-
-            case ft_fastq_split_3   : rc = perform_fastq_split_3_join( &cp,
-                                            &jtd -> stats,
-                                            jtd -> tbl_name,
-                                            results,
-                                            jtd -> progress,
-                                            jtd -> join_options ); break; /* above */
-
-            default : break;
+        tbl_iter ti = { jtd -> tbl_name, NULL };
+        if ( NULL != jtd -> stream )
+        {
+            rc = perform_join_chunks( jtd, &cp, results, &ti ); /* above */
+        }
+        else
+        {
+            rc = perform_join( jtd, &cp, results, &ti ); /* above */
         }
+        destroy_fastq_sra_iter( ti . iter ); /* fastq_iter.c ( ignores NULL ) */
         destroy_join_results( results );
     }
+    if ( 0 != rc )
+    {
+        /* the writer and the other threads must not wait for a chunk this thread will never deliver */
+        stream_ring_abort( jtd -> stream ); /* stream_ring.c ( ignores NULL ) */
+    }
     return rc;
 }
 
@@ -771,6 +831,7 @@ rc_t execute_tbl_join( KDirectory * dir,
                     size_t buf_size,
                     uint32_t num_threads,
                     bool show_progress,
+                    bool to_stdout,
                     format_t fmt,
                     const join_options * join_options )
 {
@@ -789,17 +850,27 @@ rc_t execute_tbl_join( KDirectory * dir,
         rc = extract_sra_row_count( dir, vdb_mgr, accession_short, accession_path, tbl_name, cur_cache, &row_count ); /* above */
         if ( 0 == rc && row_count > 0 )
         {
-            bool name_column_present;
+            bool name_column_present, quality_column_present = false;
 
             if ( NULL == tbl_name )
             {
                 rc = cmn_check_tbl_column( dir, vdb_mgr, accession_short, accession_path,
                                            "NAME", &name_column_present );
+                if ( 0 == rc && to_stdout )
+                {
+                    rc = cmn_check_tbl_column( dir, vdb_mgr, accession_short, accession_path,
+                                               "QUALITY", &quality_column_present );
+                }
             }
             else
             {
                 rc = cmn_check_db_column( dir, vdb_mgr, accession_short, accession_path, tbl_name,
                                           "NAME", &name_column_present );
+                if ( 0 == rc && to_stdout )
+                {
+                    rc = cmn_check_db_column( dir, vdb_mgr, accession_short, accession_path, tbl_name,
+                                              "QUALITY", &quality_column_present );
+                }
             }
 
             if ( 0 == rc )
@@ -809,6 +880,7 @@ rc_t execute_tbl_join( KDirectory * dir,
                 uint32_t thread_id;
                 uint64_t rows_per_thread;
                 struct bg_progress * progress = NULL;
+                struct stream_ring * stream = NULL;
                 struct join_options corrected_join_options; /* helper.h */
 
                 VectorInit( &threads, 0, num_threads );
@@ -820,6 +892,7 @@ rc_t execute_tbl_join( KDirectory * dir,
                 corrected_join_options . min_read_len = join_options -> min_read_len;
                 corrected_join_options . filter_bases = join_options -> filter_bases;
                 corrected_join_options . terminate_on_invalid = join_options -> terminate_on_invalid;
+                corrected_join_options . compress = join_options -> compress;
 
                 if ( row_count < ( num_threads * 100 ) )
                 {
@@ -836,6 +909,25 @@ rc_t execute_tbl_join( KDirectory * dir,
                     rc = bg_progress_make( &progress, row_count, 0, 0 ); /* progress_thread.c */
                 }
 
+                if ( 0 == rc && to_stdout )
+                {
+                    /* no temp-files: the threads hand their chunks to the ring, it writes them in order,
+                       the chunks end at blob-boundaries, so no blob has to be decoded by 2 threads,
+                       tables without qualities ( fasta-only, quality-stripped ) are cut at the blobs of READ */
+                    cmn_params cp = { dir, vdb_mgr, accession_short, accession_path, 0, 0, cur_cache };
+                    int64_t first_row;
+                    int64_t * chunk_ends = NULL;
+                    uint64_t num_chunks = 0;
+                    rc = cmn_make_blob_chunks( &cp, tbl_name, quality_column_present ? "QUALITY" : "READ",
+                                               DFLT_STREAM_CHUNK_ROWS,
+                                               &first_row, &chunk_ends, &num_chunks ); /* cmn_iter.c */
+                    if ( 0 == rc )
+                    {
+                        /* the chunks are big: allow each thread one chunk in flight and a little slack */
+                        rc = make_stream_ring( &stream, first_row, chunk_ends, num_chunks, num_threads + 2 ); /* stream_ring.c */
+                    }
+                }
+
                 for ( thread_id = 0; 0 == rc && thread_id < num_threads; ++thread_id )
                 {
                     join_thread_data * jtd = calloc( 1, sizeof * jtd );
@@ -852,6 +944,7 @@ rc_t execute_tbl_join( KDirectory * dir,
                         jtd -> buf_size         = buf_size;
                         jtd -> progress         = progress;
                         jtd -> registry         = registry;
+                        jtd -> stream           = stream;
                         jtd -> fmt              = fmt;
                         jtd -> join_options     = &corrected_join_options;
 
@@ -878,6 +971,12 @@ rc_t execute_tbl_join( KDirectory * dir,
                     }
                 }
 
+                if ( 0 != rc )
+                {
+                    /* not all threads could be started, do not let the started ones wait for chunks */
+                    stream_ring_abort( stream ); /* stream_ring.c ( ignores NULL ) */
+                }
+
                 {
                     /* collect the threads, and add the join_stats */
                     uint32_t i, n = VectorLength( &threads );
@@ -902,6 +1001,13 @@ rc_t execute_tbl_join( KDirectory * dir,
                     }
                     VectorWhack ( &threads, NULL, NULL );
                 }
+
+                if ( NULL != stream )
+                {
+                    /* all join-threads are done, wait for the writer to forward the last chunks */
+                    rc_t rc2 = wait_for_and_release_stream_ring( stream ); /* stream_ring.c */
+                    rc = ( 0 == rc ) ? rc2 : rc;
+                }
                 bg_progress_release( progress ); /* progress_thread.c ( ignores NULL )*/
             }
         }
@@ -67,6 +67,7 @@ rc_t execute_tbl_join( KDirectory * dir,
                     size_t buf_size,
                     uint32_t num_threads,
                     bool show_progress,
+                    bool to_stdout, /* stream to stdout, no temp-files for the output */
                     format_t fmt,
                     const join_options * join_options ); /* helper.h */
 
@@ -0,0 +1,545 @@
+/*==============================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+* =========================================================================== */
+
+#include <kapp/main.h> /* Quitting */
+
+#include <kfs/directory.h> /* KDirectoryNativeDir */
+#include <kfs/file.h> /* KFileRead */
+
+#include <klib/log.h> /* PLOGERR */
+#include <klib/progressbar.h> /* update_progressbar */
+#include <klib/rc.h> /* RC */
+#include <klib/status.h> /* STSMSG */
+#include <klib/text.h> /* String */
+
+#include <kproc/lock.h> /* KLock */
+#include <kproc/thread.h> /* KThread */
+
+#include <strtol.h> /* strtou64 */
+
+#include "PrfMain.h"
+#include "PrfOutFile.h"
+#include "PrfRetrier.h"
+#include "PrfChunks.h"
+
+#define MAGIC "NCBIprCh"
+
+/* the chunk-map: MAGIC, file size, chunk size (uint64 each), bitmap */
+#define MAP_HDR_SIZE (sizeof MAGIC - 1 + 2 * sizeof(uint64_t))
+
+#define MIN_CHUNK (  4 * 1024 * 1024)
+#define MAX_CHUNK ( 64 * 1024 * 1024)
+#define CHUNKS_PER_CONNECTION 8
+
+typedef struct {
+    const PrfMain * mane;
+    PrfOutFile * pof;
+    const struct VPath * path;
+    const String * src;
+    bool isUri;
+
+    uint64_t size;
+    uint64_t chunkSize;
+    uint32_t count;
+    uint8_t * done;   /* bitmap of completed chunks */
+
+    KDirectory * dir;
+    KFile * map;      /* persisted bitmap: NULL without --resume */
+
+    KLock * lock;     /* protects everything below */
+    uint32_t next;    /* search for a missing chunk from here */
+    uint32_t prefix;  /* chunks [0, prefix) are completed */
+    uint64_t loaded;  /* bytes in completed chunks */
+    progressbar * pb;
+    rc_t rc;          /* first failure: stops all connections */
+    bool hashing;     /* a connection owns pof->_md5*: see PrfChunksHash */
+} PrfChunks;
+
+static uint64_t EnvChunkSize(void) {
+    static bool INITED = false;
+    static uint64_t D_CS = 0;
+
+    if (!INITED) {
+        const char * str = getenv("NCBI_VDB_PREFETCH_CHUNK_SZ");
+        if (str != NULL) {
+            char *end = NULL;
+            D_CS = strtou64(str, &end, 0);
+            if (end[0] != 0)
+                D_CS = 0;
+        }
+        INITED = true;
+    }
+
+    return D_CS;
+}
+
+static uint64_t ChunkSize(const PrfMain * mane, uint64_t size) {
+    uint64_t s = EnvChunkSize();
+
+    assert(mane);
+
+    if (s > 0)
+        return s;
+
+    s = size / ((uint64_t)mane->connections * CHUNKS_PER_CONNECTION);
+    s = (s + MIN_CHUNK - 1) / MIN_CHUNK * MIN_CHUNK;
+    if (s < MIN_CHUNK)
+        s = MIN_CHUNK;
+    else if (s > MAX_CHUNK)
+        s = MAX_CHUNK;
+
+    return s;
+}
+
+bool PrfChunksUsable(const PrfMain * mane, uint64_t size) {
+    assert(mane);
+
+    if (mane->connections < 2)
+        return false;
+    else
+        return size > ChunkSize(mane, size);
+}
+
+static bool ChunkIsDone(const PrfChunks * self, uint32_t chunk) {
+    return (self->done[chunk / 8] & (1 << (chunk % 8))) != 0;
+}
+
+static uint64_t ChunkLength(const PrfChunks * self, uint32_t chunk) {
+    uint64_t pos = (uint64_t)chunk * self->chunkSize;
+    if (self->size - pos < self->chunkSize)
+        return self->size - pos;
+    else
+        return self->chunkSize;
+}
+
+static void MapKill(PrfChunks * self, rc_t rc, const char * msg) {
+    PLOGERR(klogInt, (klogInt, rc,
+        "Cannot keep chunk-map: $(msg)", "msg=%s", msg));
+
+    KFileRelease(self->map);
+    self->map = NULL;
+}
+
+/* A map from an earlier run is used, if it describes the same remote file,
+   and the output file was not truncated since then. */
+static bool MapLoad(PrfChunks * self, uint64_t fsize) {
+    char hdr[MAP_HDR_SIZE];
+    uint64_t size = 0, chunkSize = 0;
+    rc_t rc = KFileReadExactly(self->map, 0, hdr, sizeof hdr);
+
+    if (rc != 0)
+        return false;
+    if (string_cmp(hdr, sizeof MAGIC - 1, MAGIC, sizeof MAGIC - 1,
+        sizeof MAGIC - 1) != 0)
+    {
+        return false;
+    }
+
+    memmove(&size, hdr + sizeof MAGIC - 1, sizeof size);
+    memmove(&chunkSize, hdr + sizeof MAGIC - 1 + sizeof size, sizeof chunkSize);
+    if (size != self->size || fsize != self->size || chunkSize == 0)
+        return false;
+
+    self->chunkSize = chunkSize;
+    self->count = (uint32_t)((size + chunkSize - 1) / chunkSize);
+    self->done = calloc((self->count + 7) / 8, 1);
+    if (self->done == NULL)
+        return false;
+
+    rc = KFileReadExactly(self->map, MAP_HDR_SIZE,
+        self->done, (self->count + 7) / 8);
+    if (rc != 0) {
+        free(self->done);
+        self->done = NULL;
+        return false;
+    }
+
+    STSMSG(STS_DBG, ("loaded %S%s: chunk size = %lu",
+        self->pof->cache, EXT_CHUNKS, chunkSize));
+    return true;
+}
+
+static rc_t MapStore(PrfChunks * self) {
+    char hdr[MAP_HDR_SIZE];
+    size_t num_writ = 0;
+    rc_t rc = 0;
+
+    memmove(hdr, MAGIC, sizeof MAGIC - 1);
+    memmove(hdr + sizeof MAGIC - 1, &self->size, sizeof self->size);
+    memmove(hdr + sizeof MAGIC - 1 + sizeof self->size,
+        &self->chunkSize, sizeof self->chunkSize);
+
+    rc = KFileSetSize(self->map, 0);
+    if (rc == 0)
+        rc = KFileWriteAll(self->map, 0, hdr, sizeof hdr, &num_writ);
+    if (rc == 0)
+        rc = KFileWriteAll(self->map, MAP_HDR_SIZE,
+            self->done, (self->count + 7) / 8, &num_writ);
+
+    return rc;
+}
+
+static rc_t PrfChunksInit(PrfChunks * self, const PrfMain * mane,
+    PrfOutFile * pof, const struct VPath * path, const String * src,
+    bool isUri, uint64_t size, progressbar * pb)
+{
+    rc_t rc = 0;
+    uint64_t fsize = 0;
+    bool loaded = false;
+    uint32_t i = 0;
+
+    assert(self && mane && pof && pof->file && pof->cache);
+
+    memset(self, 0, sizeof *self);
+
+    self->mane = mane;
+    self->pof = pof;
+    self->path = path;
+    self->src = src;
+    self->isUri = isUri;
+    self->size = size;
+    self->pb = pb;
+
+    rc = KLockMake(&self->lock);
+    if (rc == 0)
+        rc = KDirectoryNativeDir(&self->dir);
+    if (rc == 0)
+        rc = KFileSize(pof->file, &fsize);
+    if (rc != 0)
+        return rc;
+
+    if (pof->_resume) {
+        if (KDirectoryPathType(self->dir, "%.*s%s", pof->cache->size,
+            pof->cache->addr, EXT_CHUNKS) == kptFile)
+        {
+            rc = KDirectoryOpenFileWrite(self->dir, &self->map, true,
+                "%.*s%s", pof->cache->size, pof->cache->addr, EXT_CHUNKS);
+            if (rc == 0)
+                loaded = MapLoad(self, fsize);
+            else
+                MapKill(self, rc, "Cannot OpenFileWrite(prc)");
+        }
+        else {
+            rc = KDirectoryCreateFile(self->dir, &self->map, true, 0664,
+                kcmInit | kcmParents, "%.*s%s",
+                pof->cache->size, pof->cache->addr, EXT_CHUNKS);
+            if (rc != 0)
+                MapKill(self, rc, "Cannot CreateFile(prc)");
+        }
+        rc = 0; /* the download works without the map */
+    }
+
+    if (!loaded) {
+        self->chunkSize = ChunkSize(mane, size);
+        self->count = (uint32_t)((size + self->chunkSize - 1)
+            / self->chunkSize);
+        self->done = calloc((self->count + 7) / 8, 1);
+        if (self->done == NULL)
+            return RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+    }
+
+    /* the chunks, that were downloaded sequentially */
+    for (i = 0; i < self->count; ++i) {
+        uint64_t end = (uint64_t)i * self->chunkSize + ChunkLength(self, i);
+        if (end > pof->pos)
+            break;
+        self->done[i / 8] |= 1 << (i % 8);
+    }
+
+    if (self->map != NULL) {
+        rc = MapStore(self);
+        if (rc != 0)
+            MapKill(self, rc, "Cannot Write(prc)");
+        rc = 0;
+    }
+
+    /* preallocate: the chunks are written at their final position */
+    if (fsize != size) {
+        rc = KFileSetSize(pof->file, size);
+        DISP_RC2(rc, "Cannot SetSize", pof->tmpName);
+    }
+
+    for (i = 0; i < self->count; ++i)
+        if (ChunkIsDone(self, i))
+            self->loaded += ChunkLength(self, i);
+    while (self->prefix < self->count && ChunkIsDone(self, self->prefix))
+        ++self->prefix;
+    if (self->prefix == self->count)
+        pof->pos = size;
+
+    /* hash the chunks downloaded by an earlier run */
+    if (self->prefix == self->count)
+        PrfOutFileMd5CatchUp(pof, size);
+    else
+        PrfOutFileMd5CatchUp(pof, (uint64_t)self->prefix * self->chunkSize);
+
+    return rc;
+}
+
+static rc_t PrfChunksFini(PrfChunks * self) {
+    rc_t rc = 0;
+
+    assert(self);
+
+    RELEASE(KFile, self->map);
+    RELEASE(KDirectory, self->dir);
+    RELEASE(KLock, self->lock);
+
+    free(self->done);
+    self->done = NULL;
+
+    return rc;
+}
+
+/* hands out the next missing chunk to a connection */
+static bool PrfChunksNext(PrfChunks * self, uint32_t * chunk) {
+    bool found = false;
+
+    assert(self && chunk);
+
+    KLockAcquire(self->lock);
+
+    if (self->rc == 0 && Quitting() == 0) {
+        while (self->next < self->count && ChunkIsDone(self, self->next))
+            ++self->next;
+        if (self->next < self->count) {
+            *chunk = self->next++;
+            found = true;
+        }
+    }
+
+    KLockUnlock(self->lock);
+
+    return found;
+}
+
+/* The MD5 state of the output file has a single owner at a time: the hasher.
+   It hashes outside of the lock, so the other connections don't wait for it;
+   a connection that finds another hasher doesn't hash at all.
+   buffer != NULL: the data just written at pos, appended if it is the next to
+   be hashed. Before leaving, the hasher reads back and hashes the completed
+   prefix [_md5Pos, pof->pos): chunks that completed before the ones preceding
+   them, or whose hashing was skipped meanwhile. */
+static void PrfChunksHash(PrfChunks * self,
+    uint64_t pos, const void * buffer, size_t size)
+{
+    uint64_t end = 0;
+
+    assert(self);
+
+    KLockAcquire(self->lock);
+    if (self->hashing || (buffer != NULL && pos != self->pof->_md5Pos)) {
+        KLockUnlock(self->lock);
+        return;
+    }
+    self->hashing = true;
+    KLockUnlock(self->lock);
+
+    if (buffer != NULL)
+        PrfOutFileMd5Append(self->pof, pos, buffer, size);
+
+    KLockAcquire(self->lock);
+    while (!self->pof->_md5Lost && (end = self->pof->pos) > self->pof->_md5Pos)
+    {
+        KLockUnlock(self->lock);
+        PrfOutFileMd5CatchUp(self->pof, end);
+        KLockAcquire(self->lock);
+    }
+    self->hashing = false;
+    KLockUnlock(self->lock);
+}
+
+static void PrfChunksDone(PrfChunks * self, uint32_t chunk, rc_t rc) {
+    assert(self);
+
+    KLockAcquire(self->lock);
+
+    if (rc != 0) {
+        if (self->rc == 0)
+            self->rc = rc;
+    }
+    else {
+        self->done[chunk / 8] |= 1 << (chunk % 8);
+        self->loaded += ChunkLength(self, chunk);
+
+        if (self->map != NULL) {
+            size_t num_writ = 0;
+            rc_t r2 = KFileWriteAll(self->map, MAP_HDR_SIZE + chunk / 8,
+                &self->done[chunk / 8], 1, &num_writ);
+            if (r2 != 0)
+                MapKill(self, r2, "Cannot Write(prc)");
+        }
+
+        while (self->prefix < self->count && ChunkIsDone(self, self->prefix))
+            ++self->prefix;
+        if (self->prefix == self->count)
+            self->pof->pos = self->size;
+        else
+            self->pof->pos = (uint64_t)self->prefix * self->chunkSize;
+
+        if (self->pb != NULL)
+            update_progressbar(self->pb, 100 * 100 * self->loaded / self->size);
+    }
+
+    KLockUnlock(self->lock);
+
+    /* chunks that completed before the ones preceding them:
+       read them back while they are still cached */
+    if (rc == 0)
+        PrfChunksHash(self, 0, NULL, 0);
+}
+
+static rc_t PrfChunksFetch(PrfChunks * self, const KFile ** in,
+    uint32_t chunk, char * buffer)
+{
+    rc_t rc = 0;
+    uint64_t pos = (uint64_t)chunk * self->chunkSize;
+    uint64_t end = pos + ChunkLength(self, chunk);
+    PrfRetrier retrier;
+
+    PrfRetrierInit(&retrier, self->mane, self->path,
+        self->src, self->isUri, in, self->size, pos);
+
+    while (rc == 0 && pos < end) {
+        size_t num_read = 0, num_writ = 0;
+        size_t to_read = retrier.curSize;
+        if (to_read > end - pos)
+            to_read = end - pos;
+
+        rc = Quitting();
+        if (rc != 0)
+            break;
+
+        rc = KFileRead(*in, pos, buffer, to_read, &num_read);
+        if (rc != 0) {
+            rc = PrfRetrierAgain(&retrier, rc, pos);
+            continue;
+        }
+        else if (num_read == 0) {
+            rc = RC(rcExe, rcFile, rcReading, rcTransfer, rcIncomplete);
+            PLOGERR(klogErr, (klogErr, rc, "Cannot KFileRead '$(name)': "
+                "unexpected end at $(pos)", "name=%S,pos=%lu",
+                self->src, pos));
+            break;
+        }
+
+        rc = KFileWriteAll(self->pof->file, pos, buffer, num_read, &num_writ);
+        DISP_RC2(rc, "Cannot KFileWrite", self->pof->tmpName);
+        if (rc == 0 && num_writ != num_read)
+            rc = RC(rcExe, rcFile, rcCopying, rcTransfer, rcIncomplete);
+
+        if (rc == 0) {
+            /* the connection at the head of the file hashes as it writes */
+            PrfChunksHash(self, pos, buffer, num_read);
+
+            pos += num_read;
+            PrfRetrierReset(&retrier, pos);
+        }
+    }
+
+    return rc;
+}
+
+/* a connection: its own remote file and buffer */
+static rc_t CC PrfChunksConnection(const KThread * thread, void * data) {
+    PrfChunks * self = data;
+    const KFile * in = NULL;
+    uint32_t chunk = 0;
+
+    char * buffer = malloc(self->mane->bsize);
+    rc_t rc = 0;
+
+    if (buffer == NULL)
+        rc = RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+    else
+        rc = _KFileOpenRemote(&in, self->mane->kns, self->path,
+            self->src, !self->isUri);
+
+    if (rc != 0) {
+        PrfChunksDone(self, 0, rc);
+        free(buffer);
+        return rc;
+    }
+
+    while (PrfChunksNext(self, &chunk)) {
+        rc = PrfChunksFetch(self, &in, chunk, buffer);
+        PrfChunksDone(self, chunk, rc);
+        if (rc != 0)
+            break;
+    }
+
+    RELEASE(KFile, in);
+    free(buffer);
+
+    return rc;
+}
+
+rc_t PrfChunksDownload(const PrfMain * mane, PrfOutFile * pof,
+    const struct VPath * path, const String * src, bool isUri,
+    uint64_t size, progressbar * pb)
+{
+    KThread * threads[MAX_CONNECTIONS];
+    uint32_t n = 0, i = 0, missing = 0;
+    PrfChunks self;
+
+    rc_t rc = PrfChunksInit(&self, mane, pof, path, src, isUri, size, pb);
+
+    for (i = 0; rc == 0 && i < self.count; ++i)
+        if (!ChunkIsDone(&self, i))
+            ++missing;
+
+    if (rc == 0)
+        STSMSG(STS_INFO, ("%S: %u of %u chunks of %lu bytes to download, "
+            "%u connections", src, missing, self.count, self.chunkSize,
+            missing < mane->connections ? missing : mane->connections));
+
+    while (rc == 0 && n < mane->connections && n < missing) {
+        rc = KThreadMake(&threads[n], PrfChunksConnection, &self);
+        DISP_RC(rc, "Cannot KThreadMake");
+        if (rc == 0)
+            ++n;
+        else
+            PrfChunksDone(&self, 0, rc); /* stops the started connections */
+    }
+
+    for (i = 0; i < n; ++i) {
+        rc_t status = 0;
+        KThreadWait(threads[i], &status);
+        KThreadRelease(threads[i]);
+    }
+
+    if (rc == 0)
+        rc = self.rc;
+    if (rc == 0)
+        rc = Quitting();
+    if (rc == 0 && self.prefix != self.count)
+        rc = RC(rcExe, rcFile, rcCopying, rcTransfer, rcIncomplete);
+
+    {
+        rc_t r2 = PrfChunksFini(&self);
+        if (rc == 0 && r2 != 0)
+            rc = r2;
+    }
+
+    return rc;
+}
@@ -0,0 +1,44 @@
+/*==============================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+* =========================================================================== */
+
+#include <kfc/defs.h> /* rc_t */
+
+/* Parallel ranged HTTP download:
+   the remote file is cut into chunks, which are fetched by a pool of
+   connections concurrently into the preallocated PrfOutFile.
+   With --resume the completed chunks are recorded in a chunk-map next to the
+   transaction file (EXT_CHUNKS), so a retry or a resumed download fetches only
+   the missing chunks. */
+
+struct PrfMain;
+struct PrfOutFile;
+struct VPath;
+struct String;
+struct progressbar;
+
+/* Is the parallel download worth it for a file of this size? */
+bool PrfChunksUsable(const struct PrfMain * mane, uint64_t size);
+
+rc_t PrfChunksDownload(const struct PrfMain * mane, struct PrfOutFile * pof,
+    const struct VPath * path, const struct String * src, bool isUri,
+    uint64_t size, struct progressbar * pb);
@@ -0,0 +1,260 @@
+/*==============================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+* =========================================================================== */
+
+#include <klib/rc.h> /* RC */
+#include <klib/status.h> /* STSMSG */
+
+#include <kproc/cond.h> /* KCondition */
+#include <kproc/lock.h> /* KLock */
+#include <kproc/thread.h> /* KThread */
+
+#include "PrfJobs.h"
+#include "PrfMain.h"
+
+#include <stdlib.h> /* calloc */
+#include <string.h> /* memset */
+
+/* queued jobs per thread */
+#define QUEUE_PER_JOB 2
+
+typedef struct {
+    PrfJobFn fn;
+    void * job;
+} PrfJob;
+
+typedef struct {
+    struct PrfJobs * pool;
+    PrfMain mane; /* the thread's copy */
+    KThread * thread;
+} PrfJobThread;
+
+typedef struct PrfJobs {
+    KLock * lock;
+    KCondition * ready; /* a job was queued or the pool is closing */
+    KCondition * room;  /* a job was taken or finished */
+
+    PrfJob * queue;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t queued;
+    uint32_t busy;  /* jobs being run */
+    bool closing;
+
+    PrfJobThread * threads;
+    uint32_t count;
+
+    rc_t rc; /* first failure since the last PrfJobsWait */
+} PrfJobs;
+
+static rc_t CC PrfJobsRun(const KThread * thread, void * data) {
+    PrfJobThread * self = data;
+    PrfJobs * pool = NULL;
+
+    assert(self && self->pool);
+    pool = self->pool;
+
+    KLockAcquire(pool->lock);
+    while (true) {
+        PrfJob job;
+        rc_t rc = 0;
+
+        while (pool->queued == 0 && !pool->closing)
+            KConditionWait(pool->ready, pool->lock);
+        if (pool->queued == 0)
+            break; /* closing */
+
+        job = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        --pool->queued;
+        ++pool->busy;
+        KConditionBroadcast(pool->room);
+        KLockUnlock(pool->lock);
+
+        /* settings could change between command line arguments */
+        PrfMainJobSync(&self->mane);
+        rc = job.fn(&self->mane, job.job);
+        PrfMainJobSync(&self->mane); /* to be reported by the parent */
+
+        KLockAcquire(pool->lock);
+        --pool->busy;
+        if (rc != 0 && pool->rc == 0)
+            pool->rc = rc;
+        KConditionBroadcast(pool->room);
+    }
+    KLockUnlock(pool->lock);
+
+    return 0;
+}
+
+rc_t PrfJobsMake(PrfJobs ** aSelf, const PrfMain * mane, uint32_t count) {
+    rc_t rc = 0;
+    PrfJobs * self = NULL;
+    uint32_t i = 0;
+
+    assert(aSelf && mane && count > 0);
+
+    *aSelf = NULL;
+
+    self = calloc(1, sizeof *self);
+    if (self == NULL)
+        return RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+
+    self->capacity = count * QUEUE_PER_JOB;
+    self->queue = calloc(self->capacity, sizeof *self->queue);
+    self->threads = calloc(count, sizeof *self->threads);
+    if (self->queue == NULL || self->threads == NULL)
+        rc = RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+
+    if (rc == 0) {
+        rc = KLockMake(&self->lock);
+        DISP_RC(rc, "KLockMake");
+    }
+    if (rc == 0) {
+        rc = KConditionMake(&self->ready);
+        DISP_RC(rc, "KConditionMake");
+    }
+    if (rc == 0) {
+        rc = KConditionMake(&self->room);
+        DISP_RC(rc, "KConditionMake");
+    }
+
+    for (i = 0; rc == 0 && i < count; ++i) {
+        PrfJobThread * t = &self->threads[i];
+        t->pool = self;
+        rc = PrfMainJobInit(&t->mane, mane);
+        if (rc == 0) {
+            rc = KThreadMake(&t->thread, PrfJobsRun, t);
+            DISP_RC(rc, "Cannot KThreadMake");
+        }
+        if (rc != 0)
+            PrfMainJobFini(&t->mane);
+        else
+            ++self->count;
+    }
+
+    if (rc == 0) {
+        STSMSG(STS_DBG, ("started %u download jobs", count));
+        *aSelf = self;
+    }
+    else
+        PrfJobsRelease(self);
+
+    return rc;
+}
+
+rc_t PrfJobsAdd(PrfJobs * self, PrfJobFn fn, void * job) {
+    assert(self && fn);
+
+    KLockAcquire(self->lock);
+
+    while (self->queued == self->capacity)
+        KConditionWait(self->room, self->lock);
+
+    self->queue[(self->head + self->queued) % self->capacity].fn = fn;
+    self->queue[(self->head + self->queued) % self->capacity].job = job;
+    ++self->queued;
+
+    KConditionSignal(self->ready);
+
+    KLockUnlock(self->lock);
+
+    return 0;
+}
+
+bool PrfJobsTryAdd(PrfJobs * self, PrfJobFn fn, void * job) {
+    bool added = false;
+
+    assert(self && fn);
+
+    KLockAcquire(self->lock);
+
+    if (self->queued < self->capacity && !self->closing) {
+        self->queue[(self->head + self->queued) % self->capacity].fn = fn;
+        self->queue[(self->head + self->queued) % self->capacity].job = job;
+        ++self->queued;
+        added = true;
+
+        KConditionSignal(self->ready);
+    }
+
+    KLockUnlock(self->lock);
+
+    return added;
+}
+
+rc_t PrfJobsWait(PrfJobs * self) {
+    rc_t rc = 0;
+
+    assert(self);
+
+    KLockAcquire(self->lock);
+
+    while (self->queued > 0 || self->busy > 0)
+        KConditionWait(self->room, self->lock);
+
+    rc = self->rc;
+    self->rc = 0;
+
+    KLockUnlock(self->lock);
+
+    return rc;
+}
+
+rc_t PrfJobsRelease(PrfJobs * self) {
+    rc_t rc = 0;
+    uint32_t i = 0;
+
+    if (self == NULL)
+        return 0;
+
+    if (self->lock != NULL) {
+        KLockAcquire(self->lock);
+        self->closing = true;
+        if (self->ready != NULL)
+            KConditionBroadcast(self->ready);
+        KLockUnlock(self->lock);
+    }
+
+    for (i = 0; i < self->count; ++i) {
+        PrfJobThread * t = &self->threads[i];
+        rc_t status = 0;
+        KThreadWait(t->thread, &status);
+        RELEASE(KThread, t->thread);
+        PrfMainJobFini(&t->mane);
+    }
+
+    if (rc == 0)
+        rc = self->rc;
+
+    RELEASE(KCondition, self->room);
+    RELEASE(KCondition, self->ready);
+    RELEASE(KLock, self->lock);
+
+    free(self->threads);
+    free(self->queue);
+
+    memset(self, 0, sizeof *self);
+    free(self);
+
+    return rc;
+}
@@ -0,0 +1,49 @@
+/*==============================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+* =========================================================================== */
+
+#include <kfc/defs.h> /* rc_t */
+
+/* --jobs: a pool of threads, that download items of a run concurrently.
+   Each thread works with its own copy of PrfMain (PrfMainJobInit):
+   the copies share everything but the download buffer. */
+
+struct PrfMain;
+struct PrfJobs;
+
+typedef rc_t (*PrfJobFn)(struct PrfMain * mane, void * job);
+
+rc_t PrfJobsMake(struct PrfJobs ** self,
+    const struct PrfMain * mane, uint32_t count);
+
+/* Queues a job: blocks while the queue is full */
+rc_t PrfJobsAdd(struct PrfJobs * self, PrfJobFn fn, void * job);
+
+/* Queues a job, if there is room: used by the jobs themselves,
+   that cannot wait for the queue without risking a deadlock */
+bool PrfJobsTryAdd(struct PrfJobs * self, PrfJobFn fn, void * job);
+
+/* Waits until the queued jobs are done.
+   Returns the first failure since the previous call. */
+rc_t PrfJobsWait(struct PrfJobs * self);
+
+rc_t PrfJobsRelease(struct PrfJobs * self);
@@ -40,6 +40,9 @@
 #include <kns/kns-mgr-priv.h> /* KNSManagerMakeReliableHttpFile */
 #include <kns/manager.h> /* KNSManagerRelease */
 
+#include <kproc/cond.h> /* KConditionMake */
+#include <kproc/lock.h> /* KLockMake */
+
 #include <vdb/database.h> /* VDBManagerOpenDBRead */
 #include <vdb/dependencies.h> /* VDatabaseListDependencies */
 #include <vdb/manager.h> /* VDBManagerPathType */
@@ -49,6 +52,9 @@
 #include <vfs/path.h> /* VPathGetCeRequired */
 #include <vfs/resolver.h> /* VResolverRelease */
 
+#include <strtol.h> /* strtou64 */
+
+#include "PrfJobs.h"
 #include "PrfMain.h"
 
 #include <time.h> /* time */
@@ -122,6 +128,7 @@ rc_t _KFileOpenRemote(const struct KFile **self, KNSManager *kns,
 typedef struct {
     BSTNode n;
     char *path;
+    bool busy; /* refseqs: is being downloaded by a job */
 } TreeNode;
 
 static int64_t CC bstCmp(const void *item, const BSTNode *n) {
@@ -168,6 +175,18 @@ bool PrfMainUseAscp(PrfMain *self) {
 
     assert(self);
 
+    if (self->parent != NULL) { /* ascp is located once for all jobs */
+        bool use = false;
+        PrfMain * parent = (PrfMain*)self->parent;
+        PrfMainLock(parent);
+        use = PrfMainUseAscp(parent);
+        self->ascpChecked = parent->ascpChecked;
+        self->ascp = parent->ascp;
+        self->asperaKey = parent->asperaKey;
+        PrfMainUnlock(parent);
+        return use;
+    }
+
     if (self->ascpChecked) {
         return self->ascp != NULL;
     }
@@ -182,26 +201,46 @@ bool PrfMainUseAscp(PrfMain *self) {
     return rc == 0 && self->ascp && self->asperaKey;
 }
 
-bool PrfMainHasDownloaded(const PrfMain *self, const char *local) {
-    TreeNode *sn = NULL;
-
+/* the jobs share the state of their parent */
+static const PrfMain * PrfMainRoot(const PrfMain *self) {
     assert(self);
 
-    sn = (TreeNode*)BSTreeFind(&self->downloaded, local, bstCmp);
+    if (self->parent != NULL)
+        return self->parent;
+    else
+        return self;
+}
 
-    return sn != NULL;
+void PrfMainLock(const PrfMain *self) {
+    self = PrfMainRoot(self);
+
+    if (self->lock != NULL)
+        KLockAcquire(self->lock);
 }
 
-rc_t PrfMainDownloaded(PrfMain *self, const char *path) {
-    TreeNode *sn = NULL;
+void PrfMainUnlock(const PrfMain *self) {
+    self = PrfMainRoot(self);
 
-    assert(self);
+    if (self->lock != NULL)
+        KLockUnlock(self->lock);
+}
 
-    if (PrfMainHasDownloaded(self, path)) {
-        return 0;
-    }
+void PrfMainMgrLock(const PrfMain *self) {
+    self = PrfMainRoot(self);
+
+    if (self->mgrLock != NULL)
+        KLockAcquire(self->mgrLock);
+}
+
+void PrfMainMgrUnlock(const PrfMain *self) {
+    self = PrfMainRoot(self);
+
+    if (self->mgrLock != NULL)
+        KLockUnlock(self->mgrLock);
+}
 
-    sn = calloc(1, sizeof *sn);
+static rc_t BSTreeAddPath(BSTree *self, const char *path) {
+    TreeNode *sn = calloc(1, sizeof *sn);
     if (sn == NULL) {
         return RC(rcExe, rcStorage, rcAllocating, rcMemory, rcExhausted);
     }
@@ -213,12 +252,177 @@ rc_t PrfMainDownloaded(PrfMain *self, const char *path) {
         return RC(rcExe, rcStorage, rcAllocating, rcMemory, rcExhausted);
     }
 
-    BSTreeInsert(&self->downloaded, (BSTNode*)sn, bstSort);
+    BSTreeInsert(self, (BSTNode*)sn, bstSort);
 
     return 0;
 }
 
-rc_t PrfMainDependenciesList(const PrfMain *self, const Resolved *resolved,
+bool PrfMainHasDownloaded(const PrfMain *self, const char *local) {
+    TreeNode *sn = NULL;
+
+    assert(self);
+
+    PrfMainLock(self);
+    sn = (TreeNode*)BSTreeFind(&PrfMainRoot(self)->downloaded, local, bstCmp);
+    PrfMainUnlock(self);
+
+    return sn != NULL;
+}
+
+rc_t PrfMainDownloaded(PrfMain *self, const char *path) {
+    rc_t rc = 0;
+    PrfMain * root = NULL;
+
+    assert(self);
+
+    root = (PrfMain*)PrfMainRoot(self);
+
+    PrfMainLock(root);
+    if (BSTreeFind(&root->downloaded, path, bstCmp) == NULL)
+        rc = BSTreeAddPath(&root->downloaded, path);
+    PrfMainUnlock(root);
+
+    return rc;
+}
+
+struct PrfJobs * PrfMainPool(const PrfMain *self) {
+    return PrfMainRoot(self)->pool;
+}
+
+int PrfMainNumberItem(const PrfMain *self, int32_t row) {
+    PrfMain * root = NULL;
+    int n = 0;
+
+    assert(self);
+
+    root = (PrfMain*)PrfMainRoot(self);
+
+    PrfMainLock(root);
+    if (row > 0)
+        root->itemNumber = row;
+    else
+        ++root->itemNumber;
+    n = root->itemNumber;
+    PrfMainUnlock(root);
+
+    return n;
+}
+
+bool PrfMainTakeRefseq(const PrfMain *self, const char *key) {
+    bool taken = false;
+    PrfMain * root = NULL;
+
+    assert(self && key);
+
+    root = (PrfMain*)PrfMainRoot(self);
+    if (root->pool == NULL)
+        return true;
+
+    PrfMainLock(root);
+    while (true) {
+        TreeNode * sn
+            = (TreeNode*)BSTreeFind(&root->refseqs, key, bstCmp);
+        if (sn == NULL) {
+            /* cannot record it: download it anyway */
+            taken = true;
+            if (BSTreeAddPath(&root->refseqs, key) == 0) {
+                sn = (TreeNode*)BSTreeFind(&root->refseqs, key, bstCmp);
+                assert(sn);
+                sn->busy = true;
+            }
+            break;
+        }
+        else if (!sn->busy)
+            break; /* downloaded */
+
+        KConditionWait(root->refseqDone, root->lock);
+    }
+    PrfMainUnlock(root);
+
+    return taken;
+}
+
+void PrfMainRefseqDone(const PrfMain *self, const char *key, rc_t rc) {
+    PrfMain * root = NULL;
+    TreeNode * sn = NULL;
+
+    assert(self && key);
+
+    root = (PrfMain*)PrfMainRoot(self);
+    if (root->pool == NULL)
+        return;
+
+    PrfMainLock(root);
+    sn = (TreeNode*)BSTreeFind(&root->refseqs, key, bstCmp);
+    if (sn != NULL) {
+        if (rc == 0)
+            sn->busy = false;
+        else {
+            /* a waiting job takes it over */
+            BSTreeUnlink(&root->refseqs, (BSTNode*)sn);
+            bstWhack((BSTNode*)sn, NULL);
+        }
+    }
+    KConditionBroadcast(root->refseqDone);
+    PrfMainUnlock(root);
+}
+
+rc_t PrfMainJobInit(PrfMain *self, const PrfMain *parent) {
+    assert(self && parent);
+
+    memset(self, 0, sizeof *self);
+
+    self->bsize = parent->bsize;
+    self->buffer = malloc(self->bsize);
+    if (self->buffer == NULL)
+        return RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+
+    self->parent = parent;
+    PrfMainJobSync(self);
+
+    return 0;
+}
+
+void PrfMainJobSync(PrfMain *self) {
+    PrfMain * parent = NULL;
+    void * buffer = NULL;
+    size_t bsize = 0;
+
+    assert(self && self->parent);
+
+    parent = (PrfMain*)self->parent;
+    buffer = self->buffer;
+    bsize = self->bsize;
+
+    PrfMainLock(parent);
+
+    if (self->undersized)
+        parent->undersized = true;
+    if (self->oversized)
+        parent->oversized = true;
+
+    *self = *parent;
+
+    PrfMainUnlock(parent);
+
+    self->buffer = buffer;
+    self->bsize = bsize;
+    self->parent = parent;
+    self->pool = NULL;
+}
+
+void PrfMainJobFini(PrfMain *self) {
+    assert(self);
+
+    if (self->parent != NULL)
+        PrfMainJobSync(self);
+
+    free(self->buffer);
+
+    memset(self, 0, sizeof *self);
+}
+
+static rc_t DependenciesList(const PrfMain *self, const Resolved *resolved,
     const struct VDBDependencies **deps)
 {
     rc_t rc = 0;
@@ -282,6 +486,18 @@ rc_t PrfMainDependenciesList(const PrfMain *self, const Resolved *resolved,
     return rc;
 }
 
+rc_t PrfMainDependenciesList(const PrfMain *self, const Resolved *resolved,
+    const struct VDBDependencies **deps)
+{
+    rc_t rc = 0;
+
+    PrfMainMgrLock(self);
+    rc = DependenciesList(self, resolved, deps);
+    PrfMainMgrUnlock(self);
+
+    return rc;
+}
+
 rc_t PrfMainOutDirCheck(PrfMain * self, bool * setAndNotExists) {
     assert(self && setAndNotExists);
 
@@ -380,6 +596,17 @@ static const char* FORCE_USAGE[] = {
 static const char* RESUME_USAGE[] = {
     "Resume partial downloads: one of: no, yes [default].", NULL };
 
+#define CONNECTIONS_OPTION "connections"
+static const char* CONNECTIONS_USAGE[] = {
+    "Number of concurrent HTTP range-requests per file, default: 1.",
+    "Large files are downloaded in chunks, "
+    "a resumed download fetches only the missing chunks.", NULL };
+
+#define JOBS_OPTION "jobs"
+static const char* JOBS_USAGE[] = {
+    "Number of kart items, runs and their dependencies "
+    "to download concurrently, default: 1.", NULL };
+
 #define FAIL_ASCP_OPTION "FAIL-ASCP"
 #define FAIL_ASCP_ALIAS  "F"
 static const char* FAIL_ASCP_USAGE[] = {
@@ -488,6 +715,8 @@ static OptDef OPTIONS[] = {
 ,{ FORCE_OPTION       , FORCE_ALIAS       , NULL, FORCE_USAGE , 1, true, false }
 ,{ RESUME_OPTION      , RESUME_ALIAS      , NULL, RESUME_USAGE, 1, true, false }
 ,{ VALIDATE_OPTION    , VALIDATE_ALIAS    , NULL,VALIDATE_USAGE,1, true, false }
+,{ CONNECTIONS_OPTION , NULL           ,NULL,CONNECTIONS_USAGE,1, true, false }
+,{ JOBS_OPTION        , NULL              , NULL, JOBS_USAGE  , 1, true, false }
 ,{ PRGRS_OPTION       , PRGRS_ALIAS       , NULL, PRGRS_USAGE , 1, false,false }
 ,{ HBEAT_OPTION       , HBEAT_ALIAS       , NULL, HBEAT_USAGE , 1, true, false }
 ,{ ELIM_QUALS_OPTION  , NULL             ,NULL,ELIM_QUALS_USAGE,1, false,false }
@@ -730,6 +959,76 @@ option_name = VALIDATE_OPTION;
     }
 }
 
+option_name = CONNECTIONS_OPTION;
+{
+    self->connections = 1; /* one stream per file by default */
+    rc = ArgsOptionCount(self->args, option_name, &pcount);
+    if (rc != 0) {
+        PLOGERR(klogInt, (klogInt, rc,
+            "Failure to get '$(opt)' argument", "opt=%s", option_name));
+        break;
+    }
+
+    if (pcount > 0) {
+        const char *val = NULL;
+        char *end = NULL;
+        uint64_t n = 0;
+        rc = ArgsOptionValue(
+            self->args, option_name, 0, (const void **)&val);
+        if (rc != 0) {
+            PLOGERR(klogInt, (klogInt, rc, "Failure to get "
+                "'$(opt)' argument value", "opt=%s", option_name));
+            break;
+        }
+        if (val != NULL)
+            n = strtou64(val, &end, 0);
+        if (val == NULL || end == val || end[0] != '\0'
+            || n == 0 || n > MAX_CONNECTIONS)
+        {
+            rc = RC(rcExe, rcArgv, rcParsing, rcParam, rcInvalid);
+            PLOGERR(klogInt, (klogInt, rc, "Unrecognized "
+                "'$(opt)' argument value", "opt=%s", option_name));
+            break;
+        }
+        self->connections = (uint32_t)n;
+    }
+}
+
+option_name = JOBS_OPTION;
+{
+    self->jobs = 1; /* one item at a time by default */
+    rc = ArgsOptionCount(self->args, option_name, &pcount);
+    if (rc != 0) {
+        PLOGERR(klogInt, (klogInt, rc,
+            "Failure to get '$(opt)' argument", "opt=%s", option_name));
+        break;
+    }
+
+    if (pcount > 0) {
+        const char *val = NULL;
+        char *end = NULL;
+        uint64_t n = 0;
+        rc = ArgsOptionValue(
+            self->args, option_name, 0, (const void **)&val);
+        if (rc != 0) {
+            PLOGERR(klogInt, (klogInt, rc, "Failure to get "
+                "'$(opt)' argument value", "opt=%s", option_name));
+            break;
+        }
+        if (val != NULL)
+            n = strtou64(val, &end, 0);
+        if (val == NULL || end == val || end[0] != '\0'
+            || n == 0 || n > MAX_JOBS)
+        {
+            rc = RC(rcExe, rcArgv, rcParsing, rcParam, rcInvalid);
+            PLOGERR(klogInt, (klogInt, rc, "Unrecognized "
+                "'$(opt)' argument value", "opt=%s", option_name));
+            break;
+        }
+        self->jobs = (uint32_t)n;
+    }
+}
+
 #if 0
 /******* LIST OPTIONS BEGIN ********/
 /* LIST_OPTION */
@@ -1308,6 +1607,11 @@ rc_t CC Usage(const Args *args) {
         {
             param = "PATH";
         }
+        else if (strcmp(opt->name, CONNECTIONS_OPTION) == 0
+            || strcmp(opt->name, JOBS_OPTION) == 0)
+        {
+            param = "count";
+        }
         else if (strcmp(opt->name, OUT_FILE_OPTION) == 0) {
             param = "FILE";
             alias = OUT_FILE_ALIAS;
@@ -1342,6 +1646,15 @@ rc_t PrfMainFini(PrfMain *self) {
 
     assert(self);
 
+    if (self->pool != NULL) {
+        rc = PrfJobsRelease(self->pool);
+        self->pool = NULL;
+    }
+    RELEASE(KCondition, self->refseqDone);
+    RELEASE(KLock, self->mgrLock);
+    RELEASE(KLock, self->lock);
+    BSTreeWhack(&self->refseqs, bstWhack, NULL);
+
     RELEASE(VResolver, self->resolver);
     RELEASE(VDBManager, self->mgr);
     RELEASE(KDirectory, self->dir);
@@ -1375,6 +1688,7 @@ rc_t PrfMainInit(int argc, char *argv[], PrfMain *self) {
     /*  self->heartbeat = 69; */
 
     BSTreeInit(&self->downloaded);
+    BSTreeInit(&self->refseqs);
 
     if (rc == 0) {
         rc = PrfMainProcessArgs(self, argc, argv);
@@ -1444,6 +1758,21 @@ rc_t PrfMainInit(int argc, char *argv[], PrfMain *self) {
         srand((unsigned)time(NULL));
     }
 
+    if (rc == 0 && self->jobs > 1 && !self->list_kart) {
+        rc = KLockMake(&self->lock);
+        DISP_RC(rc, "KLockMake");
+        if (rc == 0) {
+            rc = KLockMake(&self->mgrLock);
+            DISP_RC(rc, "KLockMake");
+        }
+        if (rc == 0) {
+            rc = KConditionMake(&self->refseqDone);
+            DISP_RC(rc, "KConditionMake");
+        }
+        if (rc == 0)
+            rc = PrfJobsMake(&self->pool, self, self->jobs);
+    }
+
     return rc;
 }
 
@@ -115,6 +115,8 @@ typedef struct PrfMain {
     EForce force;
     bool resume;
     bool validate;
+    uint32_t connections; /* concurrent range-requests per file */
+    uint32_t jobs; /* items downloaded concurrently */
 
     struct KConfig *cfg;
     struct KDirectory *dir;
@@ -134,6 +136,15 @@ typedef struct PrfMain {
 
     BSTree downloaded;
 
+    /* --jobs: PrfJobs.c */
+    struct PrfJobs * pool;
+    struct KLock * lock; /* guards the state shared by the jobs */
+    struct KLock * mgrLock; /* serializes the jobs' use of mgr */
+    const struct PrfMain * parent; /* of a job's copy of PrfMain */
+    BSTree refseqs; /* dependencies taken by the jobs */
+    struct KCondition * refseqDone; /* a job finished a dependency */
+    int itemNumber; /* of the item numbered last */
+
     uint64_t minSize;
     uint64_t maxSize;
     uint64_t heartbeat;
@@ -183,6 +194,31 @@ rc_t _VDBManagerSetDbGapCtx(
 bool PrfMainHasDownloaded(const PrfMain *self, const char *local);
 rc_t PrfMainDownloaded(PrfMain *self, const char *path);
 bool PrfMainUseAscp(PrfMain *self);
+
+/* a job's copy of PrfMain: everything but the download buffer is shared */
+rc_t PrfMainJobInit(PrfMain *self, const PrfMain *parent);
+/* passes the job's findings to the parent and takes its current settings */
+void PrfMainJobSync(PrfMain *self);
+void PrfMainJobFini(PrfMain *self);
+/* the state shared by the jobs */
+void PrfMainLock(const PrfMain *self);
+void PrfMainUnlock(const PrfMain *self);
+/* the jobs set dbGaP context of the shared VDBManager: one at a time */
+void PrfMainMgrLock(const PrfMain *self);
+void PrfMainMgrUnlock(const PrfMain *self);
+/* the pool of the jobs, NULL without --jobs */
+struct PrfJobs * PrfMainPool(const PrfMain *self);
+/* the number of the next item in the output, row > 0: the row of a kart item.
+   Called before an item is given to a job: the numbers follow the input */
+int PrfMainNumberItem(const PrfMain *self, int32_t row);
+/* A dependency is downloaded by a single job at a time. The key is its
+   location: runs stored in their own directories each get a copy.
+   true: the caller downloads it and reports the result by PrfMainRefseqDone;
+   false: another job has downloaded it.
+   Blocks while another job is downloading it. */
+bool PrfMainTakeRefseq(const PrfMain *self, const char *key);
+/* after a failure the dependency can be taken by another job */
+void PrfMainRefseqDone(const PrfMain *self, const char *key, rc_t rc);
 rc_t PrfMainDependenciesList(const PrfMain *self,
     const Resolved *resolved, const struct VDBDependencies **deps);
 rc_t PrfMainInit(int argc, char *argv[], PrfMain *self);
@@ -201,6 +237,9 @@ rc_t PrfMainFini(PrfMain *self);
 #define STS_DBG  2
 #define STS_FIN  3
 
+#define MAX_CONNECTIONS 64
+#define MAX_JOBS 64
+
 #define KART_OPTION "cart"
 #define MINSZ_OPTION "min-size"
 #define NGC_OPTION "ngc"
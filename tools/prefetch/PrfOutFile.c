@@ -109,6 +109,18 @@ static rc_t TFRm(PrfOutFile * self) {
         return 0;
 }
 
+static rc_t CMRm(PrfOutFile * self) {
+    assert(self && self->cache);
+
+    if (KDirectory_Exist(self->_dir, self->cache, EXT_CHUNKS)) {
+        STSMSG(STS_DBG, ("removing %S%s", self->cache, EXT_CHUNKS));
+        return KDirectoryRemove(self->_dir, false,
+            "%.*s%s", self->cache->size, self->cache->addr, EXT_CHUNKS);
+    }
+    else
+        return 0;
+}
+
 static rc_t TFRmEmpty(PrfOutFile * self) {
     if (TFExist(self)) {
         const KFile * f = NULL;
@@ -591,7 +603,7 @@ static rc_t TFNegotiatePos(PrfOutFile * self) {
         assert(self->pos <= fsize);
         if (self->pos > fsize)
             self->pos = fsize; /* should never happen */
-        else if (self->pos < fsize) {
+        else if (self->pos < fsize && !self->_chunked) {
             rc = KFileSetSize(self->file, self->pos);
             if (rc != 0) {
                 self->_fatal = true;
@@ -898,6 +910,8 @@ rc_t PrfOutFileInit(PrfOutFile * self, bool resume,
     self->_name = name; /* don't free ! */
     self->_vdbcache = vdbcache;
 
+    MD5StateInit(&self->_md5);
+
     rc = KDirectoryNativeDir(&self->_dir);
     if (rc != 0) {
         LOGERR(klogInt, rc, "KDirectoryNativeDir");
@@ -926,12 +940,20 @@ rc_t PrfOutFileOpen(PrfOutFile * self, bool force) {
     rc_t rc = 0;
     bool negotiated = false;
 
-    rc_t ro = TFOpen(self, force);
-    if (ro != 0)
-        TFKill(self, ro, "Cannot open TF");
+    rc_t ro = 0;
 
     assert(self && self->cache);
 
+    /* chunks after pos were downloaded in parallel: don't truncate them */
+    if (force || !self->_resume)
+        CMRm(self);
+    else
+        self->_chunked = KDirectory_Exist(self->_dir, self->cache, EXT_CHUNKS);
+
+    ro = TFOpen(self, force);
+    if (ro != 0)
+        TFKill(self, ro, "Cannot open TF");
+
     if (KDirectoryPathType(self->_dir, "%s", self->tmpName)
         == kptNotFound)
     {
@@ -983,7 +1005,7 @@ rc_t PrfOutFileOpen(PrfOutFile * self, bool force) {
         rc = KFileSize(self->file, &fsize);
         DISP_RC2(rc, "Cannot Size", self->tmpName);
         if (rc == 0) {
-            if (self->pos < fsize) {
+            if (self->pos < fsize && !self->_chunked) {
                 rc = KFileSetSize(self->file, self->pos);
                 DISP_RC2(rc, "Cannot SetSize", self->tmpName);
             }
@@ -1042,12 +1064,83 @@ rc_t PrfOutFileClose(PrfOutFile * self) {
     return rc;
 }
 
+void PrfOutFileMd5Append(PrfOutFile * self,
+    uint64_t pos, const void * buffer, size_t size)
+{
+    assert(self);
+
+    if (self->_md5Lost)
+        return;
+
+    if (pos == self->_md5Pos) {
+        MD5StateAppend(&self->_md5, buffer, size);
+        self->_md5Pos += size;
+    }
+    else if (pos < self->_md5Pos) {
+        STSMSG(STS_DBG, ("%s was rewritten at %lu: md5 is lost",
+            self->tmpName, pos));
+        self->_md5Lost = true;
+    }
+}
+
+void PrfOutFileMd5CatchUp(PrfOutFile * self, uint64_t end) {
+    rc_t rc = 0;
+    char * buffer = NULL;
+    size_t bsize = 1024 * 1024;
+
+    assert(self);
+
+    if (self->_md5Lost || self->_md5Pos >= end)
+        return;
+
+    buffer = malloc(bsize);
+    if (buffer == NULL)
+        rc = RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+
+    while (rc == 0 && self->_md5Pos < end) {
+        size_t num_read = 0;
+        size_t to_read = bsize;
+        if (to_read > end - self->_md5Pos)
+            to_read = end - self->_md5Pos;
+
+        rc = KFileRead(self->file, self->_md5Pos, buffer, to_read, &num_read);
+        if (rc == 0 && num_read == 0)
+            rc = RC(rcExe, rcFile, rcReading, rcSize, rcInsufficient);
+        if (rc == 0) {
+            MD5StateAppend(&self->_md5, buffer, num_read);
+            self->_md5Pos += num_read;
+        }
+    }
+
+    if (rc != 0) {
+        STSMSG(STS_DBG, ("cannot hash %s at %lu: %R: md5 is lost",
+            self->tmpName, self->_md5Pos, rc));
+        self->_md5Lost = true;
+    }
+
+    free(buffer);
+}
+
+bool PrfOutFileMd5Digest(PrfOutFile * self, uint8_t digest[16]) {
+    assert(self);
+
+    if (self->_md5Lost || self->_md5Pos != self->pos || self->pos == 0)
+        return false;
+
+    MD5StateFinish(&self->_md5, digest);
+    self->_md5Lost = true; /* the state is finished */
+
+    return true;
+}
+
 rc_t PrfOutFileWhack(PrfOutFile * self, bool success) {
     rc_t rc = 0;
 
 #ifndef DEBUGGINGG
-    if (success && !self->invalid)
+    if (success && !self->invalid) {
         rc = TFRm(self);
+        CMRm(self);
+    }
     else if (!success && !self->invalid)
         rc = TFRmEmpty(self);
 #endif
@@ -22,6 +22,7 @@
 * =========================================================================== */
 
 #include <kfs/file.h> /* KFile */
+#include <klib/checksum.h> /* MD5State */
 #include <klib/data-buffer.h> /* KDataBuffer */
 
 #include <limits.h> /* PATH_MAX */
@@ -35,7 +36,7 @@ typedef enum {
     eBin8,
 } EType;
 
-typedef struct {
+typedef struct PrfOutFile {
     const  char       * _name; /* don't free ! */
     bool                _vdbcache;
     const  String     *  cache;
@@ -53,8 +54,15 @@ typedef struct {
     KDataBuffer         _buf;
     uint32_t            _lastPos;
     KTime_t             _committed;
+    bool                _chunked; /* keep the chunks after pos: PrfChunks.c */
+    MD5State            _md5;     /* of [0, _md5Pos): computed while writing */
+    uint64_t            _md5Pos;
+    bool                _md5Lost; /* cannot be used: re-read file to verify */
 } PrfOutFile;
 
+/* the chunk-map of a parallel download is kept in <cache>EXT_CHUNKS */
+#define EXT_CHUNKS ".prc"
+
 rc_t PrfOutFileInit(
     PrfOutFile * self, bool resume, const char * name, bool vdbcache);
 rc_t PrfOutFileMkName(PrfOutFile * self, const String * cache);
@@ -65,4 +73,15 @@ rc_t PrfOutFileCommitDo(PrfOutFile * self);
 rc_t PrfOutFileClose(PrfOutFile * self);
 rc_t PrfOutFileWhack(PrfOutFile * self, bool success);
 
+/* MD5 of the output file is calculated while it is being written.
+   Md5Append hashes bytes written at _md5Pos, others are ignored;
+   Md5CatchUp reads and hashes [_md5Pos, end) of the file:
+   data downloaded by an earlier run or completed out of order.
+   They are not thread-safe: PrfChunks lets a single thread at a time use them. */
+void PrfOutFileMd5Append(PrfOutFile * self,
+    uint64_t pos, const void * buffer, size_t size);
+void PrfOutFileMd5CatchUp(PrfOutFile * self, uint64_t end);
+/* true if the whole file [0, pos) was hashed */
+bool PrfOutFileMd5Digest(PrfOutFile * self, uint8_t digest[16]);
+
 rc_t PrfOutFileConvert(KDirectory * dir, const char * path, bool * recognized);
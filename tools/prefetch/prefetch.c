@@ -84,6 +84,8 @@
 #include <stdio.h> /* printf */
 
 #include "kfile-no-q.h"
+#include "PrfChunks.h"
+#include "PrfJobs.h"
 #include "PrfMain.h"
 #include "PrfRetrier.h"
 #include "PrfOutFile.h"
@@ -122,6 +124,7 @@ typedef struct {
     
     bool isDependency;
     char * seq_id;
+    char * ncbiAcc; /* desc of a dependency */
 
     PrfMain *mane; /* just a pointer, no refcount here, don't release it */
 } Item;
@@ -1167,6 +1170,7 @@ static rc_t PrfMainDownloadStream(const PrfMain * self, PrfOutFile * pof,
             rc = *rwr;
 
         if (rc == 0) {
+            PrfOutFileMd5Append(pof, pof->pos, self->buffer, num_writ);
             pof->pos += num_writ;
             if (pb != NULL)
                 update_progressbar(pb, 100 * 100 * pof->pos / size);
@@ -1227,6 +1231,7 @@ static rc_t PrfMainDownloadFile(const PrfMain * self, PrfOutFile * pof,
             rc = *rwr;
 
         if (rc == 0) {
+            PrfOutFileMd5Append(pof, pof->pos, self->buffer, num_writ);
             pof->pos += num_writ;
             PrfRetrierReset(retrier, pof->pos);
             if (pb != NULL)
@@ -1246,6 +1251,7 @@ static rc_t PrfMainDownloadHttpFile(Resolved *self,
     rc_t rc = 0, rw = 0, r2 = 0, rwr = 0;
     const KFile *in = NULL;
     uint64_t size = 0;
+    bool chunked = false;
 
     progressbar * pb = NULL;
 
@@ -1318,7 +1324,27 @@ static rc_t PrfMainDownloadHttpFile(Resolved *self,
             rc = make_progressbar(&pb, 2);
     }
 
-    if (rc == 0 && !PrfOutFileIsLoaded(pof)) {
+    if (rc == 0 && !mane->dryRun && !mane->stripQuals
+        && mane->connections > 1 && Quitting() == 0)
+    {   /* the size is needed to cut the file into chunks */
+        r2 = 0;
+        if (in == NULL)
+            r2 = _KFileOpenRemote(&in, mane->kns, path,
+                &src, !self->isUri);
+        if (r2 == 0 && size == 0)
+            r2 = KFileSize(in, &size);
+        if (r2 == 0 && PrfChunksUsable(mane, size)) {
+            chunked = true;
+            rc = PrfChunksDownload(mane, pof, path, &src, self->isUri,
+                size, pb);
+        }
+    }
+
+    if (rc == 0 && !chunked && !mane->dryRun)
+        /* hash the part downloaded by an earlier run */
+        PrfOutFileMd5CatchUp(pof, pof->pos);
+
+    if (rc == 0 && !chunked && !PrfOutFileIsLoaded(pof)) {
         bool reliable = ! self -> isUri;
         ver_t http_vers = 0x01010000;
         KClientHttpRequest * kns_req = NULL;
@@ -1401,7 +1427,7 @@ static rc_t PrfMainDownloadHttpFile(Resolved *self,
         RELEASE ( KClientHttpRequest, kns_req );
     }
 
-    if (rc == 0 && (rw != 0 || PrfOutFileIsLoaded (pof))
+    if (rc == 0 && !chunked && (rw != 0 || PrfOutFileIsLoaded (pof))
        /* && pof->pos > 0 :
        sometimes KClientHttpResultGetInputStream() returns NULL
        and streaming fails: try KFile anyway */
@@ -1656,6 +1682,20 @@ static rc_t POFValidate(PrfOutFile * self,
         }
     }
 
+    if (rd == 0 && md5 != NULL && checkMd5 && !*encrypted) {
+        uint8_t digest[16];
+        if (PrfOutFileMd5Digest(self, digest)) {
+            /* calculated while downloading: don't read the file again */
+            checkMd5 = false;
+            if (memcmp(digest, md5, sizeof digest) == 0)
+                *vMd5 = eVyes;
+            else {
+                *vMd5 = eVno;
+                self->invalid = true;
+            }
+        }
+    }
+
     if (rd == 0 && md5 != NULL && checkMd5) {
         const KFile * f2 = NULL;
         rc_t r2 = 0;
@@ -2142,6 +2182,7 @@ static rc_t ItemRelease(Item *self) {
     RELEASE(KartItem, self->item);
 
     free ( self -> seq_id );
+    free(self->ncbiAcc);
 
     memset(self, 0, sizeof *self);
 
@@ -2669,7 +2710,6 @@ static rc_t ItemInitResolved(Item *self, VResolver *resolver, KDirectory *dir,
 /* resolve: locate */
 static rc_t ItemResolve(Item *item, int32_t row) {
     Resolved *self = NULL;
-    static int n = 0;
     rc_t rc = 0;
     bool ascp = false;
 
@@ -2678,14 +2718,10 @@ static rc_t ItemResolve(Item *item, int32_t row) {
     self = &item->resolved;
     assert(self->type);
 
-    ++n;
-    if (row > 0 &&
-        item->desc == NULL) /* desc is NULL for kart items */
-    {
-        n = row;
-    }
-
-    item->number = n;
+    /* a job's item is numbered before it is dispatched */
+    if (item->number == 0)
+        item->number = PrfMainNumberItem(item->mane,
+            item->desc == NULL ? row : 0); /* desc is NULL for kart items */
 
     ascp = PrfMainUseAscp(item->mane);
     if (self->type == eRunTypeList) {
@@ -2846,8 +2882,10 @@ static rc_t ItemDownload(Item *item) {
             item->mane->undersized = true;
         }
         else if (oversized) {
+            PrfMainLock(item->mane);
             logMaxSize(item->mane->maxSize);
             logBigFile(n, name, sz);
+            PrfMainUnlock(item->mane);
             skip = true;
             item->mane->oversized = true;
         }
@@ -3170,6 +3208,49 @@ rc_t ItemResolveResolvedAndDownloadOrProcess(Item *self, int32_t row)
     return rc;
 }
 
+/* --jobs: a dependency of several runs is downloaded once
+   to each location ( the same for all runs unless they have own directories ) */
+static rc_t ItemDownloadDependency(Item *self) {
+    rc_t rc = 0;
+    char key[PATH_MAX] = "";
+
+    assert(self && self->seq_id);
+
+    if (self->resolved.cache != NULL)
+        rc = string_printf(key, sizeof key, NULL, "%S", self->resolved.cache);
+    else
+        rc = string_printf(key, sizeof key, NULL, "%s", self->seq_id);
+    DISP_RC2(rc, "string_printf(dependency)", self->seq_id);
+    if (rc != 0)
+        return rc;
+
+    if (!PrfMainTakeRefseq(self->mane, key)) {
+        STSMSG(STS_INFO, ("'%s' was downloaded by another job",
+            self->seq_id));
+        return 0;
+    }
+
+    rc = ItemResolveResolvedAndDownloadOrProcess(self, 0);
+
+    PrfMainRefseqDone(self->mane, key, rc);
+
+    return rc;
+}
+
+static rc_t ItemJobDependency(PrfMain * mane, void * job) {
+    rc_t rc = 0;
+    Item * item = job;
+
+    assert(item);
+
+    item->mane = mane;
+    rc = ItemDownloadDependency(item);
+
+    RELEASE(Item, item);
+
+    return rc;
+}
+
 static rc_t ItemDownloadDependencies(Item *item) {
     Resolved *resolved = NULL;
     rc_t rc = 0;
@@ -3247,25 +3328,44 @@ static rc_t ItemDownloadDependencies(Item *item) {
             }
     
             if (rc == 0) {
+                struct PrfJobs * pool = PrfMainPool(item->mane);
                 Item *ditem = calloc(1, sizeof *ditem);
                 if (ditem == NULL)
-                    return RC(rcExe,
+                    rc = RC(rcExe,
                         rcStorage, rcAllocating, rcMemory, rcExhausted);
 
-                ditem->desc = ncbiAcc;
-                ditem->mane = item->mane;
-                ditem->isDependency = true;
-                ditem->seq_id = string_dup_measure ( seq_id, NULL );
-                if ( ditem->seq_id == NULL )
-                    return RC(rcExe,
-                        rcStorage, rcAllocating, rcMemory, rcExhausted);
+                if (rc == 0) {
+                    ditem->mane = item->mane;
+                    ditem->isDependency = true;
+                    ditem->seq_id = string_dup_measure ( seq_id, NULL );
+                    ditem->ncbiAcc = string_dup_measure(ncbiAcc, NULL);
+                    ditem->desc = ditem->ncbiAcc;
+                    if (ditem->seq_id == NULL || ditem->ncbiAcc == NULL)
+                        rc = RC(rcExe,
+                            rcStorage, rcAllocating, rcMemory, rcExhausted);
+                }
 
-                ResolvedClean(&ditem->resolved, eRunTypeDownload);
+                if (rc == 0) {
+                    ResolvedClean(&ditem->resolved, eRunTypeDownload);
 
-                rc = ItemSetDependency(ditem, deps, i);
+                    /* deps are released below: the job gets their copies */
+                    rc = ItemSetDependency(ditem, deps, i);
+                }
 
                 if (rc == 0)
-                    rc = ItemResolveResolvedAndDownloadOrProcess(ditem, 0);
+                    ditem->number = PrfMainNumberItem(item->mane, 0);
+
+                /* each dependency is a job of its own: they are downloaded
+                   in parallel with each other and with the other runs */
+                if (rc == 0) {
+                    if (pool != NULL
+                        && PrfJobsTryAdd(pool, ItemJobDependency, ditem))
+                    {
+                        ditem = NULL;
+                    }
+                    else /* the queue is full */
+                        rc = ItemDownloadDependency(ditem);
+                }
 
                 RELEASE(Item, ditem);
             }
@@ -3423,11 +3523,13 @@ static rc_t ItemPostDownload(Item *item, int32_t row) {
         assert ( path );
 
         if (!skip) {
+            PrfMainMgrLock(item->mane);
             rc = _VDBManagerSetDbGapCtx(item->mane->mgr, resolved->resolver);
             STSMSG(STS_INFO,
                 ("checking PathType of '%S'...", resolved->path.str));
             type = VDBManagerPathTypeUnreliable
                 ( item->mane->mgr, "%S", resolved->path.str) & ~kptAlias;
+            PrfMainMgrUnlock(item->mane);
         }
 
         switch (type) {
@@ -3666,17 +3768,52 @@ static int64_t CC bstKrtSort(const BSTNode *item, const BSTNode *n) {
     return 0;
 }
 
+/*********** --jobs: items processed by PrfJobs **********/
+static rc_t ItemJobProcess(PrfMain * mane, void * job) {
+    rc_t rc = 0;
+    Item * item = job;
+
+    assert(item);
+
+    item->mane = mane;
+    rc = ItemProcess(item, item->number);
+
+    RELEASE(Item, item);
+
+    return rc;
+}
+
+/* the sizes were checked: download, the item belongs to the tree */
+static rc_t ItemJobDownload(PrfMain * mane, void * job) {
+    rc_t rc = 0;
+    Item * item = job;
+
+    assert(item);
+
+    item->mane = mane;
+    rc = ItemDownload(item);
+
+    if (rc == 0)
+        rc = ItemPostDownload(item, item->number);
+
+    return rc;
+}
+
 static void CC bstKrtDownload(BSTNode *n, void *data) {
     rc_t rc = 0;
     rc_t * aRc = data;
 
     const KartTreeNode *sn = (const KartTreeNode*) n;
-    assert(sn && sn->i && aRc);
+    assert(sn && sn->i && sn->i->mane && aRc);
 
-    rc = ItemDownload(sn->i);
+    if (sn->i->mane->pool != NULL)
+        rc = PrfJobsAdd(sn->i->mane->pool, ItemJobDownload, sn->i);
+    else {
+        rc = ItemDownload(sn->i);
 
-    if (rc == 0)
-        rc = ItemPostDownload(sn->i, sn->i->number);
+        if (rc == 0)
+            rc = ItemPostDownload(sn->i, sn->i->number);
+    }
 
     if (rc != 0 && *aRc == 0)
         *aRc = rc;
@@ -3814,7 +3951,21 @@ static rc_t PrfMainRun ( PrfMain * self, const char * arg, const char * realArg,
 #ifdef DBGNG
                 STSMSG(STS_FIN, ("%s: processing item %d...", __func__, n));
 #endif
-                if (!nit.skip) {
+                if (!nit.skip && self->pool != NULL
+                    && type == eRunTypeDownload)
+                {   /* the job reports it and releases the item */
+                    item->mane = self;
+                    ResolvedClean(&item->resolved, type);
+                    /* numbered here: the jobs finish in any order */
+                    item->number = PrfMainNumberItem(self,
+                        item->desc == NULL ? (int32_t)n : 0);
+                    rc3 = PrfJobsAdd(self->pool, ItemJobProcess, item);
+                    if (rc3 == 0)
+                        item = NULL;
+                    else if (rc == 0)
+                        rc = rc3;
+                }
+                else if (!nit.skip) {
                     item->mane = self;
                     ResolvedClean(&item->resolved, type);
 
@@ -3882,6 +4033,13 @@ static rc_t PrfMainRun ( PrfMain * self, const char * arg, const char * realArg,
             STSMSG(STS_FIN, ("%s: ...finished items loop", __func__));
 #endif
 
+            /* the kart is released below: finish its items */
+            if (self->pool != NULL && it.kart != NULL) {
+                rc_t r2 = PrfJobsWait(self->pool);
+                if (rc == 0 && r2 != 0)
+                    rc = r2;
+            }
+
             if ( rc == 0 ) {
                 if (type == eRunTypeList) {
                     if (it.kart != NULL && total > 0) {
@@ -3893,6 +4051,11 @@ static rc_t PrfMainRun ( PrfMain * self, const char * arg, const char * realArg,
                     rc_t r2 = 0;
                     OUTMSG (("\nDownloading the files...\n\n", realArg));
                     BSTreeForEach (&trKrt, false, bstKrtDownload, &r2);
+                    if (self->pool != NULL) {
+                        rc_t r3 = PrfJobsWait(self->pool);
+                        if (r2 == 0 && r3 != 0)
+                            r2 = r3;
+                    }
                     if (rc == 0 && r2 != 0)
                         rc = r2;
                 }
@@ -4017,6 +4180,12 @@ rc_t CC KMain(int argc, char *argv[]) {
         STSMSG(STS_FIN, ("%s: ...finished download loop", __func__));
 #endif
 
+        if (pars.pool != NULL) {
+            rc_t rc2 = PrfJobsWait(pars.pool);
+            if (rc2 != 0 && rc == 0)
+                rc = rc2;
+        }
+
         if (pars.undersized || pars.oversized) {
             OUTMSG(("\n"));
             if (pars.undersized) {
@@ -0,0 +1,1369 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "bam_out.h"
+#include "../../shared/bgzf_pool.h"
+
+#include <klib/log.h>
+#include <klib/out.h>
+#include <klib/text.h>
+#include <klib/container.h>
+#include <kfs/directory.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/* binning-scheme of BAI, CSI uses the same min-shift but may need more levels */
+#define BAM_MIN_SHIFT 14
+#define BAI_DEPTH 5
+#define BAI_MAX_REF_LEN ( ( int64_t )1 << 29 )
+
+/* bins of a binning-scheme with the given depth, the pseudo-bin for the statistics is the one after the next */
+#define BIN_COUNT( depth ) ( ( ( 1 << ( 3 * ( ( depth ) + 1 ) ) ) - 1 ) / 7 )
+
+/* a record from bam_rec_write() travels through the KOut-handler as a frame:
+   BAM_FRAME_MARK, the length of the rest ( uint32 ), the BAM-record, RNAME and RNEXT terminated by 0.
+   No line of SAM-text starts with the mark. */
+#define BAM_FRAME_MARK 0
+#define BAM_FRAME_HDR 5
+#define BAM_CORE_SIZE 36
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+static rc_t bam_buf_reserve( bam_buf * self, size_t extra )
+{
+    if ( self->used + extra > self->cap )
+    {
+        size_t cap = ( self->cap == 0 ) ? 4096 : self->cap;
+        uint8_t * tmp;
+        while ( cap < self->used + extra )
+            cap *= 2;
+        tmp = realloc( self->p, cap );
+        if ( tmp == NULL )
+            return RC( rcExe, rcBuffer, rcResizing, rcMemory, rcExhausted );
+        self->p = tmp;
+        self->cap = cap;
+    }
+    return 0;
+}
+
+
+static rc_t bam_buf_add( bam_buf * self, const void * src, size_t size )
+{
+    rc_t rc = bam_buf_reserve( self, size );
+    if ( rc == 0 )
+    {
+        memmove( self->p + self->used, src, size );
+        self->used += size;
+    }
+    return rc;
+}
+
+/* the caller has reserved the space */
+static void put_u16( bam_buf * self, uint16_t value )
+{
+    uint8_t * dst = self->p + self->used;
+    dst[ 0 ] = value & 0xFF;
+    dst[ 1 ] = ( value >> 8 ) & 0xFF;
+    self->used += 2;
+}
+
+static void put_u32( bam_buf * self, uint32_t value )
+{
+    uint8_t * dst = self->p + self->used;
+    dst[ 0 ] = value & 0xFF;
+    dst[ 1 ] = ( value >> 8 ) & 0xFF;
+    dst[ 2 ] = ( value >> 16 ) & 0xFF;
+    dst[ 3 ] = ( value >> 24 ) & 0xFF;
+    self->used += 4;
+}
+
+static void put_u64( bam_buf * self, uint64_t value )
+{
+    put_u32( self, ( uint32_t )value );
+    put_u32( self, ( uint32_t )( value >> 32 ) );
+}
+
+static void set_u32( bam_buf * self, size_t at, uint32_t value )
+{
+    size_t used = self->used;
+    self->used = at;
+    put_u32( self, value );
+    self->used = used;
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+typedef struct bam_ref
+{
+    BSTNode node;
+    String name;
+    int32_t id;
+    uint32_t len;
+} bam_ref;
+
+
+static int64_t CC bam_ref_cmp( const void * item, const BSTNode * n )
+{
+    const String * name = item;
+    const bam_ref * ref = ( const bam_ref * )n;
+    return StringCompare( name, &ref->name );
+}
+
+
+static int64_t CC bam_ref_sort( const BSTNode * item, const BSTNode * n )
+{
+    return bam_ref_cmp( &( ( const bam_ref * )item )->name, n );
+}
+
+
+static void CC bam_ref_whack( BSTNode * n, void * data )
+{
+    free( n );
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+typedef struct idx_bin
+{
+    uint32_t bin;
+    uint32_t n_chunks;
+    uint32_t cap;
+    uint64_t * chunks;      /* pairs of unresolved vpos: beg, end */
+} idx_bin;
+
+
+typedef struct idx_ref
+{
+    idx_bin * bins;
+    uint32_t n_bins;
+    uint32_t cap_bins;
+
+    uint64_t * intv;        /* linear index: unresolved vpos, 0 = no alignment in window */
+    uint32_t n_intv;
+    uint32_t cap_intv;
+
+    uint64_t beg, end;      /* vpos of first record and behind last record */
+    uint64_t mapped;
+    uint64_t unmapped;
+} idx_ref;
+
+
+typedef struct bam_index
+{
+    enum bam_out_index type;
+    const char * path;
+    int depth;
+
+    idx_ref * refs;
+    uint32_t * bin_slot;    /* bin-number -> index + 1 into bins of the current reference */
+    int32_t cur_ref;
+    int64_t last_pos;
+    uint64_t no_coor;
+    bool ok;
+} bam_index;
+
+
+typedef struct bam_out
+{
+    struct bgzf_pool * pool;
+
+    bam_buf line;           /* collects the current line */
+    bam_buf hdr_text;       /* collects the @-lines */
+
+    BSTree ref_tree;        /* reference-name -> bam_ref */
+    bam_ref ** refs;        /* by id */
+    uint32_t ref_count;
+    uint32_t ref_cap;
+    const bam_ref * last_ref;
+
+    bam_index idx;
+
+    uint64_t records;
+    bool header_written;
+} bam_out;
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+static int64_t reg2bin( int64_t beg, int64_t end, int min_shift, int depth )
+{
+    int l, s = min_shift, t = BIN_COUNT( depth - 1 );
+    for ( --end, l = depth; l > 0; --l, s += 3, t -= 1 << ( 3 * l ) )
+    {
+        if ( beg >> s == end >> s )
+            return t + ( beg >> s );
+    }
+    return 0;
+}
+
+
+/* first position covered by bin */
+static int64_t bin_beg( uint32_t bin, int min_shift, int depth )
+{
+    int l = 0;
+    uint32_t t = 0;
+    while ( l < depth && bin >= t + ( 1u << ( 3 * l ) ) )
+    {
+        t += 1u << ( 3 * l );
+        ++l;
+    }
+    return ( int64_t )( bin - t ) << ( min_shift + 3 * ( depth - l ) );
+}
+
+
+static rc_t index_init( bam_index * self, uint32_t ref_count, int64_t max_len )
+{
+    rc_t rc = 0;
+
+    self->depth = BAI_DEPTH;
+    if ( self->type == boi_bai && max_len > BAI_MAX_REF_LEN )
+    {
+        (void)LOGMSG( klogWarn, "reference too long for a BAI-index, writing a CSI-index instead" );
+        self->type = boi_csi;
+    }
+    while ( ( ( int64_t )1 << ( BAM_MIN_SHIFT + 3 * self->depth ) ) < max_len )
+        self->depth++;
+
+    self->refs = calloc( ref_count + 1, sizeof self->refs[ 0 ] );
+    self->bin_slot = calloc( BIN_COUNT( self->depth ), sizeof self->bin_slot[ 0 ] );
+    if ( self->refs == NULL || self->bin_slot == NULL )
+    {
+        rc = RC( rcExe, rcIndex, rcConstructing, rcMemory, rcExhausted );
+        LOGERR( klogErr, rc, "cannot allocate bam-index" );
+    }
+    self->cur_ref = 0;
+    self->last_pos = -1;
+    self->ok = true;
+    return rc;
+}
+
+
+static void index_whack( bam_index * self, uint32_t ref_count )
+{
+    if ( self->refs != NULL )
+    {
+        uint32_t r, b;
+        for ( r = 0; r < ref_count; ++r )
+        {
+            idx_ref * ref = &self->refs[ r ];
+            for ( b = 0; b < ref->n_bins; ++b )
+                free( ref->bins[ b ].chunks );
+            free( ref->bins );
+            free( ref->intv );
+        }
+        free( self->refs );
+        self->refs = NULL;
+    }
+    free( self->bin_slot );
+    self->bin_slot = NULL;
+}
+
+
+static rc_t index_add_chunk( idx_ref * ref, uint32_t * bin_slot, uint32_t bin_nr, uint64_t vbeg, uint64_t vend )
+{
+    idx_bin * bin;
+    if ( bin_slot[ bin_nr ] == 0 )
+    {
+        if ( ref->n_bins == ref->cap_bins )
+        {
+            uint32_t cap = ( ref->cap_bins == 0 ) ? 64 : ref->cap_bins * 2;
+            idx_bin * tmp = realloc( ref->bins, cap * sizeof tmp[ 0 ] );
+            if ( tmp == NULL )
+                return RC( rcExe, rcIndex, rcInserting, rcMemory, rcExhausted );
+            ref->bins = tmp;
+            ref->cap_bins = cap;
+        }
+        bin = &ref->bins[ ref->n_bins++ ];
+        memset( bin, 0, sizeof *bin );
+        bin->bin = bin_nr;
+        bin_slot[ bin_nr ] = ref->n_bins;
+    }
+    else
+        bin = &ref->bins[ bin_slot[ bin_nr ] - 1 ];
+
+    /* a chunk ending in the block where the new one starts is extended */
+    if ( bin->n_chunks > 0 && ( bin->chunks[ 2 * bin->n_chunks - 1 ] >> 16 ) == ( vbeg >> 16 ) )
+        bin->chunks[ 2 * bin->n_chunks - 1 ] = vend;
+    else
+    {
+        if ( bin->n_chunks == bin->cap )
+        {
+            uint32_t cap = ( bin->cap == 0 ) ? 4 : bin->cap * 2;
+            uint64_t * tmp = realloc( bin->chunks, 2 * cap * sizeof tmp[ 0 ] );
+            if ( tmp == NULL )
+                return RC( rcExe, rcIndex, rcInserting, rcMemory, rcExhausted );
+            bin->chunks = tmp;
+            bin->cap = cap;
+        }
+        bin->chunks[ 2 * bin->n_chunks ] = vbeg;
+        bin->chunks[ 2 * bin->n_chunks + 1 ] = vend;
+        bin->n_chunks++;
+    }
+    return 0;
+}
+
+
+static rc_t index_add_intv( idx_ref * ref, int64_t beg, int64_t end, uint64_t vbeg )
+{
+    uint32_t w, w_beg = ( uint32_t )( beg >> BAM_MIN_SHIFT ), w_end = ( uint32_t )( ( end - 1 ) >> BAM_MIN_SHIFT );
+    if ( w_end >= ref->cap_intv )
+    {
+        uint32_t cap = ( ref->cap_intv == 0 ) ? 1024 : ref->cap_intv;
+        uint64_t * tmp;
+        while ( cap <= w_end )
+            cap *= 2;
+        tmp = realloc( ref->intv, cap * sizeof tmp[ 0 ] );
+        if ( tmp == NULL )
+            return RC( rcExe, rcIndex, rcInserting, rcMemory, rcExhausted );
+        memset( tmp + ref->cap_intv, 0, ( cap - ref->cap_intv ) * sizeof tmp[ 0 ] );
+        ref->intv = tmp;
+        ref->cap_intv = cap;
+    }
+    for ( w = w_beg; w <= w_end; ++w )
+    {
+        if ( ref->intv[ w ] == 0 )
+            ref->intv[ w ] = vbeg;
+    }
+    if ( w_end >= ref->n_intv )
+        ref->n_intv = w_end + 1;
+    return 0;
+}
+
+
+static rc_t index_add( bam_index * self, int32_t ref_id, int64_t pos, int64_t end,
+                       bool unmapped, uint64_t vbeg, uint64_t vend )
+{
+    rc_t rc = 0;
+    idx_ref * ref;
+
+    /* unplaced records ( ref_id = -1 ) have to come last */
+    if ( ( uint32_t )ref_id < ( uint32_t )self->cur_ref ||
+         ( ref_id == self->cur_ref && pos < self->last_pos ) )
+    {
+        (void)LOGMSG( klogWarn, "output is not sorted by position, no bam-index will be written" );
+        self->ok = false;
+        return 0;
+    }
+    if ( ref_id != self->cur_ref )
+    {
+        if ( self->cur_ref >= 0 )
+        {
+            /* forget the bins of the previous reference */
+            const idx_ref * prev = &self->refs[ self->cur_ref ];
+            uint32_t b;
+            for ( b = 0; b < prev->n_bins; ++b )
+                self->bin_slot[ prev->bins[ b ].bin ] = 0;
+        }
+        self->cur_ref = ref_id;
+    }
+    self->last_pos = pos;
+
+    if ( ref_id < 0 || pos < 0 )
+    {
+        self->no_coor++;
+        return 0;
+    }
+
+    ref = &self->refs[ ref_id ];
+    rc = index_add_chunk( ref, self->bin_slot, ( uint32_t )reg2bin( pos, end, BAM_MIN_SHIFT, self->depth ), vbeg, vend );
+    if ( rc == 0 )
+        rc = index_add_intv( ref, pos, end, vbeg );
+    if ( rc == 0 )
+    {
+        if ( ref->mapped + ref->unmapped == 0 )
+            ref->beg = vbeg;
+        ref->end = vend;
+        if ( unmapped )
+            ref->unmapped++;
+        else
+            ref->mapped++;
+    }
+    return rc;
+}
+
+
+static rc_t index_serialize( const bam_index * self, uint32_t ref_count,
+                             const struct bgzf_pool * pool, bam_buf * dst )
+{
+    bool csi = ( self->type == boi_csi );
+    uint32_t r, b, c, pseudo_bin = BIN_COUNT( self->depth ) + 1;
+    rc_t rc = bam_buf_reserve( dst, 16 );
+    if ( rc == 0 )
+    {
+        bam_buf_add( dst, csi ? "CSI\1" : "BAI\1", 4 );
+        if ( csi )
+        {
+            put_u32( dst, BAM_MIN_SHIFT );
+            put_u32( dst, self->depth );
+            put_u32( dst, 0 );  /* l_aux */
+        }
+        put_u32( dst, ref_count );
+    }
+    for ( r = 0; rc == 0 && r < ref_count; ++r )
+    {
+        idx_ref * ref = &self->refs[ r ];
+        bool has_data = ( ref->mapped + ref->unmapped > 0 );
+        size_t need = 8 + ( size_t )ref->n_intv * 8 + 48;
+
+        for ( b = 0; b < ref->n_bins; ++b )
+            need += 16 + ( size_t )ref->bins[ b ].n_chunks * 16;
+        rc = bam_buf_reserve( dst, need );
+        if ( rc != 0 )
+            break;
+
+        /* fill the gaps in the linear index with the previous offset */
+        for ( c = 1; c < ref->n_intv; ++c )
+        {
+            if ( ref->intv[ c ] == 0 )
+                ref->intv[ c ] = ref->intv[ c - 1 ];
+        }
+
+        put_u32( dst, ref->n_bins + ( has_data ? 1 : 0 ) );
+        for ( b = 0; b < ref->n_bins; ++b )
+        {
+            const idx_bin * bin = &ref->bins[ b ];
+            put_u32( dst, bin->bin );
+            if ( csi )
+            {
+                /* the smallest offset of records overlapping the beginning of the bin */
+                uint64_t loff = bin->chunks[ 0 ];
+                uint64_t w = ( uint64_t )bin_beg( bin->bin, BAM_MIN_SHIFT, self->depth ) >> BAM_MIN_SHIFT;
+                if ( w < ref->n_intv && ref->intv[ w ] != 0 && ref->intv[ w ] < loff )
+                    loff = ref->intv[ w ];
+                put_u64( dst, bgzf_pool_resolve( pool, loff ) );
+            }
+            put_u32( dst, bin->n_chunks );
+            for ( c = 0; c < 2 * bin->n_chunks; ++c )
+                put_u64( dst, bgzf_pool_resolve( pool, bin->chunks[ c ] ) );
+        }
+        if ( has_data )
+        {
+            put_u32( dst, pseudo_bin );
+            if ( csi )
+                put_u64( dst, 0 );
+            put_u32( dst, 2 );
+            put_u64( dst, bgzf_pool_resolve( pool, ref->beg ) );
+            put_u64( dst, bgzf_pool_resolve( pool, ref->end ) );
+            put_u64( dst, ref->mapped );
+            put_u64( dst, ref->unmapped );
+        }
+        if ( !csi )
+        {
+            put_u32( dst, ref->n_intv );
+            for ( c = 0; c < ref->n_intv; ++c )
+                put_u64( dst, ( ref->intv[ c ] == 0 ) ? 0 : bgzf_pool_resolve( pool, ref->intv[ c ] ) );
+        }
+    }
+    if ( rc == 0 )
+        rc = bam_buf_reserve( dst, 8 );
+    if ( rc == 0 )
+        put_u64( dst, self->no_coor );
+    return rc;
+}
+
+
+static rc_t index_write( const bam_index * self, uint32_t ref_count, const struct bgzf_pool * pool )
+{
+    bam_buf data;
+    rc_t rc;
+
+    memset( &data, 0, sizeof data );
+    rc = index_serialize( self, ref_count, pool, &data );
+    if ( rc == 0 )
+    {
+        KDirectory * dir;
+        rc = KDirectoryNativeDir( &dir );
+        if ( rc == 0 )
+        {
+            KFile * f;
+            rc = KDirectoryCreateFile( dir, &f, false, 0664, kcmInit, "%s", self->path );
+            if ( rc == 0 )
+            {
+                if ( self->type == boi_csi )
+                {
+                    /* a CSI-index is BGZF-compressed */
+                    struct bgzf_pool * idx_pool;
+                    rc = make_bgzf_pool( &idx_pool, f, 0, 0, Z_DEFAULT_COMPRESSION, false );
+                    if ( rc == 0 )
+                    {
+                        rc = bgzf_pool_write( idx_pool, data.p, data.used );
+                        if ( rc == 0 )
+                            rc = bgzf_pool_finish( idx_pool );
+                        release_bgzf_pool( idx_pool );
+                    }
+                }
+                else
+                {
+                    size_t num_writ;
+                    rc = KFileWriteAll( f, 0, data.p, data.used, &num_writ );
+                }
+                KFileRelease( f );
+            }
+            KDirectoryRelease( dir );
+        }
+        if ( rc != 0 )
+            (void)PLOGERR( klogErr, ( klogErr, rc, "cannot write bam-index '$(path)'", "path=%s", self->path ) );
+    }
+    free( data.p );
+    return rc;
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+rc_t make_bam_out( struct bam_out ** self, KFile * f, uint32_t threads,
+                   enum bam_out_index index_type, const char * index_path )
+{
+    rc_t rc = 0;
+    bam_out * o = calloc( 1, sizeof *o );
+    *self = NULL;
+    if ( o == NULL )
+        rc = RC( rcExe, rcFile, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        BSTreeInit( &o->ref_tree );
+        if ( index_type != boi_none && index_path != NULL )
+        {
+            o->idx.type = index_type;
+            o->idx.path = string_dup_measure( index_path, NULL );
+            if ( o->idx.path == NULL )
+                rc = RC( rcExe, rcFile, rcConstructing, rcMemory, rcExhausted );
+        }
+        if ( rc == 0 )
+            rc = make_bgzf_pool( &o->pool, f, 0, threads, Z_DEFAULT_COMPRESSION,
+                                 o->idx.type != boi_none ); /* bgzf_pool.c */
+        if ( rc == 0 )
+            *self = o;
+        else
+            release_bam_out( o );
+    }
+    return rc;
+}
+
+
+void release_bam_out( struct bam_out * self )
+{
+    if ( self != NULL )
+    {
+        index_whack( &self->idx, self->ref_count );
+        free( ( void * )self->idx.path );
+        release_bgzf_pool( self->pool ); /* bgzf_pool.c */
+        BSTreeWhack( &self->ref_tree, bam_ref_whack, NULL );
+        free( self->refs );
+        free( self->line.p );
+        free( self->hdr_text.p );
+        free( self );
+    }
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+static bool parse_i64( const char * s, int64_t * value )
+{
+    bool neg = false;
+    int64_t v = 0;
+    if ( *s == '-' )
+    {
+        neg = true;
+        s++;
+    }
+    else if ( *s == '+' )
+        s++;
+    if ( *s < '0' || *s > '9' )
+        return false;
+    while ( *s >= '0' && *s <= '9' )
+        v = v * 10 + ( *s++ - '0' );
+    *value = neg ? -v : v;
+    return ( *s == 0 );
+}
+
+
+static rc_t bad_line( const char * what, const char * line )
+{
+    rc_t rc = RC( rcExe, rcFile, rcParsing, rcData, rcInvalid );
+    (void)PLOGERR( klogErr, ( klogErr, rc, "cannot encode $(what) of SAM-line '$(line)' as BAM",
+                              "what=%s,line=%s", what, line ) );
+    return rc;
+}
+
+
+static rc_t add_reference( bam_out * self, const char * name, size_t name_len, uint32_t len )
+{
+    rc_t rc = 0;
+    bam_ref * ref = malloc( sizeof *ref + name_len + 1 );
+    if ( ref == NULL )
+        return RC( rcExe, rcFile, rcInserting, rcMemory, rcExhausted );
+
+    memmove( ( char * )( ref + 1 ), name, name_len );
+    ( ( char * )( ref + 1 ) )[ name_len ] = 0;
+    StringInit( &ref->name, ( const char * )( ref + 1 ), name_len, ( uint32_t )name_len );
+    ref->id = self->ref_count;
+    ref->len = len;
+
+    if ( self->ref_count == self->ref_cap )
+    {
+        uint32_t cap = ( self->ref_cap == 0 ) ? 64 : self->ref_cap * 2;
+        bam_ref ** tmp = realloc( self->refs, cap * sizeof tmp[ 0 ] );
+        if ( tmp == NULL )
+            rc = RC( rcExe, rcFile, rcInserting, rcMemory, rcExhausted );
+        else
+        {
+            self->refs = tmp;
+            self->ref_cap = cap;
+        }
+    }
+    if ( rc == 0 )
+    {
+        rc = BSTreeInsertUnique( &self->ref_tree, &ref->node, NULL, bam_ref_sort );
+        if ( rc != 0 )
+            (void)PLOGERR( klogErr, ( klogErr, rc, "duplicate reference '$(name)' in header",
+                                      "name=%S", &ref->name ) );
+    }
+    if ( rc == 0 )
+        self->refs[ self->ref_count++ ] = ref;
+    else
+        free( ref );
+    return rc;
+}
+
+
+/* @SQ-lines contribute to the reference-dictionary, the line is terminated by 0 */
+static rc_t parse_sq_line( bam_out * self, char * line )
+{
+    const char * name = NULL;
+    size_t name_len = 0;
+    int64_t len = -1;
+    char * field = line;
+
+    while ( field != NULL )
+    {
+        char * tab = strchr( field, '\t' );
+        size_t field_len = ( tab != NULL ) ? ( size_t )( tab - field ) : strlen( field );
+        if ( field_len > 3 && field[ 0 ] == 'S' && field[ 1 ] == 'N' && field[ 2 ] == ':' )
+        {
+            name = field + 3;
+            name_len = field_len - 3;
+        }
+        else if ( field_len > 3 && field[ 0 ] == 'L' && field[ 1 ] == 'N' && field[ 2 ] == ':' )
+        {
+            char save = field[ field_len ];
+            field[ field_len ] = 0;
+            if ( !parse_i64( field + 3, &len ) )
+                len = -1;
+            field[ field_len ] = save;
+        }
+        field = ( tab != NULL ) ? tab + 1 : NULL;
+    }
+    if ( name == NULL || len < 0 || len > INT32_MAX )
+        return bad_line( "@SQ-line", line );
+    return add_reference( self, name, name_len, ( uint32_t )len );
+}
+
+
+static rc_t write_header( bam_out * self )
+{
+    bam_buf hdr;
+    uint32_t i;
+    int64_t max_len = 0;
+    rc_t rc;
+
+    memset( &hdr, 0, sizeof hdr );
+    rc = bam_buf_reserve( &hdr, 12 + self->hdr_text.used );
+    if ( rc == 0 )
+    {
+        bam_buf_add( &hdr, "BAM\1", 4 );
+        put_u32( &hdr, ( uint32_t )self->hdr_text.used );
+        bam_buf_add( &hdr, self->hdr_text.p, self->hdr_text.used );
+        put_u32( &hdr, self->ref_count );
+    }
+    for ( i = 0; rc == 0 && i < self->ref_count; ++i )
+    {
+        const bam_ref * ref = self->refs[ i ];
+        rc = bam_buf_reserve( &hdr, 8 + ref->name.size + 1 );
+        if ( rc == 0 )
+        {
+            put_u32( &hdr, ref->name.size + 1 );
+            bam_buf_add( &hdr, ref->name.addr, ref->name.size + 1 );
+            put_u32( &hdr, ref->len );
+        }
+        if ( ref->len > max_len )
+            max_len = ref->len;
+    }
+
+    /* the records start in a new block, the first offset in the index is a clean one */
+    if ( rc == 0 )
+        rc = bgzf_pool_write( self->pool, hdr.p, hdr.used ); /* bgzf_pool.c */
+    if ( rc == 0 )
+        rc = bgzf_pool_flush( self->pool ); /* bgzf_pool.c */
+    free( hdr.p );
+
+    if ( rc == 0 && self->idx.type != boi_none )
+        rc = index_init( &self->idx, self->ref_count, max_len );
+    self->header_written = true;
+    return rc;
+}
+
+
+static rc_t find_ref( bam_out * self, const char * name, size_t len, int32_t * id )
+{
+    if ( len == 1 && name[ 0 ] == '*' )
+        *id = -1;
+    else if ( self->last_ref != NULL && self->last_ref->name.size == len &&
+              memcmp( self->last_ref->name.addr, name, len ) == 0 )
+        *id = self->last_ref->id;
+    else
+    {
+        String s;
+        const bam_ref * ref;
+        StringInit( &s, name, len, ( uint32_t )len );
+        ref = ( const bam_ref * )BSTreeFind( &self->ref_tree, &s, bam_ref_cmp );
+        if ( ref == NULL )
+        {
+            rc_t rc = RC( rcExe, rcFile, rcParsing, rcId, rcNotFound );
+            (void)PLOGERR( klogErr, ( klogErr, rc, "reference '$(name)' is not in the header",
+                                      "name=%S", &s ) );
+            return rc;
+        }
+        self->last_ref = ref;
+        *id = ref->id;
+    }
+    return 0;
+}
+
+
+static const char cigar_ops[] = "MIDNSHP=X";
+
+/* 4-bit code of a base, lower-case letters included; the complement of a code */
+static const uint8_t nt16_comp[ 16 ] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+
+static uint8_t nt16( char c )
+{
+    switch ( c )
+    {
+        case '=' : return 0;
+        case 'A' : case 'a' : return 1;
+        case 'C' : case 'c' : return 2;
+        case 'M' : case 'm' : return 3;
+        case 'G' : case 'g' : return 4;
+        case 'R' : case 'r' : return 5;
+        case 'S' : case 's' : return 6;
+        case 'V' : case 'v' : return 7;
+        case 'T' : case 't' : return 8;
+        case 'W' : case 'w' : return 9;
+        case 'Y' : case 'y' : return 10;
+        case 'H' : case 'h' : return 11;
+        case 'K' : case 'k' : return 12;
+        case 'D' : case 'd' : return 13;
+        case 'B' : case 'b' : return 14;
+    }
+    return 15;
+}
+
+
+static char int_type( int64_t v )
+{
+    if ( v < 0 )
+        return ( v >= INT8_MIN ) ? 'c' : ( v >= INT16_MIN ) ? 's' : 'i';
+    return ( v <= UINT8_MAX ) ? 'C' : ( v <= UINT16_MAX ) ? 'S' : 'I';
+}
+
+
+/* the caller has reserved the space */
+static void put_int( bam_buf * dst, char type, int64_t v )
+{
+    switch ( type )
+    {
+        case 'c' : case 'C' : dst->p[ dst->used++ ] = ( uint8_t )v; break;
+        case 's' : case 'S' : put_u16( dst, ( uint16_t )v ); break;
+        default  : put_u32( dst, ( uint32_t )v ); break;
+    }
+}
+
+
+static void put_typed( bam_buf * dst, char type, const char * value )
+{
+    if ( type == 'f' )
+    {
+        float f = strtof( value, NULL );
+        uint32_t u;
+        memmove( &u, &f, 4 );
+        put_u32( dst, u );
+    }
+    else
+        put_int( dst, type, strtoll( value, NULL, 10 ) );
+}
+
+
+/* one optional field TAG:TYPE:VALUE in SAM-notation, terminated by 0 */
+static rc_t encode_tag( bam_buf * dst, const char * tag )
+{
+    size_t len = strlen( tag );
+    rc_t rc;
+
+    if ( len < 5 || tag[ 2 ] != ':' || tag[ 4 ] != ':' )
+        return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+    rc = bam_buf_reserve( dst, len + 8 );
+    if ( rc != 0 )
+        return rc;
+
+    bam_buf_add( dst, tag, 2 );
+    switch ( tag[ 3 ] )
+    {
+        case 'A' : bam_buf_add( dst, "A", 1 );
+                   bam_buf_add( dst, tag + 5, 1 );
+                   break;
+
+        case 'i' : {
+                        int64_t v;
+                        char t;
+                        if ( !parse_i64( tag + 5, &v ) )
+                            return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+                        t = int_type( v );
+                        bam_buf_add( dst, &t, 1 );
+                        put_int( dst, t, v );
+                   }
+                   break;
+
+        case 'f' : bam_buf_add( dst, "f", 1 );
+                   put_typed( dst, 'f', tag + 5 );
+                   break;
+
+        case 'Z' :
+        case 'H' : bam_buf_add( dst, tag + 3, 1 );
+                   bam_buf_add( dst, tag + 5, len - 5 + 1 );
+                   break;
+
+        case 'B' : {
+                        /* B:t,v1,v2,... */
+                        char sub = tag[ 5 ];
+                        size_t width = ( sub == 'c' || sub == 'C' ) ? 1 : ( sub == 's' || sub == 'S' ) ? 2 : 4;
+                        size_t count_at;
+                        uint32_t count = 0;
+                        const char * v = tag + 6;
+                        if ( strchr( "cCsSiIf", sub ) == NULL || sub == 0 )
+                            return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+                        bam_buf_add( dst, "B", 1 );
+                        bam_buf_add( dst, &sub, 1 );
+                        count_at = dst->used;
+                        put_u32( dst, 0 );
+                        while ( rc == 0 && *v == ',' )
+                        {
+                            rc = bam_buf_reserve( dst, width );
+                            if ( rc == 0 )
+                            {
+                                put_typed( dst, sub, ++v );
+                                count++;
+                                while ( *v != ',' && *v != 0 )
+                                    v++;
+                            }
+                        }
+                        set_u32( dst, count_at, count );
+                   }
+                   break;
+
+        default  : rc = RC( rcExe, rcFile, rcWriting, rcData, rcInvalid ); break;
+    }
+    return rc;
+}
+
+
+static uint32_t get_u32( const uint8_t * src )
+{
+    return ( uint32_t )src[ 0 ] | ( ( uint32_t )src[ 1 ] << 8 ) |
+           ( ( uint32_t )src[ 2 ] << 16 ) | ( ( uint32_t )src[ 3 ] << 24 );
+}
+
+
+static void put_u32_at( uint8_t * dst, uint32_t value )
+{
+    dst[ 0 ] = value & 0xFF;
+    dst[ 1 ] = ( value >> 8 ) & 0xFF;
+    dst[ 2 ] = ( value >> 16 ) & 0xFF;
+    dst[ 3 ] = ( value >> 24 ) & 0xFF;
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+void init_bam_rec( bam_rec * self )
+{
+    memset( self, 0, sizeof *self );
+}
+
+
+void release_bam_rec( bam_rec * self )
+{
+    free( self->buf.p );
+    free( self->scratch.p );
+    init_bam_rec( self );
+}
+
+
+rc_t bam_rec_start( bam_rec * self, const char * qname, size_t len )
+{
+    rc_t rc;
+    if ( len == 0 )
+    {
+        qname = "*";
+        len = 1;
+    }
+    if ( len > 254 )
+        return RC( rcExe, rcFile, rcWriting, rcName, rcExcessive );
+
+    self->buf.used = 0;
+    self->n_cigar = 0;
+    self->l_seq = 0;
+    self->ref_span = 0;
+    rc = bam_buf_reserve( &self->buf, BAM_FRAME_HDR + BAM_CORE_SIZE + len + 1 );
+    if ( rc == 0 )
+    {
+        /* frame-header and the fixed fields are filled in by bam_rec_write() */
+        self->buf.used = BAM_FRAME_HDR + BAM_CORE_SIZE;
+        bam_buf_add( &self->buf, qname, len );
+        self->buf.p[ self->buf.used++ ] = 0;
+    }
+    return rc;
+}
+
+
+rc_t bam_rec_cigar( bam_rec * self, const char * cigar, size_t len )
+{
+    rc_t rc = 0;
+    const char * end = cigar + len;
+    if ( len == 0 || ( len == 1 && cigar[ 0 ] == '*' ) )
+        return 0;
+    while ( rc == 0 && cigar < end )
+    {
+        uint32_t count = 0;
+        const char * op;
+        if ( *cigar < '0' || *cigar > '9' )
+            return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+        while ( cigar < end && *cigar >= '0' && *cigar <= '9' )
+            count = count * 10 + ( *cigar++ - '0' );
+        op = ( cigar < end && *cigar != 0 ) ? strchr( cigar_ops, *cigar ) : NULL;
+        if ( op == NULL )
+            return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+        switch ( *cigar++ )
+        {
+            case 'M' : case 'D' : case 'N' : case '=' : case 'X' : self->ref_span += count; break;
+        }
+        rc = bam_buf_reserve( &self->buf, 4 );
+        if ( rc == 0 )
+        {
+            put_u32( &self->buf, ( count << 4 ) | ( uint32_t )( op - cigar_ops ) );
+            self->n_cigar++;
+        }
+    }
+    if ( rc == 0 && self->n_cigar > 0xFFFF )
+        rc = RC( rcExe, rcFile, rcWriting, rcData, rcExcessive );
+    return rc;
+}
+
+
+rc_t bam_rec_seq( bam_rec * self, const char * seq, size_t len, bool reverse )
+{
+    rc_t rc;
+    if ( len == 1 && seq[ 0 ] == '*' )
+        len = 0;
+    rc = bam_buf_reserve( &self->buf, ( len + 1 ) / 2 );
+    if ( rc == 0 )
+    {
+        uint8_t * dst = self->buf.p + self->buf.used;
+        size_t i;
+        memset( dst, 0, ( len + 1 ) / 2 );
+        for ( i = 0; i < len; ++i )
+        {
+            uint8_t code = reverse ? nt16_comp[ nt16( seq[ len - i - 1 ] ) ] : nt16( seq[ i ] );
+            dst[ i / 2 ] |= ( i & 1 ) ? code : ( uint8_t )( code << 4 );
+        }
+        self->buf.used += ( len + 1 ) / 2;
+        self->l_seq = ( uint32_t )len;
+    }
+    return rc;
+}
+
+
+rc_t bam_rec_qual( bam_rec * self, const char * qual, size_t len, uint8_t offset,
+                   const uint8_t * quant_matrix, bool reverse )
+{
+    rc_t rc;
+    if ( qual != NULL && len != self->l_seq )
+        return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+    rc = bam_buf_reserve( &self->buf, self->l_seq );
+    if ( rc == 0 )
+    {
+        uint8_t * dst = self->buf.p + self->buf.used;
+        if ( qual == NULL )
+            memset( dst, 0xFF, self->l_seq );
+        else
+        {
+            size_t i;
+            for ( i = 0; i < len; ++i )
+            {
+                uint8_t q = ( uint8_t )( qual[ reverse ? len - i - 1 : i ] - offset );
+                dst[ i ] = ( quant_matrix != NULL ) ? quant_matrix[ q ] : q;
+            }
+        }
+        self->buf.used += self->l_seq;
+    }
+    return rc;
+}
+
+
+rc_t bam_rec_tag_str( bam_rec * self, const char * tag, const char * value, size_t len )
+{
+    rc_t rc = bam_buf_reserve( &self->buf, 3 + len + 1 );
+    if ( rc == 0 )
+    {
+        switch ( tag[ 3 ] )
+        {
+            case 'A' : if ( len != 1 )
+                           return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+                       /* fall through: a single character, not terminated */
+            case 'Z' :
+            case 'H' : bam_buf_add( &self->buf, tag, 2 );
+                       bam_buf_add( &self->buf, tag + 3, 1 );
+                       bam_buf_add( &self->buf, value, len );
+                       if ( tag[ 3 ] != 'A' )
+                           self->buf.p[ self->buf.used++ ] = 0;
+                       break;
+
+            case 'i' : {
+                            /* a number as text, for instance a part of the ALIGN_GROUP-column */
+                            int64_t v = 0;
+                            size_t i = ( len > 0 && value[ 0 ] == '-' ) ? 1 : 0;
+                            if ( i == len )
+                                return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+                            for ( ; i < len; ++i )
+                            {
+                                if ( value[ i ] < '0' || value[ i ] > '9' )
+                                    return RC( rcExe, rcFile, rcWriting, rcData, rcInvalid );
+                                v = v * 10 + ( value[ i ] - '0' );
+                            }
+                            rc = bam_rec_tag_int( self, tag, ( value[ 0 ] == '-' ) ? -v : v );
+                       }
+                       break;
+
+            default  : rc = RC( rcExe, rcFile, rcWriting, rcData, rcInvalid ); break;
+        }
+    }
+    return rc;
+}
+
+
+rc_t bam_rec_tag_int( bam_rec * self, const char * tag, int64_t value )
+{
+    rc_t rc = bam_buf_reserve( &self->buf, 3 + 4 );
+    if ( rc == 0 )
+    {
+        char t = int_type( value );
+        bam_buf_add( &self->buf, tag, 2 );
+        bam_buf_add( &self->buf, &t, 1 );
+        put_int( &self->buf, t, value );
+    }
+    return rc;
+}
+
+
+rc_t bam_rec_tags_sam( bam_rec * self, const char * text, size_t len )
+{
+    rc_t rc = 0;
+    const char * end = text + len;
+    while ( rc == 0 && text < end )
+    {
+        const char * tab = memchr( text, '\t', end - text );
+        size_t part = ( tab != NULL ) ? ( size_t )( tab - text ) : ( size_t )( end - text );
+        if ( part > 0 )
+        {
+            /* encode_tag() needs the field terminated by 0 */
+            self->scratch.used = 0;
+            rc = bam_buf_reserve( &self->scratch, part + 1 );
+            if ( rc == 0 )
+            {
+                bam_buf_add( &self->scratch, text, part );
+                self->scratch.p[ self->scratch.used ] = 0;
+                rc = encode_tag( &self->buf, ( const char * )self->scratch.p );
+            }
+        }
+        text += part + ( tab != NULL ? 1 : 0 );
+    }
+    return rc;
+}
+
+
+rc_t bam_rec_write( bam_rec * self, uint32_t flag, const char * rname, size_t rname_len, int64_t pos,
+                    uint32_t mapq, const char * rnext, size_t rnext_len, int64_t pnext, int64_t tlen )
+{
+    rc_t rc;
+    size_t rec_end = self->buf.used;
+    int64_t beg = pos - 1;
+
+    if ( rname_len == 0 )
+    {
+        rname = "*";
+        rname_len = 1;
+    }
+    if ( rnext_len == 0 )
+    {
+        rnext = "*";
+        rnext_len = 1;
+    }
+    rc = bam_buf_reserve( &self->buf, rname_len + rnext_len + 2 );
+    if ( rc == 0 )
+    {
+        int64_t bin = reg2bin( beg, beg + ( self->ref_span > 0 ? self->ref_span : 1 ), BAM_MIN_SHIFT, BAI_DEPTH );
+        size_t l_read_name = strlen( ( const char * )self->buf.p + BAM_FRAME_HDR + BAM_CORE_SIZE ) + 1;
+
+        /* the names of the references follow the record, bam_out_write() translates them into ids */
+        bam_buf_add( &self->buf, rname, rname_len );
+        self->buf.p[ self->buf.used++ ] = 0;
+        bam_buf_add( &self->buf, rnext, rnext_len );
+        self->buf.p[ self->buf.used++ ] = 0;
+
+        self->buf.used = 0;
+        self->buf.p[ self->buf.used++ ] = BAM_FRAME_MARK;
+        put_u32( &self->buf, ( uint32_t )( rec_end + rname_len + rnext_len + 2 - BAM_FRAME_HDR ) );
+        put_u32( &self->buf, ( uint32_t )( rec_end - BAM_FRAME_HDR - 4 ) );   /* block_size */
+        put_u32( &self->buf, ( uint32_t )-1 );                                  /* refID */
+        put_u32( &self->buf, ( uint32_t )beg );                                 /* pos */
+        self->buf.p[ self->buf.used++ ] = ( uint8_t )l_read_name;              /* l_read_name */
+        self->buf.p[ self->buf.used++ ] = ( uint8_t )mapq;                     /* mapq */
+        put_u16( &self->buf, ( uint16_t )bin );                                 /* bin */
+        put_u16( &self->buf, ( uint16_t )self->n_cigar );                       /* n_cigar_op */
+        put_u16( &self->buf, ( uint16_t )flag );                                /* flag */
+        put_u32( &self->buf, self->l_seq );                                     /* l_seq */
+        put_u32( &self->buf, ( uint32_t )-1 );                                  /* next_refID */
+        put_u32( &self->buf, ( uint32_t )( pnext - 1 ) );                       /* next_pos */
+        put_u32( &self->buf, ( uint32_t )tlen );                                /* tlen */
+        self->buf.used = rec_end + rname_len + rnext_len + 2;
+    }
+
+    if ( rc == 0 )
+    {
+        KWrtHandler * handler = KOutHandlerGet();
+        size_t written = 0;
+        while ( rc == 0 && written < self->buf.used )
+        {
+            size_t num_writ = 0;
+            rc = ( * handler->writer )( handler->data, ( const char * )self->buf.p + written,
+                                        self->buf.used - written, &num_writ );
+            if ( rc == 0 && num_writ == 0 )
+                rc = RC( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+            written += num_writ;
+        }
+    }
+    self->buf.used = 0;
+    return rc;
+}
+
+
+/* ----------------------------------------------------------------------------------------- */
+
+/* the record has refID / next_refID set, it starts with block_size */
+static rc_t write_record( bam_out * self, const uint8_t * rec, size_t size,
+                          int32_t ref_id, int64_t pos, int64_t ref_len, uint32_t flag )
+{
+    rc_t rc = 0;
+    uint64_t vbeg, vend;
+
+    /* start a new block if the record does not fit into the current one */
+    if ( size <= BGZF_POOL_PAYLOAD && size > bgzf_pool_room( self->pool ) )
+        rc = bgzf_pool_flush( self->pool ); /* bgzf_pool.c */
+    vbeg = bgzf_pool_vpos( self->pool );
+    if ( rc == 0 )
+        rc = bgzf_pool_write( self->pool, rec, size ); /* bgzf_pool.c */
+    vend = bgzf_pool_vpos( self->pool );
+    if ( rc == 0 && self->idx.ok )
+        rc = index_add( &self->idx, ref_id, pos, pos + ( ref_len > 0 ? ref_len : 1 ),
+                        ( flag & 0x4 ) != 0, vbeg, vend );
+    self->records++;
+    return rc;
+}
+
+
+/* a frame written by bam_rec_write(): the record followed by RNAME and RNEXT */
+static rc_t write_frame( bam_out * self, uint8_t * frame, size_t size )
+{
+    rc_t rc = 0;
+    uint32_t block_size = ( size >= BAM_CORE_SIZE ) ? get_u32( frame ) : 0;
+    const char * rname, * rnext;
+    size_t rname_len, rnext_len, cigar_at;
+    int32_t ref_id, next_id;
+    int64_t ref_len = 0;
+    uint32_t n_cigar, i;
+
+    if ( block_size < BAM_CORE_SIZE - 4 || ( size_t )block_size + 4 + 4 > size || frame[ size - 1 ] != 0 )
+    {
+        rc = RC( rcExe, rcFile, rcWriting, rcData, rcCorrupt );
+        (void)LOGERR( klogErr, rc, "invalid BAM-record" );
+        return rc;
+    }
+    rname = ( const char * )frame + 4 + block_size;
+    rname_len = strlen( rname );
+    if ( 4 + ( size_t )block_size + rname_len + 1 >= size )
+    {
+        rc = RC( rcExe, rcFile, rcWriting, rcData, rcCorrupt );
+        (void)LOGERR( klogErr, rc, "invalid BAM-record" );
+        return rc;
+    }
+    rnext = rname + rname_len + 1;
+    rnext_len = strlen( rnext );
+
+    if ( !self->header_written )
+        rc = write_header( self );
+    if ( rc == 0 )
+        rc = find_ref( self, rname, rname_len, &ref_id );
+    if ( rc == 0 )
+    {
+        if ( rnext_len == 1 && rnext[ 0 ] == '=' )
+            next_id = ref_id;
+        else
+            rc = find_ref( self, rnext, rnext_len, &next_id );
+    }
+    if ( rc != 0 )
+        return rc;
+    put_u32_at( frame + 4, ( uint32_t )ref_id );
+    put_u32_at( frame + 24, ( uint32_t )next_id );
+
+    /* the reference-bases covered, for the index */
+    n_cigar = ( uint32_t )frame[ 16 ] | ( ( uint32_t )frame[ 17 ] << 8 );
+    cigar_at = 36 + frame[ 12 ];
+    for ( i = 0; i < n_cigar && cigar_at + 4 * ( i + 1 ) <= ( size_t )block_size + 4; ++i )
+    {
+        uint32_t op = get_u32( frame + cigar_at + 4 * i );
+        switch ( op & 0xF )
+        {
+            case 0 : case 2 : case 3 : case 7 : case 8 : ref_len += op >> 4; break;
+        }
+    }
+
+    return write_record( self, frame, ( size_t )block_size + 4, ref_id, ( int32_t )get_u32( frame + 8 ),
+                         ref_len, ( uint32_t )frame[ 18 ] | ( ( uint32_t )frame[ 19 ] << 8 ) );
+}
+
+
+/* a SAM-line from the KOut-handler, terminated by 0: only the header is text */
+static rc_t process_line( bam_out * self, char * line, size_t len )
+{
+    rc_t rc = 0;
+    if ( len == 0 )
+        return 0;
+    if ( line[ 0 ] != '@' )
+    {
+        rc = RC( rcExe, rcFile, rcWriting, rcData, rcUnexpected );
+        (void)PLOGERR( klogErr, ( klogErr, rc, "unexpected text-line in BAM-output: '$(line)'", "line=%s", line ) );
+        return rc;
+    }
+    if ( self->header_written )
+    {
+        (void)LOGMSG( klogWarn, "header-line after the first record ignored in BAM-output" );
+        return 0;
+    }
+    rc = bam_buf_add( &self->hdr_text, line, len );
+    if ( rc == 0 )
+        rc = bam_buf_add( &self->hdr_text, "\n", 1 );
+    if ( rc == 0 && len > 4 && memcmp( line, "@SQ\t", 4 ) == 0 )
+        rc = parse_sq_line( self, line );
+    return rc;
+}
+
+
+rc_t bam_out_write( struct bam_out * self, const char * text, size_t len )
+{
+    rc_t rc = 0;
+    while ( rc == 0 && len > 0 )
+    {
+        size_t part;
+        if ( ( self->line.used > 0 ? self->line.p[ 0 ] : ( uint8_t )text[ 0 ] ) == BAM_FRAME_MARK )
+        {
+            /* a frame of bam_rec_write(), may arrive in pieces: header first, then the rest */
+            size_t need = BAM_FRAME_HDR;
+            if ( self->line.used >= BAM_FRAME_HDR )
+                need += get_u32( self->line.p + 1 );
+            part = need - self->line.used;
+            if ( part > len )
+                part = len;
+            rc = bam_buf_add( &self->line, text, part );
+            if ( rc == 0 && need > BAM_FRAME_HDR && self->line.used == need )
+            {
+                rc = write_frame( self, self->line.p + BAM_FRAME_HDR, need - BAM_FRAME_HDR );
+                self->line.used = 0;
+            }
+        }
+        else
+        {
+            const char * nl = memchr( text, '\n', len );
+            part = ( nl != NULL ) ? ( size_t )( nl - text ) : len;
+
+            rc = bam_buf_add( &self->line, text, part );
+            if ( rc == 0 && nl != NULL )
+            {
+                /* terminate the line by 0, the parsers rely on it */
+                rc = bam_buf_reserve( &self->line, 1 );
+                if ( rc == 0 )
+                {
+                    self->line.p[ self->line.used ] = 0;
+                    rc = process_line( self, ( char * )self->line.p, self->line.used );
+                    self->line.used = 0;
+                }
+                part++;
+            }
+        }
+        text += part;
+        len -= part;
+    }
+    return rc;
+}
+
+
+rc_t bam_out_finish( struct bam_out * self )
+{
+    rc_t rc = 0;
+    if ( self->line.used > 0 )
+    {
+        if ( self->line.p[ 0 ] == BAM_FRAME_MARK )
+        {
+            rc = RC( rcExe, rcFile, rcWriting, rcData, rcIncomplete );
+            (void)LOGERR( klogErr, rc, "incomplete BAM-record at the end of the output" );
+        }
+        else
+            rc = bam_out_write( self, "\n", 1 );
+    }
+    if ( rc == 0 && !self->header_written )
+        rc = write_header( self );
+    if ( rc == 0 )
+        rc = bgzf_pool_finish( self->pool ); /* bgzf_pool.c */
+    if ( rc == 0 && self->idx.type != boi_none && self->idx.ok )
+        rc = index_write( &self->idx, self->ref_count, self->pool );
+    return rc;
+}
@@ -0,0 +1,134 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+#ifndef _h_bam_out_
+#define _h_bam_out_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+#include <klib/rc.h>
+#include <kfs/file.h>
+
+/* ---------------------------------------------------------------------------------------------
+    the bam-out encoder sits behind the KOut-handler and writes BAM: the @-lines of the header
+    arrive as text and are collected into the BAM-header ( the @SQ-lines define the reference-
+    dictionary ). The records are encoded by the dump-code straight from the column-values
+    ( bam_rec below ) and arrive already binary. The BGZF-compression runs on a pool of threads
+    ( bgzf_pool.c ).
+
+    If requested, a BAI- or CSI-index is built on the fly and written at the end. This requires
+    the records to be sorted by reference and position, which is the order sam-dump produces.
+    If a record is found out of order, the index is dropped with a warning.
+--------------------------------------------------------------------------------------------- */
+
+/* a growing byte-buffer */
+typedef struct bam_buf
+{
+    uint8_t * p;
+    size_t used;
+    size_t cap;
+} bam_buf;
+
+enum bam_out_index
+{
+    boi_none = 0,
+    boi_bai,
+    boi_csi
+};
+
+struct bam_out;
+
+/* the encoder does not own the file */
+rc_t make_bam_out( struct bam_out ** self, KFile * f, uint32_t threads,
+                   enum bam_out_index index_type, const char * index_path );
+
+rc_t bam_out_write( struct bam_out * self, const char * text, size_t len );
+
+/* encodes a trailing incomplete line, writes the EOF-marker and the index */
+rc_t bam_out_finish( struct bam_out * self );
+
+void release_bam_out( struct bam_out * self );
+
+
+/* ---------------------------------------------------------------------------------------------
+    a BAM-record assembled by sam-aligned.c / sam-unaligned.c from the column-values, the buffer
+    is reused for all records. The parts have to be added in the order of the record:
+    start ( QNAME ), cigar, seq, qual, tags, write.
+
+    bam_rec_write() hands the record to the KOut-handler, that way it stays in order with the
+    output of the other threads ( ordered_out.c ). The reference-names travel with the record,
+    bam_out_write() only translates them into ids before the record is compressed.
+--------------------------------------------------------------------------------------------- */
+
+typedef struct bam_rec
+{
+    bam_buf buf;
+    bam_buf scratch;        /* one optional field of bam_rec_tags_sam(), terminated by 0 */
+    uint32_t n_cigar;
+    uint32_t l_seq;
+    int64_t ref_span;       /* reference-bases covered by the CIGAR */
+} bam_rec;
+
+void init_bam_rec( bam_rec * self );
+
+void release_bam_rec( bam_rec * self );
+
+/* empty qname is written as '*' */
+rc_t bam_rec_start( bam_rec * self, const char * qname, size_t len );
+
+/* the CIGAR-string as read from the cursor, empty or '*' for none */
+rc_t bam_rec_cigar( bam_rec * self, const char * cigar, size_t len );
+
+/* the bases as text, reverse-complemented if requested */
+rc_t bam_rec_seq( bam_rec * self, const char * seq, size_t len, bool reverse );
+
+/* NULL for '*', otherwise one value per base: phred + offset ( 0 or 33 ),
+   quant_matrix ( opts->qual_quant_matrix ) is applied if not NULL */
+rc_t bam_rec_qual( bam_rec * self, const char * qual, size_t len, uint8_t offset,
+                   const uint8_t * quant_matrix, bool reverse );
+
+/* tag in SAM-notation, for instance "RG:Z:" ( types A, Z, H, and i given as text ) */
+rc_t bam_rec_tag_str( bam_rec * self, const char * tag, const char * value, size_t len );
+
+rc_t bam_rec_tag_int( bam_rec * self, const char * tag, int64_t value );
+
+/* TAB-separated optional fields in SAM-notation, as produced by cg_tools.c */
+rc_t bam_rec_tags_sam( bam_rec * self, const char * text, size_t len );
+
+/* the fixed fields as they appear in SAM: pos and pnext 1-based ( 0 = none ), rnext may be '=',
+   empty names are written as '*'; the record is written via the KOut-handler */
+rc_t bam_rec_write( bam_rec * self, uint32_t flag, const char * rname, size_t rname_len, int64_t pos,
+                    uint32_t mapq, const char * rnext, size_t rnext_len, int64_t pnext, int64_t tlen );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -668,36 +668,54 @@ static rc_t prepare_reflist( prepare_ctx *ctx )
 }
 
 
+rc_t open_ref_source( prepare_ctx *ctx,
+                      const VDBManager *vdb_mgr,
+                      VSchema *vdb_schema,
+                      const char * path )
+{
+    rc_t rc;
+    ctx->reflist = NULL;
+    rc = prepare_db_table( ctx, vdb_mgr, vdb_schema, path );
+    if ( rc == 0 )
+        rc = prepare_reflist( ctx );
+    return rc;
+}
+
+
+/* ctx->db keeps its value: the caller of prepare_ref_iter() detects with it if it was a database */
+void close_ref_source( prepare_ctx *ctx )
+{
+    if ( ctx->reflist != NULL )
+    {
+        ReferenceList_Release( ctx->reflist );
+        ctx->reflist = NULL;
+    }
+    VTableRelease ( ctx->seq_tab );
+    VDatabaseRelease ( ctx->db );
+}
+
+
 rc_t prepare_ref_iter( prepare_ctx *ctx,
                        const VDBManager *vdb_mgr,
                        VSchema *vdb_schema,
                        const char * path,
                        BSTree * regions )
 {
-    rc_t rc = prepare_db_table( ctx, vdb_mgr, vdb_schema, path );
+    rc_t rc = open_ref_source( ctx, vdb_mgr, vdb_schema, path );
     if ( rc == 0 )
     {
-        rc = prepare_reflist( ctx );
-        if( rc == 0 )
+        if ( ctx->reflist == NULL || count_ref_regions( regions ) == 0 )
         {
-            if ( ctx->reflist == NULL || count_ref_regions( regions ) == 0 )
-            {
-                /* the user has not specified a reference-range : use the whole file... */
-                rc = prepare_whole_file( ctx );
-            }
-            else
-            {
-                /* pick only the requested ranges... */
-                rc = foreach_ref_region( regions, prepare_region_cb, ctx ); /* ref_regions.c */
-            }
+            /* the user has not specified a reference-range : use the whole file... */
+            rc = prepare_whole_file( ctx );
         }
-        if ( ctx->reflist != NULL )
+        else
         {
-            ReferenceList_Release( ctx->reflist );
+            /* pick only the requested ranges... */
+            rc = foreach_ref_region( regions, prepare_region_cb, ctx ); /* ref_regions.c */
         }
     }
-    VTableRelease ( ctx->seq_tab );
-    VDatabaseRelease ( ctx->db );
+    close_ref_source( ctx );
     return rc;
 }
 
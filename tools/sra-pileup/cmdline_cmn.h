@@ -127,6 +127,14 @@ typedef struct prepare_ctx
 
 
 
+/* opens ctx->db, ctx->seq_tab and ctx->reflist for path */
+rc_t open_ref_source( prepare_ctx *ctx,
+                      const VDBManager *vdb_mgr,
+                      VSchema *vdb_schema,
+                      const char * path );
+
+void close_ref_source( prepare_ctx *ctx );
+
 rc_t prepare_ref_iter( prepare_ctx *ctx,
                        const VDBManager *vdb_mgr,
                        VSchema *vdb_schema,
@@ -197,6 +197,47 @@ rc_t print_dyn_string( struct dyn_string * self )
 }
 
 
+rc_t add_bytes_2_dyn_string( struct dyn_string *self, const void * bytes, size_t len )
+{
+    rc_t rc = 0;
+    if ( self->data_len + len + 1 > self->allocated )
+    {
+        size_t new_size = self->allocated * 2;
+        if ( new_size < self->data_len + len + 1 )
+            new_size = self->data_len + len + 1;
+        rc = expand_dyn_string( self, new_size );
+    }
+    if ( rc == 0 )
+    {
+        memmove( &(self->data[ self->data_len ]), bytes, len );
+        self->data_len += len;
+        self->data[ self->data_len ] = 0;
+    }
+    return rc;
+}
+
+
+rc_t write_dyn_string( struct dyn_string * self )
+{
+    rc_t rc = 0;
+    if ( self != NULL )
+    {
+        KWrtWriter writer = KOutWriterGet();
+        void * data = KOutDataGet();
+        size_t done = 0;
+        while ( rc == 0 && done < self->data_len && writer != NULL )
+        {
+            size_t num_writ = 0;
+            rc = writer( data, &(self->data[ done ]), self->data_len - done, &num_writ );
+            if ( rc == 0 && num_writ == 0 )
+                rc = RC( rcApp, rcNoTarg, rcWriting, rcTransfer, rcIncomplete );
+            done += num_writ;
+        }
+    }
+    return rc;
+}
+
+
 size_t dyn_string_len( struct dyn_string * self )
 {
     if ( self != NULL )
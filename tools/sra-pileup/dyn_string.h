@@ -46,6 +46,9 @@ rc_t add_string_2_dyn_string( struct dyn_string *self, const char * s );
 rc_t add_dyn_string_2_dyn_string( struct dyn_string *self, struct dyn_string *other );
 rc_t print_2_dyn_string( struct dyn_string * self, const char *fmt, ... );
 rc_t print_dyn_string( struct dyn_string * self );
+rc_t add_bytes_2_dyn_string( struct dyn_string *self, const void * bytes, size_t len );
+/* writes the content as is through the current KOut-writer, safe for binary content */
+rc_t write_dyn_string( struct dyn_string * self );
 size_t dyn_string_len( struct dyn_string * self );
 
 #ifdef __cplusplus
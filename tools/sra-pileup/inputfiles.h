@@ -64,6 +64,7 @@ typedef struct input_database
     char * path;
     const VDatabase * db;
     const ReferenceList *reflist;
+    uint32_t reflist_options;   /* to make more reflists for worker-threads ( sam-aligned.c ) */
     void * prim_ctx;
     void * sec_ctx;
     void * ev_ctx;
@@ -27,6 +27,242 @@
 #include "matecache.h"
 #include <sysalloc.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================================
+    the same-ref mate-table
+   ============================================================================================ */
+
+#define MATE_TABLE_MIN_BITS 10
+#define MATE_SWEEP_STEP 4096
+#define MATE_DIST_MIN_COUNT 1024    /* observations before the distance-limit adapts */
+
+typedef struct mate_entry
+{
+    int64_t key;                    /* alignment-id, 0 ... empty slot */
+    INSDC_coord_zero ref_pos;
+    INSDC_coord_len tlen;
+    INSDC_coord_zero mate_pos;
+    uint32_t flags;
+} mate_entry;
+
+
+static uint64_t mate_hash( int64_t key, uint32_t bits )
+{
+    /* Fibonacci-hashing, the alignment-id's are dense */
+    return ( ( uint64_t )key * 0x9E3779B97F4A7C15ULL ) >> ( 64 - bits );
+}
+
+
+static void init_mate_table( mate_table * t, uint32_t min_max_dist )
+{
+    memset( t, 0, sizeof *t );
+    t->min_max_dist = min_max_dist;
+    t->max_dist = min_max_dist;
+}
+
+
+static void release_mate_table( mate_table * t )
+{
+    if ( t->entries != NULL )
+        free( t->entries );
+    t->entries = NULL;
+    t->bits = 0;
+    t->used = 0;
+}
+
+
+static uint64_t mate_table_bytes( const mate_table * t )
+{
+    return ( t->bits > 0 ) ? ( ( ( uint64_t )1 << t->bits ) * sizeof( mate_entry ) ) : 0;
+}
+
+
+static mate_entry * mate_table_find( const mate_table * t, int64_t key )
+{
+    if ( t->bits > 0 )
+    {
+        uint64_t mask = ( ( uint64_t )1 << t->bits ) - 1;
+        uint64_t i = mate_hash( key, t->bits );
+        while ( t->entries[ i ].key != 0 )
+        {
+            if ( t->entries[ i ].key == key )
+                return &t->entries[ i ];
+            i = ( i + 1 ) & mask;
+        }
+    }
+    return NULL;
+}
+
+
+/* the slot for key, either the one with this key or an empty one ( there is always an empty one ) */
+static mate_entry * mate_table_slot( mate_entry * entries, uint32_t bits, int64_t key )
+{
+    uint64_t mask = ( ( uint64_t )1 << bits ) - 1;
+    uint64_t i = mate_hash( key, bits );
+    while ( entries[ i ].key != 0 && entries[ i ].key != key )
+        i = ( i + 1 ) & mask;
+    return &entries[ i ];
+}
+
+
+/* moves all entries, with a mate not before min_mate_pos, into a new array of 1 << bits slots */
+static rc_t mate_table_rebuild( mate_table * t, uint32_t bits, INSDC_coord_zero min_mate_pos, uint64_t * evicted )
+{
+    rc_t rc = 0;
+    mate_entry * entries = calloc( ( size_t )1 << bits, sizeof *entries );
+    if ( entries == NULL )
+    {
+        rc = RC( rcApp, rcNoTarg, rcResizing, rcMemory, rcExhausted );
+        (void)LOGERR( klogErr, rc, "cannot resize same-ref-cache" );
+    }
+    else
+    {
+        INSDC_coord_zero new_min = 0;
+        uint64_t used = 0;
+        if ( t->entries != NULL )
+        {
+            uint64_t i, capacity = ( uint64_t )1 << t->bits;
+            for ( i = 0; i < capacity; ++i )
+            {
+                const mate_entry * e = &t->entries[ i ];
+                if ( e->key != 0 )
+                {
+                    if ( e->mate_pos < min_mate_pos )
+                        ( *evicted )++;
+                    else
+                    {
+                        *( mate_table_slot( entries, bits, e->key ) ) = *e;
+                        if ( used == 0 || e->mate_pos < new_min )
+                            new_min = e->mate_pos;
+                        used++;
+                    }
+                }
+            }
+            free( t->entries );
+        }
+        t->entries = entries;
+        t->bits = bits;
+        t->used = used;
+        t->min_mate_pos = new_min;
+    }
+    return rc;
+}
+
+
+/* evicts the entries the walk has passed, shrinks the table if it is mostly empty */
+static rc_t mate_table_sweep( mate_table * t, INSDC_coord_zero walk_pos, uint64_t * evicted )
+{
+    rc_t rc = 0;
+    t->next_sweep = walk_pos + MATE_SWEEP_STEP;
+    if ( t->used > 0 && t->min_mate_pos < walk_pos )
+    {
+        uint32_t bits = t->bits;
+        while ( bits > MATE_TABLE_MIN_BITS && ( t->used * 8 ) < ( ( uint64_t )1 << bits ) )
+            bits--;
+        rc = mate_table_rebuild( t, bits, walk_pos, evicted );
+    }
+    return rc;
+}
+
+
+/* the distance-limit: twice the distance, that covers 99% of the observed mates */
+static void mate_table_observe( mate_table * t, uint64_t dist )
+{
+    uint32_t bucket = 0;
+    while ( dist > 1 && bucket < 31 )
+    {
+        dist >>= 1;
+        bucket++;
+    }
+    t->dist_hist[ bucket ]++;
+    t->dist_count++;
+    if ( t->dist_count >= MATE_DIST_MIN_COUNT && ( t->dist_count & ( MATE_DIST_MIN_COUNT - 1 ) ) == 0 )
+    {
+        uint64_t sum = 0, limit = t->dist_count - ( t->dist_count / 100 );
+        uint32_t b = 0;
+        while ( b < 31 && ( sum += t->dist_hist[ b ] ) < limit )
+            b++;
+        t->max_dist = ( b >= 29 ) ? 0x7FFFFFFF : ( ( uint32_t )2 << ( b + 1 ) );
+        if ( t->max_dist < t->min_max_dist )
+            t->max_dist = t->min_max_dist;
+    }
+}
+
+
+static rc_t mate_table_insert( mate_table * t, const mate_entry * e, matecache_per_file * mcpf )
+{
+    rc_t rc = 0;
+    mate_entry * slot;
+
+    if ( t->bits == 0 )
+        rc = mate_table_rebuild( t, MATE_TABLE_MIN_BITS, 0, &mcpf->evicted_same_ref );
+    else if ( e->ref_pos >= t->next_sweep )
+        rc = mate_table_sweep( t, e->ref_pos, &mcpf->evicted_same_ref );
+
+    /* keep the load-factor below 0.5 */
+    if ( rc == 0 && ( ( t->used + 1 ) * 2 ) > ( ( uint64_t )1 << t->bits ) )
+    {
+        rc = mate_table_sweep( t, e->ref_pos, &mcpf->evicted_same_ref );
+        if ( rc == 0 && ( ( t->used + 1 ) * 2 ) > ( ( uint64_t )1 << t->bits ) )
+            rc = mate_table_rebuild( t, t->bits + 1, 0, &mcpf->evicted_same_ref );
+    }
+
+    if ( rc == 0 )
+    {
+        if ( mate_table_bytes( t ) > mcpf->maxbytes_same_ref )
+            mcpf->maxbytes_same_ref = mate_table_bytes( t );
+        slot = mate_table_slot( t->entries, t->bits, e->key );
+        if ( slot->key == 0 )
+            t->used++;
+        *slot = *e;
+        if ( t->used == 1 || e->mate_pos < t->min_mate_pos )
+            t->min_mate_pos = e->mate_pos;
+    }
+    return rc;
+}
+
+
+/* backward-shift deletion: no tombstones, the probe-sequences stay short */
+static void mate_table_delete( mate_table * t, mate_entry * e )
+{
+    uint64_t mask = ( ( uint64_t )1 << t->bits ) - 1;
+    uint64_t i = e - t->entries;
+    uint64_t j = i;
+    while ( true )
+    {
+        uint64_t home;
+        j = ( j + 1 ) & mask;
+        if ( t->entries[ j ].key == 0 )
+            break;
+        home = mate_hash( t->entries[ j ].key, t->bits );
+        /* the entry at j can stay, if its home-slot is cyclically in ( i, j ] */
+        if ( ( i <= j ) ? ( i < home && home <= j ) : ( i < home || home <= j ) )
+            continue;
+        t->entries[ i ] = t->entries[ j ];
+        i = j;
+    }
+    t->entries[ i ].key = 0;
+    t->used--;
+}
+
+
+static void mate_table_clear( mate_table * t )
+{
+    if ( t->entries != NULL )
+    {
+        if ( t->bits > MATE_TABLE_MIN_BITS + 4 )
+            release_mate_table( t );  /* do not keep a huge table for the next reference */
+        else
+            memset( t->entries, 0, mate_table_bytes( t ) );
+    }
+    t->used = 0;
+    t->next_sweep = 0;
+    t->min_mate_pos = 0;
+}
+
+
+/* ============================================================================================ */
 
 void release_matecache( matecache * const self )
 {
@@ -37,10 +273,7 @@ void release_matecache( matecache * const self )
             uint32_t idx;
             for ( idx = 0; idx < self->count; ++idx )
             {
-                if ( self->per_file[ idx ].same_ref_64 != NULL )
-                    KVectorRelease( self->per_file[ idx ].same_ref_64 );
-                if ( self->per_file[ idx ].same_ref_16 != NULL )
-                    KVectorRelease( self->per_file[ idx ].same_ref_16 );
+                release_mate_table( &self->per_file[ idx ].same_ref );
 
                 if ( self->per_file[ idx ].unaligned_64_a != NULL )
                     KVectorRelease( self->per_file[ idx ].unaligned_64_a );
@@ -54,7 +287,7 @@ void release_matecache( matecache * const self )
 }
 
 
-rc_t make_matecache( matecache **self, uint32_t count )
+rc_t make_matecache( matecache **self, uint32_t count, uint32_t min_dist )
 {
     rc_t rc = 0;
 
@@ -68,6 +301,7 @@ rc_t make_matecache( matecache **self, uint32_t count )
     else
     {
         mc->count = count;
+        mc->min_dist = min_dist;
         mc->per_file = calloc( sizeof *(mc->per_file), count );
         if ( mc->per_file == NULL )
         {
@@ -79,26 +313,15 @@ rc_t make_matecache( matecache **self, uint32_t count )
             uint32_t idx;
             for ( idx = 0; idx < count && rc == 0; ++idx )
             {
-                rc = KVectorMake( &( mc->per_file[ idx ].same_ref_64 ) );
+                init_mate_table( &( mc->per_file[ idx ].same_ref ), min_dist );
+                rc = KVectorMake( &( mc->per_file[ idx ].unaligned_64_a ) );
                 if ( rc != 0 )
-                    (void)LOGERR( klogErr, rc, "cannot create KVector (same-ref) U64" );
+                    (void)LOGERR( klogErr, rc, "cannot create KVector (unaligned a) U64" );
                 else
                 {
-                    rc = KVectorMake( &( mc->per_file[ idx ].same_ref_16 ) );
+                    rc = KVectorMake( &( mc->per_file[ idx ].unaligned_64_b ) );
                     if ( rc != 0 )
-                        (void)LOGERR( klogErr, rc, "cannot create KVector (same-ref) U16" );
-                    else
-                    {
-                        rc = KVectorMake( &( mc->per_file[ idx ].unaligned_64_a ) );
-                        if ( rc != 0 )
-                            (void)LOGERR( klogErr, rc, "cannot create KVector (unaligned a) U64" );
-                        else
-                        {
-                            rc = KVectorMake( &( mc->per_file[ idx ].unaligned_64_b ) );
-                            if ( rc != 0 )
-                                (void)LOGERR( klogErr, rc, "cannot create KVector (unaligned b) U64" );
-                        }
-                    }
+                        (void)LOGERR( klogErr, rc, "cannot create KVector (unaligned b) U64" );
                 }
             }
             if ( rc == 0 )
@@ -166,30 +389,37 @@ static rc_t matecache_check( const matecache * const self, uint32_t db_idx, mate
 
 
 rc_t matecache_insert_same_ref( matecache * const self,
-        uint32_t db_idx, int64_t key, INSDC_coord_zero ref_pos, uint32_t flags, INSDC_coord_len tlen )
+        uint32_t db_idx, int64_t key, INSDC_coord_zero ref_pos, uint32_t flags, INSDC_coord_len tlen,
+        INSDC_coord_zero mate_pos )
 {
     matecache_per_file * mcpf = NULL;
     rc_t rc = matecache_check( self, db_idx, &mcpf );
     if ( rc == 0 )
     {
-        uint64_t ref_pos_and_tlen = ref_pos;
-        ref_pos_and_tlen <<= 32;
-        ref_pos_and_tlen |= tlen;
-        rc = KVectorSetU64( mcpf->same_ref_64, key, ref_pos_and_tlen );
-        if ( rc != 0 )
-            (void)LOGERR( klogErr, rc, "cannot insert into KVector (same-ref) U64" );
-        else
-        {
-            rc = KVectorSetU16( mcpf->same_ref_16, key, flags );
-            if ( rc != 0 )
-                (void)LOGERR( klogErr, rc, "cannot insert into KVector (same-ref) U16" );
-        }
-        if ( rc == 0 )
+        mate_table * t = &mcpf->same_ref;
+        if ( mate_pos >= ref_pos )  /* if not: the walk has passed the mate already */
         {
-            mcpf->stat_same_ref.count++;
-            if ( mcpf->stat_same_ref.count > mcpf->maxcount_same_ref )
-                mcpf->maxcount_same_ref = mcpf->stat_same_ref.count;
-            mcpf->stat_same_ref.inserts++;
+            uint64_t dist = mate_pos - ref_pos;
+            mate_table_observe( t, dist );
+            if ( dist > t->max_dist )
+                mcpf->too_far_same_ref++;
+            else
+            {
+                mate_entry e;
+                e.key = key;
+                e.ref_pos = ref_pos;
+                e.tlen = tlen;
+                e.mate_pos = mate_pos;
+                e.flags = flags;
+                rc = mate_table_insert( t, &e, mcpf );
+                if ( rc == 0 )
+                {
+                    mcpf->stat_same_ref.count = t->used;
+                    if ( mcpf->stat_same_ref.count > mcpf->maxcount_same_ref )
+                        mcpf->maxcount_same_ref = mcpf->stat_same_ref.count;
+                    mcpf->stat_same_ref.inserts++;
+                }
+            }
         }
     }
     return rc;
@@ -203,30 +433,16 @@ rc_t matecache_lookup_same_ref( const matecache * const self, uint32_t db_idx, i
     rc_t rc = matecache_check( self, db_idx, &mcpf );
     if ( rc == 0 )
     {
-        uint64_t value64;
+        const mate_entry * e = mate_table_find( &mcpf->same_ref, key );
         mcpf->stat_same_ref.lookups++;
-        rc = KVectorGetU64( mcpf->same_ref_64, key, &value64 );
-        if ( rc != 0 )
-        {
-            if ( GetRCState( rc ) != rcNotFound )
-                (void)LOGERR( klogErr, rc, "cannot retrieve value (same-ref) U64" );
-        }
+        if ( e == NULL )
+            rc = RC( rcApp, rcNoTarg, rcAccessing, rcItem, rcNotFound );
         else
         {
-            uint16_t value16;
-            rc = KVectorGetU16( mcpf->same_ref_16, key, &value16 );
-            if ( rc != 0 )
-            {
-                if ( GetRCState( rc ) != rcNotFound )
-                    (void)LOGERR( klogErr, rc, "cannot retrieve value (same-ref) U16" );
-            }
-            else
-            {
-                *ref_pos = ( value64 >> 32 );
-                *tlen = ( value64 & 0xFFFFFFFF );
-                *flags = value16;
-                mcpf->stat_same_ref.finds++;
-            }
+            *ref_pos = e->ref_pos;
+            *tlen = e->tlen;
+            *flags = e->flags;
+            mcpf->stat_same_ref.finds++;
         }
     }
     return rc;
@@ -239,44 +455,10 @@ rc_t matecache_remove_same_ref( matecache * const self, uint32_t db_idx, int64_t
     rc_t rc = matecache_check( self, db_idx, &mcpf );
     if ( rc == 0 )
     {
-        rc = KVectorUnset( mcpf->same_ref_64, key );
-        if ( rc != 0 )
-            (void)LOGERR( klogErr, rc, "cannot remove from same-ref-cache (64bit)" );
-        else
-        {
-            rc = KVectorUnset( mcpf->same_ref_16, key );
-            if ( rc != 0 )
-                (void)LOGERR( klogErr, rc, "cannot remove from same-ref-cache (16bit)" );
-        }
-        if ( rc == 0 && mcpf->stat_same_ref.count > 0 )
-            mcpf->stat_same_ref.count--;
-    }
-    return rc;
-}
-
-
-static rc_t matecache_clear_same_ref_per_file( matecache_per_file * const mcpf )
-{
-    rc_t rc = KVectorRelease( mcpf->same_ref_64 );
-    if ( rc != 0 )
-        (void)LOGERR( klogErr, rc, "cannot release same-ref-cache (64bit)" );
-    else
-    {
-        rc = KVectorRelease( mcpf->same_ref_16 );
-        if ( rc != 0 )
-            (void)LOGERR( klogErr, rc, "cannot release same-ref-cache (16bit)" );
-        else
-        {
-            rc = KVectorMake( &mcpf->same_ref_64 );
-            if ( rc != 0 )
-                (void)LOGERR( klogErr, rc, "cannot make same-ref-cache (64bit)" );
-            else
-            {
-                rc = KVectorMake( &mcpf->same_ref_16 );
-                if ( rc != 0 )
-                    (void)LOGERR( klogErr, rc, "cannot make same-ref-cache (16bit)" );
-            }
-        }
+        mate_entry * e = mate_table_find( &mcpf->same_ref, key );
+        if ( e != NULL )
+            mate_table_delete( &mcpf->same_ref, e );
+        mcpf->stat_same_ref.count = mcpf->same_ref.used;
     }
     return rc;
 }
@@ -293,9 +475,10 @@ rc_t matecache_clear_same_ref( matecache * const self )
     else
     {
         uint32_t idx;
-        for ( idx = 0; idx < self->count && rc == 0; ++idx )
+        for ( idx = 0; idx < self->count; ++idx )
         {
-            rc = matecache_clear_same_ref_per_file( &self->per_file[ idx ] );
+            mate_table_clear( &self->per_file[ idx ].same_ref );
+            self->per_file[ idx ].stat_same_ref.count = 0;
         }
         self->flashes++;
    }
@@ -325,6 +508,19 @@ rc_t matecache_report( const matecache * const self )
                 rc = KOutMsg( "matecache[ %u ].lookups = %,lu\n", idx, self->per_file[ idx ].stat_same_ref.lookups );
             if ( rc == 0 )
                 rc = KOutMsg( "matecache[ %u ].finds = %,lu\n", idx, self->per_file[ idx ].stat_same_ref.finds );
+            if ( rc == 0 )
+            {
+                const matecache_stat * st = &self->per_file[ idx ].stat_same_ref;
+                uint64_t permille = ( st->lookups > 0 ) ? ( st->finds * 1000 ) / st->lookups : 0;
+                rc = KOutMsg( "matecache[ %u ].hitrate = %lu.%lu%%\n", idx, permille / 10, permille % 10 );
+            }
+            if ( rc == 0 )
+                rc = KOutMsg( "matecache[ %u ].evicted = %,lu\n", idx, self->per_file[ idx ].evicted_same_ref );
+            if ( rc == 0 )
+                rc = KOutMsg( "matecache[ %u ].too_far = %,lu ( limit = %,u )\n", idx,
+                              self->per_file[ idx ].too_far_same_ref, self->per_file[ idx ].same_ref.max_dist );
+            if ( rc == 0 )
+                rc = KOutMsg( "matecache[ %u ].maxbytes = %,lu\n", idx, self->per_file[ idx ].maxbytes_same_ref );
             if ( rc == 0 )
                 rc = KOutMsg( "unaligned:\n" );
             if ( rc == 0 )
@@ -335,7 +531,86 @@ rc_t matecache_report( const matecache * const self )
                 rc = KOutMsg( "matecache[ %u ].finds = %,lu\n", idx, self->per_file[ idx ].stat_unaligned.finds );
         }
         if ( rc == 0 )
-            rc = KOutMsg( "matecache.flashes = %,lu\n", idx, self->flashes );
+            rc = KOutMsg( "matecache.flashes = %,u\n", self->flashes );
+    }
+    return rc;
+}
+
+
+typedef struct merge_ctx
+{
+    matecache_per_file * dst;
+    const matecache_per_file * src;
+} merge_ctx;
+
+
+static rc_t CC on_unaligned_merge( uint64_t key, uint64_t value, void *user_data )
+{
+    merge_ctx * mctx = user_data;
+    uint64_t seq_id;
+    rc_t rc = KVectorGetU64( mctx->src->unaligned_64_b, key, &seq_id );
+    if ( rc != 0 )
+        (void)LOGERR( klogErr, rc, "cannot retrieve value (unaligned b) U64" );
+    else
+    {
+        rc = KVectorSetU64( mctx->dst->unaligned_64_a, key, value );
+        if ( rc != 0 )
+            (void)LOGERR( klogErr, rc, "cannot insert into KVector (unaligned a) U64" );
+        else
+        {
+            rc = KVectorSetU64( mctx->dst->unaligned_64_b, key, seq_id );
+            if ( rc != 0 )
+                (void)LOGERR( klogErr, rc, "cannot insert into KVector (unaligned b) U64" );
+        }
+    }
+    return rc;
+}
+
+
+rc_t matecache_merge( matecache * const self, const matecache * const other )
+{
+    rc_t rc = 0;
+    if ( self == NULL || other == NULL || self->count != other->count )
+    {
+        rc = RC( rcApp, rcNoTarg, rcAccessing, rcParam, rcInvalid );
+        (void)LOGERR( klogErr, rc, "cannot merge matecache" );
+    }
+    else
+    {
+        uint32_t idx;
+        for ( idx = 0; idx < self->count && rc == 0; ++idx )
+        {
+            matecache_per_file * dst = &self->per_file[ idx ];
+            const matecache_per_file * src = &other->per_file[ idx ];
+            merge_ctx mctx;
+
+            mctx.dst = dst;
+            mctx.src = src;
+            rc = KVectorVisitU64 ( src->unaligned_64_a, false, on_unaligned_merge, &mctx );
+            if ( rc == 0 )
+            {
+                dst->stat_same_ref.count   += src->stat_same_ref.count;
+                dst->stat_same_ref.lookups += src->stat_same_ref.lookups;
+                dst->stat_same_ref.finds   += src->stat_same_ref.finds;
+                dst->stat_same_ref.inserts += src->stat_same_ref.inserts;
+
+                dst->stat_unaligned.count   += src->stat_unaligned.count;
+                dst->stat_unaligned.lookups += src->stat_unaligned.lookups;
+                dst->stat_unaligned.finds   += src->stat_unaligned.finds;
+                dst->stat_unaligned.inserts += src->stat_unaligned.inserts;
+
+                if ( dst->maxcount_same_ref < src->maxcount_same_ref )
+                    dst->maxcount_same_ref = src->maxcount_same_ref;
+                if ( dst->maxbytes_same_ref < src->maxbytes_same_ref )
+                    dst->maxbytes_same_ref = src->maxbytes_same_ref;
+                dst->evicted_same_ref += src->evicted_same_ref;
+                dst->too_far_same_ref += src->too_far_same_ref;
+                if ( dst->same_ref.max_dist < src->same_ref.max_dist )
+                    dst->same_ref.max_dist = src->same_ref.max_dist;
+            }
+        }
+        if ( rc == 0 )
+            self->flashes += other->flashes;
     }
     return rc;
 }
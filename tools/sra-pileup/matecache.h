@@ -50,10 +50,34 @@ typedef struct matecache_stat
 } matecache_stat;
 
 
+/* ---------------------------------------------------------------------------------------------
+    same-ref cache: an open-addressed hash-table ( linear probing ), key is the alignment-id.
+    An entry is useless as soon as the walk has passed the position of the mate, entries like that
+    are evicted by a sweep every MATE_SWEEP_STEP bases. Mates farther apart than max_dist are not
+    cached at all, max_dist follows the observed distribution of the distances between mates.
+    This keeps the table small for long references, the lookups stay in the CPU-cache.
+--------------------------------------------------------------------------------------------- */
+
+struct mate_entry;
+
+typedef struct mate_table
+{
+    struct mate_entry * entries;
+    uint32_t bits;                  /* capacity = 1 << bits, zero if nothing allocated yet */
+    uint64_t used;
+    INSDC_coord_zero next_sweep;    /* the walk-position that triggers the next eviction-sweep */
+    INSDC_coord_zero min_mate_pos;  /* no entry has a mate before this position */
+
+    uint64_t dist_hist[ 32 ];       /* log2-histogram of the distances between mates */
+    uint64_t dist_count;
+    uint32_t max_dist;              /* mates farther apart are not cached */
+    uint32_t min_max_dist;          /* max_dist never goes below this ( --mate-cache-min-dist ) */
+} mate_table;
+
+
 typedef struct matecache_per_file
 {
-    KVector *same_ref_64;   /* ref-pos and ref-idx */
-    KVector *same_ref_16;   /* flags */
+    mate_table same_ref;            /* ref-pos, tlen, flags, mate-pos */
 
     KVector *unaligned_64_a;  /* ref-pos and ref-idx */
     KVector *unaligned_64_b;  /* seq_spot_id */
@@ -61,6 +85,9 @@ typedef struct matecache_per_file
     matecache_stat stat_same_ref;
     matecache_stat stat_unaligned;
     uint64_t maxcount_same_ref;
+    uint64_t evicted_same_ref;      /* removed by a sweep, the mate was never seen */
+    uint64_t too_far_same_ref;      /* not inserted, because mate too far away */
+    uint64_t maxbytes_same_ref;     /* largest footprint of the table */
 } matecache_per_file;
 
 
@@ -69,12 +96,15 @@ typedef struct matecache
     matecache_per_file *per_file;
     uint32_t count;
     uint32_t flashes;
+    uint32_t min_dist;
 } matecache;
 
 
 /* general cache functions */
 
-rc_t make_matecache( matecache **self, uint32_t count );
+/* min_dist: mates closer than this ( in bases ) are always cached, farther ones only if
+   the observed distances are larger */
+rc_t make_matecache( matecache **self, uint32_t count, uint32_t min_dist );
 
 void release_matecache( matecache * const self );
 
@@ -82,11 +112,21 @@ rc_t matecache_clear_same_ref( matecache * const self );
 
 rc_t matecache_report( const matecache * const self );
 
+/* moves the unaligned entries and the statistic of other into self
+   ( other was filled by a worker-thread, see sam-aligned.c ) */
+rc_t matecache_merge( matecache * const self, const matecache * const other );
+
 
 /* cache functions for aligned mates on the same reference */
 
+/*
+    key      ... row-id of the alignment
+    ref_pos  ... position of the alignment = the current walk-position
+    mate_pos ... position of the mate, the entry is evicted after the walk passed it
+*/
 rc_t matecache_insert_same_ref( matecache * const self,
-        uint32_t db_idx, int64_t key, INSDC_coord_zero ref_pos, uint32_t flags, INSDC_coord_len tlen );
+        uint32_t db_idx, int64_t key, INSDC_coord_zero ref_pos, uint32_t flags, INSDC_coord_len tlen,
+        INSDC_coord_zero mate_pos );
 
 rc_t matecache_lookup_same_ref( const matecache * const self, uint32_t db_idx, int64_t key,
                        INSDC_coord_zero *ref_pos, uint32_t *flags, INSDC_coord_len *tlen );
@@ -24,9 +24,6 @@
 *
 */
 
-#include <klib/printf.h>
-#include <klib/out.h>
-
 #include <os-native.h>
 #include <sysalloc.h>
 #include <ctype.h>
@@ -157,14 +154,14 @@ void free_cigar_t( struct cigar_t * c )
 }
 
 
-static rc_t kout_delete( int count, int *match_count,
-						 const uint8_t * ref, const INSDC_coord_len ref_len, int *ref_idx )
+static rc_t md_delete( sam_line * line, int count, int *match_count,
+						const uint8_t * ref, const INSDC_coord_len ref_len, int *ref_idx )
 {
 	rc_t rc = 0;
 	
 	if ( *match_count > 0 )
 	{
-		rc = KOutMsg( "%d", *match_count );
+		rc = sam_line_u64( line, *match_count );
 		*match_count = 0;
 	}
 	
@@ -172,7 +169,9 @@ static rc_t kout_delete( int count, int *match_count,
 	{
 		if ( ( *ref_idx + count ) < ref_len )
 		{
-			rc = KOutMsg( "^%.*s", count, &(ref[ *ref_idx ] ) );
+			rc = sam_line_char( line, '^' );
+			if ( rc == 0 )
+				rc = sam_line_str( line, ( const char * )&( ref[ *ref_idx ] ), count );
 			(*ref_idx) += count;
 		}
 		else
@@ -182,9 +181,9 @@ static rc_t kout_delete( int count, int *match_count,
 }
 
 
-static rc_t kout_match( int count, int *match_count,
-						const char * read, size_t read_len, int *read_idx,
-						const uint8_t *ref, const INSDC_coord_len ref_len, int *ref_idx )
+static rc_t md_match( sam_line * line, int count, int *match_count,
+					   const char * read, size_t read_len, int *read_idx,
+					   const uint8_t *ref, const INSDC_coord_len ref_len, int *ref_idx )
 {
 	rc_t rc = 0;
 	int i;
@@ -198,7 +197,9 @@ static rc_t kout_match( int count, int *match_count,
 			}
 			else
 			{
-				rc = KOutMsg( "%d%c", *match_count, ref[ *ref_idx ] );
+				rc = sam_line_u64( line, *match_count );
+				if ( rc == 0 )
+					rc = sam_line_char( line, ( char )ref[ *ref_idx ] );
 				*match_count = 0;
 			}
 			(*ref_idx)++;
@@ -210,37 +211,34 @@ static rc_t kout_match( int count, int *match_count,
 }
 
 
-static rc_t kout_tag( const struct cigar_t * c,
-					  const char * read,
-					  const size_t read_len,
-					  const uint8_t * ref,
-					  const INSDC_coord_len ref_len )
+static rc_t md_tag( sam_line * line,
+					const struct cigar_t * c,
+					const char * read,
+					const size_t read_len,
+					const uint8_t * ref,
+					const INSDC_coord_len ref_len )
 {
 	rc_t rc = 0;
 	if ( c != NULL && read != NULL && read_len > 0 && ref != NULL && ref_len > 0 )
 	{
-		rc = KOutMsg( "\tMD:Z:" );
-		if ( rc == 0 )
+		int read_idx = 0;
+		int ref_idx = 0;
+		int match_count = 0;
+		int cigar_idx;
+		for ( cigar_idx = 0; cigar_idx < c->length && rc == 0; ++cigar_idx )
 		{
-			int read_idx = 0;
-			int ref_idx = 0;
-			int match_count = 0;
-			int cigar_idx;
-			for ( cigar_idx = 0; cigar_idx < c->length && rc == 0; ++cigar_idx )
+			int count = c->count[ cigar_idx ];
+			switch ( c->op[ cigar_idx ] )
 			{
-				int count = c->count[ cigar_idx ];
-				switch ( c->op[ cigar_idx ] )
-				{
-					case 'D' : rc = kout_delete( count, &match_count, ref, ref_len, &ref_idx ); break;
-					
-					case 'I' : read_idx += count; break;
+				case 'D' : rc = md_delete( line, count, &match_count, ref, ref_len, &ref_idx ); break;
+				
+				case 'I' : read_idx += count; break;
 
-					case 'M' : rc = kout_match( count, &match_count, read, read_len, &read_idx, ref, ref_len, &ref_idx ); break;
-				}
+				case 'M' : rc = md_match( line, count, &match_count, read, read_len, &read_idx, ref, ref_len, &ref_idx ); break;
 			}
-			if ( rc == 0 && match_count > 0 )
-				rc = KOutMsg( "%d", match_count );
 		}
+		if ( rc == 0 && match_count > 0 )
+			rc = sam_line_u64( line, match_count );
 	}
 	else
 		rc = RC( rcExe, rcNoTarg, rcAllocating, rcParam, rcIncomplete );
@@ -248,12 +246,13 @@ static rc_t kout_tag( const struct cigar_t * c,
 }
 
 
-rc_t kout_md_tag_from_cigar_string( const char * cigar_str,
-									const size_t cigar_len,
-									const char * read,
-									const size_t read_len,
-									const uint8_t * ref,
-									const INSDC_coord_len ref_len )
+rc_t md_tag_from_cigar_string( sam_line * line,
+							   const char * cigar_str,
+							   const size_t cigar_len,
+							   const char * read,
+							   const size_t read_len,
+							   const uint8_t * ref,
+							   const INSDC_coord_len ref_len )
 {
 	rc_t rc = 0;
 	struct cigar_t * cigar = make_cigar_t( cigar_str, cigar_len );
@@ -261,7 +260,7 @@ rc_t kout_md_tag_from_cigar_string( const char * cigar_str,
 		rc = RC( rcExe, rcNoTarg, rcAllocating, rcItem, rcIncomplete );
 	else
 	{
-		rc = kout_tag( cigar, read, read_len, ref, ref_len );
+		rc = md_tag( line, cigar, read, read_len, ref, ref_len );
 		free_cigar_t( cigar );
 	}
 	return rc;
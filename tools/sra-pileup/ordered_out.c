@@ -0,0 +1,439 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "ordered_out.h"
+
+#include <klib/log.h>
+#include <klib/out.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined( _MSC_VER )
+#define THREAD_LOCAL __declspec( thread )
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef struct out_chunk
+{
+    struct out_chunk * next;
+    size_t used;
+    char data[ 1 ];
+} out_chunk;
+
+
+typedef struct out_job
+{
+    out_chunk * head;       /* complete chunks, waiting for the merger */
+    out_chunk * tail;
+    out_chunk * fill;       /* the chunk the worker fills, not seen by the merger */
+    out_chunk * lead;       /* ordered_out_lead(), written by the merger in front of the chunks */
+    uint32_t queued;
+    bool done;
+    bool has_output;        /* the worker has written or led, seen only by the worker */
+} out_job;
+
+
+typedef struct ordered_out
+{
+    KLock * lock;
+    KCondition * cond;      /* signals: chunk queued, chunk written, job done, abort */
+    out_job * jobs;
+    uint32_t job_count;
+    uint32_t next_job;
+    size_t chunk_size;
+    uint32_t max_queued;
+    rc_t rc;                /* the first error of a worker */
+    bool abort;
+    out_chunk * last_lead;  /* the lead the merger has written last */
+
+    KWrtWriter org_writer;  /* the KOut-handler before ordered_out_capture() */
+    void * org_data;
+    bool captured;
+} ordered_out;
+
+
+/* the job the calling thread writes into via KOutMsg() */
+static THREAD_LOCAL ordered_out * thread_out = NULL;
+static THREAD_LOCAL uint32_t thread_job = 0;
+
+
+static void free_chunks( out_chunk * c )
+{
+    while ( c != NULL )
+    {
+        out_chunk * next = c->next;
+        free( c );
+        c = next;
+    }
+}
+
+
+rc_t make_ordered_out( struct ordered_out ** self, uint32_t job_count, size_t chunk_size, uint32_t max_queued )
+{
+    rc_t rc = 0;
+    ordered_out * o = calloc( 1, sizeof *o );
+    *self = NULL;
+    if ( o == NULL )
+        rc = RC( rcExe, rcQueue, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        o->job_count = job_count;
+        o->chunk_size = chunk_size;
+        o->max_queued = ( max_queued == 0 ) ? 1 : max_queued;
+        o->jobs = calloc( job_count + 1, sizeof o->jobs[ 0 ] );
+        if ( o->jobs == NULL )
+            rc = RC( rcExe, rcQueue, rcConstructing, rcMemory, rcExhausted );
+        if ( rc == 0 )
+            rc = KLockMake( &o->lock );
+        if ( rc == 0 )
+            rc = KConditionMake( &o->cond );
+        if ( rc == 0 )
+            *self = o;
+        else
+        {
+            LOGERR( klogErr, rc, "cannot create ordered output" );
+            release_ordered_out( o );
+        }
+    }
+    return rc;
+}
+
+
+void release_ordered_out( struct ordered_out * self )
+{
+    if ( self != NULL )
+    {
+        if ( self->captured )
+            KOutHandlerSet( self->org_writer, self->org_data );
+        if ( self->jobs != NULL )
+        {
+            uint32_t i;
+            for ( i = 0; i < self->job_count; ++i )
+            {
+                free_chunks( self->jobs[ i ].head );
+                free( self->jobs[ i ].fill );
+                free( self->jobs[ i ].lead );
+            }
+            free( self->jobs );
+        }
+        free( self->last_lead );
+        KConditionRelease( self->cond );
+        KLockRelease( self->lock );
+        free( self );
+    }
+}
+
+
+bool ordered_out_next_job( struct ordered_out * self, uint32_t * job )
+{
+    bool res = false;
+    KLockAcquire( self->lock );
+    if ( !self->abort && self->next_job < self->job_count )
+    {
+        *job = self->next_job++;
+        res = true;
+    }
+    KLockUnlock( self->lock );
+    return res;
+}
+
+
+/* hands the fill-chunk of the job to the merger, waits if too many chunks are queued */
+static rc_t queue_fill( ordered_out * self, out_job * j )
+{
+    rc_t rc = 0;
+    out_chunk * c = j->fill;
+    j->fill = NULL;
+
+    KLockAcquire( self->lock );
+    while ( !self->abort && j->queued >= self->max_queued )
+        KConditionWait( self->cond, self->lock );
+    if ( self->abort )
+    {
+        rc = RC( rcExe, rcQueue, rcInserting, rcTransfer, rcCanceled );
+        free( c );
+    }
+    else
+    {
+        if ( j->tail == NULL )
+            j->head = c;
+        else
+            j->tail->next = c;
+        j->tail = c;
+        j->queued++;
+        KConditionBroadcast( self->cond );
+    }
+    KLockUnlock( self->lock );
+    return rc;
+}
+
+
+rc_t ordered_out_write( struct ordered_out * self, uint32_t job, const char * buffer, size_t size )
+{
+    rc_t rc = 0;
+    out_job * j = &self->jobs[ job ];
+    if ( size > 0 )
+        j->has_output = true;
+    while ( rc == 0 && size > 0 )
+    {
+        size_t to_copy;
+        if ( j->fill == NULL )
+        {
+            j->fill = malloc( sizeof *j->fill + self->chunk_size );
+            if ( j->fill == NULL )
+            {
+                rc = RC( rcExe, rcQueue, rcInserting, rcMemory, rcExhausted );
+                break;
+            }
+            j->fill->next = NULL;
+            j->fill->used = 0;
+        }
+        to_copy = self->chunk_size - j->fill->used;
+        if ( to_copy > size )
+            to_copy = size;
+        memmove( j->fill->data + j->fill->used, buffer, to_copy );
+        j->fill->used += to_copy;
+        buffer += to_copy;
+        size -= to_copy;
+        if ( j->fill->used == self->chunk_size )
+            rc = queue_fill( self, j );
+    }
+    return rc;
+}
+
+
+static void set_abort( ordered_out * self, rc_t rc )
+{
+    if ( !self->abort )
+    {
+        self->rc = rc;
+        self->abort = true;
+    }
+}
+
+
+rc_t ordered_out_job_done( struct ordered_out * self, uint32_t job, rc_t rc )
+{
+    out_job * j = &self->jobs[ job ];
+    if ( rc == 0 && j->fill != NULL && j->fill->used > 0 )
+        rc = queue_fill( self, j );
+
+    KLockAcquire( self->lock );
+    j->done = true;
+    if ( rc != 0 )
+        set_abort( self, rc );
+    KConditionBroadcast( self->cond );
+    KLockUnlock( self->lock );
+    return rc;
+}
+
+
+void ordered_out_abort( struct ordered_out * self, rc_t rc )
+{
+    KLockAcquire( self->lock );
+    set_abort( self, rc );
+    KConditionBroadcast( self->cond );
+    KLockUnlock( self->lock );
+}
+
+
+static rc_t write_chunk( const ordered_out * self, const out_chunk * c )
+{
+    KWrtWriter writer = self->captured ? self->org_writer : KOutWriterGet();
+    void * data = self->captured ? self->org_data : KOutDataGet();
+    size_t written = 0;
+    rc_t rc = 0;
+    while ( rc == 0 && written < c->used )
+    {
+        size_t num_writ = 0;
+        rc = writer( data, c->data + written, c->used - written, &num_writ );
+        if ( rc == 0 && num_writ == 0 )
+            rc = RC( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+        written += num_writ;
+    }
+    return rc;
+}
+
+
+/* the lead of a job is written only if it differs from the last one, the merger keeps that */
+static rc_t write_lead( ordered_out * self, out_chunk * lead )
+{
+    rc_t rc = 0;
+    if ( self->last_lead != NULL &&
+         self->last_lead->used == lead->used &&
+         memcmp( self->last_lead->data, lead->data, lead->used ) == 0 )
+        free( lead );
+    else
+    {
+        rc = write_chunk( self, lead );
+        free( self->last_lead );
+        self->last_lead = lead;
+    }
+    return rc;
+}
+
+
+rc_t ordered_out_merge( struct ordered_out * self )
+{
+    rc_t rc = 0;
+    uint32_t i;
+    for ( i = 0; rc == 0 && i < self->job_count; ++i )
+    {
+        out_job * j = &self->jobs[ i ];
+        bool job_done = false;
+        while ( rc == 0 && !job_done )
+        {
+            out_chunk * c = NULL;
+            out_chunk * lead = NULL;
+
+            KLockAcquire( self->lock );
+            while ( !self->abort && j->head == NULL && !j->done )
+                KConditionWait( self->cond, self->lock );
+            /* the lead is set before the first chunk of the job is queued */
+            lead = j->lead;
+            j->lead = NULL;
+            if ( self->abort )
+                rc = ( self->rc != 0 ) ? self->rc : RC( rcExe, rcQueue, rcReading, rcTransfer, rcCanceled );
+            else if ( j->head != NULL )
+            {
+                c = j->head;
+                j->head = c->next;
+                if ( j->head == NULL )
+                    j->tail = NULL;
+                j->queued--;
+                KConditionBroadcast( self->cond );
+            }
+            else
+                job_done = true;
+            KLockUnlock( self->lock );
+
+            if ( lead != NULL )
+            {
+                if ( rc == 0 )
+                {
+                    rc = write_lead( self, lead );
+                    if ( rc != 0 )
+                        ordered_out_abort( self, rc );
+                }
+                else
+                    free( lead );
+            }
+            if ( rc == 0 && c != NULL )
+            {
+                rc = write_chunk( self, c );
+                free( c );
+                if ( rc != 0 )
+                    ordered_out_abort( self, rc );
+            }
+        }
+    }
+    return rc;
+}
+
+
+static rc_t CC ordered_out_callback( void * self, const char * buffer, size_t size, size_t * num_writ )
+{
+    ordered_out * o = self;
+    rc_t rc;
+    if ( thread_out == o )
+    {
+        rc = ordered_out_write( o, thread_job, buffer, size );
+        *num_writ = ( rc == 0 ) ? size : 0;
+    }
+    else
+        rc = o->org_writer( o->org_data, buffer, size, num_writ );
+    return rc;
+}
+
+
+rc_t ordered_out_capture( struct ordered_out * self )
+{
+    rc_t rc = 0;
+    if ( !self->captured )
+    {
+        self->org_writer = KOutWriterGet();
+        self->org_data = KOutDataGet();
+        rc = KOutHandlerSet( ordered_out_callback, self );
+        if ( rc != 0 )
+            LOGERR( klogInt, rc, "KOutHandlerSet() failed" );
+        else
+            self->captured = true;
+    }
+    return rc;
+}
+
+
+void ordered_out_set_thread_job( struct ordered_out * self, uint32_t job )
+{
+    thread_out = self;
+    thread_job = job;
+}
+
+
+rc_t ordered_out_lead( const char * buffer, size_t size )
+{
+    rc_t rc = 0;
+    ordered_out * o = thread_out;
+    out_job * j = ( o != NULL ) ? &o->jobs[ thread_job ] : NULL;
+
+    if ( j == NULL || j->has_output )
+    {
+        /* no job, or the job has produced output already: this is ordinary output */
+        KWrtWriter writer = KOutWriterGet();
+        void * data = KOutDataGet();
+        size_t written = 0;
+        while ( rc == 0 && written < size )
+        {
+            size_t num_writ = 0;
+            rc = writer( data, buffer + written, size - written, &num_writ );
+            if ( rc == 0 && num_writ == 0 )
+                rc = RC( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+            written += num_writ;
+        }
+    }
+    else
+    {
+        out_chunk * lead = malloc( sizeof *lead + size );
+        if ( lead == NULL )
+            rc = RC( rcExe, rcQueue, rcInserting, rcMemory, rcExhausted );
+        else
+        {
+            lead->next = NULL;
+            lead->used = size;
+            memmove( lead->data, buffer, size );
+            j->has_output = true;
+            KLockAcquire( o->lock );
+            j->lead = lead;
+            KLockUnlock( o->lock );
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,91 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+#ifndef _h_ordered_out_
+#define _h_ordered_out_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+#include <klib/rc.h>
+
+/* ---------------------------------------------------------------------------------------------
+    ordered-out lets a pool of worker-threads produce the output of numbered jobs concurrently,
+    while the output is written in the order of the job-numbers:
+
+    - the workers ask for the next job ( ordered_out_next_job ), write the output of the job
+      in arbitrary pieces ( ordered_out_write ) and finish it ( ordered_out_job_done )
+    - the merger ( ordered_out_merge, on the thread that owns the output ) writes the queued
+      output of job #0 until it is done, then job #1 ...
+
+    The output of a job is collected in chunks, a worker blocks if more than max_queued chunks
+    of its job are waiting for the merger. That limits how far the workers can run ahead.
+
+    ordered_out_capture() installs a KOut-handler, that sends everything a worker prints via
+    KOutMsg() into the job the worker has selected with ordered_out_set_thread_job(). Output of
+    other threads ( and the merger ) goes to the original KOut-handler, which is restored by
+    release_ordered_out().
+--------------------------------------------------------------------------------------------- */
+
+struct ordered_out;
+
+rc_t make_ordered_out( struct ordered_out ** self, uint32_t job_count, size_t chunk_size, uint32_t max_queued );
+
+void release_ordered_out( struct ordered_out * self );
+
+/* returns false if there are no more jobs or the output has been aborted */
+bool ordered_out_next_job( struct ordered_out * self, uint32_t * job );
+
+rc_t ordered_out_write( struct ordered_out * self, uint32_t job, const char * buffer, size_t size );
+
+/* rc != 0 aborts all other jobs */
+rc_t ordered_out_job_done( struct ordered_out * self, uint32_t job, rc_t rc );
+
+/* for a worker, that fails outside of a job */
+void ordered_out_abort( struct ordered_out * self, rc_t rc );
+
+/* writes the output of all jobs through the current KOut-writer, returns the first error */
+rc_t ordered_out_merge( struct ordered_out * self );
+
+rc_t ordered_out_capture( struct ordered_out * self );
+
+/* self == NULL: KOutMsg() of the calling thread goes to the original KOut-handler again */
+void ordered_out_set_thread_job( struct ordered_out * self, uint32_t job );
+
+/* announces what the job of the calling thread produces ( the reference of a binary pileup ):
+   the merger writes the lead in front of the output of the job, but not if it is the same as
+   the last lead it has written, adjacent jobs on the same reference announce it once.
+   Without a job, or after the job has produced output, the lead is ordinary output. */
+rc_t ordered_out_lead( const char * buffer, size_t size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
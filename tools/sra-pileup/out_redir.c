@@ -42,10 +42,18 @@ static rc_t CC out_redir_callback( void * self, const char * buffer, size_t bufs
 }
 
 
-rc_t init_out_redir( out_redir * self, enum out_redir_mode mode, const char * filename, size_t bufsize )
+static rc_t CC out_redir_bam_callback( void * self, const char * buffer, size_t bufsize, size_t * num_writ )
+{
+    out_redir * redir = ( out_redir * )self;
+    rc_t rc = bam_out_write( redir->bam, buffer, bufsize ); /* bam_out.c */
+    *num_writ = ( rc == 0 ) ? bufsize : 0;
+    return rc;
+}
+
+
+static rc_t open_output_file( KFile ** output_file, enum out_redir_mode mode, const char * filename, size_t bufsize )
 {
     rc_t rc;
-    KFile *output_file;
 
     if ( filename != NULL )
     {
@@ -55,12 +63,12 @@ rc_t init_out_redir( out_redir * self, enum out_redir_mode mode, const char * fi
             LOGERR( klogInt, rc, "KDirectoryNativeDir() failed" );
         else
         {
-            rc = KDirectoryCreateFile ( dir, &output_file, false, 0664, kcmInit, "%s", filename );
+            rc = KDirectoryCreateFile ( dir, output_file, false, 0664, kcmInit, "%s", filename );
             KDirectoryRelease( dir );
         }
     }
     else
-        rc = KFileMakeStdOut ( &output_file );
+        rc = KFileMakeStdOut ( output_file );
 
     if ( rc == 0 )
     {
@@ -69,47 +77,96 @@ rc_t init_out_redir( out_redir * self, enum out_redir_mode mode, const char * fi
         /* wrap the output-file in compression, if requested */
         switch ( mode )
         {
-            case orm_gzip  : rc = KFileMakeGzipForWrite( &temp_file, output_file ); break;
-            case orm_bzip2 : rc = KFileMakeBzip2ForWrite( &temp_file, output_file ); break;
+            case orm_gzip  : rc = KFileMakeGzipForWrite( &temp_file, *output_file ); break;
+            case orm_bzip2 : rc = KFileMakeBzip2ForWrite( &temp_file, *output_file ); break;
             case orm_uncompressed : break;
         }
         if ( rc == 0 )
         {
             if ( mode != orm_uncompressed )
             {
-                KFileRelease( output_file );
-                output_file = temp_file;
+                KFileRelease( *output_file );
+                *output_file = temp_file;
             }
 
             /* wrap the output/compressed-file in buffering, if requested */
             if ( bufsize != 0 )
             {
-                rc = KBufFileMakeWrite( &temp_file, output_file, false, bufsize );
+                rc = KBufFileMakeWrite( &temp_file, *output_file, false, bufsize );
                 if ( rc == 0 )
                 {
-                    KFileRelease( output_file );
-                    output_file = temp_file;
+                    KFileRelease( *output_file );
+                    *output_file = temp_file;
                 }
             }
+        }
+        if ( rc != 0 )
+            KFileRelease( *output_file );
+    }
+    return rc;
+}
 
-            if ( rc == 0 )
-            {
-                self->kfile = output_file;
-                self->org_writer = KOutWriterGet();
-                self->org_data = KOutDataGet();
-                self->pos = 0;
-                rc = KOutHandlerSet( out_redir_callback, self );
-                if ( rc != 0 )
-                    LOGERR( klogInt, rc, "KOutHandlerSet() failed" );
-            }
+
+rc_t init_out_redir( out_redir * self, enum out_redir_mode mode, const char * filename, size_t bufsize )
+{
+    KFile *output_file;
+    rc_t rc = open_output_file( &output_file, mode, filename, bufsize );
+    if ( rc == 0 )
+    {
+        self->kfile = output_file;
+        self->org_writer = KOutWriterGet();
+        self->org_data = KOutDataGet();
+        self->pos = 0;
+        self->bam = NULL;
+        rc = KOutHandlerSet( out_redir_callback, self );
+        if ( rc != 0 )
+            LOGERR( klogInt, rc, "KOutHandlerSet() failed" );
+    }
+    return rc;
+}
+
+
+rc_t init_out_redir_bam( out_redir * self, const char * filename, size_t bufsize,
+                         uint32_t threads, enum bam_out_index index_type, const char * index_path )
+{
+    KFile *output_file;
+    rc_t rc = open_output_file( &output_file, orm_uncompressed, filename, bufsize );
+    if ( rc == 0 )
+    {
+        self->kfile = output_file;
+        self->org_writer = KOutWriterGet();
+        self->org_data = KOutDataGet();
+        self->pos = 0;
+        rc = make_bam_out( &self->bam, output_file, threads, index_type, index_path ); /* bam_out.c */
+        if ( rc != 0 )
+        {
+            LOGERR( klogErr, rc, "cannot create BAM-encoder" );
+            KFileRelease( output_file );
+        }
+        else
+        {
+            rc = KOutHandlerSet( out_redir_bam_callback, self );
+            if ( rc != 0 )
+                LOGERR( klogInt, rc, "KOutHandlerSet() failed" );
         }
     }
     return rc;
 }
 
 
+rc_t finish_out_redir( out_redir * self )
+{
+    rc_t rc = 0;
+    if ( self->bam != NULL )
+        rc = bam_out_finish( self->bam ); /* bam_out.c */
+    return rc;
+}
+
+
 void release_out_redir( out_redir * self )
 {
+    release_bam_out( self->bam ); /* bam_out.c */
+    self->bam = NULL;
     KFileRelease( self->kfile );
     if( self->org_writer != NULL )
     {
@@ -39,6 +39,8 @@ extern "C" {
 
 #include <kfs/file.h>
 
+#include "bam_out.h"
+
 enum out_redir_mode
 {
     orm_uncompressed = 0,
@@ -54,11 +56,20 @@ typedef struct out_redir
     void* org_data;
     KFile* kfile;
     uint64_t pos;
+    struct bam_out * bam;   /* writes BAM, if not NULL */
 } out_redir;
 
 
 rc_t init_out_redir( out_redir * self, enum out_redir_mode mode, const char * filename, size_t bufsize );
 
+/* the header-text and the BAM-records ( bam_rec ) written via the KOut-handler are compressed as BAM
+   ( bam_out.c ), optionally indexed */
+rc_t init_out_redir_bam( out_redir * self, const char * filename, size_t bufsize,
+                         uint32_t threads, enum bam_out_index index_type, const char * index_path );
+
+/* completes the output ( BAM: EOF-marker and index ), call before release_out_redir() */
+rc_t finish_out_redir( out_redir * self );
+
 void release_out_redir( out_redir * self );
 
 #endif
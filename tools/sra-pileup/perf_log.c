@@ -270,4 +270,15 @@ void perf_log_line( struct perf_log * pl, uint64_t pos )
             pl->chunk_start = chunk_end;
         }
     }
-}
\ No newline at end of file
+}
+
+
+void perf_log_rate( struct perf_log * pl, const char * what, uint64_t count, uint64_t ms )
+{
+    if ( pl != NULL )
+    {
+        uint64_t per_sec = ( ms > 0 ) ? ( count * 1000 ) / ms : count * 1000;
+        perf_log_write( pl, "<%s> %lu in %lu ms, per second = %lu\n",
+                        value_or_unknown( what ), count, ms, per_sec );
+    }
+}
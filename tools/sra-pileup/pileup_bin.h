@@ -0,0 +1,98 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_pileup_bin_
+#define _h_pileup_bin_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* ---------------------------------------------------------------------------------------------
+    the binary pileup-format ( sra-pileup --function binary ), read by pileup_bin_reader.c
+
+    The header ( pileup_bin_header ) is written in the byte-order of the writer, the reader
+    detects it with the byte_order-field. It is followed by records, each starting with a
+    type-byte. The numbers in the records are varints ( 7 bits per byte, lowest group first,
+    the high bit is set if more bytes follow ), they do not depend on the byte-order.
+
+      PILEUP_BIN_REFERENCE: varint length of the name ( max. PILEUP_BIN_MAX_NAME ), the name.
+            The following segments belong to this reference. It is announced before its first
+            segment, a multi-threaded pileup produces the same bytes as a single-threaded one.
+
+      PILEUP_BIN_SEGMENT: varint 0-based position of the first value, varint number of
+            positions ( max. PILEUP_BIN_MAX_COUNT ), followed by column_count columns.
+            Each column is a varint byte-count and that many bytes of values:
+            a varint v << 1 is the value v, a varint ( n - 1 ) << 1 | 1 is a run of n zeros.
+            A reader can skip columns it does not know by the byte-count.
+
+    Positions without coverage are not written: they are the gaps between the segments.
+--------------------------------------------------------------------------------------------- */
+
+#define PILEUP_BIN_MAGIC        "SRAPILEB"
+#define PILEUP_BIN_BYTE_ORDER   0x01020304
+#define PILEUP_BIN_VERSION      2
+
+#define PILEUP_BIN_MAX_NAME     ( 64 * 1024 )
+#define PILEUP_BIN_MAX_COUNT    ( 64 * 1024 )
+#define PILEUP_BIN_MAX_COLUMNS  256
+#define PILEUP_BIN_MAX_VARINT   5       /* bytes of a value: 32 bits shifted by one */
+
+#define PILEUP_BIN_REFERENCE    0x52    /* 'R' */
+#define PILEUP_BIN_SEGMENT      0x53    /* 'S' */
+
+/* the columns of a segment, in this order */
+enum pileup_bin_column
+{
+    pbin_depth = 0,     /* coverage */
+    pbin_matches,       /* bases matching the reference */
+    pbin_A,             /* mismatches per base */
+    pbin_C,
+    pbin_G,
+    pbin_T,
+    pbin_deletes,       /* alignments with a deletion at this position */
+    pbin_inserts,       /* alignments with an insertion after this position */
+    pbin_forward,       /* alignments on the forward strand */
+    pbin_reverse,       /* alignments on the reverse strand */
+    pbin_column_count
+};
+
+typedef struct pileup_bin_header
+{
+    char magic[ 8 ];
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t column_count;
+    uint32_t reserved;
+} pileup_bin_header;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*  _h_pileup_bin_ */
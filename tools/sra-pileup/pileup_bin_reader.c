@@ -0,0 +1,359 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "pileup_bin_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct pileup_bin_reader
+{
+    FILE * f;
+    uint32_t column_count;      /* of the stream */
+    uint32_t * values;          /* of the current segment */
+    size_t values_allocated;
+    uint8_t * bytes;            /* one encoded column */
+    size_t bytes_allocated;
+    char ** ref_names;
+    uint32_t ref_count;
+    uint32_t ref_allocated;
+    uint32_t ref_id;            /* of the current reference */
+    int has_ref;
+} pileup_bin_reader;
+
+
+static uint32_t swap_u32( uint32_t v )
+{
+    return ( v >> 24 ) | ( ( v >> 8 ) & 0xFF00 ) | ( ( v << 8 ) & 0xFF0000 ) | ( v << 24 );
+}
+
+
+/* the end of the stream within a record is a format-error */
+static int read_bytes( pileup_bin_reader * self, void * dst, size_t len )
+{
+    if ( fread( dst, 1, len, self->f ) != len )
+        return ferror( self->f ) ? pbs_io_error : pbs_format_error;
+    return pbs_ok;
+}
+
+
+static int read_varint( pileup_bin_reader * self, uint32_t * value )
+{
+    uint64_t v = 0;
+    uint32_t shift;
+    for ( shift = 0; shift < 7 * PILEUP_BIN_MAX_VARINT; shift += 7 )
+    {
+        int c = getc( self->f );
+        if ( c == EOF )
+            return ferror( self->f ) ? pbs_io_error : pbs_format_error;
+        v |= ( uint64_t )( c & 0x7F ) << shift;
+        if ( ( c & 0x80 ) == 0 )
+        {
+            if ( v > 0xFFFFFFFF )
+                return pbs_format_error;
+            *value = ( uint32_t )v;
+            return pbs_ok;
+        }
+    }
+    return pbs_format_error;
+}
+
+
+static int decode_varint( const uint8_t ** src, const uint8_t * end, uint64_t * value )
+{
+    const uint8_t * p = *src;
+    uint64_t v = 0;
+    uint32_t shift;
+    for ( shift = 0; shift < 7 * PILEUP_BIN_MAX_VARINT && p < end; shift += 7 )
+    {
+        uint8_t c = *p++;
+        v |= ( uint64_t )( c & 0x7F ) << shift;
+        if ( ( c & 0x80 ) == 0 )
+        {
+            *src = p;
+            *value = v;
+            return pbs_ok;
+        }
+    }
+    return pbs_format_error;
+}
+
+
+int pileup_bin_open( struct pileup_bin_reader ** self, const char * path )
+{
+    int res = pbs_no_memory;
+    pileup_bin_reader * r = calloc( 1, sizeof *r );
+    *self = NULL;
+    if ( r != NULL )
+    {
+        pileup_bin_header hdr;
+
+        r->f = ( path == NULL ) ? stdin : fopen( path, "rb" );
+        if ( r->f == NULL )
+            res = pbs_io_error;
+        else if ( fread( &hdr, sizeof hdr, 1, r->f ) != 1 )
+            res = ferror( r->f ) ? pbs_io_error : pbs_format_error;
+        else if ( memcmp( hdr.magic, PILEUP_BIN_MAGIC, sizeof hdr.magic ) != 0 )
+            res = pbs_format_error;
+        else
+        {
+            res = pbs_ok;
+            if ( hdr.byte_order != PILEUP_BIN_BYTE_ORDER )
+            {
+                if ( swap_u32( hdr.byte_order ) != PILEUP_BIN_BYTE_ORDER )
+                    res = pbs_format_error;
+                else
+                {
+                    hdr.version = swap_u32( hdr.version );
+                    hdr.column_count = swap_u32( hdr.column_count );
+                }
+            }
+            if ( res == pbs_ok &&
+                 ( hdr.version != PILEUP_BIN_VERSION || hdr.column_count > PILEUP_BIN_MAX_COLUMNS ) )
+                res = pbs_format_error;
+            r->column_count = hdr.column_count;
+        }
+
+        if ( res == pbs_ok )
+            *self = r;
+        else
+            pileup_bin_close( r );
+    }
+    return res;
+}
+
+
+void pileup_bin_close( struct pileup_bin_reader * self )
+{
+    if ( self != NULL )
+    {
+        uint32_t i;
+        if ( self->f != NULL && self->f != stdin )
+            fclose( self->f );
+        for ( i = 0; i < self->ref_count; ++i )
+            free( self->ref_names[ i ] );
+        free( self->ref_names );
+        free( self->values );
+        free( self->bytes );
+        free( self );
+    }
+}
+
+
+/* the same reference is announced again by every slice of a multi-threaded pileup */
+static int enter_reference( pileup_bin_reader * self, const char * name )
+{
+    uint32_t i;
+
+    if ( self->has_ref && strcmp( self->ref_names[ self->ref_id ], name ) == 0 )
+        return pbs_ok;
+
+    for ( i = 0; i < self->ref_count; ++i )
+    {
+        if ( strcmp( self->ref_names[ i ], name ) == 0 )
+        {
+            self->ref_id = i;
+            self->has_ref = 1;
+            return pbs_ok;
+        }
+    }
+
+    if ( self->ref_count >= self->ref_allocated )
+    {
+        uint32_t allocated = ( self->ref_allocated == 0 ) ? 64 : self->ref_allocated * 2;
+        char ** names = realloc( self->ref_names, allocated * sizeof *names );
+        if ( names == NULL )
+            return pbs_no_memory;
+        self->ref_names = names;
+        self->ref_allocated = allocated;
+    }
+    self->ref_names[ self->ref_count ] = malloc( strlen( name ) + 1 );
+    if ( self->ref_names[ self->ref_count ] == NULL )
+        return pbs_no_memory;
+    strcpy( self->ref_names[ self->ref_count ], name );
+    self->ref_id = self->ref_count++;
+    self->has_ref = 1;
+    return pbs_ok;
+}
+
+
+static int read_reference( pileup_bin_reader * self )
+{
+    uint32_t len;
+    int res = read_varint( self, &len );
+    if ( res == pbs_ok && len > PILEUP_BIN_MAX_NAME )
+        res = pbs_format_error;
+    if ( res == pbs_ok )
+    {
+        char * name = malloc( len + 1 );
+        if ( name == NULL )
+            res = pbs_no_memory;
+        else
+        {
+            res = read_bytes( self, name, len );
+            if ( res == pbs_ok )
+            {
+                name[ len ] = 0;
+                res = enter_reference( self, name );
+            }
+            free( name );
+        }
+    }
+    return res;
+}
+
+
+/* the encoded column has to produce exactly count values */
+static int decode_column( const uint8_t * src, size_t len, uint32_t * dst, uint32_t count )
+{
+    const uint8_t * end = src + len;
+    uint32_t i = 0;
+    while ( src < end )
+    {
+        uint64_t v;
+        int res = decode_varint( &src, end, &v );
+        if ( res != pbs_ok )
+            return res;
+        if ( v & 1 )
+        {
+            uint64_t run = ( v >> 1 ) + 1;
+            if ( run > count - i )
+                return pbs_format_error;
+            memset( dst + i, 0, ( size_t )run * sizeof *dst );
+            i += ( uint32_t )run;
+        }
+        else
+        {
+            if ( i >= count || ( v >> 1 ) > 0xFFFFFFFF )
+                return pbs_format_error;
+            dst[ i++ ] = ( uint32_t )( v >> 1 );
+        }
+    }
+    return ( i == count ) ? pbs_ok : pbs_format_error;
+}
+
+
+static int read_segment( pileup_bin_reader * self, pileup_bin_segment * seg )
+{
+    uint32_t start, count, i;
+    size_t needed;
+    int res;
+
+    if ( !self->has_ref )
+        return pbs_format_error;
+
+    res = read_varint( self, &start );
+    if ( res == pbs_ok )
+        res = read_varint( self, &count );
+    if ( res == pbs_ok && count > PILEUP_BIN_MAX_COUNT )
+        res = pbs_format_error;
+    if ( res != pbs_ok )
+        return res;
+
+    /* only the columns known to this reader are kept */
+    needed = ( size_t )count * pbin_column_count;
+    if ( needed > self->values_allocated )
+    {
+        uint32_t * values = realloc( self->values, needed * sizeof *values );
+        if ( values == NULL )
+            return pbs_no_memory;
+        self->values = values;
+        self->values_allocated = needed;
+    }
+
+    for ( i = 0; i < self->column_count && res == pbs_ok; ++i )
+    {
+        uint32_t len;
+        res = read_varint( self, &len );
+        if ( res == pbs_ok && len > ( size_t )count * PILEUP_BIN_MAX_VARINT )
+            res = pbs_format_error;
+        if ( res == pbs_ok && len > self->bytes_allocated )
+        {
+            uint8_t * bytes = realloc( self->bytes, len );
+            if ( bytes == NULL )
+                res = pbs_no_memory;
+            else
+            {
+                self->bytes = bytes;
+                self->bytes_allocated = len;
+            }
+        }
+        if ( res == pbs_ok )
+            res = read_bytes( self, self->bytes, len );
+        if ( res == pbs_ok && i < pbin_column_count )
+            res = decode_column( self->bytes, len, self->values + ( ( size_t )i * count ), count );
+    }
+
+    if ( res == pbs_ok )
+    {
+        seg->ref_id = self->ref_id;
+        seg->ref_name = self->ref_names[ self->ref_id ];
+        seg->start = start;
+        seg->count = count;
+        for ( i = 0; i < pbin_column_count; ++i )
+            seg->column[ i ] = ( i < self->column_count ) ? self->values + ( ( size_t )i * count ) : NULL;
+    }
+    return res;
+}
+
+
+int pileup_bin_next( struct pileup_bin_reader * self, pileup_bin_segment * seg )
+{
+    while ( 1 )
+    {
+        int res;
+
+        /* a clean end is only possible between records */
+        int type = getc( self->f );
+        if ( type == EOF )
+            return ferror( self->f ) ? pbs_io_error : pbs_end;
+
+        switch( type )
+        {
+            case PILEUP_BIN_REFERENCE : res = read_reference( self );
+                                        if ( res != pbs_ok )
+                                            return res;
+                                        break;
+
+            case PILEUP_BIN_SEGMENT   : return read_segment( self, seg );
+
+            default                   : return pbs_format_error;
+        }
+    }
+}
+
+
+uint32_t pileup_bin_ref_count( const struct pileup_bin_reader * self )
+{
+    return self->ref_count;
+}
+
+
+const char * pileup_bin_ref_name( const struct pileup_bin_reader * self, uint32_t ref_id )
+{
+    return ( ref_id < self->ref_count ) ? self->ref_names[ ref_id ] : NULL;
+}
@@ -0,0 +1,89 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_pileup_bin_reader_
+#define _h_pileup_bin_reader_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "pileup_bin.h"
+
+/* ---------------------------------------------------------------------------------------------
+    reader for the binary pileup-format ( pileup_bin.h ), for tools processing the output of
+    sra-pileup --function binary. It depends only on the C-runtime ( libpileup-bin ).
+
+        struct pileup_bin_reader * r;
+        if ( pileup_bin_open( &r, "out.pileup" ) == pbs_ok )
+        {
+            pileup_bin_segment seg;
+            while ( pileup_bin_next( r, &seg ) == pbs_ok )
+            {
+                for ( i = 0; i < seg.count; ++i )
+                    use( seg.ref_name, seg.start + i, seg.column[ pbin_depth ][ i ] ... );
+            }
+            pileup_bin_close( r );
+        }
+--------------------------------------------------------------------------------------------- */
+
+enum pileup_bin_status
+{
+    pbs_ok = 0,
+    pbs_end,            /* no more segments */
+    pbs_io_error,
+    pbs_format_error,
+    pbs_no_memory
+};
+
+typedef struct pileup_bin_segment
+{
+    uint32_t ref_id;        /* 0-based, in the order of the first appearance of the reference */
+    const char * ref_name;
+    uint32_t start;         /* 0-based reference-position of the values at index #0 */
+    uint32_t count;         /* number of positions, each column has that many values */
+    const uint32_t * column[ pbin_column_count ];  /* NULL if the stream does not have the column */
+} pileup_bin_segment;
+
+struct pileup_bin_reader;
+
+/* path == NULL reads stdin */
+int pileup_bin_open( struct pileup_bin_reader ** self, const char * path );
+
+void pileup_bin_close( struct pileup_bin_reader * self );
+
+/* the values of the segment are valid until the next call */
+int pileup_bin_next( struct pileup_bin_reader * self, pileup_bin_segment * seg );
+
+/* the references seen so far */
+uint32_t pileup_bin_ref_count( const struct pileup_bin_reader * self );
+const char * pileup_bin_ref_name( const struct pileup_bin_reader * self, uint32_t ref_id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*  _h_pileup_bin_reader_ */
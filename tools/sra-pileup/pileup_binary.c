@@ -0,0 +1,237 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include <klib/out.h>
+#include <klib/text.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ref_walker_0.h"
+#include "pileup_block.h"
+#include "ordered_out.h"
+#include "pileup_bin.h"
+#include "dyn_string.h"
+#include "4na_ascii.h"
+
+rc_t write_pileup_bin_header( void )
+{
+    struct dyn_string * out;
+    rc_t rc = allocated_dyn_string( &out, 64 ); /* dyn_string.c */
+    if ( rc == 0 )
+    {
+        pileup_bin_header hdr;
+
+        memmove( hdr.magic, PILEUP_BIN_MAGIC, sizeof hdr.magic );
+        hdr.byte_order = PILEUP_BIN_BYTE_ORDER;
+        hdr.version = PILEUP_BIN_VERSION;
+        hdr.column_count = pbin_column_count;
+        hdr.reserved = 0;
+
+        rc = add_bytes_2_dyn_string( out, &hdr, sizeof hdr );
+        if ( rc == 0 )
+            rc = write_dyn_string( out );
+        free_dyn_string( out );
+    }
+    return rc;
+}
+
+
+/* =========================================================================================== */
+
+
+static uint32_t put_varint( uint8_t * dst, uint64_t value )
+{
+    uint32_t n = 0;
+    while ( value >= 0x80 )
+    {
+        dst[ n++ ] = ( uint8_t )( value | 0x80 );
+        value >>= 7;
+    }
+    dst[ n++ ] = ( uint8_t )value;
+    return n;
+}
+
+
+static rc_t add_varint( struct dyn_string * out, uint64_t value )
+{
+    uint8_t buf[ 10 ];
+    return add_bytes_2_dyn_string( out, buf, put_varint( buf, value ) );
+}
+
+
+/* written before the first segment of the block is added to out, so it can go out directly.
+   In a slice ( --threads ) it becomes the lead of the slice-job: the slices of one reference
+   announce it once, the output is the same as without threads */
+static rc_t write_reference( const char * ref_name )
+{
+    rc_t rc = 0;
+    uint32_t len = string_size( ref_name );
+    uint8_t * rec = malloc( 1 + PILEUP_BIN_MAX_VARINT + len );
+    if ( rec == NULL )
+        rc = RC( rcExe, rcNoTarg, rcWriting, rcMemory, rcExhausted );
+    else
+    {
+        uint32_t n = 0;
+        rec[ n++ ] = PILEUP_BIN_REFERENCE;
+        n += put_varint( rec + n, len );
+        memmove( rec + n, ref_name, len );
+        rc = ordered_out_lead( ( const char * )rec, n + len ); /* ordered_out.c */
+        free( rec );
+    }
+    return rc;
+}
+
+
+/* most columns are zero for long stretches ( mismatches, indels ), these become runs */
+static uint32_t encode_column( uint8_t * dst, const uint32_t * values, uint32_t count )
+{
+    uint32_t n = 0, i = 0;
+    while ( i < count )
+    {
+        if ( values[ i ] == 0 )
+        {
+            uint32_t run = 1;
+            while ( i + run < count && values[ i + run ] == 0 )
+                run++;
+            n += put_varint( dst + n, ( ( uint64_t )( run - 1 ) << 1 ) | 1 );
+            i += run;
+        }
+        else
+            n += put_varint( dst + n, ( uint64_t )values[ i++ ] << 1 );
+    }
+    return n;
+}
+
+
+/* the segment is written column by column, encoded from the arrays of the block */
+static rc_t write_segment( pileup_block * block, uint32_t first, uint32_t count )
+{
+    /* a segment never exceeds the block */
+    uint8_t encoded[ PILEUP_BLOCK_LEN * PILEUP_BIN_MAX_VARINT ];
+    const uint32_t * src[ pbin_column_count ];
+    uint32_t i;
+    rc_t rc;
+
+    src[ pbin_depth ]   = block->depth;
+    src[ pbin_matches ] = block->column[ pbc_matches ];
+    src[ pbin_A ]       = block->column[ pbc_base_A ];
+    src[ pbin_C ]       = block->column[ pbc_base_C ];
+    src[ pbin_G ]       = block->column[ pbc_base_G ];
+    src[ pbin_T ]       = block->column[ pbc_base_T ];
+    src[ pbin_deletes ] = block->column[ pbc_deletes ];
+    src[ pbin_inserts ] = block->column[ pbc_inserts ];
+    src[ pbin_forward ] = block->column[ pbc_forward ];
+    src[ pbin_reverse ] = block->column[ pbc_reverse ];
+
+    rc = add_char_2_dyn_string( block->out, PILEUP_BIN_SEGMENT );
+    if ( rc == 0 )
+        rc = add_varint( block->out, block->start + first );
+    if ( rc == 0 )
+        rc = add_varint( block->out, count );
+    for ( i = 0; i < pbin_column_count && rc == 0; ++i )
+    {
+        uint32_t len = encode_column( encoded, src[ i ] + first, count );
+        rc = add_varint( block->out, len );
+        if ( rc == 0 )
+            rc = add_bytes_2_dyn_string( block->out, encoded, len );
+    }
+    return rc;
+}
+
+
+/* every run of covered positions becomes a segment, the positions without coverage are left out */
+static rc_t CC print_binary( pileup_block * block, const pileup_options * options )
+{
+    rc_t rc = 0;
+    uint32_t slot = 0, used = block->used;
+    const uint32_t * depth = block->depth;
+
+    while ( slot < used && rc == 0 )
+    {
+        uint32_t first;
+
+        while ( slot < used && depth[ slot ] == 0 )
+            slot++;
+        first = slot;
+        while ( slot < used && depth[ slot ] > 0 )
+            slot++;
+
+        if ( slot > first )
+        {
+            if ( block->ref_entered )
+            {
+                rc = write_reference( block->ref_name );
+                block->ref_entered = false;
+            }
+            if ( rc == 0 )
+                rc = write_segment( block, first, slot - first );
+        }
+    }
+    return rc;
+}
+
+
+static rc_t CC walk_binary_placement( walk_data * data )
+{
+    int32_t state = data->state;
+    if ( ( state & align_iter_invalid ) != align_iter_invalid )
+    {
+        pileup_block * block = data->data;
+        uint32_t slot = block->slot;
+
+        if ( ( state & align_iter_skip ) == align_iter_skip )
+            block->column[ pbc_deletes ][ slot ]++;
+        else if ( ( state & align_iter_match ) == align_iter_match )
+            block->column[ pbc_matches ][ slot ]++;
+        else
+        {
+            switch( _4na_to_ascii( state, false ) )
+            {
+                case 'A' : block->column[ pbc_base_A ][ slot ]++; break;
+                case 'C' : block->column[ pbc_base_C ][ slot ]++; break;
+                case 'G' : block->column[ pbc_base_G ][ slot ]++; break;
+                case 'T' : block->column[ pbc_base_T ][ slot ]++; break;
+            }
+        }
+
+        if ( ( state & align_iter_insert ) == align_iter_insert )
+            block->column[ pbc_inserts ][ slot ]++;
+
+        if ( data->xrec->reverse )
+            block->column[ pbc_reverse ][ slot ]++;
+        else
+            block->column[ pbc_forward ][ slot ]++;
+    }
+    return 0;
+}
+
+
+rc_t walk_binary( ReferenceIterator *ref_iter, pileup_options * options )
+{
+    return walk_pileup_block( ref_iter, options, walk_binary_placement, print_binary ); /* pileup_block.c */
+}
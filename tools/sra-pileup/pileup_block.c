@@ -0,0 +1,303 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "pileup_block.h"
+#include "dyn_string.h"
+#include "4na_ascii.h"
+
+#include <klib/rc.h>
+#include <klib/out.h>
+
+static void clear_pileup_block( pileup_block * self )
+{
+    uint32_t i;
+
+    memset( self->visited, 0, self->used );
+    memset( self->ref_base, 0, self->used );
+    memset( self->depth, 0, self->used * sizeof self->depth[ 0 ] );
+    for ( i = 0; i < pbc_count; ++i )
+        memset( self->column[ i ], 0, self->used * sizeof self->column[ i ][ 0 ] );
+    for ( i = 0; i < pbf_count; ++i )
+    {
+        self->fragments[ i ].entries_used = 0;
+        self->fragments[ i ].bases_used = 0;
+        self->fragments[ i ].cursor = 0;
+    }
+    self->used = 0;
+}
+
+
+static rc_t init_pileup_block( pileup_block * self, pileup_block_print print )
+{
+    rc_t rc = 0;
+
+    memset( self, 0, sizeof *self );
+    self->print = print;
+
+    /* one allocation for all counter-arrays */
+    self->depth = calloc( ( pbc_count + 1 ) * PILEUP_BLOCK_LEN, sizeof self->depth[ 0 ] );
+    self->visited = calloc( 2, PILEUP_BLOCK_LEN );
+    if ( self->depth == NULL || self->visited == NULL )
+        rc = RC( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+    else
+    {
+        uint32_t i;
+        for ( i = 0; i < pbc_count; ++i )
+            self->column[ i ] = self->depth + ( ( i + 1 ) * PILEUP_BLOCK_LEN );
+        self->ref_base = self->visited + PILEUP_BLOCK_LEN;
+        rc = allocated_dyn_string( &self->out, 64 * 1024 ); /* dyn_string.c */
+    }
+    return rc;
+}
+
+
+static void release_pileup_block( pileup_block * self )
+{
+    uint32_t i;
+    for ( i = 0; i < pbf_count; ++i )
+    {
+        free( self->fragments[ i ].entries );
+        free( self->fragments[ i ].bases );
+    }
+    if ( self->out != NULL )
+        free_dyn_string( self->out );
+    free( self->visited );
+    free( self->depth );
+}
+
+
+static rc_t flush_pileup_block( pileup_block * self, const pileup_options * options )
+{
+    rc_t rc = 0;
+    if ( self->used > 0 )
+    {
+        reset_dyn_string( self->out );
+        rc = self->print( self, options );
+        if ( rc == 0 )
+            rc = write_dyn_string( self->out ); /* dyn_string.c */
+        clear_pileup_block( self );
+    }
+    return rc;
+}
+
+
+static rc_t CC pileup_block_enter_ref_pos( walk_data * data )
+{
+    pileup_block * self = data->data;
+    rc_t rc = 0;
+
+    if ( self->used > 0 &&
+         ( data->ref_name != self->ref_name ||
+           data->ref_pos < self->start ||
+           data->ref_pos >= self->start + PILEUP_BLOCK_LEN ) )
+    {
+        rc = flush_pileup_block( self, data->options );
+    }
+
+    if ( rc == 0 )
+    {
+        uint32_t slot;
+        if ( self->used == 0 )
+        {
+            self->ref_name = data->ref_name;
+            self->start = data->ref_pos;
+        }
+        slot = data->ref_pos - self->start;
+        self->slot = slot;
+        self->visited[ slot ] = 1;
+        self->ref_base[ slot ] = data->ref_base;
+        self->depth[ slot ] = data->depth;
+        if ( slot >= self->used )
+            self->used = slot + 1;
+    }
+    return rc;
+}
+
+
+static rc_t CC pileup_block_enter_ref( walk_data * data )
+{
+    pileup_block * self = data->data;
+    self->ref_entered = true;
+    return 0;
+}
+
+
+static rc_t CC pileup_block_exit_ref_window( walk_data * data )
+{
+    return flush_pileup_block( data->data, data->options );
+}
+
+
+rc_t walk_pileup_block( ReferenceIterator *ref_iter, pileup_options *options,
+                        rc_t ( CC * on_placement ) ( walk_data * data ),
+                        pileup_block_print print )
+{
+    pileup_block block;
+    rc_t rc = init_pileup_block( &block, print );
+    if ( rc == 0 )
+    {
+        walk_data data;
+        walk_funcs funcs;
+
+        data.ref_iter = ref_iter;
+        data.options = options;
+        data.data = &block;
+
+        funcs.on_enter_ref = pileup_block_enter_ref;
+        funcs.on_exit_ref = NULL;
+
+        funcs.on_enter_ref_window = NULL;
+        funcs.on_exit_ref_window = pileup_block_exit_ref_window;
+
+        funcs.on_enter_ref_pos = pileup_block_enter_ref_pos;
+        funcs.on_exit_ref_pos = NULL;
+
+        funcs.on_enter_spotgroup = NULL;
+        funcs.on_exit_spotgroup = NULL;
+
+        funcs.on_placement = on_placement;
+
+        rc = walk_0( &data, &funcs );
+        if ( rc == 0 )
+            rc = flush_pileup_block( &block, options );
+    }
+    release_pileup_block( &block );
+    return rc;
+}
+
+
+/* =========================================================================================== */
+
+
+static rc_t grow_fragments( pileup_fragments * self, uint32_t bases_needed )
+{
+    if ( self->entries_used >= self->entries_allocated )
+    {
+        uint32_t allocated = ( self->entries_allocated == 0 ) ? 256 : self->entries_allocated * 2;
+        pileup_fragment * entries = realloc( self->entries, allocated * sizeof *entries );
+        if ( entries == NULL )
+            return RC( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+        self->entries = entries;
+        self->entries_allocated = allocated;
+    }
+    if ( self->bases_used + bases_needed > self->bases_allocated )
+    {
+        uint32_t allocated = ( self->bases_allocated == 0 ) ? 4096 : self->bases_allocated * 2;
+        char * bases;
+        while ( self->bases_used + bases_needed > allocated )
+            allocated *= 2;
+        bases = realloc( self->bases, allocated );
+        if ( bases == NULL )
+            return RC( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+        self->bases = bases;
+        self->bases_allocated = allocated;
+    }
+    return 0;
+}
+
+
+rc_t pileup_block_count_fragment( pileup_block * self, uint32_t kind,
+                                  const INSDC_4na_bin * bases, uint32_t len )
+{
+    pileup_fragments * f = &self->fragments[ kind ];
+    rc_t rc = grow_fragments( f, len );
+    if ( rc == 0 )
+    {
+        /* the bases are converted behind the used part of the buffer, they stay there if new */
+        char * ascii = f->bases + f->bases_used;
+        uint32_t idx;
+
+        for ( idx = 0; idx < len; ++idx )
+            ascii[ idx ] = _4na_to_ascii( bases[ idx ], false );
+
+        /* the fragments of the current position are at the end of the list */
+        idx = f->entries_used;
+        while ( idx > 0 && f->entries[ idx - 1 ].slot == self->slot )
+        {
+            pileup_fragment * e = &f->entries[ --idx ];
+            if ( e->len == len && memcmp( f->bases + e->offset, ascii, len ) == 0 )
+            {
+                e->count++;
+                return 0;
+            }
+        }
+
+        f->entries[ f->entries_used ].slot = self->slot;
+        f->entries[ f->entries_used ].offset = f->bases_used;
+        f->entries[ f->entries_used ].len = len;
+        f->entries[ f->entries_used ].count = 1;
+        f->entries_used++;
+        f->bases_used += len;
+    }
+    return rc;
+}
+
+
+/* the order of string_cmp(): by bases, a prefix before the longer fragment */
+static int cmp_fragments( const pileup_fragments * f, const pileup_fragment * a, const pileup_fragment * b )
+{
+    int res = memcmp( f->bases + a->offset, f->bases + b->offset, ( a->len < b->len ) ? a->len : b->len );
+    if ( res == 0 )
+        res = ( a->len < b->len ) ? -1 : ( ( a->len > b->len ) ? 1 : 0 );
+    return res;
+}
+
+
+rc_t pileup_block_print_fragments( pileup_block * self, uint32_t kind, uint32_t slot )
+{
+    rc_t rc = 0;
+    pileup_fragments * f = &self->fragments[ kind ];
+    uint32_t first, end, idx;
+
+    /* skip fragments of slots, that were not printed */
+    while ( f->cursor < f->entries_used && f->entries[ f->cursor ].slot < slot )
+        f->cursor++;
+    first = end = f->cursor;
+    while ( end < f->entries_used && f->entries[ end ].slot == slot )
+        end++;
+
+    /* insertion-sort: there are only a few different fragments per position */
+    for ( idx = first + 1; idx < end; ++idx )
+    {
+        pileup_fragment e = f->entries[ idx ];
+        uint32_t j = idx;
+        while ( j > first && cmp_fragments( f, &f->entries[ j - 1 ], &e ) > 0 )
+        {
+            f->entries[ j ] = f->entries[ j - 1 ];
+            j--;
+        }
+        f->entries[ j ] = e;
+    }
+
+    for ( idx = first; idx < end && rc == 0; ++idx )
+    {
+        const pileup_fragment * e = &f->entries[ idx ];
+        rc = print_2_dyn_string( self->out, ( idx == first ) ? "%u-%.*s" : "|%u-%.*s",
+                                 e->count, e->len, f->bases + e->offset );
+    }
+    f->cursor = end;
+    return rc;
+}
@@ -0,0 +1,141 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#ifndef _h_pileup_block_
+#define _h_pileup_block_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ref_walker_0.h"
+
+/* ---------------------------------------------------------------------------------------------
+    pileup-block: the counters of a block of consecutive reference-positions as a struct of
+    arrays ( one array per counter, indexed by the position inside the block ).
+
+    The walker visits the positions in order: it selects the slot of the current position
+    ( pileup_block_enter_ref_pos ), the function increments the counters of that slot for each
+    alignment. If the walker leaves the block or the reference-window, the print-callback of
+    the function produces the lines of all visited positions in one pass over the arrays, they
+    are written in one piece, and the block is cleared.
+
+    Indel-fragments are collected per block in one buffer, the fragments of a position are
+    consecutive because the positions are visited in order.
+--------------------------------------------------------------------------------------------- */
+
+#define PILEUP_BLOCK_LEN 4096
+
+/* the counter-arrays, each function defines what it counts in them */
+enum
+{
+    pbc_matches = 0,
+    pbc_base_A,
+    pbc_base_C,
+    pbc_base_G,
+    pbc_base_T,
+    pbc_inserts,
+    pbc_deletes,
+    pbc_forward,
+    pbc_reverse,
+    pbc_starting,
+    pbc_ending,
+    pbc_insert_after_A,
+    pbc_insert_after_C,
+    pbc_insert_after_G,
+    pbc_insert_after_T,
+    pbc_result,         /* for the print-callback: computed per block */
+    pbc_count
+};
+
+/* the kinds of indel-fragments */
+enum
+{
+    pbf_insert = 0,
+    pbf_delete,
+    pbf_count
+};
+
+typedef struct pileup_fragment
+{
+    uint32_t slot;      /* of the position */
+    uint32_t offset;    /* of the bases in pileup_fragments.bases */
+    uint32_t len;
+    uint32_t count;
+} pileup_fragment;
+
+typedef struct pileup_fragments
+{
+    pileup_fragment * entries;
+    uint32_t entries_used;
+    uint32_t entries_allocated;
+    char * bases;
+    uint32_t bases_used;
+    uint32_t bases_allocated;
+    uint32_t cursor;    /* first entry not printed yet */
+} pileup_fragments;
+
+struct pileup_block;
+struct dyn_string;
+
+/* appends the lines of the visited positions of the block to self->out */
+typedef rc_t ( CC * pileup_block_print )( struct pileup_block * self, const pileup_options * options );
+
+typedef struct pileup_block
+{
+    const char * ref_name;          /* of the positions in the block */
+    INSDC_coord_zero start;         /* reference-position of slot #0 */
+    uint32_t used;                  /* the visited positions are in slot #0 ... #used - 1 */
+    uint32_t slot;                  /* of the current position */
+    uint8_t * visited;
+    INSDC_4na_bin * ref_base;
+    uint32_t * depth;
+    uint32_t * column[ pbc_count ];
+    pileup_fragments fragments[ pbf_count ];
+    struct dyn_string * out;
+    pileup_block_print print;
+    bool ref_entered;               /* the walker entered a reference, the print-callback may clear it */
+} pileup_block;
+
+
+/* walks the ref-iter with the given placement-callback, data->data is the pileup_block */
+rc_t walk_pileup_block( ReferenceIterator *ref_iter, pileup_options *options,
+                        rc_t ( CC * on_placement ) ( walk_data * data ),
+                        pileup_block_print print );
+
+/* counts the fragment for the current position */
+rc_t pileup_block_count_fragment( pileup_block * self, uint32_t kind,
+                                  const INSDC_4na_bin * bases, uint32_t len );
+
+/* appends the fragments of the slot ( sorted by bases ) as "count-bases|count-bases..." to self->out,
+   has to be called for the slots in ascending order */
+rc_t pileup_block_print_fragments( pileup_block * self, uint32_t kind, uint32_t slot );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*  _h_pileup_block_ */
@@ -27,292 +27,94 @@
 #include <klib/out.h>
 
 #include "ref_walker_0.h"
+#include "pileup_block.h"
+#include "dyn_string.h"
 #include "4na_ascii.h"
 
-static uint32_t percent( uint32_t v1, uint32_t v2 )
-{
-    uint32_t sum = v1 + v2;
-    uint32_t res = 0;
-    if ( sum > 0 )
-        res = ( ( v1 * 100 ) / sum );
-    return res;
-}
-
-typedef struct indel_fragment
-{
-    BSTNode node;
-    const char * bases;
-    uint32_t len;
-    uint32_t count;
-} indel_fragment;
-
-
-static indel_fragment * make_indel_fragment( const char * bases, uint32_t len )
-{
-    indel_fragment * res = malloc( sizeof * res );
-    if ( res != NULL )
-    {
-        res->bases = string_dup ( bases, len );
-        if ( res->bases == NULL )
-        {
-            free( res );
-            res = NULL;
-        }
-        else
-        {
-            res->len = len;
-            res->count = 1;
-        }
-    }
-    return res;
-}
-
-
-static void CC free_indel_fragment( BSTNode * n, void * data )
-{
-    indel_fragment * fragment = ( indel_fragment * ) n;
-    if ( fragment != NULL )
-    {
-        free( ( void * ) fragment->bases );
-        free( fragment );
-    }
-}
-
-
-static void free_fragments( BSTree * fragments )
-{    
-    BSTreeWhack ( fragments, free_indel_fragment, NULL );
-}
-
-
-typedef struct find_fragment_ctx
-{
-    const char * bases;
-    uint32_t len;
-} find_fragment_ctx;
-
-
-static int64_t CC cmp_fragment_vs_find_ctx( const void *item, const BSTNode *n )
-{
-    const indel_fragment * fragment = ( const indel_fragment * )n;
-    const find_fragment_ctx * fctx = ( const find_fragment_ctx * )item;
-    return string_cmp ( fctx->bases, fctx->len, fragment->bases, fragment->len, -1 );
-}
-
-
-static int64_t CC cmp_fragment_vs_fragment( const BSTNode *item, const BSTNode *n )
-{
-    const indel_fragment * f1 = ( const indel_fragment * )item;
-    const indel_fragment * f2 = ( const indel_fragment * )n;
-    return string_cmp ( f1->bases, f1->len, f2->bases, f2->len, -1 );
-}
-
-
-static void count_indel_fragment( BSTree * fragments, const INSDC_4na_bin *bases, uint32_t len )
-{
-    find_fragment_ctx fctx;
-
-    fctx.bases = malloc( len );
-    if ( fctx.bases != NULL )
-    {
-        indel_fragment * fragment;
-        uint32_t i;
-
-        fctx.len = len;
-        for ( i = 0; i < len; ++i )
-            ( ( char * )fctx.bases )[ i ] = _4na_to_ascii( bases[ i ], false );
-
-        fragment = ( indel_fragment * ) BSTreeFind ( fragments, &fctx, cmp_fragment_vs_find_ctx );
-        if ( fragment == NULL )
-        {
-            fragment = make_indel_fragment( fctx.bases, len );
-            if ( fragment != NULL )
-            {
-                rc_t rc = BSTreeInsert ( fragments, ( BSTNode * )fragment, cmp_fragment_vs_fragment );
-                if ( rc != 0 )
-                    free_indel_fragment( ( BSTNode * )fragment, NULL );
-            }
-        }
-        else
-            fragment->count++;
-
-        free( ( void * ) fctx.bases );
-    }
-}
-
-
-typedef struct walk_fragment_ctx
-{
-    rc_t rc;
-    uint32_t n;
-} walk_fragment_ctx;
-
-
-static void CC on_fragment( BSTNode *n, void *data )
-{
-    walk_fragment_ctx * wctx = data;
-    const indel_fragment * fragment = ( const indel_fragment * )n;
-    if ( wctx->rc == 0 )
-    {
-        if ( wctx->n == 0 )
-            wctx->rc = KOutMsg( "%u-%.*s", fragment->count, fragment->len, fragment->bases );
-        else
-            wctx->rc = KOutMsg( "|%u-%.*s", fragment->count, fragment->len, fragment->bases );
-        wctx->n++;
-    }
-}
-
-
-static rc_t print_fragments( BSTree * fragments )
-{
-    walk_fragment_ctx wctx;
-    wctx.rc = 0;
-    wctx.n = 0;
-    BSTreeForEach ( fragments, false, on_fragment, &wctx );
-    return wctx.rc;
-}
-
 /* =========================================================================================== */
 
-typedef struct pileup_counters
-{
-    uint32_t matches;
-    uint32_t mismatches[ 4 ];
-    uint32_t inserts;
-    uint32_t deletes;
-    uint32_t forward;
-    uint32_t reverse;
-    uint32_t starting;
-    uint32_t ending;
-    BSTree insert_fragments;
-    BSTree delete_fragments;
-} pileup_counters;
-
-
-static void clear_counters( pileup_counters * counters )
-{
-    uint32_t i;
-
-    counters->matches = 0;
-    for ( i = 0; i < 4; ++i )
-        counters->mismatches[ i ] = 0;
-    counters->inserts = 0;
-    counters->deletes = 0;
-    counters->forward = 0;
-    counters->reverse = 0;
-    counters->starting = 0;
-    counters->ending = 0;
-    BSTreeInit( &(counters->insert_fragments) );
-    BSTreeInit( &(counters->delete_fragments) );
-}
-
 
-static void walk_counter_state( ReferenceIterator *ref_iter, int32_t state, bool reverse,
-                                pileup_counters * counters )
+static void count_indels( ReferenceIterator *ref_iter, int32_t state, pileup_block * block, rc_t * rc )
 {
-    if ( ( state & align_iter_invalid ) == align_iter_invalid )
-        return;
-
-    if ( ( state & align_iter_skip ) != align_iter_skip )
-    {
-        if ( ( state & align_iter_match ) == align_iter_match )
-            (counters->matches)++;
-        else
-        {
-            char c = _4na_to_ascii( state, false );
-            switch( c )
-            {
-                case 'A' : ( counters->mismatches[ 0 ] )++; break;
-                case 'C' : ( counters->mismatches[ 1 ] )++; break;
-                case 'G' : ( counters->mismatches[ 2 ] )++; break;
-                case 'T' : ( counters->mismatches[ 3 ] )++; break;
-            }
-        }
-    }
-
-    if ( reverse )
-        (counters->reverse)++;
-    else
-        (counters->forward)++;
+    uint32_t slot = block->slot;
 
     if ( ( state & align_iter_insert ) == align_iter_insert )
     {
         const INSDC_4na_bin *bases;
         uint32_t n = ReferenceIteratorBasesInserted ( ref_iter, &bases );
-        (counters->inserts) += n;
-        count_indel_fragment( &(counters->insert_fragments), bases, n );
+        block->column[ pbc_inserts ][ slot ] += n;
+        *rc = pileup_block_count_fragment( block, pbf_insert, bases, n ); /* pileup_block.c */
     }
 
-    if ( ( state & align_iter_delete ) == align_iter_delete )
+    if ( *rc == 0 && ( state & align_iter_delete ) == align_iter_delete )
     {
         const INSDC_4na_bin *bases;
         INSDC_coord_zero ref_pos;
         uint32_t n = ReferenceIteratorBasesDeleted ( ref_iter, &ref_pos, &bases );
         if ( bases != NULL )
         {
-            (counters->deletes) += n;
-            count_indel_fragment( &(counters->delete_fragments), bases, n );
+            block->column[ pbc_deletes ][ slot ] += n;
+            *rc = pileup_block_count_fragment( block, pbf_delete, bases, n ); /* pileup_block.c */
             free( (void *) bases );
         }
     }
-
-    if ( ( state & align_iter_first ) == align_iter_first )
-        ( counters->starting)++;
-
-    if ( ( state & align_iter_last ) == align_iter_last )
-        ( counters->ending)++;
 }
 
 
-static rc_t print_counter_line( const char * ref_name,
-                                INSDC_coord_zero ref_pos,
-                                INSDC_4na_bin ref_base,
-                                uint32_t depth,
-                                pileup_counters * counters )
+/* pbc_base_A ... pbc_base_T count the mismatches */
+static void count_bases( int32_t state, pileup_block * block )
 {
-    char c = _4na_to_ascii( ref_base, false );
-
-    rc_t rc = KOutMsg( "%s\t%u\t%c\t%u\t", ref_name, ref_pos + 1, c, depth );
-
-    if ( rc == 0 && counters->matches > 0 )
-        rc = KOutMsg( "%u", counters->matches );
+    uint32_t slot = block->slot;
+    if ( ( state & align_iter_match ) == align_iter_match )
+        block->column[ pbc_matches ][ slot ]++;
+    else
+    {
+        switch( _4na_to_ascii( state, false ) )
+        {
+            case 'A' : block->column[ pbc_base_A ][ slot ]++; break;
+            case 'C' : block->column[ pbc_base_C ][ slot ]++; break;
+            case 'G' : block->column[ pbc_base_G ][ slot ]++; break;
+            case 'T' : block->column[ pbc_base_T ][ slot ]++; break;
+        }
+    }
+}
 
-    if ( rc == 0 /* && counters->mismatches[ 0 ] > 0 */ )
-        rc = KOutMsg( "\t%u-A", counters->mismatches[ 0 ] );
 
-    if ( rc == 0 /* && counters->mismatches[ 1 ] > 0 */ )
-        rc = KOutMsg( "\t%u-C", counters->mismatches[ 1 ] );
+static rc_t print_counter_line( pileup_block * block, uint32_t slot )
+{
+    struct dyn_string * out = block->out;
+    char c = _4na_to_ascii( block->ref_base[ slot ], false );
 
-    if ( rc == 0 /* && counters->mismatches[ 2 ] > 0 */ )
-        rc = KOutMsg( "\t%u-G", counters->mismatches[ 2 ] );
+    rc_t rc = print_2_dyn_string( out, "%s\t%u\t%c\t%u\t",
+                                  block->ref_name, block->start + slot + 1, c, block->depth[ slot ] );
 
-    if ( rc == 0 /* && counters->mismatches[ 3 ] > 0 */ )
-        rc = KOutMsg( "\t%u-T", counters->mismatches[ 3 ] );
+    if ( rc == 0 && block->column[ pbc_matches ][ slot ] > 0 )
+        rc = print_2_dyn_string( out, "%u", block->column[ pbc_matches ][ slot ] );
 
     if ( rc == 0 )
-        rc = KOutMsg( "\tI:" );
+        rc = print_2_dyn_string( out, "\t%u-A\t%u-C\t%u-G\t%u-T\tI:",
+                                 block->column[ pbc_base_A ][ slot ], block->column[ pbc_base_C ][ slot ],
+                                 block->column[ pbc_base_G ][ slot ], block->column[ pbc_base_T ][ slot ] );
     if ( rc == 0 )
-        rc = print_fragments( &(counters->insert_fragments) );
+        rc = pileup_block_print_fragments( block, pbf_insert, slot );
 
     if ( rc == 0 )
-        rc = KOutMsg( "\tD:" );
+        rc = add_string_2_dyn_string( out, "\tD:" );
     if ( rc == 0 )
-        rc = print_fragments( &(counters->delete_fragments) );
+        rc = pileup_block_print_fragments( block, pbf_delete, slot );
 
+    /* pbc_result is the percentage of forward-alignments */
     if ( rc == 0 )
-        rc = KOutMsg( "\t%u%%", percent( counters->forward, counters->reverse ) );
+        rc = print_2_dyn_string( out, "\t%u%%", block->column[ pbc_result ][ slot ] );
 
-    if ( rc == 0 && counters->starting > 0 )
-        rc = KOutMsg( "\tS%u", counters->starting );
+    if ( rc == 0 && block->column[ pbc_starting ][ slot ] > 0 )
+        rc = print_2_dyn_string( out, "\tS%u", block->column[ pbc_starting ][ slot ] );
 
-    if ( rc == 0 && counters->ending > 0 )
-        rc = KOutMsg( "\tE%u", counters->ending );
+    if ( rc == 0 && block->column[ pbc_ending ][ slot ] > 0 )
+        rc = print_2_dyn_string( out, "\tE%u", block->column[ pbc_ending ][ slot ] );
 
     if ( rc == 0 )
-        rc = KOutMsg( "\n" );
-
-    free_fragments( &(counters->insert_fragments) );
-    free_fragments( &(counters->delete_fragments) );
+        rc = add_char_2_dyn_string( out, '\n' );
 
     return rc;
 }
@@ -321,127 +123,108 @@ static rc_t print_counter_line( const char * ref_name,
 /* ........................................................................................... */
 
 
-static rc_t CC walk_counters_enter_ref_pos( walk_data * data )
+static rc_t CC print_counters( pileup_block * block, const pileup_options * options )
 {
-    clear_counters( data->data );
-    return 0;
-}
+    rc_t rc = 0;
+    uint32_t slot, used = block->used;
+    const uint32_t * forward = block->column[ pbc_forward ];
+    const uint32_t * reverse = block->column[ pbc_reverse ];
+    uint32_t * percent = block->column[ pbc_result ];
 
-static rc_t CC walk_counters_exit_ref_pos( walk_data * data )
-{
-    rc_t rc = print_counter_line( data->ref_name, data->ref_pos, data->ref_base, data->depth, data->data );
+    for ( slot = 0; slot < used; ++slot )
+    {
+        uint32_t sum = forward[ slot ] + reverse[ slot ];
+        percent[ slot ] = ( sum > 0 ) ? ( ( forward[ slot ] * 100 ) / sum ) : 0;
+    }
+
+    for ( slot = 0; slot < used && rc == 0; ++slot )
+    {
+        if ( block->visited[ slot ] )
+            rc = print_counter_line( block, slot );
+    }
     return rc;
 }
 
-static rc_t CC walk_counters_placement( walk_data * data )
-{
-    walk_counter_state( data->ref_iter, data->state, data->xrec->reverse, data->data );
-    return 0;
-}
 
-rc_t walk_counters( ReferenceIterator *ref_iter, pileup_options *options )
+static rc_t CC walk_counters_placement( walk_data * data )
 {
-    walk_data data;
-    walk_funcs funcs;
-    pileup_counters counters;
+    rc_t rc = 0;
+    int32_t state = data->state;
+    if ( ( state & align_iter_invalid ) != align_iter_invalid )
+    {
+        pileup_block * block = data->data;
+        uint32_t slot = block->slot;
 
-    data.ref_iter = ref_iter;
-    data.options = options;
-    data.data = &counters;
+        if ( ( state & align_iter_skip ) != align_iter_skip )
+            count_bases( state, block );
 
-    funcs.on_enter_ref = NULL;
-    funcs.on_exit_ref = NULL;
+        if ( data->xrec->reverse )
+            block->column[ pbc_reverse ][ slot ]++;
+        else
+            block->column[ pbc_forward ][ slot ]++;
 
-    funcs.on_enter_ref_window = NULL;
-    funcs.on_exit_ref_window = NULL;
+        count_indels( data->ref_iter, state, block, &rc );
 
-    funcs.on_enter_ref_pos = walk_counters_enter_ref_pos;
-    funcs.on_exit_ref_pos = walk_counters_exit_ref_pos;
+        if ( ( state & align_iter_first ) == align_iter_first )
+            block->column[ pbc_starting ][ slot ]++;
 
-    funcs.on_enter_spotgroup = NULL;
-    funcs.on_exit_spotgroup = NULL;
+        if ( ( state & align_iter_last ) == align_iter_last )
+            block->column[ pbc_ending ][ slot ]++;
+    }
+    return rc;
+}
 
-    funcs.on_placement = walk_counters_placement;
 
-    return walk_0( &data, &funcs );
+rc_t walk_counters( ReferenceIterator *ref_iter, pileup_options *options )
+{
+    return walk_pileup_block( ref_iter, options, walk_counters_placement, print_counters ); /* pileup_block.c */
 }
 
 
 /* =========================================================================================== */
 
 
-static rc_t print_mismatches_line( const char * ref_name,
-                                   INSDC_coord_zero ref_pos,
-                                   uint32_t depth,
-                                   uint32_t min_mismatch_percent,
-                                   pileup_counters * counters )
+static rc_t CC print_mismatches( pileup_block * block, const pileup_options * options )
 {
     rc_t rc = 0;
-    if ( depth > 0 )
+    uint32_t slot, used = block->used;
+    const uint32_t * a = block->column[ pbc_base_A ];
+    const uint32_t * c = block->column[ pbc_base_C ];
+    const uint32_t * g = block->column[ pbc_base_G ];
+    const uint32_t * t = block->column[ pbc_base_T ];
+    uint32_t * total = block->column[ pbc_result ];
+
+    for ( slot = 0; slot < used; ++slot )
+        total[ slot ] = a[ slot ] + c[ slot ] + g[ slot ] + t[ slot ];
+
+    for ( slot = 0; slot < used && rc == 0; ++slot )
     {
-        uint32_t total_mismatches = counters->mismatches[ 0 ] +
-                                    counters->mismatches[ 1 ] +
-                                    counters->mismatches[ 2 ] +
-                                    counters->mismatches[ 3 ];
-	if ( total_mismatches * 100 >= min_mismatch_percent * depth) 
+        uint32_t depth = block->depth[ slot ];
+        if ( block->visited[ slot ] && depth > 0 &&
+             total[ slot ] * 100 >= options->min_mismatch * depth )
         {
-                rc = KOutMsg( "%s\t%u\t%u\t%u\n", ref_name, ref_pos + 1, depth, total_mismatches );
+            rc = print_2_dyn_string( block->out, "%s\t%u\t%u\t%u\n",
+                                     block->ref_name, block->start + slot + 1, depth, total[ slot ] );
         }
     }
-    
-    free_fragments( &(counters->insert_fragments) );
-    free_fragments( &(counters->delete_fragments) );
-
     return rc;
 }
 
 
-/* ........................................................................................... */
-
-
-static rc_t CC walk_mismatches_enter_ref_pos( walk_data * data )
-{
-    clear_counters( data->data );
-    return 0;
-}
-
-static rc_t CC walk_mismatches_exit_ref_pos( walk_data * data )
-{
-    rc_t rc = print_mismatches_line( data->ref_name, data->ref_pos,
-                                     data->depth, data->options->min_mismatch, data->data );
-    return rc;
-}
-
+/* only the mismatches are reported */
 static rc_t CC walk_mismatches_placement( walk_data * data )
 {
-    walk_counter_state( data->ref_iter, data->state, data->xrec->reverse, data->data );
+    int32_t state = data->state;
+    if ( ( state & align_iter_invalid ) != align_iter_invalid &&
+         ( state & align_iter_skip ) != align_iter_skip )
+    {
+        count_bases( state, data->data );
+    }
     return 0;
 }
 
 
 rc_t walk_mismatches( ReferenceIterator *ref_iter, pileup_options * options )
 {
-    walk_data data;
-    walk_funcs funcs;
-    pileup_counters counters;
-
-    data.ref_iter = ref_iter;
-    data.options = options;
-    data.data = &counters;
-
-    funcs.on_enter_ref = NULL;
-    funcs.on_exit_ref = NULL;
-
-    funcs.on_enter_ref_window = NULL;
-    funcs.on_exit_ref_window = NULL;
-
-    funcs.on_enter_ref_pos = walk_mismatches_enter_ref_pos;
-    funcs.on_exit_ref_pos = walk_mismatches_exit_ref_pos;
-
-    funcs.on_enter_spotgroup = NULL;
-    funcs.on_exit_spotgroup = NULL;
-
-    funcs.on_placement = walk_mismatches_placement;
-
-    return walk_0( &data, &funcs );
+    return walk_pileup_block( ref_iter, options, walk_mismatches_placement, print_mismatches ); /* pileup_block.c */
 }
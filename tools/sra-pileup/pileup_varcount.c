@@ -27,34 +27,23 @@
 #include <klib/out.h>
 
 #include "ref_walker_0.h"
+#include "pileup_block.h"
+#include "dyn_string.h"
 #include "4na_ascii.h"
 
-typedef struct var_counters
+/* the pbc_base_A...pbc_base_T and pbc_insert_after_A...pbc_insert_after_T columns are consecutive,
+   they are indexed by _4na_to_index() */
+static rc_t CC print_varcount( pileup_block * block, const pileup_options * options )
 {
-    uint32_t coverage;
-    uint32_t base_counts[ 4 ];      /* 0...A, 1...C, 2...G, 3...T */
-    uint32_t deletes;
-    uint32_t inserts;
-    uint32_t insert_after[ 4 ];     /* 0...A, 1...C, 2...G, 3...T */
-} var_counters;
+    rc_t rc = 0;
+    uint32_t slot, used = block->used;
+    uint32_t * const * col = block->column;
 
-
-static rc_t CC walk_varcount_enter_ref_pos( walk_data * data )
-{
-    var_counters * vc = data->data;
-    memset( vc, 0, sizeof *vc );
-    return 0;
-}
-
-
-static rc_t CC walk_varcount_exit_ref_pos( walk_data * data )
-{
-    if ( data->depth == 0 )
-        return 0;
-    else
+    for ( slot = 0; slot < used && rc == 0; ++slot )
     {
-        var_counters * vc = data->data;
-        char ref_base = _4na_to_ascii( data->ref_base, false );
+        if ( block->visited[ slot ] && block->depth[ slot ] > 0 )
+        {
+            char ref_base = _4na_to_ascii( block->ref_base[ slot ], false );
 
 /*
         A ... ref-name
@@ -77,13 +66,16 @@ static rc_t CC walk_varcount_exit_ref_pos( walk_data * data )
 
                           A   B   C   D   E   F   G   H   I   J   K   L   M   N
 */                         
-        return KOutMsg( "%s\t%u\t%c\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\n", 
-                     data->ref_name, data->ref_pos + 1, ref_base, data->depth,
+            rc = print_2_dyn_string( block->out, "%s\t%u\t%c\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\t%u\n", 
+                     block->ref_name, block->start + slot + 1, ref_base, block->depth[ slot ],
 
-                     vc->base_counts[ 0 ], vc->base_counts[ 1 ], vc->base_counts[ 2 ], vc->base_counts[ 3 ],
-                     vc->deletes, vc->inserts,
-                     vc->insert_after[ 0 ], vc->insert_after[ 1 ], vc->insert_after[ 2 ], vc->insert_after[ 3 ] );
+                     col[ pbc_base_A ][ slot ], col[ pbc_base_C ][ slot ], col[ pbc_base_G ][ slot ], col[ pbc_base_T ][ slot ],
+                     col[ pbc_deletes ][ slot ], col[ pbc_inserts ][ slot ],
+                     col[ pbc_insert_after_A ][ slot ], col[ pbc_insert_after_C ][ slot ],
+                     col[ pbc_insert_after_G ][ slot ], col[ pbc_insert_after_T ][ slot ] );
+        }
     }
+    return rc;
 }
 
 
@@ -92,18 +84,19 @@ static rc_t CC walk_varcount_placement( walk_data * data )
     int32_t state = data->state;
     if ( ( state & align_iter_invalid ) != align_iter_invalid )
     {
-        var_counters * vc = data->data;
+        pileup_block * block = data->data;
+        uint32_t slot = block->slot;
         uint32_t idx = _4na_to_index( state );
 
         if ( ( state & align_iter_skip ) == align_iter_skip )
-            ( vc->deletes ) ++;
+            block->column[ pbc_deletes ][ slot ] ++;
         else if ( ( state & align_iter_match ) != align_iter_match )
-            vc->base_counts[ idx ] ++;
+            block->column[ pbc_base_A + idx ][ slot ] ++;
 
         if ( ( state & align_iter_insert ) == align_iter_insert )
         {
-            ( vc->inserts )++;
-            vc->insert_after[ idx ] ++;
+            block->column[ pbc_inserts ][ slot ]++;
+            block->column[ pbc_insert_after_A + idx ][ slot ] ++;
         }
     }
     return 0;
@@ -112,28 +105,5 @@ static rc_t CC walk_varcount_placement( walk_data * data )
 
 rc_t walk_varcount( ReferenceIterator *ref_iter, pileup_options * options )
 {
-    walk_data data;
-    walk_funcs funcs;
-
-    var_counters v_counters;
-
-    data.ref_iter = ref_iter;
-    data.options = options;
-    data.data = &v_counters;
-
-    funcs.on_enter_ref = NULL;
-    funcs.on_exit_ref = NULL;
-
-    funcs.on_enter_ref_window = NULL;
-    funcs.on_exit_ref_window = NULL;
-
-    funcs.on_enter_ref_pos = walk_varcount_enter_ref_pos;
-    funcs.on_exit_ref_pos = walk_varcount_exit_ref_pos;
-
-    funcs.on_enter_spotgroup = NULL;
-    funcs.on_exit_spotgroup = NULL;
-
-    funcs.on_placement = walk_varcount_placement;
-
-    return walk_0( &data, &funcs );
+    return walk_pileup_block( ref_iter, options, walk_varcount_placement, print_varcount ); /* pileup_block.c */
 }
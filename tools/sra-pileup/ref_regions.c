@@ -781,13 +781,15 @@ bool skiplist_is_skip_position( struct skiplist * list, uint64_t pos )
         if ( cur_node != NULL )
         {
             const struct skip_range * curr_skip_range = cur_node->current_skip_range;
-            if ( curr_skip_range != NULL )
+            /* the walker can jump over several skip-ranges ( or start in the middle of a reference ) */
+            while ( curr_skip_range != NULL && pos > curr_skip_range->end )
             {
-                if ( pos < curr_skip_range->start ) return false;
-                if ( pos <= curr_skip_range->end ) return true;
                 cur_node->current_id++;
-                cur_node->current_skip_range = VectorGet ( &( cur_node->skip_ranges ), cur_node->current_id );
+                curr_skip_range = VectorGet ( &( cur_node->skip_ranges ), cur_node->current_id );
+                cur_node->current_skip_range = curr_skip_range;
             }
+            if ( curr_skip_range != NULL )
+                return ( pos >= curr_skip_range->start );
         }
     }
     return false;
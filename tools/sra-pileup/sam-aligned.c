@@ -27,6 +27,7 @@
 #include <align/manager.h>
 #include <align/iterator.h>
 #include <kapp/main.h>
+#include <kproc/thread.h>
 #include <ctype.h>
 #include <sysalloc.h>
 
@@ -35,6 +36,9 @@
 #include "rna_splice_log.h"
 #include "sam-aligned.h"
 #include "md_flag.h"
+#include "ordered_out.h"
+#include "sam_line.h"
+#include "bam_out.h"
 
 const char * PRIM_TABLE = "PRIMARY_ALIGNMENT";
 const char * SEC_TABLE = "SECONDARY_ALIGNMENT";
@@ -180,6 +184,12 @@ typedef struct align_table_context
 
     /* the common part repeats for evidence-alignment */
     align_cmn_context eval;
+
+    /* the SAM-line is assembled here ( prim/sec ), reused for every record */
+    sam_line line;
+
+    /* the same for BAM-output, encoded from the column-values */
+    bam_rec bam;
 } align_table_context;
 
 
@@ -229,6 +239,8 @@ static void init_align_table_context( align_table_context * const atx,
     atx->ref_obj = ref_obj;
     atx->cig_op_buffer = NULL;
     atx->cig_op_buffer_len = 0;
+    init_sam_line( &atx->line ); /* sam_line.c */
+    init_bam_rec( &atx->bam ); /* bam_out.c */
     invalidate_all_column_idx( atx );
 }
 
@@ -239,6 +251,8 @@ static void free_align_table_context( align_table_context * atx )
     {
         if ( atx->cig_op_buffer != NULL )
             free( atx->cig_op_buffer );
+        release_sam_line( &atx->line ); /* sam_line.c */
+        release_bam_rec( &atx->bam ); /* bam_out.c */
 
         VCursorRelease( atx->cmn.cursor );
         VCursorRelease( atx->eval.cursor );
@@ -976,12 +990,8 @@ static rc_t cg_cigar_treatments( enum cigar_treatment what_treatment,
 }
 
 
-static rc_t print_quality_or_star( const samdump_opts * const opts,
-                                   const char * const q,
-                                   uint32_t q_len,
-                                   uint32_t r_len )
+static bool is_star_quality( const char * const q, uint32_t q_len, uint32_t r_len )
 {
-    rc_t rc;
     bool star_qual = ( q_len == 0 || q_len != r_len );
     if ( !star_qual && q[ 0 ] == 255 )
     {
@@ -989,8 +999,17 @@ static rc_t print_quality_or_star( const samdump_opts * const opts,
         while ( i < q_len && q[ i ] == 255 ) i++;
         star_qual = ( i == q_len );
     }
-    
-    if ( star_qual )
+    return star_qual;
+}
+
+
+static rc_t print_quality_or_star( const samdump_opts * const opts,
+                                   const char * const q,
+                                   uint32_t q_len,
+                                   uint32_t r_len )
+{
+    rc_t rc;
+    if ( is_star_quality( q, q_len, r_len ) )
         rc = KOutMsg( "*" );
     else
         rc = dump_quality_33( opts, q, q_len, false ); /* sam-dump-opts.c */
@@ -1397,18 +1416,35 @@ static rc_t print_alignment_sam_ev( const samdump_opts * const opts,
 }
 
 
-static rc_t opt_field_spot_group( const VCursor * cursor, uint32_t col_id, int64_t row_id )
+/* an optional field goes into the BAM-record if there is one, into the SAM-line otherwise */
+static rc_t opt_field_str( sam_line * line, bam_rec * bam, const char * tag, const char * value, size_t len )
+{
+    if ( bam != NULL )
+        return bam_rec_tag_str( bam, tag, value, len ); /* bam_out.c */
+    return sam_line_tag_str( line, tag, value, len ); /* sam_line.c */
+}
+
+
+static rc_t opt_field_u64( sam_line * line, bam_rec * bam, const char * tag, uint64_t value )
+{
+    if ( bam != NULL )
+        return bam_rec_tag_int( bam, tag, ( int64_t )value ); /* bam_out.c */
+    return sam_line_tag_u64( line, tag, value ); /* sam_line.c */
+}
+
+
+static rc_t opt_field_spot_group( sam_line * line, bam_rec * bam, const VCursor * cursor, uint32_t col_id, int64_t row_id )
 {
     const char * value = NULL;
     uint32_t len;    
     rc_t rc = read_char_ptr( row_id, cursor, col_id, &value, &len, "SPOT_GROUP" );
     if ( rc == 0 && len > 0 )
-        rc = KOutMsg( "\tRG:Z:%.*s", len, value );
+        rc = opt_field_str( line, bam, "RG:Z:", value, len );
     return rc;
 }
 
 
-static rc_t opt_field_lnk_group( const VCursor * cursor, uint32_t col_id, int64_t row_id )
+static rc_t opt_field_lnk_group( sam_line * line, bam_rec * bam, const VCursor * cursor, uint32_t col_id, int64_t row_id )
 {
     const char * value = NULL;
     uint32_t len;    
@@ -1451,14 +1487,60 @@ static rc_t opt_field_lnk_group( const VCursor * cursor, uint32_t col_id, int64_
         }
         
         if ( CB.addr == NULL && UB.addr == NULL )
-            { rc = KOutMsg( "\tBX:Z:%.*s", len, value ); }
+            { rc = opt_field_str( line, bam, "BX:Z:", value, len ); }
         else
-            { rc = KOutMsg( "\tCB:Z:%S\tUB:Z:%S", &CB, &UB ); }
+        {
+            rc = opt_field_str( line, bam, "CB:Z:", CB.addr, CB.size );
+            if ( rc == 0 )
+                rc = opt_field_str( line, bam, "UB:Z:", UB.addr, UB.size );
+        }
+    }
+    return rc;
+}
+
+/* the same as dump_name() in sam-dump-opts.c, but into the SAM-line */
+static rc_t line_name( sam_line * line, const samdump_opts * opts, int64_t seq_spot_id,
+                       const char * spot_group, uint32_t spot_group_len )
+{
+    rc_t rc = 0;
+    bool with_spot_group = ( spot_group != NULL && spot_group_len > 0 );
+
+    if ( opts->print_cg_names )
+    {
+        if ( with_spot_group )
+        {
+            rc = sam_line_str( line, spot_group, spot_group_len );
+            if ( rc == 0 )
+                rc = sam_line_str( line, "-1:", 3 );
+        }
+        if ( rc == 0 )
+            rc = sam_line_u64( line, seq_spot_id );
+    }
+    else
+    {
+        if ( opts->qname_prefix != NULL )
+        {
+            rc = sam_line_cstr( line, opts->qname_prefix );
+            if ( rc == 0 )
+                rc = sam_line_char( line, '.' );
+        }
+        if ( rc == 0 )
+            rc = sam_line_u64( line, seq_spot_id );
+        if ( rc == 0 && opts->print_spot_group_in_name && with_spot_group )
+        {
+            rc = sam_line_char( line, '.' );
+            if ( rc == 0 )
+                rc = sam_line_str( line, spot_group, spot_group_len );
+        }
     }
     return rc;
 }
 
+
+/* bam is NULL for SAM-output, the record goes into the line then */
 static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
+                                    sam_line * line,
+                                    bam_rec * bam,
                                     const char * ref_name,
                                     INSDC_coord_zero pos,
                                     matecache * const mc,
@@ -1472,6 +1554,9 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
     int64_t mate_align_id = 0, id = rec->id;
     const int64_t * seq_spot_id;
     const char * mate_ref_name = ref_name;
+    const char * rnext;
+    size_t rnext_len;
+    uint32_t pnext;
     const VCursor * cursor = atx->cmn.cursor;
     cg_cigar_output cgc_output;
     rna_splice_candidates candidates; /* in cg_tools.h */
@@ -1570,7 +1655,7 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
                     {
                         /* now that we have the data, store it in sam-ref-cache it the mate is on the same ref. */
                         uint32_t mate_flags = calc_mate_flags( sam_flags );
-                        rc = matecache_insert_same_ref( mc, atx->db_idx, id, pos, mate_flags, -tlen );
+                        rc = matecache_insert_same_ref( mc, atx->db_idx, id, pos, mate_flags, -tlen, mate_ref_pos );
                     }
 
                     if ( mate_align_id == 0 && mate_ref_name_len == 0 && opts->print_half_unaligned_reads &&
@@ -1598,17 +1683,24 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
                 uint32_t spot_group_len;
                 rc = read_char_ptr( id, cursor, atx->cmn.seq_spot_group_idx, &spot_group, &spot_group_len, "SPOT_GROUP" );
                 if ( rc == 0 )
-                    rc = dump_name( opts, *seq_spot_id, spot_group, spot_group_len ); /* sam-dump-opts.c */
+                    rc = line_name( line, opts, *seq_spot_id, spot_group, spot_group_len ); /* above */
             }
             else
-                rc = dump_name( opts, *seq_spot_id, NULL, 0 ); /* sam-dump-opts.c */
+                rc = line_name( line, opts, *seq_spot_id, NULL, 0 ); /* above */
         }
         else
-            rc = KOutMsg( "*" );
+            rc = sam_line_char( line, '*' );
     }
 
-    if ( rc == 0 )
-        rc = KOutMsg( "\t" );
+    if ( bam != NULL )
+    {
+        /* the name has been assembled in the line, it starts the BAM-record */
+        if ( rc == 0 )
+            rc = bam_rec_start( bam, line->buffer, line->used ); /* bam_out.c */
+        line->used = 0;
+    }
+    else if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
 
     /* massage the sam-flag if we are not dumping unaligned reads... */
     if ( !opts->dump_unaligned_reads    /** not going to dump unaligned **/
@@ -1622,8 +1714,25 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
     /* SAM-FIELD: RNAME     SRA-column: REF_NAME / REF_SEQ_ID ( char * ) */
     /* SAM-FIELD: POS       SRA-column: REF_POS + 1 */
     /* SAM-FIELD: MAPQ      SRA-column: MAPQ */
-    if ( rc == 0 )
-        rc = KOutMsg( "%u\t%s\t%u\t%d\t", sam_flags, ref_name, pos + 1, rec->mapq );
+    /* ( BAM: the fixed fields are set by bam_rec_write() at the end ) */
+    if ( rc == 0 && bam == NULL )
+    {
+        rc = sam_line_u64( line, sam_flags );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+        if ( rc == 0 )
+            rc = sam_line_cstr( line, ref_name );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+        if ( rc == 0 )
+            rc = sam_line_u64( line, ( uint32_t )( pos + 1 ) );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+        if ( rc == 0 )
+            rc = sam_line_i64( line, rec->mapq );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+    }
 
     /* get READ, QUALITY and EIDT_DIST before cigar manipulation because we need/change these values */
     if ( rc == 0 )
@@ -1708,8 +1817,14 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
             if ( candidates.cigops != NULL )
                 free( ( void * ) candidates.cigops );
         }
-        if ( rc == 0 )
-            rc = KOutMsg( "%.*s\t", cgc_output.p_cigar.len, cgc_output.p_cigar.ptr );
+        if ( rc == 0 && bam != NULL )
+            rc = bam_rec_cigar( bam, cgc_output.p_cigar.ptr, cgc_output.p_cigar.len ); /* bam_out.c */
+        else if ( rc == 0 )
+        {
+            rc = sam_line_str( line, cgc_output.p_cigar.ptr, cgc_output.p_cigar.len );
+            if ( rc == 0 )
+                rc = sam_line_char( line, '\t' );
+        }
 
         if ( temp_cigar != NULL )
             free( temp_cigar );
@@ -1718,43 +1833,76 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
     /* SAM-FIELD: RNEXT     SRA-column: MATE_REF_NAME ( !!! row_len can be zero !!! ) */
     /* SAM-FIELD: PNEXT     SRA-column: MATE_REF_POS + 1 ( !!! row_len can be zero !!! ) */
     /* SAM-FIELD: TLEN      SRA-column: TEMPLATE_LEN ( !!! row_len can be zero !!! ) */
-    if ( rc == 0 )
+    if ( mate_ref_name_len > 0 )
     {
-        if ( mate_ref_name_len > 0 )
-        {
-            rc = KOutMsg( "%.*s\t%u\t%d\t", mate_ref_name_len, mate_ref_name, mate_ref_pos + 1, tlen );
-        }
-        else
-        {
-            if ( mate_ref_pos_len == 0 )
-                rc = KOutMsg( "*\t0\t%d\t", tlen );
-            else
-                rc = KOutMsg( "*\t%u\t%d\t", mate_ref_pos, tlen );
-        }
+        rnext = mate_ref_name;
+        rnext_len = mate_ref_name_len;
+        pnext = ( uint32_t )( mate_ref_pos + 1 );
+    }
+    else
+    {
+        rnext = "*";
+        rnext_len = 1;
+        pnext = ( mate_ref_pos_len == 0 ) ? 0 : ( uint32_t )mate_ref_pos;
+    }
+    if ( rc == 0 && bam == NULL )
+    {
+        rc = sam_line_str( line, rnext, rnext_len );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+        if ( rc == 0 )
+            rc = sam_line_u64( line, pnext );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+        if ( rc == 0 )
+            rc = sam_line_i64( line, ( int32_t )tlen ); /* negative for the downstream mate */
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
     }
 
     /* SAM-FIELD: SEQ       SRA-column: READ */
-    if ( rc == 0 )
-        rc = KOutMsg( "%.*s\t", cgc_output.p_read.len, cgc_output.p_read.ptr );
+    if ( rc == 0 && bam != NULL )
+        rc = bam_rec_seq( bam, cgc_output.p_read.ptr, cgc_output.p_read.len, false ); /* bam_out.c */
+    else if ( rc == 0 )
+    {
+        rc = sam_line_str( line, cgc_output.p_read.ptr, cgc_output.p_read.len );
+        if ( rc == 0 )
+            rc = sam_line_char( line, '\t' );
+    }
 
     /* SAM-FIELD: QUAL      SRA-column: SAM_QUALITY */
     if ( rc == 0 )
-        rc = print_quality_or_star( opts, cgc_output.p_quality.ptr, cgc_output.p_quality.len, cgc_output.p_read.len ); /* above */    
+    {
+        const uint8_t * quant_matrix = ( opts->qual_quant != NULL ) ? opts->qual_quant_matrix : NULL;
+        bool star = is_star_quality( cgc_output.p_quality.ptr, cgc_output.p_quality.len, cgc_output.p_read.len );
+        if ( bam != NULL )
+            rc = bam_rec_qual( bam, star ? NULL : cgc_output.p_quality.ptr, cgc_output.p_quality.len,
+                               33, quant_matrix, false ); /* bam_out.c */
+        else if ( star )
+            rc = sam_line_char( line, '*' );
+        else
+            rc = sam_line_qual_33( line, cgc_output.p_quality.ptr, cgc_output.p_quality.len, quant_matrix ); /* sam_line.c */
+    }
 
     /* OPT SAM-FIELD: RG     SRA-column: SPOT_GROUP */
     if ( rc == 0 && ( atx->cmn.seq_spot_group_idx != COL_NOT_AVAILABLE ) )
-        rc = opt_field_spot_group( cursor, atx->cmn.seq_spot_group_idx, id );
+        rc = opt_field_spot_group( line, bam, cursor, atx->cmn.seq_spot_group_idx, id );
 
     /* OPT SAM-FIELD: BZ     SRA-column: LINKAGE_GROUP */
     if ( rc == 0 && ( atx->lnk_group_idx != COL_NOT_AVAILABLE ) )
-        rc = opt_field_lnk_group( cursor, atx->lnk_group_idx, id );
+        rc = opt_field_lnk_group( line, bam, cursor, atx->lnk_group_idx, id );
 
     if ( rc == 0 && cgc_output.p_tags.len > 0 )
-        rc = KOutMsg( "\t%.*s", cgc_output.p_tags.len, cgc_output.p_tags.ptr );
+    {
+        if ( bam != NULL )
+            rc = bam_rec_tags_sam( bam, cgc_output.p_tags.ptr, cgc_output.p_tags.len ); /* bam_out.c */
+        else
+            rc = sam_line_tag_str( line, "", cgc_output.p_tags.ptr, cgc_output.p_tags.len );
+    }
 
     /* OPT SAM-FIELD: XI     SRA-column: ALIGN_ID */
     if ( rc == 0 && opts->print_alignment_id_in_column_xi )
-        rc = KOutMsg( "\tXI:i:%u", id );
+        rc = opt_field_u64( line, bam, "XI:i:", ( uint32_t )id );
 
     /* to match sam-tools output: in case we are dumping this in CG-mode.... */
     if ( rc == 0 && ( opts->cigar_treatment != ct_unchanged ) && ( atx->al_group_idx != COL_NOT_AVAILABLE ) )
@@ -1769,7 +1917,9 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
             {
                 if ( align_grp[ i ] == '_' )
                 {
-                    rc = KOutMsg( "\tZI:i:%.*s\tZA:i:%.1s", i, align_grp, align_grp + i + 1 );
+                    rc = opt_field_str( line, bam, "ZI:i:", align_grp, i );
+                    if ( rc == 0 )
+                        rc = opt_field_str( line, bam, "ZA:i:", align_grp + i + 1, 1 );
                     break;
                 }
             }
@@ -1783,12 +1933,12 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
         uint32_t al_count_len;
         rc = read_uint8_ptr( id, cursor, atx->cmn.al_count_idx, &al_count, &al_count_len, "ALIGNMENT_COUNT" );
         if ( rc == 0 && al_count_len > 0 )
-            rc = KOutMsg( "\tNH:i:%u", *al_count );
+            rc = opt_field_u64( line, bam, "NH:i:", *al_count );
     }
 
     /* OPT SAM-FIELD: NM     SRA-column: EDIT_DISTANCE */
     if ( rc == 0 )
-        rc = KOutMsg( "\tNM:i:%u", ( cgc_output.edit_dist - NM_adjustments ) );
+        rc = opt_field_u64( line, bam, "NM:i:", ( uint32_t )( cgc_output.edit_dist - NM_adjustments ) );
 
     /* OPT SAM-FIELD: XS:A:+/-  SRA-column: RNA-SPLICING detected via computation, or from the RNA_ORIENTATION - column */
     if ( rc == 0 )
@@ -1799,9 +1949,9 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
             if ( candidates.fwd_matched > 0 || candidates.rev_matched > 0 )
             {
                 if ( candidates.fwd_matched > 0 )
-                    rc = KOutMsg( "\tXS:A:+" );
+                    rc = opt_field_str( line, bam, "XS:A:", "+", 1 );
                 else 
-                    rc = KOutMsg( "\tXS:A:-" );
+                    rc = opt_field_str( line, bam, "XS:A:", "-", 1 );
             }
         }
         else
@@ -1815,7 +1965,7 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
                                     &rna_orientation, &rna_orientation_len, "RNA_ORIENTATION" );
                 if ( rc == 0 && rna_orientation_len > 0 )
                 {
-                    rc = KOutMsg( "\tXS:A:%c", rna_orientation[ 0 ] );
+                    rc = opt_field_str( line, bam, "XS:A:", rna_orientation, 1 );
                 }
             }
         }
@@ -1831,18 +1981,37 @@ static rc_t print_alignment_sam_ps( const samdump_opts * const opts,
         {
             INSDC_coord_len ref_len;
             rc = ReferenceObj_Read( rec->ref, pos, rec->len, alig_ref, &ref_len );
+            /* BAM: the line is not used for the record, the value is assembled there */
+            if ( rc == 0 && bam == NULL )
+                rc = sam_line_cstr( line, "\tMD:Z:" );
             if ( rc == 0 )
             {
-                rc = kout_md_tag_from_cigar_string( cgc_output.p_cigar.ptr, cgc_output.p_cigar.len, /* cigar */
-                        cgc_output.p_read.ptr, cgc_output.p_read.len,                               /* read */
-                        alig_ref, ref_len );                                                        /* reference */
+                size_t md_at = line->used;
+                rc = md_tag_from_cigar_string( line,                                        /* md_flag.c */
+                        cgc_output.p_cigar.ptr, cgc_output.p_cigar.len,                     /* cigar */
+                        cgc_output.p_read.ptr, cgc_output.p_read.len,                       /* read */
+                        alig_ref, ref_len );                                                /* reference */
+                if ( rc == 0 && bam != NULL )
+                {
+                    rc = bam_rec_tag_str( bam, "MD:Z:", line->buffer + md_at, line->used - md_at ); /* bam_out.c */
+                    line->used = 0;
+                }
             }
             free( alig_ref );
         }
     }
     
-    if ( rc == 0 )
-        rc = KOutMsg( "\n" );
+    if ( rc == 0 && bam != NULL )
+        rc = bam_rec_write( bam, sam_flags, ref_name, string_size( ref_name ), ( uint32_t )( pos + 1 ),
+                            ( uint32_t )rec->mapq, rnext, rnext_len, pnext, ( int32_t )tlen ); /* bam_out.c */
+    else if ( rc == 0 )
+    {
+        rc = sam_line_char( line, '\n' );
+        if ( rc == 0 )
+            rc = sam_line_write( line ); /* sam_line.c */
+    }
+    if ( rc != 0 )
+        line->used = 0;
 
     /* print a log-info if have to because RNA-splicing is requested and we have not homogeneous bits */
     if ( rna_not_homogeneous_flag )
@@ -2028,7 +2197,9 @@ static rc_t walk_position( const samdump_opts * const opts,
                             if ( atx->align_table_type == att_evidence )
                                 rc = print_alignment_sam_ev( opts, ref_name, pos, rec, atx );
                             else
-                                rc = print_alignment_sam_ps( opts, ref_name, pos, mc, splice_dict, rec, atx );
+                                rc = print_alignment_sam_ps( opts, &atx->line,
+                                            ( opts->output_compression == oc_bam ) ? &atx->bam : NULL,
+                                            ref_name, pos, mc, splice_dict, rec, atx );
                         }
                         else
                             rc = print_alignment_fastx( opts, ref_name, pos, mc, rec, atx );
@@ -2282,6 +2453,253 @@ static rc_t print_all_aligned_spots_0( const samdump_opts * const opts,
 }
 
 
+/*
+   strategy #1 with worker-threads ( --ref-threads ):
+   every reference of every input-file is a job, the workers dump different references concurrently.
+   Each worker has its own alignment-manager, reflists and matecache, its output is collected by
+   ordered_out.c and written by the main-thread in the order strategy #1 would have produced.
+   The same-ref matecache is cleared after each reference anyway, the half-aligned entries of the
+   workers are merged into the main matecache after all workers are done.
+*/
+
+#define REF_OUT_CHUNK_SIZE  ( 64 * 1024 )
+#define REF_OUT_MAX_QUEUED  256
+
+typedef struct ref_job
+{
+    const input_database * ids;
+    uint32_t ref_idx;
+} ref_job;
+
+
+typedef struct ref_worker
+{
+    const samdump_opts * opts;
+    const ref_job * jobs;
+    struct ordered_out * out;
+    const AlignMgr * a_mgr;
+    const ReferenceList ** reflists;    /* one per input-database */
+    uint32_t reflist_count;
+    matecache * mc;
+    KThread * thread;
+} ref_worker;
+
+
+static rc_t CC ref_worker_thread( const KThread * self, void * data )
+{
+    ref_worker * w = data;
+    rc_t rc = 0;
+    uint32_t job;
+
+    while ( rc == 0 && ordered_out_next_job( w->out, &job ) )
+    {
+        const ref_job * rj = &w->jobs[ job ];
+        const ReferenceObj * ref_obj;
+
+        ordered_out_set_thread_job( w->out, job ); /* KOutMsg() of this thread goes into this job */
+        rc = ReferenceList_Get( w->reflists[ rj->ids->db_idx ], &ref_obj, rj->ref_idx );
+        if ( rc == 0 && ref_obj != NULL )
+        {
+            rc = print_all_aligned_spots_of_this_reference( w->opts, rj->ids, w->mc, w->a_mgr, ref_obj );
+            ReferenceObj_Release( ref_obj );
+        }
+        ordered_out_set_thread_job( NULL, 0 );
+        rc = ordered_out_job_done( w->out, job, rc ); /* ordered_out.c */
+    }
+    return rc;
+}
+
+
+static void release_ref_worker( ref_worker * w )
+{
+    uint32_t idx;
+    if ( w->reflists != NULL )
+    {
+        for ( idx = 0; idx < w->reflist_count; ++idx )
+            ReferenceList_Release( w->reflists[ idx ] );
+        free( w->reflists );
+    }
+    release_matecache( w->mc );
+    AlignMgrRelease( w->a_mgr );
+}
+
+
+/* all resources of a worker are made on the main-thread, the worker only opens its cursors */
+static rc_t init_ref_worker( ref_worker * w, const samdump_opts * const opts,
+                             const input_files * const ifs, const matecache * const mc )
+{
+    rc_t rc = AlignMgrMakeRead( &w->a_mgr );
+    if ( rc != 0 )
+    {
+        (void)LOGERR( klogErr, rc, "cannot create alignment-manager" );
+    }
+    else if ( mc != NULL )
+    {
+        rc = make_matecache( &w->mc, mc->count, mc->min_dist ); /* matecache.c */
+    }
+
+    if ( rc == 0 )
+    {
+        w->reflists = calloc( ifs->database_count + 1, sizeof w->reflists[ 0 ] );
+        if ( w->reflists == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            (void)LOGERR( klogErr, rc, "cannot create reflists for worker-thread" );
+        }
+        else
+        {
+            uint32_t db_idx;
+            w->reflist_count = ifs->database_count;
+            for ( db_idx = 0; db_idx < ifs->database_count && rc == 0; ++db_idx )
+            {
+                const input_database * ids = VectorGet( &ifs->dbs, db_idx );
+                if ( ids != NULL )
+                {
+                    rc = ReferenceList_MakeDatabase( &w->reflists[ ids->db_idx ], ids->db,
+                                                     ids->reflist_options, 0, NULL, 0 );
+                    if ( rc != 0 )
+                    {
+                        (void)PLOGERR( klogErr, ( klogErr, rc, "cannot create reflist for '$(t)'", "t=%s", ids->path ) );
+                    }
+                }
+            }
+        }
+    }
+    return rc;
+}
+
+
+static rc_t collect_ref_jobs( const input_files * const ifs, ref_job ** jobs, uint32_t * job_count )
+{
+    rc_t rc = 0;
+    uint32_t db_idx, count = 0;
+
+    *jobs = NULL;
+    for ( db_idx = 0; db_idx < ifs->database_count && rc == 0; ++db_idx )
+    {
+        const input_database * ids = VectorGet( &ifs->dbs, db_idx );
+        if ( ids != NULL )
+        {
+            uint32_t refobj_count;
+            rc = ReferenceList_Count( ids->reflist, &refobj_count );
+            if ( rc == 0 )
+                count += refobj_count;
+        }
+    }
+
+    if ( rc == 0 )
+    {
+        *jobs = calloc( count + 1, sizeof **jobs );
+        if ( *jobs == NULL )
+        {
+            rc = RC( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            (void)LOGERR( klogErr, rc, "cannot create list of references" );
+        }
+        else
+        {
+            count = 0;
+            for ( db_idx = 0; db_idx < ifs->database_count && rc == 0; ++db_idx )
+            {
+                const input_database * ids = VectorGet( &ifs->dbs, db_idx );
+                if ( ids != NULL )
+                {
+                    uint32_t ref_idx, refobj_count;
+                    rc = ReferenceList_Count( ids->reflist, &refobj_count );
+                    for ( ref_idx = 0; ref_idx < refobj_count && rc == 0; ++ref_idx )
+                    {
+                        ( *jobs )[ count ].ids = ids;
+                        ( *jobs )[ count ].ref_idx = ref_idx;
+                        count++;
+                    }
+                }
+            }
+        }
+    }
+    *job_count = count;
+    return rc;
+}
+
+
+static rc_t print_all_aligned_spots_mt( const samdump_opts * const opts,
+                                        const input_files * const ifs,
+                                        matecache * const mc )
+{
+    ref_job * jobs;
+    uint32_t job_count;
+    rc_t rc = collect_ref_jobs( ifs, &jobs, &job_count );
+    if ( rc == 0 && job_count > 0 )
+    {
+        struct ordered_out * out;
+        rc = make_ordered_out( &out, job_count, REF_OUT_CHUNK_SIZE, REF_OUT_MAX_QUEUED ); /* ordered_out.c */
+        if ( rc == 0 )
+        {
+            uint32_t worker_count = ( opts->ref_threads < job_count ) ? opts->ref_threads : job_count;
+            ref_worker * workers = calloc( worker_count, sizeof *workers );
+            if ( workers == NULL )
+            {
+                rc = RC( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+                (void)LOGERR( klogErr, rc, "cannot create worker-threads" );
+            }
+            else
+            {
+                uint32_t idx, started = 0;
+                for ( idx = 0; idx < worker_count && rc == 0; ++idx )
+                {
+                    workers[ idx ].opts = opts;
+                    workers[ idx ].jobs = jobs;
+                    workers[ idx ].out = out;
+                    rc = init_ref_worker( &workers[ idx ], opts, ifs, mc );
+                }
+
+                if ( rc == 0 )
+                    rc = ordered_out_capture( out );
+
+                for ( idx = 0; idx < worker_count && rc == 0; ++idx )
+                {
+                    rc = KThreadMake( &workers[ idx ].thread, ref_worker_thread, &workers[ idx ] );
+                    if ( rc != 0 )
+                        (void)LOGERR( klogErr, rc, "cannot start worker-thread" );
+                    else
+                        started++;
+                }
+                if ( rc != 0 )
+                    ordered_out_abort( out, rc );
+
+                if ( started > 0 )
+                {
+                    /* the main-thread writes the output of the workers in order */
+                    rc_t rc1 = ordered_out_merge( out );
+                    if ( rc == 0 )
+                        rc = rc1;
+                }
+
+                for ( idx = 0; idx < started; ++idx )
+                {
+                    rc_t status;
+                    rc_t rc1 = KThreadWait( workers[ idx ].thread, &status );
+                    if ( rc1 == 0 )
+                        rc1 = status;
+                    if ( rc == 0 )
+                        rc = rc1;
+                    KThreadRelease( workers[ idx ].thread );
+                }
+
+                for ( idx = 0; idx < worker_count; ++idx )
+                {
+                    if ( rc == 0 && mc != NULL && workers[ idx ].mc != NULL )
+                        rc = matecache_merge( mc, workers[ idx ].mc ); /* matecache.c */
+                    release_ref_worker( &workers[ idx ] );
+                }
+                free( workers );
+            }
+            release_ordered_out( out );
+        }
+    }
+    free( jobs );
+    return rc;
+}
+
+
 /*
    the user did not specify regions, print all alignments from all input-files
    this is strategy #2 to do this, throw all iterators for all input-files and all there references
@@ -2387,7 +2805,14 @@ rc_t print_aligned_spots( const samdump_opts * const opts,
             /* the user did not specify regions to be printed ==> print all alignments */
             switch( opts->dump_mode )
             {
-                case dm_one_ref_at_a_time : rc = print_all_aligned_spots_0( opts, ifs, mc, a_mgr ); break;
+                case dm_one_ref_at_a_time :
+                    /* the rna-splice-log and the perf-log are written per reference,
+                       they cannot be shared by the worker-threads */
+                    if ( opts->ref_threads > 1 && opts->rna_splice_log == NULL && opts->perf_log == NULL )
+                        rc = print_all_aligned_spots_mt( opts, ifs, mc );
+                    else
+                        rc = print_all_aligned_spots_0( opts, ifs, mc, a_mgr );
+                    break;
                 case dm_prepare_all_refs  : rc = print_all_aligned_spots_1( opts, ifs, mc, a_mgr ); break;
             }
         }
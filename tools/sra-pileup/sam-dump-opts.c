@@ -919,6 +919,8 @@ static rc_t get_int64_option( Args * args, const char * name, uint64_t def, uint
 static rc_t gather_int_options( Args * args, samdump_opts * opts )
 {
     rc_t rc = get_uint32_option( args, OPT_MATE_GAP, 10000, &opts->mape_gap_cache_limit, true );
+    if ( rc == 0 )
+        rc = get_uint32_option( args, OPT_MATE_MIN_DIST, 10000, &opts->mate_cache_min_dist, false );
     if ( rc == 0 )
         rc = get_uint32_option( args, OPT_OUTBUFSIZE, 1024 * 32, &opts->output_buffer_size, false );
 
@@ -951,6 +953,15 @@ static rc_t gather_int_options( Args * args, samdump_opts * opts )
     if ( rc == 0 )
         rc = get_uint32_option( args, OPT_RNA_SPLICEL, 0, &opts->rna_splice_level, true );
 
+    if ( rc == 0 )
+        rc = get_uint32_option( args, OPT_BAM_THREADS, 4, &opts->bam_threads, false );
+
+    if ( rc == 0 )
+        rc = get_uint32_option( args, OPT_REF_THREADS, 1, &opts->ref_threads, true );
+
+    if ( rc == 0 && opts->no_mt )
+        opts->ref_threads = 1;
+
     return rc;
 }
 
@@ -1253,6 +1264,7 @@ void report_options( const samdump_opts * opts )
         case oc_none  : KOutMsg( "output-compression    : none\n" ); break;
         case oc_gzip  : KOutMsg( "output-compression    : gzip\n" ); break;
         case oc_bzip2 : KOutMsg( "output-compression    : bzip2\n" ); break;
+        case oc_bam   : KOutMsg( "output-compression    : BAM ( %u threads )\n", opts->bam_threads ); break;
         default       : KOutMsg( "output-compression    : unknown\n" ); break;
     }
 
@@ -1336,6 +1348,7 @@ void report_options( const samdump_opts * opts )
     }
 
     KOutMsg( "mate-gap-cache-limit  : %u\n",  opts->mape_gap_cache_limit );
+    KOutMsg( "mate-cache-min-dist   : %u\n",  opts->mate_cache_min_dist );
     KOutMsg( "outputfile            : %s\n",  opts->outputfile );
     KOutMsg( "outputbuffer-size     : %u\n",  opts->output_buffer_size );
     KOutMsg( "cursor-cache-size     : %u\n",  opts->cursor_cache_size );
@@ -1349,6 +1362,7 @@ void report_options( const samdump_opts * opts )
     KOutMsg( "rna-splice-log        : %s\n",  opts->rna_splice_log_file );
 
     KOutMsg( "multithreading        : %s\n",  opts->no_mt ? "NO" : "YES" );  
+    KOutMsg( "ref-threads           : %u\n",  opts->ref_threads );
     KOutMsg( "with-MD-flag          : %s\n",  opts->with_md_flag ? "NO" : "YES" );
 	
 #if _DEBUGGING
@@ -1396,6 +1410,62 @@ void release_options( samdump_opts * opts )
 /* =========================================================================================== */
 
 
+/* BAM-records are encoded from the column-values ( sam-aligned.c, sam-unaligned.c ), everything that
+   is not SAM cannot be combined with it, neither can the CG-evidence modes: they still print text */
+static rc_t gather_bam_options( Args * args, samdump_opts * opts )
+{
+    bool bam;
+    rc_t rc = get_bool_option( args, OPT_BAM, &bam );
+    if ( rc == 0 && bam )
+    {
+        const char * s;
+
+        if ( opts->output_compression != oc_none || opts->output_format != of_sam )
+        {
+            rc = RC( rcExe, rcArgv, rcProcessing, rcParam, rcInvalid );
+            (void)LOGERR( klogErr, rc, "--bam cannot be combined with --gzip, --bzip2, --fasta or --fastq" );
+        }
+        else if ( opts->header_mode == hm_none || opts->report_cache )
+        {
+            rc = RC( rcExe, rcArgv, rcProcessing, rcParam, rcInvalid );
+            (void)LOGERR( klogErr, rc, "--bam needs the header and cannot be combined with --cachereport" );
+        }
+        else if ( opts->dump_cg_evidence || opts->dump_cg_ev_dnb || opts->dump_cg_sam )
+        {
+            rc = RC( rcExe, rcArgv, rcProcessing, rcParam, rcInvalid );
+            (void)LOGERR( klogErr, rc, "--bam cannot be combined with --CG-evidence, --CG-ev-dnb or --CG-SAM" );
+        }
+        else
+            opts->output_compression = oc_bam;
+
+        if ( rc == 0 )
+            rc = get_str_option( args, OPT_BAM_INDEX, &s );
+        if ( rc == 0 && s != NULL )
+        {
+            size_t len = string_size( s );
+            if ( string_cmp( s, len, "bai", 3, 4 ) == 0 )
+                opts->bam_index = bi_bai;
+            else if ( string_cmp( s, len, "csi", 3, 4 ) == 0 )
+                opts->bam_index = bi_csi;
+            else
+            {
+                rc = RC( rcExe, rcArgv, rcProcessing, rcParam, rcInvalid );
+                (void)PLOGERR( klogErr, ( klogErr, rc, "unknown bam-index '$(t)'", "t=%s", s ) );
+            }
+            if ( rc == 0 && opts->outputfile == NULL )
+            {
+                rc = RC( rcExe, rcArgv, rcProcessing, rcParam, rcInvalid );
+                (void)LOGERR( klogErr, rc, "--bam-index needs --output-file" );
+            }
+        }
+
+        if ( opts->no_mt )
+            opts->bam_threads = 0;
+    }
+    return rc;
+}
+
+
 rc_t gather_options( Args * args, samdump_opts * opts )
 {
     rc_t rc = gather_region_options( args, opts );
@@ -1407,6 +1477,8 @@ rc_t gather_options( Args * args, samdump_opts * opts )
         rc = gather_int_options( args, opts );
     if ( rc == 0 )
         rc = gather_matepair_distances( args, opts );
+    if ( rc == 0 )
+        rc = gather_bam_options( args, opts );
     if ( rc == 0 )
         gather_unaligned_options( opts );
     return rc;
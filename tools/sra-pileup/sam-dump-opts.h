@@ -91,6 +91,7 @@ extern "C" {
 #define OPT_DUMP_MODE   "dump-mode"
 #define OPT_MIN_MAPQ    "min-mapq"
 #define OPT_NO_MATE_CACHE "no-mate-cache"
+#define OPT_MATE_MIN_DIST "mate-cache-min-dist"
 #define OPT_LEGACY      "legacy"
 #define OPT_NEW         "new"
 #define OPT_RNA_SPLICE  "rna-splicing"
@@ -100,6 +101,10 @@ extern "C" {
 #define OPT_TIMING      "timing"
 #define OPT_MD_FLAG     "with-md-flag"
 #define OPT_NGC         "ngc"
+#define OPT_BAM         "bam"
+#define OPT_BAM_INDEX   "bam-index"
+#define OPT_BAM_THREADS "bam-threads"
+#define OPT_REF_THREADS "ref-threads"
 
 typedef struct range
 {
@@ -135,7 +140,15 @@ enum output_compression
 {
     oc_none = 0,    /* do not compress output */
     oc_gzip,        /* compress output with gzip */
-    oc_bzip2        /* compress output with bzip2 */
+    oc_bzip2,       /* compress output with bzip2 */
+    oc_bam          /* encode the SAM-output as BAM */
+};
+
+enum bam_index
+{
+    bi_none = 0,    /* do not index the BAM-output */
+    bi_bai,         /* write a BAI-index next to the output-file */
+    bi_csi          /* write a CSI-index next to the output-file */
 };
 
 enum cigar_treatment
@@ -207,6 +220,9 @@ typedef struct samdump_opts
     /* mate's farther apart than this are not cached */
     uint32_t mape_gap_cache_limit;
 
+    /* mate's closer than this ( in bases ) are always cached */
+    uint32_t mate_cache_min_dist;
+
     size_t cursor_cache_size;
 
     /* how the sam-headers are treated */
@@ -221,6 +237,15 @@ typedef struct samdump_opts
     /* should the output be compressed / in which format */
     enum output_compression output_compression;
 
+    /* index the BAM-output */
+    enum bam_index bam_index;
+
+    /* threads for the BGZF-compression of BAM-output */
+    uint32_t bam_threads;
+
+    /* threads dumping the aligned reads of different references concurrently */
+    uint32_t ref_threads;
+
     /* how to process in case of: aligned reads requested + no regions given */
     enum dump_mode dump_mode;
 
@@ -150,6 +150,10 @@ char const *sd_min_mapq_usage[]       = { "min. mapq an alignment has to have, t
 char const *sd_no_mate_cache_usage[]  = { "do not use a mate-cache, slower but less memory usage",
                                        NULL };
 
+char const *sd_mate_min_dist_usage[]  = { "mates closer than this on the reference are always cached,",
+                                          "farther ones only if they are within the observed distances (dflt:10000)",
+                                       NULL };
+
 char const *rna_splice_usage[]        = { "modify cigar-string (replace .D. with .N.) and add output flags (XS:A:+/-) ",
                                            "when rna-splicing is detected by match to spliceosome recognition sites",
                                        NULL };
@@ -168,6 +172,16 @@ char const *with_md_flag_usage[]      = { "print MD-flag", NULL };
                             
 char const *ngc_usage[]               = { "PATH to ngc file", NULL };
 
+char const *bam_usage[]               = { "Produce BAM ( BGZF-compressed ) output", NULL };
+
+char const *bam_index_usage[]         = { "write a bai- or csi-index of the BAM-output next to the output-file",
+                                          "( needs --output-file and coordinate-sorted output )", NULL };
+
+char const *bam_threads_usage[]       = { "threads compressing the BAM-output (dflt:4)", NULL };
+
+char const *ref_threads_usage[]       = { "threads dumping references concurrently (dflt:1)",
+                                          "( output-order is unchanged, needs more memory )", NULL };
+
 OptDef SamDumpArgs[] =
 {
     { OPT_UNALIGNED,     "u", NULL, sd_unaligned_usage,      0, false, false },  /* print unaligned reads */
@@ -206,6 +220,7 @@ OptDef SamDumpArgs[] =
     { OPT_CURSOR_CACHE, NULL, NULL, sd_cur_cache_usage,      0, true,  false },  /* size of cursor cache */
     { OPT_MIN_MAPQ,     NULL, NULL, sd_min_mapq_usage,       0, true,  false },  /* minimal mapping quality */
     { OPT_NO_MATE_CACHE,NULL, NULL, sd_no_mate_cache_usage,  0, false, false },  /* do not use mate-cache */
+    { OPT_MATE_MIN_DIST,NULL, NULL, sd_mate_min_dist_usage,  0, true,  false },  /* bases, mates closer than this are always cached */
     { OPT_RNA_SPLICE,   NULL, NULL, rna_splice_usage,        0, false, false },  /* detect rna-splicing in sequence */
     { OPT_RNA_SPLICEL,  NULL, NULL, rna_splicel_usage,       0, true,  false },  /* level of rna-splicing detection */
     { OPT_RNA_SPLICE_LOG,  NULL, NULL, rna_splice_log_usage, 0, true,  false },  /* filename to log rna-splice events into */
@@ -216,6 +231,10 @@ OptDef SamDumpArgs[] =
     { OPT_LEGACY,       NULL, NULL, NULL,                    0, false, false },  /* force legacy code-path */
     { OPT_NEW,          NULL, NULL, NULL,                    0, false, false },   /* force new code-path */
     { OPT_NGC,          NULL, NULL, ngc_usage, 0, true, false },  /* ngc file */
+    { OPT_BAM,          NULL, NULL, bam_usage,               0, false, false },  /* output-format = BAM */
+    { OPT_BAM_INDEX,    NULL, NULL, bam_index_usage,         0, true,  false },  /* index the BAM-output */
+    { OPT_BAM_THREADS,  NULL, NULL, bam_threads_usage,       0, true,  false },  /* threads compressing BAM */
+    { OPT_REF_THREADS,  NULL, NULL, ref_threads_usage,       0, true,  false },  /* threads dumping references */
     { OPT_TIMING,       NULL, NULL, NULL,                    0, true, false }    /* optional timing */
 };
 
@@ -257,6 +276,7 @@ char const *sd_usage_params[] =
     NULL,                       /* cursor cache */
     NULL,                       /* min_mapq */
     NULL,                       /* no mate-cache */
+    "bases",                    /* mate-cache-min-dist */
     NULL,                       /* detect rna-splicing in sequence */
     NULL,                       /* level of rna-splicing detection */
     NULL,                       /* file to log rna-splice-events into */
@@ -267,6 +287,10 @@ char const *sd_usage_params[] =
     NULL,                       /* force legacy code path */
     NULL,                       /* force new code path */
     "PATH",                     /* ngc file */
+    NULL,                       /* bam */
+    "bai|csi",                  /* bam-index */
+    "count",                    /* bam-threads */
+    "count",                    /* ref-threads */
     NULL                        /* optional timing */
 };
 
@@ -388,7 +412,7 @@ static rc_t print_samdump( const samdump_opts * const opts )
                         matecache * mc = NULL;
 
                         if ( opts->use_mate_cache )
-                            rc = make_matecache( &mc, ifs->database_count );
+                            rc = make_matecache( &mc, ifs->database_count, opts->mate_cache_min_dist );
 
                         if ( rc == 0 )
                         {
@@ -469,16 +493,35 @@ static rc_t samdump_main( Args * args, const samdump_opts * const opts )
 {
     rc_t rc = 0;
     out_redir redir; /* from out_redir.h */
-    enum out_redir_mode mode;
+    enum out_redir_mode mode = orm_uncompressed;
 
     switch( opts->output_compression )
     {
         case oc_none  : mode = orm_uncompressed; break;
         case oc_gzip  : mode = orm_gzip; break;
         case oc_bzip2 : mode = orm_bzip2; break;
+        case oc_bam   : mode = orm_uncompressed; break;
     }
 
-    rc = init_out_redir( &redir, mode, opts->outputfile, opts->output_buffer_size ); /* from out_redir.c */
+    if ( opts->output_compression == oc_bam && !opts->report_options && opts->cigar_test == NULL )
+    {
+        enum bam_out_index index_type = boi_none;
+        char index_path[ 4096 ];
+
+        index_path[ 0 ] = 0;
+        if ( opts->bam_index != bi_none )
+        {
+            size_t num_writ;
+            index_type = ( opts->bam_index == bi_csi ) ? boi_csi : boi_bai;
+            rc = string_printf( index_path, sizeof index_path, &num_writ, "%s.%s",
+                                opts->outputfile, ( opts->bam_index == bi_csi ) ? "csi" : "bai" );
+        }
+        if ( rc == 0 )
+            rc = init_out_redir_bam( &redir, opts->outputfile, opts->output_buffer_size,
+                                     opts->bam_threads, index_type, index_path ); /* from out_redir.c */
+    }
+    else
+        rc = init_out_redir( &redir, mode, opts->outputfile, opts->output_buffer_size ); /* from out_redir.c */
     if ( rc == 0 )
     {
         if ( opts->report_options )
@@ -504,6 +547,8 @@ static rc_t samdump_main( Args * args, const samdump_opts * const opts )
             /* ------------------------------------------------------ */
             }
         }
+        if ( rc == 0 )
+            rc = finish_out_redir( &redir ); /* from out_redir.c */
         release_out_redir( &redir ); /* from out_redir.c */
     }
     return rc;
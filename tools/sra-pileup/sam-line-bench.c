@@ -0,0 +1,258 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+
+/*--------------------------------------------------------------------------
+ * sam-line-bench
+ *  times the record-formatter sam_line against formatting the same record
+ *  field by field via KOutMsg() ( the way sam-aligned.c printed records
+ *  before ), and checks that both produce the same bytes: exits non-zero
+ *  if they do not
+ */
+
+#include "sam_line.h"
+
+#include <klib/out.h>
+#include <klib/text.h>
+#include <klib/time.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_READ_LEN 100
+
+typedef struct bench_record
+{
+    int64_t spot_id;
+    uint32_t flags;
+    const char * ref_name;
+    uint32_t pos;
+    int32_t mapq;
+    const char * cigar;
+    uint32_t mate_pos;
+    int32_t tlen;
+    char read[ BENCH_READ_LEN ];
+    char qual[ BENCH_READ_LEN ];
+    const char * spot_group;
+    uint32_t nh;
+    uint32_t nm;
+} bench_record;
+
+
+/* the output is not kept, only counted and hashed ( FNV-1a ) to compare the formatters */
+typedef struct bench_sink
+{
+    uint64_t bytes;
+    uint64_t hash;
+} bench_sink;
+
+
+static rc_t CC bench_writer( void * self, const char * buffer, size_t bufsize, size_t * num_writ )
+{
+    bench_sink * sink = self;
+    size_t i;
+    for ( i = 0; i < bufsize; ++i )
+    {
+        sink->hash ^= ( uint8_t )buffer[ i ];
+        sink->hash *= 1099511628211ULL;
+    }
+    sink->bytes += bufsize;
+    *num_writ = bufsize;
+    return 0;
+}
+
+
+static rc_t bench_kout_msg( const bench_record * r )
+{
+    rc_t rc = KOutMsg( "%lu", r->spot_id );
+    if ( rc == 0 )
+        rc = KOutMsg( "\t" );
+    if ( rc == 0 )
+        rc = KOutMsg( "%u\t%s\t%u\t%d\t", r->flags, r->ref_name, r->pos, r->mapq );
+    if ( rc == 0 )
+        rc = KOutMsg( "%.*s\t", ( uint32_t )string_size( r->cigar ), r->cigar );
+    if ( rc == 0 )
+        rc = KOutMsg( "%.*s\t%u\t%d\t", 1, "=", r->mate_pos, r->tlen );
+    if ( rc == 0 )
+        rc = KOutMsg( "%.*s\t", BENCH_READ_LEN, r->read );
+    if ( rc == 0 )
+        rc = KOutMsg( "%.*s", BENCH_READ_LEN, r->qual );
+    if ( rc == 0 )
+        rc = KOutMsg( "\tRG:Z:%.*s", ( uint32_t )string_size( r->spot_group ), r->spot_group );
+    if ( rc == 0 )
+        rc = KOutMsg( "\tNH:i:%u", r->nh );
+    if ( rc == 0 )
+        rc = KOutMsg( "\tNM:i:%u", r->nm );
+    if ( rc == 0 )
+        rc = KOutMsg( "\n" );
+    return rc;
+}
+
+
+static rc_t bench_sam_line( sam_line * line, const bench_record * r )
+{
+    rc_t rc = sam_line_u64( line, r->spot_id );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_u64( line, r->flags );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_cstr( line, r->ref_name );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_u64( line, r->pos );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_i64( line, r->mapq );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_cstr( line, r->cigar );
+    if ( rc == 0 )
+        rc = sam_line_str( line, "\t=\t", 3 );
+    if ( rc == 0 )
+        rc = sam_line_u64( line, r->mate_pos );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_i64( line, r->tlen );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_str( line, r->read, BENCH_READ_LEN );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_qual_33( line, r->qual, BENCH_READ_LEN, NULL );
+    if ( rc == 0 )
+        rc = sam_line_tag_str( line, "RG:Z:", r->spot_group, string_size( r->spot_group ) );
+    if ( rc == 0 )
+        rc = sam_line_tag_u64( line, "NH:i:", r->nh );
+    if ( rc == 0 )
+        rc = sam_line_tag_u64( line, "NM:i:", r->nm );
+    if ( rc == 0 )
+        rc = sam_line_char( line, '\n' );
+    if ( rc == 0 )
+        rc = sam_line_write( line );
+    return rc;
+}
+
+
+static void bench_init_record( bench_record * r )
+{
+    static const char bases[] = "ACGT";
+    uint32_t i;
+    r->spot_id = 123456789;
+    r->flags = 99;
+    r->ref_name = "NC_000001.11";
+    r->pos = 152348765;
+    r->mapq = 60;
+    r->cigar = "37M2I61M";
+    r->mate_pos = 152349012;
+    r->tlen = 347;
+    for ( i = 0; i < BENCH_READ_LEN; ++i )
+    {
+        r->read[ i ] = bases[ ( i * 7 ) & 3 ];
+        r->qual[ i ] = ( char )( 33 + 20 + ( i % 21 ) );
+    }
+    r->spot_group = "SRR000001.lane1";
+    r->nh = 1;
+    r->nm = 3;
+}
+
+
+static void bench_report( const char * name, uint32_t count, KTimeMs_t ms, const bench_sink * sink )
+{
+    printf( "%s: %u records, %lu bytes, %lu ms", name, count, ( unsigned long )sink->bytes, ( unsigned long )ms );
+    if ( ms > 0 )
+        printf( ", %lu records/sec", ( unsigned long )( ( uint64_t )count * 1000 / ms ) );
+    printf( "\n" );
+}
+
+
+int main( int argc, char * argv[] )
+{
+    rc_t rc;
+    uint32_t count = ( argc > 1 ) ? ( uint32_t )strtoul( argv[ 1 ], NULL, 0 ) : 200000;
+    bench_sink kout_sink = { 0, 14695981039346656037ULL };
+    bench_sink line_sink = kout_sink;
+    KTimeMs_t start, kout_ms = 0, line_ms = 0;
+    bench_record r;
+    sam_line line;
+    uint32_t i;
+
+    if ( count == 0 )
+    {
+        printf( "Usage: %s [ count ]\n", argv[ 0 ] );
+        return 1;
+    }
+
+    bench_init_record( &r );
+    init_sam_line( &line );
+
+    rc = KOutHandlerSet( bench_writer, &kout_sink );
+    start = KTimeMsStamp();
+    for ( i = 0; rc == 0 && i < count; ++i )
+    {
+        r.spot_id++;
+        rc = bench_kout_msg( &r );
+    }
+    kout_ms = KTimeMsStamp() - start;
+
+    /* the same spot-ids again, the output has to be identical */
+    r.spot_id -= count;
+    if ( rc == 0 )
+        rc = KOutHandlerSet( bench_writer, &line_sink );
+    start = KTimeMsStamp();
+    for ( i = 0; rc == 0 && i < count; ++i )
+    {
+        r.spot_id++;
+        rc = bench_sam_line( &line, &r );
+    }
+    line_ms = KTimeMsStamp() - start;
+
+    release_sam_line( &line );
+
+    if ( rc != 0 )
+    {
+        printf( "formatting failed, rc = %u\n", rc );
+        return 1;
+    }
+
+    bench_report( "KOutMsg ", count, kout_ms, &kout_sink );
+    bench_report( "sam_line", count, line_ms, &line_sink );
+
+    if ( kout_sink.bytes != line_sink.bytes || kout_sink.hash != line_sink.hash )
+    {
+        printf( "the formatters produced DIFFERENT output\n" );
+        return 1;
+    }
+    return 0;
+}
@@ -26,7 +26,9 @@
 
 #include "read_fkt.h"
 #include "sam-unaligned.h"
+#include "bam_out.h"
 #include <kapp/main.h>
+#include <klib/printf.h>
 #include <sysalloc.h>
 #include <ctype.h>
 
@@ -107,6 +109,9 @@ typedef struct seq_table_ctx
     uint32_t spot_group_idx;
     uint32_t name_idx;
     uint32_t lnk_group_idx;
+
+    bam_rec rec;
+    bam_rec * bam;      /* &rec for BAM-output, NULL for SAM-text */
 } seq_table_ctx;
 
 
@@ -116,6 +121,11 @@ static rc_t prepare_seq_table_ctx( const samdump_opts * const opts,
 {
     struct KNamelist * available_columns;
     rc_t rc = VTableListReadableColumns ( itab->tab, &available_columns );
+    init_bam_rec( &stx->rec ); /* bam_out.c */
+    if ( opts->output_format == of_sam && opts->output_compression == oc_bam )
+        stx->bam = &stx->rec;
+    else
+        stx->bam = NULL;
     if ( rc != 0 )
     {
         (void)PLOGERR( klogInt, ( klogInt, rc, 
@@ -159,6 +169,13 @@ static rc_t prepare_seq_table_ctx( const samdump_opts * const opts,
 }
 
 
+static void release_seq_table_ctx( seq_table_ctx * const stx )
+{
+    VCursorRelease( stx->cursor );
+    release_bam_rec( &stx->rec ); /* bam_out.c */
+}
+
+
 typedef struct seq_row
 {
     uint32_t nreads;
@@ -425,16 +442,24 @@ static rc_t print_sliced_quality( const samdump_opts * const opts,
 }
 
 
-static rc_t dump_the_other_read( const seq_table_ctx * const stx,
-                                 const prim_table_ctx * const ptx,
-                                 const int64_t row_id,
-                                 const uint32_t mate_idx )
+/* RNEXT / PNEXT from the PRIMARY_ALIGNMENT-table, '*' and 0 if the mate is not aligned */
+static rc_t get_the_other_read( const seq_table_ctx * const stx,
+                                const prim_table_ctx * const ptx,
+                                const int64_t row_id,
+                                const uint32_t mate_idx,
+                                const char ** mate_ref_name,
+                                uint32_t * const mate_ref_name_len,
+                                int64_t * const mate_ref_pos )
 {
     uint32_t row_len;
     const int64_t *prim_al_id_ptr;
 
     /* read from the SEQUENCE-table the value of the colum "PRIMARY_ALIGNMENT_ID"[ mate_idx ] */
     rc_t rc = read_int64_ptr( row_id, stx->cursor, stx->prim_al_id_idx, &prim_al_id_ptr, &row_len, "PRIM_AL_ID" );
+
+    *mate_ref_name = ref_name_star;
+    *mate_ref_name_len = 1;
+    *mate_ref_pos = 0;
     if ( rc == 0 )
     {
         if ( row_len == 0 )
@@ -449,11 +474,7 @@ static rc_t dump_the_other_read( const seq_table_ctx * const stx,
         {
             /* read from the PRIMARY_ALIGNMENT_TABLE the value of the columns "REF_NAME" and "REF_POS" */
             int64_t a_row_id = prim_al_id_ptr[ mate_idx ];
-            if ( a_row_id == 0 )
-            {
-                rc = KOutMsg( "*\t0\t" );
-            }
-            else
+            if ( a_row_id != 0 )
             {
                 const char * ref_name;
                 uint32_t ref_name_len;
@@ -470,7 +491,9 @@ static rc_t dump_the_other_read( const seq_table_ctx * const stx,
                         rc = read_INSDC_coord_zero_ptr( a_row_id, ptx->cursor, ptx->ref_pos_idx, &ref_pos, &row_len, "REF_POS" );
                         if ( rc == 0 )
                         {
-                            rc = KOutMsg( "%.*s\t%i\t", ref_name_len, ref_name, ref_pos[ 0 ] + 1 );
+                            *mate_ref_name = ref_name;
+                            *mate_ref_name_len = ref_name_len;
+                            *mate_ref_pos = ref_pos[ 0 ] + 1;
                         }
                     }
                 }
@@ -566,13 +589,52 @@ static bool calc_reverse_flag( const samdump_opts * const opts,
 }
 
 
+/* the fields of one unaligned record, collected by the dump_seq_..._sam() - functions */
+typedef struct unaligned_rec
+{
+    int64_t row_id;                     /* in the SEQUENCE-table */
+    int64_t spot_id;                    /* QNAME if there is no name */
+    const char * name;                  /* QNAME from the NAME-column, if available */
+    uint32_t name_len;
+    const char * spot_group;            /* appended to QNAME, if requested */
+    uint32_t spot_group_len;
+    uint32_t sam_flags;
+    bool mate_unknown;                  /* RNEXT and PNEXT are '0', no PRIMARY_ALIGNMENT-table */
+    const char * mate_ref_name;         /* RNEXT */
+    uint32_t mate_ref_name_len;
+    int64_t mate_ref_pos;               /* PNEXT, 1-based */
+    const INSDC_dna_text * read;        /* SEQ and QUAL, sliced by READ_START / READ_LEN */
+    const char * quality;
+    const INSDC_coord_zero * read_start;
+    const INSDC_coord_len * read_len;
+    uint32_t read_idx;
+    bool reverse;
+} unaligned_rec;
+
+
+static void init_unaligned_rec( unaligned_rec * r, const int64_t row_id, const uint32_t read_idx )
+{
+    memset( r, 0, sizeof *r );
+    r->row_id = row_id;
+    r->spot_id = row_id;
+    r->read_idx = read_idx;
+    r->mate_ref_name = ref_name_star;
+    r->mate_ref_name_len = 1;
+}
+
+
 static rc_t opt_field_spot_group( const seq_table_ctx * const stx, int64_t row_id )
 {
     const char * spot_group = NULL;
     uint32_t spot_group_len;    
     rc_t rc = read_char_ptr( row_id, stx->cursor, stx->spot_group_idx, &spot_group, &spot_group_len, "SPOT_GROUP" );
     if ( rc == 0 && spot_group_len > 0 )
-        rc = KOutMsg( "\tRG:Z:%.*s", spot_group_len, spot_group );
+    {
+        if ( stx->bam != NULL )
+            rc = bam_rec_tag_str( stx->bam, "RG:Z:", spot_group, spot_group_len ); /* bam_out.c */
+        else
+            rc = KOutMsg( "\tRG:Z:%.*s", spot_group_len, spot_group );
+    }
     return rc;
 }
 
@@ -582,10 +644,163 @@ static rc_t opt_field_lnk_group( const seq_table_ctx * const stx, int64_t row_id
     uint32_t lnk_grp_len;
     rc_t rc = read_char_ptr( row_id, stx->cursor, stx->lnk_group_idx, &lnk_grp, &lnk_grp_len, "LINKAGE_GROUP" );
     if ( rc == 0 && lnk_grp_len > 0 )
-        rc = KOutMsg( "\tBX:Z:%.*s", lnk_grp_len, lnk_grp );
+    {
+        if ( stx->bam != NULL )
+            rc = bam_rec_tag_str( stx->bam, "BX:Z:", lnk_grp, lnk_grp_len ); /* bam_out.c */
+        else
+            rc = KOutMsg( "\tBX:Z:%.*s", lnk_grp_len, lnk_grp );
+    }
+    return rc;
+}
+
+static rc_t opt_fields( const samdump_opts * const opts, const seq_table_ctx * const stx, int64_t row_id )
+{
+    rc_t rc = 0;
+
+    /* OPT SAM-FIELD:       SRA-column: ALIGN_ID */
+    if ( opts->print_alignment_id_in_column_xi )
+    {
+        if ( stx->bam != NULL )
+            rc = bam_rec_tag_int( stx->bam, "XI:i:", ( uint32_t )row_id ); /* bam_out.c */
+        else
+            rc = KOutMsg( "\tXI:i:%u", ( uint32_t )row_id );
+    }
+
+    /* OPT SAM-FIELD:       SRA-column: SPOT_GROUP */
+    if ( rc == 0 && stx->spot_group_idx != COL_NOT_AVAILABLE )
+        rc = opt_field_spot_group( stx, row_id );
+
+    /* OPT SAM-FIELD:       SRA-column: LINKAGE_GROUP */
+    if ( rc == 0 && stx->lnk_group_idx != COL_NOT_AVAILABLE )
+        rc = opt_field_lnk_group( stx, row_id );
+
+    return rc;
+}
+
+
+static rc_t print_unaligned_rec_sam( const samdump_opts * const opts,
+                                     const seq_table_ctx * const stx,
+                                     const unaligned_rec * r )
+{
+    rc_t rc;
+
+    /* SAM-FIELD: QNAME     SRA-column: NAME or SPOT_ID ( int64 ), optionally with SPOT_GROUP */
+    if ( r->name != NULL && r->name_len > 0 )
+        rc = KOutMsg( "%.*s", r->name_len, r->name );
+    else
+        rc = KOutMsg( "%ld", r->spot_id );
+    if ( rc == 0 && r->spot_group_len > 0 )
+        rc = KOutMsg( ".%.*s", r->spot_group_len, r->spot_group );
+
+    /* SAM-FIELD: FLAG      SRA-column: calculated from READ_TYPE, READ_FILTER etc. */
+    /* SAM-FIELD: RNAME     SRA-column: none, fix '*' */
+    /* SAM-FIELD: POS       SRA-column: none, fix '0' */
+    /* SAM-FIELD: MAPQ      SRA-column: none, fix '0' */
+    /* SAM-FIELD: CIGAR     SRA-column: none, fix '*' */
+    if ( rc == 0 )
+        rc = KOutMsg( "\t%u\t*\t0\t0\t*\t", r->sam_flags );
+
+    /* SAM-FIELD: RNEXT     SRA-column: mate-cache, PRIMARY_ALIGNMENT-table or none */
+    /* SAM-FIELD: PNEXT     SRA-column: mate-cache, PRIMARY_ALIGNMENT-table or none */
+    /* SAM-FIELD: TLEN      SRA-column: none, fix '0' */
+    if ( rc == 0 )
+    {
+        if ( r->mate_unknown )
+            rc = KOutMsg( "0\t0\t0\t" );
+        else
+            rc = KOutMsg( "%.*s\t%li\t0\t", r->mate_ref_name_len, r->mate_ref_name, r->mate_ref_pos );
+    }
+
+    /* SAM-FIELD: SEQ       SRA-column: READ, sliced by READ_START/READ_LEN */
+    if ( rc == 0 )
+        rc = print_sliced_read( r->read, r->read_idx, r->reverse, r->read_start, r->read_len );
+    if ( rc == 0 )
+        rc = KOutMsg( "\t" );
+
+    /* SAM-FIELD: QUAL      SRA-column: QUALITY, sliced by READ_START/READ_LEN */
+    if ( rc == 0 )
+        rc = print_sliced_quality( opts, r->quality, r->read_idx, r->reverse, r->read_start, r->read_len );
+
+    if ( rc == 0 )
+        rc = opt_fields( opts, stx, r->row_id );
+
+    if ( rc == 0 )
+        rc = KOutMsg( "\n" );
+    return rc;
+}
+
+
+static rc_t print_unaligned_rec_bam( const samdump_opts * const opts,
+                                     const seq_table_ctx * const stx,
+                                     const unaligned_rec * r )
+{
+    char qname[ 1024 ];
+    size_t qname_len;
+    rc_t rc;
+    INSDC_coord_zero start = r->read_start[ r->read_idx ];
+    INSDC_coord_len len = r->read_len[ r->read_idx ];
+
+    /* QNAME */
+    if ( r->name != NULL && r->name_len > 0 )
+        rc = string_printf( qname, sizeof qname, &qname_len, "%.*s", r->name_len, r->name );
+    else
+        rc = string_printf( qname, sizeof qname, &qname_len, "%ld", r->spot_id );
+    if ( rc == 0 && r->spot_group_len > 0 )
+    {
+        size_t num_writ;
+        rc = string_printf( &qname[ qname_len ], sizeof qname - qname_len, &num_writ,
+                            ".%.*s", r->spot_group_len, r->spot_group );
+        qname_len += num_writ;
+    }
+    if ( rc == 0 )
+        rc = bam_rec_start( stx->bam, qname, qname_len ); /* bam_out.c */
+
+    /* SEQ and QUAL, there is no CIGAR */
+    if ( rc == 0 )
+        rc = bam_rec_seq( stx->bam, r->read + start, len, r->reverse );
+    if ( rc == 0 )
+    {
+        const uint8_t * quant_matrix = ( opts->qual_quant != NULL ) ? opts->qual_quant_matrix : NULL;
+        rc = bam_rec_qual( stx->bam, r->quality + start, len, 0, quant_matrix, r->reverse );
+    }
+
+    if ( rc == 0 )
+        rc = opt_fields( opts, stx, r->row_id );
+
+    /* the fixed fields: RNAME '*', POS 0, MAPQ 0, TLEN 0 */
+    if ( rc == 0 )
+    {
+        if ( r->mate_unknown )
+            rc = bam_rec_write( stx->bam, r->sam_flags, NULL, 0, 0, 0, NULL, 0, 0, 0 );
+        else
+            rc = bam_rec_write( stx->bam, r->sam_flags, NULL, 0, 0, 0,
+                                r->mate_ref_name, r->mate_ref_name_len, r->mate_ref_pos, 0 );
+    }
+    return rc;
+}
+
+
+static rc_t print_unaligned_rec( const samdump_opts * const opts,
+                                 const seq_table_ctx * const stx,
+                                 const unaligned_rec * r )
+{
+    if ( stx->bam != NULL )
+        return print_unaligned_rec_bam( opts, stx, r );
+    return print_unaligned_rec_sam( opts, stx, r );
+}
+
+
+static rc_t read_spot_group_for_name( const samdump_opts * const opts,
+                                      const seq_table_ctx * const stx,
+                                      unaligned_rec * r )
+{
+    rc_t rc = 0;
+    if ( opts->print_spot_group_in_name )
+        rc = read_char_ptr( r->row_id, stx->cursor, stx->spot_group_idx, &r->spot_group, &r->spot_group_len, "SPOT_GROUP" );
     return rc;
 }
 
+
 static rc_t dump_seq_row_sam_filtered( const samdump_opts * const opts,
                                        const seq_table_ctx * const stx,
                                        const prim_table_ctx * const ptx,
@@ -649,62 +864,29 @@ static rc_t dump_seq_row_sam_filtered( const samdump_opts * const opts,
                         }
                         else
                         {
-                            bool reverse = false;
+                            unaligned_rec r;
+                            init_unaligned_rec( &r, row_id, read_idx );
+                            r.spot_id = seq_spot_id;
+
+                            /* RNEXT / PNEXT found in the mate-cache */
+                            r.mate_ref_name = mate_ref_name;
+                            r.mate_ref_name_len = string_size( mate_ref_name );
+                            r.mate_ref_pos = mate_ref_pos + 1;
+
+                            rc = read_spot_group_for_name( opts, stx, &r );
 
-                            /* SAM-FIELD: QNAME     SRA-column: SPOT_ID ( int64 ) */
-                            if ( rc == 0 )
-                            {
-                                bool print_just_seq_spot_id = true;
-                                
-                                if ( opts->print_spot_group_in_name )
-                                {
-                                    const char * spot_group;
-                                    uint32_t spot_group_len;
-                                    rc = read_char_ptr( row_id, stx->cursor, stx->spot_group_idx, &spot_group, &spot_group_len, "SPOT_GROUP" );
-                                    if ( rc == 0 && spot_group_len > 0 )
-                                    {
-                                        rc = KOutMsg( "%ld.%.*s\t", seq_spot_id, spot_group_len, spot_group );
-                                        print_just_seq_spot_id = false;
-                                    }
-                                }
-                                if ( print_just_seq_spot_id )
-                                {
-                                    rc = KOutMsg( "%ld\t", seq_spot_id );
-                                }
-                            }
-                            
                             if ( rc == 0 && read_type == NULL )
                                 rc = read_read_type( stx, row_id, &read_type, nreads );
 
                             if ( rc == 0 )
-                                reverse = calc_reverse_flag( opts, read_idx, read_type );
+                                r.reverse = calc_reverse_flag( opts, read_idx, read_type );
 
                             if ( rc == 0 && read_filter == NULL )
                                 rc = read_read_filter( stx, row_id, &read_filter, nreads );
 
-                            /* SAM-FIELD: FLAG      SRA-column: calculated from READ_TYPE, READ_FILTER etc. */
                             if ( rc == 0 )
-                            {
-                                uint32_t sam_flags = calculate_unaligned_sam_flags_db( nreads, read_idx, mate_idx, 
-                                                                                    align_id, read_type, reverse, read_filter );
-                                rc = KOutMsg( "%u\t", sam_flags );
-                            }
-
-                            /* SAM-FIELD: RNAME     SRA-column: none, fix '*' */
-                            /* SAM-FIELD: POS       SRA-column: none, fix '0' */
-                            /* SAM-FIELD: MAPQ      SRA-column: none, fix '0' */
-                            /* SAM-FIELD: CIGAR     SRA-column: none, fix '*' */
-                            if ( rc == 0 )
-                                rc = KOutMsg( "*\t0\t0\t*\t" );
-
-                            /* SAM-FIELD: RNEXT     SRA-column: found in cache */
-                            /* SAM-FIELD: POS       SRA-column: found in cache */
-                            if ( rc == 0 )
-                                rc = KOutMsg( "%s\t%li\t", mate_ref_name, mate_ref_pos + 1 );
-
-                            /* SAM-FIELD: TLEN      SRA-column: none, fix '0' */
-                            if ( rc == 0 )
-                                rc = KOutMsg( "0\t" );
+                                r.sam_flags = calculate_unaligned_sam_flags_db( nreads, read_idx, mate_idx, 
+                                                                               align_id, read_type, r.reverse, read_filter );
 
                             if ( rc == 0 && read == NULL )
                                 rc = read_INSDC_dna_text_ptr( row_id, stx->cursor, stx->read_idx, &read, &rd_len, "READ" );
@@ -713,30 +895,14 @@ static rc_t dump_seq_row_sam_filtered( const samdump_opts * const opts,
                             if ( rc == 0 && read_start == NULL )
                                 rc = read_read_start( stx, row_id, &read_start, nreads );
 
-                            /* SAM-FIELD: SEQ       SRA-column: READ, sliced by READ_START/READ_LEN */
-                            if ( rc == 0 )
-                                rc = print_sliced_read( read, read_idx, reverse, read_start, read_len );
-                            if ( rc == 0 )
-                                rc = KOutMsg( "\t" );
-
-                            /* SAM-FIELD: QUAL      SRA-column: QUALITY, sliced by READ_START/READ_LEN */
-                            if ( rc == 0 )
-                                rc = print_sliced_quality( opts, quality, read_idx, reverse, read_start, read_len );
-
-                            /* OPT SAM-FIELD:       SRA-column: ALIGN_ID */
-                            if ( rc == 0 && opts->print_alignment_id_in_column_xi )
-                                rc = KOutMsg( "\tXI:i:%u", row_id );
-
-                            /* OPT SAM-FIELD:      SRA-column: SPOT_GROUP */
-                            if ( rc == 0 && stx->spot_group_idx != COL_NOT_AVAILABLE )
-                                rc = opt_field_spot_group( stx, row_id );
-
-                            /* OPT SAM-FIELD:       SRA-column: LINKAGE_GROUP */
-                            if ( rc == 0 && stx->lnk_group_idx != COL_NOT_AVAILABLE )
-                                rc = opt_field_lnk_group( stx, row_id );
-                            
                             if ( rc == 0 )
-                                rc = KOutMsg( "\n" );
+                            {
+                                r.read = read;
+                                r.quality = quality;
+                                r.read_start = read_start;
+                                r.read_len = read_len;
+                                rc = print_unaligned_rec( opts, stx, &r );
+                            }
                         }
                     }
                 }
@@ -779,10 +945,12 @@ static rc_t dump_seq_prim_row_sam( const samdump_opts * const opts,
         if ( prim_align_ids[ read_idx ] == 0 &&     /* read is NOT aligned! */
              read_len[ read_idx ] > 0 )             /* and has a length! */
         {
-            bool reverse = false, mate_available = false;
+            bool mate_available = false;
             uint32_t mate_idx = 0;
             int64_t mate_id = 0;
+            unaligned_rec r;
 
+            init_unaligned_rec( &r, row_id, read_idx );
             if ( nreads > 1 )
             {
                 if ( read_idx == ( nreads - 1 ) )
@@ -798,126 +966,69 @@ static rc_t dump_seq_prim_row_sam( const samdump_opts * const opts,
             if ( rc == 0 && read_type == NULL )
                 rc = read_read_type( stx, row_id, &read_type, nreads );
             if ( rc == 0 )
-                reverse = calc_reverse_flag( opts, read_idx, read_type );
+                r.reverse = calc_reverse_flag( opts, read_idx, read_type );
 
             if ( rc == 0 && read_filter == NULL )
                 rc = read_read_filter( stx, row_id, &read_filter, nreads );
 
-            /* SAM-FIELD: QNAME     SRA-column: SPOT_ID ( int64 ) */
             if ( rc == 0 )
-            {
-                bool print_just_seq_spot_id = true;
-                
-                if ( opts->print_spot_group_in_name )
-                {
-                    const char * spot_group;
-                    uint32_t spot_group_len;
-                    rc = read_char_ptr( row_id, stx->cursor, stx->spot_group_idx, &spot_group, &spot_group_len, "SPOT_GROUP" );
-                    if ( rc == 0 && spot_group_len > 0 )
-                    {
-                        rc = KOutMsg( "%ld.%.*s\t", row_id, spot_group_len, spot_group );
-                        print_just_seq_spot_id = false;
-                    }
-                }
-                if ( print_just_seq_spot_id )
-                {
-                    rc = KOutMsg( "%ld\t", row_id );
-                }
-            }
-            
-            /* SAM-FIELD: FLAG      SRA-column: calculated from READ_TYPE, READ_FILTER etc. */
+                rc = read_spot_group_for_name( opts, stx, &r );
+
+            /* FLAG     SRA-column: calculated from READ_TYPE, READ_FILTER etc. */
             if ( rc == 0 )
             {
-                uint32_t sam_flags;
                 if ( stx->prim_al_id_idx != INVALID_COLUMN )
                 {
                     uint32_t temp_nreads = nreads;
                     if ( mate_id == 0 && read_len[ mate_idx ] == 0 ) temp_nreads--;
-                    sam_flags = calculate_unaligned_sam_flags_db( temp_nreads, read_idx, mate_idx, 
-                                            mate_id, read_type, reverse, read_filter );
+                    r.sam_flags = calculate_unaligned_sam_flags_db( temp_nreads, read_idx, mate_idx, 
+                                            mate_id, read_type, r.reverse, read_filter );
                 }
                 else
                 {
-                    if ( reverse )
-                        sam_flags = ( 0x04 | 0x10 );
+                    if ( r.reverse )
+                        r.sam_flags = ( 0x04 | 0x10 );
                     else
-                        sam_flags = 0x04;
+                        r.sam_flags = 0x04;
                 }
-                rc = KOutMsg( "%u\t", sam_flags );
             }
 
-            /* SAM-FIELD: RNAME     SRA-column: none, fix '*' */
-            /* SAM-FIELD: POS       SRA-column: none, fix '0' */
-            /* SAM-FIELD: MAPQ      SRA-column: none, fix '0' */
-            /* SAM-FIELD: CIGAR     SRA-column: none, fix '*' */
-            if ( rc == 0 )
-                rc = KOutMsg( "*\t0\t0\t*\t" );
-
-            /* SAM-FIELD: RNEXT     SRA-column: look up in cache, or none */
-            /* SAM-FIELD: POS       SRA-column: look up in cache, or none */
+            /* RNEXT / PNEXT    SRA-column: look up in cache, or none */
             if ( rc == 0 )
             {
                 if ( ptx == NULL || !mate_available )
                 {
-                    rc = KOutMsg( "0\t0\t" );   /* no way to get that without PRIM_ALIGN-table */
+                    r.mate_unknown = true;   /* no way to get that without PRIM_ALIGN-table */
+                }
+                else if ( opts->use_mate_cache && mc != NULL && ids != NULL )
+                {
+                    INSDC_coord_zero mate_ref_pos;
+                    rc = get_mate_info( ptx, mc, ids, row_id, mate_id, nreads,
+                                        &r.mate_ref_name, &r.mate_ref_name_len, &mate_ref_pos );
+                    r.mate_ref_pos = mate_ref_pos;
                 }
                 else
                 {
-                    if ( opts->use_mate_cache && mc != NULL && ids != NULL )
-                    {
-                        const char * mate_ref_name;
-                        uint32_t mate_ref_name_len;
-                        INSDC_coord_zero mate_ref_pos;
-
-                        rc = get_mate_info( ptx, mc, ids, row_id, mate_id, nreads, &mate_ref_name, &mate_ref_name_len, &mate_ref_pos );
-                        if ( rc == 0 )
-                            rc = KOutMsg( "%.*s\t%li\t", mate_ref_name_len, mate_ref_name, mate_ref_pos );
-                    }
-                    else
-                    {
-                        /* print the mate info */
-                        rc = dump_the_other_read( stx, ptx, row_id, mate_idx );
-                    }
+                    rc = get_the_other_read( stx, ptx, row_id, mate_idx,
+                                             &r.mate_ref_name, &r.mate_ref_name_len, &r.mate_ref_pos );
                 }
             }
 
-
-            /* SAM-FIELD: TLEN      SRA-column: none, fix '0' */
-            if ( rc == 0 )
-                rc = KOutMsg( "0\t" );
-
             if ( rc == 0 && read == NULL )
                 rc = read_INSDC_dna_text_ptr( row_id, stx->cursor, stx->read_idx, &read, &rd_len, "READ" );
             if ( rc == 0 && read_start == NULL )
                 rc = read_read_start( stx, row_id, &read_start, nreads );
-
-            /* SAM-FIELD: SEQ       SRA-column: READ, sliced by READ_START/READ_LEN */
-            if ( rc == 0 )
-                rc = print_sliced_read( read, read_idx, reverse, read_start, read_len );
-            if ( rc == 0 )
-                rc = KOutMsg( "\t" );
-
             if ( rc == 0 && quality == NULL )
                 rc = read_quality( stx, row_id, &quality, rd_len );
 
-            /* SAM-FIELD: QUAL      SRA-column: QUALITY, sliced by READ_START/READ_LEN */
-            if ( rc == 0 )
-                rc = print_sliced_quality( opts, quality, read_idx, reverse, read_start, read_len );
-
-            /* OPT SAM-FIIELD:      SRA-column: ALIGN_ID */
-            if ( rc == 0 && opts->print_alignment_id_in_column_xi )
-                rc = KOutMsg( "\tXI:i:%u", row_id );
-
-            /* OPT SAM-FIIELD:      SRA-column: SPOT_GROUP */
-            if ( rc == 0 && stx->spot_group_idx != COL_NOT_AVAILABLE )
-                rc = opt_field_spot_group( stx, row_id );
-
-            /* OPT SAM-FIELD:       SRA-column: LINKAGE_GROUP */
-            if ( rc == 0 && stx->lnk_group_idx != COL_NOT_AVAILABLE )
-                rc = opt_field_lnk_group( stx, row_id );
-
             if ( rc == 0 )
-                rc = KOutMsg( "\n" );
+            {
+                r.read = read;
+                r.quality = quality;
+                r.read_start = read_start;
+                r.read_len = read_len;
+                rc = print_unaligned_rec( opts, stx, &r );
+            }
         }
     }
     return rc;
@@ -955,8 +1066,13 @@ static rc_t dump_seq_row_sam( const samdump_opts * const opts,
         if ( ( read_len[ read_idx ] > 0 ) &&             /* has a length! */
              ( ( read_type[ read_idx ] & READ_TYPE_BIOLOGICAL ) == READ_TYPE_BIOLOGICAL ) )
         {
-            bool reverse = false;
             uint32_t mate_idx = 0;
+            unaligned_rec r;
+
+            /* RNEXT / PNEXT    SRA-column: none, fix '*' and '0' */
+            init_unaligned_rec( &r, row_id, read_idx );
+            r.name = name;
+            r.name_len = name_len;
 
             if ( nreads > 1 )
             {
@@ -967,91 +1083,34 @@ static rc_t dump_seq_row_sam( const samdump_opts * const opts,
             }
 
             if ( rc == 0 ) /* types in interfaces/insdc/insdc.h */
-                reverse = calc_reverse_flag( opts, read_idx, read_type );
+                r.reverse = calc_reverse_flag( opts, read_idx, read_type );
 
             if ( rc == 0 && read_filter == NULL )
                 rc = read_read_filter( stx, row_id, &read_filter, nreads );
 
-            /* SAM-FIELD: QNAME     SRA-column: SPOT_ID ( int64 ) */
-            if ( rc == 0 )
-            {
-                bool print_just_seq_spot_id = true;
-                
-                if ( opts->print_spot_group_in_name )
-                {
-                    const char * spot_group;
-                    uint32_t spot_group_len;
-                    rc = read_char_ptr( row_id, stx->cursor, stx->spot_group_idx, &spot_group, &spot_group_len, "SPOT_GROUP" );
-                    if ( rc == 0 && spot_group_len > 0 )
-                    {
-                        if ( name != NULL && name_len > 0 )
-                            rc = KOutMsg( "%.*s.%.*s\t", name_len, name, spot_group_len, spot_group );
-                        else
-                            rc = KOutMsg( "%ld.%.*s\t", row_id, spot_group_len, spot_group );
-                        print_just_seq_spot_id = false;
-                    }
-                }
-
-                if ( print_just_seq_spot_id )
-                {
-                    if ( name != NULL && name_len > 0 )
-                        rc = KOutMsg( "%.*s\t", name_len, name );
-                    else
-                        rc = KOutMsg( "%lu\t", row_id );
-                }
-            }
-
-            /* SAM-FIELD: FLAG      SRA-column: calculated from READ_TYPE, READ_FILTER etc. */
             if ( rc == 0 )
-            {
-                uint32_t sam_flags = calculate_unaligned_sam_flags_db( nreads, read_idx, mate_idx, 
-                                            0, read_type, reverse, read_filter );
-                rc = KOutMsg( "%u\t", sam_flags );
-            }
-
-            /* SAM-FIELD: RNAME     SRA-column: none, fix '*' */
-            /* SAM-FIELD: POS       SRA-column: none, fix '0' */
-            /* SAM-FIELD: MAPQ      SRA-column: none, fix '0' */
-            /* SAM-FIELD: CIGAR     SRA-column: none, fix '*' */
-            /* SAM-FIELD: RNEXT     SRA-column: none, fix '*' */
-            /* SAM-FIELD: POS       SRA-column: none, fix '0' */
-            /* SAM-FIELD: TLEN      SRA-column: none, fix '0' */
+                rc = read_spot_group_for_name( opts, stx, &r );
 
+            /* FLAG     SRA-column: calculated from READ_TYPE, READ_FILTER etc. */
             if ( rc == 0 )
-                rc = KOutMsg( "*\t0\t0\t*\t*\t0\t0\t" );
+                r.sam_flags = calculate_unaligned_sam_flags_db( nreads, read_idx, mate_idx, 
+                                            0, read_type, r.reverse, read_filter );
 
             if ( rc == 0 && read == NULL )
                 rc = read_INSDC_dna_text_ptr( row_id, stx->cursor, stx->read_idx, &read, &rd_len, "READ" );
             if ( rc == 0 && read_start == NULL )
                 rc = read_read_start( stx, row_id, &read_start, nreads );
-
-            /* SAM-FIELD: SEQ       SRA-column: READ, sliced by READ_START/READ_LEN */
-            if ( rc == 0 )
-                rc = print_sliced_read( read, read_idx, reverse, read_start, read_len );
-            if ( rc == 0 )
-                rc = KOutMsg( "\t" );
-
             if ( rc == 0 && quality == NULL )
                 rc = read_quality( stx, row_id, &quality, rd_len );
 
-            /* SAM-FIELD: QUAL      SRA-column: QUALITY, sliced by READ_START/READ_LEN */
-            if ( rc == 0 )
-                rc = print_sliced_quality( opts, quality, read_idx, reverse, read_start, read_len );
-
-            /* OPT SAM-FIIELD:      SRA-column: ALIGN_ID */
-            if ( rc == 0 && opts->print_alignment_id_in_column_xi )
-                rc = KOutMsg( "\tXI:i:%u", row_id );
-
-            /* OPT SAM-FIIELD:      SRA-column: SPOT_GROUP */
-            if ( rc == 0 && stx->spot_group_idx != COL_NOT_AVAILABLE )
-                rc = opt_field_spot_group( stx, row_id );
-
-            /* OPT SAM-FIELD:       SRA-column: LINKAGE_GROUP */
-            if ( rc == 0 && stx->lnk_group_idx != COL_NOT_AVAILABLE )
-                rc = opt_field_lnk_group( stx, row_id );
-
             if ( rc == 0 )
-                rc = KOutMsg( "\n" );
+            {
+                r.read = read;
+                r.quality = quality;
+                r.read_start = read_start;
+                r.read_len = read_len;
+                rc = print_unaligned_rec( opts, stx, &r );
+            }
         }
     }
     return rc;
@@ -1372,6 +1431,7 @@ static rc_t print_unaligned_database_filtered_2( const samdump_opts * const opts
                 VCursorRelease( ptx.cursor );
             }
         }
+        release_seq_table_ctx( &stx );
     }
     return rc;
 }
@@ -1496,7 +1556,7 @@ static rc_t print_unaligned_database_full( const samdump_opts * const opts,
                     VCursorRelease( ptx.cursor );
             }
         }
-        VCursorRelease( stx.cursor );
+        release_seq_table_ctx( &stx );
     }
     return rc;
 }
@@ -1546,7 +1606,7 @@ static rc_t print_unaligned_table( const samdump_opts * const opts,
                 }
             }
         }
-        VCursorRelease( stx.cursor );
+        release_seq_table_ctx( &stx );
     }
     return rc;
 }
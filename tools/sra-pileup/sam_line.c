@@ -0,0 +1,225 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+
+#include "sam_line.h"
+
+#include <klib/out.h>
+#include <klib/log.h>
+#include <klib/text.h>
+#include <sysalloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SAM_LINE_MIN_SIZE 4096
+
+static const char digit_pairs[ 201 ] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+
+void init_sam_line( sam_line * self )
+{
+    self->buffer = NULL;
+    self->size = 0;
+    self->used = 0;
+}
+
+
+void release_sam_line( sam_line * self )
+{
+    if ( self->buffer != NULL )
+        free( self->buffer );
+    init_sam_line( self );
+}
+
+
+static rc_t sam_line_reserve( sam_line * self, size_t len )
+{
+    rc_t rc = 0;
+    size_t needed = self->used + len;
+    if ( needed > self->size )
+    {
+        size_t new_size = ( self->size < SAM_LINE_MIN_SIZE ) ? SAM_LINE_MIN_SIZE : self->size;
+        char * temp;
+        while ( new_size < needed )
+            new_size <<= 1;
+        temp = realloc( self->buffer, new_size );
+        if ( temp == NULL )
+        {
+            rc = RC( rcExe, rcBuffer, rcResizing, rcMemory, rcExhausted );
+            (void)LOGERR( klogErr, rc, "cannot enlarge SAM-line buffer" );
+        }
+        else
+        {
+            self->buffer = temp;
+            self->size = new_size;
+        }
+    }
+    return rc;
+}
+
+
+rc_t sam_line_char( sam_line * self, char c )
+{
+    rc_t rc = 0;
+    if ( self->used >= self->size )
+        rc = sam_line_reserve( self, 1 );
+    if ( rc == 0 )
+        self->buffer[ self->used++ ] = c;
+    return rc;
+}
+
+
+rc_t sam_line_str( sam_line * self, const char * s, size_t len )
+{
+    rc_t rc = sam_line_reserve( self, len );
+    if ( rc == 0 && len > 0 )
+    {
+        memmove( &self->buffer[ self->used ], s, len );
+        self->used += len;
+    }
+    return rc;
+}
+
+
+rc_t sam_line_cstr( sam_line * self, const char * s )
+{
+    return sam_line_str( self, s, string_size( s ) );
+}
+
+
+rc_t sam_line_u64( sam_line * self, uint64_t value )
+{
+    char temp[ 24 ];
+    char * p = &temp[ sizeof temp ];
+
+    /* two digits at a time, from the back */
+    while ( value >= 100 )
+    {
+        const char * d = &digit_pairs[ ( value % 100 ) * 2 ];
+        value /= 100;
+        *( --p ) = d[ 1 ];
+        *( --p ) = d[ 0 ];
+    }
+    if ( value >= 10 )
+    {
+        const char * d = &digit_pairs[ value * 2 ];
+        *( --p ) = d[ 1 ];
+        *( --p ) = d[ 0 ];
+    }
+    else
+        *( --p ) = ( char )( '0' + value );
+
+    return sam_line_str( self, p, &temp[ sizeof temp ] - p );
+}
+
+
+rc_t sam_line_i64( sam_line * self, int64_t value )
+{
+    rc_t rc = 0;
+    uint64_t u = ( uint64_t )value;
+    if ( value < 0 )
+    {
+        rc = sam_line_char( self, '-' );
+        u = ~u + 1;
+    }
+    if ( rc == 0 )
+        rc = sam_line_u64( self, u );
+    return rc;
+}
+
+
+rc_t sam_line_tag_str( sam_line * self, const char * tag, const char * s, size_t len )
+{
+    rc_t rc = sam_line_char( self, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_cstr( self, tag );
+    if ( rc == 0 )
+        rc = sam_line_str( self, s, len );
+    return rc;
+}
+
+
+rc_t sam_line_tag_u64( sam_line * self, const char * tag, uint64_t value )
+{
+    rc_t rc = sam_line_char( self, '\t' );
+    if ( rc == 0 )
+        rc = sam_line_cstr( self, tag );
+    if ( rc == 0 )
+        rc = sam_line_u64( self, value );
+    return rc;
+}
+
+
+rc_t sam_line_qual_33( sam_line * self, const char * quality, uint32_t len, const uint8_t * quant_matrix )
+{
+    rc_t rc;
+    if ( quant_matrix == NULL )
+        rc = sam_line_str( self, quality, len );
+    else
+    {
+        rc = sam_line_reserve( self, len );
+        if ( rc == 0 )
+        {
+            char * dst = &self->buffer[ self->used ];
+            uint32_t i;
+            for ( i = 0; i < len; ++i )
+                dst[ i ] = quant_matrix[ ( uint8_t )( quality[ i ] - 33 ) ] + 33;
+            self->used += len;
+        }
+    }
+    return rc;
+}
+
+
+rc_t sam_line_write( sam_line * self )
+{
+    rc_t rc = 0;
+    if ( self->used > 0 )
+    {
+        KWrtHandler * handler = KOutHandlerGet ();
+        size_t written = 0;
+        while ( rc == 0 && written < self->used )
+        {
+            size_t num_writ = 0;
+            rc = ( * handler -> writer ) ( handler -> data, &self->buffer[ written ], self->used - written, &num_writ );
+            if ( rc == 0 && num_writ == 0 )
+                rc = RC( rcExe, rcFile, rcWriting, rcTransfer, rcIncomplete );
+            written += num_writ;
+        }
+        self->used = 0;
+    }
+    return rc;
+}
@@ -0,0 +1,81 @@
+/*===========================================================================
+*
+*                            PUBLIC DOMAIN NOTICE
+*               National Center for Biotechnology Information
+*
+*  This software/database is a "United States Government Work" under the
+*  terms of the United States Copyright Act.  It was written as part of
+*  the author's official duties as a United States Government employee and
+*  thus cannot be copyrighted.  This software/database is freely available
+*  to the public for use. The National Library of Medicine and the U.S.
+*  Government have not placed any restriction on its use or reproduction.
+*
+*  Although all reasonable efforts have been taken to ensure the accuracy
+*  and reliability of the software and data, the NLM and the U.S.
+*  Government do not and cannot warrant the performance or results that
+*  may be obtained by using this software or data. The NLM and the U.S.
+*  Government disclaim all warranties, express or implied, including
+*  warranties of performance, merchantability or fitness for any particular
+*  purpose.
+*
+*  Please cite the author in any work or product based on this material.
+*
+* ===========================================================================
+*
+*/
+#ifndef _h_sam_line_
+#define _h_sam_line_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#if 0
+}
+#endif
+
+#include <klib/rc.h>
+
+/* ---------------------------------------------------------------------------------------------
+    a SAM-line is assembled field by field in a buffer, that is reused for all lines,
+    and written with one call to the KOut-handler ( sam_line_write ).
+    The append-functions do not parse format-strings, numbers are converted by hand.
+--------------------------------------------------------------------------------------------- */
+
+typedef struct sam_line
+{
+    char * buffer;
+    size_t size;    /* allocated */
+    size_t used;
+} sam_line;
+
+void init_sam_line( sam_line * self );
+
+void release_sam_line( sam_line * self );
+
+rc_t sam_line_char( sam_line * self, char c );
+
+rc_t sam_line_str( sam_line * self, const char * s, size_t len );
+
+rc_t sam_line_cstr( sam_line * self, const char * s );
+
+rc_t sam_line_u64( sam_line * self, uint64_t value );
+
+rc_t sam_line_i64( sam_line * self, int64_t value );
+
+/* writes TAB, tag ( for instance "RG:Z:" ) and value */
+rc_t sam_line_tag_str( sam_line * self, const char * tag, const char * s, size_t len );
+
+rc_t sam_line_tag_u64( sam_line * self, const char * tag, uint64_t value );
+
+/* quality is phred+33, quant_matrix ( opts->qual_quant_matrix ) is applied if not NULL */
+rc_t sam_line_qual_33( sam_line * self, const char * quality, uint32_t len, const uint8_t * quant_matrix );
+
+/* writes the line via the KOut-handler and empties it */
+rc_t sam_line_write( sam_line * self );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -39,8 +39,10 @@
 #include "pileup_index.h"
 #include "pileup_varcount.h"
 #include "pileup_indels.h"
+#include "pileup_binary.h"
 #include "pileup_stat.h"
 #include "pileup_v2.h"
+#include "ordered_out.h"
 
 #include <kapp/main.h>
 
@@ -49,6 +51,8 @@
 #include <klib/report.h>
 #include <klib/vector.h>
 
+#include <kproc/thread.h>
+
 #include <kfs/file.h>
 #include <kfs/buffile.h>
 #include <kfs/bzip.h>
@@ -103,6 +107,8 @@
 
 #define OPTION_DEPTH_PER_SPOTGRP	"depth-per-spotgroup"
 
+#define OPTION_THREADS "threads"
+
 #define OPTION_NGC "ngc"
 
 #define OPTION_FUNC    "function"
@@ -119,6 +125,7 @@
 #define FUNC_VARCOUNT   "varcount"
 #define FUNC_DELETES    "deletes"
 #define FUNC_INDELS     "indels"
+#define FUNC_BINARY     "binary"
 
 enum
 {
@@ -133,7 +140,8 @@ enum
     sra_pileup_test = 8,
     sra_pileup_varcount = 9,
     sra_pileup_deletes = 10,
-	sra_pileup_indels = 11
+	sra_pileup_indels = 11,
+    sra_pileup_binary = 12
 };
 
 static const char * minmapq_usage[]         = { "Minimum mapq-value, ", 
@@ -160,6 +168,11 @@ static const char * merge_usage[]           = { "If adjacent slices are closer t
                                                 "they are merged and a skiplist is created. ", 
                                                 "a value of zero disables the feature, default is 10000", NULL };
 
+static const char * threads_usage[]         = { "number of worker-threads: the references are cut into slices, ",
+                                                "which are piled up concurrently. Has no effect on ",
+                                                "function stat and debug, with --noskip or more than one input. ",
+                                                "default is 1", NULL };
+
 static const char * no_qual_usage[]         = { "omit qualities", NULL };
 
 static const char * func_ref_usage[]        = { "list references", NULL };
@@ -178,6 +191,10 @@ static const char * func_varcount_usage[]   = { "variation counters: ",
 
 static const char * func_deletes_usage[]    = { "list deletions greater then 20", NULL };
 
+static const char * func_binary_usage[]     = { "per-position counters in binary format ( pileup_bin.h ): ",
+                                                "coverage, matches, mismatch A, C, G, T, deletes, inserts, ",
+                                                "forward, reverse, positions without coverage are left out", NULL };
+
 static const char * func_usage[]            = { "alternative functionality", NULL };
 
 static const char * ngc_usage[] = { "path to ngc file", NULL };
@@ -195,6 +212,7 @@ OptDef MyOptions[] =
     { OPTION_SEQNAME,	ALIAS_SEQNAME,	NULL,	seqname_usage,	1,        false,       false },
     { OPTION_MIN_M,		NULL,			NULL,	min_m_usage,	1,        true,        false },
     { OPTION_MERGE,		NULL,			NULL,	merge_usage,	1,        true,        false },
+    { OPTION_THREADS,	NULL,			NULL,	threads_usage,	1,        true,        false },
     { OPTION_FUNC,		ALIAS_FUNC,		NULL,	func_usage,		1,        true,        false },
     { OPTION_NGC,       NULL,           NULL,   ngc_usage, 1, true, false },
 };
@@ -292,6 +310,13 @@ static rc_t get_pileup_options( Args * args, pileup_options *opts )
     if ( rc == 0 )
         rc = get_uint32_option( args, OPTION_MERGE, &opts->merge_dist, 10000 );
         
+    if ( rc == 0 )
+    {
+        rc = get_uint32_option( args, OPTION_THREADS, &opts->threads, 1 );
+        if ( opts->threads == 0 || opts->cmn.no_mt )
+            opts->threads = 1;
+    }
+
     if ( rc == 0 )
         rc = get_bool_option( args, OPTION_DUPS, &opts->process_dups, false );
 
@@ -341,6 +366,8 @@ static rc_t get_pileup_options( Args * args, pileup_options *opts )
                 opts->function = sra_pileup_deletes;
             else if ( cmp_pchar( fkt, FUNC_INDELS ) == 0 )
                 opts->function = sra_pileup_indels;
+            else if ( cmp_pchar( fkt, FUNC_BINARY ) == 0 )
+                opts->function = sra_pileup_binary;
         }
     }
 
@@ -398,6 +425,7 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine ( ALIAS_SEQNAME, OPTION_SEQNAME, NULL, seqname_usage );
     HelpOptionLine ( NULL, OPTION_MIN_M, NULL, min_m_usage );
     HelpOptionLine ( NULL, OPTION_MERGE, NULL, merge_usage );
+    HelpOptionLine ( NULL, OPTION_THREADS, "count", threads_usage );
     HelpOptionLine ( ALIAS_NOQUAL, OPTION_NOQUAL, NULL, no_qual_usage );
 
     HelpOptionLine ( NULL, "function ref",      NULL, func_ref_usage );
@@ -409,6 +437,7 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine ( NULL, "function varcount", NULL, func_varcount_usage );
     HelpOptionLine ( NULL, "function deletes",  NULL, func_deletes_usage );
     HelpOptionLine ( NULL, "function indels",   NULL, func_indels_usage );
+    HelpOptionLine ( NULL, "function binary",   NULL, func_binary_usage );
 	
     KOutMsg ( "\nGrouping of accessions into artificial spotgroups:\n" );
     KOutMsg ( "  sra-pileup SRRXXXXXX=a SRRYYYYYY=b SRRZZZZZZ=a\n\n" );
@@ -1147,170 +1176,187 @@ static bool row_not_found_while_reading_column( rc_t rc )
              rcNotFound == GetRCState( rc ) );
 }
 
-static rc_t CC prepare_section_cb( prepare_ctx * ctx, const struct reference_range * range )
+
+/* the part of the reference, that is piled up for a reference-range ( NULL ... the whole reference ) */
+static rc_t get_section_bounds( const ReferenceObj * refobj, const struct reference_range * range,
+                                uint32_t * start, uint32_t * end )
 {
-    rc_t rc = 0;
     INSDC_coord_len len;
-    if ( ctx->db == NULL || ctx->refobj == NULL )
+    rc_t rc = ReferenceObj_SeqLength( refobj, &len );
+    if ( rc != 0 )
     {
-        rc = SILENT_RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
-        /* it is opened in prepare_db_table even if ctx->db == NULL */
-        PLOGERR( klogErr, ( klogErr, rc, "failed to process $(path)",
-            "path=%s", ctx->path == NULL ? "input argument" : ctx->path));
-        ReportSilence();
+        LOGERR( klogInt, rc, "ReferenceObj_SeqLength() failed" );
     }
     else
     {
-        rc = ReferenceObj_SeqLength( ctx->refobj, &len );
-        if ( rc != 0 )
+        if ( range == NULL )
         {
-            LOGERR( klogInt, rc, "ReferenceObj_SeqLength() failed" );
+            *start = 1;
+            *end = ( len - *start ) + 1;
         }
         else
         {
-            uint32_t start, end;
-            rc_t rc1 = 0, rc2 = 0, rc3 = 0;
+            *start = get_ref_range_start( range );
+            *end   = get_ref_range_end( range );
+        }
+
+        if ( *start == 0 ) *start = 1;
+        if ( ( *end == 0 )||( *end > len + 1 ) )
+        {
+            *end = ( len - *start ) + 1;
+        }
+    }
+    return rc;
+}
+
 
-            if ( range == NULL )
+static rc_t add_section_placements( prepare_ctx * ctx, uint32_t start, uint32_t end )
+{
+    rc_t rc, rc1 = 0, rc2 = 0, rc3 = 0;
+
+    /* depending on ctx->select prepare primary, secondary or both... */
+    if ( ctx->use_primary_alignments )
+    {
+        if ( ctx->prim_cur == NULL )
+        {
+            rc1 = make_cursor_ids( ctx->data, &ctx->prim_cur_ids );
+            if ( rc1 != 0 )
             {
-                start = 1;
-                end = ( len - start ) + 1;
+                LOGERR( klogInt, rc1, "cannot create cursor-ids for prim. alignment cursor" );
             }
             else
-            {
-                start = get_ref_range_start( range );
-                end   = get_ref_range_end( range );
-            }
+                rc1 = prepare_prim_cursor( ctx->db, &ctx->prim_cur, ctx->omit_qualities,
+                                           ctx->read_tlen, ctx->prim_cur_ids );
+        }
 
-            if ( start == 0 ) start = 1;
-            if ( ( end == 0 )||( end > len + 1 ) )
+        if ( rc1 == 0 )
+        {
+            /* show_placement_params( "primary", ctx->refobj, start, end ); */
+            rc1 = ReferenceIteratorAddPlacements ( ctx->ref_iter,       /* the outer ref-iter */
+                                                  ctx->refobj,          /* the ref-obj for this chromosome */
+                                                  start - 1,            /* start ( zero-based ) */
+                                                  end - start + 1,      /* length */
+                                                  NULL,                 /* ref-cursor */
+                                                  ctx->prim_cur,        /* align-cursor */
+                                                  primary_align_ids,    /* which id's */
+                                                  ctx->spot_group,      /* what read-group */
+                                                  ctx->prim_cur_ids     /* placement-context */
+                                                 );
+            if ( rc1 != 0 && !row_not_found_while_reading_column( rc1 ) )
             {
-                end = ( len - start ) + 1;
+                /* row_not_found_while_reading column within VDB happens if the
+                 requested reference-slice is empty, let's silence that */
+                LOGERR( klogInt, rc1, "ReferenceIteratorAddPlacements(prim) failed" );
             }
-            
-            /* depending on ctx->select prepare primary, secondary or both... */
-            if ( ctx->use_primary_alignments )
-            {
-                if ( ctx->prim_cur == NULL )
-                {
-                    rc1 = make_cursor_ids( ctx->data, &ctx->prim_cur_ids );
-                    if ( rc1 != 0 )
-                    {
-                        LOGERR( klogInt, rc1, "cannot create cursor-ids for prim. alignment cursor" );
-                    }
-                    else
-                        rc1 = prepare_prim_cursor( ctx->db, &ctx->prim_cur, ctx->omit_qualities,
-                                                   ctx->read_tlen, ctx->prim_cur_ids );
-                }
+        }
+    }
 
-                if ( rc1 == 0 )
-                {
-                    /* show_placement_params( "primary", ctx->refobj, start, end ); */
-                    rc1 = ReferenceIteratorAddPlacements ( ctx->ref_iter,       /* the outer ref-iter */
-                                                          ctx->refobj,          /* the ref-obj for this chromosome */
-                                                          start - 1,            /* start ( zero-based ) */
-                                                          end - start + 1,      /* length */
-                                                          NULL,                 /* ref-cursor */
-                                                          ctx->prim_cur,        /* align-cursor */
-                                                          primary_align_ids,    /* which id's */
-                                                          ctx->spot_group,      /* what read-group */
-                                                          ctx->prim_cur_ids     /* placement-context */
-                                                         );
-                    if ( rc1 != 0 && !row_not_found_while_reading_column( rc1 ) )
-                    {
-                        /* row_not_found_while_reading column within VDB happens if the
-                         requested reference-slice is empty, let's silence that */
-                        LOGERR( klogInt, rc1, "ReferenceIteratorAddPlacements(prim) failed" );
-                    }
-                }
+    if ( ctx->use_secondary_alignments )
+    {
+        if ( ctx->sec_cur == NULL )
+        {
+            rc2 = make_cursor_ids( ctx->data, &ctx->sec_cur_ids );
+            if ( rc2 != 0 )
+            {
+                LOGERR( klogInt, rc2, "cannot create cursor-ids for sec. alignment cursor" );
             }
+            else
+                rc2 = prepare_sec_cursor( ctx->db, &ctx->sec_cur, ctx->omit_qualities,
+                                          ctx->read_tlen, ctx->sec_cur_ids );
+        }
 
-            if ( ctx->use_secondary_alignments )
+        if ( rc2 == 0 )
+        {
+            /* show_placement_params( "secondary", ctx->refobj, start, end ); */
+            rc2 = ReferenceIteratorAddPlacements ( ctx->ref_iter,       /* the outer ref-iter */
+                                                  ctx->refobj,          /* the ref-obj for this chromosome */
+                                                  start - 1,            /* start ( zero-based ) */
+                                                  end - start + 1,      /* length */
+                                                  NULL,                 /* ref-cursor */
+                                                  ctx->sec_cur,         /* align-cursor */
+                                                  secondary_align_ids,  /* which id's */
+                                                  ctx->spot_group,      /* what read-group */
+                                                  ctx->sec_cur_ids      /* placement-context */
+                                                 );
+            if ( rc2 != 0 && !row_not_found_while_reading_column( rc2 ) )
             {
-                if ( ctx->sec_cur == NULL )
-                {
-                    rc2 = make_cursor_ids( ctx->data, &ctx->sec_cur_ids );
-                    if ( rc2 != 0 )
-                    {
-                        LOGERR( klogInt, rc2, "cannot create cursor-ids for sec. alignment cursor" );
-                    }
-                    else
-                        rc2 = prepare_sec_cursor( ctx->db, &ctx->sec_cur, ctx->omit_qualities,
-                                                  ctx->read_tlen, ctx->sec_cur_ids );
-                }
-
-                if ( rc2 == 0 )
-                {
-                    /* show_placement_params( "secondary", ctx->refobj, start, end ); */
-                    rc2 = ReferenceIteratorAddPlacements ( ctx->ref_iter,       /* the outer ref-iter */
-                                                          ctx->refobj,          /* the ref-obj for this chromosome */
-                                                          start - 1,            /* start ( zero-based ) */
-                                                          end - start + 1,      /* length */
-                                                          NULL,                 /* ref-cursor */
-                                                          ctx->sec_cur,         /* align-cursor */
-                                                          secondary_align_ids,  /* which id's */
-                                                          ctx->spot_group,      /* what read-group */
-                                                          ctx->sec_cur_ids      /* placement-context */
-                                                         );
-                    if ( rc2 != 0 && !row_not_found_while_reading_column( rc2 ) )
-                    {
-                        /* row_not_found_while_reading column within VDB happens if the
-                         requested reference-slice is empty, let's silence that */
-                        LOGERR( klogInt, rc2, "ReferenceIteratorAddPlacements(sec) failed" );
-                    }
-                }
+                /* row_not_found_while_reading column within VDB happens if the
+                 requested reference-slice is empty, let's silence that */
+                LOGERR( klogInt, rc2, "ReferenceIteratorAddPlacements(sec) failed" );
             }
+        }
+    }
 
-            if ( ctx->use_evidence_alignments )
+    if ( ctx->use_evidence_alignments )
+    {
+        if ( ctx->ev_cur == NULL )
+        {
+            rc3 = make_cursor_ids( ctx->data, &ctx->ev_cur_ids );
+            if ( rc3 != 0 )
             {
-                if ( ctx->ev_cur == NULL )
-                {
-                    rc3 = make_cursor_ids( ctx->data, &ctx->ev_cur_ids );
-                    if ( rc3 != 0 )
-                    {
-                        LOGERR( klogInt, rc3, "cannot create cursor-ids for ev. alignment cursor" );
-                    }
-                    else
-                        rc3 = prepare_evidence_cursor( ctx->db, &ctx->ev_cur, ctx->omit_qualities,
-                                                       ctx->read_tlen, ctx->ev_cur_ids );
-                }
-
-                if ( rc3 == 0 )
-                {
-                    /* show_placement_params( "evidende", ctx->refobj, start, end ); */
-                    rc3 = ReferenceIteratorAddPlacements ( ctx->ref_iter,       /* the outer ref-iter */
-                                                          ctx->refobj,          /* the ref-obj for this chromosome */
-                                                          start - 1,            /* start ( zero-based ) */
-                                                          end - start + 1,      /* length */
-                                                          NULL,                 /* ref-cursor */
-                                                          ctx->ev_cur,          /* align-cursor */
-                                                          evidence_align_ids,   /* which id's */
-                                                          ctx->spot_group,      /* what read-group */
-                                                          ctx->ev_cur_ids       /* placement-context */
-                                                         );
-                    if ( rc3 != 0 && !row_not_found_while_reading_column( rc3 ) )
-                    {
-                        /* row_not_found_while_reading column within VDB happens if the
-                         requested reference-slice is empty, let's silence that */
-                        LOGERR( klogInt, rc3, "ReferenceIteratorAddPlacements(evidence) failed" );
-                    }
-                }
+                LOGERR( klogInt, rc3, "cannot create cursor-ids for ev. alignment cursor" );
             }
+            else
+                rc3 = prepare_evidence_cursor( ctx->db, &ctx->ev_cur, ctx->omit_qualities,
+                                               ctx->read_tlen, ctx->ev_cur_ids );
+        }
 
-            if ( rc1 == SILENT_RC( rcAlign, rcType, rcAccessing, rcRow, rcNotFound ) )
-            { /* from allocate_populate_rec */
-                rc = rc1;
+        if ( rc3 == 0 )
+        {
+            /* show_placement_params( "evidende", ctx->refobj, start, end ); */
+            rc3 = ReferenceIteratorAddPlacements ( ctx->ref_iter,       /* the outer ref-iter */
+                                                  ctx->refobj,          /* the ref-obj for this chromosome */
+                                                  start - 1,            /* start ( zero-based ) */
+                                                  end - start + 1,      /* length */
+                                                  NULL,                 /* ref-cursor */
+                                                  ctx->ev_cur,          /* align-cursor */
+                                                  evidence_align_ids,   /* which id's */
+                                                  ctx->spot_group,      /* what read-group */
+                                                  ctx->ev_cur_ids       /* placement-context */
+                                                 );
+            if ( rc3 != 0 && !row_not_found_while_reading_column( rc3 ) )
+            {
+                /* row_not_found_while_reading column within VDB happens if the
+                 requested reference-slice is empty, let's silence that */
+                LOGERR( klogInt, rc3, "ReferenceIteratorAddPlacements(evidence) failed" );
             }
-            else if ( rc1 == 0 )
-                rc = 0;
-            else if ( rc2 == 0 )
-                rc = 0;
-            else if ( rc3 == 0 )
-                rc = 0;
-            else
-                rc = rc1;
         }
     }
+
+    if ( rc1 == SILENT_RC( rcAlign, rcType, rcAccessing, rcRow, rcNotFound ) )
+    { /* from allocate_populate_rec */
+        rc = rc1;
+    }
+    else if ( rc1 == 0 )
+        rc = 0;
+    else if ( rc2 == 0 )
+        rc = 0;
+    else if ( rc3 == 0 )
+        rc = 0;
+    else
+        rc = rc1;
+    return rc;
+}
+
+
+static rc_t CC prepare_section_cb( prepare_ctx * ctx, const struct reference_range * range )
+{
+    rc_t rc = 0;
+    if ( ctx->db == NULL || ctx->refobj == NULL )
+    {
+        rc = SILENT_RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
+        /* it is opened in prepare_db_table even if ctx->db == NULL */
+        PLOGERR( klogErr, ( klogErr, rc, "failed to process $(path)",
+            "path=%s", ctx->path == NULL ? "input argument" : ctx->path));
+        ReportSilence();
+    }
+    else
+    {
+        uint32_t start, end;
+        rc = get_section_bounds( ctx->refobj, range, &start, &end );
+        if ( rc == 0 )
+            rc = add_section_placements( ctx, start, end );
+    }
     return rc;
 }
 
@@ -1326,12 +1372,9 @@ typedef struct foreach_arg_ctx
 } foreach_arg_ctx;
 
 
-/* called for each source-file/accession */
-static rc_t CC on_argument( const char * path, const char * spot_group, void * data )
+static rc_t check_csra_source( const foreach_arg_ctx * ctx, const char * path )
 {
     rc_t rc = 0;
-    foreach_arg_ctx * ctx = ( foreach_arg_ctx * )data;
-
     int path_type = ( VDBManagerPathType ( ctx->vdb_mgr, "%s", path ) & ~ kptAlias );
     if ( path_type != kptDatabase )
     {
@@ -1356,55 +1399,458 @@ static rc_t CC on_argument( const char * path, const char * spot_group, void * d
                 rc = RC ( rcApp, rcNoTarg, rcOpening, rcItem, rcUnsupported );
                 PLOGERR( klogErr, ( klogErr, rc, "failed to open '$(path)', it is not a csra-database", "path=%s", path ) );
             }
+        }
+    }
+    return rc;
+}
+
+
+static void init_prepare_ctx( prepare_ctx * prep, const pileup_options * options, ReferenceIterator * ref_iter,
+                              const char * spot_group, void * data, const char * path )
+{
+    memset( prep, 0, sizeof *prep );
+    prep->omit_qualities = options->omit_qualities;
+    prep->read_tlen = options->read_tlen;
+    prep->use_primary_alignments = ( ( options->cmn.tab_select & primary_ats ) == primary_ats );
+    prep->use_secondary_alignments = ( ( options->cmn.tab_select & secondary_ats ) == secondary_ats );
+    prep->use_evidence_alignments = ( ( options->cmn.tab_select & evidence_ats ) == evidence_ats );
+    prep->ref_iter = ref_iter;
+    prep->spot_group = spot_group;
+    prep->on_section = prepare_section_cb;
+    prep->data = data;
+    prep->path = path;
+}
+
+
+/* called for each source-file/accession */
+static rc_t CC on_argument( const char * path, const char * spot_group, void * data )
+{
+    foreach_arg_ctx * ctx = ( foreach_arg_ctx * )data;
+    rc_t rc = check_csra_source( ctx, path );
+    if ( rc == 0 )
+    {
+        prepare_ctx prep;   /* from cmdline_cmn.h */
+
+        init_prepare_ctx( &prep, ctx->options, ctx->ref_iter, spot_group, ctx->cursor_ids, path );
+        rc = prepare_ref_iter( &prep, ctx->vdb_mgr, ctx->vdb_schema, path, ctx->ranges ); /* cmdline_cmn.c */
+        if ( rc == 0 && prep.db == NULL )
+        {
+            rc = RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
+            LOGERR( klogInt, rc, "unsupported source" );
+        }
+        if ( prep.prim_cur != NULL ) VCursorRelease( prep.prim_cur );
+        if ( prep.sec_cur != NULL ) VCursorRelease( prep.sec_cur );
+        if ( prep.ev_cur != NULL ) VCursorRelease( prep.ev_cur );
+    }
+    return rc;
+}
+
+
+/* free all cursor-ids-blocks created in parallel with the alignment-cursor */
+static void CC cur_id_vector_entry_whack( void *item, void *data )
+{
+    pileup_col_ids * ids = item;
+    free( ids );
+}
+
+
+static rc_t make_ref_iter( pileup_callback_data * cb_data, ReferenceIterator ** ref_iter )
+{
+    PlacementRecordExtendFuncs cb_block;
+    rc_t rc;
+
+    cb_block.data = cb_data;
+    cb_block.destroy = NULL;
+    cb_block.populate = populate_tooldata;
+    cb_block.alloc_size = alloc_size;
+    cb_block.fixed_size = 0;
+
+    rc = AlignMgrMakeReferenceIterator ( cb_data->almgr, ref_iter, &cb_block, cb_data->options->minmapq );
+    if ( rc != 0 )
+    {
+        LOGERR( klogInt, rc, "AlignMgrMakeReferenceIterator() failed" );
+    }
+    return rc;
+}
+
+
+static rc_t walk_pileup( ReferenceIterator *ref_iter, pileup_options *options )
+{
+    rc_t rc;
+    switch( options->function )
+    {
+        case sra_pileup_stat        : rc = walk_stat( ref_iter, options ); break;
+        case sra_pileup_counters    : rc = walk_counters( ref_iter, options ); break;
+        case sra_pileup_debug       : rc = walk_debug( ref_iter, options ); break;
+        case sra_pileup_mismatch    : rc = walk_mismatches( ref_iter, options ); break;
+        case sra_pileup_index       : rc = walk_index( ref_iter, options ); break;
+        case sra_pileup_varcount    : rc = walk_varcount( ref_iter, options ); break;
+        case sra_pileup_indels      : rc = walk_indels( ref_iter, options ); break;
+        case sra_pileup_binary      : rc = walk_binary( ref_iter, options ); break;
+        default :  rc = walk_ref_iter( ref_iter, options ); break;
+    }
+    return rc;
+}
+
+/* =========================================================================================== */
+
+/*
+   multi-threaded pileup ( --threads ):
+   the sections the serial path adds to its reference-iterator ( whole references, or the
+   requested ranges after check_ref_regions() merged them ) are cut into slices, every slice
+   is a job. Each worker has its own alignment-manager, database, reflist, cursors and skiplist,
+   and walks each slice with a new reference-iterator: it fetches all alignments overlapping
+   the slice, but reports only the positions inside of it. The output of the slices is written
+   by ordered_out.c in the order of the serial path, the concatenation is the same output.
+*/
+
+#define SLICE_OUT_CHUNK_SIZE    ( 64 * 1024 )
+#define SLICE_OUT_MAX_QUEUED    256
+#define SLICE_MIN_LEN           ( 64 * 1024 )
+#define SLICE_MAX_LEN           ( 4 * 1024 * 1024 )
+#define SLICES_PER_THREAD       8
+
+typedef struct slice_job
+{
+    uint32_t ref_idx;   /* index of the reference in the reflist of the source */
+    uint32_t start;     /* 1-based, inclusive */
+    uint32_t end;
+} slice_job;
+
+
+typedef struct slice_list
+{
+    slice_job * jobs;
+    uint32_t count;
+    uint32_t allocated;
+    uint64_t total_len;
+} slice_list;
+
+
+static rc_t add_slice_job( slice_list * list, uint32_t ref_idx, uint32_t start, uint32_t end )
+{
+    if ( list->count >= list->allocated )
+    {
+        uint32_t allocated = ( list->allocated == 0 ) ? 64 : list->allocated * 2;
+        slice_job * jobs = realloc( list->jobs, allocated * sizeof *jobs );
+        if ( jobs == NULL )
+        {
+            rc_t rc = RC ( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            LOGERR( klogInt, rc, "cannot create list of slices" );
+            return rc;
+        }
+        list->jobs = jobs;
+        list->allocated = allocated;
+    }
+    list->jobs[ list->count ].ref_idx = ref_idx;
+    list->jobs[ list->count ].start = start;
+    list->jobs[ list->count ].end = end;
+    list->count++;
+    list->total_len += ( end - start + 1 );
+    return 0;
+}
+
+
+/* called by prepare_ref_iter() in the order the serial path adds the sections to its ref-iter */
+static rc_t CC collect_section_cb( prepare_ctx * ctx, const struct reference_range * range )
+{
+    rc_t rc = 0;
+    if ( ctx->db == NULL || ctx->refobj == NULL )
+    {
+        rc = SILENT_RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
+        PLOGERR( klogErr, ( klogErr, rc, "failed to process $(path)",
+            "path=%s", ctx->path == NULL ? "input argument" : ctx->path));
+    }
+    else
+    {
+        uint32_t start, end;
+        rc = get_section_bounds( ctx->refobj, range, &start, &end );
+        if ( rc == 0 && start <= end )
+        {
+            uint32_t ref_idx;
+            rc = ReferenceObj_Idx( ctx->refobj, &ref_idx );
+            if ( rc != 0 )
+            {
+                LOGERR( klogInt, rc, "ReferenceObj_Idx() failed" );
+            }
             else
+                rc = add_slice_job( ctx->data, ref_idx, start, end );
+        }
+    }
+    return rc;
+}
+
+
+/* the slice-length adapts to the amount of work, so that each worker gets a couple of slices */
+static rc_t cut_sections_into_slices( const slice_list * sections, uint32_t threads, slice_list * slices )
+{
+    rc_t rc = 0;
+    uint32_t idx;
+    uint64_t slice_len = sections->total_len / ( ( uint64_t )threads * SLICES_PER_THREAD );
+
+    if ( slice_len < SLICE_MIN_LEN )
+        slice_len = SLICE_MIN_LEN;
+    else if ( slice_len > SLICE_MAX_LEN )
+        slice_len = SLICE_MAX_LEN;
+
+    for ( idx = 0; idx < sections->count && rc == 0; ++idx )
+    {
+        const slice_job * section = &sections->jobs[ idx ];
+        uint64_t start = section->start;
+        while ( rc == 0 && start <= section->end )
+        {
+            uint64_t end = start + slice_len - 1;
+            if ( end > section->end )
+                end = section->end;
+            rc = add_slice_job( slices, section->ref_idx, ( uint32_t )start, ( uint32_t )end );
+            start = end + 1;
+        }
+    }
+    return rc;
+}
+
+
+typedef struct slice_worker
+{
+    pileup_options options;         /* copy of the tool-options, with its own skiplist */
+    pileup_callback_data cb_data;   /* with its own alignment-manager */
+    prepare_ctx prep;               /* its own database, reflist and cursors */
+    Vector cursor_ids;
+    const slice_job * jobs;
+    struct ordered_out * out;
+    KThread * thread;
+} slice_worker;
+
+
+static rc_t walk_slice( slice_worker * w, const slice_job * job )
+{
+    ReferenceIterator * ref_iter;
+    rc_t rc = make_ref_iter( &w->cb_data, &ref_iter );
+    if ( rc == 0 )
+    {
+        rc = ReferenceList_Get( w->prep.reflist, &w->prep.refobj, job->ref_idx );
+        if ( rc != 0 )
+        {
+            LOGERR( klogInt, rc, "ReferenceList_Get() failed" );
+        }
+        else
+        {
+            w->prep.ref_iter = ref_iter;
+            rc = add_section_placements( &w->prep, job->start, job->end );
+            ReferenceObj_Release( w->prep.refobj );
+            w->prep.refobj = NULL;
+            w->prep.ref_iter = NULL;
+
+            /* a slice without alignments produces no output */
+            if ( row_not_found_while_reading_column( rc ) )
+                rc = 0;
+            else if ( rc == 0 )
+                rc = walk_pileup( ref_iter, &w->options );
+        }
+        ReferenceIteratorRelease( ref_iter );
+    }
+    return rc;
+}
+
+
+static rc_t CC slice_worker_thread( const KThread * self, void * data )
+{
+    slice_worker * w = data;
+    rc_t rc = 0;
+    uint32_t job;
+
+    while ( rc == 0 && ordered_out_next_job( w->out, &job ) )
+    {
+        ordered_out_set_thread_job( w->out, job ); /* KOutMsg() of this thread goes into this job */
+        rc = walk_slice( w, &w->jobs[ job ] );
+        ordered_out_set_thread_job( NULL, 0 );
+        rc = ordered_out_job_done( w->out, job, rc ); /* ordered_out.c */
+    }
+    return rc;
+}
+
+
+/* all resources of a worker are made on the main-thread, the worker only opens its cursors */
+static rc_t init_slice_worker( slice_worker * w, const foreach_arg_ctx * ctx,
+                               const char * path, const char * spot_group )
+{
+    rc_t rc;
+
+    w->options = *( ctx->options );
+    w->options.skiplist = skiplist_make( ctx->ranges ); /* ref_regions.c */
+    w->cb_data.options = &w->options;
+    VectorInit ( &w->cursor_ids, 0, 4 );
+    init_prepare_ctx( &w->prep, &w->options, NULL, spot_group, &w->cursor_ids, path );
+
+    rc = AlignMgrMakeRead ( &w->cb_data.almgr );
+    if ( rc != 0 )
+    {
+        LOGERR( klogInt, rc, "AlignMgrMake() failed" );
+    }
+    else
+    {
+        rc = open_ref_source( &w->prep, ctx->vdb_mgr, ctx->vdb_schema, path ); /* cmdline_cmn.c */
+        if ( rc == 0 && w->prep.reflist == NULL )
+        {
+            rc = RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
+            LOGERR( klogInt, rc, "unsupported source" );
+        }
+    }
+    return rc;
+}
+
+
+static void release_slice_worker( slice_worker * w )
+{
+    if ( w->prep.prim_cur != NULL ) VCursorRelease( w->prep.prim_cur );
+    if ( w->prep.sec_cur != NULL ) VCursorRelease( w->prep.sec_cur );
+    if ( w->prep.ev_cur != NULL ) VCursorRelease( w->prep.ev_cur );
+    close_ref_source( &w->prep ); /* cmdline_cmn.c */
+    if ( w->cb_data.almgr != NULL ) AlignMgrRelease ( w->cb_data.almgr );
+    VectorWhack ( &w->cursor_ids, cur_id_vector_entry_whack, NULL );
+    if ( w->options.skiplist != NULL ) skiplist_release( w->options.skiplist );
+}
+
+
+static rc_t pileup_slices( const foreach_arg_ctx * ctx, const slice_list * slices,
+                           const char * path, const char * spot_group )
+{
+    struct ordered_out * out;
+    rc_t rc = make_ordered_out( &out, slices->count, SLICE_OUT_CHUNK_SIZE, SLICE_OUT_MAX_QUEUED ); /* ordered_out.c */
+    if ( rc == 0 )
+    {
+        uint32_t worker_count = ( ctx->options->threads < slices->count ) ? ctx->options->threads : slices->count;
+        slice_worker * workers = calloc( worker_count, sizeof *workers );
+        if ( workers == NULL )
+        {
+            rc = RC ( rcApp, rcNoTarg, rcConstructing, rcMemory, rcExhausted );
+            LOGERR( klogInt, rc, "cannot create worker-threads" );
+        }
+        else
+        {
+            uint32_t idx, initialized = 0, started = 0;
+            for ( idx = 0; idx < worker_count && rc == 0; ++idx )
             {
-                prepare_ctx prep;   /* from cmdline_cmn.h */
-
-                prep.omit_qualities = ctx->options->omit_qualities;
-                prep.read_tlen = ctx->options->read_tlen;
-                prep.use_primary_alignments = ( ( ctx->options->cmn.tab_select & primary_ats ) == primary_ats );
-                prep.use_secondary_alignments = ( ( ctx->options->cmn.tab_select & secondary_ats ) == secondary_ats );
-                prep.use_evidence_alignments = ( ( ctx->options->cmn.tab_select & evidence_ats ) == evidence_ats );
-                prep.ref_iter = ctx->ref_iter;
-                prep.spot_group = spot_group;
-                prep.on_section = prepare_section_cb;
-                prep.data = ctx->cursor_ids;
-                prep.path = path;
-                prep.db = NULL;
-                prep.prim_cur = NULL;
-                prep.sec_cur = NULL;
-                prep.ev_cur = NULL;
-                
-                rc = prepare_ref_iter( &prep, ctx->vdb_mgr, ctx->vdb_schema, path, ctx->ranges ); /* cmdline_cmn.c */
-                if ( rc == 0 && prep.db == NULL )
+                workers[ idx ].jobs = slices->jobs;
+                workers[ idx ].out = out;
+                rc = init_slice_worker( &workers[ idx ], ctx, path, spot_group );
+                initialized++;
+            }
+
+            if ( rc == 0 )
+                rc = ordered_out_capture( out ); /* ordered_out.c */
+
+            for ( idx = 0; idx < worker_count && rc == 0; ++idx )
+            {
+                rc = KThreadMake ( &workers[ idx ].thread, slice_worker_thread, &workers[ idx ] );
+                if ( rc != 0 )
                 {
-                    rc = RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
-                    LOGERR( klogInt, rc, "unsupported source" );
+                    LOGERR( klogInt, rc, "KThreadMake() failed" );
                 }
-                if ( prep.prim_cur != NULL ) VCursorRelease( prep.prim_cur );
-                if ( prep.sec_cur != NULL ) VCursorRelease( prep.sec_cur );
-                if ( prep.ev_cur != NULL ) VCursorRelease( prep.ev_cur );
+                else
+                    started++;
             }
+            if ( rc != 0 )
+                ordered_out_abort( out, rc );
+
+            if ( started > 0 )
+            {
+                /* the main-thread writes the output of the slices in order */
+                rc_t rc1 = ordered_out_merge( out );
+                if ( rc == 0 )
+                    rc = rc1;
+            }
+
+            for ( idx = 0; idx < started; ++idx )
+            {
+                rc_t status;
+                rc_t rc1 = KThreadWait ( workers[ idx ].thread, &status );
+                if ( rc1 == 0 )
+                    rc1 = status;
+                if ( rc == 0 )
+                    rc = rc1;
+                KThreadRelease ( workers[ idx ].thread );
+            }
+
+            for ( idx = 0; idx < initialized; ++idx )
+                release_slice_worker( &workers[ idx ] );
+            free( workers );
         }
+        release_ordered_out( out );
     }
     return rc;
 }
 
 
-/* free all cursor-ids-blocks created in parallel with the alignment-cursor */
-static void CC cur_id_vector_entry_whack( void *item, void *data )
+/* called for the only source-file/accession, if the pileup runs in worker-threads */
+static rc_t CC on_argument_mt( const char * path, const char * spot_group, void * data )
 {
-    pileup_col_ids * ids = item;
-    free( ids );
+    foreach_arg_ctx * ctx = ( foreach_arg_ctx * )data;
+    rc_t rc = check_csra_source( ctx, path );
+    if ( rc == 0 )
+    {
+        slice_list sections, slices;
+        prepare_ctx prep;   /* from cmdline_cmn.h */
+
+        memset( &sections, 0, sizeof sections );
+        memset( &slices, 0, sizeof slices );
+
+        init_prepare_ctx( &prep, ctx->options, NULL, spot_group, &sections, path );
+        prep.on_section = collect_section_cb;
+        rc = prepare_ref_iter( &prep, ctx->vdb_mgr, ctx->vdb_schema, path, ctx->ranges ); /* cmdline_cmn.c */
+        if ( rc == 0 && prep.db == NULL )
+        {
+            rc = RC ( rcApp, rcNoTarg, rcOpening, rcSelf, rcInvalid );
+            LOGERR( klogInt, rc, "unsupported source" );
+        }
+
+        if ( rc == 0 )
+            rc = cut_sections_into_slices( &sections, ctx->options->threads, &slices );
+        if ( rc == 0 && slices.count > 0 )
+            rc = pileup_slices( ctx, &slices, path, spot_group );
+
+        free( sections.jobs );
+        free( slices.jobs );
+    }
+    return rc;
 }
 
 
+/* the slices of a reference can only be walked independently, if the output of a position
+   does not depend on other positions ( stat and debug report per reference / per window ),
+   with --noskip the serial path reports empty positions of a window, an empty slice does not */
+static bool use_slice_threads( Args * args, const pileup_options * options )
+{
+    uint32_t count = 0;
+
+    if ( options->threads < 2 || options->no_skip )
+        return false;
+
+    switch( options->function )
+    {
+        case sra_pileup_samtools    :
+        case sra_pileup_counters    :
+        case sra_pileup_mismatch    :
+        case sra_pileup_index       :
+        case sra_pileup_varcount    :
+        case sra_pileup_indels      :
+        case sra_pileup_binary      : break;
+        default                     : return false;
+    }
+
+    /* the ref-iter of the serial path merges the alignments of all sources */
+    return ( ArgsParamCount( args, &count ) == 0 && count == 1 );
+}
+
+
+
 static rc_t pileup_main( Args * args, pileup_options *options )
 {
     foreach_arg_ctx arg_ctx;
     pileup_callback_data cb_data;
     KDirectory * dir = NULL;
     Vector cur_ids_vector;
+    bool walked = false;
 
     /* (1) make the align-manager ( necessary to make a ReferenceIterator... ) */
     rc_t rc = AlignMgrMakeRead ( &cb_data.almgr );
@@ -1421,21 +1867,7 @@ static rc_t pileup_main( Args * args, pileup_options *options )
 
     /* (2) make the reference-iterator */
     if ( rc == 0 )
-    {
-        PlacementRecordExtendFuncs cb_block;
-
-        cb_block.data = &cb_data;
-        cb_block.destroy = NULL;
-        cb_block.populate = populate_tooldata;
-        cb_block.alloc_size = alloc_size;
-        cb_block.fixed_size = 0;
-
-        rc = AlignMgrMakeReferenceIterator ( cb_data.almgr, &arg_ctx.ref_iter, &cb_block, options->minmapq );
-        if ( rc != 0 )
-        {
-            LOGERR( klogInt, rc, "AlignMgrMakeReferenceIterator() failed" );
-        }
-    }
+        rc = make_ref_iter( &cb_data, &arg_ctx.ref_iter );
 
     /* (3) make a KDirectory ( necessary to make a vdb-manager ) */
     if ( rc == 0 )
@@ -1519,6 +1951,10 @@ static rc_t pileup_main( Args * args, pileup_options *options )
             case sra_pileup_varcount   : options->omit_qualities = true;
                                           options->read_tlen = false;
                                           break;
+
+            case sra_pileup_binary     : options->omit_qualities = true;
+                                          options->read_tlen = false;
+                                          break;
         }
     }
 
@@ -1535,7 +1971,14 @@ static rc_t pileup_main( Args * args, pileup_options *options )
             options->skiplist = skiplist_make( &regions ); /* create skiplist for neighboring slices */
 
             arg_ctx.ranges = &regions;
-            rc = foreach_argument( args, dir, options->div_by_spotgrp, &empty, on_argument, &arg_ctx ); /* cmdline_cmn.c */
+            if ( use_slice_threads( args, options ) )
+            {
+                /* the slices are walked by the worker-threads, the ref-iter stays empty */
+                rc = foreach_argument( args, dir, options->div_by_spotgrp, &empty, on_argument_mt, &arg_ctx ); /* cmdline_cmn.c */
+                walked = true;
+            }
+            else
+                rc = foreach_argument( args, dir, options->div_by_spotgrp, &empty, on_argument, &arg_ctx ); /* cmdline_cmn.c */
             if ( empty )
             {
                 Usage ( args );
@@ -1546,20 +1989,10 @@ static rc_t pileup_main( Args * args, pileup_options *options )
     }
 
     /* (6) walk the "loaded" ref-iterator ===> perform the pileup */
-    if ( rc == 0 )
+    if ( rc == 0 && !walked )
     {
         /* ============================================== */
-        switch( options->function )
-        {
-            case sra_pileup_stat        : rc = walk_stat( arg_ctx.ref_iter, options ); break;
-            case sra_pileup_counters    : rc = walk_counters( arg_ctx.ref_iter, options ); break;
-            case sra_pileup_debug       : rc = walk_debug( arg_ctx.ref_iter, options ); break;
-            case sra_pileup_mismatch    : rc = walk_mismatches( arg_ctx.ref_iter, options ); break;
-            case sra_pileup_index       : rc = walk_index( arg_ctx.ref_iter, options ); break;
-            case sra_pileup_varcount    : rc = walk_varcount( arg_ctx.ref_iter, options ); break;
-			case sra_pileup_indels      : rc = walk_indels( arg_ctx.ref_iter, options ); break;
-            default :  rc = walk_ref_iter( arg_ctx.ref_iter, options ); break;
-        }
+        rc = walk_pileup( arg_ctx.ref_iter, options );
         /* ============================================== */
     }
 
@@ -1643,8 +2076,12 @@ rc_t CC KMain( int argc, char *argv [] )
                         }
                         else
                         {
+                            if ( options.function == sra_pileup_binary )
+                                rc = write_pileup_bin_header(); /* pileup_binary.c */
+
                             /* ============================== */
-                            rc = pileup_main( args, &options );
+                            if ( rc == 0 )
+                                rc = pileup_main( args, &options );
                             /* ============================== */
                         }
                     }
@@ -396,6 +396,9 @@ void BufferedPairColWriterWriteMapped ( BufferedPairColWriter *self, const ctx_t
         /* detect last row */
         if ( ++ self -> cur_item == self -> num_items )
         {
+            /* rows are about to be visited in new-id order */
+            MemBankAdvise ( self -> mbank, ctx, mbaRandom );
+
             /* map values */
             TRY ( BufferedPairColWriterMapValues ( self, ctx ) )
             {
@@ -614,6 +617,7 @@ void BufferedPairColWriterWriteUnmapped ( BufferedPairColWriter *self, const ctx
             /* write all rows to column writer */
 	    uint32_t *last_base=NULL;
 	    uint32_t   cnt=0;
+            MemBankAdvise ( self -> mbank, ctx, mbaRandom );
             STATUS ( 3, "writing cell data to '%s' num_items=%ld vocab_size=%d num_immed=%d", ColumnWriterFullSpec ( self -> cw, ctx ), self -> num_items, self ->vocab_cnt, self -> num_immed );
             for ( i = 0; ! FAILED () && i < self -> num_items; ++ i )
             {
@@ -634,6 +634,10 @@ ColumnPair *TablePairMakeColumnPair ( TablePair *self, const ctx_t *ctx,
                 col -> presorted = reader -> presorted;
                 col -> large = large;
 
+                /* simple readers and writers own their cursors */
+                col -> independent = reader -> vt == & SimpleColumnReader_vt &&
+                                     writer -> vt == & SimpleColumnWriter_vt;
+
                 rc = string_printf ( col -> full_spec, full_spec_size + 1, NULL,
                     "%s.%s", self -> full_spec, colspec );
                 if ( rc == 0 )
@@ -664,7 +668,10 @@ ColumnPair *TablePairMakeStaticColumnPair ( TablePair *self, const ctx_t *ctx,
     TRY ( col = TablePairMakeColumnPair ( self, ctx, reader, writer, colspec, false ) )
     {
         if ( col != NULL )
+        {
             col -> is_static = true;
+            col -> independent = false;
+        }
     }
 
     return col;
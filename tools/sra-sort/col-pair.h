@@ -275,6 +275,10 @@ struct ColumnPair
 
     bool large;
 
+    /* true if reader and writer share no state with other columns,
+       and may be copied concurrently with them */
+    bool independent;
+
     char full_spec [ 1 ];
 };
 
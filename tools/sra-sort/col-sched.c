@@ -0,0 +1,419 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include "col-sched.h"
+#include "col-pair.h"
+#include "row-set.h"
+#include "ctx.h"
+#include "caps.h"
+#include "except.h"
+#include "status.h"
+#include "mem.h"
+#include "sra-sort.h"
+
+#include <klib/vector.h>
+#include <klib/rc.h>
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+
+FILE_ENTRY ( col-sched );
+
+
+/* upper limit on the number of worker threads */
+#define MAX_COL_WORKERS 64
+
+/* estimated working set of a single column copy,
+   i.e. the source cursor blob cache plus the open destination blob.
+   this memory is not allocated from the MemBank, but must fit
+   within its remaining quota for a worker to be started */
+#define COL_WORKER_RESERVE ( 32 * 1024 * 1024 )
+
+
+/*--------------------------------------------------------------------------
+ * ColumnWorker
+ *  one thread of the pool, with its own capabilities
+ */
+typedef struct ColumnWorker ColumnWorker;
+struct ColumnWorker
+{
+    Caps caps;
+    ColumnScheduler *sched;
+    KThread *t;
+};
+
+
+/*--------------------------------------------------------------------------
+ * ColumnScheduler
+ */
+struct ColumnScheduler
+{
+    /* all columns, borrowed */
+    const Vector *cols;
+
+    /* independent columns */
+    ColumnPair **indep;
+    uint32_t num_indep;
+
+    /* worker threads */
+    ColumnWorker *workers;
+    uint32_t max_workers;
+    uint32_t num_workers;
+
+    /* lock guards everything below */
+    KLock *lock;
+
+    /* a row-set was posted or the pool is stopping */
+    KCondition *ready;
+
+    /* the last column in progress was finished */
+    KCondition *done;
+
+    /* current row-set, only read by workers */
+    const RowSet *rs;
+
+    /* next column to hand out, and columns in progress */
+    uint32_t next_col;
+    uint32_t busy;
+
+    /* first failure reported by a worker */
+    rc_t rc;
+
+    bool stopping;
+};
+
+
+/* WorkerRun
+ *  take columns of the posted row-set until the pool stops
+ */
+static
+rc_t CC ColumnWorkerRun ( const KThread *t, void *data )
+{
+    ColumnWorker *w = data;
+    ColumnScheduler *sched = w -> sched;
+
+    DECLARE_CTX_INFO ();
+    ctx_t thread_ctx = { & w -> caps, NULL, & ctx_info };
+    const ctx_t *ctx = & thread_ctx;
+
+    STATUS ( 4, "column copy thread 0x%p started", t );
+
+    KLockAcquire ( sched -> lock );
+    while ( ! sched -> stopping )
+    {
+        if ( sched -> next_col == sched -> num_indep )
+            KConditionWait ( sched -> ready, sched -> lock );
+        else
+        {
+            RowSet *view;
+            const RowSet *rs = sched -> rs;
+            ColumnPair *col = sched -> indep [ sched -> next_col ++ ];
+            ++ sched -> busy;
+            KLockUnlock ( sched -> lock );
+
+            /* each column walks the shared row-set on its own */
+            TRY ( view = RowSetMakeView ( rs, ctx ) )
+            {
+                ColumnPairCopy ( col, ctx, view );
+                RowSetRelease ( view, ctx );
+            }
+
+            KLockAcquire ( sched -> lock );
+            if ( FAILED () )
+            {
+                /* record failure and hand out no more columns */
+                if ( sched -> rc == 0 )
+                    sched -> rc = ctx -> rc;
+                sched -> next_col = sched -> num_indep;
+
+                /* the error has been reported */
+                thread_ctx . rc = 0;
+            }
+            if ( -- sched -> busy == 0 )
+                KConditionSignal ( sched -> done );
+        }
+    }
+    KLockUnlock ( sched -> lock );
+
+    STATUS ( 4, "column copy thread 0x%p finished", t );
+
+    CapsWhack ( & w -> caps, ctx );
+    return 0;
+}
+
+
+/* Start
+ *  collect independent columns and start workers
+ */
+static
+void ColumnSchedulerStart ( ColumnScheduler *self, const ctx_t *ctx, uint32_t max_workers )
+{
+    FUNC_ENTRY ( ctx );
+
+    TRY ( self -> indep = MemAlloc ( ctx, sizeof self -> indep [ 0 ] * self -> num_indep, false ) )
+    {
+        uint32_t i, j, count = VectorLength ( self -> cols );
+        for ( i = j = 0; i < count; ++ i )
+        {
+            ColumnPair *col = VectorGet ( self -> cols, i );
+            if ( col -> independent )
+                self -> indep [ j ++ ] = col;
+        }
+
+        /* start with nothing to hand out */
+        self -> next_col = self -> num_indep;
+
+        TRY ( self -> workers = MemAlloc ( ctx, sizeof self -> workers [ 0 ] * max_workers, true ) )
+        {
+            rc_t rc;
+
+            self -> max_workers = max_workers;
+
+            rc = KLockMake ( & self -> lock );
+            if ( rc != 0 )
+                ERROR ( rc, "failed to create column scheduler lock" );
+            else
+            {
+                rc = KConditionMake ( & self -> ready );
+                if ( rc == 0 )
+                    rc = KConditionMake ( & self -> done );
+                if ( rc != 0 )
+                    ERROR ( rc, "failed to create column scheduler condition" );
+            }
+
+            for ( i = 0; ! FAILED () && i < max_workers; ++ i )
+            {
+                ColumnWorker *w = & self -> workers [ i ];
+                w -> sched = self;
+
+                TRY ( CapsInit ( & w -> caps, ctx ) )
+                {
+                    rc = KThreadMake ( & w -> t, ColumnWorkerRun, w );
+                    if ( rc == 0 )
+                        ++ self -> num_workers;
+                    else
+                    {
+                        ERROR ( rc, "failed to start column copy thread" );
+                        CapsWhack ( & w -> caps, ctx );
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/* Make
+ *  create a scheduler for the ColumnPairs in "cols"
+ */
+ColumnScheduler *ColumnSchedulerMake ( const ctx_t *ctx, const Vector *cols )
+{
+    FUNC_ENTRY ( ctx );
+
+    ColumnScheduler *self;
+
+    TRY ( self = MemAlloc ( ctx, sizeof * self, true ) )
+    {
+        uint32_t i, count = VectorLength ( cols );
+        uint32_t max_workers = ctx -> caps -> tool -> num_threads;
+
+        self -> cols = cols;
+
+        for ( i = 0; i < count; ++ i )
+        {
+            const ColumnPair *col = VectorGet ( cols, i );
+            if ( col -> independent )
+                ++ self -> num_indep;
+        }
+
+        /* more workers than columns would only sleep */
+        if ( max_workers > MAX_COL_WORKERS )
+            max_workers = MAX_COL_WORKERS;
+        if ( max_workers > self -> num_indep )
+            max_workers = self -> num_indep;
+
+        /* leave the memory quota intact */
+        if ( max_workers > 1 )
+        {
+            size_t quota, in_use = MemInUse ( ctx, & quota );
+            size_t avail = ( in_use < quota ) ? quota - in_use : 0;
+            if ( avail / COL_WORKER_RESERVE < max_workers )
+            {
+                max_workers = ( uint32_t ) ( avail / COL_WORKER_RESERVE );
+                STATUS ( 3, "memory quota limits column copy threads to %u", max_workers );
+            }
+        }
+
+        /* a single worker is no better than the calling thread */
+        if ( max_workers < 2 )
+            return self;
+
+        STATUS ( 3, "copying %u of %u columns on %u threads", self -> num_indep, count, max_workers );
+
+        TRY ( ColumnSchedulerStart ( self, ctx, max_workers ) )
+        {
+            return self;
+        }
+
+        ColumnSchedulerRelease ( self, ctx );
+    }
+
+    return NULL;
+}
+
+
+/* Release
+ *  stops and joins worker threads
+ */
+void ColumnSchedulerRelease ( ColumnScheduler *self, const ctx_t *ctx )
+{
+    FUNC_ENTRY ( ctx );
+
+    if ( self != NULL )
+    {
+        uint32_t i;
+
+        if ( self -> num_workers != 0 )
+        {
+            KLockAcquire ( self -> lock );
+            self -> stopping = true;
+            KConditionBroadcast ( self -> ready );
+            KLockUnlock ( self -> lock );
+        }
+
+        for ( i = 0; i < self -> num_workers; ++ i )
+        {
+            rc_t status;
+            rc_t rc = KThreadWait ( self -> workers [ i ] . t, & status );
+            if ( rc != 0 )
+                ERROR ( rc, "failed to wait for column copy thread" );
+            KThreadRelease ( self -> workers [ i ] . t );
+        }
+
+        KConditionRelease ( self -> done );
+        KConditionRelease ( self -> ready );
+        KLockRelease ( self -> lock );
+
+        if ( self -> workers != NULL )
+            MemFree ( ctx, self -> workers, sizeof self -> workers [ 0 ] * self -> max_workers );
+        if ( self -> indep != NULL )
+            MemFree ( ctx, self -> indep, sizeof self -> indep [ 0 ] * self -> num_indep );
+
+        MemFree ( ctx, self, sizeof * self );
+    }
+}
+
+
+/* Wait
+ *  wait for the workers to finish the posted row-set
+ *  "cancel" hands out no more columns
+ */
+static
+void ColumnSchedulerWait ( ColumnScheduler *self, const ctx_t *ctx, bool cancel )
+{
+    FUNC_ENTRY ( ctx );
+
+    rc_t rc;
+
+    KLockAcquire ( self -> lock );
+    if ( cancel )
+        self -> next_col = self -> num_indep;
+    while ( self -> next_col != self -> num_indep || self -> busy != 0 )
+        KConditionWait ( self -> done, self -> lock );
+    self -> rs = NULL;
+    rc = self -> rc;
+    KLockUnlock ( self -> lock );
+
+    if ( rc != 0 && ! cancel )
+        ERROR ( rc, "failed to copy columns concurrently" );
+}
+
+
+/* Copy
+ *  copy all columns for a single RowSet
+ */
+void ColumnSchedulerCopy ( ColumnScheduler *self, const ctx_t *ctx, RowSet *rs )
+{
+    FUNC_ENTRY ( ctx );
+
+    uint32_t i = 0, count = VectorLength ( self -> cols );
+
+    if ( self -> num_workers != 0 )
+    {
+        RowSet *view;
+
+        /* establish the row-ids once, for all views */
+        ON_FAIL ( RowSetReset ( rs, ctx, false ) )
+            return;
+
+        TRY ( view = RowSetMakeView ( rs, ctx ) )
+        {
+            KLockAcquire ( self -> lock );
+            self -> rs = rs;
+            self -> next_col = 0;
+            self -> rc = 0;
+            KConditionBroadcast ( self -> ready );
+            KLockUnlock ( self -> lock );
+
+            /* meanwhile copy the other columns in order, through a view
+               of our own, up to the first static column: it has to
+               reset "rs" and waits for the workers */
+            for ( ; i < count; ++ i )
+            {
+                ColumnPair *col = VectorGet ( self -> cols, i );
+                assert ( col != NULL );
+
+                if ( col -> independent )
+                    continue;
+                if ( col -> is_static )
+                    break;
+
+                ON_FAIL ( ColumnPairCopy ( col, ctx, view ) )
+                    break;
+            }
+
+            RowSetRelease ( view, ctx );
+
+            ColumnSchedulerWait ( self, ctx, FAILED () );
+        }
+
+        if ( FAILED () )
+            return;
+    }
+
+    /* copy the remaining columns in order */
+    for ( ; i < count; ++ i )
+    {
+        ColumnPair *col = VectorGet ( self -> cols, i );
+        assert ( col != NULL );
+
+        if ( self -> num_workers != 0 && col -> independent )
+            continue;
+
+        ON_FAIL ( ColumnPairCopy ( col, ctx, rs ) )
+            break;
+    }
+}
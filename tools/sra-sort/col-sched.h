@@ -0,0 +1,77 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+#ifndef _h_sra_sort_col_sched_
+#define _h_sra_sort_col_sched_
+
+#ifndef _h_sra_sort_defs_
+#include "sort-defs.h"
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * forwards
+ */
+struct Vector;
+struct RowSet;
+
+
+/*--------------------------------------------------------------------------
+ * ColumnScheduler
+ *  copies a vector of ColumnPairs for each RowSet,
+ *  dispatching independent columns to a pool of worker threads
+ */
+typedef struct ColumnScheduler ColumnScheduler;
+
+
+/* Make
+ *  create a scheduler for the ColumnPairs in "cols"
+ *  the vector is borrowed, and must outlive the scheduler
+ *
+ *  the number of workers is taken from Tool, and reduced to
+ *  the number of independent columns and to what the remaining
+ *  MemBank quota can accommodate. with fewer than two workers,
+ *  all columns are copied on the calling thread.
+ */
+ColumnScheduler *ColumnSchedulerMake ( const ctx_t *ctx, struct Vector const *cols );
+
+
+/* Release
+ *  stops and joins worker threads
+ */
+void ColumnSchedulerRelease ( ColumnScheduler *self, const ctx_t *ctx );
+
+
+/* Copy
+ *  copy all columns for a single RowSet
+ *
+ *  independent columns are copied concurrently, each through
+ *  its own view of "rs". the remaining columns are copied on the
+ *  calling thread in their original order, while the workers run,
+ *  up to the first static column, which waits for the workers.
+ */
+void ColumnSchedulerCopy ( ColumnScheduler *self, const ctx_t *ctx, struct RowSet *rs );
+
+#endif
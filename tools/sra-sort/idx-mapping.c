@@ -25,10 +25,13 @@
  */
 
 #include "idx-mapping.h"
+#include "radix-sort.h"
 #include "ctx.h"
 
 #include <klib/sort.h>
 
+#include <stddef.h>
+
 FILE_ENTRY ( idx-mapping );
 
 
@@ -64,6 +67,10 @@ int64_t CC IdxMappingCmpNew ( const void *a, const void *b, void *data )
 
 void IdxMappingSortOld ( IdxMapping *self, const ctx_t *ctx, size_t count )
 {
+    static const RadixSortKey old_key = { offsetof ( IdxMapping, old_id ), true };
+    if ( RadixSort ( ctx, self, count, sizeof * self, & old_key, NULL ) )
+        return;
+
 #define CMP( a, b ) \
     ( ( T ( a ) -> old_id < T ( b ) -> old_id ) ? -1 : ( T ( a ) -> old_id > T ( b ) -> old_id ) )
 
@@ -74,6 +81,10 @@ void IdxMappingSortOld ( IdxMapping *self, const ctx_t *ctx, size_t count )
 
 void IdxMappingSortNew ( IdxMapping *self, const ctx_t *ctx, size_t count )
 {
+    static const RadixSortKey new_key = { offsetof ( IdxMapping, new_id ), true };
+    if ( RadixSort ( ctx, self, count, sizeof * self, & new_key, NULL ) )
+        return;
+
 #define CMP( a, b ) \
     ( ( T ( a ) -> new_id < T ( b ) -> new_id ) ? -1 : ( T ( a ) -> new_id > T ( b ) -> new_id ) )
 
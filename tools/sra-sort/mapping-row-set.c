@@ -97,17 +97,17 @@ void MappingRowSetWhack ( MappingRowSet *self, const ctx_t *ctx )
 }
 
 static
-size_t MappingRowSetNextStat ( MappingRowSet *self, const ctx_t *ctx,
-    int64_t *ids, size_t max_ids )
+size_t MappingRowSetReadStat ( const MappingRowSet *self, const ctx_t *ctx,
+    size_t offset, int64_t *ids, size_t max_ids )
 {
     FUNC_ENTRY ( ctx );
 
     /* the starting row-id is taken from row-set-iterator
-       and offset by our current element counter */
-    int64_t row_id = self -> iter -> row_id + self -> cur_elem;
+       and offset by the requested element */
+    int64_t row_id = self -> iter -> row_id + offset;
 
     /* limit id generation to request */
-    size_t i, to_set = self -> num_elems - self -> cur_elem;
+    size_t i, to_set = offset < self -> num_elems ? self -> num_elems - offset : 0;
     if ( to_set > max_ids )
         to_set = max_ids;
 
@@ -118,27 +118,47 @@ size_t MappingRowSetNextStat ( MappingRowSet *self, const ctx_t *ctx,
     for ( i = 0; i < to_set; ++ i )
         ids [ i ] = row_id + i;
 
+    return to_set;
+}
+
+static
+size_t MappingRowSetNextStat ( MappingRowSet *self, const ctx_t *ctx,
+    int64_t *ids, size_t max_ids )
+{
+    FUNC_ENTRY ( ctx );
+
     /* advance counter */
+    size_t to_set = MappingRowSetReadStat ( self, ctx, self -> cur_elem, ids, max_ids );
     self -> cur_elem += to_set;
     return to_set;
 }
 
 static
-size_t MappingRowSetNextPhys ( MappingRowSet *self, const ctx_t *ctx,
-    int64_t *ids, size_t max_ids )
+size_t MappingRowSetReadPhys ( const MappingRowSet *self, const ctx_t *ctx,
+    size_t offset, int64_t *ids, size_t max_ids )
 {
     FUNC_ENTRY ( ctx );
 
     /* limit copy to request */
-    size_t i, to_copy = self -> num_elems - self -> cur_elem;
+    size_t i, to_copy = offset < self -> num_elems ? self -> num_elems - offset : 0;
     if ( to_copy > max_ids )
         to_copy = max_ids;
 
     /* copy out old-ids */
     for ( i = 0; i < to_copy; ++ i )
-        ids [ i ] = self -> map [ self -> cur_elem + i ] . old_id;
+        ids [ i ] = self -> map [ offset + i ] . old_id;
+
+    return to_copy;
+}
+
+static
+size_t MappingRowSetNextPhys ( MappingRowSet *self, const ctx_t *ctx,
+    int64_t *ids, size_t max_ids )
+{
+    FUNC_ENTRY ( ctx );
 
     /* advance counter */
+    size_t to_copy = MappingRowSetReadPhys ( self, ctx, self -> cur_elem, ids, max_ids );
     self -> cur_elem += to_copy;
     return to_copy;
 }
@@ -150,14 +170,16 @@ static RowSet_vt MappingRowSetPhys_vt =
 {
     MappingRowSetWhack,
     MappingRowSetNextPhys,
-    MappingRowSetReset
+    MappingRowSetReset,
+    MappingRowSetReadPhys
 };
 
 static RowSet_vt MappingRowSetStat_vt =
 {
     MappingRowSetWhack,
     MappingRowSetNextStat,
-    MappingRowSetReset
+    MappingRowSetReset,
+    MappingRowSetReadStat
 };
 
 static
@@ -202,14 +224,16 @@ static RowSet_vt MapFileMappingRowSetPhys_vt =
 {
     MappingRowSetWhack,
     MappingRowSetNextPhys,
-    MapFileMappingRowSetReset
+    MapFileMappingRowSetReset,
+    MappingRowSetReadPhys
 };
 
 static RowSet_vt MapFileMappingRowSetStat_vt =
 {
     MappingRowSetWhack,
     MappingRowSetNextStat,
-    MapFileMappingRowSetReset
+    MapFileMappingRowSetReset,
+    MappingRowSetReadStat
 };
 
 static
@@ -30,6 +30,13 @@
 #include "except.h"
 #include "status.h"
 
+#if ! WINDOWS
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+
 FILE_ENTRY ( mem );
 
 
@@ -66,3 +73,43 @@ size_t MemInUse ( const ctx_t *ctx, size_t *opt_quota )
 
     return MemBankInUse ( ctx -> caps -> mem, ctx, opt_quota );
 }
+
+
+/* ProcessStats
+ *  report page faults and resident size of the process
+ */
+bool MemProcessStats ( const ctx_t *ctx, uint64_t *major_faults, uint64_t *minor_faults, size_t *resident )
+{
+#if ! WINDOWS
+    struct rusage ru;
+
+    * major_faults = * minor_faults = 0;
+    * resident = 0;
+
+    if ( getrusage ( RUSAGE_SELF, & ru ) != 0 )
+        return false;
+
+    * major_faults = ru . ru_majflt;
+    * minor_faults = ru . ru_minflt;
+
+#if LINUX
+    {
+        /* second field of statm is the resident page count */
+        unsigned long pages, rss;
+        FILE *f = fopen ( "/proc/self/statm", "r" );
+        if ( f != NULL )
+        {
+            if ( fscanf ( f, "%lu %lu", & pages, & rss ) == 2 )
+                * resident = ( size_t ) rss * sysconf ( _SC_PAGESIZE );
+            fclose ( f );
+        }
+    }
+#endif
+
+    return true;
+#else
+    * major_faults = * minor_faults = 0;
+    * resident = 0;
+    return false;
+#endif
+}
@@ -45,6 +45,13 @@ void MemFree ( const ctx_t *ctx, void *mem, size_t bytes );
 size_t MemInUse ( const ctx_t *ctx, size_t *opt_quota );
 
 
+/* ProcessStats
+ *  report page faults and resident size of the process
+ *  returns false if not available on this platform
+ */
+bool MemProcessStats ( const ctx_t *ctx, uint64_t *major_faults, uint64_t *minor_faults, size_t *resident );
+
+
 
 /*--------------------------------------------------------------------------
  * MemBank
@@ -52,6 +59,16 @@ size_t MemInUse ( const ctx_t *ctx, size_t *opt_quota );
  */
 typedef struct MemBank_vt MemBank_vt;
 
+/* MemBankAccess
+ *  how the contents of a bank are about to be accessed
+ */
+typedef enum MemBankAccess MemBankAccess;
+enum MemBankAccess
+{
+    mbaSequential,
+    mbaRandom
+};
+
 typedef struct MemBank MemBank;
 struct MemBank
 {
@@ -70,6 +87,9 @@ struct MemBank_vt
     size_t ( * in_use ) ( const MEMBANK_IMPL *self, const ctx_t *ctx, size_t *opt_quota );
     void* ( * alloc ) ( MEMBANK_IMPL *self, const ctx_t *ctx, size_t bytes, bool clear );
     void ( * free ) ( MEMBANK_IMPL *self, const ctx_t *ctx, void *mem, size_t bytes );
+
+    /* optional */
+    void ( * advise ) ( MEMBANK_IMPL *self, const ctx_t *ctx, MemBankAccess access );
 };
 
 
@@ -116,6 +136,13 @@ void MemBankRelease ( const MemBank *self, const ctx_t *ctx );
     POLY_DISPATCH_VOID ( free, self, MEMBANK_IMPL, ctx, mem, bytes )
 
 
+/* Advise
+ *  hint at how allocated memory is about to be accessed
+ *  ignored by banks that do not implement it
+ */
+void MemBankAdvise ( MemBank *self, const ctx_t *ctx, MemBankAccess access );
+
+
 /* Init
  */
 void MemBankInit ( MemBank *self, const ctx_t *ctx, const MemBank_vt *vt, const char *name );
@@ -294,3 +294,13 @@ void MemBankRelease ( const MemBank *self, const ctx_t *ctx )
         }}
     }
 }
+
+
+/* Advise
+ *  hint at how allocated memory is about to be accessed
+ */
+void MemBankAdvise ( MemBank *self, const ctx_t *ctx, MemBankAccess access )
+{
+    if ( self != NULL && self -> vt -> advise != NULL )
+        ( * self -> vt -> advise ) ( ( MEMBANK_IMPL* ) self, ctx, access );
+}
@@ -45,6 +45,11 @@ typedef struct PagedMMapBank PagedMMapBank;
 #include <stdlib.h>
 #include <string.h>
 
+#if ! WINDOWS
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 FILE_ENTRY ( paged-mmapbank );
 
 
@@ -77,6 +82,58 @@ void CC MMapPageWhack ( SLNode *n, void *data )
     MemFree ( ctx, self, sizeof * self );
 }
 
+#if ! WINDOWS
+/* Advise
+ *  pass an access hint for the page on to the kernel
+ *  it is only a hint, so failure is ignored
+ */
+static
+void MMapPageAdvise ( const MMapPage *self, size_t bytes, int advice )
+{
+    size_t pgmask = ( size_t ) sysconf ( _SC_PAGESIZE ) - 1;
+    size_t start = ( size_t ) self -> addr & ~ pgmask;
+
+    if ( bytes != 0 )
+        madvise ( ( void* ) start, bytes + ( ( size_t ) self -> addr - start ), advice );
+}
+#endif
+
+/* Resident
+ *  count bytes of the page currently in physical memory
+ */
+static
+size_t MMapPageResident ( const MMapPage *self )
+{
+    size_t resident = 0;
+#if LINUX
+    size_t pgsize = ( size_t ) sysconf ( _SC_PAGESIZE );
+    size_t start = ( size_t ) self -> addr & ~ ( pgsize - 1 );
+    size_t end = ( size_t ) self -> addr + self -> size;
+
+    while ( start < end )
+    {
+        size_t i, count;
+        unsigned char vec [ 4096 ];
+
+        count = ( end - start + pgsize - 1 ) / pgsize;
+        if ( count > sizeof vec )
+            count = sizeof vec;
+
+        if ( mincore ( ( void* ) start, count * pgsize, vec ) != 0 )
+            break;
+
+        for ( i = 0; i < count; ++ i )
+        {
+            if ( ( vec [ i ] & 1 ) != 0 )
+                resident += pgsize;
+        }
+
+        start += count * pgsize;
+    }
+#endif
+    return resident;
+}
+
 
 /*--------------------------------------------------------------------------
  * PagedMMapBank
@@ -90,9 +147,30 @@ struct PagedMMapBank
     size_t pgsize;
     KFile *backing;
     SLList pages;
+
+    /* use huge pages and access hints */
+    bool advise;
 };
 
 
+/* Resident
+ *  report bytes of the bank currently in physical memory
+ */
+static
+void PagedMMapBankReportResident ( const PagedMMapBank *self, const ctx_t *ctx )
+{
+    FUNC_ENTRY ( ctx );
+
+    size_t resident = 0;
+    const MMapPage *pg = ( const MMapPage* ) SLListHead ( & self -> pages );
+
+    for ( ; pg != NULL; pg = ( const MMapPage* ) SLNodeNext ( & pg -> n ) )
+        resident += MMapPageResident ( pg );
+
+    STATUS ( 4, "mem-mapped buffer: %,zu of %,zu bytes resident", resident, self -> used );
+}
+
+
 /* Whack
  */
 static
@@ -102,6 +180,9 @@ void PagedMMapBankWhack ( PagedMMapBank *self, const ctx_t *ctx )
 
     rc_t rc;
 
+    if ( self -> advise )
+        PagedMMapBankReportResident ( self, ctx );
+
     SLListWhack ( & self -> pages, MMapPageWhack, ( void* ) ctx );
 
     rc = KFileRelease ( self -> backing );
@@ -257,6 +338,18 @@ void PagedMMapBankMapPage ( PagedMMapBank *self, const ctx_t *ctx, MMapPage *pg
                 pg -> used = 0;
                 self -> used += self -> pgsize;
                 STATUS ( 4, "total mem-mapped buffer space: %,zu bytes", self -> used );
+#if ! WINDOWS
+                if ( self -> advise )
+                {
+#ifdef MADV_HUGEPAGE
+                    /* only honored where the kernel supports
+                       transparent huge pages for this mapping */
+                    MMapPageAdvise ( pg, pg -> size, MADV_HUGEPAGE );
+#endif
+                    /* pages are filled front to back */
+                    MMapPageAdvise ( pg, pg -> size, MADV_SEQUENTIAL );
+                }
+#endif
                 return;
             }
         }
@@ -319,6 +412,14 @@ void *PagedMMapBankAlloc ( PagedMMapBank *self, const ctx_t *ctx, size_t bytes,
             {
                 TRY ( PagedMMapBankMapPage ( self, ctx, pg ) )
                 {
+#if ! WINDOWS
+                    /* the filled page will not be read until the bank
+                       is drained, so give its frames back now. the mapping
+                       is shared, so contents stay in the backing file */
+                    MMapPage *full = ( MMapPage* ) SLListHead ( & self -> pages );
+                    if ( self -> advise && full != NULL )
+                        MMapPageAdvise ( full, full -> size, MADV_DONTNEED );
+#endif
                     /* got it - push it onto stack */
                     SLListPushHead ( & self -> pages, & pg -> n );
 
@@ -355,12 +456,59 @@ void PagedMMapBankFree ( PagedMMapBank *self, const ctx_t *ctx, void *mem, size_
 }
 
 
+/* Advise
+ *  hint at how pages are about to be accessed
+ */
+static
+void PagedMMapBankAdvise ( PagedMMapBank *self, const ctx_t *ctx, MemBankAccess access )
+{
+#if ! WINDOWS
+    FUNC_ENTRY ( ctx );
+
+    MMapPage *pg;
+    size_t budget = ( size_t ) -1;
+
+    if ( ! self -> advise )
+        return;
+
+#ifdef _SC_AVPHYS_PAGES
+    /* do not ask for more than will fit in free memory */
+    budget = ( size_t ) sysconf ( _SC_AVPHYS_PAGES ) * ( size_t ) sysconf ( _SC_PAGESIZE );
+#endif
+
+    /* most recently filled page is at head,
+       and most likely to still be in the page cache */
+    for ( pg = ( MMapPage* ) SLListHead ( & self -> pages );
+          pg != NULL; pg = ( MMapPage* ) SLNodeNext ( & pg -> n ) )
+    {
+        switch ( access )
+        {
+        case mbaSequential:
+            MMapPageAdvise ( pg, pg -> size, MADV_SEQUENTIAL );
+            break;
+        case mbaRandom:
+            MMapPageAdvise ( pg, pg -> size, MADV_RANDOM );
+            if ( pg -> used <= budget )
+            {
+                MMapPageAdvise ( pg, pg -> used, MADV_WILLNEED );
+                budget -= pg -> used;
+            }
+            break;
+        }
+    }
+
+    PagedMMapBankReportResident ( self, ctx );
+#endif
+}
+
+
 static MemBank_vt PagedMMapBank_vt =
 {
     PagedMMapBankWhack,
     PagedMMapBankInUse,
     PagedMMapBankAlloc,
-    PagedMMapBankFree
+    PagedMMapBankFree,
+    PagedMMapBankAdvise
 };
 
 
@@ -389,6 +537,7 @@ MemBank *MemBankMakePagedMMap ( const ctx_t *ctx, size_t quota, size_t pgsize )
         {
             mem -> quota = quota;
             mem -> pgsize = pgsize;
+            mem -> advise = ctx -> caps -> tool -> mmap_advise;
             return & mem -> dad;
         }
 
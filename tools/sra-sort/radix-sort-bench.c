@@ -0,0 +1,355 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+/*--------------------------------------------------------------------------
+ * radix-sort-bench
+ *  times RadixSort against the KSORT path it replaces,
+ *  on random IdxMapping pairs, IdPosLen records and 64-bit ids,
+ *  and checks the results: exits non-zero if any of them is not sorted
+ */
+
+#include "radix-sort.h"
+#include "idx-mapping.h"
+#include "ctx.h"
+#include "caps.h"
+#include "except.h"
+#include "mem.h"
+#include "sra-sort.h"
+
+#include <klib/sort.h>
+#include <klib/time.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+FILE_ENTRY ( radix-sort-bench );
+
+
+static uint64_t seed = 88172645463325252ULL;
+
+/* results that were not sorted */
+static uint32_t failures;
+
+static
+uint64_t next_random ( void )
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+/* signed keys on both sides of zero */
+static
+int64_t next_id ( size_t count )
+{
+    return ( int64_t ) ( next_random () % ( count * 4 ) ) - ( int64_t ) ( count * 2 );
+}
+
+/* order-independent digest of the records, to detect lost or duplicated ones */
+static
+uint64_t digest ( const void *base, size_t count, size_t elem_size )
+{
+    size_t i, j;
+    uint64_t sum = 0;
+    const uint64_t *p = base;
+
+    for ( i = 0; i < count; ++ i )
+    {
+        uint64_t h = 0;
+        for ( j = 0; j < elem_size / sizeof * p; ++ j )
+            h = ( h ^ p [ i * ( elem_size / sizeof * p ) + j ] ) * 0x100000001B3ULL;
+        sum += h;
+    }
+
+    return sum;
+}
+
+static
+void report ( const char *what, size_t count, const char *name, uint32_t threads,
+    KTimeMs_t start, int64_t ( CC * cmp ) ( const void*, const void*, void* ),
+    const void *base, size_t elem_size, uint64_t expected )
+{
+    size_t i;
+    const uint8_t *p = base;
+
+    printf ( "%s %zu: %s, %u thread(s): %lu ms\n",
+             what, count, name, threads, ( unsigned long ) ( KTimeMsStamp () - start ) );
+
+    for ( i = 1; i < count; ++ i )
+    {
+        if ( cmp ( p + ( i - 1 ) * elem_size, p + i * elem_size, NULL ) > 0 )
+        {
+            printf ( "  NOT SORTED at element %zu\n", i );
+            ++ failures;
+            break;
+        }
+    }
+
+    if ( digest ( base, count, elem_size ) != expected )
+    {
+        printf ( "  NOT SORTED: records were lost or duplicated\n" );
+        ++ failures;
+    }
+}
+
+/* RadixSort declines e.g. for too few records or insufficient quota:
+   the benchmark says so, rather than timing KSORT under its name */
+#define PASS_NAME( pass, radix ) \
+    ( ( pass ) == 0 ? "KSORT" : ( radix ) ? "radix" : "radix declined, KSORT" )
+
+static
+int64_t CC cmp_idx_mapping_old ( const void *a, const void *b, void *data )
+{
+    const IdxMapping *ap = a, *bp = b;
+    return ap -> old_id < bp -> old_id ? -1 : ap -> old_id > bp -> old_id;
+}
+
+static
+void bench_idx_mapping ( const ctx_t *ctx, Tool *tp, size_t count, uint32_t threads )
+{
+    FUNC_ENTRY ( ctx );
+
+    IdxMapping *orig, *map;
+    size_t i, bytes = sizeof * map * count;
+
+    TRY ( orig = MemAlloc ( ctx, bytes, false ) )
+    {
+        TRY ( map = MemAlloc ( ctx, bytes, false ) )
+        {
+            uint32_t pass;
+            uint64_t expected;
+            static const RadixSortKey old_key = { offsetof ( IdxMapping, old_id ), true };
+
+            /* old ids as a shuffled range, much like a sort index */
+            for ( i = 0; i < count; ++ i )
+            {
+                orig [ i ] . old_id = next_id ( count );
+                orig [ i ] . new_id = ( int64_t ) i + 1;
+            }
+            expected = digest ( orig, count, sizeof * orig );
+
+            for ( pass = 0; ! FAILED () && pass < 3; ++ pass )
+            {
+                KTimeMs_t start;
+                bool radix = false;
+
+                tp -> radix_sort = pass != 0;
+                tp -> num_threads = ( pass == 2 ) ? threads : 1;
+
+                memmove ( map, orig, bytes );
+
+                start = KTimeMsStamp ();
+                if ( pass != 0 )
+                    radix = RadixSort ( ctx, map, count, sizeof * map, & old_key, NULL );
+                if ( ! radix )
+                {
+                    /* the KSORT path of IdxMappingSortOld */
+                    tp -> radix_sort = false;
+                    IdxMappingSortOld ( map, ctx, count );
+                }
+
+                report ( "IdxMapping pairs", count, PASS_NAME ( pass, radix ), tp -> num_threads,
+                         start, cmp_idx_mapping_old, map, sizeof * map, expected );
+            }
+
+            MemFree ( ctx, map, bytes );
+        }
+
+        MemFree ( ctx, orig, bytes );
+    }
+}
+
+/* as in ref-alignid-col.c: ordered on poslen, then on id */
+typedef struct IdPosLen IdPosLen;
+struct IdPosLen
+{
+    int64_t id;
+    uint64_t poslen;
+};
+
+static
+int64_t CC cmp_id_pos_len ( const void *a, const void *b, void *data )
+{
+    const IdPosLen *ap = a, *bp = b;
+
+    if ( ap -> poslen != bp -> poslen )
+        return ap -> poslen < bp -> poslen ? -1 : 1;
+    return ap -> id < bp -> id ? -1 : ap -> id > bp -> id;
+}
+
+static
+void bench_id_pos_len ( const ctx_t *ctx, Tool *tp, size_t count, uint32_t threads )
+{
+    FUNC_ENTRY ( ctx );
+
+    IdPosLen *orig, *recs;
+    size_t i, bytes = sizeof * recs * count;
+
+    TRY ( orig = MemAlloc ( ctx, bytes, false ) )
+    {
+        TRY ( recs = MemAlloc ( ctx, bytes, false ) )
+        {
+            uint32_t pass;
+            uint64_t expected;
+            static const RadixSortKey poslen_key = { offsetof ( IdPosLen, poslen ), false };
+            static const RadixSortKey id_key = { offsetof ( IdPosLen, id ), true };
+
+            /* few distinct positions, so the minor key decides most of the order;
+               some with the top bit set, which must sort last as unsigned */
+            for ( i = 0; i < count; ++ i )
+            {
+                orig [ i ] . id = next_id ( count );
+                orig [ i ] . poslen = ( next_random () % ( count / 16 + 1 ) ) << 32;
+                if ( ( i & 15 ) == 0 )
+                    orig [ i ] . poslen |= 1ULL << 63;
+            }
+            expected = digest ( orig, count, sizeof * orig );
+
+            for ( pass = 0; ! FAILED () && pass < 3; ++ pass )
+            {
+                KTimeMs_t start;
+                bool radix = false;
+
+                tp -> radix_sort = true;
+                tp -> num_threads = ( pass == 2 ) ? threads : 1;
+
+                memmove ( recs, orig, bytes );
+
+                start = KTimeMsStamp ();
+                if ( pass != 0 )
+                    radix = RadixSort ( ctx, recs, count, sizeof * recs, & poslen_key, & id_key );
+                if ( ! radix )
+                    ksort ( recs, count, sizeof * recs, cmp_id_pos_len, NULL );
+
+                report ( "IdPosLen records", count, PASS_NAME ( pass, radix ), tp -> num_threads,
+                         start, cmp_id_pos_len, recs, sizeof * recs, expected );
+            }
+
+            MemFree ( ctx, recs, bytes );
+        }
+
+        MemFree ( ctx, orig, bytes );
+    }
+}
+
+static
+int64_t CC cmp_int64 ( const void *a, const void *b, void *data )
+{
+    const int64_t *ap = a, *bp = b;
+    return * ap < * bp ? -1 : * ap > * bp;
+}
+
+static
+void bench_int64 ( const ctx_t *ctx, Tool *tp, size_t count, uint32_t threads )
+{
+    FUNC_ENTRY ( ctx );
+
+    int64_t *orig, *ids;
+    size_t i, bytes = sizeof * ids * count;
+
+    TRY ( orig = MemAlloc ( ctx, bytes, false ) )
+    {
+        TRY ( ids = MemAlloc ( ctx, bytes, false ) )
+        {
+            uint32_t pass;
+            uint64_t expected;
+            static const RadixSortKey id_key = { 0, true };
+
+            for ( i = 0; i < count; ++ i )
+                orig [ i ] = next_id ( count );
+            expected = digest ( orig, count, sizeof * orig );
+
+            for ( pass = 0; ! FAILED () && pass < 3; ++ pass )
+            {
+                KTimeMs_t start;
+                bool radix = false;
+
+                tp -> radix_sort = true;
+                tp -> num_threads = ( pass == 2 ) ? threads : 1;
+
+                memmove ( ids, orig, bytes );
+
+                start = KTimeMsStamp ();
+                if ( pass != 0 )
+                    radix = RadixSort ( ctx, ids, count, sizeof * ids, & id_key, NULL );
+                if ( ! radix )
+                    ksort_int64_t ( ids, count );
+
+                report ( "int64_t ids", count, PASS_NAME ( pass, radix ), tp -> num_threads,
+                         start, cmp_int64, ids, sizeof * ids, expected );
+            }
+
+            MemFree ( ctx, ids, bytes );
+        }
+
+        MemFree ( ctx, orig, bytes );
+    }
+}
+
+int main ( int argc, char *argv [] )
+{
+    DECLARE_CTX_INFO ();
+
+    Tool tool;
+    Caps caps;
+    ctx_t main_ctx = { & caps, NULL, & ctx_info };
+    const ctx_t *ctx = & main_ctx;
+
+    size_t count = ( argc > 1 ) ? ( size_t ) strtoull ( argv [ 1 ], NULL, 0 ) : 64 * 1024 * 1024;
+    uint32_t threads = ( argc > 2 ) ? ( uint32_t ) strtoul ( argv [ 2 ], NULL, 0 ) : 8;
+
+    if ( count == 0 || threads == 0 )
+    {
+        printf ( "Usage: %s [ count [ threads ] ]\n", argv [ 0 ] );
+        return 1;
+    }
+
+    memset ( & tool, 0, sizeof tool );
+    CapsInit ( & caps, NULL );
+    caps . tool = & tool;
+
+    TRY ( caps . mem = MemBankMake ( ctx, -1 ) )
+    {
+        TRY ( bench_idx_mapping ( ctx, & tool, count, threads ) )
+        {
+            TRY ( bench_id_pos_len ( ctx, & tool, count, threads ) )
+            {
+                bench_int64 ( ctx, & tool, count, threads );
+            }
+        }
+    }
+
+    caps . tool = NULL;
+    CapsWhack ( & caps, ctx );
+
+    if ( failures != 0 )
+        printf ( "%u result(s) NOT SORTED\n", failures );
+
+    return main_ctx . rc != 0 || failures != 0;
+}
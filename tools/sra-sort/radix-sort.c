@@ -0,0 +1,382 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+
+#include "radix-sort.h"
+#include "ctx.h"
+#include "caps.h"
+#include "except.h"
+#include "status.h"
+#include "mem.h"
+#include "sra-sort.h"
+
+#include <kproc/thread.h>
+#include <klib/rc.h>
+
+#include <string.h>
+
+FILE_ENTRY ( radix-sort );
+
+
+/* below this many records, KSORT is as good */
+#define RADIX_MIN_COUNT ( 64 * 1024 )
+
+/* smallest number of records worth a thread */
+#define RADIX_MIN_CHUNK ( 1024 * 1024 )
+
+/* upper limit on threads */
+#define RADIX_MAX_PARTS 64
+
+/* two keys of eight bytes */
+#define RADIX_MAX_DIGITS 16
+
+
+/*--------------------------------------------------------------------------
+ * RadixSortData
+ *  shared state of a sort
+ */
+typedef struct RadixSortData RadixSortData;
+struct RadixSortData
+{
+    /* current source and destination arrays */
+    const uint8_t *src;
+    uint8_t *dst;
+    size_t elem_size;
+
+    /* keys in order of significance, least first */
+    size_t key_off [ 2 ];
+    uint64_t key_flip [ 2 ];
+    uint32_t num_keys;
+
+    /* digit of current pass */
+    uint32_t digit;
+
+    /* operation of current pass */
+    enum { radixCountAll, radixCount, radixScatter } op;
+};
+
+
+/*--------------------------------------------------------------------------
+ * RadixSortPart
+ *  a contiguous chunk of the array, handled by one thread
+ */
+typedef struct RadixSortPart RadixSortPart;
+struct RadixSortPart
+{
+    const RadixSortData *rs;
+    KThread *t;
+
+    /* element range */
+    size_t start, end;
+
+    /* counts of every digit, for deciding which to skip */
+    size_t all [ RADIX_MAX_DIGITS ] [ 256 ];
+
+    /* counts of current digit, then destination offsets */
+    size_t hist [ 256 ];
+};
+
+
+/* KeyGet
+ *  read key "k" of record, ordered as unsigned
+ */
+static __inline__
+uint64_t RadixSortKeyGet ( const RadixSortData *rs, const uint8_t *rec, uint32_t k )
+{
+    uint64_t key;
+    memcpy ( & key, rec + rs -> key_off [ k ], sizeof key );
+    return key ^ rs -> key_flip [ k ];
+}
+
+/* CountAll
+ *  count every digit within chunk
+ */
+static
+void RadixSortPartCountAll ( RadixSortPart *self )
+{
+    const RadixSortData *rs = self -> rs;
+    const size_t elem_size = rs -> elem_size;
+
+    size_t i;
+    uint32_t k, b;
+
+    for ( i = self -> start; i < self -> end; ++ i )
+    {
+        const uint8_t *rec = rs -> src + i * elem_size;
+        for ( k = 0; k < rs -> num_keys; ++ k )
+        {
+            uint64_t key = RadixSortKeyGet ( rs, rec, k );
+            for ( b = 0; b < 8; ++ b )
+                ++ self -> all [ k * 8 + b ] [ ( key >> ( b * 8 ) ) & 0xFF ];
+        }
+    }
+}
+
+/* Count
+ *  count current digit within chunk
+ */
+static
+void RadixSortPartCount ( RadixSortPart *self )
+{
+    const RadixSortData *rs = self -> rs;
+    const size_t elem_size = rs -> elem_size;
+    const uint32_t k = rs -> digit / 8;
+    const uint32_t shift = ( rs -> digit % 8 ) * 8;
+
+    size_t i;
+
+    memset ( self -> hist, 0, sizeof self -> hist );
+
+    for ( i = self -> start; i < self -> end; ++ i )
+    {
+        uint64_t key = RadixSortKeyGet ( rs, rs -> src + i * elem_size, k );
+        ++ self -> hist [ ( key >> shift ) & 0xFF ];
+    }
+}
+
+/* Scatter
+ *  move records of chunk to their destination offsets
+ */
+static
+void RadixSortPartScatter ( RadixSortPart *self )
+{
+    const RadixSortData *rs = self -> rs;
+    const size_t elem_size = rs -> elem_size;
+    const uint32_t k = rs -> digit / 8;
+    const uint32_t shift = ( rs -> digit % 8 ) * 8;
+
+    size_t i;
+
+    for ( i = self -> start; i < self -> end; ++ i )
+    {
+        const uint8_t *rec = rs -> src + i * elem_size;
+        uint64_t key = RadixSortKeyGet ( rs, rec, k );
+        size_t dst = self -> hist [ ( key >> shift ) & 0xFF ] ++;
+        memcpy ( rs -> dst + dst * elem_size, rec, elem_size );
+    }
+}
+
+static
+rc_t CC RadixSortPartRun ( const KThread *t, void *data )
+{
+    RadixSortPart *self = data;
+
+    switch ( self -> rs -> op )
+    {
+    case radixCountAll:
+        RadixSortPartCountAll ( self );
+        break;
+    case radixCount:
+        RadixSortPartCount ( self );
+        break;
+    case radixScatter:
+        RadixSortPartScatter ( self );
+        break;
+    }
+
+    return 0;
+}
+
+/* RunParts
+ *  run current operation on all chunks, and wait for them
+ *  a chunk whose thread could not be started is run inline
+ */
+static
+void RadixSortRunParts ( RadixSortPart *parts, uint32_t num_parts )
+{
+    uint32_t i;
+
+    for ( i = 1; i < num_parts; ++ i )
+    {
+        if ( KThreadMake ( & parts [ i ] . t, RadixSortPartRun, & parts [ i ] ) != 0 )
+        {
+            parts [ i ] . t = NULL;
+            RadixSortPartRun ( NULL, & parts [ i ] );
+        }
+    }
+
+    RadixSortPartRun ( NULL, & parts [ 0 ] );
+
+    for ( i = 1; i < num_parts; ++ i )
+    {
+        if ( parts [ i ] . t != NULL )
+        {
+            rc_t status;
+            KThreadWait ( parts [ i ] . t, & status );
+            KThreadRelease ( parts [ i ] . t );
+            parts [ i ] . t = NULL;
+        }
+    }
+}
+
+
+/* DigitIsConstant
+ *  true if every record has the same value for digit "d"
+ *  in which case a pass would not reorder anything
+ */
+static
+bool RadixSortDigitIsConstant ( const RadixSortPart *parts, uint32_t num_parts, uint32_t d, size_t count )
+{
+    uint32_t i, b;
+
+    for ( b = 0; b < 256; ++ b )
+    {
+        size_t total = 0;
+        for ( i = 0; i < num_parts; ++ i )
+            total += parts [ i ] . all [ d ] [ b ];
+        if ( total != 0 )
+            return total == count;
+    }
+
+    return true;
+}
+
+
+/* RadixSort
+ *  stable LSD radix sort of fixed-size records on 64-bit integer keys
+ */
+bool RadixSort ( const ctx_t *ctx, void *base, size_t count, size_t elem_size,
+    const RadixSortKey *major, const RadixSortKey *opt_minor )
+{
+    FUNC_ENTRY ( ctx );
+
+    const Tool *tp = ctx -> caps -> tool;
+
+    RadixSortData rs;
+    RadixSortPart *parts;
+    uint8_t *scratch;
+    size_t in_use, quota, bytes;
+    uint32_t i, d, b, num_parts, num_passes;
+
+    if ( count < RADIX_MIN_COUNT || ! tp -> radix_sort )
+        return false;
+
+    /* divide into chunks worth a thread */
+    num_parts = tp -> num_threads;
+    if ( num_parts > RADIX_MAX_PARTS )
+        num_parts = RADIX_MAX_PARTS;
+    if ( ( size_t ) num_parts > count / RADIX_MIN_CHUNK )
+        num_parts = ( uint32_t ) ( count / RADIX_MIN_CHUNK );
+    if ( num_parts == 0 )
+        num_parts = 1;
+
+    /* the scratch array must fit within quota */
+    bytes = count * elem_size;
+    in_use = MemInUse ( ctx, & quota );
+    if ( in_use >= quota || quota - in_use < bytes + sizeof parts [ 0 ] * num_parts )
+    {
+        STATUS ( 4, "not enough memory quota to radix sort %,zu elements", count );
+        return false;
+    }
+
+    parts = MemAlloc ( ctx, sizeof parts [ 0 ] * num_parts, true );
+    if ( FAILED () )
+    {
+        CLEAR ();
+        return false;
+    }
+
+    scratch = MemAlloc ( ctx, bytes, false );
+    if ( FAILED () )
+    {
+        CLEAR ();
+        MemFree ( ctx, parts, sizeof parts [ 0 ] * num_parts );
+        return false;
+    }
+
+    STATUS ( 4, "radix sorting %,zu elements on %u threads", count, num_parts );
+
+    /* order keys from least significant */
+    rs . num_keys = 0;
+    if ( opt_minor != NULL )
+    {
+        rs . key_off [ rs . num_keys ] = opt_minor -> offset;
+        rs . key_flip [ rs . num_keys ++ ] = opt_minor -> is_signed ? ( uint64_t ) 1 << 63 : 0;
+    }
+    rs . key_off [ rs . num_keys ] = major -> offset;
+    rs . key_flip [ rs . num_keys ++ ] = major -> is_signed ? ( uint64_t ) 1 << 63 : 0;
+
+    rs . src = base;
+    rs . dst = scratch;
+    rs . elem_size = elem_size;
+    rs . digit = 0;
+
+    for ( i = 0; i < num_parts; ++ i )
+    {
+        parts [ i ] . rs = & rs;
+        parts [ i ] . start = count / num_parts * i;
+        parts [ i ] . end = ( i + 1 == num_parts ) ? count : count / num_parts * ( i + 1 );
+    }
+
+    /* count all digits at once */
+    rs . op = radixCountAll;
+    RadixSortRunParts ( parts, num_parts );
+
+    for ( num_passes = d = 0; d < rs . num_keys * 8; ++ d )
+    {
+        size_t offset;
+        uint8_t *prev;
+
+        if ( RadixSortDigitIsConstant ( parts, num_parts, d, count ) )
+            continue;
+
+        /* count digit within each chunk as it is now ordered */
+        rs . digit = d;
+        rs . op = radixCount;
+        RadixSortRunParts ( parts, num_parts );
+
+        /* turn counts into destination offsets,
+           ordered by digit and then by chunk */
+        for ( offset = 0, b = 0; b < 256; ++ b )
+        {
+            for ( i = 0; i < num_parts; ++ i )
+            {
+                size_t n = parts [ i ] . hist [ b ];
+                parts [ i ] . hist [ b ] = offset;
+                offset += n;
+            }
+        }
+
+        rs . op = radixScatter;
+        RadixSortRunParts ( parts, num_parts );
+
+        /* the destination becomes the source of the next pass */
+        prev = ( uint8_t* ) rs . src;
+        rs . src = rs . dst;
+        rs . dst = prev;
+        ++ num_passes;
+    }
+
+    /* an odd number of passes left the result in scratch */
+    if ( rs . src != base )
+        memmove ( base, rs . src, bytes );
+
+    STATUS ( 4, "radix sorted %,zu elements in %u passes", count, num_passes );
+
+    MemFree ( ctx, scratch, bytes );
+    MemFree ( ctx, parts, sizeof parts [ 0 ] * num_parts );
+
+    return true;
+}
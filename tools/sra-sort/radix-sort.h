@@ -0,0 +1,66 @@
+/*===========================================================================
+ *
+ *                            PUBLIC DOMAIN NOTICE
+ *               National Center for Biotechnology Information
+ *
+ *  This software/database is a "United States Government Work" under the
+ *  terms of the United States Copyright Act.  It was written as part of
+ *  the author's official duties as a United States Government employee and
+ *  thus cannot be copyrighted.  This software/database is freely available
+ *  to the public for use. The National Library of Medicine and the U.S.
+ *  Government have not placed any restriction on its use or reproduction.
+ *
+ *  Although all reasonable efforts have been taken to ensure the accuracy
+ *  and reliability of the software and data, the NLM and the U.S.
+ *  Government do not and cannot warrant the performance or results that
+ *  may be obtained by using this software or data. The NLM and the U.S.
+ *  Government disclaim all warranties, express or implied, including
+ *  warranties of performance, merchantability or fitness for any particular
+ *  purpose.
+ *
+ *  Please cite the author in any work or product based on this material.
+ *
+ * ===========================================================================
+ *
+ */
+#ifndef _h_sra_sort_radix_sort_
+#define _h_sra_sort_radix_sort_
+
+#ifndef _h_sra_sort_defs_
+#include "sort-defs.h"
+#endif
+
+
+/*--------------------------------------------------------------------------
+ * RadixSortKey
+ *  describes a 64-bit integer key within a fixed-size record
+ */
+typedef struct RadixSortKey RadixSortKey;
+struct RadixSortKey
+{
+    /* byte offset of key within record */
+    size_t offset;
+
+    /* true for int64_t, false for uint64_t */
+    bool is_signed;
+};
+
+
+/*--------------------------------------------------------------------------
+ * RadixSort
+ *  stable LSD radix sort of "count" records of "elem_size" bytes,
+ *  ordered on "major" key and then on "opt_minor" key if not NULL
+ *
+ *  the array is split into chunks counted and scattered by up to
+ *  Tool "num_threads" threads, and byte positions that are equal in
+ *  every key are skipped.
+ *
+ *  needs scratch memory from the MemBank the size of the array.
+ *  returns false without touching the array when declining to sort,
+ *  i.e. too few records to benefit, insufficient quota, or radix sort
+ *  disabled in Tool. the caller is expected to fall back to KSORT.
+ */
+bool RadixSort ( const ctx_t *ctx, void *base, size_t count, size_t elem_size,
+    const RadixSortKey *major, const RadixSortKey *opt_minor );
+
+#endif
@@ -38,6 +38,7 @@ struct AlignIdColReader;
 #include "mem.h"
 #include "idx-mapping.h"
 #include "map-file.h"
+#include "radix-sort.h"
 #include "sra-sort.h"
 
 #include <vdb/cursor.h>
@@ -46,6 +47,7 @@ struct AlignIdColReader;
 #include <klib/rc.h>
 
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
 
 FILE_ENTRY ( ref-alignid-col );
@@ -111,6 +113,24 @@ void ksort_IdPosLen_pos ( IdPosLen *pbase, size_t total_elems )
 #undef CMP
 
 }
+
+/* radix sort when possible, otherwise KSORT */
+static
+void IdPosLenSortPos ( IdPosLen *pbase, const ctx_t *ctx, size_t total_elems )
+{
+    static const RadixSortKey poslen_key = { offsetof ( IdPosLen, poslen ), false };
+    static const RadixSortKey id_key = { offsetof ( IdPosLen, id ), true };
+    if ( ! RadixSort ( ctx, pbase, total_elems, sizeof * pbase, & poslen_key, & id_key ) )
+        ksort_IdPosLen_pos ( pbase, total_elems );
+}
+
+static
+void Int64SortIds ( int64_t *pbase, const ctx_t *ctx, size_t total_elems )
+{
+    static const RadixSortKey id_key = { 0, true };
+    if ( ! RadixSort ( ctx, pbase, total_elems, sizeof * pbase, & id_key, NULL ) )
+        ksort_int64_t ( pbase, total_elems );
+}
 #endif
 
 
@@ -444,7 +464,7 @@ const void *AlignIdColReaderRead ( AlignIdColReader *self, const ctx_t *ctx,
 #if USE_OLD_KSORT
             ksort ( self -> u . ids, self -> num_elems, sizeof self -> u . ids [ 0 ], cmp_int64_t, ( void* ) ctx );
 #else
-            ksort_int64_t ( self -> u . ids, self -> num_elems );
+            Int64SortIds ( self -> u . ids, ctx, self -> num_elems );
 #endif
 
             /* transform from ids to id_poslen */
@@ -479,7 +499,7 @@ const void *AlignIdColReaderRead ( AlignIdColReader *self, const ctx_t *ctx,
 #if USE_OLD_KSORT
         ksort ( self -> u . id_poslen, self -> num_elems, sizeof self -> u . id_poslen [ 0 ], IdPosLenCmpPos, ( void* ) ctx );
 #else
-        ksort_IdPosLen_pos ( self -> u . id_poslen, self -> num_elems );
+        IdPosLenSortPos ( self -> u . id_poslen, ctx, self -> num_elems );
 #endif
 
         /* write poslen to temp column */
@@ -106,6 +106,101 @@ void RowSetInit ( RowSet *self, const ctx_t *ctx, const RowSet_vt *vt )
 }
 
 
+/*--------------------------------------------------------------------------
+ * RowSetView
+ *  an independent iterator over a shared RowSet
+ */
+typedef struct RowSetView RowSetView;
+struct RowSetView
+{
+    RowSet dad;
+
+    /* the viewed row-set */
+    const RowSet *rs;
+
+    /* our own position within it */
+    size_t cur_elem;
+};
+
+static
+void RowSetViewWhack ( RowSet *self, const ctx_t *ctx )
+{
+    FUNC_ENTRY ( ctx );
+    RowSetView *view = ( RowSetView* ) self;
+    RowSetRelease ( view -> rs, ctx );
+    MemFree ( ctx, view, sizeof * view );
+}
+
+static
+size_t RowSetViewRead ( const RowSet *self, const ctx_t *ctx,
+    size_t offset, int64_t *ids, size_t max_ids )
+{
+    FUNC_ENTRY ( ctx );
+    const RowSetView *view = ( const RowSetView* ) self;
+    return RowSetRead ( view -> rs, ctx, offset, ids, max_ids );
+}
+
+static
+size_t RowSetViewNext ( RowSet *self, const ctx_t *ctx,
+    int64_t *ids, size_t max_ids )
+{
+    FUNC_ENTRY ( ctx );
+
+    size_t count;
+    RowSetView *view = ( RowSetView* ) self;
+
+    TRY ( count = RowSetRead ( view -> rs, ctx, view -> cur_elem, ids, max_ids ) )
+    {
+        view -> cur_elem += count;
+        return count;
+    }
+
+    return 0;
+}
+
+static
+void RowSetViewReset ( RowSet *self, const ctx_t *ctx, bool for_static )
+{
+    /* the viewed row-set holds the ids,
+       and was reset by its owner */
+    ( ( RowSetView* ) self ) -> cur_elem = 0;
+}
+
+static RowSet_vt RowSetView_vt =
+{
+    RowSetViewWhack,
+    RowSetViewNext,
+    RowSetViewReset,
+    RowSetViewRead
+};
+
+
+/* MakeView
+ *  create an independent iterator over a row-set that has
+ *  already been Reset, reading it through RowSetRead
+ */
+RowSet *RowSetMakeView ( const RowSet *self, const ctx_t *ctx )
+{
+    FUNC_ENTRY ( ctx );
+
+    RowSetView *view;
+
+    TRY ( view = MemAlloc ( ctx, sizeof * view, false ) )
+    {
+        TRY ( view -> rs = RowSetDuplicate ( self, ctx ) )
+        {
+            RowSetInit ( & view -> dad, ctx, & RowSetView_vt );
+            view -> cur_elem = 0;
+            return & view -> dad;
+        }
+
+        MemFree ( ctx, view, sizeof * view );
+    }
+
+    return NULL;
+}
+
+
 /*--------------------------------------------------------------------------
  * RowSetIterator
  *  interface to iterate RowSets
@@ -74,6 +74,10 @@ struct RowSet_vt
     /* reset iterator to initial state */
     void ( * reset ) ( ROWSET_IMPL *self, const ctx_t *ctx,
         bool for_static );
+
+    /* retrieve row-ids at an offset without advancing */
+    size_t ( * read ) ( const ROWSET_IMPL *self, const ctx_t *ctx,
+        size_t offset, int64_t *ids, size_t max_ids );
 };
 
 
@@ -102,6 +106,27 @@ RowSet *RowSetDuplicate ( const RowSet *self, const ctx_t *ctx );
     POLY_DISPATCH_VOID ( reset, self, ROWSET_IMPL, ctx, for_static )
 
 
+/* Read
+ *  return the set of row-ids starting at "offset" from the
+ *  beginning, as established by the last Reset
+ *  does not modify iterator state, so that several threads
+ *  may read a row-set that is not being Reset concurrently
+ *  returns 0 if no rows are available
+ */
+#define RowSetRead( self, ctx, offset, ids, max_ids ) \
+    POLY_DISPATCH_INT ( read, self, const ROWSET_IMPL, ctx, offset, ids, max_ids )
+
+
+/* MakeView
+ *  create an independent iterator over a row-set that has
+ *  already been Reset, reading it through RowSetRead
+ *
+ *  Reset on the view only rewinds it, and must request the same
+ *  static/physical mode with which "self" was last Reset
+ */
+RowSet *RowSetMakeView ( const RowSet *self, const ctx_t *ctx );
+
+
 /* Init
  */
 void RowSetInit ( RowSet *self, const ctx_t *ctx, const RowSet_vt *vt );
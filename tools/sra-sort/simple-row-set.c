@@ -61,26 +61,36 @@ void SimpleRowSetWhack ( SimpleRowSet *self, const ctx_t *ctx )
 }
 
 static
-size_t SimpleRowSetNext ( SimpleRowSet *self, const ctx_t *ctx,
-    int64_t *row_ids, size_t max_ids )
+size_t SimpleRowSetRead ( const SimpleRowSet *self, const ctx_t *ctx,
+    size_t offset, int64_t *row_ids, size_t max_ids )
 {
-    if ( row_ids != NULL )
+    if ( row_ids != NULL && ( uint64_t ) offset < ( uint64_t ) ( self -> last_excl - self -> first ) )
     {
         size_t i;
+        int64_t row_id = self -> first + offset;
 
-        uint64_t max_avail = self -> last_excl - self -> row_id;
+        uint64_t max_avail = self -> last_excl - row_id;
         if ( max_avail < ( uint64_t ) max_ids )
             max_ids = ( size_t ) max_avail;
 
         for ( i = 0; i < max_ids; ++ i )
-            row_ids [ i ] = self -> row_id + i;
+            row_ids [ i ] = row_id + i;
 
-        self -> row_id += max_ids;
         return max_ids;
     }
     return 0;
 }
 
+static
+size_t SimpleRowSetNext ( SimpleRowSet *self, const ctx_t *ctx,
+    int64_t *row_ids, size_t max_ids )
+{
+    size_t count = SimpleRowSetRead ( self, ctx,
+        ( size_t ) ( self -> row_id - self -> first ), row_ids, max_ids );
+    self -> row_id += count;
+    return count;
+}
+
 static
 void SimpleRowSetReset ( SimpleRowSet *self, const ctx_t *ctx, bool for_static )
 {
@@ -91,7 +101,8 @@ static RowSet_vt SimpleRowSet_vt =
 {
     SimpleRowSetWhack,
     SimpleRowSetNext,
-    SimpleRowSetReset
+    SimpleRowSetReset,
+    SimpleRowSetRead
 };
 
 
@@ -103,17 +103,17 @@ void SortingRowSetWhack ( SortingRowSet *self, const ctx_t *ctx )
 }
 
 static
-size_t SortingRowSetNextStat ( SortingRowSet *self, const ctx_t *ctx,
-    int64_t *ids, size_t max_ids )
+size_t SortingRowSetReadStat ( const SortingRowSet *self, const ctx_t *ctx,
+    size_t offset, int64_t *ids, size_t max_ids )
 {
     FUNC_ENTRY ( ctx );
 
     /* the starting row-id is taken from row-set-iterator
-       and offset by our current element counter */
-    int64_t row_id = self -> iter -> row_id + self -> cur_elem;
+       and offset by the requested element */
+    int64_t row_id = self -> iter -> row_id + offset;
 
     /* limit id generation to request */
-    size_t i, to_set = self -> num_elems - self -> cur_elem;
+    size_t i, to_set = offset < self -> num_elems ? self -> num_elems - offset : 0;
     if ( to_set > max_ids )
         to_set = max_ids;
 
@@ -124,26 +124,46 @@ size_t SortingRowSetNextStat ( SortingRowSet *self, const ctx_t *ctx,
     for ( i = 0; i < to_set; ++ i )
         ids [ i ] = row_id + i;
 
+    return to_set;
+}
+
+static
+size_t SortingRowSetNextStat ( SortingRowSet *self, const ctx_t *ctx,
+    int64_t *ids, size_t max_ids )
+{
+    FUNC_ENTRY ( ctx );
+
     /* advance counter */
+    size_t to_set = SortingRowSetReadStat ( self, ctx, self -> cur_elem, ids, max_ids );
     self -> cur_elem += to_set;
     return to_set;
 }
 
 static
-size_t SortingRowSetNextPhys ( SortingRowSet *self, const ctx_t *ctx,
-    int64_t *ids, size_t max_ids )
+size_t SortingRowSetReadPhys ( const SortingRowSet *self, const ctx_t *ctx,
+    size_t offset, int64_t *ids, size_t max_ids )
 {
     FUNC_ENTRY ( ctx );
 
     /* limit copy to request */
-    size_t to_copy = self -> num_elems - self -> cur_elem;
+    size_t to_copy = offset < self -> num_elems ? self -> num_elems - offset : 0;
     if ( to_copy > max_ids )
         to_copy = max_ids;
 
     /* copy out old-ids */
-    memmove ( ids, & self -> src_ids [ self -> cur_elem ], to_copy * sizeof ids [ 0 ] );
+    memmove ( ids, & self -> src_ids [ offset ], to_copy * sizeof ids [ 0 ] );
+
+    return to_copy;
+}
+
+static
+size_t SortingRowSetNextPhys ( SortingRowSet *self, const ctx_t *ctx,
+    int64_t *ids, size_t max_ids )
+{
+    FUNC_ENTRY ( ctx );
 
     /* advance counter */
+    size_t to_copy = SortingRowSetReadPhys ( self, ctx, self -> cur_elem, ids, max_ids );
     self -> cur_elem += to_copy;
     return to_copy;
 }
@@ -155,14 +175,16 @@ static RowSet_vt SortingRowSetPhys_vt =
 {
     SortingRowSetWhack,
     SortingRowSetNextPhys,
-    SortingRowSetReset
+    SortingRowSetReset,
+    SortingRowSetReadPhys
 };
 
 static RowSet_vt SortingRowSetStat_vt =
 {
     SortingRowSetWhack,
     SortingRowSetNextStat,
-    SortingRowSetReset
+    SortingRowSetReset,
+    SortingRowSetReadStat
 };
 
 static
@@ -81,6 +81,8 @@ rc_t CC UsageSummary ( const char *prog_name )
 #define OPT_TEMP_DIR "tempdir"
 #define OPT_MMAP_DIR "mmapdir"
 #define OPT_UNSORTED_OLD_NEW "unsorted-old-new"
+#define OPT_THREADS "threads"
+#define OPT_MMAP_ADVISE "mmap-advise"
 
 #define OPT_COLUMN_MD5 "column-md5"
 #define OPT_NO_COLUMN_CHECKSUM "no-column-checksum"
@@ -103,6 +105,9 @@ static const char *hlp_max_large_idx_ids [] = { "sets number of rows to process
 static const char *hlp_temp_dir [] = { "sets a specific directory to use for temporary files", NULL };
 static const char *hlp_mmap_dir [] = { "sets a specific directory to use for memory-mapped buffers", NULL };
 static const char *hlp_unsorted_old_new [] = { "write old=>new index in unsorted order", NULL };
+static const char *hlp_threads [] = { "sets number of worker threads for copying columns and sorting",
+                                      "default 1, limited by --mem-limit", NULL };
+static const char *hlp_mmap_advise [] = { "use huge pages and access hints on memory-mapped buffers", NULL };
 
 static const char *hlp_column_md5 [] = { "generate md5sum compatible checksum files for each column [default]", NULL };
 static const char *hlp_no_column_checksum [] = { "disable generation of column checksums", NULL };
@@ -136,6 +141,8 @@ static OptDef options [] =
   , { OPT_TEMP_DIR, NULL, NULL, hlp_temp_dir, 1, true, false }
   , { OPT_MMAP_DIR, NULL, NULL, hlp_mmap_dir, 1, true, false }
   , { OPT_UNSORTED_OLD_NEW, NULL, NULL, hlp_unsorted_old_new, 1, false, false }
+  , { OPT_THREADS, NULL, NULL, hlp_threads, 1, true, false }
+  , { OPT_MMAP_ADVISE, NULL, NULL, hlp_mmap_advise, 1, false, false }
 
   , { OPT_COLUMN_MD5, NULL, NULL, hlp_column_md5, 1, false, false }
   , { OPT_NO_COLUMN_CHECKSUM, NULL, NULL, hlp_no_column_checksum, 1, false, false }
@@ -160,6 +167,8 @@ static const char *option_params [] =
   , "path-to-tmp"
   , "path-to-mmaps"
   , NULL
+  , "count"
+  , NULL
   , NULL
   , NULL
   , NULL
@@ -339,6 +348,9 @@ void initialize_params ( const ctx_t *ctx, Caps *caps, Tool *tp, Selection *sel,
     tp -> min_idx_ids =  64 * 1024 * 1024;
     tp -> max_missing_ids = tp -> max_idx_ids;
 
+    /* copy columns one at a time */
+    tp -> num_threads = 1;
+
 #if 0
     /* refpos cache size */
     tp -> refpos_cache_capacity = 100 * 1024 * 1024;
@@ -375,6 +387,11 @@ tp->write_new_to_old=true;
     tp -> unlink_idx_files = true;
     tp -> idx_consistency_check = false;
 
+    /* radix sort unless configured otherwise */
+    tp -> radix_sort = true;
+
+    /* leave paging of mmap buffers to the kernel */
+    tp -> mmap_advise = false;
 
     /* record them as caps */
     caps -> tool = tp;
@@ -401,6 +418,21 @@ tp->write_new_to_old=true;
     if ( found )
         tp -> max_ref_idx_ids = ( size_t ) val;
 
+    ON_FAIL ( val = KConfigGetNodeU64 ( ctx, "sra-sort/threads", & found ) )
+        return;
+    if ( found && val != 0 )
+        tp -> num_threads = ( uint32_t ) val;
+
+    ON_FAIL ( val = KConfigGetNodeU64 ( ctx, "sra-sort/radix_sort", & found ) )
+        return;
+    if ( found )
+        tp -> radix_sort = val != 0;
+
+    ON_FAIL ( val = KConfigGetNodeU64 ( ctx, "sra-sort/mmap_advise", & found ) )
+        return;
+    if ( found )
+        tp -> mmap_advise = val != 0;
+
     /* finally look in args */
     ON_FAIL ( str = ArgsGetOptStr ( args, ctx, OPT_TEMP_DIR, & count ) )
         return;
@@ -432,6 +464,16 @@ tp->write_new_to_old=true;
     if ( count != 0 )
         tp -> max_large_idx_ids = ( size_t ) val;
 
+    ON_FAIL ( val = ArgsGetOptU64 ( args, ctx, OPT_THREADS, & count ) )
+        return;
+    if ( count != 0 && val != 0 )
+        tp -> num_threads = ( uint32_t ) val;
+
+    ON_FAIL ( found = ArgsGetOptBool ( args, ctx, OPT_MMAP_ADVISE, & count ) )
+        return;
+    if ( count != 0 )
+        tp -> mmap_advise = true;
+
     ON_FAIL ( found = ArgsGetOptBool ( args, ctx, OPT_IGNORE_FAILURE, & count ) )
         return;
     if ( count != 0 )
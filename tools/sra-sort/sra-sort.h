@@ -95,6 +95,9 @@ struct Tool
     /* the number of missing SEQUENCE ids to gather at a time */
     size_t max_missing_ids;
 
+    /* the number of worker threads for copying columns and sorting */
+    uint32_t num_threads;
+
     /* pid of tool */
     int pid;
 
@@ -139,6 +142,12 @@ struct Tool
 
     /* perform consistency check on index */
     bool idx_consistency_check;
+
+    /* sort large id arrays by radix rather than by comparison */
+    bool radix_sort;
+
+    /* use huge pages and access hints on memory-mapped buffers */
+    bool mmap_advise;
 };
 
 
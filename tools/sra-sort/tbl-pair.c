@@ -29,6 +29,7 @@ typedef struct TablePair StdTblPair;
 
 #include "tbl-pair.h"
 #include "col-pair.h"
+#include "col-sched.h"
 #include "db-pair.h"
 #include "meta-pair.h"
 #include "row-set-priv.h"
@@ -298,29 +299,27 @@ void TablePairCopyPresortColumns ( TablePair *self, const ctx_t *ctx )
     if ( count != 0 )
     {
         RowSetIterator *rsi;
+        ColumnScheduler *sched;
         TRY ( rsi = TablePairMakeSimpleRowSetIterator ( self, ctx ) )
         {
             STATUS ( 2, "copying '%s' presorted columns", self -> full_spec );
 
-            while ( ! FAILED () )
+            TRY ( sched = ColumnSchedulerMake ( ctx, & self -> presort_cols ) )
             {
-                uint32_t i;
-
-                RowSet *rs;
-                ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
-                    break;
-                if ( rs == NULL )
-                    break;
-
-                for ( i = 0; i < count; ++ i )
+                while ( ! FAILED () )
                 {
-                    ColumnPair *col = VectorGet ( & self -> presort_cols, i );
-                    assert ( col != NULL );
-                    ON_FAIL ( ColumnPairCopy ( col, ctx, rs ) )
+                    RowSet *rs;
+                    ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
+                        break;
+                    if ( rs == NULL )
                         break;
+
+                    ColumnSchedulerCopy ( sched, ctx, rs );
+
+                    RowSetRelease ( rs, ctx );
                 }
 
-                RowSetRelease ( rs, ctx );
+                ColumnSchedulerRelease ( sched, ctx );
             }
 
             RowSetIteratorRelease ( rsi, ctx );
@@ -349,31 +348,29 @@ void TablePairCopyMappedColumns ( TablePair *self, const ctx_t *ctx )
     if ( count != 0 )
     {
         RowSetIterator *rsi;
+        ColumnScheduler *sched;
         const bool is_mapped = true;
         const bool is_large = false;
         TRY ( rsi = TablePairGetRowSetIterator ( self, ctx, is_mapped, is_large ) )
         {
             STATUS ( 2, "copying '%s' mapped columns", self -> full_spec );
 
-            while ( ! FAILED () )
+            TRY ( sched = ColumnSchedulerMake ( ctx, & self -> mapped_cols ) )
             {
-                uint32_t i;
-
-                RowSet *rs;
-                ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
-                    break;
-                if ( rs == NULL )
-                    break;
-
-                for ( i = 0; i < count; ++ i )
+                while ( ! FAILED () )
                 {
-                    ColumnPair *col = VectorGet ( & self -> mapped_cols, i );
-                    assert ( col != NULL );
-                    ON_FAIL ( ColumnPairCopy ( col, ctx, rs ) )
+                    RowSet *rs;
+                    ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
+                        break;
+                    if ( rs == NULL )
                         break;
+
+                    ColumnSchedulerCopy ( sched, ctx, rs );
+
+                    RowSetRelease ( rs, ctx );
                 }
 
-                RowSetRelease ( rs, ctx );
+                ColumnSchedulerRelease ( sched, ctx );
             }
 
             RowSetIteratorRelease ( rsi, ctx );
@@ -402,31 +399,29 @@ void TablePairCopyLargeColumns ( TablePair *self, const ctx_t *ctx )
     if ( count != 0 )
     {
         RowSetIterator *rsi;
+        ColumnScheduler *sched;
         const bool is_mapped = false;
         const bool is_large = true;
         TRY ( rsi = TablePairGetRowSetIterator ( self, ctx, is_mapped, is_large ) )
         {
             STATUS ( 2, "copying '%s' large columns", self -> full_spec );
 
-            while ( ! FAILED () )
+            TRY ( sched = ColumnSchedulerMake ( ctx, & self -> large_cols ) )
             {
-                uint32_t i;
-
-                RowSet *rs;
-                ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
-                    break;
-                if ( rs == NULL )
-                    break;
-
-                for ( i = 0; i < count; ++ i )
+                while ( ! FAILED () )
                 {
-                    ColumnPair *col = VectorGet ( & self -> large_cols, i );
-                    assert ( col != NULL );
-                    ON_FAIL ( ColumnPairCopy ( col, ctx, rs ) )
+                    RowSet *rs;
+                    ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
+                        break;
+                    if ( rs == NULL )
                         break;
+
+                    ColumnSchedulerCopy ( sched, ctx, rs );
+
+                    RowSetRelease ( rs, ctx );
                 }
 
-                RowSetRelease ( rs, ctx );
+                ColumnSchedulerRelease ( sched, ctx );
             }
 
             RowSetIteratorRelease ( rsi, ctx );
@@ -455,31 +450,29 @@ void TablePairCopyLargeMappedColumns ( TablePair *self, const ctx_t *ctx )
     if ( count != 0 )
     {
         RowSetIterator *rsi;
+        ColumnScheduler *sched;
         const bool is_mapped = true;
         const bool is_large = true;
         TRY ( rsi = TablePairGetRowSetIterator ( self, ctx, is_mapped, is_large ) )
         {
             STATUS ( 2, "copying '%s' large mapped columns", self -> full_spec );
 
-            while ( ! FAILED () )
+            TRY ( sched = ColumnSchedulerMake ( ctx, & self -> large_mapped_cols ) )
             {
-                uint32_t i;
-
-                RowSet *rs;
-                ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
-                    break;
-                if ( rs == NULL )
-                    break;
-
-                for ( i = 0; i < count; ++ i )
+                while ( ! FAILED () )
                 {
-                    ColumnPair *col = VectorGet ( & self -> large_mapped_cols, i );
-                    assert ( col != NULL );
-                    ON_FAIL ( ColumnPairCopy ( col, ctx, rs ) )
+                    RowSet *rs;
+                    ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
+                        break;
+                    if ( rs == NULL )
                         break;
+
+                    ColumnSchedulerCopy ( sched, ctx, rs );
+
+                    RowSetRelease ( rs, ctx );
                 }
 
-                RowSetRelease ( rs, ctx );
+                ColumnSchedulerRelease ( sched, ctx );
             }
 
             RowSetIteratorRelease ( rsi, ctx );
@@ -508,31 +501,29 @@ void TablePairCopyNormalColumns ( TablePair *self, const ctx_t *ctx )
     if ( count != 0 )
     {
         RowSetIterator *rsi;
+        ColumnScheduler *sched;
         const bool is_mapped = false;
         const bool is_large = false;
         TRY ( rsi = TablePairGetRowSetIterator ( self, ctx, is_mapped, is_large ) )
         {
             STATUS ( 2, "copying '%s' columns", self -> full_spec );
 
-            while ( ! FAILED () )
+            TRY ( sched = ColumnSchedulerMake ( ctx, & self -> normal_cols ) )
             {
-                uint32_t i;
-
-                RowSet *rs;
-                ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
-                    break;
-                if ( rs == NULL )
-                    break;
-
-                for ( i = 0; i < count; ++ i )
+                while ( ! FAILED () )
                 {
-                    ColumnPair *col = VectorGet ( & self -> normal_cols, i );
-                    assert ( col != NULL );
-                    ON_FAIL ( ColumnPairCopy ( col, ctx, rs ) )
+                    RowSet *rs;
+                    ON_FAIL ( rs = RowSetIteratorNext ( rsi, ctx ) )
+                        break;
+                    if ( rs == NULL )
                         break;
+
+                    ColumnSchedulerCopy ( sched, ctx, rs );
+
+                    RowSetRelease ( rs, ctx );
                 }
 
-                RowSetRelease ( rs, ctx );
+                ColumnSchedulerRelease ( sched, ctx );
             }
 
             RowSetIteratorRelease ( rsi, ctx );
@@ -551,11 +542,33 @@ void TablePairCopyNormalColumns ( TablePair *self, const ctx_t *ctx )
     }
 }
 
-void TablePairCopy ( TablePair *self, const ctx_t *ctx )
+/* ReportMemory
+ *  memory in use plus paging activity of the process
+ */
+static
+void TablePairReportMemory ( const ctx_t *ctx )
 {
     FUNC_ENTRY ( ctx );
 
-    size_t in_use, quota;
+    size_t in_use, quota, resident;
+    uint64_t major_faults, minor_faults;
+
+    in_use = MemInUse ( ctx, & quota );
+    if ( ( quota + 1 ) != 0 )
+        STATUS ( 4, "MEMORY: %,zu bytes used out of %,zu total ( %u%% )", in_use, quota, ( uint32_t ) ( in_use * 100 ) / quota );
+    else
+        STATUS ( 4, "MEMORY: %,zu bytes used", in_use );
+
+    if ( MemProcessStats ( ctx, & major_faults, & minor_faults, & resident ) )
+    {
+        STATUS ( 4, "MEMORY: %,zu bytes resident, %,lu major and %,lu minor page faults",
+                 resident, major_faults, minor_faults );
+    }
+}
+
+void TablePairCopy ( TablePair *self, const ctx_t *ctx )
+{
+    FUNC_ENTRY ( ctx );
 
     /* copy columns */
     
@@ -565,11 +578,7 @@ void TablePairCopy ( TablePair *self, const ctx_t *ctx )
 
     STATUS ( 2, "copying table '%s'", self -> full_spec );
 
-    in_use = MemInUse ( ctx, & quota );
-    if ( ( quota + 1 ) != 0 )
-        STATUS ( 4, "MEMORY: %,zu bytes used out of %,zu total ( %u%% )", in_use, quota, ( uint32_t ) ( in_use * 100 ) / quota );
-    else
-        STATUS ( 4, "MEMORY: %,zu bytes used", in_use );
+    TablePairReportMemory ( ctx );
 
     TRY ( TablePairPreCopy ( self, ctx ) )
     {
@@ -595,11 +604,7 @@ void TablePairCopy ( TablePair *self, const ctx_t *ctx )
     if ( ! FAILED () )
         TablePairPostCopy ( self, ctx );
 
-    in_use = MemInUse ( ctx, & quota );
-    if ( ( quota + 1 ) != 0 )
-        STATUS ( 4, "MEMORY: %,zu bytes used out of %,zu total ( %u%% )", in_use, quota, ( uint32_t ) ( in_use * 100 ) / quota );
-    else
-        STATUS ( 4, "MEMORY: %,zu bytes used", in_use );
+    TablePairReportMemory ( ctx );
 
     STATUS ( 2, "finished with table '%s'", self -> full_spec );
 }
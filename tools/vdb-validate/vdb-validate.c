@@ -74,9 +74,15 @@
 #include <klib/status.h> /* STSMSG */
 #include <klib/debug.h>
 #include <klib/data-buffer.h>
+#include <klib/printf.h>
 #include <klib/sort.h>
 
+#include <kproc/thread.h>
+#include <kproc/lock.h>
+#include <kproc/cond.h>
+
 #include <sysalloc.h>
+#include <atomic32.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -98,6 +104,12 @@
 
 #define SDC_ROW_CHUNK_MAX 8ull*1024ull*1024ull
 
+/* threaded checks: upper limit on workers, and least amount of work worth a thread */
+#define MAX_THREADS 64
+#ifndef MIN_ROWS_PER_THREAD
+#define MIN_ROWS_PER_THREAD (1024ull * 1024ull)
+#endif
+
 #if 0
 #define DBG_MSG(args) KOutMsg args
 #else
@@ -109,6 +121,8 @@ static bool md5_required;
 static bool ref_int_check;
 static bool s_IndexOnly;
 static size_t memory_suggestion = (2ull * 1024ull * 1024ull * 1024ull);
+static uint32_t num_threads = 1;
+static uint64_t min_rows_per_thread = MIN_ROWS_PER_THREAD;
 
 typedef struct node_s {
     int parent;
@@ -120,6 +134,7 @@ typedef struct node_s {
     uint32_t objType;
 } node_t;
 typedef struct cc_context_s {
+    struct cc_prefetch_s *prefetch;
     node_t *nodes;
     char *names;
     rc_t rc;
@@ -323,6 +338,319 @@ static rc_t visiting(CCReportInfoBlock const *what, cc_context_t *ctx)
     return 0;
 }
 
+/* parallel consistency check
+ *  kdb checks an object in a single walk, reporting as it goes. to keep
+ *  that walk from waiting on storage, the column data files are listed
+ *  up front and read ahead in blocks by a bounded number of threads.
+ *  the check only tells which column it has reached: the read-ahead stays
+ *  within a number of bytes from the start of that column, and columns
+ *  the check has passed are not read anymore. */
+#define CC_PREFETCH_BLOCK (4u * 1024u * 1024u)
+#define CC_PREFETCH_WINDOW (64u * 1024u * 1024u) /* per thread */
+#define CC_PREFETCH_DEPTH 8
+
+typedef struct cc_column_s {
+    char *path;         /* column directory, from the object's directory */
+    char const *name;   /* path without the leading "./" */
+    uint64_t size;      /* of the data file */
+    uint64_t start;     /* sum of the sizes of the columns before it */
+} cc_column_t;
+
+typedef struct cc_prefetch_s {
+    KDirectory const *dir;
+    KLock *lock;
+    KCondition *cond;
+    cc_column_t *col;
+    unsigned count;
+    unsigned max;
+    unsigned next;      /* column of the next block to read ahead */
+    unsigned checked;   /* column being checked */
+    uint64_t next_pos;  /* of the next block in its column */
+    uint64_t total;     /* size of all data files */
+    uint64_t window;    /* bytes to read ahead of the start of checked */
+    unsigned threads;
+    atomic32_t done;
+    KThread *thread[MAX_THREADS];
+} cc_prefetch_t;
+
+static rc_t cc_prefetch_add(cc_prefetch_t *self, char const path[], uint64_t size)
+{
+    cc_column_t *col;
+
+    if (self->count == self->max) {
+        unsigned const max = self->max ? self->max * 2 : 64;
+        void *const temp = realloc(self->col, max * sizeof(self->col[0]));
+
+        if (temp == NULL)
+            return RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+        self->col = temp;
+        self->max = max;
+    }
+    col = &self->col[self->count];
+    col->path = string_dup_measure(path, NULL);
+    if (col->path == NULL)
+        return RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+    col->name = strncmp(col->path, "./", 2) == 0 ? col->path + 2 : col->path;
+    col->size = size;
+    col->start = self->total;
+    self->total += size;
+    ++self->count;
+    return 0;
+}
+
+static bool is_col_dir(char const path[])
+{
+    size_t const len = strlen(path);
+
+    return len >= 3 && strcmp(&path[len - 3], "col") == 0
+        && (len == 3 || path[len - 4] == '/');
+}
+
+/* find column directories having a non-empty data file, in listing order */
+static rc_t cc_prefetch_collect(cc_prefetch_t *self, char const path[], unsigned depth)
+{
+    KNamelist *list;
+    uint32_t i, n = 0;
+    rc_t rc;
+
+    if (depth > CC_PREFETCH_DEPTH)
+        return 0;
+
+    rc = KDirectoryList(self->dir, &list, NULL, NULL, "%s", path);
+    if (rc)
+        return rc;
+    rc = KNamelistCount(list, &n);
+    for (i = 0; rc == 0 && i < n; ++i) {
+        char const *name;
+        char sub[4096];
+        uint64_t size = 0;
+
+        rc = KNamelistGet(list, i, &name);
+        if (rc == 0)
+            rc = string_printf(sub, sizeof(sub), NULL, "%s/%s", path, name);
+        if (rc)
+            break;
+        if ((KDirectoryPathType(self->dir, "%s", sub) & ~kptAlias) != kptDir)
+            continue;
+        if (!is_col_dir(path))
+            rc = cc_prefetch_collect(self, sub, depth + 1);
+        else if ((KDirectoryPathType(self->dir, "%s/data", sub) & ~kptAlias) == kptFile
+                 && KDirectoryFileSize(self->dir, &size, "%s/data", sub) == 0
+                 && size > 0)
+        {
+            rc = cc_prefetch_add(self, sub, size);
+        }
+    }
+    KNamelistRelease(list);
+    return rc;
+}
+
+/* claim the next block to read ahead, called under the lock;
+ * false when it is not to be read yet or there is none left */
+static bool cc_prefetch_next(cc_prefetch_t *self, unsigned *k, uint64_t *pos)
+{
+    if (self->next < self->checked) {
+        self->next = self->checked;
+        self->next_pos = 0;
+    }
+    while (self->next < self->count
+           && self->next_pos >= self->col[self->next].size)
+    {
+        ++self->next;
+        self->next_pos = 0;
+    }
+    if (self->next >= self->count
+        || self->col[self->next].start + self->next_pos
+           >= self->col[self->checked].start + self->window)
+    {
+        return false;
+    }
+    *k = self->next;
+    *pos = self->next_pos;
+    self->next_pos += CC_PREFETCH_BLOCK;
+    return true;
+}
+
+static rc_t CC cc_prefetch_thread(KThread const *thread, void *data)
+{
+    cc_prefetch_t *const self = data;
+    void *const buffer = malloc(CC_PREFETCH_BLOCK);
+    KFile const *f = NULL;
+    unsigned fk = self->count;
+
+    if (buffer == NULL)
+        return RC(rcExe, rcData, rcAllocating, rcMemory, rcExhausted);
+
+    KLockAcquire(self->lock);
+    while (atomic32_read(&self->done) == 0) {
+        unsigned k;
+        uint64_t pos;
+        size_t num_read;
+
+        if (!cc_prefetch_next(self, &k, &pos)) {
+            if (self->next >= self->count)
+                break;
+            KConditionWait(self->cond, self->lock);
+            continue;
+        }
+        KLockUnlock(self->lock);
+
+        /* only warming the cache: errors are left for the check to find */
+        if (k != fk) {
+            KFileRelease(f);
+            f = NULL;
+            fk = k;
+            (void)KDirectoryOpenFileRead(self->dir, &f, "%s/data", self->col[k].path);
+        }
+        if (f != NULL)
+            (void)KFileRead(f, pos, buffer, CC_PREFETCH_BLOCK, &num_read);
+
+        KLockAcquire(self->lock);
+    }
+    KLockUnlock(self->lock);
+
+    KFileRelease(f);
+    free(buffer);
+    return 0;
+}
+
+/* path of a visited object from the directory of the checked one,
+ * e.g. "tbl/SEQUENCE/col/READ"; the checked object is nodes[0] */
+static rc_t cc_node_path(cc_context_t const *ctx, int nn, char path[], size_t size, size_t *len)
+{
+    node_t const *const node = &ctx->nodes[nn];
+    char const *name = &ctx->names[node->name];
+    char const *const leaf = strrchr(name, '/');
+    char const *dir;
+    size_t num_writ;
+    rc_t rc;
+
+    *len = 0;
+    if (node->parent < 0)
+        return 0;
+
+    rc = cc_node_path(ctx, node->parent, path, size, len);
+    if (rc)
+        return rc;
+
+    switch (node->objType) {
+    case kptDatabase:
+        dir = "db";
+        break;
+    case kptTable:
+        dir = "tbl";
+        break;
+    case kptColumn:
+        dir = "col";
+        break;
+    default:
+        return RC(rcExe, rcPath, rcConstructing, rcType, rcUnexpected);
+    }
+    if (leaf != NULL)
+        name = leaf + 1;
+    rc = string_printf(&path[*len], size - *len, &num_writ, "%s%s/%s",
+        *len ? "/" : "", dir, name);
+    if (rc == 0)
+        *len += num_writ;
+    return rc;
+}
+
+/* called when the check visits a column: move the read-ahead window */
+static void cc_prefetch_advance(cc_prefetch_t *self, cc_context_t const *ctx, int nn)
+{
+    char path[4096];
+    size_t len;
+    unsigned i, n;
+
+    if (cc_node_path(ctx, nn, path, sizeof(path), &len) != 0)
+        return;
+
+    KLockAcquire(self->lock);
+    for (i = self->checked, n = 0; n < self->count; ++n, i = (i + 1) % self->count) {
+        if (strcmp(self->col[i].name, path) == 0) {
+            self->checked = i;
+            KConditionBroadcast(self->cond);
+            break;
+        }
+    }
+    KLockUnlock(self->lock);
+}
+
+static void cc_prefetch_stop(cc_prefetch_t *self)
+{
+    unsigned i;
+
+    if (self == NULL)
+        return;
+
+    KLockAcquire(self->lock);
+    atomic32_set(&self->done, 1);
+    KConditionBroadcast(self->cond);
+    KLockUnlock(self->lock);
+
+    for (i = 0; i < self->threads; ++i) {
+        rc_t status;
+
+        KThreadWait(self->thread[i], &status);
+        KThreadRelease(self->thread[i]);
+    }
+    for (i = 0; i < self->count; ++i)
+        free(self->col[i].path);
+    free(self->col);
+
+    KConditionRelease(self->cond);
+    KLockRelease(self->lock);
+    KDirectoryRelease(self->dir);
+    free(self);
+}
+
+/* takes ownership of dir; returns NULL when there is nothing to read ahead */
+static cc_prefetch_t *cc_prefetch_start(KDirectory const *dir, unsigned threads)
+{
+    cc_prefetch_t *const self = calloc(1, sizeof(*self));
+    rc_t rc;
+
+    if (self == NULL) {
+        KDirectoryRelease(dir);
+        return NULL;
+    }
+    self->dir = dir;
+    atomic32_set(&self->done, 0);
+
+    rc = cc_prefetch_collect(self, ".", 0);
+    if (rc == 0)
+        rc = KLockMake(&self->lock);
+    if (rc == 0)
+        rc = KConditionMake(&self->cond);
+    if (rc == 0 && self->count > 1) {
+        if (threads > MAX_THREADS)
+            threads = MAX_THREADS;
+        if (threads > self->count)
+            threads = self->count;
+        /* the read-ahead has to stay in the page cache until it is checked */
+        self->window = (uint64_t)threads * CC_PREFETCH_WINDOW;
+        if (self->window > memory_suggestion / 2)
+            self->window = memory_suggestion / 2;
+        if (self->window < CC_PREFETCH_BLOCK)
+            self->window = CC_PREFETCH_BLOCK;
+
+        for ( ; self->threads < threads; ++self->threads) {
+            if (KThreadMake(&self->thread[self->threads], cc_prefetch_thread, self) != 0)
+                break;
+        }
+        if (self->threads > 0) {
+            (void)PLOGMSG(klogInfo, (klogInfo, "Reading ahead $(count) columns "
+                "($(size) bytes) with $(threads) threads, up to $(window) bytes "
+                "ahead", "count=%u,size=%lu,threads=%u,window=%lu",
+                self->count, self->total, self->threads, self->window));
+            return self;
+        }
+    }
+
+    cc_prefetch_stop(self);
+    return NULL;
+}
+
 static rc_t CC report(CCReportInfoBlock const *what, void *Ctx)
 {
     cc_context_t *ctx = Ctx;
@@ -331,8 +659,12 @@ static rc_t CC report(CCReportInfoBlock const *what, void *Ctx)
     if (rc)
         return rc;
 
-    if (what->type == ccrpt_Visit)
-        return visiting(what, ctx);
+    if (what->type == ccrpt_Visit) {
+        rc = visiting(what, ctx);
+        if (rc == 0 && what->objType == kptColumn && ctx->prefetch != NULL)
+            cc_prefetch_advance(ctx->prefetch, ctx, ctx->nextNode - 1);
+        return rc;
+    }
 
     switch (what->objType) {
     case kptDatabase:
@@ -358,6 +690,10 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
     char const *objtype;
 
     uint32_t level = ( mode & 4 ) ? 3 : ( mode & 2 ) ? 1 : 0;
+
+    /* read column data ahead when checksums are to be verified */
+    bool const parallel = num_threads > 1 && ( mode & 3 ) != 0 && !s_IndexOnly;
+
     if (s_IndexOnly)
         level |= CC_INDEX_ONLY;
 
@@ -388,7 +724,13 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
         rc = KDBManagerOpenDBRead ( mgr, & db, "%s", name );
         if ( rc == 0 )
         {
+            const KDirectory *dir;
+            if ( parallel && KDatabaseOpenDirectoryRead ( db, & dir ) == 0 )
+                ctx.prefetch = cc_prefetch_start ( dir, num_threads );
+
             rc = KDatabaseConsistencyCheck ( db, 0, level, report, & ctx );
+            cc_prefetch_stop ( ctx.prefetch );
+            ctx.prefetch = NULL;
             if ( rc == 0 )
             {
                 rc = ctx.rc;
@@ -407,7 +749,13 @@ rc_t kdbcc ( const KDBManager *mgr, char const name[], uint32_t mode,
         rc = KDBManagerOpenTableRead ( mgr, & tbl, "%s", name );
         if ( rc == 0 )
         {
+            const KDirectory *dir;
+            if ( parallel && KTableOpenDirectoryRead ( tbl, & dir ) == 0 )
+                ctx.prefetch = cc_prefetch_start ( dir, num_threads );
+
             rc = KTableConsistencyCheck ( tbl, 0, level, report, & ctx, platform );
+            cc_prefetch_stop ( ctx.prefetch );
+            ctx.prefetch = NULL;
             if ( rc == 0 )
                 rc = ctx.rc;
 
@@ -1279,6 +1627,222 @@ static void sort_keys(size_t const N, int64_t array[/* N */])
 #undef INDEXOF
 }
 
+static unsigned thread_count(uint64_t const rows)
+{
+    uint64_t const most = rows / min_rows_per_thread;
+    unsigned n = num_threads < MAX_THREADS ? num_threads : MAX_THREADS;
+
+    if (n > most)
+        n = (unsigned)most;
+    return n > 0 ? n : 1;
+}
+
+static bool pair_less(id_pair_t const *const a, id_pair_t const *const b)
+{
+    return a->first < b->first || (a->first == b->first && a->second < b->second);
+}
+
+static void reverse_pairs(id_pair_t *lo, id_pair_t *hi)
+{
+    while (lo < --hi) {
+        id_pair_t const tmp = *lo;
+        *lo++ = *hi;
+        *hi = tmp;
+    }
+}
+
+/* merge sorted [a, m) and [m, b) in place: SymMerge, by rotations */
+static void merge_in_place(id_pair_t array[], size_t a, size_t m, size_t b)
+{
+    size_t mid, n, start, r, end;
+
+    if (a >= m || m >= b)
+        return;
+    if (m - a == 1) {
+        /* insert array[a] into the right run */
+        size_t i = m, j = b;
+        while (i < j) {
+            size_t const h = i + (j - i) / 2;
+            if (pair_less(&array[h], &array[a])) i = h + 1; else j = h;
+        }
+        reverse_pairs(&array[a], &array[m]);
+        reverse_pairs(&array[m], &array[i]);
+        reverse_pairs(&array[a], &array[i]);
+        return;
+    }
+    if (b - m == 1) {
+        /* insert array[m] into the left run */
+        size_t i = a, j = m;
+        while (i < j) {
+            size_t const h = i + (j - i) / 2;
+            if (!pair_less(&array[m], &array[h])) i = h + 1; else j = h;
+        }
+        reverse_pairs(&array[i], &array[m]);
+        reverse_pairs(&array[m], &array[b]);
+        reverse_pairs(&array[i], &array[b]);
+        return;
+    }
+
+    mid = a + (b - a) / 2;
+    n = mid + m;
+    if (m > mid) {
+        start = n - b;
+        r = mid;
+    }
+    else {
+        start = a;
+        r = m;
+    }
+    while (start < r) {
+        size_t const c = start + (r - start) / 2;
+        if (!pair_less(&array[n - 1 - c], &array[c])) start = c + 1; else r = c;
+    }
+    end = n - start;
+    if (start < m && m < end) {
+        /* rotate [start, end) to bring [m, end) before [start, m) */
+        reverse_pairs(&array[start], &array[m]);
+        reverse_pairs(&array[m], &array[end]);
+        reverse_pairs(&array[start], &array[end]);
+    }
+    merge_in_place(array, a, start, mid);
+    merge_in_place(array, mid, end, b);
+}
+
+/* merge sorted [a, m) and [m, b) through scratch room for the shorter run */
+static void merge_buffered(id_pair_t array[], size_t a, size_t m, size_t b,
+                           id_pair_t scratch[])
+{
+    if (m - a <= b - m) {
+        /* forward, from the left run in scratch */
+        id_pair_t const *l = scratch, *const le = scratch + (m - a);
+        id_pair_t const *r = &array[m], *const re = &array[b];
+        id_pair_t *out = &array[a];
+
+        memmove(scratch, &array[a], (m - a) * sizeof(array[0]));
+        while (l < le && r < re)
+            *out++ = pair_less(r, l) ? *r++ : *l++;
+        while (l < le)
+            *out++ = *l++;
+    }
+    else {
+        /* backward, from the right run in scratch */
+        id_pair_t const *r = scratch + (b - m), *const rb = scratch;
+        id_pair_t const *l = &array[m], *const lb = &array[a];
+        id_pair_t *out = &array[b];
+
+        memmove(scratch, &array[m], (b - m) * sizeof(array[0]));
+        while (l > lb && r > rb)
+            *--out = pair_less(r - 1, l - 1) ? *--l : *--r;
+        while (r > rb)
+            *--out = *--r;
+    }
+}
+
+typedef struct sort_part_s {
+    KThread *thread;
+    id_pair_t *array;
+    size_t N;
+    size_t M;           /* merge: [0, M) and [M, N) are sorted */
+    id_pair_t *scratch; /* merge: room for N / 2, or NULL to merge in place */
+} sort_part_t;
+
+static rc_t CC sort_part_thread(KThread const *self, void *data)
+{
+    sort_part_t *const part = data;
+
+    sort_key_pairs(part->N, part->array);
+    return 0;
+}
+
+static rc_t CC merge_part_thread(KThread const *self, void *data)
+{
+    sort_part_t *const part = data;
+
+    if (part->scratch != NULL)
+        merge_buffered(part->array, 0, part->M, part->N, part->scratch);
+    else
+        merge_in_place(part->array, 0, part->M, part->N);
+    return 0;
+}
+
+/* runs each part on a thread of its own, or here if it cannot be started */
+static void run_parts(unsigned const parts, sort_part_t part[],
+                      rc_t (CC *run)(KThread const *, void *))
+{
+    unsigned j;
+
+    for (j = 0; j < parts; ++j) {
+        if (KThreadMake(&part[j].thread, run, &part[j]) != 0) {
+            part[j].thread = NULL;
+            run(NULL, &part[j]);
+        }
+    }
+    for (j = 0; j < parts; ++j) {
+        if (part[j].thread != NULL) {
+            rc_t status;
+
+            KThreadWait(part[j].thread, &status);
+            KThreadRelease(part[j].thread);
+        }
+    }
+}
+
+/* sort key pairs in slices on separate threads,
+ * then merge neighboring slices pairwise on separate threads.
+ * a merge buffers its shorter run: N / 2 pairs for all merges at once,
+ * which together with the array must fit in memory_suggestion,
+ * or else the slices are merged in place */
+static void sort_key_pairs_mt(size_t const N, id_pair_t array[/* N */])
+{
+    sort_part_t part[MAX_THREADS];
+    size_t bound[MAX_THREADS + 1];
+    unsigned runs = thread_count(N);
+    id_pair_t *scratch = NULL;
+    unsigned j;
+
+    if (runs < 2) {
+        sort_key_pairs(N, array);
+        return;
+    }
+
+    for (j = 0; j < runs; ++j) {
+        bound[j] = (N * j) / runs;
+        part[j].array = &array[bound[j]];
+        part[j].N = (N * (j + 1)) / runs - bound[j];
+    }
+    bound[runs] = N;
+    run_parts(runs, part, sort_part_thread);
+
+    if (N / 2 + N <= memory_suggestion / sizeof(array[0]))
+        scratch = malloc((N / 2) * sizeof(array[0]));
+
+    while (runs > 1) {
+        unsigned const merges = runs / 2;
+
+        for (j = 0; j < merges; ++j) {
+            size_t const a = bound[2 * j];
+            size_t const m = bound[2 * j + 1];
+            size_t const b = bound[2 * j + 2];
+
+            part[j].array = &array[a];
+            part[j].M = m - a;
+            part[j].N = b - a;
+            /* [a / 2, b / 2) of scratch is this merge's alone */
+            part[j].scratch = scratch != NULL ? &scratch[a / 2] : NULL;
+        }
+        run_parts(merges, part, merge_part_thread);
+
+        for (j = 0; j < merges; ++j)
+            bound[j] = bound[2 * j];
+        if (runs % 2 != 0)
+            bound[j++] = bound[runs - 1];
+        bound[j] = N;
+        runs = j;
+    }
+
+    free(scratch);
+}
+
 #define CHECK_QUITTING do { rc_t const rc = Quitting(); if (rc) return rc; } while(0);
 
 static size_t load_key_pairs(int64_t const startId,
@@ -1371,7 +1935,10 @@ static rc_t ric_align_generic(int64_t const startId,
                               VCursor const *const acurs,
                               ColumnInfo *const aci,
                               VCursor const *const bcurs,
-                              ColumnInfo *const bci
+                              ColumnInfo *const bci,
+                              atomic32_t const *const failed,
+                              int const range,
+                              bool const progress
                               )
 {
     int64_t chunk;
@@ -1392,7 +1959,10 @@ static rc_t ric_align_generic(int64_t const startId,
         if (rc) return rc;
         if (chunk == last)
             break;
-        if (chunk != startId) {
+        /* a lower range has failed: it is the one to report */
+        if (failed != NULL && atomic32_read(failed) < range)
+            return 0;
+        if (progress && chunk != startId) {
             (void)PLOGMSG(klogInfo, (klogInfo, "Referential Integrity: "
                                      "$(aname) <-> $(bname)"
                                      " $(pct)% complete",
@@ -1471,6 +2041,135 @@ static rc_t ric_align_generic(int64_t const startId,
     return 0;
 }
 
+typedef struct ric_worker_s {
+    KThread *thread;
+    VCursor const *acurs;
+    VCursor const *bcurs;
+    ColumnInfo aci;
+    ColumnInfo bci;
+    int64_t startId;
+    uint64_t count;
+    size_t chunk;
+    atomic32_t *failed; /* the lowest failing range */
+    int range;
+    bool progress;
+    rc_t rc;
+} ric_worker_t;
+
+static rc_t open_ric_cursor(VTable const *tbl, ColumnInfo *ci, VCursor const **curs)
+{
+    rc_t rc = VTableCreateCursorRead(tbl, curs);
+    if (rc == 0)
+        rc = VCursorAddColumn(*curs, &ci->idx, "%s", ci->name);
+    if (rc == 0)
+        rc = VCursorOpen(*curs);
+    return rc;
+}
+
+/* lowers the lowest failing range to range */
+static void ric_range_failed(atomic32_t *const failed, int const range)
+{
+    int cur = atomic32_read(failed);
+
+    while (range < cur) {
+        int const prev = atomic32_test_and_set(failed, range, cur);
+        if (prev == cur)
+            break;
+        cur = prev;
+    }
+}
+
+/* checks one id range with the cursors opened for it */
+static rc_t CC ric_worker_thread(KThread const *self, void *data)
+{
+    ric_worker_t *const w = data;
+    id_pair_t *const pair = malloc(sizeof(id_pair_t) * w->chunk);
+    rc_t rc;
+
+    if (pair) {
+        void *scratch = NULL;
+
+        rc = ric_align_generic(w->startId, w->count, w->chunk, pair, &scratch,
+                               w->acurs, &w->aci, w->bcurs, &w->bci,
+                               w->failed, w->range, w->progress);
+        free(scratch);
+        free(pair);
+    }
+    else
+        rc = RC(rcExe, rcDatabase, rcValidating, rcMemory, rcExhausted);
+
+    /* no point in the higher ranges going on, the lower ones finish */
+    if (rc != 0)
+        ric_range_failed(w->failed, w->range);
+
+    w->rc = rc;
+    return rc;
+}
+
+/* referential integrity of a.aname -> b.bname over disjoint id ranges,
+ * one thread per range; the result is that of the lowest failing range:
+ * the ranges below it are checked to the end, so it does not depend on timing */
+static rc_t ric_align_parallel(VTable const *atbl, char const aname[],
+                               VTable const *btbl, char const bname[],
+                               int64_t const startId, uint64_t const count,
+                               unsigned const threads)
+{
+    ric_worker_t worker[MAX_THREADS];
+    size_t const max = memory_suggestion / (sizeof(id_pair_t)) / threads;
+    atomic32_t failed;
+    unsigned i;
+    rc_t rc = 0;
+
+    atomic32_set(&failed, (int)threads);
+    memset(worker, 0, sizeof(worker));
+
+    /* the cursors are made here: a worker only reads its own */
+    for (i = 0; i < threads && rc == 0; ++i) {
+        ric_worker_t *const w = &worker[i];
+        uint64_t const first = (count * i) / threads;
+
+        w->aci.name = aname;
+        w->bci.name = bname;
+        w->startId = startId + first;
+        w->count = (count * (i + 1)) / threads - first;
+        w->chunk = w->count > max ? max : (size_t)w->count;
+        w->failed = &failed;
+        w->range = (int)i;
+        w->progress = i == 0;
+
+        rc = open_ric_cursor(atbl, &w->aci, &w->acurs);
+        if (rc == 0)
+            rc = open_ric_cursor(btbl, &w->bci, &w->bcurs);
+    }
+    for (i = 0; i < threads && rc == 0; ++i) {
+        ric_worker_t *const w = &worker[i];
+
+        if (KThreadMake(&w->thread, ric_worker_thread, w) != 0)
+            w->thread = NULL;
+    }
+    for (i = 0; i < threads; ++i) {
+        ric_worker_t *const w = &worker[i];
+
+        if (w->thread != NULL) {
+            rc_t status;
+
+            KThreadWait(w->thread, &status);
+            KThreadRelease(w->thread);
+        }
+        else if (rc == 0) {
+            /* could not start it, do it here */
+            ric_worker_thread(NULL, w);
+        }
+        VCursorRelease(w->acurs);
+        VCursorRelease(w->bcurs);
+    }
+    /* a stopped range reports success, the ones below the lowest failure
+       have all been checked */
+    for (i = 0; i < threads && rc == 0; ++i)
+        rc = worker[i].rc;
+    return rc;
+}
+
 static rc_t ric_align_ref_and_align(char const dbname[],
                                     VTable const *ref,
                                     VTable const *align,
@@ -1513,14 +2212,20 @@ static rc_t ric_align_ref_and_align(char const dbname[],
                 "reference table can not be read", "name=%s", dbname));
     }
     if (rc == 0) {
-        size_t const chunk = work_chunk(count);
-        id_pair_t *const pair = malloc(sizeof(id_pair_t) * chunk);
+        unsigned const threads = thread_count(count);
+        size_t const chunk = threads > 1 ? 0 : work_chunk(count);
+        id_pair_t *const pair = threads > 1 ? NULL : malloc(sizeof(id_pair_t) * chunk);
 
-        if (pair) {
+        if (pair || threads > 1) {
             void *scratch = NULL;
 
-            rc = ric_align_generic(startId, count, chunk, pair, &scratch,
-                                   acurs, &aci, bcurs, &bci);
+            if (threads > 1)
+                rc = ric_align_parallel(align, aci.name, ref, bci.name,
+                                        startId, count, threads);
+            else
+                rc = ric_align_generic(startId, count, chunk, pair, &scratch,
+                                       acurs, &aci, bcurs, &bci,
+                                       NULL, 0, true);
             if (scratch)
                 free(scratch);
 
@@ -1595,14 +2300,20 @@ static rc_t ric_align_seq_and_pri(char const dbname[],
                 "sequence table can not be read", "name=%s", dbname));
     }
     if (rc == 0) {
-        size_t const chunk = work_chunk(count);
-        id_pair_t *const pair = malloc((sizeof(id_pair_t)+sizeof(int64_t)) * chunk);
+        unsigned const threads = thread_count(count);
+        size_t const chunk = threads > 1 ? 0 : work_chunk(count);
+        id_pair_t *const pair = threads > 1 ? NULL : malloc((sizeof(id_pair_t)+sizeof(int64_t)) * chunk);
 
-        if (pair) {
+        if (pair || threads > 1) {
             void *scratch = NULL;
 
-            rc = ric_align_generic(startId, count, chunk, pair, &scratch,
-                                   acurs, &aci, bcurs, &bci);
+            if (threads > 1)
+                rc = ric_align_parallel(pri, aci.name, seq, bci.name,
+                                        startId, count, threads);
+            else
+                rc = ric_align_generic(startId, count, chunk, pair, &scratch,
+                                       acurs, &aci, bcurs, &bci,
+                                       NULL, 0, true);
             if (scratch)
                 free(scratch);
 
@@ -1878,7 +2589,7 @@ static rc_t ridc_align_seq_pri_sec(const vdb_validate_params *pb,
 
             if (!ordered)
             {
-                sort_key_pairs(i_count, seq_spot_id_pairs);
+                sort_key_pairs_mt(i_count, seq_spot_id_pairs);
             }
 
             // Load chunk of PRIMARY_ALIGNMENT_ID (and some other fields) and sort ids for faster data retrieval
@@ -1958,7 +2669,7 @@ static rc_t ridc_align_seq_pri_sec(const vdb_validate_params *pb,
 
             if (!ordered)
             {
-                sort_key_pairs(i_count, pri_id_pairs);
+                sort_key_pairs_mt(i_count, pri_id_pairs);
             }
 
             for ( i = 0; i < i_count; ++i )
@@ -2909,12 +3620,21 @@ static const char *USAGE_SDC_PLEN_THOLD[] =
 #define OPTION_NGC "ngc"
 static const char *USAGE_NGC[] = { "path to ngc file", NULL };
 
+#define OPTION_THREADS "threads"
+static const char *USAGE_THREADS[] =
+{ "Number of threads to use for referential integrity checks",
+  "and for reading column data ahead of checksum verification (default: 1)", NULL };
+
 static const char *USAGE_DRI[] =
 { "Do not check data referential integrity for databases", NULL };
 
 static const char *USAGE_IND_ONLY[] =
 { "Check index-only with blobs CRC32 (default: no)", NULL };
 
+#define OPTION_MIN_ROWS "min-rows-per-thread"
+static const char *USAGE_MIN_ROWS[] =
+{ "Least number of rows worth a thread of the threaded checks", NULL };
+
 static OptDef options [] =
 {                                                    /* needs_value, required */
 /*  { OPTION_MD5     , ALIAS_MD5     , NULL, USAGE_MD5     , 1, true , false }*/
@@ -2927,6 +3647,7 @@ static OptDef options [] =
   , { OPTION_REF_INT , ALIAS_REF_INT , NULL, USAGE_REF_INT , 1, true , false }
   , { OPTION_CNS_CHK , ALIAS_CNS_CHK , NULL, USAGE_CNS_CHK , 1, true , false }
   , { OPTION_NGC     , NULL          , NULL, USAGE_NGC     , 1, true , false }
+  , { OPTION_THREADS , NULL          , NULL, USAGE_THREADS , 1, true , false }
 
     /* secondary alignment table data check options */
   , { OPTION_SDC_SEC_ROWS, NULL      , NULL, USAGE_SDC_SEC_ROWS, 1, true , false }
@@ -2936,6 +3657,7 @@ static OptDef options [] =
     /* not printed by --help */
   , { "dri"          , NULL          , NULL, USAGE_DRI     , 1, false, false }
   , { "index-only"   ,NULL           , NULL, USAGE_IND_ONLY, 1, false, false }
+  , { OPTION_MIN_ROWS, NULL          , NULL, USAGE_MIN_ROWS, 1, true , false }
 
     /* obsolete options for backward compatibility */
   , { OPTION_md5     , ALIAS_md5     , NULL, USAGE_MD5     , 1, true , false }
@@ -2989,6 +3711,7 @@ rc_t CC Usage ( const Args * args )
     HelpOptionLine(NULL          , OPTION_SDC_SEQ_ROWS, "rows"    , USAGE_SDC_SEQ_ROWS);
     HelpOptionLine(NULL          , OPTION_SDC_PLEN_THOLD, "threshold", USAGE_SDC_PLEN_THOLD);
     HelpOptionLine(NULL          , OPTION_NGC           , "path", USAGE_NGC);
+    HelpOptionLine(NULL          , OPTION_THREADS       , "count", USAGE_THREADS);
 
 /*
 #define NUM_LISTABLE_OPTIONS \
@@ -3310,6 +4033,60 @@ rc_t parse_args ( vdb_validate_params *pb, Args *args )
         }
     }
 
+/* OPTION_THREADS */
+    {
+        rc = ArgsOptionCount(args, OPTION_THREADS, &cnt);
+        if (rc != 0) {
+            LOGERR(klogErr, rc, "Failure to get '" OPTION_THREADS "' argument");
+            return rc;
+        }
+        if (cnt != 0) {
+            uint64_t value;
+
+            rc = ArgsOptionValue(args, OPTION_THREADS, 0, (const void **)&dummy);
+            if (rc != 0) {
+                LOGERR(klogErr, rc,
+                    "Failure to get '" OPTION_THREADS "' argument");
+                return rc;
+            }
+            value = string_to_U64(dummy, string_size(dummy), &rc);
+            if (rc == 0 && value == 0)
+                rc = RC(rcExe, rcArgv, rcParsing, rcParam, rcInvalid);
+            if (rc != 0) {
+                LOGERR(klogErr, rc, OPTION_THREADS " has illegal value");
+                return rc;
+            }
+            num_threads = value < MAX_THREADS ? (uint32_t)value : MAX_THREADS;
+        }
+    }
+
+/* OPTION_MIN_ROWS: lets tests run the threaded checks on small databases */
+    {
+        rc = ArgsOptionCount(args, OPTION_MIN_ROWS, &cnt);
+        if (rc != 0) {
+            LOGERR(klogErr, rc, "Failure to get '" OPTION_MIN_ROWS "' argument");
+            return rc;
+        }
+        if (cnt != 0) {
+            uint64_t value;
+
+            rc = ArgsOptionValue(args, OPTION_MIN_ROWS, 0, (const void **)&dummy);
+            if (rc != 0) {
+                LOGERR(klogErr, rc,
+                    "Failure to get '" OPTION_MIN_ROWS "' argument");
+                return rc;
+            }
+            value = string_to_U64(dummy, string_size(dummy), &rc);
+            if (rc == 0 && value == 0)
+                rc = RC(rcExe, rcArgv, rcParsing, rcParam, rcInvalid);
+            if (rc != 0) {
+                LOGERR(klogErr, rc, OPTION_MIN_ROWS " has illegal value");
+                return rc;
+            }
+            min_rows_per_thread = value;
+        }
+    }
+
     if ( pb -> blob_crc || pb -> index_chk )
         pb -> md5_chk = pb -> md5_chk_explicit;
 